@@ -25,6 +25,7 @@
 #include "gstvaapibufferproxy.h"
 #include "gstvaapibufferproxy_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiobject_priv.h"
 
 #define DEBUG 1
@@ -48,6 +49,9 @@ from_GstVaapiBufferMemoryType (guint type)
     case GST_VAAPI_BUFFER_MEMORY_TYPE_GEM_BUF:
       va_type = VA_SURFACE_ATTRIB_MEM_TYPE_KERNEL_DRM;
       break;
+    case GST_VAAPI_BUFFER_MEMORY_TYPE_USER_PTR:
+      va_type = VA_SURFACE_ATTRIB_MEM_TYPE_USER_PTR;
+      break;
 #endif
     default:
       va_type = 0;
@@ -69,6 +73,9 @@ to_GstVaapiBufferMemoryType (guint va_type)
     case VA_SURFACE_ATTRIB_MEM_TYPE_KERNEL_DRM:
       type = GST_VAAPI_BUFFER_MEMORY_TYPE_GEM_BUF;
       break;
+    case VA_SURFACE_ATTRIB_MEM_TYPE_USER_PTR:
+      type = GST_VAAPI_BUFFER_MEMORY_TYPE_USER_PTR;
+      break;
 #endif
     default:
       type = 0;
@@ -91,8 +98,11 @@ gst_vaapi_buffer_proxy_acquire_handle (GstVaapiBufferProxy * proxy)
     return FALSE;
 
   GST_VAAPI_OBJECT_LOCK_DISPLAY (proxy->parent);
-  va_status = vaAcquireBufferHandle (GST_VAAPI_OBJECT_VADISPLAY (proxy->parent),
-      proxy->va_buf, &proxy->va_info);
+  GST_VAAPI_PROFILER_CALL (va_status,
+      GST_VAAPI_OBJECT_VADISPLAY (proxy->parent), VA_INVALID_ID,
+      ACQUIRE_BUFFER_HANDLE, 0,
+      vaAcquireBufferHandle (GST_VAAPI_OBJECT_VADISPLAY (proxy->parent),
+          proxy->va_buf, &proxy->va_info));
   GST_VAAPI_OBJECT_UNLOCK_DISPLAY (proxy->parent);
   if (!vaapi_check_status (va_status, "vaAcquireBufferHandle()"))
     return FALSE;
@@ -114,8 +124,11 @@ gst_vaapi_buffer_proxy_release_handle (GstVaapiBufferProxy * proxy)
     return FALSE;
 
   GST_VAAPI_OBJECT_LOCK_DISPLAY (proxy->parent);
-  va_status = vaReleaseBufferHandle (GST_VAAPI_OBJECT_VADISPLAY (proxy->parent),
-      proxy->va_buf);
+  GST_VAAPI_PROFILER_CALL (va_status,
+      GST_VAAPI_OBJECT_VADISPLAY (proxy->parent), VA_INVALID_ID,
+      RELEASE_BUFFER_HANDLE, 0,
+      vaReleaseBufferHandle (GST_VAAPI_OBJECT_VADISPLAY (proxy->parent),
+          proxy->va_buf));
   GST_VAAPI_OBJECT_UNLOCK_DISPLAY (proxy->parent);
   if (!vaapi_check_status (va_status, "vaReleaseBufferHandle()"))
     return FALSE;
@@ -0,0 +1,191 @@
+/*
+ *  gstvaapicapscache.c - Memoized caps shared by elements
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapicapscache
+ * @short_description: Memoized caps shared by elements
+ *
+ * A #GstVaapiCapsCache keeps the caps elements derive from the
+ * capabilities of a VA display, e.g. the allowed pad caps built from
+ * the decode profiles or the image formats, so that they are built
+ * once per display instead of once per element instance and
+ * renegotiation. Caps are indexed by the element kind they were built
+ * for, and by the features, e.g. DMABuf support, they depend on.
+ *
+ * Memoized caps are shared, and thus must never be modified.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapicapscache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+struct _GstVaapiCapsCache
+{
+  GMutex mutex;
+  GHashTable *caps;
+  guint64 num_hits;
+  guint64 num_misses;
+};
+
+/**
+ * gst_vaapi_caps_cache_new:
+ *
+ * Creates a new, empty, #GstVaapiCapsCache.
+ *
+ * Return value: the newly allocated #GstVaapiCapsCache
+ */
+GstVaapiCapsCache *
+gst_vaapi_caps_cache_new (void)
+{
+  GstVaapiCapsCache *cache;
+
+  cache = g_slice_new (GstVaapiCapsCache);
+  g_mutex_init (&cache->mutex);
+  cache->caps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) gst_caps_unref);
+  cache->num_hits = 0;
+  cache->num_misses = 0;
+  return cache;
+}
+
+/**
+ * gst_vaapi_caps_cache_free:
+ * @cache: a #GstVaapiCapsCache
+ *
+ * Destroys @cache, releasing the memoized caps.
+ */
+void
+gst_vaapi_caps_cache_free (GstVaapiCapsCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_hash_table_unref (cache->caps);
+  g_mutex_clear (&cache->mutex);
+  g_slice_free (GstVaapiCapsCache, cache);
+}
+
+/**
+ * gst_vaapi_caps_cache_get:
+ * @cache: a #GstVaapiCapsCache
+ * @kind: the element kind, e.g. "vaapidecode-sink"
+ * @features: (allow-none): the features the caps depend on
+ * @func: the function building the caps
+ * @user_data: data to pass to @func
+ *
+ * Retrieves the caps memoized for @kind and @features, calling @func
+ * to build them on first use. @func is called without any lock held,
+ * and if several threads build the same caps concurrently, the first
+ * caps built win.
+ *
+ * This function is thread safe.
+ *
+ * Return value: (transfer full): the memoized #GstCaps, or %NULL if
+ *   @func failed
+ */
+GstCaps *
+gst_vaapi_caps_cache_get (GstVaapiCapsCache * cache, const gchar * kind,
+    const gchar * features, GstVaapiCapsCacheFunc func, gpointer user_data)
+{
+  GstCaps *caps, *cached_caps;
+  gchar *key;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (kind != NULL, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  key = g_strdup_printf ("%s/%s", kind, features ? features : "");
+
+  g_mutex_lock (&cache->mutex);
+  cached_caps = g_hash_table_lookup (cache->caps, key);
+  if (cached_caps) {
+    cache->num_hits++;
+    caps = gst_caps_ref (cached_caps);
+    g_mutex_unlock (&cache->mutex);
+    g_free (key);
+    return caps;
+  }
+  cache->num_misses++;
+  g_mutex_unlock (&cache->mutex);
+
+  caps = func (user_data);
+  if (!caps) {
+    g_free (key);
+    return NULL;
+  }
+  GST_DEBUG ("built %s caps: %" GST_PTR_FORMAT, key, caps);
+
+  g_mutex_lock (&cache->mutex);
+  cached_caps = g_hash_table_lookup (cache->caps, key);
+  if (cached_caps) {
+    gst_caps_replace (&caps, cached_caps);
+    g_free (key);
+  } else
+    g_hash_table_insert (cache->caps, key, gst_caps_ref (caps));
+  g_mutex_unlock (&cache->mutex);
+  return caps;
+}
+
+/**
+ * gst_vaapi_caps_cache_clear:
+ * @cache: a #GstVaapiCapsCache
+ *
+ * Releases all the memoized caps, e.g. because the capabilities they
+ * were derived from changed. Caps already handed out are not affected.
+ *
+ * This function is thread safe.
+ */
+void
+gst_vaapi_caps_cache_clear (GstVaapiCapsCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->mutex);
+  g_hash_table_remove_all (cache->caps);
+  g_mutex_unlock (&cache->mutex);
+}
+
+/**
+ * gst_vaapi_caps_cache_get_stats:
+ * @cache: a #GstVaapiCapsCache
+ * @num_hits_ptr: (out) (allow-none): return location for the number of
+ *   lookups served from the cache
+ * @num_misses_ptr: (out) (allow-none): return location for the number
+ *   of lookups that had to build caps
+ *
+ * Retrieves the @cache statistics.
+ *
+ * This function is thread safe.
+ */
+void
+gst_vaapi_caps_cache_get_stats (GstVaapiCapsCache * cache,
+    guint64 * num_hits_ptr, guint64 * num_misses_ptr)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->mutex);
+  if (num_hits_ptr)
+    *num_hits_ptr = cache->num_hits;
+  if (num_misses_ptr)
+    *num_misses_ptr = cache->num_misses;
+  g_mutex_unlock (&cache->mutex);
+}
@@ -0,0 +1,64 @@
+/*
+ *  gstvaapicapscache.h - Memoized caps shared by elements
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_CAPS_CACHE_H
+#define GST_VAAPI_CAPS_CACHE_H
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapidisplay.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiCapsCache GstVaapiCapsCache;
+
+/**
+ * GstVaapiCapsCacheFunc:
+ * @user_data: the data passed to gst_vaapi_caps_cache_get()
+ *
+ * Builds the caps to memoize.
+ *
+ * Return value: (transfer full): the new #GstCaps, or %NULL on failure
+ */
+typedef GstCaps *(*GstVaapiCapsCacheFunc) (gpointer user_data);
+
+GstVaapiCapsCache *
+gst_vaapi_caps_cache_new (void);
+
+void
+gst_vaapi_caps_cache_free (GstVaapiCapsCache * cache);
+
+GstCaps *
+gst_vaapi_caps_cache_get (GstVaapiCapsCache * cache, const gchar * kind,
+    const gchar * features, GstVaapiCapsCacheFunc func, gpointer user_data);
+
+void
+gst_vaapi_caps_cache_clear (GstVaapiCapsCache * cache);
+
+void
+gst_vaapi_caps_cache_get_stats (GstVaapiCapsCache * cache,
+    guint64 * num_hits_ptr, guint64 * num_misses_ptr);
+
+GstVaapiCapsCache *
+gst_vaapi_display_get_caps_cache (GstVaapiDisplay * display);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_CAPS_CACHE_H */
@@ -38,11 +38,11 @@ coded_buffer_create (GstVaapiCodedBuffer * buf, guint buf_size,
   VABufferID buf_id;
   gboolean success;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
   success = vaapi_create_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_OBJECT_ID (context), VAEncCodedBufferType, buf_size, NULL,
       &buf_id, NULL);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!success)
     return FALSE;
 
@@ -61,9 +61,9 @@ coded_buffer_destroy (GstVaapiCodedBuffer * buf)
   GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (buf_id));
 
   if (buf_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
     vaapi_destroy_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display), &buf_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
     GST_VAAPI_OBJECT_ID (buf) = VA_INVALID_ID;
   }
 }
@@ -71,14 +71,20 @@ coded_buffer_destroy (GstVaapiCodedBuffer * buf)
 static gboolean
 coded_buffer_map (GstVaapiCodedBuffer * buf)
 {
-  if (buf->segment_list)
+  if (buf->segment_list) {
+    buf->map_count++;
     return TRUE;
+  }
 
-  GST_VAAPI_OBJECT_LOCK_DISPLAY (buf);
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (GST_VAAPI_OBJECT_DISPLAY (buf));
   buf->segment_list = vaapi_map_buffer (GST_VAAPI_OBJECT_VADISPLAY (buf),
       GST_VAAPI_OBJECT_ID (buf));
-  GST_VAAPI_OBJECT_UNLOCK_DISPLAY (buf);
-  return buf->segment_list != NULL;
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (GST_VAAPI_OBJECT_DISPLAY (buf));
+  if (!buf->segment_list)
+    return FALSE;
+
+  buf->map_count = 1;
+  return TRUE;
 }
 
 static void
@@ -87,10 +93,14 @@ coded_buffer_unmap (GstVaapiCodedBuffer * buf)
   if (!buf->segment_list)
     return;
 
-  GST_VAAPI_OBJECT_LOCK_DISPLAY (buf);
+  /* Keep the mapping alive while other users still reference it */
+  if (--buf->map_count > 0)
+    return;
+
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (GST_VAAPI_OBJECT_DISPLAY (buf));
   vaapi_unmap_buffer (GST_VAAPI_OBJECT_VADISPLAY (buf),
       GST_VAAPI_OBJECT_ID (buf), (void **) &buf->segment_list);
-  GST_VAAPI_OBJECT_UNLOCK_DISPLAY (buf);
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (GST_VAAPI_OBJECT_DISPLAY (buf));
 }
 
 /* *INDENT-OFF* */
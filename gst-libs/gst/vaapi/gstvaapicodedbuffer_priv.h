@@ -25,6 +25,7 @@
 #define GST_VAAPI_CODED_BUFFER_PRIV_H
 
 #include <gst/vaapi/gstvaapicontext.h>
+#include <gst/vaapi/gstvaapivideopool.h>
 #include "gstvaapicodedbuffer.h"
 #include "gstvaapiobject_priv.h"
 
@@ -47,6 +48,7 @@ struct _GstVaapiCodedBuffer
 
   GstVaapiContext      *context;
   VACodedBufferSegment *segment_list;
+  guint                 map_count;
 };
 
 /**
@@ -73,6 +75,11 @@ G_GNUC_INTERNAL
 void
 gst_vaapi_coded_buffer_unmap (GstVaapiCodedBuffer * buf);
 
+G_GNUC_INTERNAL
+GstVaapiVideoPool *
+gst_vaapi_coded_buffer_pool_new_with_context (GstVaapiContext * context,
+    gsize buf_size);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_PRIV_H */
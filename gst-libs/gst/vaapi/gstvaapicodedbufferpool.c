@@ -92,14 +92,31 @@ gst_vaapi_coded_buffer_pool_class (void)
 GstVaapiVideoPool *
 gst_vaapi_coded_buffer_pool_new (GstVaapiEncoder * encoder, gsize buf_size)
 {
-  GstVaapiVideoPool *pool;
-  GstVaapiContext *context;
-
   g_return_val_if_fail (encoder != NULL, NULL);
-  g_return_val_if_fail (buf_size > 0, NULL);
 
-  context = GST_VAAPI_ENCODER_CONTEXT (encoder);
+  return gst_vaapi_coded_buffer_pool_new_with_context
+      (GST_VAAPI_ENCODER_CONTEXT (encoder), buf_size);
+}
+
+/**
+ * gst_vaapi_coded_buffer_pool_new_with_context:
+ * @context: a #GstVaapiContext
+ * @buf_size: the max size of #GstVaapiCodedBuffer objects, in bytes
+ *
+ * Creates a new #GstVaapiVideoPool of #GstVaapiCodedBuffer objects
+ * with the supplied maximum size in bytes, and bound to the specified
+ * VA @context.
+ *
+ * Return value: the newly allocated #GstVaapiVideoPool
+ */
+GstVaapiVideoPool *
+gst_vaapi_coded_buffer_pool_new_with_context (GstVaapiContext * context,
+    gsize buf_size)
+{
+  GstVaapiVideoPool *pool;
+
   g_return_val_if_fail (context != NULL, NULL);
+  g_return_val_if_fail (buf_size > 0, NULL);
 
   pool = (GstVaapiVideoPool *)
       gst_vaapi_mini_object_new (gst_vaapi_coded_buffer_pool_class ());
@@ -254,3 +254,61 @@ gst_vaapi_coded_buffer_proxy_set_user_data (GstVaapiCodedBufferProxy * proxy,
 
   coded_buffer_proxy_set_user_data (proxy, user_data, destroy_func);
 }
+
+/**
+ * gst_vaapi_coded_buffer_proxy_map:
+ * @proxy: a #GstVaapiCodedBufferProxy
+ * @out_segment_list_ptr: return location for the mapped
+ *   VACodedBufferSegment list
+ *
+ * Maps the underlying VA coded buffer and returns its list of coded
+ * segments into @out_segment_list_ptr. The mapping is reference
+ * counted and stays valid until the matching call to
+ * gst_vaapi_coded_buffer_proxy_unmap(). As long as it is mapped, the
+ * coded buffer shall not be returned to its parent pool, i.e. the
+ * caller must also hold a reference to @proxy.
+ *
+ * Return value: %TRUE if successful, %FALSE otherwise
+ */
+gboolean
+gst_vaapi_coded_buffer_proxy_map (GstVaapiCodedBufferProxy * proxy,
+    VACodedBufferSegment ** out_segment_list_ptr)
+{
+  g_return_val_if_fail (proxy != NULL, FALSE);
+  g_return_val_if_fail (proxy->buffer != NULL, FALSE);
+
+  return gst_vaapi_coded_buffer_map (proxy->buffer, out_segment_list_ptr);
+}
+
+/**
+ * gst_vaapi_coded_buffer_proxy_unmap:
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Releases a mapping previously obtained through
+ * gst_vaapi_coded_buffer_proxy_map().
+ */
+void
+gst_vaapi_coded_buffer_proxy_unmap (GstVaapiCodedBufferProxy * proxy)
+{
+  g_return_if_fail (proxy != NULL);
+  g_return_if_fail (proxy->buffer != NULL);
+
+  gst_vaapi_coded_buffer_unmap (proxy->buffer);
+}
+
+/**
+ * gst_vaapi_coded_buffer_proxy_get_pool:
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Returns the #GstVaapiVideoPool the underlying coded buffer was
+ * allocated from, if any. The returned pool is owned by @proxy.
+ *
+ * Return value: the parent #GstVaapiVideoPool, or %NULL
+ */
+GstVaapiVideoPool *
+gst_vaapi_coded_buffer_proxy_get_pool (GstVaapiCodedBufferProxy * proxy)
+{
+  g_return_val_if_fail (proxy != NULL, NULL);
+
+  return proxy->pool;
+}
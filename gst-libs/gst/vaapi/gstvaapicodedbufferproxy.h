@@ -77,6 +77,16 @@ void
 gst_vaapi_coded_buffer_proxy_set_user_data (GstVaapiCodedBufferProxy * proxy,
     gpointer user_data, GDestroyNotify destroy_func);
 
+gboolean
+gst_vaapi_coded_buffer_proxy_map (GstVaapiCodedBufferProxy * proxy,
+    VACodedBufferSegment ** out_segment_list_ptr);
+
+void
+gst_vaapi_coded_buffer_proxy_unmap (GstVaapiCodedBufferProxy * proxy);
+
+GstVaapiVideoPool *
+gst_vaapi_coded_buffer_proxy_get_pool (GstVaapiCodedBufferProxy * proxy);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CODED_BUFFER_PROXY_H */
@@ -39,6 +39,8 @@
 #include "gstvaapisurfaceproxy.h"
 #include "gstvaapivideopool_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
+#include "gstvaapirecorder.h"
 #include "gstvaapiutils_core.h"
 
 #define DEBUG 1
@@ -100,20 +102,27 @@ context_destroy (GstVaapiContext * context)
   GST_DEBUG ("context 0x%08x", context_id);
 
   if (context_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
-    status = vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
-        context_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    if (GST_VAAPI_RECORDER_IS_ENABLED ())
+      gst_vaapi_recorder_destroy_context (GST_VAAPI_DISPLAY_VADISPLAY
+          (display), context_id);
+
+    GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+    GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+        context_id, DESTROY_CONTEXT, 0,
+        vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (display), context_id));
+    GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
     if (!vaapi_check_status (status, "vaDestroyContext()"))
       GST_WARNING ("failed to destroy context 0x%08x", context_id);
     GST_VAAPI_OBJECT_ID (context) = VA_INVALID_ID;
   }
 
   if (context->va_config != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
-    status = vaDestroyConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
-        context->va_config);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+    GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+        VA_INVALID_ID, DESTROY_CONFIG, 0,
+        vaDestroyConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
+            context->va_config));
+    GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
     if (!vaapi_check_status (status, "vaDestroyConfig()"))
       GST_WARNING ("failed to destroy config 0x%08x", context->va_config);
     context->va_config = VA_INVALID_ID;
@@ -130,12 +139,19 @@ context_ensure_surfaces (GstVaapiContext * context)
 {
   const GstVaapiContextInfo *const cip = &context->info;
   const guint num_surfaces = cip->ref_frames + SCRATCH_SURFACES_COUNT;
+  GstVaapiSurfaceRecyclerKey key;
   GstVaapiSurface *surface;
   guint i;
 
+  key.chroma_type = cip->chroma_type;
+  key.format = GST_VIDEO_FORMAT_UNKNOWN;
+  key.width = cip->width;
+  key.height = cip->height;
+  key.flags = 0;
+
   for (i = context->surfaces->len; i < num_surfaces; i++) {
-    surface = gst_vaapi_surface_new (GST_VAAPI_OBJECT_DISPLAY (context),
-        cip->chroma_type, cip->width, cip->height);
+    surface = gst_vaapi_surface_new_recyclable (GST_VAAPI_OBJECT_DISPLAY
+        (context), &key);
     if (!surface)
       return FALSE;
     gst_vaapi_surface_set_parent_context (surface, context);
@@ -206,14 +222,21 @@ context_create (GstVaapiContext * context)
   }
   g_assert (surfaces->len == context->surfaces->len);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      context->va_config, cip->width, cip->height, VA_PROGRESSIVE,
-      (VASurfaceID *) surfaces->data, surfaces->len, &context_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      context_id, CREATE_CONTEXT, 0,
+      vaCreateContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          context->va_config, cip->width, cip->height, VA_PROGRESSIVE,
+          (VASurfaceID *) surfaces->data, surfaces->len, &context_id));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaCreateContext()"))
     goto cleanup;
 
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_create_context (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        context_id, context->va_config, cip->width, cip->height,
+        VA_PROGRESSIVE, (VASurfaceID *) surfaces->data, surfaces->len);
+
   GST_DEBUG ("context 0x%08x", context_id);
   GST_VAAPI_OBJECT_ID (context) = context_id;
   success = TRUE;
@@ -307,14 +330,21 @@ config_create (GstVaapiContext * context)
       break;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      context->va_profile, context->va_entrypoint, attribs, attrib - attribs,
-      &context->va_config);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, CREATE_CONFIG, 0,
+      vaCreateConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          context->va_profile, context->va_entrypoint, attribs,
+          attrib - attribs, &context->va_config));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaCreateConfig()"))
     goto cleanup;
 
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_create_config (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        context->va_config, context->va_profile, context->va_entrypoint,
+        attribs, attrib - attribs);
+
   return TRUE;
 cleanup:
   GST_WARNING ("Failed to create vaConfig");
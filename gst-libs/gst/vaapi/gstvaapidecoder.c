@@ -34,6 +34,7 @@
 #include "gstvaapiparser_frame.h"
 #include "gstvaapisurfaceproxy_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapitiming.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -131,6 +132,7 @@ do_parse (GstVaapiDecoder * decoder,
   GstVaapiParserFrame *frame;
   GstVaapiDecoderUnit *unit;
   GstVaapiDecoderStatus status;
+  GstClockTime start;
 
   *got_unit_size_ptr = 0;
   *got_frame_ptr = FALSE;
@@ -156,8 +158,10 @@ do_parse (GstVaapiDecoder * decoder,
   gst_vaapi_decoder_unit_init (unit);
 
   ps->current_frame = base_frame;
+  start = GST_VAAPI_TIMING_BEGIN ();
   status = GST_VAAPI_DECODER_GET_CLASS (decoder)->parse (decoder,
       adapter, at_eos, unit);
+  GST_VAAPI_TIMING_END (GST_VAAPI_TIMING_STAGE_PARSE, start);
   if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
     if (at_eos && frame->units->len > 0 &&
         status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
@@ -30,6 +30,9 @@
 #include "gstvaapisurfaceproxy_priv.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapitiming.h"
+#include "gstvaapiprofiler.h"
+#include "gstvaapirecorder.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -233,7 +236,11 @@ do_decode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
 
   vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
 
-  status = vaRenderPicture (dpy, ctx, buf_id, 1);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_render_picture (dpy, ctx, buf_id, 1);
+
+  GST_VAAPI_PROFILER_CALL (status, dpy, ctx, RENDER_PICTURE, 0,
+      vaRenderPicture (dpy, ctx, buf_id, 1));
   if (!vaapi_check_status (status, "vaRenderPicture()"))
     return FALSE;
 
@@ -245,6 +252,7 @@ do_decode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
 gboolean
 gst_vaapi_picture_decode (GstVaapiPicture * picture)
 {
+  const GstClockTime start = GST_VAAPI_TIMING_BEGIN ();
   GstVaapiIqMatrix *iq_matrix;
   GstVaapiBitPlane *bitplane;
   GstVaapiHuffmanTable *huf_table;
@@ -261,7 +269,12 @@ gst_vaapi_picture_decode (GstVaapiPicture * picture)
 
   GST_DEBUG ("decode picture 0x%08x", picture->surface_id);
 
-  status = vaBeginPicture (va_display, va_context, picture->surface_id);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_begin_picture (va_display, va_context,
+        picture->surface_id);
+
+  GST_VAAPI_PROFILER_CALL (status, va_display, va_context, BEGIN_PICTURE, 0,
+      vaBeginPicture (va_display, va_context, picture->surface_id));
   if (!vaapi_check_status (status, "vaBeginPicture()"))
     return FALSE;
 
@@ -301,7 +314,12 @@ gst_vaapi_picture_decode (GstVaapiPicture * picture)
     va_buffers[0] = slice->param_id;
     va_buffers[1] = slice->data_id;
 
-    status = vaRenderPicture (va_display, va_context, va_buffers, 2);
+    if (GST_VAAPI_RECORDER_IS_ENABLED ())
+      gst_vaapi_recorder_render_picture (va_display, va_context, va_buffers,
+          2);
+
+    GST_VAAPI_PROFILER_CALL (status, va_display, va_context, RENDER_PICTURE, 0,
+        vaRenderPicture (va_display, va_context, va_buffers, 2));
     if (!vaapi_check_status (status, "vaRenderPicture()"))
       return FALSE;
 
@@ -309,9 +327,15 @@ gst_vaapi_picture_decode (GstVaapiPicture * picture)
     vaapi_destroy_buffer (va_display, &slice->data_id);
   }
 
-  status = vaEndPicture (va_display, va_context);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_end_picture (va_display, va_context);
+
+  GST_VAAPI_PROFILER_CALL (status, va_display, va_context, END_PICTURE, 0,
+      vaEndPicture (va_display, va_context));
   if (!vaapi_check_status (status, "vaEndPicture()"))
     return FALSE;
+
+  GST_VAAPI_TIMING_END (GST_VAAPI_TIMING_STAGE_DECODE, start);
   return TRUE;
 }
 
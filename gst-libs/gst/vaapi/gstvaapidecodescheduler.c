@@ -0,0 +1,476 @@
+/*
+ *  gstvaapidecodescheduler.c - Decode jobs scheduler shared by streams
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapidecodescheduler
+ * @short_description: Decode jobs scheduler shared by streams
+ *
+ * A #GstVaapiDecodeScheduler runs the decode jobs of many streams on
+ * a fixed pool of worker threads. Each worker picks a batch of jobs
+ * from distinct streams, and runs them in a row. An optional lock
+ * function is called around each batch. Without a lock function, a
+ * worker only takes more than one job when there are more ready jobs
+ * than idle workers, so that batching saves wake-ups and scheduler
+ * lock round-trips without ever leaving a worker idle.
+ *
+ * Jobs of a given stream are run in submission order, one at a time.
+ * Across streams, the job with the earliest deadline is picked first,
+ * and streams with equal deadlines are served in a round-robin
+ * fashion. A stream may submit a job and carry on with other work,
+ * e.g. pushing the frames decoded so far, until it waits for the job.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapidecodescheduler.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct
+{
+  GList link;                   /* in stream->jobs, then stream->done_jobs */
+  gpointer data;
+  gint64 deadline;
+  GstVaapiDecoderStatus status;
+} Job;
+
+struct _GstVaapiDecodeSchedulerStream
+{
+  GList link;                   /* in scheduler->ready_streams, if ready */
+  GstVaapiDecodeScheduler *scheduler;
+  GstVaapiDecodeSchedulerFunc func;
+  gpointer data;
+  GQueue jobs;                  /* head is the running or next job */
+  GQueue done_jobs;             /* jobs not waited for yet */
+  GCond done_cond;
+  gboolean is_ready;
+  gboolean is_busy;
+};
+
+struct _GstVaapiDecodeScheduler
+{
+  GMutex mutex;
+  GCond work_cond;
+  GThread **workers;
+  guint num_workers;
+  guint max_batch_size;
+  GstVaapiDecodeSchedulerLockFunc lock_func;
+  GstVaapiDecodeSchedulerLockFunc unlock_func;
+  gpointer user_data;
+  GQueue ready_streams;         /* streams with a job ready to run */
+  guint num_idle_workers;
+  gboolean shutdown;
+  GstVaapiDecodeSchedulerStats stats;
+};
+
+/* Queues @stream for its next job, if it has one and none is running */
+static void
+stream_update_ready (GstVaapiDecodeSchedulerStream * stream)
+{
+  GstVaapiDecodeScheduler *const scheduler = stream->scheduler;
+
+  if (stream->is_ready || stream->is_busy || g_queue_is_empty (&stream->jobs))
+    return;
+
+  g_queue_push_tail_link (&scheduler->ready_streams, &stream->link);
+  stream->is_ready = TRUE;
+  g_cond_signal (&scheduler->work_cond);
+}
+
+/* Dequeues the ready stream whose next job has the earliest deadline */
+static GstVaapiDecodeSchedulerStream *
+scheduler_pop_stream (GstVaapiDecodeScheduler * scheduler)
+{
+  GstVaapiDecodeSchedulerStream *stream, *best_stream = NULL;
+  gint64 best_deadline = 0;
+  Job *job;
+  GList *l;
+
+  for (l = scheduler->ready_streams.head; l != NULL; l = l->next) {
+    stream = l->data;
+    job = stream->jobs.head->data;
+    if (!best_stream || job->deadline < best_deadline) {
+      best_stream = stream;
+      best_deadline = job->deadline;
+    }
+  }
+  if (!best_stream)
+    return NULL;
+
+  g_queue_unlink (&scheduler->ready_streams, &best_stream->link);
+  best_stream->is_ready = FALSE;
+  best_stream->is_busy = TRUE;
+  return best_stream;
+}
+
+static gpointer
+worker_thread (gpointer data)
+{
+  GstVaapiDecodeScheduler *const scheduler = data;
+  GstVaapiDecodeSchedulerStream **streams;
+  GstVaapiDecodeSchedulerStream *stream;
+  Job *job;
+  gint64 now;
+  guint i, num_jobs;
+
+  streams = g_new (GstVaapiDecodeSchedulerStream *, scheduler->max_batch_size);
+
+  g_mutex_lock (&scheduler->mutex);
+  for (;;) {
+    scheduler->num_idle_workers++;
+    while (!scheduler->shutdown && g_queue_is_empty (&scheduler->ready_streams))
+      g_cond_wait (&scheduler->work_cond, &scheduler->mutex);
+    scheduler->num_idle_workers--;
+    if (scheduler->shutdown)
+      break;
+
+    /* Jobs the idle workers can take are left to them, unless the
+       batch amortizes a lock */
+    num_jobs = 0;
+    do {
+      stream = scheduler_pop_stream (scheduler);
+      if (!stream)
+        break;
+      streams[num_jobs++] = stream;
+    } while (num_jobs < scheduler->max_batch_size && (scheduler->lock_func ||
+            scheduler->ready_streams.length > scheduler->num_idle_workers));
+
+    now = g_get_monotonic_time ();
+    for (i = 0; i < num_jobs; i++) {
+      job = streams[i]->jobs.head->data;
+      if (job->deadline < now)
+        scheduler->stats.num_deadline_misses++;
+    }
+    scheduler->stats.queue_depth -= num_jobs;
+    scheduler->stats.num_jobs += num_jobs;
+    scheduler->stats.num_batches++;
+    g_mutex_unlock (&scheduler->mutex);
+
+    if (scheduler->lock_func)
+      scheduler->lock_func (scheduler->user_data);
+    for (i = 0; i < num_jobs; i++) {
+      job = streams[i]->jobs.head->data;
+      job->status = streams[i]->func (streams[i]->data, job->data);
+    }
+    if (scheduler->unlock_func)
+      scheduler->unlock_func (scheduler->user_data);
+
+    g_mutex_lock (&scheduler->mutex);
+    for (i = 0; i < num_jobs; i++) {
+      stream = streams[i];
+      job = stream->jobs.head->data;
+      g_queue_unlink (&stream->jobs, &job->link);
+      g_queue_push_tail_link (&stream->done_jobs, &job->link);
+      stream->is_busy = FALSE;
+      stream_update_ready (stream);
+      g_cond_signal (&stream->done_cond);
+    }
+  }
+  g_mutex_unlock (&scheduler->mutex);
+
+  g_free (streams);
+  return NULL;
+}
+
+/**
+ * gst_vaapi_decode_scheduler_new:
+ * @num_workers: the number of worker threads
+ * @max_batch_size: the maximum number of jobs run in a row by a worker
+ * @lock_func: (allow-none): the function called before running a batch
+ * @unlock_func: (allow-none): the function called after running a batch
+ * @user_data: the data passed to @lock_func and @unlock_func
+ *
+ * Creates a new #GstVaapiDecodeScheduler, with @num_workers threads
+ * running the jobs submitted by its streams.
+ *
+ * Note that the jobs of distinct streams run concurrently on distinct
+ * workers, unless @lock_func serializes them.
+ *
+ * Return value: the newly allocated #GstVaapiDecodeScheduler, or
+ *   %NULL on failure
+ */
+GstVaapiDecodeScheduler *
+gst_vaapi_decode_scheduler_new (guint num_workers, guint max_batch_size,
+    GstVaapiDecodeSchedulerLockFunc lock_func,
+    GstVaapiDecodeSchedulerLockFunc unlock_func, gpointer user_data)
+{
+  GstVaapiDecodeScheduler *scheduler;
+  GError *err = NULL;
+  gchar *name;
+  guint i;
+
+  g_return_val_if_fail (num_workers > 0, NULL);
+  g_return_val_if_fail (max_batch_size > 0, NULL);
+
+  scheduler = g_slice_new0 (GstVaapiDecodeScheduler);
+  if (!scheduler)
+    return NULL;
+
+  g_mutex_init (&scheduler->mutex);
+  g_cond_init (&scheduler->work_cond);
+  g_queue_init (&scheduler->ready_streams);
+  scheduler->max_batch_size = max_batch_size;
+  scheduler->lock_func = lock_func;
+  scheduler->unlock_func = unlock_func;
+  scheduler->user_data = user_data;
+
+  scheduler->workers = g_new0 (GThread *, num_workers);
+  for (i = 0; i < num_workers; i++) {
+    name = g_strdup_printf ("vaapi-decode-%u", i);
+    scheduler->workers[i] = g_thread_try_new (name, worker_thread, scheduler,
+        &err);
+    g_free (name);
+    if (!scheduler->workers[i])
+      goto error_create_thread;
+    scheduler->num_workers++;
+  }
+  return scheduler;
+
+  /* ERRORS */
+error_create_thread:
+  {
+    GST_ERROR ("failed to create worker thread: %s", err->message);
+    g_clear_error (&err);
+    gst_vaapi_decode_scheduler_free (scheduler);
+    return NULL;
+  }
+}
+
+/**
+ * gst_vaapi_decode_scheduler_free:
+ * @scheduler: a #GstVaapiDecodeScheduler
+ *
+ * Stops the worker threads and destroys @scheduler. All streams shall
+ * have been removed beforehand.
+ */
+void
+gst_vaapi_decode_scheduler_free (GstVaapiDecodeScheduler * scheduler)
+{
+  guint i;
+
+  if (!scheduler)
+    return;
+
+  g_mutex_lock (&scheduler->mutex);
+  g_warn_if_fail (scheduler->stats.num_streams == 0);
+  scheduler->shutdown = TRUE;
+  g_cond_broadcast (&scheduler->work_cond);
+  g_mutex_unlock (&scheduler->mutex);
+
+  for (i = 0; i < scheduler->num_workers; i++)
+    g_thread_join (scheduler->workers[i]);
+  g_free (scheduler->workers);
+
+  if (scheduler->stats.num_jobs > 0)
+    GST_DEBUG ("%" G_GUINT64_FORMAT " jobs run in %" G_GUINT64_FORMAT
+        " batches, %" G_GUINT64_FORMAT " past deadline, max queue depth %u",
+        scheduler->stats.num_jobs, scheduler->stats.num_batches,
+        scheduler->stats.num_deadline_misses,
+        scheduler->stats.max_queue_depth);
+
+  g_cond_clear (&scheduler->work_cond);
+  g_mutex_clear (&scheduler->mutex);
+  g_slice_free (GstVaapiDecodeScheduler, scheduler);
+}
+
+/**
+ * gst_vaapi_decode_scheduler_add_stream:
+ * @scheduler: a #GstVaapiDecodeScheduler
+ * @func: the function that runs the stream jobs
+ * @stream_data: the data passed to @func
+ *
+ * Registers a new stream, e.g. a decoder instance, to @scheduler.
+ *
+ * Return value: the newly allocated #GstVaapiDecodeSchedulerStream
+ */
+GstVaapiDecodeSchedulerStream *
+gst_vaapi_decode_scheduler_add_stream (GstVaapiDecodeScheduler * scheduler,
+    GstVaapiDecodeSchedulerFunc func, gpointer stream_data)
+{
+  GstVaapiDecodeSchedulerStream *stream;
+
+  g_return_val_if_fail (scheduler != NULL, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  stream = g_slice_new0 (GstVaapiDecodeSchedulerStream);
+  if (!stream)
+    return NULL;
+
+  stream->link.data = stream;
+  stream->scheduler = scheduler;
+  stream->func = func;
+  stream->data = stream_data;
+  g_queue_init (&stream->jobs);
+  g_queue_init (&stream->done_jobs);
+  g_cond_init (&stream->done_cond);
+
+  g_mutex_lock (&scheduler->mutex);
+  scheduler->stats.num_streams++;
+  g_mutex_unlock (&scheduler->mutex);
+  return stream;
+}
+
+/**
+ * gst_vaapi_decode_scheduler_remove_stream:
+ * @stream: a #GstVaapiDecodeSchedulerStream
+ *
+ * Unregisters @stream from its scheduler and destroys it. All jobs of
+ * @stream shall have been waited for.
+ */
+void
+gst_vaapi_decode_scheduler_remove_stream (GstVaapiDecodeSchedulerStream *
+    stream)
+{
+  GstVaapiDecodeScheduler *scheduler;
+
+  g_return_if_fail (stream != NULL);
+
+  scheduler = stream->scheduler;
+  g_mutex_lock (&scheduler->mutex);
+  g_warn_if_fail (g_queue_is_empty (&stream->jobs));
+  g_warn_if_fail (g_queue_is_empty (&stream->done_jobs));
+  scheduler->stats.num_streams--;
+  g_mutex_unlock (&scheduler->mutex);
+
+  g_cond_clear (&stream->done_cond);
+  g_slice_free (GstVaapiDecodeSchedulerStream, stream);
+}
+
+/**
+ * gst_vaapi_decode_scheduler_submit:
+ * @stream: a #GstVaapiDecodeSchedulerStream
+ * @job_data: the data passed to the @stream function
+ * @deadline: the monotonic time, in microseconds, the job should be
+ *   started by, or %GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE
+ *
+ * Submits a job on behalf of @stream, without waiting for it to run.
+ * Each submitted job shall be waited for with
+ * gst_vaapi_decode_scheduler_wait().
+ */
+void
+gst_vaapi_decode_scheduler_submit (GstVaapiDecodeSchedulerStream * stream,
+    gpointer job_data, gint64 deadline)
+{
+  GstVaapiDecodeScheduler *scheduler;
+  Job *job;
+
+  g_return_if_fail (stream != NULL);
+
+  scheduler = stream->scheduler;
+
+  job = g_slice_new0 (Job);
+  job->link.data = job;
+  job->data = job_data;
+  job->deadline = deadline;
+  job->status = GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+
+  g_mutex_lock (&scheduler->mutex);
+  g_queue_push_tail_link (&stream->jobs, &job->link);
+  scheduler->stats.queue_depth++;
+  if (scheduler->stats.max_queue_depth < scheduler->stats.queue_depth)
+    scheduler->stats.max_queue_depth = scheduler->stats.queue_depth;
+  stream_update_ready (stream);
+  g_mutex_unlock (&scheduler->mutex);
+}
+
+/**
+ * gst_vaapi_decode_scheduler_wait:
+ * @stream: a #GstVaapiDecodeSchedulerStream
+ * @job_data_ptr: (allow-none): return location for the job data
+ *
+ * Waits for the oldest job submitted by @stream, and not waited for
+ * yet, to be run.
+ *
+ * Return value: the status returned by the @stream function, or
+ *   %GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER if no job was
+ *   pending
+ */
+GstVaapiDecoderStatus
+gst_vaapi_decode_scheduler_wait (GstVaapiDecodeSchedulerStream * stream,
+    gpointer * job_data_ptr)
+{
+  GstVaapiDecodeScheduler *scheduler;
+  GstVaapiDecoderStatus status;
+  Job *job = NULL;
+
+  g_return_val_if_fail (stream != NULL,
+      GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
+
+  scheduler = stream->scheduler;
+
+  g_mutex_lock (&scheduler->mutex);
+  while (g_queue_is_empty (&stream->done_jobs) &&
+      !g_queue_is_empty (&stream->jobs))
+    g_cond_wait (&stream->done_cond, &scheduler->mutex);
+  if (!g_queue_is_empty (&stream->done_jobs)) {
+    job = stream->done_jobs.head->data;
+    g_queue_unlink (&stream->done_jobs, &job->link);
+  }
+  g_mutex_unlock (&scheduler->mutex);
+
+  if (!job)
+    return GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER;
+
+  if (job_data_ptr)
+    *job_data_ptr = job->data;
+  status = job->status;
+  g_slice_free (Job, job);
+  return status;
+}
+
+/**
+ * gst_vaapi_decode_scheduler_run:
+ * @stream: a #GstVaapiDecodeSchedulerStream
+ * @job_data: the data passed to the @stream function
+ * @deadline: the monotonic time, in microseconds, the job should be
+ *   started by, or %GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE
+ *
+ * Submits a job on behalf of @stream, and waits for a worker thread
+ * to run it. No other job of @stream shall be pending.
+ *
+ * Return value: the status returned by the @stream function
+ */
+GstVaapiDecoderStatus
+gst_vaapi_decode_scheduler_run (GstVaapiDecodeSchedulerStream * stream,
+    gpointer job_data, gint64 deadline)
+{
+  gst_vaapi_decode_scheduler_submit (stream, job_data, deadline);
+  return gst_vaapi_decode_scheduler_wait (stream, NULL);
+}
+
+/**
+ * gst_vaapi_decode_scheduler_get_stats:
+ * @scheduler: a #GstVaapiDecodeScheduler
+ * @stats: return location for the statistics
+ *
+ * Retrieves the @scheduler statistics.
+ */
+void
+gst_vaapi_decode_scheduler_get_stats (GstVaapiDecodeScheduler * scheduler,
+    GstVaapiDecodeSchedulerStats * stats)
+{
+  g_return_if_fail (scheduler != NULL);
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&scheduler->mutex);
+  *stats = scheduler->stats;
+  g_mutex_unlock (&scheduler->mutex);
+}
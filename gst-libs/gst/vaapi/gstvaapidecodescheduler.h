@@ -0,0 +1,120 @@
+/*
+ *  gstvaapidecodescheduler.h - Decode jobs scheduler shared by streams
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DECODE_SCHEDULER_H
+#define GST_VAAPI_DECODE_SCHEDULER_H
+
+#include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapidecoder.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiDecodeScheduler GstVaapiDecodeScheduler;
+typedef struct _GstVaapiDecodeSchedulerStream GstVaapiDecodeSchedulerStream;
+typedef struct _GstVaapiDecodeSchedulerStats GstVaapiDecodeSchedulerStats;
+
+/**
+ * GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE:
+ *
+ * The deadline of jobs that may be run at any time.
+ */
+#define GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE G_MAXINT64
+
+/**
+ * GstVaapiDecodeSchedulerFunc:
+ * @stream_data: the data the stream was added with
+ * @job_data: the data the job was submitted with
+ *
+ * Runs a job, e.g. decodes a frame, on behalf of a stream.
+ *
+ * Return value: the job status
+ */
+typedef GstVaapiDecoderStatus (*GstVaapiDecodeSchedulerFunc) (
+    gpointer stream_data, gpointer job_data);
+
+/**
+ * GstVaapiDecodeSchedulerLockFunc:
+ * @user_data: the data passed to gst_vaapi_decode_scheduler_new()
+ *
+ * Acquires or releases the resource shared by all jobs, e.g. the VA
+ * display lock.
+ */
+typedef void (*GstVaapiDecodeSchedulerLockFunc) (gpointer user_data);
+
+/**
+ * GstVaapiDecodeSchedulerStats:
+ * @num_streams: the number of streams
+ * @queue_depth: the number of jobs waiting for a worker
+ * @max_queue_depth: the highest @queue_depth so far
+ * @num_jobs: the number of jobs run so far
+ * @num_batches: the number of batches the jobs were run in
+ * @num_deadline_misses: the number of jobs started past their deadline
+ *
+ * The #GstVaapiDecodeScheduler statistics.
+ */
+struct _GstVaapiDecodeSchedulerStats
+{
+  guint num_streams;
+  guint queue_depth;
+  guint max_queue_depth;
+  guint64 num_jobs;
+  guint64 num_batches;
+  guint64 num_deadline_misses;
+};
+
+GstVaapiDecodeScheduler *
+gst_vaapi_decode_scheduler_new (guint num_workers, guint max_batch_size,
+    GstVaapiDecodeSchedulerLockFunc lock_func,
+    GstVaapiDecodeSchedulerLockFunc unlock_func, gpointer user_data);
+
+void
+gst_vaapi_decode_scheduler_free (GstVaapiDecodeScheduler * scheduler);
+
+GstVaapiDecodeSchedulerStream *
+gst_vaapi_decode_scheduler_add_stream (GstVaapiDecodeScheduler * scheduler,
+    GstVaapiDecodeSchedulerFunc func, gpointer stream_data);
+
+void
+gst_vaapi_decode_scheduler_remove_stream (GstVaapiDecodeSchedulerStream *
+    stream);
+
+void
+gst_vaapi_decode_scheduler_submit (GstVaapiDecodeSchedulerStream * stream,
+    gpointer job_data, gint64 deadline);
+
+GstVaapiDecoderStatus
+gst_vaapi_decode_scheduler_wait (GstVaapiDecodeSchedulerStream * stream,
+    gpointer * job_data_ptr);
+
+GstVaapiDecoderStatus
+gst_vaapi_decode_scheduler_run (GstVaapiDecodeSchedulerStream * stream,
+    gpointer job_data, gint64 deadline);
+
+void
+gst_vaapi_decode_scheduler_get_stats (GstVaapiDecodeScheduler * scheduler,
+    GstVaapiDecodeSchedulerStats * stats);
+
+GstVaapiDecodeScheduler *
+gst_vaapi_display_get_decode_scheduler (GstVaapiDisplay * display);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DECODE_SCHEDULER_H */
@@ -0,0 +1,227 @@
+/*
+ *  gstvaapideinterlacehistory.c - Deinterlacing reference history
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapideinterlacehistory
+ * @short_description: Deinterlacing reference history
+ *
+ * A #GstVaapiDeinterlaceHistory keeps the past input frames that
+ * advanced deinterlacing methods use as references. Losing them
+ * degrades the output to a single field interpolation for the next
+ * frames, so the history is only invalidated when the references no
+ * longer precede the current frame: on a discontinuity, when the
+ * timestamps go backwards, or when more than one frame is missing.
+ *
+ * Changes of field order, or renegotiations that keep the frame size
+ * and format, do not invalidate the history.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapideinterlacehistory.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* The largest gap between two references, in frame durations, that
+   still tolerates a single missing frame */
+#define MAX_GAP_NUM     5
+#define MAX_GAP_DENOM   2
+
+/**
+ * gst_vaapi_deinterlace_history_init:
+ * @history: a #GstVaapiDeinterlaceHistory
+ *
+ * Initializes @history as empty, with an unknown frame duration.
+ */
+void
+gst_vaapi_deinterlace_history_init (GstVaapiDeinterlaceHistory * history)
+{
+  g_return_if_fail (history != NULL);
+
+  memset (history, 0, sizeof (*history));
+  history->last_pts = GST_CLOCK_TIME_NONE;
+}
+
+/**
+ * gst_vaapi_deinterlace_history_clear:
+ * @history: a #GstVaapiDeinterlaceHistory
+ *
+ * Releases all the references, and resets @history to its initial
+ * state, e.g. when the stream stops.
+ */
+void
+gst_vaapi_deinterlace_history_clear (GstVaapiDeinterlaceHistory * history)
+{
+  guint i;
+
+  g_return_if_fail (history != NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (history->buffers); i++)
+    gst_buffer_replace (&history->buffers[i], NULL);
+  gst_vaapi_deinterlace_history_init (history);
+}
+
+/**
+ * gst_vaapi_deinterlace_history_invalidate:
+ * @history: a #GstVaapiDeinterlaceHistory
+ *
+ * Releases all the references, because they can no longer be used
+ * with the next frames, e.g. since the frame size changed. The frame
+ * duration is kept.
+ */
+void
+gst_vaapi_deinterlace_history_invalidate (GstVaapiDeinterlaceHistory * history)
+{
+  guint i;
+
+  g_return_if_fail (history != NULL);
+
+  if (history->num_buffers > 0) {
+    GST_DEBUG ("invalidate %u references", history->num_buffers);
+    history->num_invalidations++;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (history->buffers); i++) {
+    gst_buffer_replace (&history->buffers[i], NULL);
+    history->surfaces[i] = NULL;
+  }
+  history->index = 0;
+  history->num_buffers = 0;
+  history->last_pts = GST_CLOCK_TIME_NONE;
+}
+
+/**
+ * gst_vaapi_deinterlace_history_set_frame_duration:
+ * @history: a #GstVaapiDeinterlaceHistory
+ * @frame_duration: the expected duration between two frames, or 0 if
+ *   unknown
+ *
+ * Sets the frame duration used to detect missing frames. If unknown,
+ * gaps in the timestamps never invalidate the history.
+ */
+void
+gst_vaapi_deinterlace_history_set_frame_duration (GstVaapiDeinterlaceHistory *
+    history, GstClockTime frame_duration)
+{
+  g_return_if_fail (history != NULL);
+
+  history->frame_duration =
+      GST_CLOCK_TIME_IS_VALID (frame_duration) ? frame_duration : 0;
+}
+
+/**
+ * gst_vaapi_deinterlace_history_check:
+ * @history: a #GstVaapiDeinterlaceHistory
+ * @buffer: the next input #GstBuffer
+ *
+ * Checks that the references in @history still precede @buffer, and
+ * invalidates them otherwise.
+ *
+ * Return value: %TRUE if the references were kept
+ */
+gboolean
+gst_vaapi_deinterlace_history_check (GstVaapiDeinterlaceHistory * history,
+    GstBuffer * buffer)
+{
+  GstClockTime pts, max_gap;
+
+  g_return_val_if_fail (history != NULL, FALSE);
+  g_return_val_if_fail (buffer != NULL, FALSE);
+
+  if (history->num_buffers == 0)
+    return TRUE;
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT))
+    goto invalidate;
+
+  pts = GST_BUFFER_PTS (buffer);
+  if (!GST_CLOCK_TIME_IS_VALID (pts) ||
+      !GST_CLOCK_TIME_IS_VALID (history->last_pts))
+    return TRUE;
+
+  if (pts < history->last_pts)
+    goto invalidate;
+
+  if (history->frame_duration > 0) {
+    max_gap = gst_util_uint64_scale_int (history->frame_duration,
+        MAX_GAP_NUM, MAX_GAP_DENOM);
+    if (pts - history->last_pts > max_gap)
+      goto invalidate;
+  }
+  return TRUE;
+
+invalidate:
+  gst_vaapi_deinterlace_history_invalidate (history);
+  return FALSE;
+}
+
+/**
+ * gst_vaapi_deinterlace_history_push:
+ * @history: a #GstVaapiDeinterlaceHistory
+ * @buffer: the #GstBuffer to keep as reference
+ * @surface: the #GstVaapiSurface of @buffer
+ *
+ * Adds @buffer as the newest reference, replacing the oldest one if
+ * @history is full. @history holds a reference to @buffer, which is
+ * expected to keep @surface alive.
+ */
+void
+gst_vaapi_deinterlace_history_push (GstVaapiDeinterlaceHistory * history,
+    GstBuffer * buffer, GstVaapiSurface * surface)
+{
+  g_return_if_fail (history != NULL);
+  g_return_if_fail (buffer != NULL);
+  g_return_if_fail (surface != NULL);
+
+  gst_buffer_replace (&history->buffers[history->index], buffer);
+  history->surfaces[history->index] = surface;
+  history->index = (history->index + 1) % G_N_ELEMENTS (history->buffers);
+  if (history->num_buffers < G_N_ELEMENTS (history->buffers))
+    history->num_buffers++;
+
+  if (GST_CLOCK_TIME_IS_VALID (GST_BUFFER_PTS (buffer)))
+    history->last_pts = GST_BUFFER_PTS (buffer);
+}
+
+/**
+ * gst_vaapi_deinterlace_history_get_surfaces:
+ * @history: a #GstVaapiDeinterlaceHistory
+ * @surfaces: (out caller-allocates) (array): return location for at
+ *   most %GST_VAAPI_DEINTERLACE_MAX_REFERENCES surfaces
+ *
+ * Retrieves the reference surfaces, from the newest to the oldest.
+ *
+ * Return value: the number of surfaces stored in @surfaces
+ */
+guint
+gst_vaapi_deinterlace_history_get_surfaces (GstVaapiDeinterlaceHistory *
+    history, GstVaapiSurface ** surfaces)
+{
+  const guint n = G_N_ELEMENTS (history->buffers);
+  guint i;
+
+  g_return_val_if_fail (history != NULL, 0);
+  g_return_val_if_fail (surfaces != NULL, 0);
+
+  for (i = 0; i < history->num_buffers; i++)
+    surfaces[i] = history->surfaces[(history->index + n - i - 1) % n];
+  return history->num_buffers;
+}
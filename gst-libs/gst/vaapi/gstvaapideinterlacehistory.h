@@ -0,0 +1,97 @@
+/*
+ *  gstvaapideinterlacehistory.h - Deinterlacing reference history
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DEINTERLACE_HISTORY_H
+#define GST_VAAPI_DEINTERLACE_HISTORY_H
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapisurface.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GST_VAAPI_DEINTERLACE_MAX_REFERENCES:
+ *
+ * This represents the maximum number of VA surfaces we could keep as
+ * references for advanced deinterlacing.
+ *
+ * Note: if the upstream element is vaapidecode, then the maximum
+ * number of allowed surfaces used as references shall be less than
+ * the actual number of scratch surfaces used for decoding (4).
+ */
+#define GST_VAAPI_DEINTERLACE_MAX_REFERENCES 2
+
+typedef struct _GstVaapiDeinterlaceHistory GstVaapiDeinterlaceHistory;
+
+/**
+ * GstVaapiDeinterlaceHistory:
+ * @buffers: history buffers, maintained as a cyclic array
+ * @surfaces: the surfaces of @buffers, in the same slots
+ * @index: next free slot in the history
+ * @num_buffers: number of valid buffers in the history
+ * @last_pts: timestamp of the newest buffer in the history
+ * @frame_duration: expected duration between two buffers, or 0
+ * @num_invalidations: number of times the history was invalidated
+ *
+ * The past input frames used as references for advanced
+ * deinterlacing. The history is only invalidated when the continuity
+ * of the stream is broken. All fields are private.
+ */
+struct _GstVaapiDeinterlaceHistory
+{
+  /*< private >*/
+  GstBuffer *buffers[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
+  GstVaapiSurface *surfaces[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
+  guint index;
+  guint num_buffers;
+  GstClockTime last_pts;
+  GstClockTime frame_duration;
+  guint num_invalidations;
+};
+
+void
+gst_vaapi_deinterlace_history_init (GstVaapiDeinterlaceHistory * history);
+
+void
+gst_vaapi_deinterlace_history_clear (GstVaapiDeinterlaceHistory * history);
+
+void
+gst_vaapi_deinterlace_history_invalidate (GstVaapiDeinterlaceHistory * history);
+
+void
+gst_vaapi_deinterlace_history_set_frame_duration (
+    GstVaapiDeinterlaceHistory * history, GstClockTime frame_duration);
+
+gboolean
+gst_vaapi_deinterlace_history_check (GstVaapiDeinterlaceHistory * history,
+    GstBuffer * buffer);
+
+void
+gst_vaapi_deinterlace_history_push (GstVaapiDeinterlaceHistory * history,
+    GstBuffer * buffer, GstVaapiSurface * surface);
+
+guint
+gst_vaapi_deinterlace_history_get_surfaces (
+    GstVaapiDeinterlaceHistory * history, GstVaapiSurface ** surfaces);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DEINTERLACE_HISTORY_H */
@@ -29,10 +29,14 @@
 
 #include "sysdeps.h"
 #include <string.h>
+#include <sys/stat.h>
+#include <va/va_backend.h>
+#include <va/va_drmcommon.h>
 #include "gstvaapiutils.h"
 #include "gstvaapivalue.h"
 #include "gstvaapidisplay.h"
 #include "gstvaapitexturemap.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiworkarounds.h"
 
@@ -51,6 +55,18 @@ GST_DEBUG_CATEGORY (gst_debug_vaapi_display);
 G_DEFINE_TYPE_WITH_CODE (GstVaapiDisplay, gst_vaapi_display, GST_TYPE_OBJECT,
     _do_init);
 
+/* Surfaces released by surface pools are kept for reuse up to that
+   total size, and for that long at most */
+#define SURFACE_RECYCLER_MAX_SIZE (256 * 1024 * 1024)
+#define SURFACE_RECYCLER_MAX_IDLE_TIME (5 * G_TIME_SPAN_SECOND)
+
+/* Decode jobs of the streams sharing the display scheduler are run on
+   that many threads at most, in batches of that many jobs at most. No
+   lock is taken around them, so jobs are only batched when all the
+   workers are busy */
+#define DECODE_SCHEDULER_MAX_WORKERS 4
+#define DECODE_SCHEDULER_MAX_BATCH_SIZE 8
+
 /* Ensure those symbols are actually defined in the resulting libraries */
 #undef gst_vaapi_display_ref
 #undef gst_vaapi_display_unref
@@ -502,9 +518,351 @@ find_property_id (const gchar * name)
   return 0;
 }
 
+/* Display capabilities are queried from the VA driver until a query
+   succeeds and only read afterwards, so that queries do not need any
+   lock past the first successful one */
+enum
+{
+  CAPS_PROFILES = 1 << 0,
+  CAPS_PROPERTIES = 1 << 1,
+  CAPS_IMAGE_FORMATS = 1 << 2,
+  CAPS_SUBPICTURE_FORMATS = 1 << 3,
+  CAPS_VENDOR_STRING = 1 << 4,
+  CAPS_DRIVER_CACHE = 1 << 5,
+  CAPS_THREAD_SAFETY = 1 << 6,
+};
+
+typedef gboolean (*QueryCapsFunc) (GstVaapiDisplay * display);
+
+/* Called with the caps lock held. The capabilities are only marked
+   ready once queried successfully, so that a failed query is retried */
+static gboolean
+ensure_caps_unlocked (GstVaapiDisplay * display, guint caps,
+    QueryCapsFunc func)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  gint64 start_time;
+  gboolean success;
+
+  if (g_atomic_int_get (&priv->caps_ready) & caps)
+    return TRUE;
+
+  start_time = g_get_monotonic_time ();
+  success = func (display);
+  if (!success) {
+    GST_DEBUG_OBJECT (display, "failed to query capabilities 0x%x", caps);
+    return FALSE;
+  }
+
+  g_atomic_int_or (&priv->caps_ready, caps);
+  GST_DEBUG_OBJECT (display, "capabilities 0x%x ready in %" G_GINT64_FORMAT
+      " us", caps, g_get_monotonic_time () - start_time);
+  return TRUE;
+}
+
+static gboolean
+ensure_caps (GstVaapiDisplay * display, guint caps, QueryCapsFunc func)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  gboolean success;
+
+  if (g_atomic_int_get (&priv->caps_ready) & caps)
+    return TRUE;
+
+  g_mutex_lock (&priv->caps_mutex);
+  success = ensure_caps_unlocked (display, caps, func);
+  g_mutex_unlock (&priv->caps_mutex);
+  return success;
+}
+
+/* Copies the VA driver vendor string */
+static gboolean
+query_vendor_string (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  const gchar *vendor_string;
+
+  vendor_string = vaQueryVendorString (priv->display);
+  if (vendor_string)
+    priv->vendor_string = g_strdup (vendor_string);
+  return priv->vendor_string != NULL;
+}
+
+/* Finds out whether the VA driver supports concurrent calls on
+   distinct objects without any external lock. Only drivers known to
+   serialize internally are trusted, the others get the display lock
+   around such calls. This never fails, so that the result is fixed
+   once determined and lock/unlock pairs stay balanced */
+static gboolean
+query_thread_safety (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  static const gchar *thread_safe_drivers[] = {
+    "Intel i965 driver",
+    "Intel iHD driver",
+    "Mesa Gallium driver",
+    NULL
+  };
+  guint i;
+
+  priv->has_thread_safe_driver = FALSE;
+  if (!ensure_caps_unlocked (display, CAPS_VENDOR_STRING,
+          query_vendor_string))
+    return TRUE;
+
+  for (i = 0; thread_safe_drivers[i]; i++) {
+    if (g_ascii_strncasecmp (priv->vendor_string, thread_safe_drivers[i],
+            strlen (thread_safe_drivers[i])) == 0) {
+      priv->has_thread_safe_driver = TRUE;
+      break;
+    }
+  }
+  GST_INFO_OBJECT (display, "VA driver calls are %s",
+      priv->has_thread_safe_driver ? "concurrent" : "serialized");
+  return TRUE;
+}
+
+/* Identifies the device the VA driver runs on by the backend type and
+   the device number of the DRM node libva opened for it. Display names
+   like ":0" are not unique across hosts or containers sharing a cache */
+static gchar *
+get_driver_device (GstVaapiDisplay * display)
+{
+  VADisplayContextP const va_ctx =
+      (VADisplayContextP) GST_VAAPI_DISPLAY_VADISPLAY (display);
+  const struct drm_state *drm_state;
+  GEnumClass *enum_class;
+  GEnumValue *enum_value;
+  struct stat st;
+  gchar *device;
+
+  if (!va_ctx || !va_ctx->pDriverContext)
+    return NULL;
+  drm_state = va_ctx->pDriverContext->drm_state;
+  if (!drm_state || drm_state->fd < 0)
+    return NULL;
+  if (fstat (drm_state->fd, &st) < 0 || !S_ISCHR (st.st_mode))
+    return NULL;
+
+  enum_class = g_type_class_ref (GST_VAAPI_TYPE_DISPLAY_TYPE);
+  enum_value = g_enum_get_value (enum_class,
+      GST_VAAPI_DISPLAY_VADISPLAY_TYPE (display));
+  device = g_strdup_printf ("%s;rdev %" G_GUINT64_FORMAT,
+      enum_value ? enum_value->value_nick : "unknown", (guint64) st.st_rdev);
+  g_type_class_unref (enum_class);
+  return device;
+}
+
+/* Opens the on-disk cache of the VA driver capabilities, unless it is
+   disabled or the DRM device of the display cannot be identified.
+   Cached capabilities are only valid for the very same driver and
+   libva, so this only fails if the driver vendor string could not be
+   queried */
+static gboolean
+open_driver_cache (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  GstVaapiDisplayPrivate *const root_priv = priv->parent ?
+      GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent) : priv;
+
+  priv->driver_device = get_driver_device (display);
+  if (!priv->driver_device) {
+    GST_DEBUG_OBJECT (display, "unknown DRM device, driver cache disabled");
+    return TRUE;
+  }
+
+  if (!ensure_caps_unlocked (display, CAPS_VENDOR_STRING,
+          query_vendor_string))
+    return FALSE;
+
+  priv->driver_cache = gst_vaapi_driver_cache_new (NULL);
+  if (!priv->driver_cache)
+    return TRUE;
+  priv->driver_id = g_strdup_printf ("%s;libva %d.%d", priv->vendor_string,
+      root_priv->va_major_version, root_priv->va_minor_version);
+  return TRUE;
+}
+
+/* Called with the caps lock held */
+static gboolean
+lookup_driver_caps (GstVaapiDisplay * display, const gchar * name,
+    GArray ** values_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  ensure_caps_unlocked (display, CAPS_DRIVER_CACHE, open_driver_cache);
+  if (!priv->driver_cache)
+    return FALSE;
+  if (!gst_vaapi_driver_cache_lookup (priv->driver_cache, priv->driver_device,
+          priv->driver_id, name, values_ptr))
+    return FALSE;
+
+  GST_DEBUG_OBJECT (display, "loaded %s from driver cache", name);
+  return TRUE;
+}
+
+/* Called with the caps lock held */
+static void
+store_driver_caps (GstVaapiDisplay * display, const gchar * name,
+    const guint * values, guint num_values)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  ensure_caps_unlocked (display, CAPS_DRIVER_CACHE, open_driver_cache);
+  if (!priv->driver_cache)
+    return;
+  gst_vaapi_driver_cache_store (priv->driver_cache, priv->driver_device,
+      priv->driver_id, name, values, num_values);
+}
+
+/* Called with the caps lock held */
+static void
+save_driver_caps (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  if (priv->driver_cache)
+    gst_vaapi_driver_cache_save (priv->driver_cache);
+}
+
+/* Configs are cached as flat lists of (profile, entrypoint) pairs */
+static GArray *
+lookup_cached_configs (GstVaapiDisplay * display, const gchar * name)
+{
+  GArray *values, *configs;
+  GstVaapiConfig config;
+  guint i;
+
+  if (!lookup_driver_caps (display, name, &values))
+    return NULL;
+  if (values->len % 2 != 0) {
+    g_array_free (values, TRUE);
+    return NULL;
+  }
+
+  configs = g_array_sized_new (FALSE, FALSE, sizeof (GstVaapiConfig),
+      values->len / 2);
+  for (i = 0; i < values->len; i += 2) {
+    config.profile = g_array_index (values, guint, i);
+    config.entrypoint = g_array_index (values, guint, i + 1);
+    g_array_append_val (configs, config);
+  }
+  g_array_free (values, TRUE);
+  return configs;
+}
+
+static void
+store_cached_configs (GstVaapiDisplay * display, const gchar * name,
+    GArray * configs)
+{
+  GArray *values;
+  guint i, value[2];
+
+  values = g_array_sized_new (FALSE, FALSE, sizeof (guint), configs->len * 2);
+  for (i = 0; i < configs->len; i++) {
+    const GstVaapiConfig *const config =
+        &g_array_index (configs, GstVaapiConfig, i);
+    value[0] = config->profile;
+    value[1] = config->entrypoint;
+    g_array_append_vals (values, value, 2);
+  }
+  store_driver_caps (display, name, (guint *) values->data, values->len);
+  g_array_free (values, TRUE);
+}
+
+/* Formats are cached as flat lists of (format, flags) pairs */
+static GArray *
+lookup_cached_formats (GstVaapiDisplay * display, const gchar * name)
+{
+  GArray *values, *formats;
+  GstVaapiFormatInfo fi;
+  guint i;
+
+  if (!lookup_driver_caps (display, name, &values))
+    return NULL;
+  if (values->len % 2 != 0) {
+    g_array_free (values, TRUE);
+    return NULL;
+  }
+
+  formats = g_array_sized_new (FALSE, FALSE, sizeof (GstVaapiFormatInfo),
+      values->len / 2);
+  for (i = 0; i < values->len; i += 2) {
+    fi.format = g_array_index (values, guint, i);
+    fi.flags = g_array_index (values, guint, i + 1);
+    g_array_append_val (formats, fi);
+  }
+  g_array_free (values, TRUE);
+  return formats;
+}
+
+static void
+store_cached_formats (GstVaapiDisplay * display, const gchar * name,
+    GArray * formats)
+{
+  GArray *values;
+  guint i, value[2];
+
+  values = g_array_sized_new (FALSE, FALSE, sizeof (guint), formats->len * 2);
+  for (i = 0; i < formats->len; i++) {
+    const GstVaapiFormatInfo *const fip =
+        &g_array_index (formats, GstVaapiFormatInfo, i);
+    value[0] = fip->format;
+    value[1] = fip->flags;
+    g_array_append_vals (values, value, 2);
+  }
+  store_driver_caps (display, name, (guint *) values->data, values->len);
+  g_array_free (values, TRUE);
+}
+
+static gboolean
+load_cached_profiles (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  GArray *decoders, *encoders = NULL, *vpp = NULL;
+  gboolean success = FALSE;
+
+  decoders = lookup_cached_configs (display, "decoders");
+  if (!decoders)
+    goto cleanup;
+  encoders = lookup_cached_configs (display, "encoders");
+  if (!encoders)
+    goto cleanup;
+  if (!lookup_driver_caps (display, "vpp", &vpp) || vpp->len != 1)
+    goto cleanup;
+
+  priv->decoders = decoders;
+  priv->encoders = encoders;
+  priv->has_vpp = g_array_index (vpp, guint, 0) != 0;
+  priv->has_profiles = TRUE;
+  decoders = encoders = NULL;
+  success = TRUE;
+
+cleanup:
+  if (decoders)
+    g_array_free (decoders, TRUE);
+  if (encoders)
+    g_array_free (encoders, TRUE);
+  if (vpp)
+    g_array_free (vpp, TRUE);
+  return success;
+}
+
+static void
+store_cached_profiles (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  const guint has_vpp = priv->has_vpp;
+
+  store_cached_configs (display, "decoders", priv->decoders);
+  store_cached_configs (display, "encoders", priv->encoders);
+  store_driver_caps (display, "vpp", &has_vpp, 1);
+  save_driver_caps (display);
+}
+
 /* Initialize VA profiles (decoders, encoders) */
 static gboolean
-ensure_profiles (GstVaapiDisplay * display)
+query_profiles (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAProfile *profiles = NULL;
@@ -515,6 +873,8 @@ ensure_profiles (GstVaapiDisplay * display)
 
   if (priv->has_profiles)
     return TRUE;
+  if (load_cached_profiles (display))
+    return TRUE;
 
   priv->decoders = g_array_new (FALSE, FALSE, sizeof (GstVaapiConfig));
   if (!priv->decoders)
@@ -533,7 +893,9 @@ ensure_profiles (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQueryConfigProfiles (priv->display, profiles, &n);
+  GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+      QUERY_CONFIG_PROFILES, 0,
+      vaQueryConfigProfiles (priv->display, profiles, &n));
   if (!vaapi_check_status (status, "vaQueryConfigProfiles()"))
     goto cleanup;
 
@@ -554,8 +916,10 @@ ensure_profiles (GstVaapiDisplay * display)
     if (!config.profile)
       continue;
 
-    status = vaQueryConfigEntrypoints (priv->display,
-        profiles[i], entrypoints, &num_entrypoints);
+    GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+        QUERY_CONFIG_ENTRYPOINTS, 0,
+        vaQueryConfigEntrypoints (priv->display, profiles[i], entrypoints,
+            &num_entrypoints));
     if (!vaapi_check_status (status, "vaQueryConfigEntrypoints()"))
       continue;
 
@@ -582,8 +946,10 @@ ensure_profiles (GstVaapiDisplay * display)
 
   /* Video processing API */
 #if USE_VA_VPP
-  status = vaQueryConfigEntrypoints (priv->display, VAProfileNone,
-      entrypoints, &num_entrypoints);
+  GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+      QUERY_CONFIG_ENTRYPOINTS, 0,
+      vaQueryConfigEntrypoints (priv->display, VAProfileNone, entrypoints,
+          &num_entrypoints));
   if (vaapi_check_status (status, "vaQueryEntrypoints() [VAProfileNone]")) {
     for (j = 0; j < num_entrypoints; j++) {
       if (entrypoints[j] == VAEntrypointVideoProc)
@@ -592,16 +958,28 @@ ensure_profiles (GstVaapiDisplay * display)
   }
 #endif
   success = TRUE;
+  store_cached_profiles (display);
 
 cleanup:
   g_free (profiles);
   g_free (entrypoints);
+  if (!success) {
+    if (priv->decoders) {
+      g_array_free (priv->decoders, TRUE);
+      priv->decoders = NULL;
+    }
+    if (priv->encoders) {
+      g_array_free (priv->encoders, TRUE);
+      priv->encoders = NULL;
+    }
+    priv->has_profiles = FALSE;
+  }
   return success;
 }
 
 /* Initialize VA display attributes */
 static gboolean
-ensure_properties (GstVaapiDisplay * display)
+query_properties (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VADisplayAttribute *display_attrs = NULL;
@@ -623,7 +1001,9 @@ ensure_properties (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQueryDisplayAttributes (priv->display, display_attrs, &n);
+  GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+      QUERY_DISPLAY_ATTRIBUTES, 0,
+      vaQueryDisplayAttributes (priv->display, display_attrs, &n));
   if (!vaapi_check_status (status, "vaQueryDisplayAttributes()"))
     goto cleanup;
 
@@ -684,12 +1064,16 @@ ensure_properties (GstVaapiDisplay * display)
 
 cleanup:
   g_free (display_attrs);
+  if (!success && priv->properties) {
+    g_array_free (priv->properties, TRUE);
+    priv->properties = NULL;
+  }
   return success;
 }
 
 /* Initialize VA image formats */
 static gboolean
-ensure_image_formats (GstVaapiDisplay * display)
+query_image_formats (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAImageFormat *formats = NULL;
@@ -697,6 +1081,9 @@ ensure_image_formats (GstVaapiDisplay * display)
   gint i, n;
   gboolean success = FALSE;
 
+  if (priv->image_formats)
+    return TRUE;
+  priv->image_formats = lookup_cached_formats (display, "image-formats");
   if (priv->image_formats)
     return TRUE;
 
@@ -710,7 +1097,9 @@ ensure_image_formats (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQueryImageFormats (priv->display, formats, &n);
+  GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+      QUERY_IMAGE_FORMATS, 0, vaQueryImageFormats (priv->display, formats,
+          &n));
   if (!vaapi_check_status (status, "vaQueryImageFormats()"))
     goto cleanup;
 
@@ -721,15 +1110,21 @@ ensure_image_formats (GstVaapiDisplay * display)
   append_formats (priv->image_formats, formats, NULL, n);
   g_array_sort (priv->image_formats, compare_yuv_formats);
   success = TRUE;
+  store_cached_formats (display, "image-formats", priv->image_formats);
+  save_driver_caps (display);
 
 cleanup:
   g_free (formats);
+  if (!success && priv->image_formats) {
+    g_array_free (priv->image_formats, TRUE);
+    priv->image_formats = NULL;
+  }
   return success;
 }
 
 /* Initialize VA subpicture formats */
 static gboolean
-ensure_subpicture_formats (GstVaapiDisplay * display)
+query_subpicture_formats (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAImageFormat *formats = NULL;
@@ -738,6 +1133,10 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
   guint i, n;
   gboolean success = FALSE;
 
+  if (priv->subpicture_formats)
+    return TRUE;
+  priv->subpicture_formats =
+      lookup_cached_formats (display, "subpicture-formats");
   if (priv->subpicture_formats)
     return TRUE;
 
@@ -756,7 +1155,9 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQuerySubpictureFormats (priv->display, formats, flags, &n);
+  GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+      QUERY_SUBPICTURE_FORMATS, 0,
+      vaQuerySubpictureFormats (priv->display, formats, flags, &n));
   if (!vaapi_check_status (status, "vaQuerySubpictureFormats()"))
     goto cleanup;
 
@@ -769,13 +1170,45 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
   append_formats (priv->subpicture_formats, formats, flags, n);
   g_array_sort (priv->subpicture_formats, compare_rgb_formats);
   success = TRUE;
+  store_cached_formats (display, "subpicture-formats",
+      priv->subpicture_formats);
+  save_driver_caps (display);
 
 cleanup:
   g_free (formats);
   g_free (flags);
+  if (!success && priv->subpicture_formats) {
+    g_array_free (priv->subpicture_formats, TRUE);
+    priv->subpicture_formats = NULL;
+  }
   return success;
 }
 
+static inline gboolean
+ensure_profiles (GstVaapiDisplay * display)
+{
+  return ensure_caps (display, CAPS_PROFILES, query_profiles);
+}
+
+static inline gboolean
+ensure_properties (GstVaapiDisplay * display)
+{
+  return ensure_caps (display, CAPS_PROPERTIES, query_properties);
+}
+
+static inline gboolean
+ensure_image_formats (GstVaapiDisplay * display)
+{
+  return ensure_caps (display, CAPS_IMAGE_FORMATS, query_image_formats);
+}
+
+static inline gboolean
+ensure_subpicture_formats (GstVaapiDisplay * display)
+{
+  return ensure_caps (display, CAPS_SUBPICTURE_FORMATS,
+      query_subpicture_formats);
+}
+
 static void
 gst_vaapi_display_calculate_pixel_aspect_ratio (GstVaapiDisplay * display)
 {
@@ -854,10 +1287,38 @@ gst_vaapi_display_destroy (GstVaapiDisplay * display)
     g_array_free (priv->properties, TRUE);
     priv->properties = NULL;
   }
+  priv->has_profiles = FALSE;
+  priv->caps_ready = 0;
+
+  if (priv->driver_cache) {
+    gst_vaapi_driver_cache_free (priv->driver_cache);
+    priv->driver_cache = NULL;
+  }
+  g_free (priv->driver_id);
+  priv->driver_id = NULL;
+  g_free (priv->driver_device);
+  priv->driver_device = NULL;
+
+  if (priv->decode_scheduler) {
+    gst_vaapi_decode_scheduler_free (priv->decode_scheduler);
+    priv->decode_scheduler = NULL;
+  }
+
+  if (priv->caps_cache) {
+    gst_vaapi_caps_cache_free (priv->caps_cache);
+    priv->caps_cache = NULL;
+  }
+
+  if (priv->surface_recycler) {
+    gst_vaapi_surface_recycler_free (priv->surface_recycler);
+    priv->surface_recycler = NULL;
+  }
 
   if (priv->display) {
-    if (!priv->parent)
+    if (!priv->parent) {
+      gst_vaapi_profiler_close_display (priv->display);
       vaTerminate (priv->display);
+    }
     priv->display = NULL;
   }
 
@@ -936,7 +1397,8 @@ gst_vaapi_display_create_unlocked (GstVaapiDisplay * display,
   }
 
   if (!priv->parent) {
-    if (!vaapi_initialize (priv->display))
+    if (!vaapi_initialize (priv->display, &priv->va_major_version,
+            &priv->va_minor_version))
       return FALSE;
   }
 
@@ -991,6 +1453,24 @@ gst_vaapi_display_unlock_default (GstVaapiDisplay * display)
   g_rec_mutex_unlock (&priv->mutex);
 }
 
+static void
+destroy_recycled_surface (GstVaapiID surface_id, gpointer user_data)
+{
+  GstVaapiDisplay *const display = user_data;
+  VASurfaceID va_surface_id = surface_id;
+  VAStatus status;
+
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, DESTROY_SURFACES, 0,
+      vaDestroySurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          &va_surface_id, 1));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
+  if (!vaapi_check_status (status, "vaDestroySurfaces()"))
+    GST_WARNING ("failed to destroy surface %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (surface_id));
+}
+
 static void
 gst_vaapi_display_init (GstVaapiDisplay * display)
 {
@@ -1003,6 +1483,11 @@ gst_vaapi_display_init (GstVaapiDisplay * display)
   priv->par_d = 1;
 
   g_rec_mutex_init (&priv->mutex);
+  g_mutex_init (&priv->objects_mutex);
+  g_mutex_init (&priv->caps_mutex);
+  priv->surface_recycler =
+      gst_vaapi_surface_recycler_new (SURFACE_RECYCLER_MAX_SIZE,
+      SURFACE_RECYCLER_MAX_IDLE_TIME, destroy_recycled_surface, display);
 }
 
 static void
@@ -1013,6 +1498,8 @@ gst_vaapi_display_finalize (GObject * object)
 
   gst_vaapi_display_destroy (display);
   g_rec_mutex_clear (&priv->mutex);
+  g_mutex_clear (&priv->objects_mutex);
+  g_mutex_clear (&priv->caps_mutex);
 
   G_OBJECT_CLASS (gst_vaapi_display_parent_class)->finalize (object);
 }
@@ -1225,6 +1712,45 @@ gst_vaapi_display_unlock (GstVaapiDisplay * display)
     klass->unlock (display);
 }
 
+/* Locks the creation and destruction of VA objects, which is shared
+   with the parent display if any */
+void
+gst_vaapi_display_lock_objects (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  g_mutex_lock (&priv->objects_mutex);
+}
+
+void
+gst_vaapi_display_unlock_objects (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  g_mutex_unlock (&priv->objects_mutex);
+}
+
+/* Locks the display around a VA call on a single object, unless the
+   VA driver is thread-safe */
+void
+gst_vaapi_display_lock_va_call (GstVaapiDisplay * display)
+{
+  ensure_caps (display, CAPS_THREAD_SAFETY, query_thread_safety);
+  if (!GST_VAAPI_DISPLAY_GET_PRIVATE (display)->has_thread_safe_driver)
+    gst_vaapi_display_lock (display);
+}
+
+void
+gst_vaapi_display_unlock_va_call (GstVaapiDisplay * display)
+{
+  if (!GST_VAAPI_DISPLAY_GET_PRIVATE (display)->has_thread_safe_driver)
+    gst_vaapi_display_unlock (display);
+}
+
 /**
  * gst_vaapi_display_sync:
  * @display: a #GstVaapiDisplay
@@ -1338,6 +1864,86 @@ gst_vaapi_display_get_display (GstVaapiDisplay * display)
   return GST_VAAPI_DISPLAY_GET_PRIVATE (display)->display;
 }
 
+/* Returns the surface recycler shared by all surface pools allocated
+   from the same VA display */
+GstVaapiSurfaceRecycler *
+gst_vaapi_display_get_surface_recycler (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+
+  g_return_val_if_fail (display != NULL, NULL);
+
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  return priv->surface_recycler;
+}
+
+/**
+ * gst_vaapi_display_get_decode_scheduler:
+ * @display: a #GstVaapiDisplay
+ *
+ * Retrieves the #GstVaapiDecodeScheduler shared by all the decoders
+ * created from the same VA display, creating it on first use. Its
+ * worker threads run the decode jobs of distinct streams concurrently,
+ * without the @display lock, as decoders running on their own
+ * streaming threads do.
+ *
+ * Return value: the #GstVaapiDecodeScheduler owned by @display, or
+ *   %NULL on failure
+ */
+GstVaapiDecodeScheduler *
+gst_vaapi_display_get_decode_scheduler (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+  GstVaapiDecodeScheduler *scheduler;
+
+  g_return_val_if_fail (display != NULL, NULL);
+
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  if (priv->parent) {
+    display = priv->parent;
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  }
+
+  GST_OBJECT_LOCK (display);
+  if (!priv->decode_scheduler)
+    priv->decode_scheduler = gst_vaapi_decode_scheduler_new (MIN
+        (g_get_num_processors (), DECODE_SCHEDULER_MAX_WORKERS),
+        DECODE_SCHEDULER_MAX_BATCH_SIZE, NULL, NULL, NULL);
+  scheduler = priv->decode_scheduler;
+  GST_OBJECT_UNLOCK (display);
+  return scheduler;
+}
+
+/**
+ * gst_vaapi_display_get_caps_cache:
+ * @display: a #GstVaapiDisplay
+ *
+ * Retrieves the #GstVaapiCapsCache holding the caps elements derived
+ * from the capabilities of @display, creating it on first use. Unlike
+ * most shared objects, it is not shared with the parent display, as
+ * the caps may depend on the display type, e.g. for OpenGL support.
+ *
+ * Return value: the #GstVaapiCapsCache owned by @display
+ */
+GstVaapiCapsCache *
+gst_vaapi_display_get_caps_cache (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+  GstVaapiCapsCache *cache;
+
+  g_return_val_if_fail (display != NULL, NULL);
+
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  GST_OBJECT_LOCK (display);
+  if (!priv->caps_cache)
+    priv->caps_cache = gst_vaapi_caps_cache_new ();
+  cache = priv->caps_cache;
+  GST_OBJECT_UNLOCK (display);
+  return cache;
+}
+
 /**
  * gst_vaapi_display_get_width:
  * @display: a #GstVaapiDisplay
@@ -1785,7 +2391,9 @@ get_attribute (GstVaapiDisplay * display, VADisplayAttribType type,
 
   attr.type = type;
   attr.flags = VA_DISPLAY_ATTRIB_GETTABLE;
-  status = vaGetDisplayAttributes (priv->display, &attr, 1);
+  GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+      GET_DISPLAY_ATTRIBUTES, 0,
+      vaGetDisplayAttributes (priv->display, &attr, 1));
   if (!vaapi_check_status (status, "vaGetDisplayAttributes()"))
     return FALSE;
   *value = attr.value;
@@ -1802,7 +2410,9 @@ set_attribute (GstVaapiDisplay * display, VADisplayAttribType type, gint value)
   attr.type = type;
   attr.value = value;
   attr.flags = VA_DISPLAY_ATTRIB_SETTABLE;
-  status = vaSetDisplayAttributes (priv->display, &attr, 1);
+  GST_VAAPI_PROFILER_CALL (status, priv->display, VA_INVALID_ID,
+      SET_DISPLAY_ATTRIBUTES, 0,
+      vaSetDisplayAttributes (priv->display, &attr, 1));
   if (!vaapi_check_status (status, "vaSetDisplayAttributes()"))
     return FALSE;
   return TRUE;
@@ -2073,17 +2683,8 @@ set_color_balance (GstVaapiDisplay * display, guint prop_id, gfloat v)
 static gboolean
 ensure_vendor_string (GstVaapiDisplay * display)
 {
-  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
-  const gchar *vendor_string;
-
-  GST_VAAPI_DISPLAY_LOCK (display);
-  if (!priv->vendor_string) {
-    vendor_string = vaQueryVendorString (priv->display);
-    if (vendor_string)
-      priv->vendor_string = g_strdup (vendor_string);
-  }
-  GST_VAAPI_DISPLAY_UNLOCK (display);
-  return priv->vendor_string != NULL;
+  ensure_caps (display, CAPS_VENDOR_STRING, query_vendor_string);
+  return GST_VAAPI_DISPLAY_GET_PRIVATE (display)->vendor_string != NULL;
 }
 
 /**
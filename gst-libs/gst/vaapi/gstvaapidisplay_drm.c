@@ -34,6 +34,7 @@
 #include <xf86drm.h>
 #include <va/va_drm.h>
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapidisplay_drm.h"
 #include "gstvaapidisplay_drm_priv.h"
@@ -69,7 +70,8 @@ supports_vaapi (int fd)
   if (!va_dpy)
     return FALSE;
 
-  ret = vaapi_initialize (va_dpy);
+  ret = vaapi_initialize (va_dpy, NULL, NULL);
+  gst_vaapi_profiler_close_display (va_dpy);
   vaTerminate (va_dpy);
   return ret;
 }
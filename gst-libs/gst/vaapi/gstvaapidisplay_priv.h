@@ -30,6 +30,10 @@
 #include <gst/vaapi/gstvaapiwindow.h>
 #include <gst/vaapi/gstvaapitexture.h>
 #include <gst/vaapi/gstvaapitexturemap.h>
+#include <gst/vaapi/gstvaapisurfacerecycler.h>
+#include <gst/vaapi/gstvaapidecodescheduler.h>
+#include <gst/vaapi/gstvaapidrivercache.h>
+#include <gst/vaapi/gstvaapicapscache.h>
 #include "gstvaapiminiobject.h"
 
 G_BEGIN_DECLS
@@ -119,6 +123,51 @@ typedef enum _GstVaapiDisplayInitType           GstVaapiDisplayInitType;
 #define GST_VAAPI_DISPLAY_CACHE(display) \
   (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->cache)
 
+/**
+ * GST_VAAPI_DISPLAY_LOCK_OBJECTS:
+ * @display: a @GstVaapiDisplay
+ *
+ * Serializes the creation and destruction of VA objects on @display.
+ * Unlike the @display lock, this lock is neither held across blocking
+ * VA calls nor while calling into the native windowing system. It may
+ * be acquired with the @display lock held, but not the other way round.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DISPLAY_LOCK_OBJECTS(display) \
+  gst_vaapi_display_lock_objects (GST_VAAPI_DISPLAY_CAST (display))
+
+/**
+ * GST_VAAPI_DISPLAY_UNLOCK_OBJECTS:
+ * @display: a @GstVaapiDisplay
+ *
+ * Releases the lock acquired by GST_VAAPI_DISPLAY_LOCK_OBJECTS().
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DISPLAY_UNLOCK_OBJECTS(display) \
+  gst_vaapi_display_unlock_objects (GST_VAAPI_DISPLAY_CAST (display))
+
+/**
+ * GST_VAAPI_DISPLAY_LOCK_VA_CALL:
+ * @display: a @GstVaapiDisplay
+ *
+ * Locks @display around a VA call on a single existing object, e.g.
+ * vaSyncSurface() or vaGetImage(), unless the VA driver is known to
+ * support concurrent calls, in which case this is a no-op.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DISPLAY_LOCK_VA_CALL(display) \
+  gst_vaapi_display_lock_va_call (GST_VAAPI_DISPLAY_CAST (display))
+
+/**
+ * GST_VAAPI_DISPLAY_UNLOCK_VA_CALL:
+ * @display: a @GstVaapiDisplay
+ *
+ * Releases the lock acquired by GST_VAAPI_DISPLAY_LOCK_VA_CALL().
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DISPLAY_UNLOCK_VA_CALL(display) \
+  gst_vaapi_display_unlock_va_call (GST_VAAPI_DISPLAY_CAST (display))
+
 struct _GstVaapiDisplayPrivate
 {
   GstVaapiDisplay *parent;
@@ -140,6 +189,18 @@ struct _GstVaapiDisplayPrivate
   GArray *subpicture_formats;
   GArray *properties;
   gchar *vendor_string;
+  gint va_major_version;
+  gint va_minor_version;
+  GstVaapiDriverCache *driver_cache;
+  gchar *driver_id;
+  gchar *driver_device;
+  GstVaapiSurfaceRecycler *surface_recycler;
+  GstVaapiDecodeScheduler *decode_scheduler;
+  GstVaapiCapsCache *caps_cache;
+  GMutex objects_mutex;
+  GMutex caps_mutex;
+  volatile guint caps_ready;
+  gboolean has_thread_safe_driver;
   guint use_foreign_display:1;
   guint has_vpp:1;
   guint has_profiles:1;
@@ -217,6 +278,26 @@ GstVaapiDisplay *
 gst_vaapi_display_new (GstVaapiDisplay * display,
     GstVaapiDisplayInitType init_type, gpointer init_value);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_lock_objects (GstVaapiDisplay * display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_unlock_objects (GstVaapiDisplay * display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_lock_va_call (GstVaapiDisplay * display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_unlock_va_call (GstVaapiDisplay * display);
+
+G_GNUC_INTERNAL
+GstVaapiSurfaceRecycler *
+gst_vaapi_display_get_surface_recycler (GstVaapiDisplay * display);
+
 /* Inline reference counting for core libgstvaapi library */
 #ifdef IN_LIBGSTVAAPI_CORE
 #define gst_vaapi_display_ref_internal(display) \
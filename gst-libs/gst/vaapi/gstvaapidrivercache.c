@@ -0,0 +1,324 @@
+/*
+ *  gstvaapidrivercache.c - On-disk cache of VA driver capabilities
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapidrivercache
+ * @short_description: On-disk cache of VA driver capabilities
+ *
+ * A #GstVaapiDriverCache keeps the capabilities a VA driver reported
+ * for a device in a file, so that the next displays opened on that
+ * device, possibly by other processes, do not need to query the
+ * driver again. Capabilities are lists of unsigned integers, stored
+ * per device along with a string identifying the driver. Whenever the
+ * driver identification of a device changes, e.g. after a driver or
+ * libva update, all the capabilities stored for that device are
+ * discarded.
+ */
+
+#include "sysdeps.h"
+#include <glib/gstdio.h>
+#include "gstvaapidrivercache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Bumped whenever the way capabilities are stored changes */
+#define DRIVER_CACHE_VERSION 1
+
+#define DRIVER_KEY "driver"
+
+struct _GstVaapiDriverCache
+{
+  gchar *filename;
+  GKeyFile *key_file;
+  GHashTable *dirty_devices;
+};
+
+static gchar *
+get_default_filename (void)
+{
+  const gchar *const filename = g_getenv (GST_VAAPI_DRIVER_CACHE_ENV);
+
+  if (filename)
+    return *filename ? g_strdup (filename) : NULL;
+  return g_build_filename (g_get_user_cache_dir (),
+      "gstreamer-" GST_API_VERSION_S, "vaapi-driver-cache.ini", NULL);
+}
+
+/* The driver identification, including that of the cache itself */
+static gchar *
+get_driver_id (const gchar * driver)
+{
+  return g_strdup_printf ("%d;%s;%s", DRIVER_CACHE_VERSION, PACKAGE_VERSION,
+      driver);
+}
+
+static gboolean
+load_key_file (GKeyFile * key_file, const gchar * filename)
+{
+  GError *error = NULL;
+
+  if (!g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE,
+          &error)) {
+    if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      GST_WARNING ("failed to load driver cache %s: %s", filename,
+          error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_driver_cache_new:
+ * @filename: (allow-none): the cache file, or %NULL for the default one
+ *
+ * Creates a new #GstVaapiDriverCache and loads the contents of
+ * @filename into it, if that file exists. The default cache file is
+ * the one designated by the %GST_VAAPI_DRIVER_CACHE_ENV environment
+ * variable, if set, or a file in the user cache directory otherwise.
+ *
+ * The cache is not thread safe, callers need to serialize accesses.
+ *
+ * Return value: the newly allocated #GstVaapiDriverCache, or %NULL if
+ *   the default cache file was requested and the cache is disabled
+ */
+GstVaapiDriverCache *
+gst_vaapi_driver_cache_new (const gchar * filename)
+{
+  GstVaapiDriverCache *cache;
+  gchar *cache_filename;
+
+  cache_filename = filename ? g_strdup (filename) : get_default_filename ();
+  if (!cache_filename)
+    return NULL;
+
+  cache = g_slice_new (GstVaapiDriverCache);
+  cache->filename = cache_filename;
+  cache->key_file = g_key_file_new ();
+  cache->dirty_devices = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  load_key_file (cache->key_file, cache->filename);
+  return cache;
+}
+
+/**
+ * gst_vaapi_driver_cache_free:
+ * @cache: a #GstVaapiDriverCache
+ *
+ * Destroys @cache. Capabilities stored since the last call to
+ * gst_vaapi_driver_cache_save() are lost.
+ */
+void
+gst_vaapi_driver_cache_free (GstVaapiDriverCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_hash_table_unref (cache->dirty_devices);
+  g_key_file_free (cache->key_file);
+  g_free (cache->filename);
+  g_slice_free (GstVaapiDriverCache, cache);
+}
+
+static gboolean
+has_driver (GstVaapiDriverCache * cache, const gchar * device,
+    const gchar * driver_id)
+{
+  gchar *cached_driver_id;
+  gboolean success;
+
+  cached_driver_id = g_key_file_get_string (cache->key_file, device,
+      DRIVER_KEY, NULL);
+  success = g_strcmp0 (cached_driver_id, driver_id) == 0;
+  g_free (cached_driver_id);
+  return success;
+}
+
+/**
+ * gst_vaapi_driver_cache_lookup:
+ * @cache: a #GstVaapiDriverCache
+ * @device: the device identification, e.g. its node
+ * @driver: the driver identification, e.g. its vendor string
+ * @name: the capability name
+ * @values_ptr: return location for the capability values, as a
+ *   #GArray of #guint
+ *
+ * Looks up the @name capability reported by @driver for @device.
+ *
+ * Return value: %TRUE if the capability was found, in which case
+ *   @values_ptr holds a new #GArray the caller owns
+ */
+gboolean
+gst_vaapi_driver_cache_lookup (GstVaapiDriverCache * cache,
+    const gchar * device, const gchar * driver, const gchar * name,
+    GArray ** values_ptr)
+{
+  GError *error = NULL;
+  gchar *driver_id;
+  gint *values;
+  gsize num_values;
+  gboolean has_values;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (device != NULL, FALSE);
+  g_return_val_if_fail (driver != NULL, FALSE);
+  g_return_val_if_fail (name != NULL, FALSE);
+  g_return_val_if_fail (values_ptr != NULL, FALSE);
+
+  driver_id = get_driver_id (driver);
+  has_values = has_driver (cache, device, driver_id);
+  g_free (driver_id);
+  if (!has_values)
+    return FALSE;
+
+  /* Empty lists are valid capabilities, and come out as NULL */
+  values = g_key_file_get_integer_list (cache->key_file, device, name,
+      &num_values, &error);
+  if (error) {
+    g_error_free (error);
+    return FALSE;
+  }
+
+  *values_ptr = g_array_sized_new (FALSE, FALSE, sizeof (guint), num_values);
+  g_array_append_vals (*values_ptr, values, num_values);
+  g_free (values);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_driver_cache_store:
+ * @cache: a #GstVaapiDriverCache
+ * @device: the device identification, e.g. its node
+ * @driver: the driver identification, e.g. its vendor string
+ * @name: the capability name
+ * @values: the capability values
+ * @num_values: the number of @values
+ *
+ * Stores the @name capability reported by @driver for @device, until
+ * the next call to gst_vaapi_driver_cache_save(). Any capability
+ * stored for @device by another driver is discarded.
+ */
+void
+gst_vaapi_driver_cache_store (GstVaapiDriverCache * cache,
+    const gchar * device, const gchar * driver, const gchar * name,
+    const guint * values, guint num_values)
+{
+  gchar *driver_id;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (device != NULL);
+  g_return_if_fail (driver != NULL);
+  g_return_if_fail (name != NULL);
+  g_return_if_fail (values != NULL || num_values == 0);
+
+  driver_id = get_driver_id (driver);
+  if (!has_driver (cache, device, driver_id)) {
+    g_key_file_remove_group (cache->key_file, device, NULL);
+    g_key_file_set_string (cache->key_file, device, DRIVER_KEY, driver_id);
+  }
+  g_free (driver_id);
+
+  g_key_file_set_integer_list (cache->key_file, device, name,
+      (gint *) values, num_values);
+  g_hash_table_add (cache->dirty_devices, g_strdup (device));
+}
+
+static void
+copy_group (GKeyFile * dst_key_file, GKeyFile * src_key_file,
+    const gchar * group)
+{
+  gchar **keys, *value;
+  guint i;
+
+  g_key_file_remove_group (dst_key_file, group, NULL);
+
+  keys = g_key_file_get_keys (src_key_file, group, NULL, NULL);
+  if (!keys)
+    return;
+  for (i = 0; keys[i] != NULL; i++) {
+    value = g_key_file_get_value (src_key_file, group, keys[i], NULL);
+    if (value)
+      g_key_file_set_value (dst_key_file, group, keys[i], value);
+    g_free (value);
+  }
+  g_strfreev (keys);
+}
+
+/**
+ * gst_vaapi_driver_cache_save:
+ * @cache: a #GstVaapiDriverCache
+ *
+ * Writes the capabilities stored since the last save to the cache
+ * file. Devices stored in the file by other processes in the meantime
+ * are preserved, and the file is replaced atomically.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_driver_cache_save (GstVaapiDriverCache * cache)
+{
+  GKeyFile *key_file;
+  GHashTableIter iter;
+  GError *error = NULL;
+  gchar *data = NULL, *dirname;
+  gpointer device;
+  gsize size;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+
+  if (g_hash_table_size (cache->dirty_devices) == 0)
+    return TRUE;
+
+  key_file = g_key_file_new ();
+  load_key_file (key_file, cache->filename);
+  g_hash_table_iter_init (&iter, cache->dirty_devices);
+  while (g_hash_table_iter_next (&iter, &device, NULL))
+    copy_group (key_file, cache->key_file, device);
+
+  data = g_key_file_to_data (key_file, &size, NULL);
+  if (!data)
+    goto cleanup;
+
+  dirname = g_path_get_dirname (cache->filename);
+  g_mkdir_with_parents (dirname, 0700);
+  g_free (dirname);
+
+  if (!g_file_set_contents (cache->filename, data, size, &error))
+    goto error_write_file;
+
+  g_hash_table_remove_all (cache->dirty_devices);
+  success = TRUE;
+
+cleanup:
+  g_free (data);
+  g_key_file_free (key_file);
+  return success;
+
+  /* ERRORS */
+error_write_file:
+  {
+    GST_WARNING ("failed to write driver cache %s: %s", cache->filename,
+        error->message);
+    g_error_free (error);
+    goto cleanup;
+  }
+}
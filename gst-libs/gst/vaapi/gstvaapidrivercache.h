@@ -0,0 +1,60 @@
+/*
+ *  gstvaapidrivercache.h - On-disk cache of VA driver capabilities
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DRIVER_CACHE_H
+#define GST_VAAPI_DRIVER_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiDriverCache GstVaapiDriverCache;
+
+/**
+ * GST_VAAPI_DRIVER_CACHE_ENV:
+ *
+ * The environment variable holding the path to the driver cache
+ * file. The cache is disabled if it is set to an empty string.
+ */
+#define GST_VAAPI_DRIVER_CACHE_ENV "GST_VAAPI_DRIVER_CACHE"
+
+GstVaapiDriverCache *
+gst_vaapi_driver_cache_new (const gchar * filename);
+
+void
+gst_vaapi_driver_cache_free (GstVaapiDriverCache * cache);
+
+gboolean
+gst_vaapi_driver_cache_lookup (GstVaapiDriverCache * cache,
+    const gchar * device, const gchar * driver, const gchar * name,
+    GArray ** values_ptr);
+
+void
+gst_vaapi_driver_cache_store (GstVaapiDriverCache * cache,
+    const gchar * device, const gchar * driver, const gchar * name,
+    const guint * values, guint num_values);
+
+gboolean
+gst_vaapi_driver_cache_save (GstVaapiDriverCache * cache);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DRIVER_CACHE_H */
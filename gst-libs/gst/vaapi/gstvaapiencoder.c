@@ -25,10 +25,13 @@
 #include "gstvaapicompat.h"
 #include "gstvaapiencoder.h"
 #include "gstvaapiencoder_priv.h"
+#include "gstvaapicodedbuffer_priv.h"
 #include "gstvaapicontext.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils.h"
 #include "gstvaapiutils_core.h"
+#include "gstvaapiutils_h26x.h"
+#include "gstvaapitiming.h"
 #include "gstvaapivalue.h"
 
 #define DEBUG 1
@@ -172,6 +175,29 @@ gst_vaapi_encoder_properties_get_default (const GstVaapiEncoderClass * klass)
   return props;
 }
 
+/* Generate the property controlling parallel encoding of intra-only
+   pictures, for codecs that support it */
+GPtrArray *
+gst_vaapi_encoder_properties_append_num_contexts (GPtrArray * props)
+{
+  /**
+   * GstVaapiEncoder:num-contexts:
+   *
+   * The number of VA contexts independent pictures are dispatched
+   * to, in a round-robin fashion. This is only effective when all
+   * pictures are intra coded, with constant QP rate control.
+   */
+  GST_VAAPI_ENCODER_PROPERTIES_APPEND (props,
+      GST_VAAPI_ENCODER_PROP_NUM_CONTEXTS,
+      g_param_spec_uint ("num-contexts",
+          "Number of contexts",
+          "Number of VA contexts intra-only pictures are encoded on in parallel",
+          1, GST_VAAPI_ENCODER_MAX_CONTEXTS, 1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  return props;
+}
+
 /**
  * gst_vaapi_encoder_ref:
  * @encoder: a #GstVaapiEncoder
@@ -224,24 +250,25 @@ _coded_buffer_proxy_released_notify (GstVaapiEncoder * encoder)
   g_mutex_unlock (&encoder->mutex);
 }
 
-/* Creates a new VA coded buffer object proxy, backed from a pool */
+/* Creates a new VA coded buffer object proxy, backed from the pool of
+   the VA context the picture is encoded on */
 static GstVaapiCodedBufferProxy *
-gst_vaapi_encoder_create_coded_buffer (GstVaapiEncoder * encoder)
+gst_vaapi_encoder_create_coded_buffer (GstVaapiEncoder * encoder, guint lane)
 {
-  GstVaapiCodedBufferPool *const pool =
-      GST_VAAPI_CODED_BUFFER_POOL (encoder->codedbuf_pool);
+  GstVaapiCodedBufferPool *const pool = GST_VAAPI_CODED_BUFFER_POOL (lane > 0 ?
+      encoder->aux_codedbuf_pools[lane - 1] : encoder->codedbuf_pool);
   GstVaapiCodedBufferProxy *codedbuf_proxy;
 
   g_mutex_lock (&encoder->mutex);
-  do {
+  for (;;) {
     codedbuf_proxy = gst_vaapi_coded_buffer_proxy_new_from_pool (pool);
     if (codedbuf_proxy)
       break;
 
-    /* Wait for a free coded buffer to become available */
+    /* Wait for a free coded buffer to become available. Buffers of
+       other contexts may be released first, so check again */
     g_cond_wait (&encoder->codedbuf_free, &encoder->mutex);
-    codedbuf_proxy = gst_vaapi_coded_buffer_proxy_new_from_pool (pool);
-  } while (0);
+  }
   g_mutex_unlock (&encoder->mutex);
   if (!codedbuf_proxy)
     return NULL;
@@ -285,6 +312,16 @@ gst_vaapi_encoder_create_surface (GstVaapiEncoder * encoder)
   return proxy;
 }
 
+/* Selects the VA context subsequent pictures are encoded on */
+static void
+set_va_context (GstVaapiEncoder * encoder, guint lane)
+{
+  GstVaapiContext *const context =
+      lane > 0 ? encoder->aux_contexts[lane - 1] : encoder->context;
+
+  encoder->va_context = gst_vaapi_context_get_id (context);
+}
+
 /**
  * gst_vaapi_encoder_put_frame:
  * @encoder: a #GstVaapiEncoder
@@ -300,11 +337,17 @@ gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
     GstVideoCodecFrame * frame)
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
+  const GstClockTime start = GST_VAAPI_TIMING_BEGIN ();
   GstVaapiEncoderStatus status;
   GstVaapiEncPicture *picture;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
+  guint lane;
 
   for (;;) {
+    /* Dispatch the next picture to the least busy VA context */
+    lane = gst_vaapi_parallel_queue_next_lane (encoder->codedbuf_queue);
+    set_va_context (encoder, lane);
+
     picture = NULL;
     status = klass->reordering (encoder, frame, &picture);
     if (status == GST_VAAPI_ENCODER_STATUS_NO_SURFACE)
@@ -312,7 +355,7 @@ gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
     if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
       goto error_reorder_frame;
 
-    codedbuf_proxy = gst_vaapi_encoder_create_coded_buffer (encoder);
+    codedbuf_proxy = gst_vaapi_encoder_create_coded_buffer (encoder, lane);
     if (!codedbuf_proxy)
       goto error_create_coded_buffer;
 
@@ -322,12 +365,16 @@ gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
 
     gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
         picture, (GDestroyNotify) gst_vaapi_mini_object_unref);
-    g_async_queue_push (encoder->codedbuf_queue, codedbuf_proxy);
+    gst_vaapi_parallel_queue_push (encoder->codedbuf_queue, lane,
+        codedbuf_proxy);
     encoder->num_codedbuf_queued++;
 
     /* Try again with any pending reordered frame now available for encoding */
     frame = NULL;
   }
+  set_va_context (encoder, 0);
+
+  GST_VAAPI_TIMING_END (GST_VAAPI_TIMING_STAGE_ENCODE, start);
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
 
   /* ERRORS */
@@ -358,7 +405,9 @@ error_encode:
  * @timeout: the number of microseconds to wait for the coded buffer, at most
  *
  * Upon successful return, *@out_codedbuf_proxy_ptr contains the next
- * coded buffer as a #GstVaapiCodedBufferProxy. The caller owns this
+ * coded buffer as a #GstVaapiCodedBufferProxy. Coded buffers are
+ * always returned in submission order, even if pictures were encoded
+ * in parallel on several VA contexts. The caller owns this
  * object, so gst_vaapi_coded_buffer_proxy_unref() shall be called
  * after usage. Otherwise, @GST_VAAPI_DECODER_STATUS_ERROR_NO_BUFFER
  * is returned if no coded buffer is available so far (timeout).
@@ -373,10 +422,12 @@ GstVaapiEncoderStatus
 gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
     GstVaapiCodedBufferProxy ** out_codedbuf_proxy_ptr, guint64 timeout)
 {
+  const GstClockTime start = GST_VAAPI_TIMING_BEGIN ();
   GstVaapiEncPicture *picture;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
 
-  codedbuf_proxy = g_async_queue_timeout_pop (encoder->codedbuf_queue, timeout);
+  codedbuf_proxy = gst_vaapi_parallel_queue_pop (encoder->codedbuf_queue,
+      timeout, NULL);
   if (!codedbuf_proxy)
     return GST_VAAPI_ENCODER_STATUS_NO_BUFFER;
 
@@ -392,6 +443,8 @@ gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
   if (out_codedbuf_proxy_ptr)
     *out_codedbuf_proxy_ptr = gst_vaapi_coded_buffer_proxy_ref (codedbuf_proxy);
   gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
+
+  GST_VAAPI_TIMING_END (GST_VAAPI_TIMING_STAGE_GET_BUFFER, start);
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
 
   /* ERRORS */
@@ -661,6 +714,87 @@ gst_vaapi_encoder_ensure_context (GstVaapiEncoder * encoder)
   return TRUE;
 }
 
+/* Ensures the auxiliary VA contexts for parallel encoding are created */
+static gboolean
+gst_vaapi_encoder_ensure_aux_contexts (GstVaapiEncoder * encoder)
+{
+  GstVaapiContextInfo aux_info = encoder->context_info;
+  GstVaapiContextInfo *const cip = &aux_info;
+  GstVaapiContext **context_ptr;
+  guint i, num_contexts;
+
+  /* Pictures depending on each other can only be encoded serially */
+  num_contexts = encoder->intra_only ? encoder->num_contexts : 1;
+
+  /* Each VA context runs its own rate control loop, so every one of
+     them would target the full bitrate */
+  switch (GST_VAAPI_ENCODER_RATE_CONTROL (encoder)) {
+    case GST_VAAPI_RATECONTROL_NONE:
+    case GST_VAAPI_RATECONTROL_CQP:
+      break;
+    default:
+      if (num_contexts > 1)
+        GST_WARNING ("parallel encoding requires constant QP, "
+            "using a single VA context");
+      num_contexts = 1;
+      break;
+  }
+
+  if (!gst_vaapi_parallel_queue_set_num_lanes (encoder->codedbuf_queue,
+          num_contexts)) {
+    GST_WARNING ("could not change the number of contexts while encoding");
+    num_contexts =
+        gst_vaapi_parallel_queue_get_num_lanes (encoder->codedbuf_queue);
+  }
+  GST_DEBUG ("encoding on %u VA context(s)", num_contexts);
+
+  /* Reconstructed surfaces are allocated from the main context only */
+  cip->ref_frames = 0;
+
+  for (i = 1; i < GST_VAAPI_ENCODER_MAX_CONTEXTS; i++) {
+    context_ptr = &encoder->aux_contexts[i - 1];
+    if (i >= num_contexts) {
+      gst_vaapi_video_pool_replace (&encoder->aux_codedbuf_pools[i - 1],
+          NULL);
+      gst_vaapi_object_replace (context_ptr, NULL);
+      continue;
+    }
+    if (*context_ptr) {
+      if (!gst_vaapi_context_reset (*context_ptr, cip))
+        return FALSE;
+    } else {
+      gst_vaapi_video_pool_replace (&encoder->aux_codedbuf_pools[i - 1],
+          NULL);
+      *context_ptr = gst_vaapi_context_new (encoder->display, cip);
+      if (!*context_ptr)
+        return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* Ensures the coded buffer pool of @context holds buffers of the
+   current size */
+static gboolean
+ensure_coded_buffer_pool (GstVaapiEncoder * encoder,
+    GstVaapiVideoPool ** pool_ptr, GstVaapiContext * context)
+{
+  GstVaapiVideoPool *pool;
+
+  if (*pool_ptr && gst_vaapi_coded_buffer_pool_get_buffer_size
+      (GST_VAAPI_CODED_BUFFER_POOL (*pool_ptr)) == encoder->codedbuf_size)
+    return TRUE;
+
+  pool = gst_vaapi_coded_buffer_pool_new_with_context (context,
+      encoder->codedbuf_size);
+  if (!pool)
+    return FALSE;
+  gst_vaapi_video_pool_set_capacity (pool, 5);
+  gst_vaapi_video_pool_replace (pool_ptr, pool);
+  gst_vaapi_video_pool_unref (pool);
+  return TRUE;
+}
+
 /* Reconfigures the encoder with the new properties */
 static GstVaapiEncoderStatus
 gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
@@ -668,8 +802,7 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
   GstVideoInfo *const vip = GST_VAAPI_ENCODER_VIDEO_INFO (encoder);
   GstVaapiEncoderStatus status;
-  GstVaapiVideoPool *pool;
-  guint codedbuf_size;
+  guint i;
 
   /* Generate a keyframe every second */
   if (!encoder->keyframe_period)
@@ -681,17 +814,19 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
 
   if (!gst_vaapi_encoder_ensure_context (encoder))
     goto error_reset_context;
+  if (!gst_vaapi_encoder_ensure_aux_contexts (encoder))
+    goto error_reset_context;
 
-  codedbuf_size = encoder->codedbuf_pool ?
-      gst_vaapi_coded_buffer_pool_get_buffer_size (GST_VAAPI_CODED_BUFFER_POOL
-      (encoder)) : 0;
-  if (codedbuf_size != encoder->codedbuf_size) {
-    pool = gst_vaapi_coded_buffer_pool_new (encoder, encoder->codedbuf_size);
-    if (!pool)
+  /* Each VA context encodes into coded buffers of its own */
+  if (!ensure_coded_buffer_pool (encoder, &encoder->codedbuf_pool,
+          encoder->context))
+    goto error_alloc_codedbuf_pool;
+  for (i = 0; i < G_N_ELEMENTS (encoder->aux_contexts); i++) {
+    if (!encoder->aux_contexts[i])
+      continue;
+    if (!ensure_coded_buffer_pool (encoder, &encoder->aux_codedbuf_pools[i],
+            encoder->aux_contexts[i]))
       goto error_alloc_codedbuf_pool;
-    gst_vaapi_video_pool_set_capacity (pool, 5);
-    gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, pool);
-    gst_vaapi_video_pool_unref (pool);
   }
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
 
@@ -793,6 +928,10 @@ set_property (GstVaapiEncoder * encoder, gint prop_id, const GValue * value)
     case GST_VAAPI_ENCODER_PROP_TUNE:
       status = gst_vaapi_encoder_set_tuning (encoder, g_value_get_enum (value));
       break;
+    case GST_VAAPI_ENCODER_PROP_NUM_CONTEXTS:
+      status = gst_vaapi_encoder_set_num_contexts (encoder,
+          g_value_get_uint (value));
+      break;
   }
   return status;
 
@@ -1018,6 +1157,195 @@ error_operation_failed:
   }
 }
 
+/**
+ * gst_vaapi_encoder_set_num_contexts:
+ * @encoder: a #GstVaapiEncoder
+ * @num_contexts: the requested number of VA contexts
+ *
+ * Notifies the @encoder to dispatch pictures over @num_contexts VA
+ * contexts, so that independent pictures can be encoded in parallel
+ * by the hardware. The coded buffers are still output in presentation
+ * order. This only has an effect if all pictures are intra coded,
+ * e.g. for JPEG, or for H.264 with a keyframe period of 1, and if the
+ * rate control mode is @GST_VAAPI_RATECONTROL_CQP. Bitrate based rate
+ * control modes would run independently on each context, and thus
+ * overshoot the target bitrate.
+ *
+ * Note: currently, the number of contexts can only be specified before
+ * the last call to gst_vaapi_encoder_set_codec_state(), which shall
+ * occur before the first frame is encoded. Afterwards, any change to
+ * this parameter causes gst_vaapi_encoder_set_num_contexts() to
+ * return @GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED.
+ *
+ * Return value: a #GstVaapiEncoderStatus
+ */
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_num_contexts (GstVaapiEncoder * encoder,
+    guint num_contexts)
+{
+  g_return_val_if_fail (encoder != NULL, 0);
+  g_return_val_if_fail (num_contexts > 0 &&
+      num_contexts <= GST_VAAPI_ENCODER_MAX_CONTEXTS, 0);
+
+  if (encoder->num_contexts != num_contexts
+      && encoder->num_codedbuf_queued > 0)
+    goto error_operation_failed;
+
+  encoder->num_contexts = num_contexts;
+  return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_operation_failed:
+  {
+    GST_ERROR ("could not change number of contexts after encoding started");
+    return GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
+}
+
+/**
+ * gst_vaapi_encoder_has_crop_rect_support:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Checks whether the bitstream syntax of the @encoder codec can
+ * signal a cropping rectangle, i.e. whether
+ * gst_vaapi_encoder_set_crop_rect() is supported.
+ *
+ * Return value: %TRUE for H.264 and H.265 encoders, %FALSE otherwise
+ */
+gboolean
+gst_vaapi_encoder_has_crop_rect_support (GstVaapiEncoder * encoder)
+{
+  const GstVaapiEncoderClassData *cdata;
+
+  g_return_val_if_fail (encoder != NULL, FALSE);
+
+  cdata = GST_VAAPI_ENCODER_GET_CLASS (encoder)->class_data;
+  return cdata->codec == GST_VAAPI_CODEC_H264 ||
+      cdata->codec == GST_VAAPI_CODEC_H265;
+}
+
+/**
+ * gst_vaapi_encoder_set_crop_rect:
+ * @encoder: a #GstVaapiEncoder
+ * @crop_rect: the region of the frames to display, or %NULL
+ *
+ * Notifies the @encoder that only the @crop_rect region of the input
+ * frames is to be displayed. The whole frames are still encoded, but
+ * the region is signalled in the bitstream, i.e. as frame cropping
+ * offsets in the H.264 SPS or as the conformance window in the H.265
+ * SPS. This avoids copying the pixels of the region to a new surface.
+ * The region is extended to the chroma sample grid, and vertically to
+ * pairs of chroma lines for interlaced H.264 streams. If @crop_rect is
+ * %NULL, then the whole frames are displayed.
+ *
+ * Note: currently, the cropping rectangle can only be specified
+ * before the first frame is encoded. Afterwards, any change to this
+ * parameter causes gst_vaapi_encoder_set_crop_rect() to return
+ * @GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED. This is also the
+ * case for codecs that have no such syntax.
+ *
+ * Return value: a #GstVaapiEncoderStatus
+ */
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_crop_rect (GstVaapiEncoder * encoder,
+    const GstVaapiRectangle * crop_rect)
+{
+  const GstVaapiEncoderClassData *cdata;
+  GstVaapiRectangle rect;
+  guint width, height, crop_unit_y;
+
+  g_return_val_if_fail (encoder != NULL, 0);
+
+  width = GST_VAAPI_ENCODER_WIDTH (encoder);
+  height = GST_VAAPI_ENCODER_HEIGHT (encoder);
+
+  if (!crop_rect || (crop_rect->x == 0 && crop_rect->y == 0 &&
+          crop_rect->width == width && crop_rect->height == height)) {
+    if (encoder->has_crop_rect && encoder->num_codedbuf_queued > 0)
+      goto error_operation_failed;
+    encoder->has_crop_rect = FALSE;
+    return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+  }
+
+  cdata = GST_VAAPI_ENCODER_GET_CLASS (encoder)->class_data;
+  if (!gst_vaapi_encoder_has_crop_rect_support (encoder))
+    goto error_unsupported_codec;
+
+  /* The H.264 crop unit is twice as high for field coding (CropUnitY
+     = 4 if frame_mbs_only_flag is 0) */
+  crop_unit_y = 2;
+  if (cdata->codec == GST_VAAPI_CODEC_H264 &&
+      GST_VIDEO_INFO_IS_INTERLACED (GST_VAAPI_ENCODER_VIDEO_INFO (encoder)))
+    crop_unit_y = 4;
+
+  if (!gst_vaapi_utils_h26x_align_crop_rect (crop_rect, width, height,
+          crop_unit_y, &rect))
+    goto error_invalid_rect;
+
+  if (encoder->has_crop_rect && rect.x == encoder->crop_rect.x &&
+      rect.y == encoder->crop_rect.y &&
+      rect.width == encoder->crop_rect.width &&
+      rect.height == encoder->crop_rect.height)
+    return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  if (encoder->num_codedbuf_queued > 0)
+    goto error_operation_failed;
+
+  encoder->crop_rect = rect;
+  encoder->has_crop_rect = TRUE;
+  return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_operation_failed:
+  {
+    GST_ERROR ("could not change cropping rectangle after encoding started");
+    return GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
+error_invalid_rect:
+  {
+    GST_ERROR ("cropping rectangle (%u,%u):%ux%u does not fit in %ux%u",
+        crop_rect->x, crop_rect->y, crop_rect->width, crop_rect->height,
+        width, height);
+    return GST_VAAPI_ENCODER_STATUS_ERROR_INVALID_PARAMETER;
+  }
+error_unsupported_codec:
+  {
+    GST_ERROR ("cropping rectangle is not supported by %s encoder",
+        gst_vaapi_codec_get_name (cdata->codec));
+    return GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
+}
+
+/**
+ * gst_vaapi_encoder_get_crop_rect:
+ * @encoder: a #GstVaapiEncoder
+ * @crop_rect: return location for the cropping rectangle
+ *
+ * Retrieves the region of the frames signalled for display, as
+ * aligned by gst_vaapi_encoder_set_crop_rect(). If no cropping
+ * rectangle was set, @crop_rect is filled in with the whole frame.
+ *
+ * Return value: %TRUE if a cropping rectangle is set, %FALSE otherwise
+ */
+gboolean
+gst_vaapi_encoder_get_crop_rect (GstVaapiEncoder * encoder,
+    GstVaapiRectangle * crop_rect)
+{
+  g_return_val_if_fail (encoder != NULL, FALSE);
+  g_return_val_if_fail (crop_rect != NULL, FALSE);
+
+  if (encoder->has_crop_rect) {
+    *crop_rect = encoder->crop_rect;
+    return TRUE;
+  }
+
+  crop_rect->x = 0;
+  crop_rect->y = 0;
+  crop_rect->width = GST_VAAPI_ENCODER_WIDTH (encoder);
+  crop_rect->height = GST_VAAPI_ENCODER_HEIGHT (encoder);
+  return FALSE;
+}
+
 /* Initialize default values for configurable properties */
 static gboolean
 gst_vaapi_encoder_init_properties (GstVaapiEncoder * encoder)
@@ -1074,7 +1402,8 @@ gst_vaapi_encoder_init (GstVaapiEncoder * encoder, GstVaapiDisplay * display)
   g_cond_init (&encoder->surface_free);
   g_cond_init (&encoder->codedbuf_free);
 
-  encoder->codedbuf_queue = g_async_queue_new_full ((GDestroyNotify)
+  encoder->num_contexts = 1;
+  encoder->codedbuf_queue = gst_vaapi_parallel_queue_new (1, (GDestroyNotify)
       gst_vaapi_coded_buffer_proxy_unref);
   if (!encoder->codedbuf_queue)
     return FALSE;
@@ -1098,9 +1427,14 @@ void
 gst_vaapi_encoder_finalize (GstVaapiEncoder * encoder)
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
+  guint i;
 
   klass->finalize (encoder);
 
+  for (i = 0; i < G_N_ELEMENTS (encoder->aux_contexts); i++) {
+    gst_vaapi_video_pool_replace (&encoder->aux_codedbuf_pools[i], NULL);
+    gst_vaapi_object_replace (&encoder->aux_contexts[i], NULL);
+  }
   gst_vaapi_object_replace (&encoder->context, NULL);
   gst_vaapi_display_replace (&encoder->display, NULL);
   encoder->va_display = NULL;
@@ -1112,7 +1446,7 @@ gst_vaapi_encoder_finalize (GstVaapiEncoder * encoder)
 
   gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, NULL);
   if (encoder->codedbuf_queue) {
-    g_async_queue_unref (encoder->codedbuf_queue);
+    gst_vaapi_parallel_queue_free (encoder->codedbuf_queue);
     encoder->codedbuf_queue = NULL;
   }
   g_cond_clear (&encoder->surface_free);
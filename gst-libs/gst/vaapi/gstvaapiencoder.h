@@ -100,6 +100,8 @@ typedef enum {
  * @GST_VAAPI_ENCODER_PROP_KEYFRAME_PERIOD: The maximal distance
  *   between two keyframes (uint).
  * @GST_VAAPI_ENCODER_PROP_TUNE: The tuning options (#GstVaapiEncoderTune).
+ * @GST_VAAPI_ENCODER_PROP_NUM_CONTEXTS: The number of VA contexts
+ *   intra-only pictures are encoded on in parallel (uint).
  *
  * The set of configurable properties for the encoder.
  */
@@ -108,6 +110,7 @@ typedef enum {
   GST_VAAPI_ENCODER_PROP_BITRATE,
   GST_VAAPI_ENCODER_PROP_KEYFRAME_PERIOD,
   GST_VAAPI_ENCODER_PROP_TUNE,
+  GST_VAAPI_ENCODER_PROP_NUM_CONTEXTS,
 } GstVaapiEncoderProp;
 
 /**
@@ -166,6 +169,21 @@ GstVaapiEncoderStatus
 gst_vaapi_encoder_set_tuning (GstVaapiEncoder * encoder,
     GstVaapiEncoderTune tuning);
 
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_num_contexts (GstVaapiEncoder * encoder,
+    guint num_contexts);
+
+gboolean
+gst_vaapi_encoder_has_crop_rect_support (GstVaapiEncoder * encoder);
+
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_crop_rect (GstVaapiEncoder * encoder,
+    const GstVaapiRectangle * crop_rect);
+
+gboolean
+gst_vaapi_encoder_get_crop_rect (GstVaapiEncoder * encoder,
+    GstVaapiRectangle * crop_rect);
+
 GstVaapiEncoderStatus
 gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
     GstVaapiCodedBufferProxy ** out_codedbuf_proxy_ptr, guint64 timeout);
@@ -36,6 +36,8 @@
 #include "gstvaapiencoder_h264.h"
 #include "gstvaapiutils_h264.h"
 #include "gstvaapiutils_h264_priv.h"
+#include "gstvaapiutils_h264_enc_priv.h"
+#include "gstvaapiutils_h26x.h"
 #include "gstvaapiutils_h26x_priv.h"
 #include "gstvaapicodedbufferproxy_priv.h"
 #include "gstvaapisurface.h"
@@ -242,425 +244,6 @@ bs_error:
   }
 }
 
-/* Write the NAL unit trailing bits */
-static gboolean
-bs_write_trailing_bits (GstBitWriter * bs)
-{
-  if (!gst_bit_writer_put_bits_uint32 (bs, 1, 1))
-    goto bs_error;
-  gst_bit_writer_align_bytes_unchecked (bs, 0);
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write NAL unit trailing bits");
-    return FALSE;
-  }
-}
-
-/* Write an SPS NAL unit */
-static gboolean
-bs_write_sps_data (GstBitWriter * bs,
-    const VAEncSequenceParameterBufferH264 * seq_param, GstVaapiProfile profile,
-    const VAEncMiscParameterHRD * hrd_params)
-{
-  guint8 profile_idc;
-  guint32 constraint_set0_flag, constraint_set1_flag;
-  guint32 constraint_set2_flag, constraint_set3_flag;
-  guint32 gaps_in_frame_num_value_allowed_flag = 0;     // ??
-  gboolean nal_hrd_parameters_present_flag;
-
-  guint32 b_qpprime_y_zero_transform_bypass = 0;
-  guint32 residual_color_transform_flag = 0;
-  guint32 pic_height_in_map_units =
-      (seq_param->seq_fields.bits.frame_mbs_only_flag ?
-      seq_param->picture_height_in_mbs : seq_param->picture_height_in_mbs / 2);
-  guint32 mb_adaptive_frame_field =
-      !seq_param->seq_fields.bits.frame_mbs_only_flag;
-  guint32 i = 0;
-
-  profile_idc = gst_vaapi_utils_h264_get_profile_idc (profile);
-  constraint_set0_flag =        /* A.2.1 (baseline profile constraints) */
-      profile == GST_VAAPI_PROFILE_H264_BASELINE ||
-      profile == GST_VAAPI_PROFILE_H264_CONSTRAINED_BASELINE;
-  constraint_set1_flag =        /* A.2.2 (main profile constraints) */
-      profile == GST_VAAPI_PROFILE_H264_MAIN ||
-      profile == GST_VAAPI_PROFILE_H264_CONSTRAINED_BASELINE;
-  constraint_set2_flag = 0;
-  constraint_set3_flag = 0;
-
-  /* profile_idc */
-  WRITE_UINT32 (bs, profile_idc, 8);
-  /* constraint_set0_flag */
-  WRITE_UINT32 (bs, constraint_set0_flag, 1);
-  /* constraint_set1_flag */
-  WRITE_UINT32 (bs, constraint_set1_flag, 1);
-  /* constraint_set2_flag */
-  WRITE_UINT32 (bs, constraint_set2_flag, 1);
-  /* constraint_set3_flag */
-  WRITE_UINT32 (bs, constraint_set3_flag, 1);
-  /* reserved_zero_4bits */
-  WRITE_UINT32 (bs, 0, 4);
-  /* level_idc */
-  WRITE_UINT32 (bs, seq_param->level_idc, 8);
-  /* seq_parameter_set_id */
-  WRITE_UE (bs, seq_param->seq_parameter_set_id);
-
-  if (profile == GST_VAAPI_PROFILE_H264_HIGH ||
-      profile == GST_VAAPI_PROFILE_H264_MULTIVIEW_HIGH ||
-      profile == GST_VAAPI_PROFILE_H264_STEREO_HIGH) {
-    /* for high profile */
-    /* chroma_format_idc  = 1, 4:2:0 */
-    WRITE_UE (bs, seq_param->seq_fields.bits.chroma_format_idc);
-    if (3 == seq_param->seq_fields.bits.chroma_format_idc) {
-      WRITE_UINT32 (bs, residual_color_transform_flag, 1);
-    }
-    /* bit_depth_luma_minus8 */
-    WRITE_UE (bs, seq_param->bit_depth_luma_minus8);
-    /* bit_depth_chroma_minus8 */
-    WRITE_UE (bs, seq_param->bit_depth_chroma_minus8);
-    /* b_qpprime_y_zero_transform_bypass */
-    WRITE_UINT32 (bs, b_qpprime_y_zero_transform_bypass, 1);
-
-    /* seq_scaling_matrix_present_flag  */
-    g_assert (seq_param->seq_fields.bits.seq_scaling_matrix_present_flag == 0);
-    WRITE_UINT32 (bs,
-        seq_param->seq_fields.bits.seq_scaling_matrix_present_flag, 1);
-
-#if 0
-    if (seq_param->seq_fields.bits.seq_scaling_matrix_present_flag) {
-      for (i = 0;
-          i < (seq_param->seq_fields.bits.chroma_format_idc != 3 ? 8 : 12);
-          i++) {
-        gst_bit_writer_put_bits_uint8 (bs,
-            seq_param->seq_fields.bits.seq_scaling_list_present_flag, 1);
-        if (seq_param->seq_fields.bits.seq_scaling_list_present_flag) {
-          g_assert (0);
-          /* FIXME, need write scaling list if seq_scaling_matrix_present_flag ==1 */
-        }
-      }
-    }
-#endif
-  }
-
-  /* log2_max_frame_num_minus4 */
-  WRITE_UE (bs, seq_param->seq_fields.bits.log2_max_frame_num_minus4);
-  /* pic_order_cnt_type */
-  WRITE_UE (bs, seq_param->seq_fields.bits.pic_order_cnt_type);
-
-  if (seq_param->seq_fields.bits.pic_order_cnt_type == 0) {
-    /* log2_max_pic_order_cnt_lsb_minus4 */
-    WRITE_UE (bs, seq_param->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4);
-  } else if (seq_param->seq_fields.bits.pic_order_cnt_type == 1) {
-    g_assert (0 && "only POC type 0 is supported");
-    WRITE_UINT32 (bs,
-        seq_param->seq_fields.bits.delta_pic_order_always_zero_flag, 1);
-    WRITE_SE (bs, seq_param->offset_for_non_ref_pic);
-    WRITE_SE (bs, seq_param->offset_for_top_to_bottom_field);
-    WRITE_UE (bs, seq_param->num_ref_frames_in_pic_order_cnt_cycle);
-    for (i = 0; i < seq_param->num_ref_frames_in_pic_order_cnt_cycle; i++) {
-      WRITE_SE (bs, seq_param->offset_for_ref_frame[i]);
-    }
-  }
-
-  /* num_ref_frames */
-  WRITE_UE (bs, seq_param->max_num_ref_frames);
-  /* gaps_in_frame_num_value_allowed_flag */
-  WRITE_UINT32 (bs, gaps_in_frame_num_value_allowed_flag, 1);
-
-  /* pic_width_in_mbs_minus1 */
-  WRITE_UE (bs, seq_param->picture_width_in_mbs - 1);
-  /* pic_height_in_map_units_minus1 */
-  WRITE_UE (bs, pic_height_in_map_units - 1);
-  /* frame_mbs_only_flag */
-  WRITE_UINT32 (bs, seq_param->seq_fields.bits.frame_mbs_only_flag, 1);
-
-  if (!seq_param->seq_fields.bits.frame_mbs_only_flag) {        //ONLY mbs
-    g_assert (0 && "only progressive frames encoding is supported");
-    WRITE_UINT32 (bs, mb_adaptive_frame_field, 1);
-  }
-
-  /* direct_8x8_inference_flag */
-  WRITE_UINT32 (bs, 0, 1);
-  /* frame_cropping_flag */
-  WRITE_UINT32 (bs, seq_param->frame_cropping_flag, 1);
-
-  if (seq_param->frame_cropping_flag) {
-    /* frame_crop_left_offset */
-    WRITE_UE (bs, seq_param->frame_crop_left_offset);
-    /* frame_crop_right_offset */
-    WRITE_UE (bs, seq_param->frame_crop_right_offset);
-    /* frame_crop_top_offset */
-    WRITE_UE (bs, seq_param->frame_crop_top_offset);
-    /* frame_crop_bottom_offset */
-    WRITE_UE (bs, seq_param->frame_crop_bottom_offset);
-  }
-
-  /* vui_parameters_present_flag */
-  WRITE_UINT32 (bs, seq_param->vui_parameters_present_flag, 1);
-  if (seq_param->vui_parameters_present_flag) {
-    /* aspect_ratio_info_present_flag */
-    WRITE_UINT32 (bs,
-        seq_param->vui_fields.bits.aspect_ratio_info_present_flag, 1);
-    if (seq_param->vui_fields.bits.aspect_ratio_info_present_flag) {
-      WRITE_UINT32 (bs, seq_param->aspect_ratio_idc, 8);
-      if (seq_param->aspect_ratio_idc == 0xFF) {
-        WRITE_UINT32 (bs, seq_param->sar_width, 16);
-        WRITE_UINT32 (bs, seq_param->sar_height, 16);
-      }
-    }
-
-    /* overscan_info_present_flag */
-    WRITE_UINT32 (bs, 0, 1);
-    /* video_signal_type_present_flag */
-    WRITE_UINT32 (bs, 0, 1);
-    /* chroma_loc_info_present_flag */
-    WRITE_UINT32 (bs, 0, 1);
-
-    /* timing_info_present_flag */
-    WRITE_UINT32 (bs, seq_param->vui_fields.bits.timing_info_present_flag, 1);
-    if (seq_param->vui_fields.bits.timing_info_present_flag) {
-      WRITE_UINT32 (bs, seq_param->num_units_in_tick, 32);
-      WRITE_UINT32 (bs, seq_param->time_scale, 32);
-      WRITE_UINT32 (bs, 1, 1);  /* fixed_frame_rate_flag */
-    }
-
-    /* nal_hrd_parameters_present_flag */
-    nal_hrd_parameters_present_flag = seq_param->bits_per_second > 0;
-    WRITE_UINT32 (bs, nal_hrd_parameters_present_flag, 1);
-    if (nal_hrd_parameters_present_flag) {
-      /* hrd_parameters */
-      /* cpb_cnt_minus1 */
-      WRITE_UE (bs, 0);
-      WRITE_UINT32 (bs, SX_BITRATE - 6, 4);     /* bit_rate_scale */
-      WRITE_UINT32 (bs, SX_CPB_SIZE - 4, 4);    /* cpb_size_scale */
-
-      for (i = 0; i < 1; ++i) {
-        /* bit_rate_value_minus1[0] */
-        WRITE_UE (bs, (seq_param->bits_per_second >> SX_BITRATE) - 1);
-        /* cpb_size_value_minus1[0] */
-        WRITE_UE (bs, (hrd_params->buffer_size >> SX_CPB_SIZE) - 1);
-        /* cbr_flag[0] */
-        WRITE_UINT32 (bs, 1, 1);
-      }
-      /* initial_cpb_removal_delay_length_minus1 */
-      WRITE_UINT32 (bs, 23, 5);
-      /* cpb_removal_delay_length_minus1 */
-      WRITE_UINT32 (bs, 23, 5);
-      /* dpb_output_delay_length_minus1 */
-      WRITE_UINT32 (bs, 23, 5);
-      /* time_offset_length  */
-      WRITE_UINT32 (bs, 23, 5);
-    }
-
-    /* vcl_hrd_parameters_present_flag */
-    WRITE_UINT32 (bs, 0, 1);
-
-    if (nal_hrd_parameters_present_flag
-        || 0 /*vcl_hrd_parameters_present_flag */ ) {
-      /* low_delay_hrd_flag */
-      WRITE_UINT32 (bs, 0, 1);
-    }
-    /* pic_struct_present_flag */
-    WRITE_UINT32 (bs, 1, 1);
-    /* bs_restriction_flag */
-    WRITE_UINT32 (bs, 0, 1);
-  }
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write SPS NAL unit");
-    return FALSE;
-  }
-}
-
-static gboolean
-bs_write_sps (GstBitWriter * bs,
-    const VAEncSequenceParameterBufferH264 * seq_param, GstVaapiProfile profile,
-    const VAEncMiscParameterHRD * hrd_params)
-{
-  if (!bs_write_sps_data (bs, seq_param, profile, hrd_params))
-    return FALSE;
-
-  /* rbsp_trailing_bits */
-  bs_write_trailing_bits (bs);
-
-  return FALSE;
-}
-
-static gboolean
-bs_write_subset_sps (GstBitWriter * bs,
-    const VAEncSequenceParameterBufferH264 * seq_param, GstVaapiProfile profile,
-    guint num_views, guint16 * view_ids,
-    const VAEncMiscParameterHRD * hrd_params)
-{
-  guint32 i, j, k;
-
-  if (!bs_write_sps_data (bs, seq_param, profile, hrd_params))
-    return FALSE;
-
-  if (profile == GST_VAAPI_PROFILE_H264_STEREO_HIGH ||
-      profile == GST_VAAPI_PROFILE_H264_MULTIVIEW_HIGH) {
-    guint32 num_views_minus1, num_level_values_signalled_minus1;
-
-    num_views_minus1 = num_views - 1;
-    g_assert (num_views_minus1 < 1024);
-
-    /* bit equal to one */
-    WRITE_UINT32 (bs, 1, 1);
-
-    WRITE_UE (bs, num_views_minus1);
-
-    for (i = 0; i <= num_views_minus1; i++)
-      WRITE_UE (bs, view_ids[i]);
-
-    for (i = 1; i <= num_views_minus1; i++) {
-      guint32 num_anchor_refs_l0 = 0;
-      guint32 num_anchor_refs_l1 = 0;
-
-      WRITE_UE (bs, num_anchor_refs_l0);
-      for (j = 0; j < num_anchor_refs_l0; j++)
-        WRITE_UE (bs, 0);
-
-      WRITE_UE (bs, num_anchor_refs_l1);
-      for (j = 0; j < num_anchor_refs_l1; j++)
-        WRITE_UE (bs, 0);
-    }
-
-    for (i = 1; i <= num_views_minus1; i++) {
-      guint32 num_non_anchor_refs_l0 = 0;
-      guint32 num_non_anchor_refs_l1 = 0;
-
-      WRITE_UE (bs, num_non_anchor_refs_l0);
-      for (j = 0; j < num_non_anchor_refs_l0; j++)
-        WRITE_UE (bs, 0);
-
-      WRITE_UE (bs, num_non_anchor_refs_l1);
-      for (j = 0; j < num_non_anchor_refs_l1; j++)
-        WRITE_UE (bs, 0);
-    }
-
-    /* num level values signalled minus1 */
-    num_level_values_signalled_minus1 = 0;
-    g_assert (num_level_values_signalled_minus1 < 64);
-    WRITE_UE (bs, num_level_values_signalled_minus1);
-
-    for (i = 0; i <= num_level_values_signalled_minus1; i++) {
-      guint16 num_applicable_ops_minus1 = 0;
-      g_assert (num_applicable_ops_minus1 < 1024);
-
-      WRITE_UINT32 (bs, seq_param->level_idc, 8);
-      WRITE_UE (bs, num_applicable_ops_minus1);
-
-      for (j = 0; j <= num_applicable_ops_minus1; j++) {
-        guint8 temporal_id = 0;
-        guint16 num_target_views_minus1 = 1;
-
-        WRITE_UINT32 (bs, temporal_id, 3);
-        WRITE_UE (bs, num_target_views_minus1);
-
-        for (k = 0; k <= num_target_views_minus1; k++)
-          WRITE_UE (bs, k);
-
-        WRITE_UE (bs, num_views_minus1);
-      }
-    }
-
-    /* mvc_vui_parameters_present_flag */
-    WRITE_UINT32 (bs, 0, 1);
-  }
-
-  /* additional_extension2_flag */
-  WRITE_UINT32 (bs, 0, 1);
-
-  /* rbsp_trailing_bits */
-  bs_write_trailing_bits (bs);
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write subset SPS NAL unit");
-    return FALSE;
-  }
-  return FALSE;
-}
-
-/* Write a PPS NAL unit */
-static gboolean
-bs_write_pps (GstBitWriter * bs,
-    const VAEncPictureParameterBufferH264 * pic_param, GstVaapiProfile profile)
-{
-  guint32 num_slice_groups_minus1 = 0;
-  guint32 pic_init_qs_minus26 = 0;
-  guint32 redundant_pic_cnt_present_flag = 0;
-
-  /* pic_parameter_set_id */
-  WRITE_UE (bs, pic_param->pic_parameter_set_id);
-  /* seq_parameter_set_id */
-  WRITE_UE (bs, pic_param->seq_parameter_set_id);
-  /* entropy_coding_mode_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.entropy_coding_mode_flag, 1);
-  /* pic_order_present_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.pic_order_present_flag, 1);
-  /* slice_groups-1 */
-  WRITE_UE (bs, num_slice_groups_minus1);
-
-  if (num_slice_groups_minus1 > 0) {
-     /*FIXME*/ g_assert (0 && "unsupported arbitrary slice ordering (ASO)");
-  }
-  WRITE_UE (bs, pic_param->num_ref_idx_l0_active_minus1);
-  WRITE_UE (bs, pic_param->num_ref_idx_l1_active_minus1);
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.weighted_pred_flag, 1);
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.weighted_bipred_idc, 2);
-  /* pic_init_qp_minus26 */
-  WRITE_SE (bs, pic_param->pic_init_qp - 26);
-  /* pic_init_qs_minus26 */
-  WRITE_SE (bs, pic_init_qs_minus26);
-  /* chroma_qp_index_offset */
-  WRITE_SE (bs, pic_param->chroma_qp_index_offset);
-
-  WRITE_UINT32 (bs,
-      pic_param->pic_fields.bits.deblocking_filter_control_present_flag, 1);
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.constrained_intra_pred_flag, 1);
-  WRITE_UINT32 (bs, redundant_pic_cnt_present_flag, 1);
-
-  /* more_rbsp_data */
-  if (profile == GST_VAAPI_PROFILE_H264_HIGH
-      || profile == GST_VAAPI_PROFILE_H264_MULTIVIEW_HIGH
-      || profile == GST_VAAPI_PROFILE_H264_STEREO_HIGH) {
-    WRITE_UINT32 (bs, pic_param->pic_fields.bits.transform_8x8_mode_flag, 1);
-    WRITE_UINT32 (bs,
-        pic_param->pic_fields.bits.pic_scaling_matrix_present_flag, 1);
-    if (pic_param->pic_fields.bits.pic_scaling_matrix_present_flag) {
-      g_assert (0 && "unsupported scaling lists");
-      /* FIXME */
-      /*
-         for (i = 0; i <
-         (6+(-( (chroma_format_idc ! = 3) ? 2 : 6) * -pic_param->pic_fields.bits.transform_8x8_mode_flag));
-         i++) {
-         gst_bit_writer_put_bits_uint8(bs, pic_param->pic_fields.bits.pic_scaling_list_present_flag, 1);
-         }
-       */
-    }
-    WRITE_SE (bs, pic_param->second_chroma_qp_index_offset);
-  }
-
-  /* rbsp_trailing_bits */
-  bs_write_trailing_bits (bs);
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write PPS NAL unit");
-    return FALSE;
-  }
-}
-
 /* ------------------------------------------------------------------------- */
 /* --- H.264 Encoder                                                     --- */
 /* ------------------------------------------------------------------------- */
@@ -704,6 +287,11 @@ struct _GstVaapiEncoderH264
   GstBuffer *subset_sps_data;
   GstBuffer *pps_data;
 
+  /* packed headers, only regenerated when their syntax elements change */
+  GstVaapiH26xHeaderTemplate pps_tmpls[MAX_NUM_VIEWS];
+  GstVaapiH26xHeaderTemplate *slice_tmpls;
+  guint num_slice_tmpls;
+
   guint bitrate_bits;           // bitrate (bits)
   guint cpb_length;             // length of CPB buffer (ms)
   guint cpb_length_bits;        // length of CPB buffer (bits)
@@ -807,124 +395,6 @@ bs_error:
   }
 }
 
-/* Write a Slice NAL unit */
-static gboolean
-bs_write_slice (GstBitWriter * bs,
-    const VAEncSliceParameterBufferH264 * slice_param,
-    GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture)
-{
-  const VAEncPictureParameterBufferH264 *const pic_param = picture->param;
-  guint32 field_pic_flag = 0;
-  guint32 ref_pic_list_modification_flag_l0 = 0;
-  guint32 ref_pic_list_modification_flag_l1 = 0;
-  guint32 no_output_of_prior_pics_flag = 0;
-  guint32 long_term_reference_flag = 0;
-  guint32 adaptive_ref_pic_marking_mode_flag = 0;
-
-  /* first_mb_in_slice */
-  WRITE_UE (bs, slice_param->macroblock_address);
-  /* slice_type */
-  WRITE_UE (bs, slice_param->slice_type);
-  /* pic_parameter_set_id */
-  WRITE_UE (bs, slice_param->pic_parameter_set_id);
-  /* frame_num */
-  WRITE_UINT32 (bs, picture->frame_num, encoder->log2_max_frame_num);
-
-  /* XXX: only frames (i.e. non-interlaced) are supported for now */
-  /* frame_mbs_only_flag == 0 */
-
-  /* idr_pic_id */
-  if (GST_VAAPI_ENC_PICTURE_IS_IDR (picture))
-    WRITE_UE (bs, slice_param->idr_pic_id);
-
-  /* XXX: only POC type 0 is supported */
-  if (!encoder->pic_order_cnt_type) {
-    WRITE_UINT32 (bs, slice_param->pic_order_cnt_lsb,
-        encoder->log2_max_pic_order_cnt);
-    /* bottom_field_pic_order_in_frame_present_flag is FALSE */
-    if (pic_param->pic_fields.bits.pic_order_present_flag && !field_pic_flag)
-      WRITE_SE (bs, slice_param->delta_pic_order_cnt_bottom);
-  } else if (encoder->pic_order_cnt_type == 1 &&
-      !encoder->delta_pic_order_always_zero_flag) {
-    WRITE_SE (bs, slice_param->delta_pic_order_cnt[0]);
-    if (pic_param->pic_fields.bits.pic_order_present_flag && !field_pic_flag)
-      WRITE_SE (bs, slice_param->delta_pic_order_cnt[1]);
-  }
-  /* redundant_pic_cnt_present_flag is FALSE, no redundant coded pictures */
-
-  /* only works for B-frames */
-  if (slice_param->slice_type == 1)
-    WRITE_UINT32 (bs, slice_param->direct_spatial_mv_pred_flag, 1);
-
-  /* not supporting SP slices */
-  if (slice_param->slice_type == 0 || slice_param->slice_type == 1) {
-    WRITE_UINT32 (bs, slice_param->num_ref_idx_active_override_flag, 1);
-    if (slice_param->num_ref_idx_active_override_flag) {
-      WRITE_UE (bs, slice_param->num_ref_idx_l0_active_minus1);
-      if (slice_param->slice_type == 1)
-        WRITE_UE (bs, slice_param->num_ref_idx_l1_active_minus1);
-    }
-  }
-  /* XXX: not supporting custom reference picture list modifications */
-  if ((slice_param->slice_type != 2) && (slice_param->slice_type != 4))
-    WRITE_UINT32 (bs, ref_pic_list_modification_flag_l0, 1);
-  if (slice_param->slice_type == 1)
-    WRITE_UINT32 (bs, ref_pic_list_modification_flag_l1, 1);
-
-  /* we have: weighted_pred_flag == FALSE and */
-  /*        : weighted_bipred_idc == FALSE */
-  if ((pic_param->pic_fields.bits.weighted_pred_flag &&
-          (slice_param->slice_type == 0)) ||
-      ((pic_param->pic_fields.bits.weighted_bipred_idc == 1) &&
-          (slice_param->slice_type == 1))) {
-    /* XXXX: add pred_weight_table() */
-  }
-
-  /* dec_ref_pic_marking() */
-  if (slice_param->slice_type == 0 || slice_param->slice_type == 2) {
-    if (GST_VAAPI_ENC_PICTURE_IS_IDR (picture)) {
-      /* no_output_of_prior_pics_flag = 0 */
-      WRITE_UINT32 (bs, no_output_of_prior_pics_flag, 1);
-      /* long_term_reference_flag = 0 */
-      WRITE_UINT32 (bs, long_term_reference_flag, 1);
-    } else {
-      /* only sliding_window reference picture marking mode is supported */
-      /* adpative_ref_pic_marking_mode_flag = 0 */
-      WRITE_UINT32 (bs, adaptive_ref_pic_marking_mode_flag, 1);
-    }
-  }
-
-  /* cabac_init_idc */
-  if (pic_param->pic_fields.bits.entropy_coding_mode_flag &&
-      slice_param->slice_type != 2)
-    WRITE_UE (bs, slice_param->cabac_init_idc);
-  /*slice_qp_delta */
-  WRITE_SE (bs, slice_param->slice_qp_delta);
-
-  /* XXX: only supporting I, P and B type slices */
-  /* no sp_for_switch_flag and no slice_qs_delta */
-
-  if (pic_param->pic_fields.bits.deblocking_filter_control_present_flag) {
-    /* disable_deblocking_filter_idc */
-    WRITE_UE (bs, slice_param->disable_deblocking_filter_idc);
-    if (slice_param->disable_deblocking_filter_idc != 1) {
-      WRITE_SE (bs, slice_param->slice_alpha_c0_offset_div2);
-      WRITE_SE (bs, slice_param->slice_beta_offset_div2);
-    }
-  }
-
-  /* XXX: unsupported arbitrary slice ordering (ASO) */
-  /* num_slic_groups_minus1 should be zero */
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write Slice NAL unit");
-    return FALSE;
-  }
-}
-
 static inline void
 _check_sps_pps_status (GstVaapiEncoderH264 * encoder,
     const guint8 * nal, guint32 size)
@@ -1310,7 +780,7 @@ add_packed_sequence_header (GstVaapiEncoderH264 * encoder,
       profile == GST_VAAPI_PROFILE_H264_STEREO_HIGH)
     profile = GST_VAAPI_PROFILE_H264_HIGH;
 
-  bs_write_sps (&bs, seq_param, profile, &hrd_params);
+  gst_vaapi_utils_h264_write_sps (&bs, seq_param, profile, &hrd_params);
 
   g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
   data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
@@ -1361,8 +831,8 @@ add_packed_sequence_header_mvc (GstVaapiEncoderH264 * encoder,
   WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
   bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_HIGH, GST_H264_NAL_SUBSET_SPS);
 
-  bs_write_subset_sps (&bs, seq_param, encoder->profile, encoder->num_views,
-      encoder->view_ids, &hrd_params);
+  gst_vaapi_utils_h264_write_subset_sps (&bs, seq_param, encoder->profile,
+      encoder->num_views, encoder->view_ids, &hrd_params);
 
   g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
   data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
@@ -1394,6 +864,44 @@ bs_error:
   }
 }
 
+/* The syntax elements a PPS is generated from */
+typedef struct
+{
+  guint32 pic_fields;
+  guint32 profile;
+  guint8 pic_parameter_set_id;
+  guint8 seq_parameter_set_id;
+  guint8 num_ref_idx_l0_active_minus1;
+  guint8 num_ref_idx_l1_active_minus1;
+  guint8 pic_init_qp;
+  gint8 chroma_qp_index_offset;
+  gint8 second_chroma_qp_index_offset;
+} PpsTemplateKey;
+
+static void
+fill_pps_template_key (PpsTemplateKey * key,
+    const VAEncPictureParameterBufferH264 * pic_param, GstVaapiProfile profile)
+{
+  VAEncPictureParameterBufferH264 masked;
+
+  /* clear the per-picture flags, which are not part of the PPS */
+  masked.pic_fields.value = pic_param->pic_fields.value;
+  masked.pic_fields.bits.idr_pic_flag = 0;
+  masked.pic_fields.bits.reference_pic_flag = 0;
+
+  memset (key, 0, sizeof (*key));
+  key->pic_fields = masked.pic_fields.value;
+  key->profile = profile;
+  key->pic_parameter_set_id = pic_param->pic_parameter_set_id;
+  key->seq_parameter_set_id = pic_param->seq_parameter_set_id;
+  key->num_ref_idx_l0_active_minus1 = pic_param->num_ref_idx_l0_active_minus1;
+  key->num_ref_idx_l1_active_minus1 = pic_param->num_ref_idx_l1_active_minus1;
+  key->pic_init_qp = pic_param->pic_init_qp;
+  key->chroma_qp_index_offset = pic_param->chroma_qp_index_offset;
+  key->second_chroma_qp_index_offset =
+      pic_param->second_chroma_qp_index_offset;
+}
+
 /* Adds the supplied picture header (PPS) to the list of packed
    headers to pass down as-is to the encoder */
 static gboolean
@@ -1404,16 +912,28 @@ add_packed_picture_header (GstVaapiEncoderH264 * encoder,
   GstBitWriter bs;
   VAEncPackedHeaderParameterBuffer packed_pic_param = { 0 };
   const VAEncPictureParameterBufferH264 *const pic_param = picture->param;
+  GstVaapiH26xHeaderTemplate *const tmpl =
+      &encoder->pps_tmpls[encoder->view_idx];
+  PpsTemplateKey key;
   guint32 data_bit_size;
   guint8 *data;
 
-  gst_bit_writer_init (&bs, 128 * 8);
-  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
-  bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_HIGH, GST_H264_NAL_PPS);
-  bs_write_pps (&bs, pic_param, encoder->profile);
-  g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  /* The PPS only changes along with the encoder configuration */
+  fill_pps_template_key (&key, pic_param, encoder->profile);
+  if (!gst_vaapi_utils_h26x_header_template_match (tmpl, &key, sizeof (key))) {
+    gst_bit_writer_init (&bs, 128 * 8);
+    WRITE_UINT32 (&bs, 0x00000001, 32); /* start code */
+    bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_HIGH, GST_H264_NAL_PPS);
+    gst_vaapi_utils_h264_write_pps (&bs, pic_param, encoder->profile);
+    g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
+
+    gst_vaapi_utils_h26x_header_template_reset (tmpl, &key, sizeof (key));
+    gst_vaapi_utils_h26x_header_template_set_data (tmpl,
+        GST_BIT_WRITER_DATA (&bs), GST_BIT_WRITER_BIT_SIZE (&bs));
+    gst_bit_writer_clear (&bs, TRUE);
+  }
+  data_bit_size = tmpl->bit_size;
+  data = tmpl->data;
 
   packed_pic_param.type = VAEncPackedHeaderPicture;
   packed_pic_param.bit_length = data_bit_size;
@@ -1429,7 +949,6 @@ add_packed_picture_header (GstVaapiEncoderH264 * encoder,
 
   /* store pps data */
   _check_sps_pps_status (encoder, data + 4, data_bit_size / 8 - 4);
-  gst_bit_writer_clear (&bs, TRUE);
   return TRUE;
 
   /* ERRORS */
@@ -1612,36 +1131,168 @@ bs_error:
   }
 }
 
+/* The syntax elements a slice header template is generated from */
+typedef struct
+{
+  guint32 pic_fields;
+  guint32 macroblock_address;
+  guint8 nal_ref_idc;
+  guint8 nal_unit_type;
+  guint8 slice_type;
+  guint8 pic_parameter_set_id;
+  guint8 direct_spatial_mv_pred_flag;
+  guint8 num_ref_idx_active_override_flag;
+  guint8 num_ref_idx_l0_active_minus1;
+  guint8 num_ref_idx_l1_active_minus1;
+  guint8 cabac_init_idc;
+  gint8 slice_qp_delta;
+  guint8 disable_deblocking_filter_idc;
+  gint8 slice_alpha_c0_offset_div2;
+  gint8 slice_beta_offset_div2;
+  guint8 log2_max_frame_num;
+  guint8 log2_max_pic_order_cnt;
+} SliceTemplateKey;
+
+static void
+fill_slice_template_key (SliceTemplateKey * key,
+    GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture,
+    const VAEncSliceParameterBufferH264 * slice_param, guint8 nal_ref_idc,
+    guint8 nal_unit_type)
+{
+  const VAEncPictureParameterBufferH264 *const pic_param = picture->param;
+  VAEncPictureParameterBufferH264 masked;
+
+  /* the reference flag is already covered by nal_ref_idc */
+  masked.pic_fields.value = pic_param->pic_fields.value;
+  masked.pic_fields.bits.reference_pic_flag = 0;
+
+  memset (key, 0, sizeof (*key));
+  key->pic_fields = masked.pic_fields.value;
+  key->macroblock_address = slice_param->macroblock_address;
+  key->nal_ref_idc = nal_ref_idc;
+  key->nal_unit_type = nal_unit_type;
+  key->slice_type = slice_param->slice_type;
+  key->pic_parameter_set_id = slice_param->pic_parameter_set_id;
+  key->direct_spatial_mv_pred_flag = slice_param->direct_spatial_mv_pred_flag;
+  key->num_ref_idx_active_override_flag =
+      slice_param->num_ref_idx_active_override_flag;
+  key->num_ref_idx_l0_active_minus1 = slice_param->num_ref_idx_l0_active_minus1;
+  key->num_ref_idx_l1_active_minus1 = slice_param->num_ref_idx_l1_active_minus1;
+  key->cabac_init_idc = slice_param->cabac_init_idc;
+  key->slice_qp_delta = slice_param->slice_qp_delta;
+  key->disable_deblocking_filter_idc =
+      slice_param->disable_deblocking_filter_idc;
+  key->slice_alpha_c0_offset_div2 = slice_param->slice_alpha_c0_offset_div2;
+  key->slice_beta_offset_div2 = slice_param->slice_beta_offset_div2;
+  key->log2_max_frame_num = encoder->log2_max_frame_num;
+  key->log2_max_pic_order_cnt = encoder->log2_max_pic_order_cnt;
+}
+
+/* Looks up the template of the slice header at @slice_index, for the
+   type of the supplied picture. Only the frame_num and POC LSB fields
+   vary between non-IDR pictures of the same type, as long as the POC
+   type is 0 and the bottom field POC is not signalled. IDR slices
+   carry a variable-length idr_pic_id, so they are always written */
+static GstVaapiH26xHeaderTemplate *
+get_slice_header_template (GstVaapiEncoderH264 * encoder,
+    GstVaapiEncPicture * picture, guint slice_index)
+{
+  const VAEncPictureParameterBufferH264 *const pic_param = picture->param;
+  guint i, num_tmpls;
+
+  if (encoder->is_mvc || GST_VAAPI_ENC_PICTURE_IS_IDR (picture) ||
+      encoder->pic_order_cnt_type != 0 ||
+      pic_param->pic_fields.bits.pic_order_present_flag)
+    return NULL;
+
+  /* one template per slice and per slice type (P, B, I) */
+  num_tmpls = (slice_index + 1) * 3;
+  if (num_tmpls > encoder->num_slice_tmpls) {
+    encoder->slice_tmpls = g_renew (GstVaapiH26xHeaderTemplate,
+        encoder->slice_tmpls, num_tmpls);
+    for (i = encoder->num_slice_tmpls; i < num_tmpls; i++)
+      memset (&encoder->slice_tmpls[i], 0, sizeof (encoder->slice_tmpls[i]));
+    encoder->num_slice_tmpls = num_tmpls;
+  }
+  return &encoder->slice_tmpls[slice_index * 3 +
+      h264_get_slice_type (picture->type)];
+}
+
+static void
+reset_header_templates (GstVaapiEncoderH264 * encoder)
+{
+  guint i;
+
+  for (i = 0; i < MAX_NUM_VIEWS; i++)
+    gst_vaapi_utils_h26x_header_template_clear (&encoder->pps_tmpls[i]);
+  for (i = 0; i < encoder->num_slice_tmpls; i++)
+    gst_vaapi_utils_h26x_header_template_clear (&encoder->slice_tmpls[i]);
+  g_free (encoder->slice_tmpls);
+  encoder->slice_tmpls = NULL;
+  encoder->num_slice_tmpls = 0;
+}
+
 /* Adds the supplied slice header to the list of packed
    headers to pass down as-is to the encoder */
 static gboolean
 add_packed_slice_header (GstVaapiEncoderH264 * encoder,
-    GstVaapiEncPicture * picture, GstVaapiEncSlice * slice)
+    GstVaapiEncPicture * picture, GstVaapiEncSlice * slice, guint slice_index)
 {
   GstVaapiEncPackedHeader *packed_slice;
   GstBitWriter bs;
   VAEncPackedHeaderParameterBuffer packed_slice_param = { 0 };
   const VAEncSliceParameterBufferH264 *const slice_param = slice->param;
+  GstVaapiH26xHeaderTemplate *tmpl;
+  SliceTemplateKey key;
   guint32 data_bit_size;
   guint8 *data;
   guint8 nal_ref_idc, nal_unit_type;
 
-  gst_bit_writer_init (&bs, 128 * 8);
-  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
+  gst_bit_writer_init (&bs, 0);
 
   if (!get_nal_hdr_attributes (picture, &nal_ref_idc, &nal_unit_type))
     goto bs_error;
-  /* pack nal_unit_header_mvc_extension() for the non base view */
-  if (encoder->is_mvc && encoder->view_idx) {
-    bs_write_nal_header (&bs, nal_ref_idc, GST_H264_NAL_SLICE_EXT);
-    bs_write_nal_header_mvc_extension (&bs, picture,
-        encoder->view_ids[encoder->view_idx]);
-  } else
-    bs_write_nal_header (&bs, nal_ref_idc, nal_unit_type);
 
-  bs_write_slice (&bs, slice_param, encoder, picture);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  tmpl = get_slice_header_template (encoder, picture, slice_index);
+  if (tmpl) {
+    fill_slice_template_key (&key, encoder, picture, slice_param,
+        nal_ref_idc, nal_unit_type);
+    if (!gst_vaapi_utils_h26x_header_template_match (tmpl, &key,
+            sizeof (key)))
+      gst_vaapi_utils_h26x_header_template_reset (tmpl, &key, sizeof (key));
+  }
+
+  if (tmpl && tmpl->data) {
+    gst_vaapi_utils_h26x_header_template_patch (tmpl,
+        GST_VAAPI_H264_SLICE_TMPL_FIELD_FRAME_NUM, picture->frame_num);
+    gst_vaapi_utils_h26x_header_template_patch (tmpl,
+        GST_VAAPI_H264_SLICE_TMPL_FIELD_POC_LSB,
+        slice_param->pic_order_cnt_lsb);
+    data_bit_size = tmpl->bit_size;
+    data = tmpl->data;
+  } else {
+    gst_bit_writer_init (&bs, 128 * 8);
+    WRITE_UINT32 (&bs, 0x00000001, 32); /* start code */
+
+    /* pack nal_unit_header_mvc_extension() for the non base view */
+    if (encoder->is_mvc && encoder->view_idx) {
+      bs_write_nal_header (&bs, nal_ref_idc, GST_H264_NAL_SLICE_EXT);
+      bs_write_nal_header_mvc_extension (&bs, picture,
+          encoder->view_ids[encoder->view_idx]);
+    } else
+      bs_write_nal_header (&bs, nal_ref_idc, nal_unit_type);
+
+    gst_vaapi_utils_h264_write_slice_header (&bs, picture->param,
+        slice_param, encoder->log2_max_frame_num,
+        encoder->log2_max_pic_order_cnt, encoder->pic_order_cnt_type,
+        encoder->delta_pic_order_always_zero_flag, tmpl);
+    data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
+    data = GST_BIT_WRITER_DATA (&bs);
+
+    if (tmpl)
+      gst_vaapi_utils_h26x_header_template_set_data (tmpl, data,
+          data_bit_size);
+  }
 
   packed_slice_param.type = VAEncPackedHeaderSlice;
   packed_slice_param.bit_length = data_bit_size;
@@ -1776,6 +1427,7 @@ fill_sequence (GstVaapiEncoderH264 * encoder, GstVaapiEncSequence * sequence)
   VAEncSequenceParameterBufferH264 *const seq_param = sequence->param;
   GstVaapiH264ViewRefPool *const ref_pool =
       &encoder->ref_pools[encoder->view_idx];
+  GstVaapiRectangle crop_rect;
 
   memset (seq_param, 0, sizeof (VAEncSequenceParameterBufferH264));
   seq_param->seq_parameter_set_id = encoder->view_idx;
@@ -1823,9 +1475,13 @@ fill_sequence (GstVaapiEncoderH264 * encoder, GstVaapiEncSequence * sequence)
         sizeof (seq_param->offset_for_ref_frame));
   }
 
-  /* frame_cropping_flag */
-  if ((GST_VAAPI_ENCODER_WIDTH (encoder) & 15) ||
-      (GST_VAAPI_ENCODER_HEIGHT (encoder) & 15)) {
+  /* frame_cropping_flag: the macroblock alignment padding, and the
+     region of the frames to display, if any */
+  gst_vaapi_encoder_get_crop_rect (GST_VAAPI_ENCODER_CAST (encoder),
+      &crop_rect);
+  if (crop_rect.x != 0 || crop_rect.y != 0 ||
+      crop_rect.x + crop_rect.width != 16 * encoder->mb_width ||
+      crop_rect.y + crop_rect.height != 16 * encoder->mb_height) {
     static const guint SubWidthC[] = { 1, 2, 2, 1 };
     static const guint SubHeightC[] = { 1, 2, 1, 1 };
     const guint CropUnitX =
@@ -1835,14 +1491,14 @@ fill_sequence (GstVaapiEncoderH264 * encoder, GstVaapiEncSequence * sequence)
         (2 - seq_param->seq_fields.bits.frame_mbs_only_flag);
 
     seq_param->frame_cropping_flag = 1;
-    seq_param->frame_crop_left_offset = 0;
+    seq_param->frame_crop_left_offset = crop_rect.x / CropUnitX;
     seq_param->frame_crop_right_offset =
         (16 * encoder->mb_width -
-        GST_VAAPI_ENCODER_WIDTH (encoder)) / CropUnitX;
-    seq_param->frame_crop_top_offset = 0;
+        (crop_rect.x + crop_rect.width)) / CropUnitX;
+    seq_param->frame_crop_top_offset = crop_rect.y / CropUnitY;
     seq_param->frame_crop_bottom_offset =
         (16 * encoder->mb_height -
-        GST_VAAPI_ENCODER_HEIGHT (encoder)) / CropUnitY;
+        (crop_rect.y + crop_rect.height)) / CropUnitY;
   }
 
   /* VUI parameters are always set, at least for timing_info (framerate) */
@@ -2079,7 +1735,7 @@ add_slice_headers (GstVaapiEncoderH264 * encoder, GstVaapiEncPicture * picture,
       goto error_create_packed_prefix_nal_hdr;
     if ((GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
             VA_ENC_PACKED_HEADER_SLICE)
-        && !add_packed_slice_header (encoder, picture, slice))
+        && !add_packed_slice_header (encoder, picture, slice, i_slice))
       goto error_create_packed_slice_hdr;
 
     gst_vaapi_enc_picture_add_slice (picture, slice);
@@ -2799,6 +2455,11 @@ gst_vaapi_encoder_h264_reconfigure (GstVaapiEncoder * base_encoder)
     return status;
 
   reset_properties (encoder);
+
+  /* Every picture is an I-frame, and views don't depend on each other */
+  base_encoder->intra_only =
+      base_encoder->keyframe_period == 1 && !encoder->is_mvc;
+
   return set_context_info (base_encoder);
 }
 
@@ -2854,6 +2515,7 @@ gst_vaapi_encoder_h264_finalize (GstVaapiEncoder * base_encoder)
   gst_buffer_replace (&encoder->sps_data, NULL);
   gst_buffer_replace (&encoder->subset_sps_data, NULL);
   gst_buffer_replace (&encoder->pps_data, NULL);
+  reset_header_templates (encoder);
 
   /* reference list info de-init */
   for (i = 0; i < MAX_NUM_VIEWS; i++) {
@@ -3092,6 +2754,7 @@ gst_vaapi_encoder_h264_get_default_properties (void)
               G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS),
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  props = gst_vaapi_encoder_properties_append_num_contexts (props);
   return props;
 }
 
@@ -21,7 +21,6 @@
  */
 
 #include "sysdeps.h"
-#include <math.h>
 #include <va/va.h>
 #include <va/va_enc_hevc.h>
 #include <gst/base/gstbitwriter.h>
@@ -31,6 +30,8 @@
 #include "gstvaapiencoder_h265.h"
 #include "gstvaapiutils_h265.h"
 #include "gstvaapiutils_h265_priv.h"
+#include "gstvaapiutils_h265_enc_priv.h"
+#include "gstvaapiutils_h26x.h"
 #include "gstvaapiutils_h26x_priv.h"
 #include "gstvaapicodedbufferproxy_priv.h"
 #include "gstvaapisurface.h"
@@ -127,6 +128,11 @@ struct _GstVaapiEncoderH265
   GstBuffer *sps_data;
   GstBuffer *pps_data;
 
+  /* packed headers, only regenerated when their syntax elements change */
+  GstVaapiH26xHeaderTemplate pps_tmpl;
+  GstVaapiH26xHeaderTemplate *slice_tmpls;
+  guint num_slice_tmpls;
+
   guint bitrate_bits;           // bitrate (bits)
   guint cpb_length;             // length of CPB buffer (ms)
   guint cpb_length_bits;        // length of CPB buffer (bits)
@@ -208,23 +214,6 @@ bs_error:
   }
 }
 
-/* Write the NAL unit trailing bits */
-static gboolean
-bs_write_trailing_bits (GstBitWriter * bs)
-{
-  if (!gst_bit_writer_put_bits_uint32 (bs, 1, 1))
-    goto bs_error;
-  gst_bit_writer_align_bytes_unchecked (bs, 0);
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write NAL unit trailing bits");
-    return FALSE;
-  }
-}
-
 /* Write profile_tier_level()  */
 static gboolean
 bs_write_profile_tier_level (GstBitWriter * bs,
@@ -557,254 +546,6 @@ bs_write_sps (GstBitWriter * bs, GstVaapiEncoderH265 * encoder,
   return FALSE;
 }
 
-/* Write a PPS NAL unit */
-static gboolean
-bs_write_pps (GstBitWriter * bs,
-    const VAEncPictureParameterBufferHEVC * pic_param)
-{
-  guint32 pic_parameter_set_id = 0;
-  guint32 seq_parameter_set_id = 0;
-  guint32 output_flag_present_flag = 0;
-  guint32 num_extra_slice_header_bits = 0;
-  guint32 cabac_init_present_flag = 0;
-  guint32 pps_slice_chroma_qp_offsets_present_flag = 0;
-  guint32 deblocking_filter_control_present_flag = 0;
-  guint32 lists_modification_present_flag = 0;
-  guint32 slice_segment_header_extension_present_flag = 0;
-  guint32 pps_extension_flag = 0;
-
-  /* pic_parameter_set_id */
-  WRITE_UE (bs, pic_parameter_set_id);
-  /* seq_parameter_set_id */
-  WRITE_UE (bs, seq_parameter_set_id);
-  /* dependent_slice_segments_enabled_flag */
-  WRITE_UINT32 (bs,
-      pic_param->pic_fields.bits.dependent_slice_segments_enabled_flag, 1);
-  /* output_flag_present_flag */
-  WRITE_UINT32 (bs, output_flag_present_flag, 1);
-  /* num_extra_slice_header_bits */
-  WRITE_UINT32 (bs, num_extra_slice_header_bits, 3);
-  /* sign_data_hiding_enabled_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.sign_data_hiding_enabled_flag,
-      1);
-  /* cabac_init_present_flag */
-  WRITE_UINT32 (bs, cabac_init_present_flag, 1);
-  /* num_ref_idx_l0_default_active_minus1 */
-  WRITE_UE (bs, pic_param->num_ref_idx_l0_default_active_minus1);
-  /* num_ref_idx_l1_default_active_minus1 */
-  WRITE_UE (bs, pic_param->num_ref_idx_l1_default_active_minus1);
-  /* pic_init_qp_minus26 */
-  WRITE_SE (bs, pic_param->pic_init_qp - 26);
-  /* constrained_intra_pred_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.constrained_intra_pred_flag, 1);
-  /* transform_skip_enabled_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.transform_skip_enabled_flag, 1);
-  /* cu_qp_delta_enabled_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.cu_qp_delta_enabled_flag, 1);
-  /* diff_cu_qp_delta_depth */
-  if (pic_param->pic_fields.bits.cu_qp_delta_enabled_flag)
-    WRITE_UE (bs, pic_param->diff_cu_qp_delta_depth);
-
-  /* pps_cb_qp_offset */
-  WRITE_SE (bs, pic_param->pps_cb_qp_offset);
-  /* pps_cr_qp_offset */
-  WRITE_SE (bs, pic_param->pps_cr_qp_offset);
-  /* pps_slice_chroma_qp_offsets_present_flag */
-  WRITE_UINT32 (bs, pps_slice_chroma_qp_offsets_present_flag, 1);
-  /* weighted_pred_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.weighted_pred_flag, 1);
-  /* weighted_bipred_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.weighted_bipred_flag, 1);
-  /* transquant_bypass_enabled_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.transquant_bypass_enabled_flag,
-      1);
-  /* tiles_enabled_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.tiles_enabled_flag, 1);
-  /* entropy_coding_sync_enabled_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.entropy_coding_sync_enabled_flag,
-      1);
-  /* pps_loop_filter_across_slices_enabled_flag */
-  WRITE_UINT32 (bs,
-      pic_param->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag, 1);
-  /* deblocking_filter_control_present_flag */
-  WRITE_UINT32 (bs, deblocking_filter_control_present_flag, 1);
-  /* pps_scaling_list_data_present_flag */
-  WRITE_UINT32 (bs, pic_param->pic_fields.bits.scaling_list_data_present_flag,
-      1);
-  /* lists_modification_present_flag */
-  WRITE_UINT32 (bs, lists_modification_present_flag, 1);
-  /* log2_parallel_merge_level_minus2 */
-  WRITE_UE (bs, pic_param->log2_parallel_merge_level_minus2);
-  /* slice_segment_header_extension_present_flag */
-  WRITE_UINT32 (bs, slice_segment_header_extension_present_flag, 1);
-  /* pps_extension_flag */
-  WRITE_UINT32 (bs, pps_extension_flag, 1);
-
-  /* rbsp_trailing_bits */
-  bs_write_trailing_bits (bs);
-
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write PPS NAL unit");
-    return FALSE;
-  }
-}
-
-/* Write a Slice NAL unit */
-static gboolean
-bs_write_slice (GstBitWriter * bs,
-    const VAEncSliceParameterBufferHEVC * slice_param,
-    GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture,
-    guint8 nal_unit_type)
-{
-  const VAEncPictureParameterBufferHEVC *const pic_param = picture->param;
-
-  guint8 no_output_of_prior_pics_flag = 0;
-  guint8 dependent_slice_segment_flag = 0;
-  guint8 short_term_ref_pic_set_sps_flag = 0;
-  guint8 num_ref_idx_active_override_flag = 0;
-  guint8 slice_deblocking_filter_disabled_flag = 0;
-
-  /* first_slice_segment_in_pic_flag */
-  WRITE_UINT32 (bs, encoder->first_slice_segment_in_pic_flag, 1);
-
-  /* Fixme: For all IRAP pics */
-  /* no_output_of_prior_pics_flag */
-  if (GST_VAAPI_ENC_PICTURE_IS_IDR (picture))
-    WRITE_UINT32 (bs, no_output_of_prior_pics_flag, 1);
-
-  /* slice_pic_parameter_set_id */
-  WRITE_UE (bs, slice_param->slice_pic_parameter_set_id);
-
-  /* slice_segment_address , bits_size = Ceil(Log2(PicSizeInCtbsY)) */
-  if (!encoder->first_slice_segment_in_pic_flag) {
-    guint pic_size_ctb = encoder->ctu_width * encoder->ctu_height;
-    guint bits_size = (guint) ceil ((log2 (pic_size_ctb)));
-    WRITE_UINT32 (bs, slice_param->slice_segment_address, bits_size);
-  }
-
-  if (!dependent_slice_segment_flag) {
-    /* slice_type */
-    WRITE_UE (bs, slice_param->slice_type);
-
-    if (!pic_param->pic_fields.bits.idr_pic_flag) {
-      /* slice_pic_order_cnt_lsb */
-      WRITE_UINT32 (bs, picture->poc, encoder->log2_max_pic_order_cnt);
-      /* short_term_ref_pic_set_sps_flag */
-      WRITE_UINT32 (bs, short_term_ref_pic_set_sps_flag, 1);
-
-    /*---------- Write short_term_ref_pic_set(0) ----------- */
-      {
-        guint num_positive_pics = 0, num_negative_pics = 0;
-        guint delta_poc_s0_minus1 = 0, delta_poc_s1_minus1 = 0;
-        guint used_by_curr_pic_s0_flag = 0, used_by_curr_pic_s1_flag = 0;
-
-        if (picture->type == GST_VAAPI_PICTURE_TYPE_P) {
-          num_negative_pics = 1;
-          num_positive_pics = 0;
-          delta_poc_s0_minus1 =
-              picture->poc - slice_param->ref_pic_list0[0].pic_order_cnt - 1;
-          used_by_curr_pic_s0_flag = 1;
-          delta_poc_s1_minus1 = 0;
-          used_by_curr_pic_s1_flag = 0;
-        }
-        if (picture->type == GST_VAAPI_PICTURE_TYPE_B) {
-          num_negative_pics = 1;
-          num_positive_pics = 1;
-          delta_poc_s0_minus1 =
-              picture->poc - slice_param->ref_pic_list0[0].pic_order_cnt - 1;
-          used_by_curr_pic_s0_flag = 1;
-          delta_poc_s1_minus1 =
-              slice_param->ref_pic_list1[0].pic_order_cnt - picture->poc - 1;
-          used_by_curr_pic_s1_flag = 1;
-        }
-
-        /* num_negative_pics */
-        WRITE_UE (bs, num_negative_pics);
-        /* num_positive_pics */
-        WRITE_UE (bs, num_positive_pics);
-        if (num_negative_pics) {
-          /* delta_poc_s0_minus1 */
-          WRITE_UE (bs, delta_poc_s0_minus1);
-          /* used_by_curr_pic_s0_flag */
-          WRITE_UINT32 (bs, used_by_curr_pic_s0_flag, 1);
-        }
-        if (num_positive_pics) {
-          /* delta_poc_s1_minus1 */
-          WRITE_UE (bs, delta_poc_s1_minus1);
-          /* used_by_curr_pic_s1_flag */
-          WRITE_UINT32 (bs, used_by_curr_pic_s1_flag, 1);
-        }
-      }
-
-      /* slice_temporal_mvp_enabled_flag */
-      if (encoder->sps_temporal_mvp_enabled_flag)
-        WRITE_UINT32 (bs,
-            slice_param->slice_fields.bits.slice_temporal_mvp_enabled_flag, 1);
-    }
-
-    if (encoder->sample_adaptive_offset_enabled_flag) {
-      WRITE_UINT32 (bs, slice_param->slice_fields.bits.slice_sao_luma_flag, 1);
-      WRITE_UINT32 (bs, slice_param->slice_fields.bits.slice_sao_chroma_flag,
-          1);
-    }
-
-    if (slice_param->slice_type == GST_H265_P_SLICE ||
-        slice_param->slice_type == GST_H265_B_SLICE) {
-      /* num_ref_idx_active_override_flag */
-      WRITE_UINT32 (bs, num_ref_idx_active_override_flag, 1);
-      /* mvd_l1_zero_flag */
-      if (slice_param->slice_type == GST_H265_B_SLICE)
-        WRITE_UINT32 (bs, slice_param->slice_fields.bits.mvd_l1_zero_flag, 1);
-
-      /* cabac_init_present_flag == FALSE */
-      /* cabac_init_flag  = FALSE */
-
-      /* collocated_from_l0_flag */
-      if (slice_param->slice_fields.bits.slice_temporal_mvp_enabled_flag) {
-        if (slice_param->slice_type == GST_H265_B_SLICE)
-          WRITE_UINT32 (bs,
-              slice_param->slice_fields.bits.collocated_from_l0_flag, 1);
-      }
-      /* five_minus_max_num_merge_cand */
-      WRITE_UE (bs, 5 - slice_param->max_num_merge_cand);
-    }
-
-    /* slice_qp_delta */
-    WRITE_SE (bs, slice_param->slice_qp_delta);
-    if (pic_param->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag &&
-        (slice_param->slice_fields.bits.slice_sao_luma_flag
-            || slice_param->slice_fields.bits.slice_sao_chroma_flag
-            || !slice_deblocking_filter_disabled_flag))
-      WRITE_UINT32 (bs,
-          slice_param->slice_fields.bits.
-          slice_loop_filter_across_slices_enabled_flag, 1);
-
-  }
-
-  /* byte_alignment() */
-  {
-    /* alignment_bit_equal_to_one */
-    WRITE_UINT32 (bs, 1, 1);
-    while (GST_BIT_WRITER_BIT_SIZE (bs) % 8 != 0) {
-      /* alignment_bit_equal_to_zero */
-      WRITE_UINT32 (bs, 0, 1);
-    }
-  }
-
-  return TRUE;
-
-  /* ERRORS */
-bs_error:
-  {
-    GST_WARNING ("failed to write Slice NAL unit");
-    return FALSE;
-  }
-}
-
 static inline void
 _check_vps_sps_pps_status (GstVaapiEncoderH265 * encoder,
     const guint8 * nal, guint32 size)
@@ -1208,6 +949,45 @@ bs_error:
   }
 }
 
+/* The syntax elements a PPS is generated from */
+typedef struct
+{
+  guint32 pic_fields;
+  guint8 num_ref_idx_l0_default_active_minus1;
+  guint8 num_ref_idx_l1_default_active_minus1;
+  guint8 pic_init_qp;
+  guint8 diff_cu_qp_delta_depth;
+  gint8 pps_cb_qp_offset;
+  gint8 pps_cr_qp_offset;
+  guint8 log2_parallel_merge_level_minus2;
+} PpsTemplateKey;
+
+static void
+fill_pps_template_key (PpsTemplateKey * key,
+    const VAEncPictureParameterBufferHEVC * pic_param)
+{
+  VAEncPictureParameterBufferHEVC masked;
+
+  /* clear the per-picture fields, which are not part of the PPS */
+  masked.pic_fields.value = pic_param->pic_fields.value;
+  masked.pic_fields.bits.idr_pic_flag = 0;
+  masked.pic_fields.bits.coding_type = 0;
+  masked.pic_fields.bits.reference_pic_flag = 0;
+
+  memset (key, 0, sizeof (*key));
+  key->pic_fields = masked.pic_fields.value;
+  key->num_ref_idx_l0_default_active_minus1 =
+      pic_param->num_ref_idx_l0_default_active_minus1;
+  key->num_ref_idx_l1_default_active_minus1 =
+      pic_param->num_ref_idx_l1_default_active_minus1;
+  key->pic_init_qp = pic_param->pic_init_qp;
+  key->diff_cu_qp_delta_depth = pic_param->diff_cu_qp_delta_depth;
+  key->pps_cb_qp_offset = pic_param->pps_cb_qp_offset;
+  key->pps_cr_qp_offset = pic_param->pps_cr_qp_offset;
+  key->log2_parallel_merge_level_minus2 =
+      pic_param->log2_parallel_merge_level_minus2;
+}
+
 /* Adds the supplied picture header (PPS) to the list of packed
    headers to pass down as-is to the encoder */
 static gboolean
@@ -1218,16 +998,27 @@ add_packed_picture_header (GstVaapiEncoderH265 * encoder,
   GstBitWriter bs;
   VAEncPackedHeaderParameterBuffer packed_pic_param = { 0 };
   const VAEncPictureParameterBufferHEVC *const pic_param = picture->param;
+  GstVaapiH26xHeaderTemplate *const tmpl = &encoder->pps_tmpl;
+  PpsTemplateKey key;
   guint32 data_bit_size;
   guint8 *data;
 
-  gst_bit_writer_init (&bs, 128 * 8);
-  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
-  bs_write_nal_header (&bs, GST_H265_NAL_PPS);
-  bs_write_pps (&bs, pic_param);
-  g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  /* The PPS only changes along with the encoder configuration */
+  fill_pps_template_key (&key, pic_param);
+  if (!gst_vaapi_utils_h26x_header_template_match (tmpl, &key, sizeof (key))) {
+    gst_bit_writer_init (&bs, 128 * 8);
+    WRITE_UINT32 (&bs, 0x00000001, 32); /* start code */
+    bs_write_nal_header (&bs, GST_H265_NAL_PPS);
+    gst_vaapi_utils_h265_write_pps (&bs, pic_param);
+    g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
+
+    gst_vaapi_utils_h26x_header_template_reset (tmpl, &key, sizeof (key));
+    gst_vaapi_utils_h26x_header_template_set_data (tmpl,
+        GST_BIT_WRITER_DATA (&bs), GST_BIT_WRITER_BIT_SIZE (&bs));
+    gst_bit_writer_clear (&bs, TRUE);
+  }
+  data_bit_size = tmpl->bit_size;
+  data = tmpl->data;
 
   packed_pic_param.type = VAEncPackedHeaderPicture;
   packed_pic_param.bit_length = data_bit_size;
@@ -1243,7 +1034,6 @@ add_packed_picture_header (GstVaapiEncoderH265 * encoder,
 
   /* store pps data */
   _check_vps_sps_pps_status (encoder, data + 4, data_bit_size / 8 - 4);
-  gst_bit_writer_clear (&bs, TRUE);
   return TRUE;
 
   /* ERRORS */
@@ -1277,30 +1067,147 @@ get_nal_unit_type (GstVaapiEncPicture * picture, guint8 * nal_unit_type)
   return TRUE;
 }
 
+/* The syntax elements a slice header template is generated from */
+typedef struct
+{
+  guint32 pic_fields;
+  guint32 slice_fields;
+  guint32 slice_segment_address;
+  guint32 pic_size_in_ctbs;
+  gint32 delta_poc_s0;
+  gint32 delta_poc_s1;
+  guint8 nal_unit_type;
+  guint8 slice_type;
+  guint8 slice_pic_parameter_set_id;
+  guint8 max_num_merge_cand;
+  gint8 slice_qp_delta;
+  guint8 first_slice_segment_in_pic_flag;
+  guint8 sps_temporal_mvp_enabled_flag;
+  guint8 sample_adaptive_offset_enabled_flag;
+  guint8 log2_max_pic_order_cnt;
+} SliceTemplateKey;
+
+static void
+fill_slice_template_key (SliceTemplateKey * key,
+    GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture,
+    const VAEncSliceParameterBufferHEVC * slice_param, guint8 nal_unit_type)
+{
+  const VAEncPictureParameterBufferHEVC *const pic_param = picture->param;
+  VAEncPictureParameterBufferHEVC masked;
+
+  /* the picture type is already covered by the NAL unit and slice types */
+  masked.pic_fields.value = pic_param->pic_fields.value;
+  masked.pic_fields.bits.coding_type = 0;
+  masked.pic_fields.bits.reference_pic_flag = 0;
+
+  memset (key, 0, sizeof (*key));
+  key->pic_fields = masked.pic_fields.value;
+  key->slice_fields = slice_param->slice_fields.value;
+  key->slice_segment_address = slice_param->slice_segment_address;
+  key->pic_size_in_ctbs = encoder->ctu_width * encoder->ctu_height;
+
+  /* short_term_ref_pic_set(), relative to the current picture */
+  if (picture->type != GST_VAAPI_PICTURE_TYPE_I)
+    key->delta_poc_s0 =
+        picture->poc - slice_param->ref_pic_list0[0].pic_order_cnt;
+  if (picture->type == GST_VAAPI_PICTURE_TYPE_B)
+    key->delta_poc_s1 =
+        slice_param->ref_pic_list1[0].pic_order_cnt - picture->poc;
+
+  key->nal_unit_type = nal_unit_type;
+  key->slice_type = slice_param->slice_type;
+  key->slice_pic_parameter_set_id = slice_param->slice_pic_parameter_set_id;
+  key->max_num_merge_cand = slice_param->max_num_merge_cand;
+  key->slice_qp_delta = slice_param->slice_qp_delta;
+  key->first_slice_segment_in_pic_flag =
+      encoder->first_slice_segment_in_pic_flag;
+  key->sps_temporal_mvp_enabled_flag = encoder->sps_temporal_mvp_enabled_flag;
+  key->sample_adaptive_offset_enabled_flag =
+      encoder->sample_adaptive_offset_enabled_flag;
+  key->log2_max_pic_order_cnt = encoder->log2_max_pic_order_cnt;
+}
+
+/* Looks up the template of the slice header at @slice_index, for the
+   type of the supplied picture. Only the POC LSB field varies between
+   pictures of the same type and reference structure */
+static GstVaapiH26xHeaderTemplate *
+get_slice_header_template (GstVaapiEncoderH265 * encoder,
+    GstVaapiEncPicture * picture, guint slice_index)
+{
+  guint i, num_tmpls;
+
+  /* one template per slice and per slice type (B, P, I) */
+  num_tmpls = (slice_index + 1) * 3;
+  if (num_tmpls > encoder->num_slice_tmpls) {
+    encoder->slice_tmpls = g_renew (GstVaapiH26xHeaderTemplate,
+        encoder->slice_tmpls, num_tmpls);
+    for (i = encoder->num_slice_tmpls; i < num_tmpls; i++)
+      memset (&encoder->slice_tmpls[i], 0, sizeof (encoder->slice_tmpls[i]));
+    encoder->num_slice_tmpls = num_tmpls;
+  }
+  return &encoder->slice_tmpls[slice_index * 3 +
+      h265_get_slice_type (picture->type)];
+}
+
+static void
+reset_header_templates (GstVaapiEncoderH265 * encoder)
+{
+  guint i;
+
+  gst_vaapi_utils_h26x_header_template_clear (&encoder->pps_tmpl);
+  for (i = 0; i < encoder->num_slice_tmpls; i++)
+    gst_vaapi_utils_h26x_header_template_clear (&encoder->slice_tmpls[i]);
+  g_free (encoder->slice_tmpls);
+  encoder->slice_tmpls = NULL;
+  encoder->num_slice_tmpls = 0;
+}
+
 /* Adds the supplied slice header to the list of packed
    headers to pass down as-is to the encoder */
 static gboolean
 add_packed_slice_header (GstVaapiEncoderH265 * encoder,
-    GstVaapiEncPicture * picture, GstVaapiEncSlice * slice)
+    GstVaapiEncPicture * picture, GstVaapiEncSlice * slice, guint slice_index)
 {
   GstVaapiEncPackedHeader *packed_slice;
   GstBitWriter bs;
   VAEncPackedHeaderParameterBuffer packed_slice_param = { 0 };
   const VAEncSliceParameterBufferHEVC *const slice_param = slice->param;
+  GstVaapiH26xHeaderTemplate *tmpl;
+  SliceTemplateKey key;
   guint32 data_bit_size;
   guint8 *data;
   guint8 nal_unit_type;
 
-  gst_bit_writer_init (&bs, 128 * 8);
-  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
+  gst_bit_writer_init (&bs, 0);
 
   if (!get_nal_unit_type (picture, &nal_unit_type))
     goto bs_error;
-  bs_write_nal_header (&bs, nal_unit_type);
 
-  bs_write_slice (&bs, slice_param, encoder, picture, nal_unit_type);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  tmpl = get_slice_header_template (encoder, picture, slice_index);
+  fill_slice_template_key (&key, encoder, picture, slice_param, nal_unit_type);
+  if (!gst_vaapi_utils_h26x_header_template_match (tmpl, &key, sizeof (key)))
+    gst_vaapi_utils_h26x_header_template_reset (tmpl, &key, sizeof (key));
+
+  if (tmpl->data) {
+    /* IDR slices have no POC LSB field */
+    if (tmpl->num_fields > GST_VAAPI_H265_SLICE_TMPL_FIELD_POC_LSB)
+      gst_vaapi_utils_h26x_header_template_patch (tmpl,
+          GST_VAAPI_H265_SLICE_TMPL_FIELD_POC_LSB, picture->poc);
+  } else {
+    gst_bit_writer_init (&bs, 128 * 8);
+    WRITE_UINT32 (&bs, 0x00000001, 32); /* start code */
+    bs_write_nal_header (&bs, nal_unit_type);
+    gst_vaapi_utils_h265_write_slice_header (&bs, picture->param, slice_param,
+        encoder->log2_max_pic_order_cnt,
+        encoder->ctu_width * encoder->ctu_height,
+        encoder->sps_temporal_mvp_enabled_flag,
+        encoder->sample_adaptive_offset_enabled_flag, tmpl);
+    gst_vaapi_utils_h26x_header_template_set_data (tmpl,
+        GST_BIT_WRITER_DATA (&bs), GST_BIT_WRITER_BIT_SIZE (&bs));
+    gst_bit_writer_clear (&bs, TRUE);
+  }
+  data_bit_size = tmpl->bit_size;
+  data = tmpl->data;
 
   packed_slice_param.type = VAEncPackedHeaderSlice;
   packed_slice_param.bit_length = data_bit_size;
@@ -1427,11 +1334,41 @@ reference_list_init (GstVaapiEncoderH265 * encoder,
 }
 
 /* Fills in VA sequence parameter buffer */
+/* Derives the conformance window from the CTU alignment padding, and
+   from the region of the frames to display, if any */
+static void
+ensure_conformance_window (GstVaapiEncoderH265 * encoder)
+{
+  static const guint SubWidthC[] = { 1, 2, 2, 1 };
+  static const guint SubHeightC[] = { 1, 2, 1, 1 };
+  GstVaapiRectangle crop_rect;
+
+  gst_vaapi_encoder_get_crop_rect (GST_VAAPI_ENCODER_CAST (encoder),
+      &crop_rect);
+  if (crop_rect.x == 0 && crop_rect.y == 0 &&
+      crop_rect.x + crop_rect.width == encoder->luma_width &&
+      crop_rect.y + crop_rect.height == encoder->luma_height) {
+    encoder->conformance_window_flag = 0;
+    return;
+  }
+
+  encoder->conformance_window_flag = 1;
+  encoder->conf_win_left_offset = crop_rect.x / SubWidthC[1];
+  encoder->conf_win_right_offset =
+      (encoder->luma_width - (crop_rect.x + crop_rect.width)) / SubWidthC[1];
+  encoder->conf_win_top_offset = crop_rect.y / SubHeightC[1];
+  encoder->conf_win_bottom_offset =
+      (encoder->luma_height - (crop_rect.y + crop_rect.height)) /
+      SubHeightC[1];
+}
+
 static gboolean
 fill_sequence (GstVaapiEncoderH265 * encoder, GstVaapiEncSequence * sequence)
 {
   VAEncSequenceParameterBufferHEVC *const seq_param = sequence->param;
 
+  ensure_conformance_window (encoder);
+
   memset (seq_param, 0, sizeof (VAEncSequenceParameterBufferHEVC));
 
   seq_param->general_profile_idc = encoder->profile_idc;
@@ -1683,7 +1620,7 @@ add_slice_headers (GstVaapiEncoderH265 * encoder, GstVaapiEncPicture * picture,
 
     if ((GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
             VA_ENC_PACKED_HEADER_SLICE)
-        && !add_packed_slice_header (encoder, picture, slice))
+        && !add_packed_slice_header (encoder, picture, slice, i_slice))
       goto error_create_packed_slice_hdr;
 
     gst_vaapi_enc_picture_add_slice (picture, slice);
@@ -2366,22 +2303,6 @@ gst_vaapi_encoder_h265_reconfigure (GstVaapiEncoder * base_encoder)
     encoder->ctu_width = (encoder->luma_width + 31) / 32;
     encoder->ctu_height = (encoder->luma_height + 31) / 32;
     encoder->config_changed = TRUE;
-
-    /* Frame Cropping */
-    if ((GST_VAAPI_ENCODER_WIDTH (encoder) & 31) ||
-        (GST_VAAPI_ENCODER_HEIGHT (encoder) & 31)) {
-      static const guint SubWidthC[] = { 1, 2, 2, 1 };
-      static const guint SubHeightC[] = { 1, 2, 1, 1 };
-      encoder->conformance_window_flag = 1;
-      encoder->conf_win_left_offset = 0;
-      encoder->conf_win_right_offset =
-          (encoder->luma_width -
-          GST_VAAPI_ENCODER_WIDTH (encoder)) / SubWidthC[1];
-      encoder->conf_win_top_offset = 0;
-      encoder->conf_win_bottom_offset =
-          (encoder->luma_height -
-          GST_VAAPI_ENCODER_HEIGHT (encoder)) / SubHeightC[1];
-    }
   }
 
   status = ensure_profile_tier_level (encoder);
@@ -2434,6 +2355,7 @@ gst_vaapi_encoder_h265_finalize (GstVaapiEncoder * base_encoder)
   gst_buffer_replace (&encoder->vps_data, NULL);
   gst_buffer_replace (&encoder->sps_data, NULL);
   gst_buffer_replace (&encoder->pps_data, NULL);
+  reset_header_templates (encoder);
 
   /* reference list info de-init */
   ref_pool = &encoder->ref_pool;
@@ -61,6 +61,16 @@
 #define GST_VAAPI_ENCODER_JPEG_CAST(encoder) \
     ((GstVaapiEncoderJpeg *)(encoder))
 
+/* The VA buffers holding the cached parameters, which belong to the
+   VA context they were created on */
+typedef struct
+{
+  VAContextID va_context;
+  GstVaapiEncQMatrix *q_matrix;
+  GstVaapiEncHuffmanTable *huf_table;
+  GstVaapiEncPackedHeader *packed_hdr;
+} ParamBuffers;
+
 struct _GstVaapiEncoderJpeg
 {
   GstVaapiEncoder parent_instance;
@@ -78,6 +88,16 @@ struct _GstVaapiEncoderJpeg
   gint h_max_samp;
   gint v_max_samp;
   guint n_components;
+
+  /* VA parameters and packed headers, built once for the current
+     (quality, format, size) configuration and reused for each frame,
+     along with the VA buffers holding them on each VA context */
+  VAQMatrixBufferJPEG q_matrix;
+  VAHuffmanTableBufferJPEGBaseline huf_table;
+  guint8 *packed_hdr_data;
+  guint32 packed_hdr_bit_size;
+  gboolean has_cached_params;
+  ParamBuffers param_buffers[GST_VAAPI_ENCODER_MAX_CONTEXTS];
 };
 
 /* based on upstream gst-plugins-good jpegencoder */
@@ -272,28 +292,14 @@ generate_scaled_qm (GstJpegQuantTables * quant_tables,
   }
 }
 
-static gboolean
-fill_quantization_table (GstVaapiEncoderJpeg * encoder,
-    GstVaapiEncPicture * picture)
+static void
+fill_quantization_table (GstVaapiEncoderJpeg * encoder)
 {
-  VAQMatrixBufferJPEG *q_matrix;
+  VAQMatrixBufferJPEG *const q_matrix = &encoder->q_matrix;
   int i;
 
-  g_assert (picture);
+  memset (q_matrix, 0, sizeof (*q_matrix));
 
-  picture->q_matrix = GST_VAAPI_ENC_Q_MATRIX_NEW (JPEG, encoder);
-  if (!picture->q_matrix) {
-    GST_ERROR ("failed to allocate quantiser table");
-    return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
-  }
-  q_matrix = picture->q_matrix->param;
-
-  if (!encoder->has_quant_tables) {
-    gst_jpeg_get_default_quantization_tables (&encoder->quant_tables);
-    encoder->has_quant_tables = TRUE;
-    generate_scaled_qm (&encoder->quant_tables, &encoder->scaled_quant_tables,
-        encoder->quality);
-  }
   q_matrix->load_lum_quantiser_matrix = 1;
   for (i = 0; i < GST_JPEG_MAX_QUANT_ELEMENTS; i++) {
     q_matrix->lum_quantiser_matrix[i] =
@@ -305,45 +311,20 @@ fill_quantization_table (GstVaapiEncoderJpeg * encoder,
     q_matrix->chroma_quantiser_matrix[i] =
         encoder->quant_tables.quant_tables[1].quant_table[i];
   }
-
-  return TRUE;
 }
 
-static gboolean
-ensure_quantization_table (GstVaapiEncoderJpeg * encoder,
-    GstVaapiEncPicture * picture)
-{
-  g_assert (picture);
-
-  if (!fill_quantization_table (encoder, picture))
-    return FALSE;
-
-  return TRUE;
-}
 
-static gboolean
-fill_huffman_table (GstVaapiEncoderJpeg * encoder, GstVaapiEncPicture * picture)
+static void
+fill_huffman_table (GstVaapiEncoderJpeg * encoder)
 {
-  VAHuffmanTableBufferJPEGBaseline *huffman_table;
+  VAHuffmanTableBufferJPEGBaseline *const huffman_table = &encoder->huf_table;
   guint i, num_tables;
 
-  g_assert (picture);
-
-  picture->huf_table = GST_VAAPI_ENC_HUFFMAN_TABLE_NEW (JPEGBaseline, encoder);
-  if (!picture->huf_table) {
-    GST_ERROR ("failed to allocate Huffman tables");
-    return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
-  }
-  huffman_table = picture->huf_table->param;
+  memset (huffman_table, 0, sizeof (*huffman_table));
 
   num_tables = MIN (G_N_ELEMENTS (huffman_table->huffman_table),
       GST_JPEG_MAX_SCAN_COMPONENTS);
 
-  if (!encoder->has_huff_tables) {
-    gst_jpeg_get_default_huffman_tables (&encoder->huff_tables);
-    encoder->has_huff_tables = TRUE;
-  }
-
   for (i = 0; i < num_tables; i++) {
     huffman_table->load_huffman_table[i] =
         encoder->huff_tables.dc_tables[i].valid
@@ -366,21 +347,8 @@ fill_huffman_table (GstVaapiEncoderJpeg * encoder, GstVaapiEncPicture * picture)
     memset (huffman_table->huffman_table[i].pad,
         0, sizeof (huffman_table->huffman_table[i].pad));
   }
-
-  return TRUE;
 }
 
-static gboolean
-ensure_huffman_table (GstVaapiEncoderJpeg * encoder,
-    GstVaapiEncPicture * picture)
-{
-  g_assert (picture);
-
-  if (!fill_huffman_table (encoder, picture))
-    return FALSE;
-
-  return TRUE;
-}
 
 static gboolean
 fill_slices (GstVaapiEncoderJpeg * encoder, GstVaapiEncPicture * picture)
@@ -503,13 +471,6 @@ bs_write_jpeg_header (GstBitWriter * bs, GstVaapiEncoderJpeg * encoder,
   gst_bit_writer_put_bits_uint8 (bs, 0, 8);     //Thumbnail height
 
   /* Add  quantization table */
-  if (!encoder->has_quant_tables) {
-    gst_jpeg_get_default_quantization_tables (&encoder->quant_tables);
-    generate_scaled_qm (&encoder->quant_tables, &encoder->scaled_quant_tables,
-        encoder->quality);
-    encoder->has_quant_tables = TRUE;
-  }
-
   gst_bit_writer_put_bits_uint8 (bs, 0xFF, 8);
   gst_bit_writer_put_bits_uint8 (bs, GST_JPEG_MARKER_DQT, 8);
   gst_bit_writer_put_bits_uint16 (bs, 3 + GST_JPEG_MAX_QUANT_ELEMENTS, 16);     //Lq
@@ -549,10 +510,6 @@ bs_write_jpeg_header (GstBitWriter * bs, GstVaapiEncoderJpeg * encoder,
   }
 
   /* Add Huffman table */
-  if (!encoder->has_huff_tables) {
-    gst_jpeg_get_default_huffman_tables (&encoder->huff_tables);
-    encoder->has_huff_tables = TRUE;
-  }
   for (i = 0; i < 2; i++) {
     gst_bit_writer_put_bits_uint8 (bs, 0xFF, 8);
     gst_bit_writer_put_bits_uint8 (bs, GST_JPEG_MARKER_DHT, 8);
@@ -606,59 +563,170 @@ bs_write_jpeg_header (GstBitWriter * bs, GstVaapiEncoderJpeg * encoder,
   return TRUE;
 }
 
-static gboolean
-add_packed_header (GstVaapiEncoderJpeg * encoder, GstVaapiEncPicture * picture)
+static void
+generate_packed_header (GstVaapiEncoderJpeg * encoder,
+    GstVaapiEncPicture * picture)
 {
-  GstVaapiEncPackedHeader *packed_raw_data_hdr;
   GstBitWriter bs;
-  VAEncPackedHeaderParameterBuffer packed_raw_data_hdr_param = { 0 };
-  guint32 data_bit_size;
-  guint8 *data;
 
   gst_bit_writer_init (&bs, 128 * 8);
   bs_write_jpeg_header (&bs, encoder, picture);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  encoder->packed_hdr_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
+  encoder->packed_hdr_data = GST_BIT_WRITER_DATA (&bs);
+  gst_bit_writer_clear (&bs, FALSE);
+}
+
+static GstVaapiEncPackedHeader *
+create_packed_header (GstVaapiEncoderJpeg * encoder)
+{
+  VAEncPackedHeaderParameterBuffer packed_raw_data_hdr_param = { 0 };
 
   packed_raw_data_hdr_param.type = VAEncPackedHeaderRawData;
-  packed_raw_data_hdr_param.bit_length = data_bit_size;
+  packed_raw_data_hdr_param.bit_length = encoder->packed_hdr_bit_size;
   packed_raw_data_hdr_param.has_emulation_bytes = 0;
 
-  packed_raw_data_hdr =
-      gst_vaapi_enc_packed_header_new (GST_VAAPI_ENCODER (encoder),
-      &packed_raw_data_hdr_param, sizeof (packed_raw_data_hdr_param), data,
-      (data_bit_size + 7) / 8);
-  g_assert (packed_raw_data_hdr);
-
-  gst_vaapi_enc_picture_add_packed_header (picture, packed_raw_data_hdr);
-  gst_vaapi_codec_object_replace (&packed_raw_data_hdr, NULL);
-
-  gst_bit_writer_clear (&bs, TRUE);
-
-  return TRUE;
+  return gst_vaapi_enc_packed_header_new (GST_VAAPI_ENCODER (encoder),
+      &packed_raw_data_hdr_param, sizeof (packed_raw_data_hdr_param),
+      encoder->packed_hdr_data, (encoder->packed_hdr_bit_size + 7) / 8);
 }
 
-static gboolean
-ensure_packed_headers (GstVaapiEncoderJpeg * encoder,
-    GstVaapiEncPicture * picture)
+static void
+release_param_buffers (ParamBuffers * pb)
 {
-  g_assert (picture);
+  pb->va_context = VA_INVALID_ID;
+  gst_vaapi_codec_object_replace (&pb->q_matrix, NULL);
+  gst_vaapi_codec_object_replace (&pb->huf_table, NULL);
+  gst_vaapi_codec_object_replace (&pb->packed_hdr, NULL);
+}
 
-  if ((GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
-          VA_ENC_PACKED_HEADER_RAW_DATA)
-      && !add_packed_header (encoder, picture))
-    goto error_create_packed_hdr;
+/* Creates the VA buffers of the cached parameters, on the VA context
+   the next picture is encoded on. They are submitted as is with every
+   picture, until the parameters change */
+static ParamBuffers *
+ensure_param_buffers (GstVaapiEncoderJpeg * encoder)
+{
+  GstVaapiEncoder *const base_encoder = GST_VAAPI_ENCODER_CAST (encoder);
+  ParamBuffers *pb = NULL;
+  guint i;
 
-  return TRUE;
+  for (i = 0; i < G_N_ELEMENTS (encoder->param_buffers); i++) {
+    ParamBuffers *const slot = &encoder->param_buffers[i];
+    if (slot->va_context == base_encoder->va_context)
+      return slot;
+    if (!pb && slot->va_context == VA_INVALID_ID)
+      pb = slot;
+  }
+  if (!pb)
+    goto error_no_slot;
+
+  pb->q_matrix = gst_vaapi_enc_q_matrix_new (base_encoder,
+      &encoder->q_matrix, sizeof (encoder->q_matrix));
+  if (!pb->q_matrix)
+    goto error_create_q_matrix;
+  GST_VAAPI_MINI_OBJECT_FLAG_SET (pb->q_matrix,
+      GST_VAAPI_ENC_OBJECT_FLAG_PERSISTENT);
+
+  pb->huf_table = gst_vaapi_enc_huffman_table_new (base_encoder,
+      (guint8 *) & encoder->huf_table, sizeof (encoder->huf_table));
+  if (!pb->huf_table)
+    goto error_create_huf_table;
+  GST_VAAPI_MINI_OBJECT_FLAG_SET (pb->huf_table,
+      GST_VAAPI_ENC_OBJECT_FLAG_PERSISTENT);
+
+  if (GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
+      VA_ENC_PACKED_HEADER_RAW_DATA) {
+    pb->packed_hdr = create_packed_header (encoder);
+    if (!pb->packed_hdr)
+      goto error_create_packed_hdr;
+    GST_VAAPI_MINI_OBJECT_FLAG_SET (pb->packed_hdr,
+        GST_VAAPI_ENC_OBJECT_FLAG_PERSISTENT);
+  }
+  pb->va_context = base_encoder->va_context;
+  return pb;
 
   /* ERRORS */
+error_no_slot:
+  {
+    GST_ERROR ("too many VA contexts");
+    return NULL;
+  }
+error_create_q_matrix:
+  {
+    GST_ERROR ("failed to allocate quantiser table");
+    release_param_buffers (pb);
+    return NULL;
+  }
+error_create_huf_table:
+  {
+    GST_ERROR ("failed to allocate Huffman tables");
+    release_param_buffers (pb);
+    return NULL;
+  }
 error_create_packed_hdr:
   {
     GST_ERROR ("failed to create packed raw data header buffer");
-    return FALSE;
+    release_param_buffers (pb);
+    return NULL;
   }
 }
 
+static void
+add_param_buffers (GstVaapiEncPicture * picture, ParamBuffers * pb)
+{
+  gst_vaapi_codec_object_replace (&picture->q_matrix, pb->q_matrix);
+  gst_vaapi_codec_object_replace (&picture->huf_table, pb->huf_table);
+  if (pb->packed_hdr)
+    gst_vaapi_enc_picture_add_packed_header (picture, pb->packed_hdr);
+}
+
+/* Drops the cached VA parameters and packed headers, so that they are
+   generated again for the next frame */
+static void
+reset_cached_params (GstVaapiEncoderJpeg * encoder)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (encoder->param_buffers); i++)
+    release_param_buffers (&encoder->param_buffers[i]);
+
+  g_free (encoder->packed_hdr_data);
+  encoder->packed_hdr_data = NULL;
+  encoder->packed_hdr_bit_size = 0;
+  encoder->has_cached_params = FALSE;
+}
+
+/* Builds the VA parameters and packed headers that only depend on the
+   quality factor, the format and the size of the pictures */
+static void
+ensure_cached_params (GstVaapiEncoderJpeg * encoder,
+    GstVaapiEncPicture * picture)
+{
+  if (encoder->has_cached_params)
+    return;
+
+  GST_DEBUG ("generate tables and headers for quality %u", encoder->quality);
+
+  if (!encoder->has_quant_tables) {
+    gst_jpeg_get_default_quantization_tables (&encoder->quant_tables);
+    encoder->has_quant_tables = TRUE;
+  }
+  generate_scaled_qm (&encoder->quant_tables, &encoder->scaled_quant_tables,
+      encoder->quality);
+  fill_quantization_table (encoder);
+
+  if (!encoder->has_huff_tables) {
+    gst_jpeg_get_default_huffman_tables (&encoder->huff_tables);
+    encoder->has_huff_tables = TRUE;
+  }
+  fill_huffman_table (encoder);
+
+  if (GST_VAAPI_ENCODER_PACKED_HEADERS (encoder) &
+      VA_ENC_PACKED_HEADER_RAW_DATA)
+    generate_packed_header (encoder, picture);
+
+  encoder->has_cached_params = TRUE;
+}
+
 static GstVaapiEncoderStatus
 gst_vaapi_encoder_jpeg_encode (GstVaapiEncoder * base_encoder,
     GstVaapiEncPicture * picture, GstVaapiCodedBufferProxy * codedbuf)
@@ -667,6 +735,7 @@ gst_vaapi_encoder_jpeg_encode (GstVaapiEncoder * base_encoder,
       GST_VAAPI_ENCODER_JPEG_CAST (base_encoder);
   GstVaapiEncoderStatus ret = GST_VAAPI_ENCODER_STATUS_ERROR_UNKNOWN;
   GstVaapiSurfaceProxy *reconstruct = NULL;
+  ParamBuffers *pb;
 
   reconstruct = gst_vaapi_encoder_create_surface (base_encoder);
 
@@ -674,14 +743,13 @@ gst_vaapi_encoder_jpeg_encode (GstVaapiEncoder * base_encoder,
 
   if (!ensure_picture (encoder, picture, codedbuf, reconstruct))
     goto error;
-  if (!ensure_quantization_table (encoder, picture))
-    goto error;
-  if (!ensure_huffman_table (encoder, picture))
+  ensure_cached_params (encoder, picture);
+  pb = ensure_param_buffers (encoder);
+  if (!pb)
     goto error;
+  add_param_buffers (picture, pb);
   if (!ensure_slices (encoder, picture))
     goto error;
-  if (!ensure_packed_headers (encoder, picture))
-    goto error;
   if (!gst_vaapi_enc_picture_encode (picture))
     goto error;
   if (reconstruct)
@@ -743,6 +811,9 @@ gst_vaapi_encoder_jpeg_reconfigure (GstVaapiEncoder * base_encoder)
   /* generate sampling factors (A.1.1) */
   generate_sampling_factors (encoder);
 
+  /* The picture size or format may have changed */
+  reset_cached_params (encoder);
+
   return set_context_info (base_encoder);
 }
 
@@ -751,6 +822,10 @@ gst_vaapi_encoder_jpeg_init (GstVaapiEncoder * base_encoder)
 {
   GstVaapiEncoderJpeg *const encoder =
       GST_VAAPI_ENCODER_JPEG_CAST (base_encoder);
+  guint i;
+
+  /* JPEG pictures are all coded independently */
+  base_encoder->intra_only = TRUE;
 
   encoder->has_quant_tables = FALSE;
   memset (&encoder->quant_tables, 0, sizeof (encoder->quant_tables));
@@ -758,6 +833,10 @@ gst_vaapi_encoder_jpeg_init (GstVaapiEncoder * base_encoder)
       sizeof (encoder->scaled_quant_tables));
   encoder->has_huff_tables = FALSE;
   memset (&encoder->huff_tables, 0, sizeof (encoder->huff_tables));
+  encoder->packed_hdr_data = NULL;
+  encoder->has_cached_params = FALSE;
+  for (i = 0; i < G_N_ELEMENTS (encoder->param_buffers); i++)
+    encoder->param_buffers[i].va_context = VA_INVALID_ID;
 
   return TRUE;
 }
@@ -765,6 +844,10 @@ gst_vaapi_encoder_jpeg_init (GstVaapiEncoder * base_encoder)
 static void
 gst_vaapi_encoder_jpeg_finalize (GstVaapiEncoder * base_encoder)
 {
+  GstVaapiEncoderJpeg *const encoder =
+      GST_VAAPI_ENCODER_JPEG_CAST (base_encoder);
+
+  reset_cached_params (encoder);
 }
 
 static GstVaapiEncoderStatus
@@ -776,7 +859,10 @@ gst_vaapi_encoder_jpeg_set_property (GstVaapiEncoder * base_encoder,
 
   switch (prop_id) {
     case GST_VAAPI_ENCODER_JPEG_PROP_QUALITY:
-      encoder->quality = g_value_get_uint (value);
+      if (encoder->quality != g_value_get_uint (value)) {
+        encoder->quality = g_value_get_uint (value);
+        reset_cached_params (encoder);
+      }
       break;
     default:
       return GST_VAAPI_ENCODER_STATUS_ERROR_INVALID_PARAMETER;
@@ -837,5 +923,7 @@ gst_vaapi_encoder_jpeg_get_default_properties (void)
           "Quality factor",
           "Quality factor",
           0, 100, 50, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  props = gst_vaapi_encoder_properties_append_num_contexts (props);
   return props;
 }
@@ -26,6 +26,8 @@
 #include "gstvaapisurfaceproxy_priv.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
+#include "gstvaapirecorder.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -488,7 +490,11 @@ do_encode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
 
   vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
 
-  status = vaRenderPicture (dpy, ctx, buf_id, 1);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_render_picture (dpy, ctx, buf_id, 1);
+
+  GST_VAAPI_PROFILER_CALL (status, dpy, ctx, RENDER_PICTURE, 0,
+      vaRenderPicture (dpy, ctx, buf_id, 1));
   if (!vaapi_check_status (status, "vaRenderPicture()"))
     return FALSE;
 
@@ -497,6 +503,35 @@ do_encode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
   return TRUE;
 }
 
+/* Submits a VA buffer that is kept for the next pictures */
+static gboolean
+do_encode_persistent (VADisplay dpy, VAContextID ctx, VABufferID buf_id,
+    void **buf_ptr)
+{
+  VAStatus status;
+
+  if (*buf_ptr)
+    vaapi_unmap_buffer (dpy, buf_id, buf_ptr);
+
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_render_picture (dpy, ctx, &buf_id, 1);
+
+  GST_VAAPI_PROFILER_CALL (status, dpy, ctx, RENDER_PICTURE, 0,
+      vaRenderPicture (dpy, ctx, &buf_id, 1));
+  if (!vaapi_check_status (status, "vaRenderPicture()"))
+    return FALSE;
+  return TRUE;
+}
+
+static gboolean
+do_encode_object (gpointer object, VADisplay dpy, VAContextID ctx,
+    VABufferID * buf_id, void **buf_ptr)
+{
+  if (GST_VAAPI_ENC_OBJECT_IS_PERSISTENT (object))
+    return do_encode_persistent (dpy, ctx, *buf_id, buf_ptr);
+  return do_encode (dpy, ctx, buf_id, buf_ptr);
+}
+
 gboolean
 gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
 {
@@ -516,7 +551,12 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
 
   GST_DEBUG ("encode picture 0x%08x", picture->surface_id);
 
-  status = vaBeginPicture (va_display, va_context, picture->surface_id);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_begin_picture (va_display, va_context,
+        picture->surface_id);
+
+  GST_VAAPI_PROFILER_CALL (status, va_display, va_context, BEGIN_PICTURE, 0,
+      vaBeginPicture (va_display, va_context, picture->surface_id));
   if (!vaapi_check_status (status, "vaBeginPicture()"))
     return FALSE;
 
@@ -528,13 +568,13 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
 
   /* Submit Quantization matrix */
   q_matrix = picture->q_matrix;
-  if (q_matrix && !do_encode (va_display, va_context,
+  if (q_matrix && !do_encode_object (q_matrix, va_display, va_context,
           &q_matrix->param_id, &q_matrix->param))
     return FALSE;
 
   /* Submit huffman table */
   huf_table = picture->huf_table;
-  if (huf_table && !do_encode (va_display, va_context,
+  if (huf_table && !do_encode_object (huf_table, va_display, va_context,
           &huf_table->param_id, (void **) &huf_table->param))
     return FALSE;
 
@@ -542,9 +582,10 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
   for (i = 0; i < picture->packed_headers->len; i++) {
     GstVaapiEncPackedHeader *const header =
         g_ptr_array_index (picture->packed_headers, i);
-    if (!do_encode (va_display, va_context,
+    if (!do_encode_object (header, va_display, va_context,
             &header->param_id, &header->param) ||
-        !do_encode (va_display, va_context, &header->data_id, &header->data))
+        !do_encode_object (header, va_display, va_context,
+            &header->data_id, &header->data))
       return FALSE;
   }
 
@@ -578,7 +619,11 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
       return FALSE;
   }
 
-  status = vaEndPicture (va_display, va_context);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_end_picture (va_display, va_context);
+
+  GST_VAAPI_PROFILER_CALL (status, va_display, va_context, END_PICTURE, 0,
+      vaEndPicture (va_display, va_context));
   if (!vaapi_check_status (status, "vaEndPicture()"))
     return FALSE;
   return TRUE;
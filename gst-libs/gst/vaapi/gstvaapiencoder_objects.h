@@ -37,6 +37,22 @@ typedef struct _GstVaapiEncQMatrix GstVaapiEncQMatrix;
 typedef struct _GstVaapiEncHuffmanTable GstVaapiEncHuffmanTable;
 typedef struct _GstVaapiEncPackedHeader GstVaapiEncPackedHeader;
 
+/**
+ * GstVaapiEncObjectFlags:
+ * @GST_VAAPI_ENC_OBJECT_FLAG_PERSISTENT: the VA buffers of the object
+ *   are submitted with several pictures, so they are not destroyed
+ *   once rendered but along with the object. Only parameter buffers
+ *   whose contents never change may be persistent.
+ */
+typedef enum
+{
+  GST_VAAPI_ENC_OBJECT_FLAG_PERSISTENT = (GST_VAAPI_CODEC_OBJECT_FLAG_LAST << 0),
+} GstVaapiEncObjectFlags;
+
+#define GST_VAAPI_ENC_OBJECT_IS_PERSISTENT(object) \
+    GST_VAAPI_MINI_OBJECT_FLAG_IS_SET(object, \
+        GST_VAAPI_ENC_OBJECT_FLAG_PERSISTENT)
+
 /* ------------------------------------------------------------------------- */
 /* --- Encoder Packed Header                                             --- */
 /* ------------------------------------------------------------------------- */
@@ -28,6 +28,7 @@
 #include <gst/vaapi/gstvaapiencoder_objects.h>
 #include <gst/vaapi/gstvaapicontext.h>
 #include <gst/vaapi/gstvaapivideopool.h>
+#include <gst/vaapi/gstvaapiparallelqueue.h>
 #include <gst/video/gstvideoutils.h>
 #include <gst/vaapi/gstvaapivalue.h>
 
@@ -195,6 +196,13 @@ G_GNUC_INTERNAL
 GPtrArray *
 gst_vaapi_encoder_properties_get_default (const GstVaapiEncoderClass * klass);
 
+G_GNUC_INTERNAL
+GPtrArray *
+gst_vaapi_encoder_properties_append_num_contexts (GPtrArray * props);
+
+/* The maximum number of VA contexts intra-only pictures are encoded on */
+#define GST_VAAPI_ENCODER_MAX_CONTEXTS 4
+
 struct _GstVaapiEncoder
 {
   /*< private >*/
@@ -216,17 +224,29 @@ struct _GstVaapiEncoder
   guint32 rate_control_mask;
   guint bitrate; /* kbps */
   guint keyframe_period;
+  GstVaapiRectangle crop_rect;
 
   GMutex mutex;
   GCond surface_free;
   GCond codedbuf_free;
   guint codedbuf_size;
   GstVaapiVideoPool *codedbuf_pool;
-  GAsyncQueue *codedbuf_queue;
+  GstVaapiParallelQueue *codedbuf_queue;
   guint32 num_codedbuf_queued;
 
+  /* Independent pictures are dispatched over the main context and
+     up to (GST_VAAPI_ENCODER_MAX_CONTEXTS - 1) auxiliary contexts.
+     VA coded buffers belong to the context they were created on, so
+     each auxiliary context has its own coded buffer pool */
+  guint num_contexts;
+  GstVaapiContext *aux_contexts[GST_VAAPI_ENCODER_MAX_CONTEXTS - 1];
+  GstVaapiVideoPool *aux_codedbuf_pools[GST_VAAPI_ENCODER_MAX_CONTEXTS - 1];
+
   guint got_packed_headers:1;
   guint got_rate_control_mask:1;
+  guint has_crop_rect:1;
+  /* set by the subclass when all pictures are coded independently */
+  guint intra_only:1;
 };
 
 struct _GstVaapiEncoderClassData
@@ -22,12 +22,15 @@
 
 #include "sysdeps.h"
 #include "gstvaapifilter.h"
+#include "gstvaapifilter_sw.h"
+#include "gstvaapiimage.h"
 #include "gstvaapiutils.h"
 #include "gstvaapivalue.h"
 #include "gstvaapiminiobject.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapisurface_priv.h"
 #include "gstvaapiutils_core.h"
+#include "gstvaapiprofiler.h"
 
 #if USE_VA_VPP
 # include <va/va_vpp.h>
@@ -39,6 +42,9 @@
 #define GST_VAAPI_FILTER(obj) \
     ((GstVaapiFilter *)(obj))
 
+/* Number of pipeline parameter buffers recycled across frames */
+#define NUM_PIPELINE_PARAM_BUFFERS 4
+
 typedef struct _GstVaapiFilterOpData GstVaapiFilterOpData;
 struct _GstVaapiFilterOpData
 {
@@ -52,7 +58,9 @@ struct _GstVaapiFilterOpData
   guint va_cap_size;
   VABufferID va_buffer;
   guint va_buffer_size;
+  gfloat value;                 /* last value, or method, set */
   guint is_enabled:1;
+  guint has_value:1;
 };
 
 struct _GstVaapiFilter
@@ -60,6 +68,7 @@ struct _GstVaapiFilter
   /*< private > */
   GstVaapiMiniObject parent_instance;
 
+  GMutex lock;                  /* serializes submissions to va_context */
   GstVaapiDisplay *display;
   VADisplay va_display;
   VAConfigID va_config;
@@ -68,12 +77,26 @@ struct _GstVaapiFilter
   GstVideoFormat format;
   GstVaapiScaleMethod scale_method;
   GArray *formats;
+  GArray *vpp_formats;
   GArray *forward_references;
   GArray *backward_references;
   GstVaapiRectangle crop_rect;
   GstVaapiRectangle target_rect;
   guint use_crop_rect:1;
   guint use_target_rect:1;
+  guint use_software:1;         /* no VPP pipeline, only the CPU engine */
+  GstVaapiImage *sw_src_image;
+  GstVaapiImage *sw_dst_image;
+#if USE_VA_VPP
+  VAProcPipelineCaps pipeline_caps;
+  guint pipeline_caps_ops;      /* enabled operations the caps are for */
+  guint pipeline_caps_valid:1;
+  VABufferID pipeline_param_buffers[NUM_PIPELINE_PARAM_BUFFERS];
+  guint pipeline_param_index;
+  GArray *blend_param_buffers;
+#endif
+  guint64 num_frames;
+  guint64 num_pipeline_caps_queries;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -172,8 +195,10 @@ vpp_get_filters_unlocked (GstVaapiFilter * filter, guint * num_filters_ptr)
   if (!filters)
     goto error;
 
-  va_status = vaQueryVideoProcFilters (filter->va_display, filter->va_context,
-      filters, &num_filters);
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      QUERY_VIDEO_PROC_FILTERS, 0,
+      vaQueryVideoProcFilters (filter->va_display, filter->va_context, filters,
+          &num_filters));
 
   // Try to reallocate to the expected number of filters
   if (va_status == VA_STATUS_ERROR_MAX_NUM_EXCEEDED) {
@@ -183,8 +208,10 @@ vpp_get_filters_unlocked (GstVaapiFilter * filter, guint * num_filters_ptr)
       goto error;
     filters = new_filters;
 
-    va_status = vaQueryVideoProcFilters (filter->va_display,
-        filter->va_context, filters, &num_filters);
+    GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+        QUERY_VIDEO_PROC_FILTERS, 0,
+        vaQueryVideoProcFilters (filter->va_display, filter->va_context,
+            filters, &num_filters));
   }
   if (!vaapi_check_status (va_status, "vaQueryVideoProcFilters()"))
     goto error;
@@ -200,15 +227,12 @@ error:
   }
 }
 
+/* Capability queries are read-only, and thus are not serialized with
+   the submissions to the VPP context */
 static VAProcFilterType *
 vpp_get_filters (GstVaapiFilter * filter, guint * num_filters_ptr)
 {
-  VAProcFilterType *filters;
-
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
-  filters = vpp_get_filters_unlocked (filter, num_filters_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
-  return filters;
+  return vpp_get_filters_unlocked (filter, num_filters_ptr);
 }
 
 static gpointer
@@ -223,8 +247,10 @@ vpp_get_filter_caps_unlocked (GstVaapiFilter * filter, VAProcFilterType type,
   if (!caps)
     goto error;
 
-  va_status = vaQueryVideoProcFilterCaps (filter->va_display,
-      filter->va_context, type, caps, &num_caps);
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      QUERY_VIDEO_PROC_FILTER_CAPS, 0,
+      vaQueryVideoProcFilterCaps (filter->va_display, filter->va_context, type,
+          caps, &num_caps));
 
   // Try to reallocate to the expected number of filters
   if (va_status == VA_STATUS_ERROR_MAX_NUM_EXCEEDED) {
@@ -233,8 +259,10 @@ vpp_get_filter_caps_unlocked (GstVaapiFilter * filter, VAProcFilterType type,
       goto error;
     caps = new_caps;
 
-    va_status = vaQueryVideoProcFilterCaps (filter->va_display,
-        filter->va_context, type, caps, &num_caps);
+    GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+        QUERY_VIDEO_PROC_FILTER_CAPS, 0,
+        vaQueryVideoProcFilterCaps (filter->va_display, filter->va_context,
+            type, caps, &num_caps));
   }
   if (!vaapi_check_status (va_status, "vaQueryVideoProcFilterCaps()"))
     goto error;
@@ -254,12 +282,7 @@ static gpointer
 vpp_get_filter_caps (GstVaapiFilter * filter, VAProcFilterType type,
     guint cap_size, guint * num_caps_ptr)
 {
-  gpointer caps;
-
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
-  caps = vpp_get_filter_caps_unlocked (filter, type, cap_size, num_caps_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
-  return caps;
+  return vpp_get_filter_caps_unlocked (filter, type, cap_size, num_caps_ptr);
 }
 #endif
 
@@ -698,6 +721,33 @@ error:
     return NULL;
   }
 }
+
+/* Get the list of operations the software engine implements, i.e.
+   color conversion, cropping and scaling */
+static GPtrArray *
+get_operations_software (GstVaapiFilter * filter, GPtrArray * default_ops)
+{
+  GPtrArray *ops;
+  guint i;
+
+  ops = g_ptr_array_new_full (default_ops->len, op_data_unref);
+  if (!ops)
+    goto cleanup;
+
+  for (i = 0; i < default_ops->len; i++) {
+    GstVaapiFilterOpData *const op_data = g_ptr_array_index (default_ops, i);
+    if (op_data->va_type == VAProcFilterNone)
+      g_ptr_array_add (ops, op_data_ref (op_data));
+  }
+
+  if (filter->operations)
+    g_ptr_array_unref (filter->operations);
+  filter->operations = g_ptr_array_ref (ops);
+
+cleanup:
+  g_ptr_array_unref (default_ops);
+  return ops;
+}
 #endif
 
 /* Determine the set of supported VPP operations by the specific
@@ -714,7 +764,10 @@ get_operations (GstVaapiFilter * filter)
   ops = get_operations_default ();
   if (!ops)
     return NULL;
-  return filter ? get_operations_ordered (filter, ops) : ops;
+  if (!filter)
+    return ops;
+  return filter->use_software ? get_operations_software (filter, ops) :
+      get_operations_ordered (filter, ops);
 #endif
   return NULL;
 }
@@ -758,6 +811,22 @@ find_operation (GstVaapiFilter * filter, GstVaapiFilterOp op)
   return NULL;
 }
 
+/* Pipeline caps depend on the operation parameters, e.g. on the
+   deinterlacing algorithm, so they have to be queried again, but only
+   if a parameter actually changed */
+#if USE_VA_VPP
+static inline void
+op_update_value (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
+    gfloat value)
+{
+  if (op_data->has_value && op_data->value == value)
+    return;
+  op_data->value = value;
+  op_data->has_value = TRUE;
+  filter->pipeline_caps_valid = FALSE;
+}
+#endif
+
 /* Ensure the operation's VA buffer is allocated */
 #if USE_VA_VPP
 static inline gboolean
@@ -784,6 +853,8 @@ op_set_generic_unlocked (GstVaapiFilter * filter,
   if (!op_data || !op_ensure_buffer (filter, op_data))
     return FALSE;
 
+  op_update_value (filter, op_data, value);
+
   op_data->is_enabled =
       (value != G_PARAM_SPEC_FLOAT (op_data->pspec)->default_value);
   if (!op_data->is_enabled)
@@ -811,9 +882,9 @@ op_set_generic (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
   gboolean success = FALSE;
 
 #if USE_VA_VPP
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  g_mutex_lock (&filter->lock);
   success = op_set_generic_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  g_mutex_unlock (&filter->lock);
 #endif
   return success;
 }
@@ -831,6 +902,8 @@ op_set_color_balance_unlocked (GstVaapiFilter * filter,
   if (!op_data || !op_ensure_buffer (filter, op_data))
     return FALSE;
 
+  op_update_value (filter, op_data, value);
+
   op_data->is_enabled =
       (value != G_PARAM_SPEC_FLOAT (op_data->pspec)->default_value);
   if (!op_data->is_enabled)
@@ -859,9 +932,9 @@ op_set_color_balance (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
   gboolean success = FALSE;
 
 #if USE_VA_VPP
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  g_mutex_lock (&filter->lock);
   success = op_set_color_balance_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  g_mutex_unlock (&filter->lock);
 #endif
   return success;
 }
@@ -881,6 +954,9 @@ op_set_deinterlace_unlocked (GstVaapiFilter * filter,
   if (!op_data || !op_ensure_buffer (filter, op_data))
     return FALSE;
 
+  /* The field flags don't affect the pipeline caps */
+  op_update_value (filter, op_data, method);
+
   op_data->is_enabled = (method != GST_VAAPI_DEINTERLACE_METHOD_NONE);
   if (!op_data->is_enabled)
     return TRUE;
@@ -912,9 +988,9 @@ op_set_deinterlace (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
   gboolean success = FALSE;
 
 #if USE_VA_VPP
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  g_mutex_lock (&filter->lock);
   success = op_set_deinterlace_unlocked (filter, op_data, method, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  g_mutex_unlock (&filter->lock);
 #endif
   return success;
 }
@@ -930,6 +1006,8 @@ op_set_skintone_unlocked (GstVaapiFilter * filter,
   if (!op_data || !op_ensure_buffer (filter, op_data))
     return FALSE;
 
+  op_update_value (filter, op_data, value);
+
   op_data->is_enabled = value;
   if (!op_data->is_enabled)
     return TRUE;
@@ -951,9 +1029,9 @@ op_set_skintone (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
   gboolean success = FALSE;
 
 #if USE_VA_VPP
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  g_mutex_lock (&filter->lock);
   success = op_set_skintone_unlocked (filter, op_data, enhance);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  g_mutex_unlock (&filter->lock);
 #endif
   return success;
 }
@@ -990,17 +1068,6 @@ deint_refs_clear_all (GstVaapiFilter * filter)
 /* --- Surface Formats                                                   --- */
 /* ------------------------------------------------------------------------- */
 
-static gboolean
-ensure_formats (GstVaapiFilter * filter)
-{
-  if (G_LIKELY (filter->formats))
-    return TRUE;
-
-  filter->formats = gst_vaapi_get_surface_formats (filter->display,
-      filter->va_config);
-  return (filter->formats != NULL);
-}
-
 static inline gboolean
 is_special_format (GstVideoFormat format)
 {
@@ -1009,20 +1076,71 @@ is_special_format (GstVideoFormat format)
 }
 
 static gboolean
-find_format (GstVaapiFilter * filter, GstVideoFormat format)
+find_format_in_array (GArray * formats, GstVideoFormat format)
 {
   guint i;
 
-  if (is_special_format (format) || !filter->formats)
+  if (is_special_format (format) || !formats)
     return FALSE;
 
-  for (i = 0; i < filter->formats->len; i++) {
-    if (g_array_index (filter->formats, GstVideoFormat, i) == format)
+  for (i = 0; i < formats->len; i++) {
+    if (g_array_index (formats, GstVideoFormat, i) == format)
       return TRUE;
   }
   return FALSE;
 }
 
+/* The supported formats are those of the VPP pipeline, if any, and
+   those the software engine converts to */
+static gboolean
+ensure_formats (GstVaapiFilter * filter)
+{
+  GArray *sw_formats;
+  guint i;
+
+  if (G_LIKELY (filter->formats))
+    return TRUE;
+
+  sw_formats = gst_vaapi_filter_sw_get_formats ();
+  if (filter->use_software) {
+    filter->formats = sw_formats;
+    return TRUE;
+  }
+
+  filter->vpp_formats = gst_vaapi_get_surface_formats (filter->display,
+      filter->va_config);
+  if (!filter->vpp_formats) {
+    g_array_unref (sw_formats);
+    return FALSE;
+  }
+
+  filter->formats = g_array_sized_new (FALSE, FALSE, sizeof (GstVideoFormat),
+      filter->vpp_formats->len + sw_formats->len);
+  g_array_append_vals (filter->formats, filter->vpp_formats->data,
+      filter->vpp_formats->len);
+  for (i = 0; i < sw_formats->len; i++) {
+    const GstVideoFormat format = g_array_index (sw_formats, GstVideoFormat, i);
+    if (!find_format_in_array (filter->vpp_formats, format))
+      g_array_append_val (filter->formats, format);
+  }
+  g_array_unref (sw_formats);
+  return TRUE;
+}
+
+static inline gboolean
+find_format (GstVaapiFilter * filter, GstVideoFormat format)
+{
+  return find_format_in_array (filter->formats, format);
+}
+
+/* Determine whether the target format requires the software engine */
+static inline gboolean
+use_software (GstVaapiFilter * filter)
+{
+  return filter->use_software || (!is_special_format (filter->format) &&
+      !find_format_in_array (filter->vpp_formats, filter->format));
+}
+
 /* ------------------------------------------------------------------------- */
 /* --- Interface                                                         --- */
 /* ------------------------------------------------------------------------- */
@@ -1032,12 +1150,16 @@ static gboolean
 gst_vaapi_filter_init (GstVaapiFilter * filter, GstVaapiDisplay * display)
 {
   VAStatus va_status;
+  guint i;
 
+  g_mutex_init (&filter->lock);
   filter->display = gst_vaapi_display_ref (display);
   filter->va_display = GST_VAAPI_DISPLAY_VADISPLAY (display);
   filter->va_config = VA_INVALID_ID;
   filter->va_context = VA_INVALID_ID;
   filter->format = DEFAULT_FORMAT;
+  for (i = 0; i < NUM_PIPELINE_PARAM_BUFFERS; i++)
+    filter->pipeline_param_buffers[i] = VA_INVALID_ID;
 
   filter->forward_references =
       g_array_sized_new (FALSE, FALSE, sizeof (VASurfaceID), 4);
@@ -1050,26 +1172,40 @@ gst_vaapi_filter_init (GstVaapiFilter * filter, GstVaapiDisplay * display)
     return FALSE;
 
   if (!GST_VAAPI_DISPLAY_HAS_VPP (display))
-    return FALSE;
-
-  va_status = vaCreateConfig (filter->va_display, VAProfileNone,
-      VAEntrypointVideoProc, NULL, 0, &filter->va_config);
-  if (!vaapi_check_status (va_status, "vaCreateConfig() [VPP]"))
-    return FALSE;
-
-  va_status = vaCreateContext (filter->va_display, filter->va_config, 0, 0, 0,
-      NULL, 0, &filter->va_context);
+    goto use_software;
+
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, VA_INVALID_ID,
+      CREATE_CONFIG, 0,
+      vaCreateConfig (filter->va_display, VAProfileNone, VAEntrypointVideoProc,
+          NULL, 0, &filter->va_config));
+  if (vaapi_check_status (va_status, "vaCreateConfig() [VPP]"))
+    GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+        CREATE_CONTEXT, 0,
+        vaCreateContext (filter->va_display, filter->va_config, 0, 0, 0, NULL,
+            0, &filter->va_context));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (va_status, "vaCreateContext() [VPP]"))
-    return FALSE;
+    goto use_software;
   return TRUE;
+
+  /* The driver has no video processing pipeline: crop, scale and
+     convert the images with the CPU */
+use_software:
+  {
+    GST_INFO ("video processing is not supported, using the software engine");
+    filter->use_software = TRUE;
+    return TRUE;
+  }
 }
 
 static void
 gst_vaapi_filter_finalize (GstVaapiFilter * filter)
 {
+  VAStatus va_status;
   guint i;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (filter->display);
   if (filter->operations) {
     for (i = 0; i < filter->operations->len; i++) {
       GstVaapiFilterOpData *const op_data =
@@ -1080,16 +1216,34 @@ gst_vaapi_filter_finalize (GstVaapiFilter * filter)
     filter->operations = NULL;
   }
 
+  for (i = 0; i < NUM_PIPELINE_PARAM_BUFFERS; i++)
+    vaapi_destroy_buffer (filter->va_display,
+        &filter->pipeline_param_buffers[i]);
+
+  if (filter->blend_param_buffers) {
+    for (i = 0; i < filter->blend_param_buffers->len; i++)
+      vaapi_destroy_buffer (filter->va_display,
+          &g_array_index (filter->blend_param_buffers, VABufferID, i));
+    g_array_unref (filter->blend_param_buffers);
+    filter->blend_param_buffers = NULL;
+  }
+
   if (filter->va_context != VA_INVALID_ID) {
-    vaDestroyContext (filter->va_display, filter->va_context);
+    GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+        DESTROY_CONTEXT, 0,
+        vaDestroyContext (filter->va_display, filter->va_context));
+    vaapi_check_status (va_status, "vaDestroyContext() [VPP]");
     filter->va_context = VA_INVALID_ID;
   }
 
   if (filter->va_config != VA_INVALID_ID) {
-    vaDestroyConfig (filter->va_display, filter->va_config);
+    GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, VA_INVALID_ID,
+        DESTROY_CONFIG, 0, vaDestroyConfig (filter->va_display,
+            filter->va_config));
+    vaapi_check_status (va_status, "vaDestroyConfig() [VPP]");
     filter->va_config = VA_INVALID_ID;
   }
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (filter->display);
   gst_vaapi_display_replace (&filter->display, NULL);
 
   if (filter->forward_references) {
@@ -1106,6 +1260,15 @@ gst_vaapi_filter_finalize (GstVaapiFilter * filter)
     g_array_unref (filter->formats);
     filter->formats = NULL;
   }
+
+  if (filter->vpp_formats) {
+    g_array_unref (filter->vpp_formats);
+    filter->vpp_formats = NULL;
+  }
+
+  gst_vaapi_object_replace (&filter->sw_src_image, NULL);
+  gst_vaapi_object_replace (&filter->sw_dst_image, NULL);
+  g_mutex_clear (&filter->lock);
 }
 
 static inline const GstVaapiMiniObjectClass *
@@ -1126,6 +1289,10 @@ gst_vaapi_filter_class (void)
  * Creates a new #GstVaapiFilter set up to operate in "identity"
  * mode. This means that no other operation than scaling is performed.
  *
+ * If the driver has no video processing pipeline, the filter crops,
+ * scales and converts the surfaces with a software engine, and no
+ * other operation is available.
+ *
  * Return value: the newly created #GstVaapiFilter object
  */
 GstVaapiFilter *
@@ -1347,6 +1514,221 @@ gst_vaapi_filter_set_operation (GstVaapiFilter * filter, GstVaapiFilterOp op,
   return FALSE;
 }
 
+/* Query the pipeline caps, unless they were already for the same set
+   of operations with the same parameters */
+#if USE_VA_VPP
+static gboolean
+ensure_pipeline_caps (GstVaapiFilter * filter, VABufferID * filters,
+    guint num_filters, guint enabled_ops)
+{
+  VAStatus va_status;
+
+  if (filter->pipeline_caps_valid && filter->pipeline_caps_ops == enabled_ops)
+    return TRUE;
+
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      QUERY_VIDEO_PROC_PIPELINE_CAPS, 0,
+      vaQueryVideoProcPipelineCaps (filter->va_display, filter->va_context,
+          filters, num_filters, &filter->pipeline_caps));
+  filter->num_pipeline_caps_queries++;
+  if (!vaapi_check_status (va_status, "vaQueryVideoProcPipelineCaps()"))
+    return FALSE;
+
+  filter->pipeline_caps_ops = enabled_ops;
+  filter->pipeline_caps_valid = TRUE;
+  return TRUE;
+}
+
+/* Map the next pipeline parameter buffer, allocating it on first use.
+   Buffers are recycled round-robin rather than created and destroyed
+   for every frame */
+static gboolean
+ensure_pipeline_param_buffer (GstVaapiFilter * filter, VABufferID * buf_id_ptr,
+    VAProcPipelineParameterBuffer ** pipeline_param_ptr)
+{
+  VABufferID *const buf_id_slot =
+      &filter->pipeline_param_buffers[filter->pipeline_param_index];
+
+  filter->pipeline_param_index =
+      (filter->pipeline_param_index + 1) % NUM_PIPELINE_PARAM_BUFFERS;
+
+  if (*buf_id_slot == VA_INVALID_ID) {
+    if (!vaapi_create_buffer (filter->va_display, filter->va_context,
+            VAProcPipelineParameterBufferType,
+            sizeof (VAProcPipelineParameterBuffer), NULL, buf_id_slot,
+            (gpointer *) pipeline_param_ptr))
+      return FALSE;
+  } else {
+    *pipeline_param_ptr = vaapi_map_buffer (filter->va_display, *buf_id_slot);
+    if (!*pipeline_param_ptr)
+      return FALSE;
+  }
+  *buf_id_ptr = *buf_id_slot;
+  return TRUE;
+}
+#endif
+
+/* Get an image of @format and of the size of @surface, reusing the
+   image of the previous frame if possible */
+#if USE_VA_VPP
+static GstVaapiImage *
+ensure_sw_image (GstVaapiFilter * filter, GstVaapiImage ** image_ptr,
+    GstVideoFormat format, GstVaapiSurface * surface)
+{
+  const guint width = GST_VAAPI_SURFACE_WIDTH (surface);
+  const guint height = GST_VAAPI_SURFACE_HEIGHT (surface);
+  GstVaapiImage *const image = *image_ptr;
+
+  if (image && gst_vaapi_image_get_format (image) == format &&
+      gst_vaapi_image_get_width (image) == width &&
+      gst_vaapi_image_get_height (image) == height)
+    return image;
+
+  gst_vaapi_object_replace (image_ptr, NULL);
+  *image_ptr = gst_vaapi_image_new (filter->display, format, width, height);
+  return *image_ptr;
+}
+
+static gboolean
+sw_frame_map (GstVaapiFilterSwFrame * frame, GstVaapiImage * image,
+    GstVaapiSurface * surface)
+{
+  guint i, num_planes;
+
+  if (!gst_vaapi_image_map (image))
+    return FALSE;
+
+  memset (frame, 0, sizeof (*frame));
+  frame->format = gst_vaapi_image_get_format (image);
+  frame->width = MIN (gst_vaapi_image_get_width (image),
+      GST_VAAPI_SURFACE_WIDTH (surface));
+  frame->height = MIN (gst_vaapi_image_get_height (image),
+      GST_VAAPI_SURFACE_HEIGHT (surface));
+
+  num_planes = MIN (gst_vaapi_image_get_plane_count (image),
+      G_N_ELEMENTS (frame->data));
+  for (i = 0; i < num_planes; i++) {
+    frame->data[i] = gst_vaapi_image_get_plane (image, i);
+    frame->stride[i] = gst_vaapi_image_get_pitch (image, i);
+  }
+  return TRUE;
+}
+
+/* Crop, scale and convert @src_surface with the CPU. The source is
+   read back with vaGetImage(), which is faster than reading from a
+   derived image. The output is written in place if the destination
+   surface has the target format, or uploaded with vaPutImage() */
+static GstVaapiFilterStatus
+process_software (GstVaapiFilter * filter, GstVaapiSurface * src_surface,
+    GstVaapiSurface * dst_surface)
+{
+  GstVaapiFilterSwFrame src_frame, dst_frame;
+  GstVaapiImage *src_image, *dst_image;
+  GstVideoFormat src_format, dst_format;
+  gboolean is_derived, success;
+  guint i;
+
+  for (i = 0; i < filter->operations->len; i++) {
+    GstVaapiFilterOpData *const op_data =
+        g_ptr_array_index (filter->operations, i);
+    if (op_data->is_enabled && op_data->va_type != VAProcFilterNone)
+      goto error_unsupported_operation;
+  }
+
+  src_format = gst_vaapi_surface_get_format (src_surface);
+  if (!gst_vaapi_filter_sw_has_format (src_format))
+    src_format = GST_VIDEO_FORMAT_NV12;
+  src_image = ensure_sw_image (filter, &filter->sw_src_image, src_format,
+      src_surface);
+  if (!src_image || !gst_vaapi_surface_get_image (src_surface, src_image))
+    goto error_get_image;
+
+  switch (filter->format) {
+    case GST_VIDEO_FORMAT_UNKNOWN:
+      dst_format = src_format;
+      break;
+    case GST_VIDEO_FORMAT_ENCODED:
+      dst_format = gst_vaapi_surface_get_format (dst_surface);
+      if (!gst_vaapi_filter_sw_has_format (dst_format))
+        dst_format = GST_VIDEO_FORMAT_NV12;
+      break;
+    default:
+      dst_format = filter->format;
+      break;
+  }
+
+  is_derived = gst_vaapi_surface_get_format (dst_surface) == dst_format;
+  dst_image = is_derived ? gst_vaapi_surface_derive_image (dst_surface) : NULL;
+  if (!dst_image) {
+    is_derived = FALSE;
+    dst_image = ensure_sw_image (filter, &filter->sw_dst_image, dst_format,
+        dst_surface);
+    if (!dst_image)
+      goto error_create_image;
+    gst_vaapi_object_ref (dst_image);
+  }
+
+  if (!sw_frame_map (&src_frame, src_image, src_surface))
+    goto error_map_image;
+  if (!sw_frame_map (&dst_frame, dst_image, dst_surface)) {
+    gst_vaapi_image_unmap (src_image);
+    goto error_map_image;
+  }
+
+  success = gst_vaapi_filter_sw_process (&src_frame,
+      filter->use_crop_rect ? &filter->crop_rect : NULL, &dst_frame,
+      filter->use_target_rect ? &filter->target_rect : NULL,
+      filter->scale_method);
+  gst_vaapi_image_unmap (dst_image);
+  gst_vaapi_image_unmap (src_image);
+  if (!success)
+    goto error_process;
+
+  if (!is_derived && !gst_vaapi_surface_put_image (dst_surface, dst_image))
+    goto error_put_image;
+
+  gst_vaapi_object_unref (dst_image);
+  filter->num_frames++;
+  return GST_VAAPI_FILTER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_unsupported_operation:
+  {
+    GST_ERROR ("operations other than scaling and color conversion are "
+        "not supported without video processing pipeline");
+    return GST_VAAPI_FILTER_STATUS_ERROR_UNSUPPORTED_OPERATION;
+  }
+error_get_image:
+  {
+    GST_ERROR ("failed to read back the source surface");
+    return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
+  }
+error_create_image:
+  {
+    GST_ERROR ("failed to create %s image",
+        gst_video_format_to_string (dst_format));
+    return GST_VAAPI_FILTER_STATUS_ERROR_ALLOCATION_FAILED;
+  }
+error_map_image:
+  {
+    GST_ERROR ("failed to map image");
+    gst_vaapi_object_unref (dst_image);
+    return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
+  }
+error_process:
+  {
+    gst_vaapi_object_unref (dst_image);
+    return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
+  }
+error_put_image:
+  {
+    GST_ERROR ("failed to upload the output image");
+    gst_vaapi_object_unref (dst_image);
+    return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
+  }
+}
+#endif
+
 /**
  * gst_vaapi_filter_process:
  * @filter: a #GstVaapiFilter
@@ -1360,6 +1742,9 @@ gst_vaapi_filter_set_operation (GstVaapiFilter * filter, GstVaapiFilterOp op,
  * hardware. i.e. the only guarantee held is the generated outcome,
  * not any specific order of operations.
  *
+ * Target formats that the video processing pipeline does not support
+ * are produced by the software engine, which only crops and scales.
+ *
  * Return value: a #GstVaapiFilterStatus
  */
 static GstVaapiFilterStatus
@@ -1370,14 +1755,19 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
   VAProcPipelineParameterBuffer *pipeline_param = NULL;
   VABufferID pipeline_param_buf_id = VA_INVALID_ID;
   VABufferID filters[N_PROPERTIES];
-  VAProcPipelineCaps pipeline_caps;
-  guint i, num_filters = 0;
+  const VAProcPipelineCaps *pipeline_caps;
+  guint i, num_filters = 0, enabled_ops = 0;
   VAStatus va_status;
   VARectangle src_rect, dst_rect;
 
   if (!ensure_operations (filter))
     return GST_VAAPI_FILTER_STATUS_ERROR_ALLOCATION_FAILED;
 
+  if (use_software (filter)) {
+    deint_refs_clear_all (filter);
+    return process_software (filter, src_surface, dst_surface);
+  }
+
   /* Build surface region (source) */
   if (filter->use_crop_rect) {
     const GstVaapiRectangle *const crop_rect = &filter->crop_rect;
@@ -1431,17 +1821,16 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
       goto error;
     }
     filters[num_filters++] = op_data->va_buffer;
+    enabled_ops |= 1U << op_data->op;
   }
 
   /* Validate pipeline caps */
-  va_status = vaQueryVideoProcPipelineCaps (filter->va_display,
-      filter->va_context, filters, num_filters, &pipeline_caps);
-  if (!vaapi_check_status (va_status, "vaQueryVideoProcPipelineCaps()"))
+  if (!ensure_pipeline_caps (filter, filters, num_filters, enabled_ops))
     goto error;
+  pipeline_caps = &filter->pipeline_caps;
 
-  if (!vaapi_create_buffer (filter->va_display, filter->va_context,
-          VAProcPipelineParameterBufferType, sizeof (*pipeline_param),
-          NULL, &pipeline_param_buf_id, (gpointer *) & pipeline_param))
+  if (!ensure_pipeline_param_buffer (filter, &pipeline_param_buf_id,
+          &pipeline_param))
     goto error;
 
   memset (pipeline_param, 0, sizeof (*pipeline_param));
@@ -1462,7 +1851,7 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
         filter->forward_references->data;
     pipeline_param->num_forward_references =
         MIN (filter->forward_references->len,
-        pipeline_caps.num_forward_references);
+        pipeline_caps->num_forward_references);
   } else {
     pipeline_param->forward_references = NULL;
     pipeline_param->num_forward_references = 0;
@@ -1473,7 +1862,7 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
         filter->backward_references->data;
     pipeline_param->num_backward_references =
         MIN (filter->backward_references->len,
-        pipeline_caps.num_backward_references);
+        pipeline_caps->num_backward_references);
   } else {
     pipeline_param->backward_references = NULL;
     pipeline_param->num_backward_references = 0;
@@ -1481,29 +1870,33 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
 
   vaapi_unmap_buffer (filter->va_display, pipeline_param_buf_id, NULL);
 
-  va_status = vaBeginPicture (filter->va_display, filter->va_context,
-      GST_VAAPI_OBJECT_ID (dst_surface));
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      BEGIN_PICTURE, 0,
+      vaBeginPicture (filter->va_display, filter->va_context,
+          GST_VAAPI_OBJECT_ID (dst_surface)));
   if (!vaapi_check_status (va_status, "vaBeginPicture()"))
     goto error;
 
-  va_status = vaRenderPicture (filter->va_display, filter->va_context,
-      &pipeline_param_buf_id, 1);
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      RENDER_PICTURE, 0,
+      vaRenderPicture (filter->va_display, filter->va_context,
+          &pipeline_param_buf_id, 1));
   if (!vaapi_check_status (va_status, "vaRenderPicture()"))
     goto error;
 
-  va_status = vaEndPicture (filter->va_display, filter->va_context);
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      END_PICTURE, 0, vaEndPicture (filter->va_display, filter->va_context));
   if (!vaapi_check_status (va_status, "vaEndPicture()"))
     goto error;
 
   deint_refs_clear_all (filter);
-  vaapi_destroy_buffer (filter->va_display, &pipeline_param_buf_id);
+  filter->num_frames++;
   return GST_VAAPI_FILTER_STATUS_SUCCESS;
 
   /* ERRORS */
 error:
   {
     deint_refs_clear_all (filter);
-    vaapi_destroy_buffer (filter->va_display, &pipeline_param_buf_id);
     return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
   }
 #endif
@@ -1523,13 +1916,241 @@ gst_vaapi_filter_process (GstVaapiFilter * filter,
   g_return_val_if_fail (dst_surface != NULL,
       GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  g_mutex_lock (&filter->lock);
   status = gst_vaapi_filter_process_unlocked (filter,
       src_surface, dst_surface, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  g_mutex_unlock (&filter->lock);
+  return status;
+}
+
+/* Allocate at least @num_buffers pipeline parameter buffers for the
+   entries of a composition. They are kept for the next compositions */
+#if USE_VA_VPP
+static gboolean
+ensure_blend_param_buffers (GstVaapiFilter * filter, guint num_buffers)
+{
+  VABufferID buf_id;
+
+  if (!filter->blend_param_buffers) {
+    filter->blend_param_buffers =
+        g_array_sized_new (FALSE, FALSE, sizeof (VABufferID), num_buffers);
+    if (!filter->blend_param_buffers)
+      return FALSE;
+  }
+
+  while (filter->blend_param_buffers->len < num_buffers) {
+    if (!vaapi_create_buffer (filter->va_display, filter->va_context,
+            VAProcPipelineParameterBufferType,
+            sizeof (VAProcPipelineParameterBuffer), NULL, &buf_id, NULL))
+      return FALSE;
+    g_array_append_val (filter->blend_param_buffers, buf_id);
+  }
+  return TRUE;
+}
+
+/* Fill in a VA rectangle from @rect, or from the whole @surface */
+static gboolean
+get_surface_region (GstVaapiSurface * surface, const GstVaapiRectangle * rect,
+    VARectangle * va_rect)
+{
+  if (!rect) {
+    va_rect->x = 0;
+    va_rect->y = 0;
+    va_rect->width = GST_VAAPI_SURFACE_WIDTH (surface);
+    va_rect->height = GST_VAAPI_SURFACE_HEIGHT (surface);
+    return TRUE;
+  }
+
+  if ((rect->x + rect->width > GST_VAAPI_SURFACE_WIDTH (surface)) ||
+      (rect->y + rect->height > GST_VAAPI_SURFACE_HEIGHT (surface)))
+    return FALSE;
+
+  va_rect->x = rect->x;
+  va_rect->y = rect->y;
+  va_rect->width = rect->width;
+  va_rect->height = rect->height;
+  return TRUE;
+}
+#endif
+
+static GstVaapiFilterStatus
+gst_vaapi_filter_compose_unlocked (GstVaapiFilter * filter,
+    const GstVaapiBlendSurface * surfaces, guint num_surfaces,
+    GstVaapiSurface * dst_surface)
+{
+#if USE_VA_VPP
+  VAProcPipelineParameterBuffer *pipeline_param;
+  VARectangle *src_rects, *dst_rects;
+  VABlendState *blend_states;
+  VABufferID *buf_ids;
+  VAStatus va_status;
+  guint i;
+
+  /* The software engine does not blend */
+  if (use_software (filter))
+    return GST_VAAPI_FILTER_STATUS_ERROR_UNSUPPORTED_OPERATION;
+
+  if (!ensure_blend_param_buffers (filter, num_surfaces))
+    return GST_VAAPI_FILTER_STATUS_ERROR_ALLOCATION_FAILED;
+  buf_ids = (VABufferID *) filter->blend_param_buffers->data;
+
+  /* The regions and blend states are referenced by the parameter
+     buffers, so they have to live until vaEndPicture() */
+  src_rects = g_new (VARectangle, num_surfaces);
+  dst_rects = g_new (VARectangle, num_surfaces);
+  blend_states = g_new0 (VABlendState, num_surfaces);
+
+  for (i = 0; i < num_surfaces; i++) {
+    const GstVaapiBlendSurface *const blend = &surfaces[i];
+
+    if (!get_surface_region (blend->surface, blend->crop, &src_rects[i]) ||
+        !get_surface_region (dst_surface, &blend->target, &dst_rects[i]))
+      goto error_invalid_region;
+
+    blend_states[i].flags = VA_BLEND_GLOBAL_ALPHA;
+    blend_states[i].global_alpha = CLAMP (blend->alpha, 0.0, 1.0);
+
+    pipeline_param = vaapi_map_buffer (filter->va_display, buf_ids[i]);
+    if (!pipeline_param)
+      goto error;
+
+    memset (pipeline_param, 0, sizeof (*pipeline_param));
+    pipeline_param->surface = GST_VAAPI_OBJECT_ID (blend->surface);
+    pipeline_param->surface_region = &src_rects[i];
+    pipeline_param->surface_color_standard = VAProcColorStandardNone;
+    pipeline_param->output_region = &dst_rects[i];
+    pipeline_param->output_color_standard = VAProcColorStandardNone;
+    pipeline_param->output_background_color = 0xff000000;
+    pipeline_param->filter_flags =
+        from_GstVaapiScaleMethod (filter->scale_method);
+    pipeline_param->blend_state = &blend_states[i];
+
+    vaapi_unmap_buffer (filter->va_display, buf_ids[i], NULL);
+  }
+
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      BEGIN_PICTURE, 0,
+      vaBeginPicture (filter->va_display, filter->va_context,
+          GST_VAAPI_OBJECT_ID (dst_surface)));
+  if (!vaapi_check_status (va_status, "vaBeginPicture()"))
+    goto error;
+
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      RENDER_PICTURE, 0,
+      vaRenderPicture (filter->va_display, filter->va_context, buf_ids,
+          num_surfaces));
+  if (!vaapi_check_status (va_status, "vaRenderPicture()"))
+    goto error;
+
+  GST_VAAPI_PROFILER_CALL (va_status, filter->va_display, filter->va_context,
+      END_PICTURE, 0, vaEndPicture (filter->va_display, filter->va_context));
+  if (!vaapi_check_status (va_status, "vaEndPicture()"))
+    goto error;
+
+  g_free (src_rects);
+  g_free (dst_rects);
+  g_free (blend_states);
+  filter->num_frames++;
+  return GST_VAAPI_FILTER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_invalid_region:
+  {
+    GST_ERROR ("composition entry %u exceeds the surface bounds", i);
+    g_free (src_rects);
+    g_free (dst_rects);
+    g_free (blend_states);
+    return GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+  }
+error:
+  {
+    g_free (src_rects);
+    g_free (dst_rects);
+    g_free (blend_states);
+    return GST_VAAPI_FILTER_STATUS_ERROR_OPERATION_FAILED;
+  }
+#endif
+  return GST_VAAPI_FILTER_STATUS_ERROR_UNSUPPORTED_OPERATION;
+}
+
+/**
+ * gst_vaapi_filter_compose:
+ * @filter: a #GstVaapiFilter
+ * @surfaces: (array length=num_surfaces): the entries to compose
+ * @num_surfaces: the number of entries in @surfaces
+ * @dst_surface: the destination #GstVaapiSurface
+ *
+ * Renders all the @surfaces into @dst_surface, in order, within a
+ * single video processing picture. Each entry is scaled from its
+ * cropping region to its target region, and blended with its global
+ * alpha value. Only the scaling method and the output format of the
+ * @filter apply, other operations are ignored.
+ *
+ * This is the building block of mosaics, e.g. video walls, that would
+ * otherwise cost one picture submission and one copy per tile. Note
+ * that the driver has to support several pipeline parameter buffers
+ * per picture, and that the software engine does not compose.
+ *
+ * Return value: a #GstVaapiFilterStatus
+ */
+GstVaapiFilterStatus
+gst_vaapi_filter_compose (GstVaapiFilter * filter,
+    const GstVaapiBlendSurface * surfaces, guint num_surfaces,
+    GstVaapiSurface * dst_surface)
+{
+  GstVaapiFilterStatus status;
+  guint i;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (surfaces != NULL || num_surfaces == 0,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (dst_surface != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  if (num_surfaces == 0)
+    return GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+  for (i = 0; i < num_surfaces; i++) {
+    if (!surfaces[i].surface)
+      return GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+  }
+
+  g_mutex_lock (&filter->lock);
+  status = gst_vaapi_filter_compose_unlocked (filter, surfaces, num_surfaces,
+      dst_surface);
+  g_mutex_unlock (&filter->lock);
   return status;
 }
 
+/**
+ * gst_vaapi_filter_get_stats:
+ * @filter: a #GstVaapiFilter
+ * @num_frames_ptr: (out) (allow-none): return location for the number
+ *   of frames processed
+ * @num_caps_queries_ptr: (out) (allow-none): return location for the
+ *   number of video processing pipeline caps queries issued to process
+ *   them
+ *
+ * Retrieves the @filter statistics, accumulated by
+ * gst_vaapi_filter_process(). Once the pipeline parameter buffers
+ * are allocated, and unless the operations change, a frame costs no
+ * more than mapping and unmapping a parameter buffer, plus submitting
+ * it. The VA calls themselves are accounted by the profiler.
+ */
+void
+gst_vaapi_filter_get_stats (GstVaapiFilter * filter, guint64 * num_frames_ptr,
+    guint64 * num_caps_queries_ptr)
+{
+  g_return_if_fail (filter != NULL);
+
+  g_mutex_lock (&filter->lock);
+  if (num_frames_ptr)
+    *num_frames_ptr = filter->num_frames;
+  if (num_caps_queries_ptr)
+    *num_caps_queries_ptr = filter->num_pipeline_caps_queries;
+  g_mutex_unlock (&filter->lock);
+}
+
 /**
  * gst_vaapi_filter_get_formats:
  * @filter: a #GstVaapiFilter
@@ -30,6 +30,7 @@ G_BEGIN_DECLS
 
 typedef struct _GstVaapiFilter                  GstVaapiFilter;
 typedef struct _GstVaapiFilterOpInfo            GstVaapiFilterOpInfo;
+typedef struct _GstVaapiBlendSurface            GstVaapiBlendSurface;
 
 /**
  * @GST_VAAPI_FILTER_OP_FORMAT: Force output pixel format (#GstVideoFormat).
@@ -72,6 +73,24 @@ struct _GstVaapiFilterOpInfo
   GParamSpec *const pspec;
 };
 
+/**
+ * GstVaapiBlendSurface:
+ * @surface: the source #GstVaapiSurface
+ * @crop: (allow-none): the region of @surface to compose, or %NULL
+ *   for the whole surface
+ * @target: the region of the destination surface to compose into
+ * @alpha: the global alpha value of @surface, in the [0.0, 1.0] range
+ *
+ * An entry of a composition, as rendered by gst_vaapi_filter_compose().
+ */
+struct _GstVaapiBlendSurface
+{
+  GstVaapiSurface *surface;
+  const GstVaapiRectangle *crop;
+  GstVaapiRectangle target;
+  gfloat alpha;
+};
+
 /**
  * GstVaapiFilterStatus:
  * @GST_VAAPI_FILTER_STATUS_SUCCESS: Success.
@@ -197,6 +216,15 @@ GstVaapiFilterStatus
 gst_vaapi_filter_process (GstVaapiFilter * filter,
     GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface, guint flags);
 
+GstVaapiFilterStatus
+gst_vaapi_filter_compose (GstVaapiFilter * filter,
+    const GstVaapiBlendSurface * surfaces, guint num_surfaces,
+    GstVaapiSurface * dst_surface);
+
+void
+gst_vaapi_filter_get_stats (GstVaapiFilter * filter, guint64 * num_frames_ptr,
+    guint64 * num_caps_queries_ptr);
+
 GArray *
 gst_vaapi_filter_get_formats (GstVaapiFilter * filter);
 
@@ -0,0 +1,829 @@
+/*
+ *  gstvaapifilter_sw.c - Software scaling and color conversion
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapifilter_sw
+ * @short_description: Software scaling and color conversion
+ *
+ * The CPU engine #GstVaapiFilter falls back to when the driver does
+ * not expose a video processing pipeline, or not for the requested
+ * format. It crops, scales and converts between 4:2:0 YUV and 32-bit
+ * RGB formats, working directly on the planes of mapped images.
+ *
+ * Scaling is separable and uses fixed-point weights, with bilinear
+ * interpolation for the fast and default methods and a Lanczos-3
+ * kernel for the high quality one. Except for the fast method, the
+ * kernels are widened when downscaling to avoid aliasing. The inner
+ * loops are written so that the compiler vectorizes them, and the
+ * output rows of each plane are split into bands processed by a
+ * shared pool of threads.
+ */
+
+#include "sysdeps.h"
+#include <math.h>
+#include "gstvaapifilter_sw.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Fixed-point precision of the filter weights, and of the samples
+   between the vertical and horizontal passes */
+#define WEIGHT_BITS     14
+#define INTER_BITS      7
+
+/* Output rows are split into bands of at least MIN_BAND_ROWS rows,
+   and into MAX_BANDS bands at most */
+#define MIN_BAND_ROWS   16
+#define MAX_BANDS       8
+
+typedef struct _FormatInfo FormatInfo;
+struct _FormatInfo
+{
+  GstVideoFormat format;
+  guint is_rgb:1;
+  guint has_alpha:1;
+  /* Y, U, V or R, G, B, A components */
+  guint8 plane[4];
+  guint8 offset[4];
+  guint8 pixel_stride[4];
+};
+
+static const FormatInfo g_format_infos[] = {
+  {GST_VIDEO_FORMAT_NV12, FALSE, FALSE, {0, 1, 1}, {0, 0, 1}, {1, 2, 2}},
+  {GST_VIDEO_FORMAT_I420, FALSE, FALSE, {0, 1, 2}, {0, 0, 0}, {1, 1, 1}},
+  {GST_VIDEO_FORMAT_YV12, FALSE, FALSE, {0, 2, 1}, {0, 0, 0}, {1, 1, 1}},
+#define RGB_FORMAT(FORMAT, HAS_ALPHA, R, G, B, A) \
+  {GST_VIDEO_FORMAT_##FORMAT, TRUE, HAS_ALPHA, \
+   {0, 0, 0, 0}, {R, G, B, A}, {4, 4, 4, 4}}
+  RGB_FORMAT (RGBA, TRUE, 0, 1, 2, 3),
+  RGB_FORMAT (BGRA, TRUE, 2, 1, 0, 3),
+  RGB_FORMAT (ARGB, TRUE, 1, 2, 3, 0),
+  RGB_FORMAT (ABGR, TRUE, 3, 2, 1, 0),
+  RGB_FORMAT (RGBx, FALSE, 0, 1, 2, 3),
+  RGB_FORMAT (BGRx, FALSE, 2, 1, 0, 3),
+  RGB_FORMAT (xRGB, FALSE, 1, 2, 3, 0),
+  RGB_FORMAT (xBGR, FALSE, 3, 2, 1, 0),
+#undef RGB_FORMAT
+};
+
+static const FormatInfo *
+get_format_info (GstVideoFormat format)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (g_format_infos); i++) {
+    if (g_format_infos[i].format == format)
+      return &g_format_infos[i];
+  }
+  return NULL;
+}
+
+static inline guint
+get_num_components (const FormatInfo * info)
+{
+  return info->is_rgb ? 4 : 3;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Bands                                                             --- */
+/* ------------------------------------------------------------------------- */
+
+typedef void (*BandFunc) (gpointer data, guint y0, guint y1);
+
+typedef struct _BandSync BandSync;
+struct _BandSync
+{
+  GMutex lock;
+  GCond cond;
+  guint num_pending;
+};
+
+typedef struct _Band Band;
+struct _Band
+{
+  BandFunc func;
+  gpointer data;
+  guint y0;
+  guint y1;
+  BandSync *sync;
+};
+
+static guint
+get_max_bands (void)
+{
+  return MIN (g_get_num_processors (), MAX_BANDS);
+}
+
+static void
+band_worker (gpointer data, gpointer user_data)
+{
+  Band *const band = data;
+  BandSync *const sync = band->sync;
+
+  band->func (band->data, band->y0, band->y1);
+
+  g_mutex_lock (&sync->lock);
+  if (--sync->num_pending == 0)
+    g_cond_signal (&sync->cond);
+  g_mutex_unlock (&sync->lock);
+}
+
+static gpointer
+create_thread_pool (gpointer data)
+{
+  const guint max_bands = get_max_bands ();
+
+  /* The calling thread processes the first band itself */
+  if (max_bands < 2)
+    return NULL;
+  return g_thread_pool_new (band_worker, NULL, max_bands - 1, FALSE, NULL);
+}
+
+static GThreadPool *
+get_thread_pool (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, create_thread_pool, NULL);
+}
+
+/* Runs func() over [0, num_rows), split into bands processed in
+   parallel. Returns once all the bands are complete */
+static void
+run_bands (BandFunc func, gpointer data, guint num_rows)
+{
+  Band bands[MAX_BANDS];
+  BandSync sync;
+  GThreadPool *pool;
+  guint i, num_bands;
+
+  num_bands = CLAMP (num_rows / MIN_BAND_ROWS, 1, get_max_bands ());
+  pool = num_bands > 1 ? get_thread_pool () : NULL;
+  if (!pool) {
+    func (data, 0, num_rows);
+    return;
+  }
+
+  g_mutex_init (&sync.lock);
+  g_cond_init (&sync.cond);
+  sync.num_pending = num_bands - 1;
+
+  for (i = 0; i < num_bands; i++) {
+    Band *const band = &bands[i];
+
+    band->func = func;
+    band->data = data;
+    band->y0 = (i * num_rows) / num_bands;
+    band->y1 = ((i + 1) * num_rows) / num_bands;
+    band->sync = &sync;
+  }
+
+  for (i = 1; i < num_bands; i++) {
+    GError *error = NULL;
+
+    g_thread_pool_push (pool, &bands[i], &error);
+    if (error) {
+      GST_WARNING ("failed to dispatch band: %s", error->message);
+      g_error_free (error);
+      band_worker (&bands[i], NULL);
+    }
+  }
+  func (data, bands[0].y0, bands[0].y1);
+
+  g_mutex_lock (&sync.lock);
+  while (sync.num_pending > 0)
+    g_cond_wait (&sync.cond, &sync.lock);
+  g_mutex_unlock (&sync.lock);
+
+  g_cond_clear (&sync.cond);
+  g_mutex_clear (&sync.lock);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Planes                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+/* A region of one component, e.g. the U samples of a NV12 image */
+typedef struct _Plane Plane;
+struct _Plane
+{
+  guint8 *data;
+  guint stride;
+  guint pixel_stride;
+  guint width;
+  guint height;
+};
+
+static void
+get_plane (const GstVaapiFilterSwFrame * frame, const FormatInfo * info,
+    guint comp, const GstVaapiRectangle * rect, Plane * plane)
+{
+  const guint p = info->plane[comp];
+  guint x, y;
+
+  if (!info->is_rgb && comp > 0) {
+    x = rect->x / 2;
+    y = rect->y / 2;
+    plane->width = (rect->x + rect->width + 1) / 2 - x;
+    plane->height = (rect->y + rect->height + 1) / 2 - y;
+  } else {
+    x = rect->x;
+    y = rect->y;
+    plane->width = rect->width;
+    plane->height = rect->height;
+  }
+  plane->stride = frame->stride[p];
+  plane->pixel_stride = info->pixel_stride[comp];
+  plane->data = frame->data[p] + y * plane->stride +
+      x * plane->pixel_stride + info->offset[comp];
+}
+
+static void
+fill_plane (const Plane * plane, guint8 value)
+{
+  guint x, y;
+
+  for (y = 0; y < plane->height; y++) {
+    guint8 *const out = plane->data + y * plane->stride;
+
+    if (plane->pixel_stride == 1)
+      memset (out, value, plane->width);
+    else {
+      for (x = 0; x < plane->width; x++)
+        out[x * plane->pixel_stride] = value;
+    }
+  }
+}
+
+/* Fills the whole frame with opaque black */
+static void
+fill_frame (const GstVaapiFilterSwFrame * frame, const FormatInfo * info)
+{
+  static const guint8 yuv_black[] = { 16, 128, 128 };
+  static const guint8 rgb_black[] = { 0, 0, 0, 255 };
+  const GstVaapiRectangle rect = { 0, 0, frame->width, frame->height };
+  Plane plane;
+  guint i;
+
+  for (i = 0; i < get_num_components (info); i++) {
+    get_plane (frame, info, i, &rect, &plane);
+    fill_plane (&plane, info->is_rgb ? rgb_black[i] : yuv_black[i]);
+  }
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Scaling                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+/* The weights of each output sample, for one axis */
+typedef struct _Coeffs Coeffs;
+struct _Coeffs
+{
+  guint num_taps;
+  gint *indices;
+  gint32 *weights;
+};
+
+typedef gdouble (*KernelFunc) (gdouble x);
+
+static gdouble
+kernel_bilinear (gdouble x)
+{
+  x = fabs (x);
+  return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static gdouble
+kernel_lanczos3 (gdouble x)
+{
+  gdouble px;
+
+  if (x == 0.0)
+    return 1.0;
+  if (fabs (x) >= 3.0)
+    return 0.0;
+
+  px = G_PI * x;
+  return 3.0 * sin (px) * sin (px / 3.0) / (px * px);
+}
+
+static void
+coeffs_init (Coeffs * coeffs, guint src_len, guint dst_len,
+    GstVaapiScaleMethod method)
+{
+  const gdouble scale = (gdouble) src_len / dst_len;
+  const gint one = 1 << WEIGHT_BITS;
+  gdouble support, factor, radius, *w;
+  KernelFunc kernel;
+  guint i, t;
+
+  /* Same size: a plain copy of the samples */
+  if (src_len == dst_len) {
+    coeffs->num_taps = 1;
+    coeffs->indices = g_new (gint, dst_len);
+    coeffs->weights = g_new (gint32, dst_len);
+    for (i = 0; i < dst_len; i++) {
+      coeffs->indices[i] = i;
+      coeffs->weights[i] = one;
+    }
+    return;
+  }
+
+  if (method == GST_VAAPI_SCALE_METHOD_HQ) {
+    kernel = kernel_lanczos3;
+    support = 3.0;
+  } else {
+    kernel = kernel_bilinear;
+    support = 1.0;
+  }
+  factor = (method != GST_VAAPI_SCALE_METHOD_FAST && scale > 1.0) ?
+      scale : 1.0;
+  radius = support * factor;
+
+  coeffs->num_taps = (guint) ceil (2.0 * radius);
+  coeffs->indices = g_new (gint, dst_len * coeffs->num_taps);
+  coeffs->weights = g_new (gint32, dst_len * coeffs->num_taps);
+  w = g_new (gdouble, coeffs->num_taps);
+
+  for (i = 0; i < dst_len; i++) {
+    gint *const indices = &coeffs->indices[i * coeffs->num_taps];
+    gint32 *const weights = &coeffs->weights[i * coeffs->num_taps];
+    const gdouble center = (i + 0.5) * scale - 0.5;
+    const gint start = (gint) floor (center - radius) + 1;
+    gdouble sum = 0.0;
+    gint total = 0;
+    guint best = 0;
+
+    for (t = 0; t < coeffs->num_taps; t++) {
+      w[t] = kernel ((start + (gint) t - center) / factor);
+      sum += w[t];
+    }
+
+    /* Normalize, and make the weights sum to one exactly */
+    for (t = 0; t < coeffs->num_taps; t++) {
+      indices[t] = CLAMP (start + (gint) t, 0, (gint) src_len - 1);
+      weights[t] = sum != 0.0 ? (gint32) lrint (w[t] / sum * one) : 0;
+      total += weights[t];
+      if (weights[t] > weights[best])
+        best = t;
+    }
+    weights[best] += one - total;
+  }
+  g_free (w);
+}
+
+static void
+coeffs_clear (Coeffs * coeffs)
+{
+  g_free (coeffs->indices);
+  g_free (coeffs->weights);
+}
+
+typedef struct _ScaleJob ScaleJob;
+struct _ScaleJob
+{
+  Plane src;
+  Plane dst;
+  Coeffs hcoeffs;
+  Coeffs vcoeffs;
+};
+
+static void
+scale_rows (gpointer data, guint y0, guint y1)
+{
+  ScaleJob *const job = data;
+  const Plane *const src = &job->src;
+  const Plane *const dst = &job->dst;
+  const guint num_htaps = job->hcoeffs.num_taps;
+  const guint num_vtaps = job->vcoeffs.num_taps;
+  gint32 *row;
+  guint x, y, t;
+
+  row = g_new (gint32, src->width);
+  for (y = y0; y < y1; y++) {
+    const gint *const vindices = &job->vcoeffs.indices[y * num_vtaps];
+    const gint32 *const vweights = &job->vcoeffs.weights[y * num_vtaps];
+    guint8 *const out = dst->data + y * dst->stride;
+
+    /* Vertical pass, over the source columns */
+    memset (row, 0, src->width * sizeof (*row));
+    for (t = 0; t < num_vtaps; t++) {
+      const guint8 *const in = src->data + vindices[t] * src->stride;
+      const gint32 w = vweights[t];
+
+      if (src->pixel_stride == 1) {
+        for (x = 0; x < src->width; x++)
+          row[x] += w * in[x];
+      } else {
+        for (x = 0; x < src->width; x++)
+          row[x] += w * in[x * src->pixel_stride];
+      }
+    }
+    for (x = 0; x < src->width; x++)
+      row[x] = (row[x] + (1 << (WEIGHT_BITS - INTER_BITS - 1))) >>
+          (WEIGHT_BITS - INTER_BITS);
+
+    /* Horizontal pass, into the output row */
+    for (x = 0; x < dst->width; x++) {
+      const gint *const hindices = &job->hcoeffs.indices[x * num_htaps];
+      const gint32 *const hweights = &job->hcoeffs.weights[x * num_htaps];
+      gint32 sum = 1 << (WEIGHT_BITS + INTER_BITS - 1);
+
+      for (t = 0; t < num_htaps; t++)
+        sum += hweights[t] * row[hindices[t]];
+      sum >>= WEIGHT_BITS + INTER_BITS;
+      out[x * dst->pixel_stride] = CLAMP (sum, 0, 255);
+    }
+  }
+  g_free (row);
+}
+
+static void
+copy_rows (gpointer data, guint y0, guint y1)
+{
+  ScaleJob *const job = data;
+  const Plane *const src = &job->src;
+  const Plane *const dst = &job->dst;
+  guint x, y;
+
+  for (y = y0; y < y1; y++) {
+    const guint8 *const in = src->data + y * src->stride;
+    guint8 *const out = dst->data + y * dst->stride;
+
+    if (src->pixel_stride == 1 && dst->pixel_stride == 1)
+      memcpy (out, in, dst->width);
+    else {
+      for (x = 0; x < dst->width; x++)
+        out[x * dst->pixel_stride] = in[x * src->pixel_stride];
+    }
+  }
+}
+
+static void
+scale_plane (const Plane * src, const Plane * dst, GstVaapiScaleMethod method)
+{
+  ScaleJob job;
+
+  job.src = *src;
+  job.dst = *dst;
+  if (src->width == dst->width && src->height == dst->height) {
+    run_bands (copy_rows, &job, dst->height);
+    return;
+  }
+
+  coeffs_init (&job.hcoeffs, src->width, dst->width, method);
+  coeffs_init (&job.vcoeffs, src->height, dst->height, method);
+  run_bands (scale_rows, &job, dst->height);
+  coeffs_clear (&job.vcoeffs);
+  coeffs_clear (&job.hcoeffs);
+}
+
+/* Scales between two formats of the same family, YUV or RGB */
+static void
+scale_frame (const GstVaapiFilterSwFrame * src, const FormatInfo * src_info,
+    const GstVaapiRectangle * src_rect, const GstVaapiFilterSwFrame * dst,
+    const FormatInfo * dst_info, const GstVaapiRectangle * dst_rect,
+    GstVaapiScaleMethod method)
+{
+  Plane src_plane, dst_plane;
+  guint i;
+
+  for (i = 0; i < get_num_components (dst_info); i++) {
+    get_plane (dst, dst_info, i, dst_rect, &dst_plane);
+
+    /* Alpha channel, or padding byte */
+    if (i == 3 && !(src_info->has_alpha && dst_info->has_alpha)) {
+      fill_plane (&dst_plane, 255);
+      continue;
+    }
+    get_plane (src, src_info, i, src_rect, &src_plane);
+    scale_plane (&src_plane, &dst_plane, method);
+  }
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Color conversion                                                  --- */
+/* ------------------------------------------------------------------------- */
+
+/* Conversion of a temporary I420 or RGBA frame, holding the scaled
+   source, into the target rectangle of the destination frame. Bands
+   are made of pairs of rows, i.e. of chroma rows */
+typedef struct _ConvertJob ConvertJob;
+struct _ConvertJob
+{
+  const GstVaapiFilterSwFrame *src;
+  const GstVaapiFilterSwFrame *dst;
+  const FormatInfo *dst_info;
+  const GstVaapiRectangle *dst_rect;
+};
+
+static inline guint8
+clip_uint8 (gint v)
+{
+  return CLAMP (v, 0, 255);
+}
+
+/* ITU-R BT.601, limited range */
+static void
+convert_yuv_to_rgb (gpointer data, guint y0, guint y1)
+{
+  ConvertJob *const job = data;
+  const GstVaapiFilterSwFrame *const src = job->src;
+  const guint8 *const offset = job->dst_info->offset;
+  const guint width = job->dst_rect->width;
+  const guint height = job->dst_rect->height;
+  guint x, y, j;
+
+  for (j = y0; j < y1; j++) {
+    const guint8 *const u_row = src->data[1] + j * src->stride[1];
+    const guint8 *const v_row = src->data[2] + j * src->stride[2];
+
+    for (y = 2 * j; y < MIN (2 * j + 2, height); y++) {
+      const guint8 *const y_row = src->data[0] + y * src->stride[0];
+      guint8 *const out = job->dst->data[0] +
+          (job->dst_rect->y + y) * job->dst->stride[0] +
+          job->dst_rect->x * 4;
+
+      for (x = 0; x < width; x++) {
+        const gint c = 298 * (y_row[x] - 16) + 128;
+        const gint d = u_row[x / 2] - 128;
+        const gint e = v_row[x / 2] - 128;
+        guint8 *const p = out + x * 4;
+
+        p[offset[0]] = clip_uint8 ((c + 409 * e) >> 8);
+        p[offset[1]] = clip_uint8 ((c - 100 * d - 208 * e) >> 8);
+        p[offset[2]] = clip_uint8 ((c + 516 * d) >> 8);
+        p[offset[3]] = 255;
+      }
+    }
+  }
+}
+
+static void
+convert_rgb_to_yuv (gpointer data, guint y0, guint y1)
+{
+  ConvertJob *const job = data;
+  const GstVaapiFilterSwFrame *const src = job->src;
+  const guint width = job->dst_rect->width;
+  const guint height = job->dst_rect->height;
+  Plane planes[3];
+  guint i, x, y, j;
+
+  for (i = 0; i < 3; i++)
+    get_plane (job->dst, job->dst_info, i, job->dst_rect, &planes[i]);
+
+  for (j = y0; j < y1; j++) {
+    const guint y_end = MIN (2 * j + 2, height);
+    guint8 *const u_out = planes[1].data + j * planes[1].stride;
+    guint8 *const v_out = planes[2].data + j * planes[2].stride;
+
+    for (y = 2 * j; y < y_end; y++) {
+      const guint8 *const in = src->data[0] + y * src->stride[0];
+      guint8 *const y_out = planes[0].data + y * planes[0].stride;
+
+      for (x = 0; x < width; x++) {
+        const guint8 *const p = in + x * 4;
+
+        y_out[x * planes[0].pixel_stride] =
+            ((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16;
+      }
+    }
+
+    /* Chroma of the average of each 2x2 block */
+    for (x = 0; x < (width + 1) / 2; x++) {
+      const guint x_end = MIN (2 * x + 2, width);
+      gint r = 0, g = 0, b = 0, n = 0, u, v;
+      guint sx;
+
+      for (y = 2 * j; y < y_end; y++) {
+        const guint8 *const in = src->data[0] + y * src->stride[0];
+
+        for (sx = 2 * x; sx < x_end; sx++) {
+          r += in[sx * 4 + 0];
+          g += in[sx * 4 + 1];
+          b += in[sx * 4 + 2];
+          n++;
+        }
+      }
+      r = (r + n / 2) / n;
+      g = (g + n / 2) / n;
+      b = (b + n / 2) / n;
+
+      u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+      v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+      u_out[x * planes[1].pixel_stride] = clip_uint8 (u);
+      v_out[x * planes[2].pixel_stride] = clip_uint8 (v);
+    }
+  }
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Interface                                                         --- */
+/* ------------------------------------------------------------------------- */
+
+static gboolean
+frame_init (GstVaapiFilterSwFrame * frame, GstVideoFormat format,
+    guint width, guint height)
+{
+  const guint chroma_width = (width + 1) / 2;
+  const guint chroma_height = (height + 1) / 2;
+
+  frame->format = format;
+  frame->width = width;
+  frame->height = height;
+  memset (frame->data, 0, sizeof (frame->data));
+  memset (frame->stride, 0, sizeof (frame->stride));
+
+  switch (format) {
+    case GST_VIDEO_FORMAT_I420:
+      frame->data[0] = g_try_malloc (width * height +
+          2 * chroma_width * chroma_height);
+      if (!frame->data[0])
+        return FALSE;
+      frame->data[1] = frame->data[0] + width * height;
+      frame->data[2] = frame->data[1] + chroma_width * chroma_height;
+      frame->stride[0] = width;
+      frame->stride[1] = chroma_width;
+      frame->stride[2] = chroma_width;
+      break;
+    case GST_VIDEO_FORMAT_RGBA:
+      frame->data[0] = g_try_malloc (width * height * 4);
+      if (!frame->data[0])
+        return FALSE;
+      frame->stride[0] = width * 4;
+      break;
+    default:
+      g_assert_not_reached ();
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+check_rect (const GstVaapiFilterSwFrame * frame,
+    const GstVaapiRectangle * rect)
+{
+  return rect->width > 0 && rect->height > 0 &&
+      rect->x + rect->width <= frame->width &&
+      rect->y + rect->height <= frame->height;
+}
+
+/**
+ * gst_vaapi_filter_sw_has_format:
+ * @format: a #GstVideoFormat
+ *
+ * Determines whether the software engine can read and write images
+ * of the given @format.
+ *
+ * Return value: %TRUE if @format is supported
+ */
+gboolean
+gst_vaapi_filter_sw_has_format (GstVideoFormat format)
+{
+  return get_format_info (format) != NULL;
+}
+
+/**
+ * gst_vaapi_filter_sw_get_formats:
+ *
+ * Determines the set of formats supported by the software engine. The
+ * caller owns the resulting array of #GstVideoFormat elements, so it
+ * shall be released with g_array_unref() after usage.
+ *
+ * Return value: the set of supported formats
+ */
+GArray *
+gst_vaapi_filter_sw_get_formats (void)
+{
+  GArray *formats;
+  guint i;
+
+  formats = g_array_sized_new (FALSE, FALSE, sizeof (GstVideoFormat),
+      G_N_ELEMENTS (g_format_infos));
+  for (i = 0; i < G_N_ELEMENTS (g_format_infos); i++)
+    g_array_append_val (formats, g_format_infos[i].format);
+  return formats;
+}
+
+/**
+ * gst_vaapi_filter_sw_process:
+ * @src: the source frame
+ * @crop_rect: the region of @src to process, or %NULL
+ * @dst: the destination frame
+ * @target_rect: the region of @dst to write, or %NULL
+ * @method: the #GstVaapiScaleMethod
+ *
+ * Scales the @crop_rect region of @src into the @target_rect region
+ * of @dst, converting the pixels to the format of @dst. Outside of
+ * @target_rect, @dst is filled with black, like the background of the
+ * VA video processing pipeline.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_filter_sw_process (const GstVaapiFilterSwFrame * src,
+    const GstVaapiRectangle * crop_rect, GstVaapiFilterSwFrame * dst,
+    const GstVaapiRectangle * target_rect, GstVaapiScaleMethod method)
+{
+  const FormatInfo *src_info, *dst_info, *tmp_info;
+  GstVaapiRectangle src_rect, dst_rect, tmp_rect;
+  GstVaapiFilterSwFrame tmp;
+  ConvertJob job;
+
+  g_return_val_if_fail (src != NULL, FALSE);
+  g_return_val_if_fail (dst != NULL, FALSE);
+
+  src_info = get_format_info (src->format);
+  dst_info = get_format_info (dst->format);
+  if (!src_info || !dst_info)
+    goto error_unsupported_format;
+
+  if (crop_rect)
+    src_rect = *crop_rect;
+  else {
+    src_rect.x = 0;
+    src_rect.y = 0;
+    src_rect.width = src->width;
+    src_rect.height = src->height;
+  }
+
+  if (target_rect)
+    dst_rect = *target_rect;
+  else {
+    dst_rect.x = 0;
+    dst_rect.y = 0;
+    dst_rect.width = dst->width;
+    dst_rect.height = dst->height;
+  }
+
+  if (!check_rect (src, &src_rect) || !check_rect (dst, &dst_rect))
+    goto error_invalid_rect;
+
+  if (dst_rect.width != dst->width || dst_rect.height != dst->height)
+    fill_frame (dst, dst_info);
+
+  if (src_info->is_rgb == dst_info->is_rgb) {
+    scale_frame (src, src_info, &src_rect, dst, dst_info, &dst_rect, method);
+    return TRUE;
+  }
+
+  /* Scale in the source color space first, so that the conversion
+     only processes the pixels of the target rectangle */
+  if (!frame_init (&tmp, src_info->is_rgb ? GST_VIDEO_FORMAT_RGBA :
+          GST_VIDEO_FORMAT_I420, dst_rect.width, dst_rect.height))
+    goto error_allocate_memory;
+  tmp_info = get_format_info (tmp.format);
+
+  tmp_rect.x = 0;
+  tmp_rect.y = 0;
+  tmp_rect.width = tmp.width;
+  tmp_rect.height = tmp.height;
+  scale_frame (src, src_info, &src_rect, &tmp, tmp_info, &tmp_rect, method);
+
+  job.src = &tmp;
+  job.dst = dst;
+  job.dst_info = dst_info;
+  job.dst_rect = &dst_rect;
+  run_bands (src_info->is_rgb ? convert_rgb_to_yuv : convert_yuv_to_rgb,
+      &job, (dst_rect.height + 1) / 2);
+
+  g_free (tmp.data[0]);
+  return TRUE;
+
+  /* ERRORS */
+error_unsupported_format:
+  {
+    GST_ERROR ("unsupported conversion from %s to %s",
+        gst_video_format_to_string (src->format),
+        gst_video_format_to_string (dst->format));
+    return FALSE;
+  }
+error_invalid_rect:
+  {
+    GST_ERROR ("invalid source or target rectangle");
+    return FALSE;
+  }
+error_allocate_memory:
+  {
+    GST_ERROR ("failed to allocate temporary frame");
+    return FALSE;
+  }
+}
@@ -0,0 +1,65 @@
+/*
+ *  gstvaapifilter_sw.h - Software scaling and color conversion
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_FILTER_SW_H
+#define GST_VAAPI_FILTER_SW_H
+
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapitypes.h>
+#include <gst/vaapi/gstvaapifilter.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiFilterSwFrame GstVaapiFilterSwFrame;
+
+/**
+ * GstVaapiFilterSwFrame:
+ * @format: the pixel format of the frame
+ * @width: the width of the frame, in pixels
+ * @height: the height of the frame, in pixels
+ * @data: the base address of each plane
+ * @stride: the stride of each plane, in bytes
+ *
+ * The planes of a mapped image, as processed by the software engine.
+ */
+struct _GstVaapiFilterSwFrame
+{
+  GstVideoFormat format;
+  guint width;
+  guint height;
+  guint8 *data[3];
+  guint stride[3];
+};
+
+gboolean
+gst_vaapi_filter_sw_has_format (GstVideoFormat format);
+
+GArray *
+gst_vaapi_filter_sw_get_formats (void);
+
+gboolean
+gst_vaapi_filter_sw_process (const GstVaapiFilterSwFrame * src,
+    const GstVaapiRectangle * crop_rect, GstVaapiFilterSwFrame * dst,
+    const GstVaapiRectangle * target_rect, GstVaapiScaleMethod method);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_FILTER_SW_H */
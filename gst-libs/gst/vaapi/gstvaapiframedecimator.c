@@ -0,0 +1,177 @@
+/*
+ *  gstvaapiframedecimator.c - Frame-rate decimation schedule
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiframedecimator
+ * @short_description: Frame-rate decimation schedule
+ *
+ * A #GstVaapiFrameDecimator decides, from their timestamps, which
+ * frames of a constant rate input are to be kept so that the output
+ * has a lower frame rate. It lets elements drop frames before any
+ * processing is issued for them.
+ *
+ * The output time line is divided into slots of one output frame
+ * duration, starting at the first input timestamp. Each slot is
+ * filled with the first input frame whose timestamp falls into it,
+ * and the kept frames are retimestamped to the start of their slot.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiframedecimator.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/**
+ * gst_vaapi_frame_decimator_init:
+ * @decimator: a #GstVaapiFrameDecimator
+ * @in_fps_n: the input frame rate numerator
+ * @in_fps_d: the input frame rate denominator
+ * @out_fps_n: the output frame rate numerator
+ * @out_fps_d: the output frame rate denominator
+ *
+ * Initializes @decimator to convert the input frame rate to the output
+ * frame rate. The decimator is only active if both rates are known,
+ * and if the output frame rate is lower than the input frame rate.
+ */
+void
+gst_vaapi_frame_decimator_init (GstVaapiFrameDecimator * decimator,
+    gint in_fps_n, gint in_fps_d, gint out_fps_n, gint out_fps_d)
+{
+  g_return_if_fail (decimator != NULL);
+
+  decimator->in_fps_n = in_fps_n;
+  decimator->in_fps_d = in_fps_d;
+  decimator->out_fps_n = out_fps_n;
+  decimator->out_fps_d = out_fps_d;
+  gst_vaapi_frame_decimator_reset (decimator);
+
+  if (gst_vaapi_frame_decimator_is_active (decimator))
+    GST_DEBUG ("decimating %d/%d fps to %d/%d fps", in_fps_n, in_fps_d,
+        out_fps_n, out_fps_d);
+}
+
+/**
+ * gst_vaapi_frame_decimator_reset:
+ * @decimator: a #GstVaapiFrameDecimator
+ *
+ * Restarts the schedule, e.g. after a discontinuity. The next input
+ * frame is kept and becomes the origin of the output time line.
+ */
+void
+gst_vaapi_frame_decimator_reset (GstVaapiFrameDecimator * decimator)
+{
+  g_return_if_fail (decimator != NULL);
+
+  decimator->base_ts = GST_CLOCK_TIME_NONE;
+  decimator->last_index = -1;
+}
+
+/**
+ * gst_vaapi_frame_decimator_is_active:
+ * @decimator: a #GstVaapiFrameDecimator
+ *
+ * Checks whether @decimator drops any frames.
+ *
+ * Return value: %TRUE if the output frame rate is lower than the input
+ *   frame rate
+ */
+gboolean
+gst_vaapi_frame_decimator_is_active (const GstVaapiFrameDecimator * decimator)
+{
+  g_return_val_if_fail (decimator != NULL, FALSE);
+
+  if (decimator->in_fps_n <= 0 || decimator->in_fps_d <= 0)
+    return FALSE;
+  if (decimator->out_fps_n <= 0 || decimator->out_fps_d <= 0)
+    return FALSE;
+  return gst_util_fraction_compare (decimator->out_fps_n,
+      decimator->out_fps_d, decimator->in_fps_n, decimator->in_fps_d) < 0;
+}
+
+/**
+ * gst_vaapi_frame_decimator_keep:
+ * @decimator: a #GstVaapiFrameDecimator
+ * @timestamp: the input frame timestamp
+ * @out_timestamp_ptr: (out) (allow-none): return location for the
+ *   output frame timestamp
+ * @out_duration_ptr: (out) (allow-none): return location for the
+ *   output frame duration
+ *
+ * Decides whether the input frame at @timestamp is kept. If so, the
+ * timestamp and duration of the resulting output frame are returned.
+ * Frames without a valid timestamp are always kept as is. A timestamp
+ * going backwards restarts the schedule.
+ *
+ * If @decimator is not active, all frames are kept, and the output
+ * duration is %GST_CLOCK_TIME_NONE.
+ *
+ * Return value: %TRUE if the frame is kept, %FALSE if it is dropped
+ */
+gboolean
+gst_vaapi_frame_decimator_keep (GstVaapiFrameDecimator * decimator,
+    GstClockTime timestamp, GstClockTime * out_timestamp_ptr,
+    GstClockTime * out_duration_ptr)
+{
+  GstClockTime out_timestamp, out_duration;
+  guint64 in_index, out_index;
+
+  g_return_val_if_fail (decimator != NULL, TRUE);
+
+  out_timestamp = timestamp;
+  out_duration = GST_CLOCK_TIME_NONE;
+  if (!gst_vaapi_frame_decimator_is_active (decimator))
+    goto done;
+
+  out_duration = gst_util_uint64_scale_int (GST_SECOND,
+      decimator->out_fps_d, decimator->out_fps_n);
+  if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+    goto done;
+
+  if (!GST_CLOCK_TIME_IS_VALID (decimator->base_ts)
+      || timestamp < decimator->base_ts) {
+    decimator->base_ts = timestamp;
+    decimator->last_index = -1;
+  }
+
+  /* Map the input frame to the output slot it falls into */
+  in_index = gst_util_uint64_scale_round (timestamp - decimator->base_ts,
+      decimator->in_fps_n, (guint64) decimator->in_fps_d * GST_SECOND);
+  out_index = gst_util_uint64_scale (in_index,
+      (guint64) decimator->out_fps_n * decimator->in_fps_d,
+      (guint64) decimator->out_fps_d * decimator->in_fps_n);
+  if ((gint64) out_index <= decimator->last_index)
+    return FALSE;
+  decimator->last_index = out_index;
+
+  out_timestamp = decimator->base_ts + gst_util_uint64_scale (out_index,
+      (guint64) decimator->out_fps_d * GST_SECOND, decimator->out_fps_n);
+  out_duration = decimator->base_ts + gst_util_uint64_scale (out_index + 1,
+      (guint64) decimator->out_fps_d * GST_SECOND, decimator->out_fps_n) -
+      out_timestamp;
+
+done:
+  if (out_timestamp_ptr)
+    *out_timestamp_ptr = out_timestamp;
+  if (out_duration_ptr)
+    *out_duration_ptr = out_duration;
+  return TRUE;
+}
@@ -0,0 +1,71 @@
+/*
+ *  gstvaapiframedecimator.h - Frame-rate decimation schedule
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_FRAME_DECIMATOR_H
+#define GST_VAAPI_FRAME_DECIMATOR_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiFrameDecimator GstVaapiFrameDecimator;
+
+/**
+ * GstVaapiFrameDecimator:
+ * @in_fps_n: input frame rate numerator
+ * @in_fps_d: input frame rate denominator
+ * @out_fps_n: output frame rate numerator
+ * @out_fps_d: output frame rate denominator
+ * @base_ts: timestamp of the first input frame since the last reset
+ * @last_index: index of the last output frame, or -1
+ *
+ * Decides which frames of a constant rate input are kept to produce a
+ * lower output frame rate. All fields are private.
+ */
+struct _GstVaapiFrameDecimator
+{
+  /*< private >*/
+  gint in_fps_n;
+  gint in_fps_d;
+  gint out_fps_n;
+  gint out_fps_d;
+  GstClockTime base_ts;
+  gint64 last_index;
+};
+
+void
+gst_vaapi_frame_decimator_init (GstVaapiFrameDecimator * decimator,
+    gint in_fps_n, gint in_fps_d, gint out_fps_n, gint out_fps_d);
+
+void
+gst_vaapi_frame_decimator_reset (GstVaapiFrameDecimator * decimator);
+
+gboolean
+gst_vaapi_frame_decimator_is_active (const GstVaapiFrameDecimator * decimator);
+
+gboolean
+gst_vaapi_frame_decimator_keep (GstVaapiFrameDecimator * decimator,
+    GstClockTime timestamp, GstClockTime * out_timestamp_ptr,
+    GstClockTime * out_duration_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_FRAME_DECIMATOR_H */
@@ -31,6 +31,7 @@
 #include <string.h>
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapiobject_priv.h"
@@ -118,9 +119,11 @@ gst_vaapi_image_destroy (GstVaapiImage * image)
   GST_DEBUG ("image %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (image_id));
 
   if (image_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
-    status = vaDestroyImage (GST_VAAPI_DISPLAY_VADISPLAY (display), image_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+    GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+        VA_INVALID_ID, DESTROY_IMAGE, 0,
+        vaDestroyImage (GST_VAAPI_DISPLAY_VADISPLAY (display), image_id));
+    GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
     if (!vaapi_check_status (status, "vaDestroyImage()"))
       g_warning ("failed to destroy image %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (image_id));
@@ -142,11 +145,13 @@ _gst_vaapi_image_create (GstVaapiImage * image, GstVideoFormat format)
   if (!va_format)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      (VAImageFormat *) va_format,
-      image->width, image->height, &image->internal_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, CREATE_IMAGE, 0,
+      vaCreateImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          (VAImageFormat *) va_format, image->width, image->height,
+          &image->internal_image));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (status != VA_STATUS_SUCCESS ||
       image->internal_image.format.fourcc != va_format->fourcc)
     return FALSE;
@@ -550,10 +555,12 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaMapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      image->image.buf, (void **) &image->image_data);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, MAP_BUFFER, 0,
+      vaMapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display), image->image.buf,
+          (void **) &image->image_data));
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (display);
   if (!vaapi_check_status (status, "vaMapBuffer()"))
     return FALSE;
 
@@ -603,10 +610,11 @@ _gst_vaapi_image_unmap (GstVaapiImage * image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaUnmapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      image->image.buf);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, UNMAP_BUFFER, 0,
+      vaUnmapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display), image->image.buf));
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (display);
   if (!vaapi_check_status (status, "vaUnmapBuffer()"))
     return FALSE;
 
@@ -0,0 +1,284 @@
+/*
+ *  gstvaapiimagecache.c - Cache of downloaded surface contents
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiimagecache
+ * @short_description: Cache of downloaded surface contents
+ *
+ * A #GstVaapiImageCache keeps the images surfaces were downloaded
+ * into, indexed by surface generation number, so that several readers
+ * of the same picture share a single vaGetImage(). Items are evicted
+ * in least recently used order once the total size of the cached
+ * items exceeds a given budget. Items are pinned while they are in
+ * use and are never evicted then.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiimagecache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct
+{
+  GList link;
+  guint key;
+  gpointer item;
+  gsize size;
+  guint pin_count;
+} CacheEntry;
+
+struct _GstVaapiImageCache
+{
+  GMutex mutex;
+  GHashTable *entries;
+  GQueue lru;                   /* head is the most recently used entry */
+  GstVaapiImageCacheDestroyFunc destroy_func;
+  gpointer user_data;
+  gsize max_size;
+  gsize size;
+  guint64 num_hits;
+  guint64 num_misses;
+};
+
+static void
+cache_remove_entry (GstVaapiImageCache * cache, CacheEntry * entry)
+{
+  GST_LOG ("evict item %p (key %u, %" G_GSIZE_FORMAT " bytes)",
+      entry->item, entry->key, entry->size);
+
+  g_hash_table_remove (cache->entries, GUINT_TO_POINTER (entry->key));
+  g_queue_unlink (&cache->lru, &entry->link);
+  cache->size -= entry->size;
+
+  if (cache->destroy_func)
+    cache->destroy_func (entry->item, cache->user_data);
+  g_slice_free (CacheEntry, entry);
+}
+
+/* Evicts unpinned entries, least recently used first, until @size more
+   bytes fit into the budget */
+static gboolean
+cache_make_room (GstVaapiImageCache * cache, gsize size)
+{
+  GList *l, *prev;
+
+  for (l = cache->lru.tail; l && cache->size + size > cache->max_size;
+      l = prev) {
+    CacheEntry *const entry = l->data;
+
+    prev = l->prev;
+    if (!entry->pin_count)
+      cache_remove_entry (cache, entry);
+  }
+  return cache->size + size <= cache->max_size;
+}
+
+/**
+ * gst_vaapi_image_cache_new:
+ * @max_size: the maximum total size of the cached items, in bytes
+ * @destroy_func: function used to release evicted items
+ * @user_data: the data passed to @destroy_func
+ *
+ * Creates a new #GstVaapiImageCache.
+ *
+ * Return value: the newly allocated #GstVaapiImageCache
+ */
+GstVaapiImageCache *
+gst_vaapi_image_cache_new (gsize max_size,
+    GstVaapiImageCacheDestroyFunc destroy_func, gpointer user_data)
+{
+  GstVaapiImageCache *cache;
+
+  cache = g_slice_new0 (GstVaapiImageCache);
+  if (!cache)
+    return NULL;
+
+  g_mutex_init (&cache->mutex);
+  cache->entries = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_queue_init (&cache->lru);
+  cache->destroy_func = destroy_func;
+  cache->user_data = user_data;
+  cache->max_size = max_size;
+  return cache;
+}
+
+/**
+ * gst_vaapi_image_cache_free:
+ * @cache: a #GstVaapiImageCache
+ *
+ * Releases all the cached items and destroys the @cache. No item
+ * shall be pinned anymore.
+ */
+void
+gst_vaapi_image_cache_free (GstVaapiImageCache * cache)
+{
+  if (!cache)
+    return;
+
+  while (cache->lru.head) {
+    CacheEntry *const entry = cache->lru.head->data;
+
+    g_warn_if_fail (entry->pin_count == 0);
+    cache_remove_entry (cache, entry);
+  }
+  g_hash_table_unref (cache->entries);
+  g_mutex_clear (&cache->mutex);
+  g_slice_free (GstVaapiImageCache, cache);
+}
+
+/**
+ * gst_vaapi_image_cache_lookup:
+ * @cache: a #GstVaapiImageCache
+ * @key: the surface generation number
+ *
+ * Looks up the item cached for @key. On success, the item is pinned
+ * until gst_vaapi_image_cache_release() is called.
+ *
+ * Return value: the cached item, or %NULL if none was found
+ */
+gpointer
+gst_vaapi_image_cache_lookup (GstVaapiImageCache * cache, guint key)
+{
+  CacheEntry *entry;
+  gpointer item = NULL;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  g_mutex_lock (&cache->mutex);
+  entry = g_hash_table_lookup (cache->entries, GUINT_TO_POINTER (key));
+  if (entry) {
+    entry->pin_count++;
+    g_queue_unlink (&cache->lru, &entry->link);
+    g_queue_push_head_link (&cache->lru, &entry->link);
+    item = entry->item;
+    cache->num_hits++;
+  } else
+    cache->num_misses++;
+  g_mutex_unlock (&cache->mutex);
+  return item;
+}
+
+/**
+ * gst_vaapi_image_cache_insert:
+ * @cache: a #GstVaapiImageCache
+ * @key: the surface generation number
+ * @item: the item to cache
+ * @size: the size of @item, in bytes
+ *
+ * Adds @item to the @cache, evicting the least recently used items if
+ * needed. On success, the @cache takes ownership of @item, which is
+ * pinned until gst_vaapi_image_cache_release() is called.
+ *
+ * Return value: %TRUE on success, %FALSE if an item already exists
+ *   for @key or if @item does not fit into the @cache, in which case
+ *   the caller keeps ownership of @item
+ */
+gboolean
+gst_vaapi_image_cache_insert (GstVaapiImageCache * cache, guint key,
+    gpointer item, gsize size)
+{
+  CacheEntry *entry;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (item != NULL, FALSE);
+
+  if (size > cache->max_size)
+    return FALSE;
+
+  g_mutex_lock (&cache->mutex);
+  if (g_hash_table_contains (cache->entries, GUINT_TO_POINTER (key)))
+    goto done;
+  if (!cache_make_room (cache, size))
+    goto done;
+
+  entry = g_slice_new (CacheEntry);
+  entry->link.data = entry;
+  entry->link.prev = NULL;
+  entry->link.next = NULL;
+  entry->key = key;
+  entry->item = item;
+  entry->size = size;
+  entry->pin_count = 1;
+
+  g_hash_table_insert (cache->entries, GUINT_TO_POINTER (key), entry);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  cache->size += size;
+  success = TRUE;
+
+done:
+  g_mutex_unlock (&cache->mutex);
+  return success;
+}
+
+/**
+ * gst_vaapi_image_cache_release:
+ * @cache: a #GstVaapiImageCache
+ * @key: the surface generation number
+ *
+ * Unpins the item cached for @key, which was returned by
+ * gst_vaapi_image_cache_lookup() or added with
+ * gst_vaapi_image_cache_insert().
+ */
+void
+gst_vaapi_image_cache_release (GstVaapiImageCache * cache, guint key)
+{
+  CacheEntry *entry;
+
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->mutex);
+  entry = g_hash_table_lookup (cache->entries, GUINT_TO_POINTER (key));
+  if (entry && entry->pin_count > 0)
+    entry->pin_count--;
+  else
+    g_warning ("releasing unpinned image cache item (key %u)", key);
+  g_mutex_unlock (&cache->mutex);
+}
+
+/**
+ * gst_vaapi_image_cache_get_stats:
+ * @cache: a #GstVaapiImageCache
+ * @hits_ptr: return location for the number of successful lookups,
+ *   or %NULL
+ * @misses_ptr: return location for the number of failed lookups, or
+ *   %NULL
+ * @size_ptr: return location for the total size of the cached items,
+ *   in bytes, or %NULL
+ *
+ * Retrieves the @cache statistics.
+ */
+void
+gst_vaapi_image_cache_get_stats (GstVaapiImageCache * cache,
+    guint64 * hits_ptr, guint64 * misses_ptr, gsize * size_ptr)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_mutex_lock (&cache->mutex);
+  if (hits_ptr)
+    *hits_ptr = cache->num_hits;
+  if (misses_ptr)
+    *misses_ptr = cache->num_misses;
+  if (size_ptr)
+    *size_ptr = cache->size;
+  g_mutex_unlock (&cache->mutex);
+}
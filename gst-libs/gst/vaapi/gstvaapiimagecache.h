@@ -0,0 +1,64 @@
+/*
+ *  gstvaapiimagecache.h - Cache of downloaded surface contents
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_IMAGE_CACHE_H
+#define GST_VAAPI_IMAGE_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiImageCache GstVaapiImageCache;
+
+/**
+ * GstVaapiImageCacheDestroyFunc:
+ * @item: the evicted item
+ * @user_data: the data passed to gst_vaapi_image_cache_new()
+ *
+ * Releases an item evicted from the cache.
+ */
+typedef void (*GstVaapiImageCacheDestroyFunc) (gpointer item,
+    gpointer user_data);
+
+GstVaapiImageCache *
+gst_vaapi_image_cache_new (gsize max_size,
+    GstVaapiImageCacheDestroyFunc destroy_func, gpointer user_data);
+
+void
+gst_vaapi_image_cache_free (GstVaapiImageCache * cache);
+
+gpointer
+gst_vaapi_image_cache_lookup (GstVaapiImageCache * cache, guint key);
+
+gboolean
+gst_vaapi_image_cache_insert (GstVaapiImageCache * cache, guint key,
+    gpointer item, gsize size);
+
+void
+gst_vaapi_image_cache_release (GstVaapiImageCache * cache, guint key);
+
+void
+gst_vaapi_image_cache_get_stats (GstVaapiImageCache * cache,
+    guint64 * hits_ptr, guint64 * misses_ptr, gsize * size_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_IMAGE_CACHE_H */
@@ -0,0 +1,270 @@
+/*
+ *  gstvaapiimagesync.c - Synchronization of VA images with surfaces
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiimagesync
+ * @short_description: Synchronization of VA images with surfaces
+ *
+ * A #GstVaapiImageSync implements the copy-on-access protocol used
+ * when a surface is accessed through an image of its own, i.e. with
+ * vaGetImage() and vaPutImage(). The image is only downloaded when
+ * its previous contents matter, and is uploaded back when a mapping
+ * for writing is released, restricted to the rows that were marked
+ * as modified.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiimagesync.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+static void
+reset_dirty_area (GstVaapiImageSync * sync)
+{
+  sync->dirty_planes = 0;
+  sync->dirty_y = 0;
+  sync->dirty_height = 0;
+}
+
+/**
+ * gst_vaapi_image_sync_init:
+ * @sync: a #GstVaapiImageSync
+ * @funcs: the image transfer operations
+ * @user_data: the data passed to @funcs
+ * @height: the height of the image, in pixels
+ *
+ * Initializes @sync for a surface that holds the current video frame
+ * contents.
+ */
+void
+gst_vaapi_image_sync_init (GstVaapiImageSync * sync,
+    const GstVaapiImageSyncFuncs * funcs, gpointer user_data, guint height)
+{
+  g_return_if_fail (sync != NULL);
+  g_return_if_fail (funcs != NULL);
+
+  sync->funcs = funcs;
+  sync->user_data = user_data;
+  sync->height = height;
+  sync->flags = GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT;
+  sync->map_flags = 0;
+  reset_dirty_area (sync);
+}
+
+/**
+ * gst_vaapi_image_sync_get_flags:
+ * @sync: a #GstVaapiImageSync
+ *
+ * Return value: the current set of #GstVaapiImageSyncFlags
+ */
+guint
+gst_vaapi_image_sync_get_flags (GstVaapiImageSync * sync)
+{
+  g_return_val_if_fail (sync != NULL, 0);
+
+  return sync->flags;
+}
+
+/**
+ * gst_vaapi_image_sync_reset:
+ * @sync: a #GstVaapiImageSync
+ *
+ * Marks the video frame contents as undefined, e.g. because the
+ * surface was recycled. The next mapping for writing only won't
+ * download the surface.
+ */
+void
+gst_vaapi_image_sync_reset (GstVaapiImageSync * sync)
+{
+  g_return_if_fail (sync != NULL);
+
+  sync->flags = 0;
+  sync->map_flags = 0;
+  reset_dirty_area (sync);
+}
+
+/**
+ * gst_vaapi_image_sync_invalidate_image:
+ * @sync: a #GstVaapiImageSync
+ *
+ * Marks the image contents as stale, e.g. because the image was
+ * released. Pending changes are not uploaded to the surface.
+ */
+void
+gst_vaapi_image_sync_invalidate_image (GstVaapiImageSync * sync)
+{
+  g_return_if_fail (sync != NULL);
+
+  sync->flags &= ~GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT;
+}
+
+/**
+ * gst_vaapi_image_sync_map:
+ * @sync: a #GstVaapiImageSync
+ * @flags: the #GstMapFlags of the new mapping
+ *
+ * Makes the image ready for a mapping with @flags. The surface is
+ * downloaded into the image if the image is not current, and unless
+ * the mapping is for writing only and the surface contents are
+ * undefined.
+ *
+ * A mapping made while the image is already mapped, e.g. of another
+ * plane, only adds its @flags to the current mapping. Nothing is
+ * downloaded then, as this would overwrite the pixels written so far.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_image_sync_map (GstVaapiImageSync * sync, GstMapFlags flags)
+{
+  gboolean need_image;
+
+  g_return_val_if_fail (sync != NULL, FALSE);
+
+  if (sync->map_flags) {
+    sync->map_flags |= flags & GST_MAP_READWRITE;
+    return TRUE;
+  }
+
+  if (sync->flags & GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT)
+    need_image = FALSE;
+  else if (flags & GST_MAP_READ)
+    need_image = TRUE;
+  else if (flags & GST_MAP_WRITE)
+    need_image = (sync->flags & GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT) != 0;
+  else
+    need_image = FALSE;
+
+  if (need_image) {
+    GST_LOG ("download image");
+    if (!sync->funcs->get_image (sync->user_data))
+      return FALSE;
+    sync->flags |= GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT;
+  }
+  sync->map_flags |= flags & GST_MAP_READWRITE;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_image_sync_mark_dirty:
+ * @sync: a #GstVaapiImageSync
+ * @planes: the mask of modified plane indices
+ * @y: the first modified row
+ * @height: the number of modified rows, or 0 if unknown
+ *
+ * Records that the rows [@y, @y + @height) of @planes were modified
+ * through the current mapping. Only those rows are uploaded when the
+ * mapping is released. If no row was recorded, the whole image is
+ * uploaded.
+ */
+void
+gst_vaapi_image_sync_mark_dirty (GstVaapiImageSync * sync, guint planes,
+    guint y, guint height)
+{
+  guint y_end;
+
+  g_return_if_fail (sync != NULL);
+  g_return_if_fail (sync->map_flags & GST_MAP_WRITE);
+
+  sync->dirty_planes |= planes;
+
+  if (y >= sync->height || !height)
+    return;
+  y_end = y + MIN (height, sync->height - y);
+
+  if (sync->dirty_height) {
+    y_end = MAX (y_end, sync->dirty_y + sync->dirty_height);
+    y = MIN (y, sync->dirty_y);
+  }
+  sync->dirty_y = y;
+  sync->dirty_height = y_end - y;
+}
+
+/**
+ * gst_vaapi_image_sync_unmap:
+ * @sync: a #GstVaapiImageSync
+ *
+ * Releases the mapping. If the image was mapped for writing, the
+ * modified rows are uploaded to the surface.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_image_sync_unmap (GstVaapiImageSync * sync)
+{
+  guint planes, y, height;
+
+  g_return_val_if_fail (sync != NULL, FALSE);
+
+  if (!(sync->map_flags & GST_MAP_WRITE)) {
+    sync->map_flags = 0;
+    return TRUE;
+  }
+
+  planes = sync->dirty_planes ? sync->dirty_planes :
+      GST_VAAPI_IMAGE_SYNC_ALL_PLANES;
+  if (sync->dirty_height) {
+    y = sync->dirty_y;
+    height = sync->dirty_height;
+  } else {
+    y = 0;
+    height = sync->height;
+  }
+  sync->map_flags = 0;
+  reset_dirty_area (sync);
+
+  /* The image now holds the latest pixels, whatever the upload result */
+  sync->flags = GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT;
+
+  GST_LOG ("upload rows %u-%u of planes 0x%x", y, y + height, planes);
+  if (!sync->funcs->put_image (sync->user_data, planes, y, height))
+    return FALSE;
+  sync->flags |= GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_image_sync_ensure_surface:
+ * @sync: a #GstVaapiImageSync
+ *
+ * Makes sure the surface holds the current video frame contents,
+ * i.e. uploads the whole image if the surface is not current.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_image_sync_ensure_surface (GstVaapiImageSync * sync)
+{
+  g_return_val_if_fail (sync != NULL, FALSE);
+
+  if (sync->flags & GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT)
+    return TRUE;
+
+  if (sync->flags & GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT) {
+    GST_LOG ("upload image");
+    if (!sync->funcs->put_image (sync->user_data,
+            GST_VAAPI_IMAGE_SYNC_ALL_PLANES, 0, sync->height))
+      return FALSE;
+  }
+  sync->flags |= GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT;
+  return TRUE;
+}
@@ -0,0 +1,113 @@
+/*
+ *  gstvaapiimagesync.h - Synchronization of VA images with surfaces
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_IMAGE_SYNC_H
+#define GST_VAAPI_IMAGE_SYNC_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiImageSync GstVaapiImageSync;
+typedef struct _GstVaapiImageSyncFuncs GstVaapiImageSyncFuncs;
+
+/**
+ * GstVaapiImageSyncFlags:
+ * @GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT: the surface has the
+ *   up-to-date video frame contents
+ * @GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT: the image has the up-to-date
+ *   video frame contents
+ *
+ * The synchronization state of an image/surface pair. If neither flag
+ * is set, the video frame contents are undefined.
+ */
+typedef enum
+{
+  GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT = 1 << 0,
+  GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT = 1 << 1,
+} GstVaapiImageSyncFlags;
+
+/**
+ * GstVaapiImageSyncFuncs:
+ * @get_image: downloads the whole surface into the image
+ * @put_image: uploads the @height rows starting at @y of the image
+ *   @planes, a mask of plane indices, into the surface
+ *
+ * The operations used to transfer pixels between the image and the
+ * surface.
+ */
+struct _GstVaapiImageSyncFuncs
+{
+  gboolean (*get_image) (gpointer user_data);
+  gboolean (*put_image) (gpointer user_data, guint planes, guint y,
+      guint height);
+};
+
+/**
+ * GstVaapiImageSync:
+ *
+ * Tracks which of a surface or of its image copy holds the current
+ * video frame contents, and which parts of the image were written to.
+ */
+struct _GstVaapiImageSync
+{
+  /*< private >*/
+  const GstVaapiImageSyncFuncs *funcs;
+  gpointer user_data;
+  guint height;
+  guint flags;
+  GstMapFlags map_flags;
+  guint dirty_planes;
+  guint dirty_y;
+  guint dirty_height;
+};
+
+#define GST_VAAPI_IMAGE_SYNC_ALL_PLANES (~0U)
+
+void
+gst_vaapi_image_sync_init (GstVaapiImageSync * sync,
+    const GstVaapiImageSyncFuncs * funcs, gpointer user_data, guint height);
+
+guint
+gst_vaapi_image_sync_get_flags (GstVaapiImageSync * sync);
+
+void
+gst_vaapi_image_sync_reset (GstVaapiImageSync * sync);
+
+void
+gst_vaapi_image_sync_invalidate_image (GstVaapiImageSync * sync);
+
+gboolean
+gst_vaapi_image_sync_map (GstVaapiImageSync * sync, GstMapFlags flags);
+
+void
+gst_vaapi_image_sync_mark_dirty (GstVaapiImageSync * sync, guint planes,
+    guint y, guint height);
+
+gboolean
+gst_vaapi_image_sync_unmap (GstVaapiImageSync * sync);
+
+gboolean
+gst_vaapi_image_sync_ensure_surface (GstVaapiImageSync * sync);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_IMAGE_SYNC_H */
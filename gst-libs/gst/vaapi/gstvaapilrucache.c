@@ -0,0 +1,274 @@
+/*
+ *  gstvaapilrucache.c - Bounded cache with least recently used eviction
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapilrucache
+ * @short_description: Bounded cache with least recently used eviction
+ *
+ * A #GstVaapiLruCache maps keys to values, as a #GHashTable does, but
+ * holds at most a fixed number of entries. Once full, inserting a new
+ * entry evicts the one that was least recently looked up or inserted,
+ * so that the working set, e.g. the surfaces of an upstream pool,
+ * stays cached while stale entries are released one at a time.
+ *
+ * A #GstVaapiLruCache is not thread safe.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapilrucache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct _GstVaapiLruCacheEntry GstVaapiLruCacheEntry;
+struct _GstVaapiLruCacheEntry
+{
+  gpointer key;
+  gpointer value;
+};
+
+struct _GstVaapiLruCache
+{
+  guint capacity;
+  GHashTable *entries;          /* key -> GList link of the queue */
+  GQueue queue;                 /* most recently used entries first */
+  GDestroyNotify key_destroy_func;
+  GDestroyNotify value_destroy_func;
+  guint64 num_hits;
+  guint64 num_misses;
+  guint64 num_evictions;
+};
+
+static void
+entry_free (GstVaapiLruCache * cache, GstVaapiLruCacheEntry * entry)
+{
+  if (cache->key_destroy_func)
+    cache->key_destroy_func (entry->key);
+  if (cache->value_destroy_func)
+    cache->value_destroy_func (entry->value);
+  g_slice_free (GstVaapiLruCacheEntry, entry);
+}
+
+static void
+remove_link (GstVaapiLruCache * cache, GList * link)
+{
+  GstVaapiLruCacheEntry *const entry = link->data;
+
+  g_hash_table_remove (cache->entries, entry->key);
+  g_queue_delete_link (&cache->queue, link);
+  entry_free (cache, entry);
+}
+
+/**
+ * gst_vaapi_lru_cache_new:
+ * @capacity: the maximum number of entries
+ * @hash_func: a function to create a hash value from a key
+ * @key_equal_func: a function to check two keys for equality
+ * @key_destroy_func: (allow-none): a function to free the keys
+ * @value_destroy_func: (allow-none): a function to free the values
+ *
+ * Creates a new, empty, #GstVaapiLruCache holding at most @capacity
+ * entries.
+ *
+ * Return value: the newly allocated #GstVaapiLruCache
+ */
+GstVaapiLruCache *
+gst_vaapi_lru_cache_new (guint capacity, GHashFunc hash_func,
+    GEqualFunc key_equal_func, GDestroyNotify key_destroy_func,
+    GDestroyNotify value_destroy_func)
+{
+  GstVaapiLruCache *cache;
+
+  g_return_val_if_fail (capacity > 0, NULL);
+
+  cache = g_slice_new (GstVaapiLruCache);
+  cache->capacity = capacity;
+  cache->entries = g_hash_table_new (hash_func, key_equal_func);
+  g_queue_init (&cache->queue);
+  cache->key_destroy_func = key_destroy_func;
+  cache->value_destroy_func = value_destroy_func;
+  cache->num_hits = 0;
+  cache->num_misses = 0;
+  cache->num_evictions = 0;
+  return cache;
+}
+
+/**
+ * gst_vaapi_lru_cache_free:
+ * @cache: a #GstVaapiLruCache
+ *
+ * Destroys @cache, releasing all its entries.
+ */
+void
+gst_vaapi_lru_cache_free (GstVaapiLruCache * cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  gst_vaapi_lru_cache_clear (cache);
+  g_hash_table_unref (cache->entries);
+  g_slice_free (GstVaapiLruCache, cache);
+}
+
+/**
+ * gst_vaapi_lru_cache_lookup:
+ * @cache: a #GstVaapiLruCache
+ * @key: the key to look up
+ *
+ * Looks up @key in @cache, and marks the entry as the most recently
+ * used one if found.
+ *
+ * Return value: (transfer none): the value associated to @key, or
+ *   %NULL if there is none
+ */
+gpointer
+gst_vaapi_lru_cache_lookup (GstVaapiLruCache * cache, gconstpointer key)
+{
+  GList *link;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  link = g_hash_table_lookup (cache->entries, key);
+  if (!link) {
+    cache->num_misses++;
+    return NULL;
+  }
+  cache->num_hits++;
+
+  if (link != cache->queue.head) {
+    g_queue_unlink (&cache->queue, link);
+    g_queue_push_head_link (&cache->queue, link);
+  }
+  return ((GstVaapiLruCacheEntry *) link->data)->value;
+}
+
+/**
+ * gst_vaapi_lru_cache_insert:
+ * @cache: a #GstVaapiLruCache
+ * @key: (transfer full): the key
+ * @value: (transfer full): the value to associate to @key
+ *
+ * Inserts @value into @cache as the most recently used entry. Any
+ * previous entry for @key is released first. If @cache is full, the
+ * least recently used entry is released to make room.
+ */
+void
+gst_vaapi_lru_cache_insert (GstVaapiLruCache * cache, gpointer key,
+    gpointer value)
+{
+  GstVaapiLruCacheEntry *entry;
+
+  g_return_if_fail (cache != NULL);
+
+  gst_vaapi_lru_cache_remove (cache, key);
+
+  if (cache->queue.length >= cache->capacity) {
+    remove_link (cache, cache->queue.tail);
+    cache->num_evictions++;
+  }
+
+  entry = g_slice_new (GstVaapiLruCacheEntry);
+  entry->key = key;
+  entry->value = value;
+  g_queue_push_head (&cache->queue, entry);
+  g_hash_table_insert (cache->entries, key, cache->queue.head);
+}
+
+/**
+ * gst_vaapi_lru_cache_remove:
+ * @cache: a #GstVaapiLruCache
+ * @key: the key to remove
+ *
+ * Releases the entry for @key, if any.
+ *
+ * Return value: %TRUE if an entry was found and released
+ */
+gboolean
+gst_vaapi_lru_cache_remove (GstVaapiLruCache * cache, gconstpointer key)
+{
+  GList *link;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+
+  link = g_hash_table_lookup (cache->entries, key);
+  if (!link)
+    return FALSE;
+  remove_link (cache, link);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_lru_cache_clear:
+ * @cache: a #GstVaapiLruCache
+ *
+ * Releases all the entries of @cache. Statistics are preserved.
+ */
+void
+gst_vaapi_lru_cache_clear (GstVaapiLruCache * cache)
+{
+  GstVaapiLruCacheEntry *entry;
+
+  g_return_if_fail (cache != NULL);
+
+  g_hash_table_remove_all (cache->entries);
+  while ((entry = g_queue_pop_head (&cache->queue)) != NULL)
+    entry_free (cache, entry);
+}
+
+/**
+ * gst_vaapi_lru_cache_get_size:
+ * @cache: a #GstVaapiLruCache
+ *
+ * Return value: the number of entries held in @cache
+ */
+guint
+gst_vaapi_lru_cache_get_size (GstVaapiLruCache * cache)
+{
+  g_return_val_if_fail (cache != NULL, 0);
+
+  return cache->queue.length;
+}
+
+/**
+ * gst_vaapi_lru_cache_get_stats:
+ * @cache: a #GstVaapiLruCache
+ * @num_hits_ptr: (out) (allow-none): return location for the number of
+ *   lookups that found an entry
+ * @num_misses_ptr: (out) (allow-none): return location for the number
+ *   of lookups that found no entry
+ * @num_evictions_ptr: (out) (allow-none): return location for the
+ *   number of entries released to make room for new ones
+ *
+ * Retrieves the @cache statistics.
+ */
+void
+gst_vaapi_lru_cache_get_stats (GstVaapiLruCache * cache,
+    guint64 * num_hits_ptr, guint64 * num_misses_ptr,
+    guint64 * num_evictions_ptr)
+{
+  g_return_if_fail (cache != NULL);
+
+  if (num_hits_ptr)
+    *num_hits_ptr = cache->num_hits;
+  if (num_misses_ptr)
+    *num_misses_ptr = cache->num_misses;
+  if (num_evictions_ptr)
+    *num_evictions_ptr = cache->num_evictions;
+}
@@ -0,0 +1,62 @@
+/*
+ *  gstvaapilrucache.h - Bounded cache with least recently used eviction
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_LRU_CACHE_H
+#define GST_VAAPI_LRU_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiLruCache GstVaapiLruCache;
+
+GstVaapiLruCache *
+gst_vaapi_lru_cache_new (guint capacity, GHashFunc hash_func,
+    GEqualFunc key_equal_func, GDestroyNotify key_destroy_func,
+    GDestroyNotify value_destroy_func);
+
+void
+gst_vaapi_lru_cache_free (GstVaapiLruCache * cache);
+
+gpointer
+gst_vaapi_lru_cache_lookup (GstVaapiLruCache * cache, gconstpointer key);
+
+void
+gst_vaapi_lru_cache_insert (GstVaapiLruCache * cache, gpointer key,
+    gpointer value);
+
+gboolean
+gst_vaapi_lru_cache_remove (GstVaapiLruCache * cache, gconstpointer key);
+
+void
+gst_vaapi_lru_cache_clear (GstVaapiLruCache * cache);
+
+guint
+gst_vaapi_lru_cache_get_size (GstVaapiLruCache * cache);
+
+void
+gst_vaapi_lru_cache_get_stats (GstVaapiLruCache * cache,
+    guint64 * num_hits_ptr, guint64 * num_misses_ptr,
+    guint64 * num_evictions_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_LRU_CACHE_H */
@@ -0,0 +1,289 @@
+/*
+ *  gstvaapiparallelqueue.c - Queue of pictures encoded in parallel
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiparallelqueue
+ * @short_description: Queue of pictures encoded in parallel
+ *
+ * A #GstVaapiParallelQueue dispatches independent pictures over
+ * several lanes, e.g. one lane per VA context, and hands them back in
+ * submission order. Lanes may complete their pictures in any order
+ * and with different latencies, so the consumer always waits for the
+ * oldest submitted item, which is the next one in presentation order
+ * for intra-only streams.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiparallelqueue.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct
+{
+  gpointer item;
+  guint lane;
+} QueueEntry;
+
+struct _GstVaapiParallelQueue
+{
+  GMutex mutex;
+  GCond item_pushed;
+  GQueue entries;
+  GDestroyNotify destroy_func;
+  guint *lane_depths;
+  guint num_lanes;
+  guint last_lane;
+};
+
+static void
+queue_entry_free (QueueEntry * entry, GstVaapiParallelQueue * queue)
+{
+  if (queue->destroy_func)
+    queue->destroy_func (entry->item);
+  g_slice_free (QueueEntry, entry);
+}
+
+/**
+ * gst_vaapi_parallel_queue_new:
+ * @num_lanes: the number of lanes pictures are dispatched to
+ * @destroy_func: function used to release items left in the queue
+ *
+ * Creates a new #GstVaapiParallelQueue with @num_lanes lanes.
+ *
+ * Return value: the newly allocated #GstVaapiParallelQueue
+ */
+GstVaapiParallelQueue *
+gst_vaapi_parallel_queue_new (guint num_lanes, GDestroyNotify destroy_func)
+{
+  GstVaapiParallelQueue *queue;
+
+  g_return_val_if_fail (num_lanes > 0, NULL);
+
+  queue = g_slice_new0 (GstVaapiParallelQueue);
+  if (!queue)
+    return NULL;
+
+  g_mutex_init (&queue->mutex);
+  g_cond_init (&queue->item_pushed);
+  g_queue_init (&queue->entries);
+  queue->destroy_func = destroy_func;
+  queue->lane_depths = g_new0 (guint, num_lanes);
+  queue->num_lanes = num_lanes;
+  queue->last_lane = num_lanes - 1;
+  return queue;
+}
+
+/**
+ * gst_vaapi_parallel_queue_free:
+ * @queue: a #GstVaapiParallelQueue
+ *
+ * Releases any item left in the @queue and destroys it.
+ */
+void
+gst_vaapi_parallel_queue_free (GstVaapiParallelQueue * queue)
+{
+  if (!queue)
+    return;
+
+  g_queue_foreach (&queue->entries, (GFunc) queue_entry_free, queue);
+  g_queue_clear (&queue->entries);
+  g_free (queue->lane_depths);
+  g_cond_clear (&queue->item_pushed);
+  g_mutex_clear (&queue->mutex);
+  g_slice_free (GstVaapiParallelQueue, queue);
+}
+
+/**
+ * gst_vaapi_parallel_queue_get_num_lanes:
+ * @queue: a #GstVaapiParallelQueue
+ *
+ * Return value: the number of lanes of the @queue
+ */
+guint
+gst_vaapi_parallel_queue_get_num_lanes (GstVaapiParallelQueue * queue)
+{
+  g_return_val_if_fail (queue != NULL, 0);
+
+  return queue->num_lanes;
+}
+
+/**
+ * gst_vaapi_parallel_queue_set_num_lanes:
+ * @queue: a #GstVaapiParallelQueue
+ * @num_lanes: the new number of lanes
+ *
+ * Changes the number of lanes pictures are dispatched to. This is only
+ * possible while the @queue is empty.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_parallel_queue_set_num_lanes (GstVaapiParallelQueue * queue,
+    guint num_lanes)
+{
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (queue != NULL, FALSE);
+  g_return_val_if_fail (num_lanes > 0, FALSE);
+
+  g_mutex_lock (&queue->mutex);
+  if (queue->num_lanes == num_lanes)
+    success = TRUE;
+  else if (g_queue_is_empty (&queue->entries)) {
+    g_free (queue->lane_depths);
+    queue->lane_depths = g_new0 (guint, num_lanes);
+    queue->num_lanes = num_lanes;
+    queue->last_lane = num_lanes - 1;
+    success = TRUE;
+  }
+  g_mutex_unlock (&queue->mutex);
+  return success;
+}
+
+/**
+ * gst_vaapi_parallel_queue_get_lane_depth:
+ * @queue: a #GstVaapiParallelQueue
+ * @lane: the lane index
+ *
+ * Return value: the number of items submitted to @lane and not popped
+ *   out of the @queue yet
+ */
+guint
+gst_vaapi_parallel_queue_get_lane_depth (GstVaapiParallelQueue * queue,
+    guint lane)
+{
+  guint depth;
+
+  g_return_val_if_fail (queue != NULL, 0);
+  g_return_val_if_fail (lane < queue->num_lanes, 0);
+
+  g_mutex_lock (&queue->mutex);
+  depth = queue->lane_depths[lane];
+  g_mutex_unlock (&queue->mutex);
+  return depth;
+}
+
+/**
+ * gst_vaapi_parallel_queue_next_lane:
+ * @queue: a #GstVaapiParallelQueue
+ *
+ * Determines the lane the next item shall be submitted to, i.e. the
+ * least busy one. Lanes with the same number of pending items are
+ * selected in a round-robin fashion.
+ *
+ * Return value: the lane index
+ */
+guint
+gst_vaapi_parallel_queue_next_lane (GstVaapiParallelQueue * queue)
+{
+  guint i, lane, best_lane;
+
+  g_return_val_if_fail (queue != NULL, 0);
+
+  g_mutex_lock (&queue->mutex);
+  best_lane = (queue->last_lane + 1) % queue->num_lanes;
+  for (i = 1; i < queue->num_lanes; i++) {
+    lane = (queue->last_lane + 1 + i) % queue->num_lanes;
+    if (queue->lane_depths[lane] < queue->lane_depths[best_lane])
+      best_lane = lane;
+  }
+  queue->last_lane = best_lane;
+  g_mutex_unlock (&queue->mutex);
+  return best_lane;
+}
+
+/**
+ * gst_vaapi_parallel_queue_push:
+ * @queue: a #GstVaapiParallelQueue
+ * @lane: the lane @item was submitted to
+ * @item: the item to queue
+ *
+ * Appends @item to the @queue. Ownership of @item is transferred to
+ * the @queue.
+ */
+void
+gst_vaapi_parallel_queue_push (GstVaapiParallelQueue * queue, guint lane,
+    gpointer item)
+{
+  QueueEntry *entry;
+
+  g_return_if_fail (queue != NULL);
+  g_return_if_fail (lane < queue->num_lanes);
+  g_return_if_fail (item != NULL);
+
+  entry = g_slice_new (QueueEntry);
+  entry->item = item;
+  entry->lane = lane;
+
+  g_mutex_lock (&queue->mutex);
+  g_queue_push_tail (&queue->entries, entry);
+  queue->lane_depths[lane]++;
+  g_cond_signal (&queue->item_pushed);
+  g_mutex_unlock (&queue->mutex);
+}
+
+/**
+ * gst_vaapi_parallel_queue_pop:
+ * @queue: a #GstVaapiParallelQueue
+ * @timeout: the number of microseconds to wait for an item, at most
+ * @out_lane_ptr: return location for the lane the item was submitted
+ *   to, or %NULL
+ *
+ * Pops the oldest item out of the @queue, whatever the lane it was
+ * submitted to. The caller is responsible for waiting for the lane to
+ * complete that item, and owns it.
+ *
+ * Return value: the oldest item, or %NULL if none was submitted
+ *   within @timeout
+ */
+gpointer
+gst_vaapi_parallel_queue_pop (GstVaapiParallelQueue * queue, guint64 timeout,
+    guint * out_lane_ptr)
+{
+  QueueEntry *entry;
+  gpointer item;
+  gint64 end_time;
+
+  g_return_val_if_fail (queue != NULL, NULL);
+
+  end_time = g_get_monotonic_time () + timeout;
+
+  g_mutex_lock (&queue->mutex);
+  while (g_queue_is_empty (&queue->entries)) {
+    if (!g_cond_wait_until (&queue->item_pushed, &queue->mutex, end_time))
+      break;
+  }
+  entry = g_queue_pop_head (&queue->entries);
+  if (entry)
+    queue->lane_depths[entry->lane]--;
+  g_mutex_unlock (&queue->mutex);
+  if (!entry)
+    return NULL;
+
+  GST_LOG ("pop item %p from lane %u", entry->item, entry->lane);
+
+  if (out_lane_ptr)
+    *out_lane_ptr = entry->lane;
+  item = entry->item;
+  g_slice_free (QueueEntry, entry);
+  return item;
+}
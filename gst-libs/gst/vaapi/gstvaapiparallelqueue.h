@@ -0,0 +1,69 @@
+/*
+ *  gstvaapiparallelqueue.h - Queue of pictures encoded in parallel
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_PARALLEL_QUEUE_H
+#define GST_VAAPI_PARALLEL_QUEUE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiParallelQueue GstVaapiParallelQueue;
+
+G_GNUC_INTERNAL
+GstVaapiParallelQueue *
+gst_vaapi_parallel_queue_new (guint num_lanes, GDestroyNotify destroy_func);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_parallel_queue_free (GstVaapiParallelQueue * queue);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_parallel_queue_get_num_lanes (GstVaapiParallelQueue * queue);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_parallel_queue_set_num_lanes (GstVaapiParallelQueue * queue,
+    guint num_lanes);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_parallel_queue_get_lane_depth (GstVaapiParallelQueue * queue,
+    guint lane);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_parallel_queue_next_lane (GstVaapiParallelQueue * queue);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_parallel_queue_push (GstVaapiParallelQueue * queue, guint lane,
+    gpointer item);
+
+G_GNUC_INTERNAL
+gpointer
+gst_vaapi_parallel_queue_pop (GstVaapiParallelQueue * queue, guint64 timeout,
+    guint * out_lane_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_PARALLEL_QUEUE_H */
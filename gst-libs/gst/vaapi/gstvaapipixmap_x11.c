@@ -32,6 +32,7 @@
 #include "gstvaapidisplay_x11.h"
 #include "gstvaapidisplay_x11_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiutils_x11.h"
 #include "gstvaapisurface_priv.h"
 
@@ -129,16 +130,13 @@ gst_vaapi_pixmap_x11_render (GstVaapiPixmap * pixmap, GstVaapiSurface * surface,
     return FALSE;
 
   GST_VAAPI_OBJECT_LOCK_DISPLAY (pixmap);
-  status = vaPutSurface (GST_VAAPI_OBJECT_VADISPLAY (pixmap),
-      surface_id,
-      GST_VAAPI_OBJECT_ID (pixmap),
-      crop_rect->x, crop_rect->y,
-      crop_rect->width, crop_rect->height,
-      0, 0,
-      GST_VAAPI_PIXMAP_WIDTH (pixmap),
-      GST_VAAPI_PIXMAP_HEIGHT (pixmap),
-      NULL, 0, from_GstVaapiSurfaceRenderFlags (flags)
-      );
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_OBJECT_VADISPLAY (pixmap),
+      VA_INVALID_ID, PUT_SURFACE, 0,
+      vaPutSurface (GST_VAAPI_OBJECT_VADISPLAY (pixmap), surface_id,
+          GST_VAAPI_OBJECT_ID (pixmap), crop_rect->x, crop_rect->y,
+          crop_rect->width, crop_rect->height, 0, 0,
+          GST_VAAPI_PIXMAP_WIDTH (pixmap), GST_VAAPI_PIXMAP_HEIGHT (pixmap),
+          NULL, 0, from_GstVaapiSurfaceRenderFlags (flags)));
   GST_VAAPI_OBJECT_UNLOCK_DISPLAY (pixmap);
   if (!vaapi_check_status (status, "vaPutSurface() [pixmap]"))
     return FALSE;
@@ -0,0 +1,406 @@
+/*
+ *  gstvaapiprofiler.c - VA call latency profiler
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapiprofiler
+ * @short_description: VA call latency profiler
+ *
+ * Every libva call of the library goes through GST_VAAPI_PROFILER_CALL().
+ * Once the profiler is turned on, either through the
+ * %GST_VAAPI_PROFILER_ENV environment variable or with
+ * gst_vaapi_profiler_set_enabled(), the number of calls, the total and
+ * maximal latencies, and the amount of data exchanged are recorded for
+ * each entry point. They are kept per #VADisplay, and per #VAContextID
+ * for the calls related to a context, so that the time spent in the
+ * driver can be told apart from the time spent in the elements.
+ *
+ * The statistics of a display are dumped as JSON when it is closed.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiprofiler.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+gint _gst_vaapi_profiler_enabled = 0;
+
+typedef struct
+{
+  GstVaapiProfilerStats stats[GST_VAAPI_PROFILER_ENTRY_COUNT];
+  GHashTable *contexts;
+} DisplayStats;
+
+static GMutex g_profiler_lock;
+static GHashTable *g_profiler_displays;
+static gchar *g_profiler_filename;
+
+static const gchar *entry_names[GST_VAAPI_PROFILER_ENTRY_COUNT] = {
+  [GST_VAAPI_PROFILER_ENTRY_INITIALIZE] = "vaInitialize",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_CONFIG_PROFILES] = "vaQueryConfigProfiles",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_CONFIG_ENTRYPOINTS] =
+      "vaQueryConfigEntrypoints",
+  [GST_VAAPI_PROFILER_ENTRY_GET_CONFIG_ATTRIBUTES] = "vaGetConfigAttributes",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_DISPLAY_ATTRIBUTES] =
+      "vaQueryDisplayAttributes",
+  [GST_VAAPI_PROFILER_ENTRY_GET_DISPLAY_ATTRIBUTES] = "vaGetDisplayAttributes",
+  [GST_VAAPI_PROFILER_ENTRY_SET_DISPLAY_ATTRIBUTES] = "vaSetDisplayAttributes",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_IMAGE_FORMATS] = "vaQueryImageFormats",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_SUBPICTURE_FORMATS] =
+      "vaQuerySubpictureFormats",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_SURFACE_ATTRIBUTES] =
+      "vaQuerySurfaceAttributes",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_FILTERS] =
+      "vaQueryVideoProcFilters",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_FILTER_CAPS] =
+      "vaQueryVideoProcFilterCaps",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_PIPELINE_CAPS] =
+      "vaQueryVideoProcPipelineCaps",
+  [GST_VAAPI_PROFILER_ENTRY_CREATE_CONFIG] = "vaCreateConfig",
+  [GST_VAAPI_PROFILER_ENTRY_DESTROY_CONFIG] = "vaDestroyConfig",
+  [GST_VAAPI_PROFILER_ENTRY_CREATE_CONTEXT] = "vaCreateContext",
+  [GST_VAAPI_PROFILER_ENTRY_DESTROY_CONTEXT] = "vaDestroyContext",
+  [GST_VAAPI_PROFILER_ENTRY_CREATE_SURFACES] = "vaCreateSurfaces",
+  [GST_VAAPI_PROFILER_ENTRY_DESTROY_SURFACES] = "vaDestroySurfaces",
+  [GST_VAAPI_PROFILER_ENTRY_CREATE_BUFFER] = "vaCreateBuffer",
+  [GST_VAAPI_PROFILER_ENTRY_DESTROY_BUFFER] = "vaDestroyBuffer",
+  [GST_VAAPI_PROFILER_ENTRY_MAP_BUFFER] = "vaMapBuffer",
+  [GST_VAAPI_PROFILER_ENTRY_UNMAP_BUFFER] = "vaUnmapBuffer",
+  [GST_VAAPI_PROFILER_ENTRY_ACQUIRE_BUFFER_HANDLE] = "vaAcquireBufferHandle",
+  [GST_VAAPI_PROFILER_ENTRY_RELEASE_BUFFER_HANDLE] = "vaReleaseBufferHandle",
+  [GST_VAAPI_PROFILER_ENTRY_BEGIN_PICTURE] = "vaBeginPicture",
+  [GST_VAAPI_PROFILER_ENTRY_RENDER_PICTURE] = "vaRenderPicture",
+  [GST_VAAPI_PROFILER_ENTRY_END_PICTURE] = "vaEndPicture",
+  [GST_VAAPI_PROFILER_ENTRY_SYNC_SURFACE] = "vaSyncSurface",
+  [GST_VAAPI_PROFILER_ENTRY_QUERY_SURFACE_STATUS] = "vaQuerySurfaceStatus",
+  [GST_VAAPI_PROFILER_ENTRY_CREATE_IMAGE] = "vaCreateImage",
+  [GST_VAAPI_PROFILER_ENTRY_DESTROY_IMAGE] = "vaDestroyImage",
+  [GST_VAAPI_PROFILER_ENTRY_DERIVE_IMAGE] = "vaDeriveImage",
+  [GST_VAAPI_PROFILER_ENTRY_GET_IMAGE] = "vaGetImage",
+  [GST_VAAPI_PROFILER_ENTRY_PUT_IMAGE] = "vaPutImage",
+  [GST_VAAPI_PROFILER_ENTRY_CREATE_SUBPICTURE] = "vaCreateSubpicture",
+  [GST_VAAPI_PROFILER_ENTRY_DESTROY_SUBPICTURE] = "vaDestroySubpicture",
+  [GST_VAAPI_PROFILER_ENTRY_ASSOCIATE_SUBPICTURE] = "vaAssociateSubpicture",
+  [GST_VAAPI_PROFILER_ENTRY_DEASSOCIATE_SUBPICTURE] =
+      "vaDeassociateSubpicture",
+  [GST_VAAPI_PROFILER_ENTRY_SET_SUBPICTURE_GLOBAL_ALPHA] =
+      "vaSetSubpictureGlobalAlpha",
+  [GST_VAAPI_PROFILER_ENTRY_PUT_SURFACE] = "vaPutSurface",
+  [GST_VAAPI_PROFILER_ENTRY_GET_SURFACE_BUFFER_WL] = "vaGetSurfaceBufferWl",
+};
+
+static void
+display_stats_free (DisplayStats * ds)
+{
+  g_hash_table_unref (ds->contexts);
+  g_slice_free (DisplayStats, ds);
+}
+
+/* Returns the statistics of dpy, which are created if needed */
+static DisplayStats *
+lookup_display_stats (VADisplay dpy, gboolean create)
+{
+  DisplayStats *ds;
+
+  if (!g_profiler_displays) {
+    if (!create)
+      return NULL;
+    g_profiler_displays = g_hash_table_new_full (NULL, NULL, NULL,
+        (GDestroyNotify) display_stats_free);
+  }
+
+  ds = g_hash_table_lookup (g_profiler_displays, dpy);
+  if (!ds && create) {
+    ds = g_slice_new0 (DisplayStats);
+    ds->contexts = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+    g_hash_table_insert (g_profiler_displays, dpy, ds);
+  }
+  return ds;
+}
+
+static void
+stats_add (GstVaapiProfilerStats * stats, GstClockTime latency, guint64 bytes)
+{
+  stats->count++;
+  stats->total += latency;
+  stats->max = MAX (stats->max, latency);
+  stats->bytes += bytes;
+}
+
+/**
+ * gst_vaapi_profiler_entry_get_name:
+ * @entry: a #GstVaapiProfilerEntry
+ *
+ * Returns: the name of the libva function of @entry, or %NULL if it is
+ *   invalid
+ */
+const gchar *
+gst_vaapi_profiler_entry_get_name (GstVaapiProfilerEntry entry)
+{
+  if ((guint) entry >= GST_VAAPI_PROFILER_ENTRY_COUNT)
+    return NULL;
+  return entry_names[entry];
+}
+
+/**
+ * gst_vaapi_profiler_init:
+ *
+ * Turns the profiler on if the %GST_VAAPI_PROFILER_ENV environment
+ * variable is set. This is done once, before the first display is
+ * initialized.
+ */
+void
+gst_vaapi_profiler_init (void)
+{
+  static gsize g_once = 0;
+  const gchar *value;
+
+  if (!g_once_init_enter (&g_once))
+    return;
+
+  value = g_getenv (GST_VAAPI_PROFILER_ENV);
+  if (value && *value && strcmp (value, "0") != 0) {
+    if (strcmp (value, "1") != 0)
+      g_profiler_filename = g_strdup (value);
+    gst_vaapi_profiler_set_enabled (TRUE);
+  }
+  g_once_init_leave (&g_once, 1);
+}
+
+/**
+ * gst_vaapi_profiler_set_enabled:
+ * @enabled: %TRUE to profile the VA calls
+ *
+ * Turns the profiler on or off. The statistics recorded so far are
+ * kept.
+ */
+void
+gst_vaapi_profiler_set_enabled (gboolean enabled)
+{
+  g_atomic_int_set (&_gst_vaapi_profiler_enabled, enabled != FALSE);
+}
+
+/**
+ * gst_vaapi_profiler_record:
+ * @dpy: the #VADisplay of the call
+ * @ctx: the #VAContextID the call is related to, or %VA_INVALID_ID
+ * @entry: the #GstVaapiProfilerEntry that was called
+ * @bytes: the amount of data exchanged by the call, or 0
+ * @start: the time at which the call started, from gst_util_get_timestamp()
+ *
+ * Accounts a call to @entry to the statistics of @dpy, and of @ctx if
+ * valid. This is normally called through GST_VAAPI_PROFILER_CALL().
+ */
+void
+gst_vaapi_profiler_record (VADisplay dpy, VAContextID ctx,
+    GstVaapiProfilerEntry entry, guint64 bytes, GstClockTime start)
+{
+  GstVaapiProfilerStats *ctx_stats;
+  DisplayStats *ds;
+  GstClockTime now, latency;
+
+  g_return_if_fail ((guint) entry < GST_VAAPI_PROFILER_ENTRY_COUNT);
+
+  now = gst_util_get_timestamp ();
+  latency = now > start ? now - start : 0;
+
+  g_mutex_lock (&g_profiler_lock);
+  ds = lookup_display_stats (dpy, TRUE);
+  stats_add (&ds->stats[entry], latency, bytes);
+
+  if (ctx != VA_INVALID_ID) {
+    ctx_stats = g_hash_table_lookup (ds->contexts, GUINT_TO_POINTER (ctx));
+    if (!ctx_stats) {
+      ctx_stats = g_new0 (GstVaapiProfilerStats,
+          GST_VAAPI_PROFILER_ENTRY_COUNT);
+      g_hash_table_insert (ds->contexts, GUINT_TO_POINTER (ctx), ctx_stats);
+    }
+    stats_add (&ctx_stats[entry], latency, bytes);
+  }
+  g_mutex_unlock (&g_profiler_lock);
+}
+
+/**
+ * gst_vaapi_profiler_get_stats:
+ * @dpy: a #VADisplay
+ * @ctx: a #VAContextID, or %VA_INVALID_ID for all the calls of @dpy
+ * @entry: a #GstVaapiProfilerEntry
+ * @stats: return location for the statistics
+ *
+ * Retrieves the statistics of the calls to @entry made on @dpy, or
+ * only those related to @ctx if valid.
+ *
+ * Returns: %TRUE if @entry was called at least once, %FALSE otherwise,
+ *   in which case @stats is cleared
+ */
+gboolean
+gst_vaapi_profiler_get_stats (VADisplay dpy, VAContextID ctx,
+    GstVaapiProfilerEntry entry, GstVaapiProfilerStats * stats)
+{
+  const GstVaapiProfilerStats *entry_stats = NULL;
+  DisplayStats *ds;
+
+  g_return_val_if_fail ((guint) entry < GST_VAAPI_PROFILER_ENTRY_COUNT,
+      FALSE);
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  g_mutex_lock (&g_profiler_lock);
+  ds = lookup_display_stats (dpy, FALSE);
+  if (ds && ctx == VA_INVALID_ID)
+    entry_stats = &ds->stats[entry];
+  else if (ds) {
+    entry_stats = g_hash_table_lookup (ds->contexts, GUINT_TO_POINTER (ctx));
+    if (entry_stats)
+      entry_stats = &entry_stats[entry];
+  }
+
+  if (entry_stats)
+    *stats = *entry_stats;
+  else
+    memset (stats, 0, sizeof (*stats));
+  g_mutex_unlock (&g_profiler_lock);
+
+  return stats->count > 0;
+}
+
+static void
+append_json_stats (GString * str, const GstVaapiProfilerStats * stats)
+{
+  gboolean first = TRUE;
+  guint i;
+
+  g_string_append_c (str, '{');
+  for (i = 0; i < GST_VAAPI_PROFILER_ENTRY_COUNT; i++) {
+    if (stats[i].count == 0)
+      continue;
+    g_string_append_printf (str, "%s\"%s\":{\"count\":%" G_GUINT64_FORMAT
+        ",\"total_ns\":%" G_GUINT64_FORMAT ",\"max_ns\":%" G_GUINT64_FORMAT
+        ",\"bytes\":%" G_GUINT64_FORMAT "}", first ? "" : ",",
+        entry_names[i], stats[i].count, stats[i].total, stats[i].max,
+        stats[i].bytes);
+    first = FALSE;
+  }
+  g_string_append_c (str, '}');
+}
+
+static gint
+compare_context_ids (gconstpointer a, gconstpointer b)
+{
+  const guint ctx_a = GPOINTER_TO_UINT (a);
+  const guint ctx_b = GPOINTER_TO_UINT (b);
+
+  return ctx_a < ctx_b ? -1 : ctx_a > ctx_b;
+}
+
+/* Serializes the statistics of a display, with the lock held */
+static gchar *
+display_stats_to_json (VADisplay dpy, DisplayStats * ds)
+{
+  GString *str;
+  GList *ctx_ids, *l;
+
+  str = g_string_new (NULL);
+  g_string_append_printf (str, "{\"display\":\"%p\",\"entries\":", dpy);
+  append_json_stats (str, ds->stats);
+
+  g_string_append (str, ",\"contexts\":{");
+  ctx_ids = g_list_sort (g_hash_table_get_keys (ds->contexts),
+      compare_context_ids);
+  for (l = ctx_ids; l != NULL; l = l->next) {
+    g_string_append_printf (str, "%s\"%u\":", l != ctx_ids ? "," : "",
+        GPOINTER_TO_UINT (l->data));
+    append_json_stats (str, g_hash_table_lookup (ds->contexts, l->data));
+  }
+  g_list_free (ctx_ids);
+  g_string_append (str, "}}");
+
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * gst_vaapi_profiler_to_json:
+ * @dpy: a #VADisplay
+ *
+ * Serializes the statistics of @dpy as a JSON object, with an "entries"
+ * member holding the statistics of the entry points that were called,
+ * and a "contexts" member holding those of each context.
+ *
+ * Returns: (transfer full): the JSON string, or %NULL if no call was
+ *   recorded for @dpy
+ */
+gchar *
+gst_vaapi_profiler_to_json (VADisplay dpy)
+{
+  DisplayStats *ds;
+  gchar *json = NULL;
+
+  g_mutex_lock (&g_profiler_lock);
+  ds = lookup_display_stats (dpy, FALSE);
+  if (ds)
+    json = display_stats_to_json (dpy, ds);
+  g_mutex_unlock (&g_profiler_lock);
+  return json;
+}
+
+static void
+append_to_file (const gchar * filename, const gchar * json)
+{
+  FILE *fp;
+
+  fp = fopen (filename, "a");
+  if (!fp) {
+    GST_WARNING ("failed to open VA profile file %s", filename);
+    return;
+  }
+  fprintf (fp, "%s\n", json);
+  fclose (fp);
+}
+
+/**
+ * gst_vaapi_profiler_close_display:
+ * @dpy: the #VADisplay that is being terminated
+ *
+ * Dumps the statistics of @dpy, to the debug log and to the file named
+ * by %GST_VAAPI_PROFILER_ENV if any, then releases them. This is called
+ * right before vaTerminate().
+ */
+void
+gst_vaapi_profiler_close_display (VADisplay dpy)
+{
+  DisplayStats *ds;
+  gchar *json = NULL;
+
+  g_mutex_lock (&g_profiler_lock);
+  ds = lookup_display_stats (dpy, FALSE);
+  if (ds) {
+    json = display_stats_to_json (dpy, ds);
+    g_hash_table_remove (g_profiler_displays, dpy);
+  }
+  g_mutex_unlock (&g_profiler_lock);
+
+  if (!json)
+    return;
+
+  GST_INFO ("VA profile: %s", json);
+  if (g_profiler_filename)
+    append_to_file (g_profiler_filename, json);
+  g_free (json);
+}
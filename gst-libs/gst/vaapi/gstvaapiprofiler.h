@@ -0,0 +1,172 @@
+/*
+ *  gstvaapiprofiler.h - VA call latency profiler
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_PROFILER_H
+#define GST_VAAPI_PROFILER_H
+
+#include <gst/gst.h>
+#include <va/va.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GST_VAAPI_PROFILER_ENV:
+ *
+ * The environment variable that turns the profiler on. If it holds a
+ * file name, rather than "1", the statistics of each display are also
+ * appended to that file, as one JSON object per line.
+ */
+#define GST_VAAPI_PROFILER_ENV "GST_VAAPI_VA_PROFILE"
+
+/**
+ * GstVaapiProfilerEntry:
+ *
+ * The profiled libva entry points.
+ */
+typedef enum
+{
+  GST_VAAPI_PROFILER_ENTRY_INITIALIZE = 0,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_CONFIG_PROFILES,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_CONFIG_ENTRYPOINTS,
+  GST_VAAPI_PROFILER_ENTRY_GET_CONFIG_ATTRIBUTES,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_DISPLAY_ATTRIBUTES,
+  GST_VAAPI_PROFILER_ENTRY_GET_DISPLAY_ATTRIBUTES,
+  GST_VAAPI_PROFILER_ENTRY_SET_DISPLAY_ATTRIBUTES,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_IMAGE_FORMATS,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_SUBPICTURE_FORMATS,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_SURFACE_ATTRIBUTES,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_FILTERS,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_FILTER_CAPS,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_PIPELINE_CAPS,
+  GST_VAAPI_PROFILER_ENTRY_CREATE_CONFIG,
+  GST_VAAPI_PROFILER_ENTRY_DESTROY_CONFIG,
+  GST_VAAPI_PROFILER_ENTRY_CREATE_CONTEXT,
+  GST_VAAPI_PROFILER_ENTRY_DESTROY_CONTEXT,
+  GST_VAAPI_PROFILER_ENTRY_CREATE_SURFACES,
+  GST_VAAPI_PROFILER_ENTRY_DESTROY_SURFACES,
+  GST_VAAPI_PROFILER_ENTRY_CREATE_BUFFER,
+  GST_VAAPI_PROFILER_ENTRY_DESTROY_BUFFER,
+  GST_VAAPI_PROFILER_ENTRY_MAP_BUFFER,
+  GST_VAAPI_PROFILER_ENTRY_UNMAP_BUFFER,
+  GST_VAAPI_PROFILER_ENTRY_ACQUIRE_BUFFER_HANDLE,
+  GST_VAAPI_PROFILER_ENTRY_RELEASE_BUFFER_HANDLE,
+  GST_VAAPI_PROFILER_ENTRY_BEGIN_PICTURE,
+  GST_VAAPI_PROFILER_ENTRY_RENDER_PICTURE,
+  GST_VAAPI_PROFILER_ENTRY_END_PICTURE,
+  GST_VAAPI_PROFILER_ENTRY_SYNC_SURFACE,
+  GST_VAAPI_PROFILER_ENTRY_QUERY_SURFACE_STATUS,
+  GST_VAAPI_PROFILER_ENTRY_CREATE_IMAGE,
+  GST_VAAPI_PROFILER_ENTRY_DESTROY_IMAGE,
+  GST_VAAPI_PROFILER_ENTRY_DERIVE_IMAGE,
+  GST_VAAPI_PROFILER_ENTRY_GET_IMAGE,
+  GST_VAAPI_PROFILER_ENTRY_PUT_IMAGE,
+  GST_VAAPI_PROFILER_ENTRY_CREATE_SUBPICTURE,
+  GST_VAAPI_PROFILER_ENTRY_DESTROY_SUBPICTURE,
+  GST_VAAPI_PROFILER_ENTRY_ASSOCIATE_SUBPICTURE,
+  GST_VAAPI_PROFILER_ENTRY_DEASSOCIATE_SUBPICTURE,
+  GST_VAAPI_PROFILER_ENTRY_SET_SUBPICTURE_GLOBAL_ALPHA,
+  GST_VAAPI_PROFILER_ENTRY_PUT_SURFACE,
+  GST_VAAPI_PROFILER_ENTRY_GET_SURFACE_BUFFER_WL,
+
+  GST_VAAPI_PROFILER_ENTRY_COUNT
+} GstVaapiProfilerEntry;
+
+typedef struct _GstVaapiProfilerStats GstVaapiProfilerStats;
+
+/**
+ * GstVaapiProfilerStats:
+ * @count: the number of calls
+ * @total: the cumulated latency of the calls, in nanoseconds
+ * @max: the maximal latency of a call, in nanoseconds
+ * @bytes: the amount of data passed to or returned by the calls, when
+ *   known
+ *
+ * The statistics of a libva entry point.
+ */
+struct _GstVaapiProfilerStats
+{
+  guint64 count;
+  GstClockTime total;
+  GstClockTime max;
+  guint64 bytes;
+};
+
+/* Non-zero when the profiler is on (private) */
+extern gint _gst_vaapi_profiler_enabled;
+
+/**
+ * GST_VAAPI_PROFILER_IS_ENABLED:
+ *
+ * Evaluates to %TRUE if the VA calls are to be profiled.
+ */
+#define GST_VAAPI_PROFILER_IS_ENABLED() \
+  G_UNLIKELY (g_atomic_int_get (&_gst_vaapi_profiler_enabled))
+
+/**
+ * GST_VAAPI_PROFILER_CALL:
+ * @status: the #VAStatus variable to assign
+ * @dpy: the #VADisplay of the call
+ * @ctx: the #VAContextID the call is related to, or %VA_INVALID_ID. It
+ *   is evaluated after the call, so it can be an output of the call
+ * @entry: the #GstVaapiProfilerEntry, without its prefix
+ * @bytes: the amount of data exchanged by the call, or 0
+ * @call: the libva call
+ *
+ * Assigns the result of @call to @status, and accounts its latency to
+ * the statistics of @dpy and @ctx if the profiler is on. Otherwise,
+ * this only costs a test of a global flag.
+ */
+#define GST_VAAPI_PROFILER_CALL(status, dpy, ctx, entry, bytes, call)   \
+  G_STMT_START {                                                        \
+    const GstClockTime _va_start = GST_VAAPI_PROFILER_IS_ENABLED () ?   \
+        gst_util_get_timestamp () : GST_CLOCK_TIME_NONE;                \
+    (status) = (call);                                                  \
+    if (G_UNLIKELY (GST_CLOCK_TIME_IS_VALID (_va_start)))               \
+      gst_vaapi_profiler_record ((dpy), (ctx),                          \
+          GST_VAAPI_PROFILER_ENTRY_##entry, (bytes), _va_start);        \
+  } G_STMT_END
+
+const gchar *
+gst_vaapi_profiler_entry_get_name (GstVaapiProfilerEntry entry);
+
+void
+gst_vaapi_profiler_init (void);
+
+void
+gst_vaapi_profiler_set_enabled (gboolean enabled);
+
+void
+gst_vaapi_profiler_record (VADisplay dpy, VAContextID ctx,
+    GstVaapiProfilerEntry entry, guint64 bytes, GstClockTime start);
+
+gboolean
+gst_vaapi_profiler_get_stats (VADisplay dpy, VAContextID ctx,
+    GstVaapiProfilerEntry entry, GstVaapiProfilerStats * stats);
+
+gchar *
+gst_vaapi_profiler_to_json (VADisplay dpy);
+
+void
+gst_vaapi_profiler_close_display (VADisplay dpy);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_PROFILER_H */
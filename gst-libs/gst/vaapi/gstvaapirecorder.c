@@ -0,0 +1,365 @@
+/*
+ *  gstvaapirecorder.c - VA command stream recorder
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapirecorder
+ * @short_description: VA command stream recorder
+ *
+ * When the %GST_VAAPI_RECORDER_ENV environment variable names a file,
+ * the configs and contexts created through #GstVaapiContext, and the
+ * pictures submitted through #GstVaapiPicture and #GstVaapiEncPicture,
+ * are recorded to that file, with the full contents of their VA
+ * buffers. The trace can then be replayed without the original media
+ * or pipeline, e.g. with the va-replay test program.
+ *
+ * The ids found in the trace are those of the recording driver. Only
+ * one VA display per process is supported.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapirecorder.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+gint _gst_vaapi_recorder_enabled = 0;
+
+typedef struct
+{
+  VABufferType type;
+  guint size;
+  guint num_elements;
+} BufferInfo;
+
+static GMutex g_recorder_lock;
+static FILE *g_recorder_file;
+static GHashTable *g_recorder_buffers;
+
+static inline void
+append_word (GByteArray * record, guint32 value)
+{
+  g_byte_array_append (record, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_data (GByteArray * record, gconstpointer data, guint size)
+{
+  static const guint8 padding[3] = { 0, };
+
+  if (size > 0)
+    g_byte_array_append (record, data, size);
+  if (size % 4)
+    g_byte_array_append (record, padding, 4 - size % 4);
+}
+
+static GByteArray *
+record_new (GstVaapiRecordType type)
+{
+  GByteArray *const record = g_byte_array_new ();
+
+  /* The payload size is filled in by record_write() */
+  append_word (record, type);
+  append_word (record, 0);
+  return record;
+}
+
+static void
+record_write (GByteArray * record)
+{
+  const guint32 size = record->len - 2 * sizeof (guint32);
+
+  memcpy (record->data + sizeof (guint32), &size, sizeof (size));
+
+  g_mutex_lock (&g_recorder_lock);
+  if (g_recorder_file &&
+      fwrite (record->data, record->len, 1, g_recorder_file) != 1)
+    GST_WARNING ("failed to write VA trace record");
+  g_mutex_unlock (&g_recorder_lock);
+
+  g_byte_array_unref (record);
+}
+
+/**
+ * gst_vaapi_recorder_init:
+ *
+ * Starts recording to the file named by the %GST_VAAPI_RECORDER_ENV
+ * environment variable, if set. This is done once, before the first
+ * display is initialized.
+ */
+void
+gst_vaapi_recorder_init (void)
+{
+  static gsize g_once = 0;
+  const gchar *filename;
+
+  if (!g_once_init_enter (&g_once))
+    return;
+
+  filename = g_getenv (GST_VAAPI_RECORDER_ENV);
+  if (filename && *filename)
+    gst_vaapi_recorder_start (filename);
+  g_once_init_leave (&g_once, 1);
+}
+
+/**
+ * gst_vaapi_recorder_start:
+ * @filename: the name of the trace file
+ *
+ * Starts recording the VA command stream to @filename, which is
+ * truncated. Any previous recording is stopped.
+ *
+ * Returns: %TRUE if the file could be created
+ */
+gboolean
+gst_vaapi_recorder_start (const gchar * filename)
+{
+  const guint32 header[2] =
+      { GST_VAAPI_RECORDER_MAGIC, GST_VAAPI_RECORDER_VERSION };
+  FILE *fp;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  gst_vaapi_recorder_stop ();
+
+  fp = fopen (filename, "wb");
+  if (!fp || fwrite (header, sizeof (header), 1, fp) != 1) {
+    GST_ERROR ("failed to create VA trace file %s", filename);
+    if (fp)
+      fclose (fp);
+    return FALSE;
+  }
+
+  g_mutex_lock (&g_recorder_lock);
+  g_recorder_file = fp;
+  g_recorder_buffers = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  g_atomic_int_set (&_gst_vaapi_recorder_enabled, TRUE);
+  g_mutex_unlock (&g_recorder_lock);
+
+  GST_INFO ("recording VA command stream to %s", filename);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_recorder_stop:
+ *
+ * Stops recording, and closes the trace file.
+ */
+void
+gst_vaapi_recorder_stop (void)
+{
+  g_mutex_lock (&g_recorder_lock);
+  g_atomic_int_set (&_gst_vaapi_recorder_enabled, FALSE);
+  if (g_recorder_file) {
+    fclose (g_recorder_file);
+    g_recorder_file = NULL;
+  }
+  if (g_recorder_buffers) {
+    g_hash_table_unref (g_recorder_buffers);
+    g_recorder_buffers = NULL;
+  }
+  g_mutex_unlock (&g_recorder_lock);
+}
+
+void
+gst_vaapi_recorder_create_config (VADisplay dpy, VAConfigID config,
+    VAProfile profile, VAEntrypoint entrypoint, const VAConfigAttrib * attribs,
+    guint num_attribs)
+{
+  GByteArray *record;
+  guint i;
+
+  record = record_new (GST_VAAPI_RECORD_CREATE_CONFIG);
+  append_word (record, config);
+  append_word (record, profile);
+  append_word (record, entrypoint);
+  append_word (record, num_attribs);
+  for (i = 0; i < num_attribs; i++) {
+    append_word (record, attribs[i].type);
+    append_word (record, attribs[i].value);
+  }
+  record_write (record);
+}
+
+void
+gst_vaapi_recorder_create_context (VADisplay dpy, VAContextID context,
+    VAConfigID config, guint width, guint height, gint flag,
+    const VASurfaceID * surfaces, guint num_surfaces)
+{
+  GByteArray *record;
+  guint i;
+
+  record = record_new (GST_VAAPI_RECORD_CREATE_CONTEXT);
+  append_word (record, context);
+  append_word (record, config);
+  append_word (record, width);
+  append_word (record, height);
+  append_word (record, flag);
+  append_word (record, num_surfaces);
+  for (i = 0; i < num_surfaces; i++)
+    append_word (record, surfaces[i]);
+  record_write (record);
+}
+
+void
+gst_vaapi_recorder_destroy_context (VADisplay dpy, VAContextID context)
+{
+  GByteArray *record;
+
+  record = record_new (GST_VAAPI_RECORD_DESTROY_CONTEXT);
+  append_word (record, context);
+  record_write (record);
+
+  /* Make the trace usable up to here, should the process crash */
+  g_mutex_lock (&g_recorder_lock);
+  if (g_recorder_file)
+    fflush (g_recorder_file);
+  g_mutex_unlock (&g_recorder_lock);
+}
+
+/* Remembers the layout of a buffer, to serialize it when rendered.
+   Only the buffers written by the driver are recorded on creation */
+void
+gst_vaapi_recorder_create_buffer (VADisplay dpy, VAContextID context,
+    VABufferID buffer, VABufferType type, guint size, guint num_elements)
+{
+  BufferInfo *info;
+  GByteArray *record;
+
+  info = g_new (BufferInfo, 1);
+  info->type = type;
+  info->size = size;
+  info->num_elements = num_elements;
+
+  g_mutex_lock (&g_recorder_lock);
+  if (g_recorder_buffers)
+    g_hash_table_insert (g_recorder_buffers, GUINT_TO_POINTER (buffer), info);
+  else
+    g_free (info);
+  g_mutex_unlock (&g_recorder_lock);
+
+  if (type != VAEncCodedBufferType)
+    return;
+
+  record = record_new (GST_VAAPI_RECORD_CREATE_BUFFER);
+  append_word (record, context);
+  append_word (record, buffer);
+  append_word (record, type);
+  append_word (record, size);
+  record_write (record);
+}
+
+void
+gst_vaapi_recorder_destroy_buffer (VADisplay dpy, VABufferID buffer)
+{
+  g_mutex_lock (&g_recorder_lock);
+  if (g_recorder_buffers)
+    g_hash_table_remove (g_recorder_buffers, GUINT_TO_POINTER (buffer));
+  g_mutex_unlock (&g_recorder_lock);
+}
+
+void
+gst_vaapi_recorder_begin_picture (VADisplay dpy, VAContextID context,
+    VASurfaceID surface)
+{
+  GByteArray *record;
+
+  record = record_new (GST_VAAPI_RECORD_BEGIN_PICTURE);
+  append_word (record, context);
+  append_word (record, surface);
+  record_write (record);
+}
+
+/* Appends the layout and contents of a buffer, which is mapped again
+   since the caller has already unmapped it */
+static void
+append_buffer (GByteArray * record, VADisplay dpy, VABufferID buffer)
+{
+  BufferInfo info = { 0, };
+  BufferInfo *found = NULL;
+  gpointer data = NULL;
+  VAStatus status;
+  guint size;
+
+  g_mutex_lock (&g_recorder_lock);
+  if (g_recorder_buffers)
+    found = g_hash_table_lookup (g_recorder_buffers, GUINT_TO_POINTER (buffer));
+  if (found)
+    info = *found;
+  g_mutex_unlock (&g_recorder_lock);
+
+  size = info.size * info.num_elements;
+  if (!found)
+    GST_WARNING ("unknown VA buffer 0x%08x, recording it empty", buffer);
+  else if (size > 0) {
+    status = vaMapBuffer (dpy, buffer, &data);
+    if (status != VA_STATUS_SUCCESS) {
+      GST_WARNING ("failed to map VA buffer 0x%08x, recording it empty",
+          buffer);
+      data = NULL;
+    }
+  }
+  if (!data)
+    size = 0;
+
+  append_word (record, buffer);
+  append_word (record, info.type);
+  append_word (record, data ? info.size : 0);
+  append_word (record, data ? info.num_elements : 0);
+  append_data (record, data, size);
+
+  if (data)
+    vaUnmapBuffer (dpy, buffer);
+}
+
+void
+gst_vaapi_recorder_render_picture (VADisplay dpy, VAContextID context,
+    const VABufferID * buffers, guint num_buffers)
+{
+  GByteArray *record;
+  guint i;
+
+  record = record_new (GST_VAAPI_RECORD_RENDER_PICTURE);
+  append_word (record, context);
+  append_word (record, num_buffers);
+  for (i = 0; i < num_buffers; i++)
+    append_buffer (record, dpy, buffers[i]);
+  record_write (record);
+}
+
+void
+gst_vaapi_recorder_end_picture (VADisplay dpy, VAContextID context)
+{
+  GByteArray *record;
+
+  record = record_new (GST_VAAPI_RECORD_END_PICTURE);
+  append_word (record, context);
+  record_write (record);
+}
+
+void
+gst_vaapi_recorder_sync_surface (VADisplay dpy, VASurfaceID surface)
+{
+  GByteArray *record;
+
+  record = record_new (GST_VAAPI_RECORD_SYNC_SURFACE);
+  append_word (record, surface);
+  record_write (record);
+}
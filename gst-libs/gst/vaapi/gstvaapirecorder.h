@@ -0,0 +1,133 @@
+/*
+ *  gstvaapirecorder.h - VA command stream recorder
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_RECORDER_H
+#define GST_VAAPI_RECORDER_H
+
+#include <gst/gst.h>
+#include <va/va.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GST_VAAPI_RECORDER_ENV:
+ *
+ * The environment variable holding the name of the trace file to
+ * record the VA command stream to.
+ */
+#define GST_VAAPI_RECORDER_ENV "GST_VAAPI_RECORD"
+
+/* "GVAT" in a little-endian trace file */
+#define GST_VAAPI_RECORDER_MAGIC 0x54415647
+#define GST_VAAPI_RECORDER_VERSION 1
+
+/**
+ * GstVaapiRecordType:
+ * @GST_VAAPI_RECORD_CREATE_CONFIG: config, profile, entrypoint,
+ *   num_attribs, then num_attribs (type, value) pairs
+ * @GST_VAAPI_RECORD_CREATE_CONTEXT: context, config, width, height,
+ *   flag, num_surfaces, then num_surfaces surface ids
+ * @GST_VAAPI_RECORD_DESTROY_CONTEXT: context
+ * @GST_VAAPI_RECORD_CREATE_BUFFER: context, buffer, type, size, for
+ *   the buffers that are written by the driver, i.e. coded buffers
+ * @GST_VAAPI_RECORD_BEGIN_PICTURE: context, surface
+ * @GST_VAAPI_RECORD_RENDER_PICTURE: context, num_buffers, then for
+ *   each buffer: buffer, type, size, num_elements, and the size *
+ *   num_elements bytes of data padded to 32 bits
+ * @GST_VAAPI_RECORD_END_PICTURE: context
+ * @GST_VAAPI_RECORD_SYNC_SURFACE: surface
+ *
+ * The records of a trace file. The file starts with the
+ * %GST_VAAPI_RECORDER_MAGIC and %GST_VAAPI_RECORDER_VERSION words.
+ * Each record is a type and a payload size in bytes, followed by the
+ * payload. All words are 32-bit, in the byte order of the recording
+ * host. The ids are those of the recording driver.
+ */
+typedef enum
+{
+  GST_VAAPI_RECORD_CREATE_CONFIG = 1,
+  GST_VAAPI_RECORD_CREATE_CONTEXT,
+  GST_VAAPI_RECORD_DESTROY_CONTEXT,
+  GST_VAAPI_RECORD_CREATE_BUFFER,
+  GST_VAAPI_RECORD_BEGIN_PICTURE,
+  GST_VAAPI_RECORD_RENDER_PICTURE,
+  GST_VAAPI_RECORD_END_PICTURE,
+  GST_VAAPI_RECORD_SYNC_SURFACE,
+} GstVaapiRecordType;
+
+/* Non-zero while a trace is being recorded (private) */
+extern gint _gst_vaapi_recorder_enabled;
+
+/**
+ * GST_VAAPI_RECORDER_IS_ENABLED:
+ *
+ * Evaluates to %TRUE if the VA command stream is being recorded. This
+ * is the only cost of the recorder otherwise.
+ */
+#define GST_VAAPI_RECORDER_IS_ENABLED() \
+  G_UNLIKELY (g_atomic_int_get (&_gst_vaapi_recorder_enabled))
+
+void
+gst_vaapi_recorder_init (void);
+
+gboolean
+gst_vaapi_recorder_start (const gchar * filename);
+
+void
+gst_vaapi_recorder_stop (void);
+
+void
+gst_vaapi_recorder_create_config (VADisplay dpy, VAConfigID config,
+    VAProfile profile, VAEntrypoint entrypoint, const VAConfigAttrib * attribs,
+    guint num_attribs);
+
+void
+gst_vaapi_recorder_create_context (VADisplay dpy, VAContextID context,
+    VAConfigID config, guint width, guint height, gint flag,
+    const VASurfaceID * surfaces, guint num_surfaces);
+
+void
+gst_vaapi_recorder_destroy_context (VADisplay dpy, VAContextID context);
+
+void
+gst_vaapi_recorder_create_buffer (VADisplay dpy, VAContextID context,
+    VABufferID buffer, VABufferType type, guint size, guint num_elements);
+
+void
+gst_vaapi_recorder_destroy_buffer (VADisplay dpy, VABufferID buffer);
+
+void
+gst_vaapi_recorder_begin_picture (VADisplay dpy, VAContextID context,
+    VASurfaceID surface);
+
+void
+gst_vaapi_recorder_render_picture (VADisplay dpy, VAContextID context,
+    const VABufferID * buffers, guint num_buffers);
+
+void
+gst_vaapi_recorder_end_picture (VADisplay dpy, VAContextID context);
+
+void
+gst_vaapi_recorder_sync_surface (VADisplay dpy, VASurfaceID surface);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_RECORDER_H */
@@ -31,6 +31,7 @@
 #include <string.h>
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapisubpicture.h"
 #include "gstvaapiobject_priv.h"
 #include "gstvaapiimage_priv.h"
@@ -79,10 +80,12 @@ gst_vaapi_subpicture_destroy (GstVaapiSubpicture * subpicture)
 
   if (subpicture_id != VA_INVALID_ID) {
     if (display) {
-      GST_VAAPI_DISPLAY_LOCK (display);
-      status = vaDestroySubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
-          subpicture_id);
-      GST_VAAPI_DISPLAY_UNLOCK (display);
+      GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+      GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+          VA_INVALID_ID, DESTROY_SUBPICTURE, 0,
+          vaDestroySubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
+              subpicture_id));
+      GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
       if (!vaapi_check_status (status, "vaDestroySubpicture()"))
         g_warning ("failed to destroy subpicture %" GST_VAAPI_ID_FORMAT,
             GST_VAAPI_ID_ARGS (subpicture_id));
@@ -100,10 +103,12 @@ gst_vaapi_subpicture_create (GstVaapiSubpicture * subpicture,
   VASubpictureID subpicture_id;
   VAStatus status;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (image), &subpicture_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, CREATE_SUBPICTURE, 0,
+      vaCreateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (image), &subpicture_id));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaCreateSubpicture()"))
     return FALSE;
 
@@ -366,10 +371,12 @@ gst_vaapi_subpicture_set_global_alpha (GstVaapiSubpicture * subpicture,
 
   display = GST_VAAPI_OBJECT_DISPLAY (subpicture);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaSetSubpictureGlobalAlpha (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (subpicture), global_alpha);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, SET_SUBPICTURE_GLOBAL_ALPHA, 0,
+      vaSetSubpictureGlobalAlpha (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (subpicture), global_alpha));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaSetSubpictureGlobalAlpha()"))
     return FALSE;
 
@@ -37,6 +37,9 @@
 #include "gstvaapiimage_priv.h"
 #include "gstvaapicontext_overlay.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapitiming.h"
+#include "gstvaapiprofiler.h"
+#include "gstvaapirecorder.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -80,16 +83,30 @@ gst_vaapi_surface_destroy (GstVaapiSurface * surface)
   gst_vaapi_surface_destroy_subpictures (surface);
   gst_vaapi_surface_set_parent_context (surface, NULL);
 
+  /* Hand the VA surface over to the display for reuse by the next
+     surface pool that needs identical surfaces */
+  if (surface_id != VA_INVALID_SURFACE && surface->recycle_size > 0 &&
+      !surface->extbuf_proxy) {
+    GstVaapiSurfaceRecycler *const recycler =
+        gst_vaapi_display_get_surface_recycler (display);
+
+    if (recycler && gst_vaapi_surface_recycler_put (recycler,
+            &surface->recycle_key, surface_id, surface->recycle_size))
+      surface_id = VA_INVALID_SURFACE;
+  }
+
   if (surface_id != VA_INVALID_SURFACE) {
-    GST_VAAPI_DISPLAY_LOCK (display);
-    status = vaDestroySurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
-        &surface_id, 1);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+    GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+        VA_INVALID_ID, DESTROY_SURFACES, 0,
+        vaDestroySurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display), &surface_id,
+            1));
+    GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
     if (!vaapi_check_status (status, "vaDestroySurfaces()"))
       g_warning ("failed to destroy surface %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (surface_id));
-    GST_VAAPI_OBJECT_ID (surface) = VA_INVALID_SURFACE;
   }
+  GST_VAAPI_OBJECT_ID (surface) = VA_INVALID_SURFACE;
   gst_vaapi_buffer_proxy_replace (&surface->extbuf_proxy, NULL);
 }
 
@@ -106,10 +123,12 @@ gst_vaapi_surface_create (GstVaapiSurface * surface,
   if (!va_chroma_format)
     goto error_unsupported_chroma_type;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      width, height, va_chroma_format, 1, &surface_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, CREATE_SURFACES, 0,
+      vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display), width, height,
+          va_chroma_format, 1, &surface_id));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -197,11 +216,13 @@ gst_vaapi_surface_create_full (GstVaapiSurface * surface,
     attrib++;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      va_chroma_format, extbuf.width, extbuf.height, &surface_id, 1,
-      attribs, attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, CREATE_SURFACES, 0,
+      vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display), va_chroma_format,
+          extbuf.width, extbuf.height, &surface_id, 1, attribs,
+          attrib - attribs));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -286,11 +307,12 @@ gst_vaapi_surface_create_from_buffer_proxy (GstVaapiSurface * surface,
       from_GstVaapiBufferMemoryType (GST_VAAPI_BUFFER_PROXY_TYPE (proxy));
   attrib++;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      va_chroma_format, width, height, &surface_id, 1, attribs,
-      attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, CREATE_SURFACES, 0,
+      vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display), va_chroma_format,
+          width, height, &surface_id, 1, attribs, attrib - attribs));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -457,6 +479,42 @@ error:
   }
 }
 
+/**
+ * gst_vaapi_surface_new_with_user_ptr:
+ * @display: a #GstVaapiDisplay
+ * @data: the system memory holding the pixels
+ * @vip: the #GstVideoInfo structure defining the layout of @data
+ *
+ * Creates a new #GstVaapiSurface backed by the supplied system
+ * memory, without any copy. The VA driver generally requires @data
+ * to be page-aligned, and the plane strides to be suitably aligned
+ * too. The caller is responsible for keeping @data alive, and for
+ * not modifying it, for as long as the surface is in use.
+ *
+ * Return value: the newly allocated #GstVaapiSurface object, or %NULL
+ *   if creation of VA surface failed or is not supported
+ */
+GstVaapiSurface *
+gst_vaapi_surface_new_with_user_ptr (GstVaapiDisplay * display,
+    gpointer data, const GstVideoInfo * vip)
+{
+  GstVaapiBufferProxy *proxy;
+  GstVaapiSurface *surface;
+
+  g_return_val_if_fail (data != NULL, NULL);
+  g_return_val_if_fail (vip != NULL, NULL);
+
+  proxy = gst_vaapi_buffer_proxy_new ((guintptr) data,
+      GST_VAAPI_BUFFER_MEMORY_TYPE_USER_PTR, GST_VIDEO_INFO_SIZE (vip), NULL,
+      NULL);
+  if (!proxy)
+    return NULL;
+
+  surface = gst_vaapi_surface_new_from_buffer_proxy (display, proxy, vip);
+  gst_vaapi_buffer_proxy_unref (proxy);
+  return surface;
+}
+
 /**
  * gst_vaapi_surface_get_id:
  * @surface: a #GstVaapiSurface
@@ -570,6 +628,136 @@ gst_vaapi_surface_get_size (GstVaapiSurface * surface,
     *height_ptr = GST_VAAPI_SURFACE_HEIGHT (surface);
 }
 
+/**
+ * gst_vaapi_surface_bump_generation:
+ * @surface: a #GstVaapiSurface
+ *
+ * Records that the @surface contents changed, or are about to change,
+ * by assigning it a new generation number. Generation numbers are
+ * unique across all surfaces.
+ */
+void
+gst_vaapi_surface_bump_generation (GstVaapiSurface * surface)
+{
+  static volatile gint g_next_generation = 0;
+  guint generation;
+
+  g_return_if_fail (surface != NULL);
+
+  do {
+    generation = (guint) g_atomic_int_add (&g_next_generation, 1) + 1;
+  } while (generation == 0);
+  surface->generation = generation;
+}
+
+/**
+ * gst_vaapi_surface_get_generation:
+ * @surface: a #GstVaapiSurface
+ *
+ * Returns the generation number of the @surface contents. It changes
+ * whenever the @surface is acquired from a #GstVaapiSurfacePool to
+ * hold a new picture, or when pixels are uploaded to it with
+ * gst_vaapi_surface_put_image(). Two surfaces never share the same
+ * generation number, so it can be used as a key to cache copies of
+ * the surface contents.
+ *
+ * Return value: the non-zero generation number
+ */
+guint
+gst_vaapi_surface_get_generation (GstVaapiSurface * surface)
+{
+  g_return_val_if_fail (surface != NULL, 0);
+
+  if (!surface->generation)
+    gst_vaapi_surface_bump_generation (surface);
+  return surface->generation;
+}
+
+/* Estimates the memory footprint of a surface allocated with @key */
+static gsize
+get_recycle_size (const GstVaapiSurfaceRecyclerKey * key)
+{
+  const gsize num_pixels = (gsize) key->width * key->height;
+  GstVideoInfo vi;
+
+  if (key->format != GST_VIDEO_FORMAT_UNKNOWN) {
+    gst_video_info_set_format (&vi, key->format, key->width, key->height);
+    return GST_VIDEO_INFO_SIZE (&vi);
+  }
+
+  switch (key->chroma_type) {
+    case GST_VAAPI_CHROMA_TYPE_YUV400:
+      return num_pixels;
+    case GST_VAAPI_CHROMA_TYPE_YUV422:
+    case GST_VAAPI_CHROMA_TYPE_RGB16:
+      return num_pixels * 2;
+    case GST_VAAPI_CHROMA_TYPE_YUV444:
+    case GST_VAAPI_CHROMA_TYPE_YUV420_10BPP:
+      return num_pixels * 3;
+    case GST_VAAPI_CHROMA_TYPE_RGB32:
+      return num_pixels * 4;
+    default:
+      return num_pixels * 3 / 2;
+  }
+}
+
+/**
+ * gst_vaapi_surface_new_recyclable:
+ * @display: a #GstVaapiDisplay
+ * @key: the surface attributes
+ *
+ * Creates a #GstVaapiSurface with the attributes in @key, reusing a VA
+ * surface previously released to the @display surface recycler if
+ * possible. If @key format is %GST_VIDEO_FORMAT_UNKNOWN, the surface
+ * is allocated from its chroma type only. When destroyed, the surface
+ * is handed over to the recycler again, unless it was exported.
+ *
+ * Return value: the newly allocated #GstVaapiSurface object, or %NULL
+ *   on failure
+ */
+GstVaapiSurface *
+gst_vaapi_surface_new_recyclable (GstVaapiDisplay * display,
+    const GstVaapiSurfaceRecyclerKey * key)
+{
+  GstVaapiSurfaceRecycler *recycler;
+  GstVaapiSurface *surface;
+  GstVaapiID surface_id;
+  GstVideoInfo vi;
+
+  g_return_val_if_fail (display != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  recycler = gst_vaapi_display_get_surface_recycler (display);
+  if (recycler &&
+      gst_vaapi_surface_recycler_take (recycler, key, &surface_id)) {
+    surface = gst_vaapi_object_new (gst_vaapi_surface_class (), display);
+    if (!surface) {
+      gst_vaapi_surface_recycler_put (recycler, key, surface_id,
+          get_recycle_size (key));
+      return NULL;
+    }
+    surface->format = key->format;
+    surface->chroma_type = key->chroma_type;
+    surface->width = key->width;
+    surface->height = key->height;
+    GST_VAAPI_OBJECT_ID (surface) = surface_id;
+    GST_DEBUG ("recycled surface %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (surface_id));
+  } else if (key->format != GST_VIDEO_FORMAT_UNKNOWN) {
+    gst_video_info_set_format (&vi, key->format, key->width, key->height);
+    surface = gst_vaapi_surface_new_full (display, &vi, key->flags);
+  } else {
+    surface = gst_vaapi_surface_new (display, key->chroma_type, key->width,
+        key->height);
+  }
+  if (!surface)
+    return NULL;
+
+  surface->recycle_key = *key;
+  surface->recycle_size = get_recycle_size (key);
+  return surface;
+}
+
 /**
  * gst_vaapi_surface_set_parent_context:
  * @surface: a #GstVaapiSurface
@@ -644,18 +832,24 @@ gst_vaapi_surface_derive_image (GstVaapiSurface * surface)
   va_image.image_id = VA_INVALID_ID;
   va_image.buf = VA_INVALID_ID;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaDeriveImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (surface), &va_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, DERIVE_IMAGE, 0,
+      vaDeriveImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (surface), &va_image));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaDeriveImage()"))
     return NULL;
   if (va_image.image_id == VA_INVALID_ID || va_image.buf == VA_INVALID_ID)
     return NULL;
 
   image = gst_vaapi_image_new_with_image (display, &va_image);
-  if (!image)
-    vaDestroyImage (GST_VAAPI_DISPLAY_VADISPLAY (display), va_image.image_id);
+  if (!image) {
+    GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+        VA_INVALID_ID, DESTROY_IMAGE, 0,
+        vaDestroyImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
+            va_image.image_id));
+  }
   return image;
 }
 
@@ -693,10 +887,12 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaGetImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (surface), 0, 0, width, height, image_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, GET_IMAGE, image->image.data_size,
+      vaGetImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (surface), 0, 0, width, height, image_id));
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (display);
   if (!vaapi_check_status (status, "vaGetImage()"))
     return FALSE;
 
@@ -715,8 +911,29 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
  */
 gboolean
 gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
+{
+  return gst_vaapi_surface_put_image_rect (surface, image, NULL);
+}
+
+/**
+ * gst_vaapi_surface_put_image_rect:
+ * @surface: a #GstVaapiSurface
+ * @image: a #GstVaapiImage
+ * @rect: the sub-rectangle to copy, or %NULL for the whole image
+ *
+ * Copies the @rect area of a #GstVaapiImage into the same area of
+ * the @surface. This is useful to upload only the parts of the @image
+ * that were modified. The @image must have a format supported by the
+ * @surface, and the same size.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_surface_put_image_rect (GstVaapiSurface * surface,
+    GstVaapiImage * image, const GstVaapiRectangle * rect)
 {
   GstVaapiDisplay *display;
+  GstVaapiRectangle area;
   VAImageID image_id;
   VAStatus status;
   guint width, height;
@@ -733,18 +950,34 @@ gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (width != surface->width || height != surface->height)
     return FALSE;
 
+  if (!rect) {
+    area.x = 0;
+    area.y = 0;
+    area.width = width;
+    area.height = height;
+  } else {
+    if (rect->x + rect->width > width || rect->y + rect->height > height)
+      return FALSE;
+    area = *rect;
+  }
+  if (!area.width || !area.height)
+    return TRUE;
+
   image_id = GST_VAAPI_OBJECT_ID (image);
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaPutImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (surface), image_id, 0, 0, width, height,
-      0, 0, width, height);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, PUT_IMAGE, image->image.data_size,
+      vaPutImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (surface), image_id, area.x, area.y, area.width,
+          area.height, area.x, area.y, area.width, area.height));
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (display);
   if (!vaapi_check_status (status, "vaPutImage()"))
     return FALSE;
 
+  gst_vaapi_surface_bump_generation (surface);
   return TRUE;
 }
 
@@ -836,14 +1069,16 @@ _gst_vaapi_surface_associate_subpicture (GstVaapiSurface * surface,
     dst_rect_default.height = surface->height;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaAssociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (subpicture), &surface_id, 1,
-      src_rect->x, src_rect->y, src_rect->width, src_rect->height,
-      dst_rect->x, dst_rect->y, dst_rect->width, dst_rect->height,
-      from_GstVaapiSubpictureFlags (gst_vaapi_subpicture_get_flags
-          (subpicture)));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, ASSOCIATE_SUBPICTURE, 0,
+      vaAssociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (subpicture), &surface_id, 1, src_rect->x,
+          src_rect->y, src_rect->width, src_rect->height, dst_rect->x,
+          dst_rect->y, dst_rect->width, dst_rect->height,
+          from_GstVaapiSubpictureFlags (gst_vaapi_subpicture_get_flags
+              (subpicture))));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaAssociateSubpicture()"))
     return FALSE;
 
@@ -901,10 +1136,12 @@ _gst_vaapi_surface_deassociate_subpicture (GstVaapiSurface * surface,
   if (surface_id == VA_INVALID_SURFACE)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaDeassociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (subpicture), &surface_id, 1);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_LOCK_OBJECTS (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, DEASSOCIATE_SUBPICTURE, 0,
+      vaDeassociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (subpicture), &surface_id, 1));
+  GST_VAAPI_DISPLAY_UNLOCK_OBJECTS (display);
   if (!vaapi_check_status (status, "vaDeassociateSubpicture()"))
     return FALSE;
 
@@ -924,6 +1161,7 @@ gboolean
 gst_vaapi_surface_sync (GstVaapiSurface * surface)
 {
   GstVaapiDisplay *display;
+  GstClockTime start;
   VAStatus status;
 
   g_return_val_if_fail (surface != NULL, FALSE);
@@ -932,10 +1170,18 @@ gst_vaapi_surface_sync (GstVaapiSurface * surface)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaSyncSurface (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      GST_VAAPI_OBJECT_ID (surface));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_sync_surface (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        GST_VAAPI_OBJECT_ID (surface));
+
+  start = GST_VAAPI_TIMING_BEGIN ();
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, SYNC_SURFACE, 0,
+      vaSyncSurface (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (surface)));
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (display);
+  GST_VAAPI_TIMING_END (GST_VAAPI_TIMING_STAGE_SYNC, start);
   if (!vaapi_check_status (status, "vaSyncSurface()"))
     return FALSE;
 
@@ -956,15 +1202,19 @@ gboolean
 gst_vaapi_surface_query_status (GstVaapiSurface * surface,
     GstVaapiSurfaceStatus * pstatus)
 {
+  GstVaapiDisplay *display;
   VASurfaceStatus surface_status;
   VAStatus status;
 
   g_return_val_if_fail (surface != NULL, FALSE);
 
-  GST_VAAPI_OBJECT_LOCK_DISPLAY (surface);
-  status = vaQuerySurfaceStatus (GST_VAAPI_OBJECT_VADISPLAY (surface),
-      GST_VAAPI_OBJECT_ID (surface), &surface_status);
-  GST_VAAPI_OBJECT_UNLOCK_DISPLAY (surface);
+  display = GST_VAAPI_OBJECT_DISPLAY (surface);
+  GST_VAAPI_DISPLAY_LOCK_VA_CALL (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, QUERY_SURFACE_STATUS, 0,
+      vaQuerySurfaceStatus (GST_VAAPI_DISPLAY_VADISPLAY (display),
+          GST_VAAPI_OBJECT_ID (surface), &surface_status));
+  GST_VAAPI_DISPLAY_UNLOCK_VA_CALL (display);
   if (!vaapi_check_status (status, "vaQuerySurfaceStatus()"))
     return FALSE;
 
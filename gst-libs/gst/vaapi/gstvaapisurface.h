@@ -185,6 +185,10 @@ GstVaapiSurface *
 gst_vaapi_surface_new_from_buffer_proxy (GstVaapiDisplay * display,
     GstVaapiBufferProxy * proxy, const GstVideoInfo * vip);
 
+GstVaapiSurface *
+gst_vaapi_surface_new_with_user_ptr (GstVaapiDisplay * display,
+    gpointer data, const GstVideoInfo * vip);
+
 GstVaapiID
 gst_vaapi_surface_get_id (GstVaapiSurface * surface);
 
@@ -204,6 +208,9 @@ void
 gst_vaapi_surface_get_size (GstVaapiSurface * surface, guint * width_ptr,
     guint * height_ptr);
 
+guint
+gst_vaapi_surface_get_generation (GstVaapiSurface * surface);
+
 GstVaapiImage *
 gst_vaapi_surface_derive_image (GstVaapiSurface * surface);
 
@@ -213,6 +220,10 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image);
 gboolean
 gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image);
 
+gboolean
+gst_vaapi_surface_put_image_rect (GstVaapiSurface * surface,
+    GstVaapiImage * image, const GstVaapiRectangle * rect);
+
 gboolean
 gst_vaapi_surface_associate_subpicture (GstVaapiSurface * surface,
     GstVaapiSubpicture * subpicture, const GstVaapiRectangle * src_rect,
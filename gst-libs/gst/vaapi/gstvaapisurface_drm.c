@@ -26,16 +26,32 @@
 #include "gstvaapiimage_priv.h"
 #include "gstvaapibufferproxy_priv.h"
 
+/* Exports the buffer of @surface through a derived image. If @vip is
+   not %NULL, it is filled in with the layout of that buffer */
 static GstVaapiBufferProxy *
-gst_vaapi_surface_get_drm_buf_handle (GstVaapiSurface * surface, guint type)
+gst_vaapi_surface_get_drm_buf_handle (GstVaapiSurface * surface, guint type,
+    GstVideoInfo * vip)
 {
   GstVaapiBufferProxy *proxy;
   GstVaapiImage *image;
+  guint i;
 
   image = gst_vaapi_surface_derive_image (surface);
   if (!image)
     goto error_derive_image;
 
+  if (vip) {
+    gst_video_info_set_format (vip, gst_vaapi_image_get_format (image),
+        GST_VAAPI_SURFACE_WIDTH (surface), GST_VAAPI_SURFACE_HEIGHT (surface));
+    if (GST_VIDEO_INFO_N_PLANES (vip) != image->internal_image.num_planes)
+      goto error_invalid_image;
+    for (i = 0; i < GST_VIDEO_INFO_N_PLANES (vip); i++) {
+      GST_VIDEO_INFO_PLANE_OFFSET (vip, i) = image->internal_image.offsets[i];
+      GST_VIDEO_INFO_PLANE_STRIDE (vip, i) = image->internal_image.pitches[i];
+    }
+    GST_VIDEO_INFO_SIZE (vip) = image->internal_image.data_size;
+  }
+
   proxy =
       gst_vaapi_buffer_proxy_new_from_object (GST_VAAPI_OBJECT (surface),
       image->internal_image.buf, type, gst_vaapi_object_unref, image);
@@ -49,6 +65,12 @@ error_derive_image:
     GST_ERROR ("failed to extract image handle from surface");
     return NULL;
   }
+error_invalid_image:
+  {
+    GST_ERROR ("unsupported derived image layout");
+    gst_vaapi_object_unref (image);
+    return NULL;
+  }
 error_alloc_export_buffer:
   {
     GST_ERROR ("failed to allocate export buffer proxy");
@@ -77,7 +99,7 @@ gst_vaapi_surface_get_dma_buf_handle (GstVaapiSurface * surface)
   g_return_val_if_fail (surface != NULL, NULL);
 
   return gst_vaapi_surface_get_drm_buf_handle (surface,
-      GST_VAAPI_BUFFER_MEMORY_TYPE_DMA_BUF);
+      GST_VAAPI_BUFFER_MEMORY_TYPE_DMA_BUF, NULL);
 }
 
 /**
@@ -99,7 +121,7 @@ gst_vaapi_surface_get_gem_buf_handle (GstVaapiSurface * surface)
   g_return_val_if_fail (surface != NULL, NULL);
 
   return gst_vaapi_surface_get_drm_buf_handle (surface,
-      GST_VAAPI_BUFFER_MEMORY_TYPE_GEM_BUF);
+      GST_VAAPI_BUFFER_MEMORY_TYPE_GEM_BUF, NULL);
 }
 
 static void
@@ -189,3 +211,42 @@ gst_vaapi_surface_new_with_gem_buf_handle (GstVaapiDisplay * display,
   gst_vaapi_buffer_proxy_unref (proxy);
   return surface;
 }
+
+/**
+ * gst_vaapi_surface_import_dma_buf:
+ * @display: a #GstVaapiDisplay
+ * @surface: a #GstVaapiSurface, possibly bound to another display
+ *
+ * Creates a new #GstVaapiSurface on @display that shares the
+ * underlying buffer of @surface, through a dma_buf handle. This
+ * allows for using surfaces across #GstVaapiDisplay instances without
+ * copying pixels. The newly created surface keeps @surface alive.
+ *
+ * Return value: the newly allocated #GstVaapiSurface object, or %NULL
+ *   if @surface could not be exported or imported into @display
+ */
+GstVaapiSurface *
+gst_vaapi_surface_import_dma_buf (GstVaapiDisplay * display,
+    GstVaapiSurface * surface)
+{
+  GstVaapiBufferProxy *proxy;
+  GstVaapiSurface *out_surface;
+  GstVideoInfo vi;
+
+  g_return_val_if_fail (display != NULL, NULL);
+  g_return_val_if_fail (surface != NULL, NULL);
+
+  proxy = gst_vaapi_surface_get_drm_buf_handle (surface,
+      GST_VAAPI_BUFFER_MEMORY_TYPE_DMA_BUF, &vi);
+  if (!proxy)
+    return NULL;
+
+  out_surface = gst_vaapi_surface_new_from_buffer_proxy (display, proxy, &vi);
+
+  /* The source surface is still going to be rendered to, so it shall
+   * not be kept busy by the derived image: the acquired buffer
+   * handle is all that is needed from now on. */
+  gst_vaapi_buffer_proxy_release_data (proxy);
+  gst_vaapi_buffer_proxy_unref (proxy);
+  return out_surface;
+}
@@ -43,6 +43,10 @@ gst_vaapi_surface_new_with_gem_buf_handle (GstVaapiDisplay * display,
     guint32 name, guint size, GstVideoFormat format, guint width, guint height,
     gsize offset[GST_VIDEO_MAX_PLANES], gint stride[GST_VIDEO_MAX_PLANES]);
 
+GstVaapiSurface *
+gst_vaapi_surface_import_dma_buf (GstVaapiDisplay * display,
+    GstVaapiSurface * surface);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_SURFACE_DRM_H */
@@ -25,6 +25,7 @@
 
 #include <gst/vaapi/gstvaapicontext.h>
 #include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapisurfacerecycler.h>
 #include "gstvaapiobject_priv.h"
 
 G_BEGIN_DECLS
@@ -48,6 +49,9 @@ struct _GstVaapiSurface
   GstVaapiChromaType chroma_type;
   GPtrArray *subpictures;
   GstVaapiContext *parent_context;
+  guint generation;
+  GstVaapiSurfaceRecyclerKey recycle_key;
+  gsize recycle_size;           /* non-zero if the surface is recyclable */
 };
 
 /**
@@ -118,6 +122,15 @@ G_GNUC_INTERNAL
 GstVaapiContext *
 gst_vaapi_surface_get_parent_context (GstVaapiSurface * surface);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_surface_bump_generation (GstVaapiSurface * surface);
+
+G_GNUC_INTERNAL
+GstVaapiSurface *
+gst_vaapi_surface_new_recyclable (GstVaapiDisplay * display,
+    const GstVaapiSurfaceRecyclerKey * key);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_SURFACE_PRIV_H */
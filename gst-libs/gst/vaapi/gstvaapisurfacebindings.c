@@ -0,0 +1,340 @@
+/*
+ *  gstvaapisurfacebindings.c - Items bound to VA surfaces
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapisurfacebindings
+ * @short_description: Items bound to VA surfaces
+ *
+ * A #GstVaapiSurfaceBindings keeps track of items, e.g. buffers
+ * wrapping the DMABuf export of a VA surface, that are bound to a
+ * given surface. Released items are parked by surface, so that the
+ * next request for a surface gets the very item that is already
+ * bound to it, whatever the order surfaces are requested in.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapisurfacebindings.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct
+{
+  GList link;                   /* in free_bindings, if free */
+  GstVaapiID surface_id;
+  gpointer item;
+  gboolean is_free;
+} Binding;
+
+struct _GstVaapiSurfaceBindings
+{
+  GMutex mutex;
+  GHashTable *surfaces;         /* surface id -> Binding */
+  GHashTable *items;            /* item -> Binding */
+  GQueue free_bindings;         /* head is the most recently released */
+  guint64 num_hits;
+  guint64 num_misses;
+};
+
+static void
+binding_remove (GstVaapiSurfaceBindings * bindings, Binding * binding)
+{
+  if (binding->is_free)
+    g_queue_unlink (&bindings->free_bindings, &binding->link);
+  g_hash_table_remove (bindings->surfaces,
+      GSIZE_TO_POINTER (binding->surface_id));
+  g_hash_table_remove (bindings->items, binding->item);
+  g_slice_free (Binding, binding);
+}
+
+/**
+ * gst_vaapi_surface_bindings_new:
+ *
+ * Creates a new empty #GstVaapiSurfaceBindings.
+ *
+ * Return value: the newly allocated #GstVaapiSurfaceBindings
+ */
+GstVaapiSurfaceBindings *
+gst_vaapi_surface_bindings_new (void)
+{
+  GstVaapiSurfaceBindings *bindings;
+
+  bindings = g_slice_new0 (GstVaapiSurfaceBindings);
+  if (!bindings)
+    return NULL;
+
+  g_mutex_init (&bindings->mutex);
+  bindings->surfaces = g_hash_table_new (g_direct_hash, g_direct_equal);
+  bindings->items = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_queue_init (&bindings->free_bindings);
+  return bindings;
+}
+
+/**
+ * gst_vaapi_surface_bindings_free:
+ * @bindings: a #GstVaapiSurfaceBindings
+ *
+ * Destroys @bindings. Free items shall have been stolen beforehand,
+ * since @bindings does not own them.
+ */
+void
+gst_vaapi_surface_bindings_free (GstVaapiSurfaceBindings * bindings)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!bindings)
+    return;
+
+  g_warn_if_fail (g_queue_is_empty (&bindings->free_bindings));
+
+  g_hash_table_iter_init (&iter, bindings->surfaces);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_slice_free (Binding, value);
+  g_hash_table_unref (bindings->surfaces);
+  g_hash_table_unref (bindings->items);
+  g_mutex_clear (&bindings->mutex);
+  g_slice_free (GstVaapiSurfaceBindings, bindings);
+}
+
+/**
+ * gst_vaapi_surface_bindings_bind:
+ * @bindings: a #GstVaapiSurfaceBindings
+ * @surface_id: the VA surface the @item is bound to
+ * @item: an item in use
+ *
+ * Records that @item is now bound to @surface_id. Any previous binding
+ * of either @item or @surface_id is dropped.
+ */
+void
+gst_vaapi_surface_bindings_bind (GstVaapiSurfaceBindings * bindings,
+    GstVaapiID surface_id, gpointer item)
+{
+  Binding *binding;
+
+  g_return_if_fail (bindings != NULL);
+  g_return_if_fail (surface_id != GST_VAAPI_ID_INVALID);
+  g_return_if_fail (item != NULL);
+
+  g_mutex_lock (&bindings->mutex);
+  binding = g_hash_table_lookup (bindings->items, item);
+  if (binding)
+    binding_remove (bindings, binding);
+  binding = g_hash_table_lookup (bindings->surfaces,
+      GSIZE_TO_POINTER (surface_id));
+  if (binding) {
+    g_warn_if_fail (!binding->is_free);
+    binding_remove (bindings, binding);
+  }
+
+  GST_LOG ("bind item %p to surface %" GST_VAAPI_ID_FORMAT, item,
+      GST_VAAPI_ID_ARGS (surface_id));
+
+  binding = g_slice_new (Binding);
+  binding->link.data = binding;
+  binding->link.prev = NULL;
+  binding->link.next = NULL;
+  binding->surface_id = surface_id;
+  binding->item = item;
+  binding->is_free = FALSE;
+  g_hash_table_insert (bindings->surfaces, GSIZE_TO_POINTER (surface_id),
+      binding);
+  g_hash_table_insert (bindings->items, item, binding);
+  g_mutex_unlock (&bindings->mutex);
+}
+
+/**
+ * gst_vaapi_surface_bindings_unbind:
+ * @bindings: a #GstVaapiSurfaceBindings
+ * @item: an item in use
+ *
+ * Drops the binding of @item, if any.
+ */
+void
+gst_vaapi_surface_bindings_unbind (GstVaapiSurfaceBindings * bindings,
+    gpointer item)
+{
+  Binding *binding;
+
+  g_return_if_fail (bindings != NULL);
+
+  g_mutex_lock (&bindings->mutex);
+  binding = g_hash_table_lookup (bindings->items, item);
+  if (binding)
+    binding_remove (bindings, binding);
+  g_mutex_unlock (&bindings->mutex);
+}
+
+/**
+ * gst_vaapi_surface_bindings_get_surface_id:
+ * @bindings: a #GstVaapiSurfaceBindings
+ * @item: an item
+ *
+ * Return value: the VA surface @item is bound to, or
+ *   %GST_VAAPI_ID_INVALID if @item is not bound
+ */
+GstVaapiID
+gst_vaapi_surface_bindings_get_surface_id (GstVaapiSurfaceBindings * bindings,
+    gpointer item)
+{
+  Binding *binding;
+  GstVaapiID surface_id = GST_VAAPI_ID_INVALID;
+
+  g_return_val_if_fail (bindings != NULL, GST_VAAPI_ID_INVALID);
+
+  g_mutex_lock (&bindings->mutex);
+  binding = g_hash_table_lookup (bindings->items, item);
+  if (binding)
+    surface_id = binding->surface_id;
+  g_mutex_unlock (&bindings->mutex);
+  return surface_id;
+}
+
+/**
+ * gst_vaapi_surface_bindings_acquire:
+ * @bindings: a #GstVaapiSurfaceBindings
+ * @surface_id: the requested VA surface
+ *
+ * Looks up the free item bound to @surface_id and marks it as in use.
+ * The item remains bound to @surface_id.
+ *
+ * Return value: the free item bound to @surface_id, or %NULL if none
+ */
+gpointer
+gst_vaapi_surface_bindings_acquire (GstVaapiSurfaceBindings * bindings,
+    GstVaapiID surface_id)
+{
+  Binding *binding;
+  gpointer item = NULL;
+
+  g_return_val_if_fail (bindings != NULL, NULL);
+
+  g_mutex_lock (&bindings->mutex);
+  binding = g_hash_table_lookup (bindings->surfaces,
+      GSIZE_TO_POINTER (surface_id));
+  if (binding && binding->is_free) {
+    g_queue_unlink (&bindings->free_bindings, &binding->link);
+    binding->is_free = FALSE;
+    item = binding->item;
+    bindings->num_hits++;
+  } else
+    bindings->num_misses++;
+  g_mutex_unlock (&bindings->mutex);
+  return item;
+}
+
+/**
+ * gst_vaapi_surface_bindings_release:
+ * @bindings: a #GstVaapiSurfaceBindings
+ * @item: an item in use
+ *
+ * Parks @item under the surface it is bound to, if any.
+ *
+ * Return value: %TRUE if @item is bound to a surface and is now
+ *   owned by @bindings, %FALSE if the caller keeps it
+ */
+gboolean
+gst_vaapi_surface_bindings_release (GstVaapiSurfaceBindings * bindings,
+    gpointer item)
+{
+  Binding *binding;
+
+  g_return_val_if_fail (bindings != NULL, FALSE);
+
+  g_mutex_lock (&bindings->mutex);
+  binding = g_hash_table_lookup (bindings->items, item);
+  if (binding && !binding->is_free) {
+    binding->is_free = TRUE;
+    g_queue_push_head_link (&bindings->free_bindings, &binding->link);
+  }
+  g_mutex_unlock (&bindings->mutex);
+  return binding != NULL;
+}
+
+/**
+ * gst_vaapi_surface_bindings_steal:
+ * @bindings: a #GstVaapiSurfaceBindings
+ *
+ * Takes the least recently released free item out of @bindings, and
+ * drops its binding, e.g. to bind it to a surface that has none yet.
+ *
+ * Return value: the unbound item, or %NULL if there is no free item
+ */
+gpointer
+gst_vaapi_surface_bindings_steal (GstVaapiSurfaceBindings * bindings)
+{
+  Binding *binding;
+  gpointer item = NULL;
+
+  g_return_val_if_fail (bindings != NULL, NULL);
+
+  g_mutex_lock (&bindings->mutex);
+  if (bindings->free_bindings.tail) {
+    binding = bindings->free_bindings.tail->data;
+    item = binding->item;
+    binding_remove (bindings, binding);
+  }
+  g_mutex_unlock (&bindings->mutex);
+  return item;
+}
+
+/**
+ * gst_vaapi_surface_bindings_get_num_free:
+ * @bindings: a #GstVaapiSurfaceBindings
+ *
+ * Return value: the number of free items parked in @bindings
+ */
+guint
+gst_vaapi_surface_bindings_get_num_free (GstVaapiSurfaceBindings * bindings)
+{
+  guint num_free;
+
+  g_return_val_if_fail (bindings != NULL, 0);
+
+  g_mutex_lock (&bindings->mutex);
+  num_free = g_queue_get_length (&bindings->free_bindings);
+  g_mutex_unlock (&bindings->mutex);
+  return num_free;
+}
+
+/**
+ * gst_vaapi_surface_bindings_get_stats:
+ * @bindings: a #GstVaapiSurfaceBindings
+ * @hits_ptr: return location for the number of requests that got the
+ *   item bound to the surface, or %NULL
+ * @misses_ptr: return location for the number of other requests, or
+ *   %NULL
+ *
+ * Retrieves the @bindings statistics.
+ */
+void
+gst_vaapi_surface_bindings_get_stats (GstVaapiSurfaceBindings * bindings,
+    guint64 * hits_ptr, guint64 * misses_ptr)
+{
+  g_return_if_fail (bindings != NULL);
+
+  g_mutex_lock (&bindings->mutex);
+  if (hits_ptr)
+    *hits_ptr = bindings->num_hits;
+  if (misses_ptr)
+    *misses_ptr = bindings->num_misses;
+  g_mutex_unlock (&bindings->mutex);
+}
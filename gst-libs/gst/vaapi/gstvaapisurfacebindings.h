@@ -0,0 +1,69 @@
+/*
+ *  gstvaapisurfacebindings.h - Items bound to VA surfaces
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_SURFACE_BINDINGS_H
+#define GST_VAAPI_SURFACE_BINDINGS_H
+
+#include <gst/vaapi/gstvaapitypes.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiSurfaceBindings GstVaapiSurfaceBindings;
+
+GstVaapiSurfaceBindings *
+gst_vaapi_surface_bindings_new (void);
+
+void
+gst_vaapi_surface_bindings_free (GstVaapiSurfaceBindings * bindings);
+
+void
+gst_vaapi_surface_bindings_bind (GstVaapiSurfaceBindings * bindings,
+    GstVaapiID surface_id, gpointer item);
+
+void
+gst_vaapi_surface_bindings_unbind (GstVaapiSurfaceBindings * bindings,
+    gpointer item);
+
+GstVaapiID
+gst_vaapi_surface_bindings_get_surface_id (GstVaapiSurfaceBindings * bindings,
+    gpointer item);
+
+gpointer
+gst_vaapi_surface_bindings_acquire (GstVaapiSurfaceBindings * bindings,
+    GstVaapiID surface_id);
+
+gboolean
+gst_vaapi_surface_bindings_release (GstVaapiSurfaceBindings * bindings,
+    gpointer item);
+
+gpointer
+gst_vaapi_surface_bindings_steal (GstVaapiSurfaceBindings * bindings);
+
+guint
+gst_vaapi_surface_bindings_get_num_free (GstVaapiSurfaceBindings * bindings);
+
+void
+gst_vaapi_surface_bindings_get_stats (GstVaapiSurfaceBindings * bindings,
+    guint64 * hits_ptr, guint64 * misses_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_SURFACE_BINDINGS_H */
@@ -29,6 +29,7 @@
 
 #include "sysdeps.h"
 #include "gstvaapisurfacepool.h"
+#include "gstvaapisurface_priv.h"
 #include "gstvaapivideopool_priv.h"
 
 #define DEBUG 1
@@ -47,6 +48,8 @@ struct _GstVaapiSurfacePool
   GstVaapiChromaType chroma_type;
   GstVideoInfo video_info;
   guint alloc_flags;
+  GstVaapiSurfaceRecyclerKey format_key;
+  GstVaapiSurfaceRecyclerKey chroma_key;
 };
 
 static gboolean
@@ -67,6 +70,16 @@ surface_pool_init (GstVaapiSurfacePool * pool, const GstVideoInfo * vip,
     pool->chroma_type = gst_vaapi_video_format_get_chroma_type (format);
   if (!pool->chroma_type)
     return FALSE;
+
+  pool->chroma_key.chroma_type = pool->chroma_type;
+  pool->chroma_key.format = GST_VIDEO_FORMAT_UNKNOWN;
+  pool->chroma_key.width = GST_VIDEO_INFO_WIDTH (vip);
+  pool->chroma_key.height = GST_VIDEO_INFO_HEIGHT (vip);
+  pool->chroma_key.flags = 0;
+
+  pool->format_key = pool->chroma_key;
+  pool->format_key.format = format;
+  pool->format_key.flags = flags;
   return TRUE;
 }
 
@@ -74,20 +87,25 @@ static gpointer
 gst_vaapi_surface_pool_alloc_object (GstVaapiVideoPool * base_pool)
 {
   GstVaapiSurfacePool *const pool = GST_VAAPI_SURFACE_POOL (base_pool);
+  GstVaapiSurface *surface;
 
   /* Try to allocate a surface with an explicit pixel format first */
   if (GST_VIDEO_INFO_FORMAT (&pool->video_info) != GST_VIDEO_FORMAT_ENCODED) {
-    GstVaapiSurface *const surface =
-        gst_vaapi_surface_new_full (base_pool->display, &pool->video_info,
-        pool->alloc_flags);
+    /* Surfaces with an explicit memory layout are not interchangeable */
+    if (pool->alloc_flags & (GST_VAAPI_SURFACE_ALLOC_FLAG_FIXED_STRIDES |
+            GST_VAAPI_SURFACE_ALLOC_FLAG_FIXED_OFFSETS))
+      surface = gst_vaapi_surface_new_full (base_pool->display,
+          &pool->video_info, pool->alloc_flags);
+    else
+      surface = gst_vaapi_surface_new_recyclable (base_pool->display,
+          &pool->format_key);
     if (surface)
       return surface;
   }
 
   /* Otherwise, fallback to the original interface, based on chroma format */
-  return gst_vaapi_surface_new (base_pool->display,
-      pool->chroma_type, GST_VIDEO_INFO_WIDTH (&pool->video_info),
-      GST_VIDEO_INFO_HEIGHT (&pool->video_info));
+  return gst_vaapi_surface_new_recyclable (base_pool->display,
+      &pool->chroma_key);
 }
 
 static inline const GstVaapiMiniObjectClass *
@@ -65,6 +65,11 @@ gst_vaapi_surface_proxy_class (void)
 static void
 gst_vaapi_surface_proxy_init_properties (GstVaapiSurfaceProxy * proxy)
 {
+  /* A new proxy means the surface is going to hold a new picture, be
+     it recycled from a pool or wrapping memory written by someone
+     else, so cached copies of its former contents are stale */
+  gst_vaapi_surface_bump_generation (proxy->surface);
+
   proxy->view_id = 0;
   proxy->timestamp = GST_CLOCK_TIME_NONE;
   proxy->duration = GST_CLOCK_TIME_NONE;
@@ -182,6 +187,8 @@ gst_vaapi_surface_proxy_copy (GstVaapiSurfaceProxy * proxy)
       proxy->parent : proxy);
   copy->pool = proxy->pool ? gst_vaapi_video_pool_ref (proxy->pool) : NULL;
   copy->surface = gst_vaapi_object_ref (proxy->surface);
+  /* The copy refers to the very same picture as @proxy, so it keeps
+     its generation and any image cached for it remains valid */
   copy->view_id = proxy->view_id;
   copy->timestamp = proxy->timestamp;
   copy->duration = proxy->duration;
@@ -0,0 +1,453 @@
+/*
+ *  gstvaapisurfacerecycler.c - VA surface recycler
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapisurfacerecycler
+ * @short_description: VA surface recycler
+ *
+ * A #GstVaapiSurfaceRecycler keeps the VA surfaces surface pools no
+ * longer need, indexed by the attributes they were allocated with, so
+ * that the next pool asking for identical surfaces reuses them instead
+ * of creating new ones. This avoids vaCreateSurfaces() and
+ * vaDestroySurfaces() storms when streams are started and stopped
+ * frequently. Surfaces are destroyed once they have been idle for too
+ * long, or when the total size of the kept surfaces exceeds a given
+ * budget, least recently recycled first. Idle surfaces are evicted by
+ * a background thread, so they don't linger when no pool allocates or
+ * releases surfaces anymore. That thread is only started once the
+ * first surface is recycled, so displays that never release surfaces
+ * to the recycler don't pay for it.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapisurfacerecycler.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct
+{
+  GstVaapiSurfaceRecyclerKey key;
+  GQueue entries;               /* head is the most recently recycled */
+} Bucket;
+
+typedef struct
+{
+  GList lru_link;               /* in recycler->lru */
+  GList bucket_link;            /* in bucket->entries */
+  Bucket *bucket;
+  GstVaapiID surface_id;
+  gsize size;
+  gint64 recycle_time;
+} Entry;
+
+struct _GstVaapiSurfaceRecycler
+{
+  GMutex mutex;
+  GCond cond;                   /* signalled when the lru gets a tail */
+  GThread *thread;
+  gboolean shutdown;
+  GHashTable *buckets;
+  GQueue lru;                   /* head is the most recently recycled */
+  GstVaapiSurfaceRecyclerDestroyFunc destroy_func;
+  gpointer user_data;
+  gsize max_size;
+  GTimeSpan max_idle_time;
+  gsize size;
+  guint64 num_hits;
+  guint64 num_misses;
+};
+
+static guint
+key_hash (gconstpointer data)
+{
+  const GstVaapiSurfaceRecyclerKey *const key = data;
+  guint h;
+
+  h = key->width;
+  h = h * 31 + key->height;
+  h = h * 31 + key->format;
+  h = h * 31 + key->chroma_type;
+  h = h * 31 + key->flags;
+  return h;
+}
+
+static gboolean
+key_equal (gconstpointer a, gconstpointer b)
+{
+  const GstVaapiSurfaceRecyclerKey *const key_a = a;
+  const GstVaapiSurfaceRecyclerKey *const key_b = b;
+
+  return key_a->chroma_type == key_b->chroma_type &&
+      key_a->format == key_b->format &&
+      key_a->width == key_b->width &&
+      key_a->height == key_b->height && key_a->flags == key_b->flags;
+}
+
+static void
+bucket_free (Bucket * bucket)
+{
+  g_slice_free (Bucket, bucket);
+}
+
+/* Unlinks @entry and appends its surface to @evicted, which is
+   destroyed out of the recycler lock */
+static void
+recycler_evict_entry (GstVaapiSurfaceRecycler * recycler, Entry * entry,
+    GQueue * evicted)
+{
+  Bucket *const bucket = entry->bucket;
+
+  g_queue_unlink (&recycler->lru, &entry->lru_link);
+  g_queue_unlink (&bucket->entries, &entry->bucket_link);
+  if (g_queue_is_empty (&bucket->entries))
+    g_hash_table_remove (recycler->buckets, &bucket->key);
+  recycler->size -= entry->size;
+
+  g_queue_push_tail (evicted, GSIZE_TO_POINTER (entry->surface_id));
+  g_slice_free (Entry, entry);
+}
+
+static void
+recycler_evict_idle_unlocked (GstVaapiSurfaceRecycler * recycler,
+    gint64 now, GQueue * evicted)
+{
+  Entry *entry;
+
+  while (recycler->lru.tail) {
+    entry = recycler->lru.tail->data;
+    if (now - entry->recycle_time < recycler->max_idle_time)
+      break;
+    recycler_evict_entry (recycler, entry, evicted);
+  }
+}
+
+static void
+recycler_destroy_surfaces (GstVaapiSurfaceRecycler * recycler,
+    GQueue * evicted)
+{
+  while (!g_queue_is_empty (evicted)) {
+    const GstVaapiID surface_id =
+        GPOINTER_TO_SIZE (g_queue_pop_head (evicted));
+
+    GST_LOG ("destroy surface %" GST_VAAPI_ID_FORMAT,
+        GST_VAAPI_ID_ARGS (surface_id));
+    if (recycler->destroy_func)
+      recycler->destroy_func (surface_id, recycler->user_data);
+  }
+}
+
+/* Destroys the least recently recycled surfaces as soon as they have
+   been idle for too long */
+static gpointer
+recycler_thread (gpointer data)
+{
+  GstVaapiSurfaceRecycler *const recycler = data;
+  GQueue evicted = G_QUEUE_INIT;
+  Entry *entry;
+  gint64 end_time;
+
+  g_mutex_lock (&recycler->mutex);
+  while (!recycler->shutdown) {
+    if (!recycler->lru.tail) {
+      g_cond_wait (&recycler->cond, &recycler->mutex);
+      continue;
+    }
+
+    entry = recycler->lru.tail->data;
+    end_time = entry->recycle_time + recycler->max_idle_time;
+    if (g_cond_wait_until (&recycler->cond, &recycler->mutex, end_time))
+      continue;
+
+    recycler_evict_idle_unlocked (recycler, g_get_monotonic_time (),
+        &evicted);
+    if (g_queue_is_empty (&evicted))
+      continue;
+    g_mutex_unlock (&recycler->mutex);
+    recycler_destroy_surfaces (recycler, &evicted);
+    g_mutex_lock (&recycler->mutex);
+  }
+  g_mutex_unlock (&recycler->mutex);
+  return NULL;
+}
+
+/* Starts the eviction thread, if not already running. Idle surfaces
+   are still evicted on each take and put if this fails */
+static void
+recycler_ensure_thread_unlocked (GstVaapiSurfaceRecycler * recycler)
+{
+  GError *err = NULL;
+
+  if (recycler->thread || recycler->shutdown)
+    return;
+
+  recycler->thread = g_thread_try_new ("vaapi-recycler", recycler_thread,
+      recycler, &err);
+  if (!recycler->thread) {
+    GST_WARNING ("failed to create eviction thread: %s", err->message);
+    g_clear_error (&err);
+  }
+}
+
+/**
+ * gst_vaapi_surface_recycler_new:
+ * @max_size: the maximum total size of the kept surfaces, in bytes
+ * @max_idle_time: the time after which unused surfaces are destroyed
+ * @destroy_func: function used to destroy the evicted surfaces
+ * @user_data: the data passed to @destroy_func
+ *
+ * Creates a new #GstVaapiSurfaceRecycler. Note that @destroy_func is
+ * also called from the thread evicting idle surfaces, which is started
+ * on the first gst_vaapi_surface_recycler_put() call.
+ *
+ * Return value: the newly allocated #GstVaapiSurfaceRecycler, or
+ *   %NULL on failure
+ */
+GstVaapiSurfaceRecycler *
+gst_vaapi_surface_recycler_new (gsize max_size, GTimeSpan max_idle_time,
+    GstVaapiSurfaceRecyclerDestroyFunc destroy_func, gpointer user_data)
+{
+  GstVaapiSurfaceRecycler *recycler;
+
+  recycler = g_slice_new0 (GstVaapiSurfaceRecycler);
+  if (!recycler)
+    return NULL;
+
+  g_mutex_init (&recycler->mutex);
+  g_cond_init (&recycler->cond);
+  recycler->buckets = g_hash_table_new_full (key_hash, key_equal, NULL,
+      (GDestroyNotify) bucket_free);
+  g_queue_init (&recycler->lru);
+  recycler->destroy_func = destroy_func;
+  recycler->user_data = user_data;
+  recycler->max_size = max_size;
+  recycler->max_idle_time = max_idle_time;
+  return recycler;
+}
+
+/**
+ * gst_vaapi_surface_recycler_free:
+ * @recycler: a #GstVaapiSurfaceRecycler
+ *
+ * Destroys all the kept surfaces and the @recycler itself.
+ */
+void
+gst_vaapi_surface_recycler_free (GstVaapiSurfaceRecycler * recycler)
+{
+  GQueue evicted = G_QUEUE_INIT;
+
+  if (!recycler)
+    return;
+
+  /* The eviction thread is only running if a surface was recycled */
+  g_mutex_lock (&recycler->mutex);
+  recycler->shutdown = TRUE;
+  g_cond_signal (&recycler->cond);
+  g_mutex_unlock (&recycler->mutex);
+  if (recycler->thread) {
+    g_thread_join (recycler->thread);
+    recycler->thread = NULL;
+  }
+
+  if (recycler->num_hits + recycler->num_misses > 0)
+    GST_DEBUG ("%" G_GUINT64_FORMAT " surfaces recycled, %" G_GUINT64_FORMAT
+        " created", recycler->num_hits, recycler->num_misses);
+
+  while (recycler->lru.head)
+    recycler_evict_entry (recycler, recycler->lru.head->data, &evicted);
+  recycler_destroy_surfaces (recycler, &evicted);
+
+  g_hash_table_unref (recycler->buckets);
+  g_cond_clear (&recycler->cond);
+  g_mutex_clear (&recycler->mutex);
+  g_slice_free (GstVaapiSurfaceRecycler, recycler);
+}
+
+/**
+ * gst_vaapi_surface_recycler_take:
+ * @recycler: a #GstVaapiSurfaceRecycler
+ * @key: the attributes of the requested surface
+ * @surface_id_ptr: return location for the recycled surface
+ *
+ * Takes the most recently recycled surface allocated with @key
+ * attributes out of @recycler. The caller owns the surface.
+ *
+ * Return value: %TRUE if a surface was found, %FALSE otherwise
+ */
+gboolean
+gst_vaapi_surface_recycler_take (GstVaapiSurfaceRecycler * recycler,
+    const GstVaapiSurfaceRecyclerKey * key, GstVaapiID * surface_id_ptr)
+{
+  GQueue evicted = G_QUEUE_INIT;
+  Bucket *bucket;
+  Entry *entry;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (recycler != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (surface_id_ptr != NULL, FALSE);
+
+  g_mutex_lock (&recycler->mutex);
+  recycler_evict_idle_unlocked (recycler, g_get_monotonic_time (), &evicted);
+
+  bucket = g_hash_table_lookup (recycler->buckets, key);
+  if (bucket) {
+    entry = bucket->entries.head->data;
+    *surface_id_ptr = entry->surface_id;
+    g_queue_unlink (&recycler->lru, &entry->lru_link);
+    g_queue_unlink (&bucket->entries, &entry->bucket_link);
+    if (g_queue_is_empty (&bucket->entries))
+      g_hash_table_remove (recycler->buckets, key);
+    recycler->size -= entry->size;
+    g_slice_free (Entry, entry);
+    recycler->num_hits++;
+    success = TRUE;
+  } else
+    recycler->num_misses++;
+  g_mutex_unlock (&recycler->mutex);
+
+  recycler_destroy_surfaces (recycler, &evicted);
+  return success;
+}
+
+/**
+ * gst_vaapi_surface_recycler_put:
+ * @recycler: a #GstVaapiSurfaceRecycler
+ * @key: the attributes @surface_id was allocated with
+ * @surface_id: the VA surface to recycle
+ * @size: the size of the surface, in bytes
+ *
+ * Hands @surface_id over to @recycler, evicting the least recently
+ * recycled surfaces if needed to stay within the budget.
+ *
+ * Return value: %TRUE on success, %FALSE if @surface_id does not fit
+ *   into the budget, in which case the caller keeps ownership of it
+ */
+gboolean
+gst_vaapi_surface_recycler_put (GstVaapiSurfaceRecycler * recycler,
+    const GstVaapiSurfaceRecyclerKey * key, GstVaapiID surface_id, gsize size)
+{
+  GQueue evicted = G_QUEUE_INIT;
+  Bucket *bucket;
+  Entry *entry;
+  gint64 now;
+
+  g_return_val_if_fail (recycler != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+
+  if (size > recycler->max_size)
+    return FALSE;
+
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&recycler->mutex);
+  recycler_evict_idle_unlocked (recycler, now, &evicted);
+  while (recycler->size + size > recycler->max_size)
+    recycler_evict_entry (recycler, recycler->lru.tail->data, &evicted);
+
+  bucket = g_hash_table_lookup (recycler->buckets, key);
+  if (!bucket) {
+    bucket = g_slice_new (Bucket);
+    bucket->key = *key;
+    g_queue_init (&bucket->entries);
+    g_hash_table_insert (recycler->buckets, &bucket->key, bucket);
+  }
+
+  entry = g_slice_new (Entry);
+  entry->lru_link.data = entry;
+  entry->lru_link.prev = entry->lru_link.next = NULL;
+  entry->bucket_link.data = entry;
+  entry->bucket_link.prev = entry->bucket_link.next = NULL;
+  entry->bucket = bucket;
+  entry->surface_id = surface_id;
+  entry->size = size;
+  entry->recycle_time = now;
+  g_queue_push_head_link (&recycler->lru, &entry->lru_link);
+  g_queue_push_head_link (&bucket->entries, &entry->bucket_link);
+  recycler->size += size;
+  recycler_ensure_thread_unlocked (recycler);
+
+  /* The least recently recycled surface only changes if it is this one */
+  if (recycler->lru.tail == &entry->lru_link)
+    g_cond_signal (&recycler->cond);
+  g_mutex_unlock (&recycler->mutex);
+
+  recycler_destroy_surfaces (recycler, &evicted);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_surface_recycler_evict_idle:
+ * @recycler: a #GstVaapiSurfaceRecycler
+ * @now: the current monotonic time, in microseconds
+ *
+ * Destroys the surfaces that have been kept for too long. This is
+ * also done by the eviction thread as surfaces expire, and on each
+ * gst_vaapi_surface_recycler_take() and gst_vaapi_surface_recycler_put()
+ * call.
+ *
+ * Return value: the number of destroyed surfaces
+ */
+guint
+gst_vaapi_surface_recycler_evict_idle (GstVaapiSurfaceRecycler * recycler,
+    gint64 now)
+{
+  GQueue evicted = G_QUEUE_INIT;
+  guint num_evicted;
+
+  g_return_val_if_fail (recycler != NULL, 0);
+
+  g_mutex_lock (&recycler->mutex);
+  recycler_evict_idle_unlocked (recycler, now, &evicted);
+  g_mutex_unlock (&recycler->mutex);
+
+  num_evicted = g_queue_get_length (&evicted);
+  recycler_destroy_surfaces (recycler, &evicted);
+  return num_evicted;
+}
+
+/**
+ * gst_vaapi_surface_recycler_get_stats:
+ * @recycler: a #GstVaapiSurfaceRecycler
+ * @hits_ptr: return location for the number of recycled surfaces, or
+ *   %NULL
+ * @misses_ptr: return location for the number of requests no surface
+ *   was available for, or %NULL
+ * @size_ptr: return location for the total size of the kept surfaces,
+ *   in bytes, or %NULL
+ *
+ * Retrieves the @recycler statistics.
+ */
+void
+gst_vaapi_surface_recycler_get_stats (GstVaapiSurfaceRecycler * recycler,
+    guint64 * hits_ptr, guint64 * misses_ptr, gsize * size_ptr)
+{
+  g_return_if_fail (recycler != NULL);
+
+  g_mutex_lock (&recycler->mutex);
+  if (hits_ptr)
+    *hits_ptr = recycler->num_hits;
+  if (misses_ptr)
+    *misses_ptr = recycler->num_misses;
+  if (size_ptr)
+    *size_ptr = recycler->size;
+  g_mutex_unlock (&recycler->mutex);
+}
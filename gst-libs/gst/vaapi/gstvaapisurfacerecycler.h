@@ -0,0 +1,90 @@
+/*
+ *  gstvaapisurfacerecycler.h - VA surface recycler
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_SURFACE_RECYCLER_H
+#define GST_VAAPI_SURFACE_RECYCLER_H
+
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapitypes.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiSurfaceRecycler GstVaapiSurfaceRecycler;
+typedef struct _GstVaapiSurfaceRecyclerKey GstVaapiSurfaceRecyclerKey;
+
+/**
+ * GstVaapiSurfaceRecyclerKey:
+ * @chroma_type: the surface chroma type
+ * @format: the surface pixel format, or %GST_VIDEO_FORMAT_UNKNOWN if
+ *   the surface was allocated from its chroma type only
+ * @width: the surface width, in pixels
+ * @height: the surface height, in pixels
+ * @flags: the surface allocation flags
+ *
+ * The attributes surfaces were allocated with. Only surfaces with the
+ * very same attributes are interchangeable.
+ */
+struct _GstVaapiSurfaceRecyclerKey
+{
+  guint chroma_type;
+  GstVideoFormat format;
+  guint width;
+  guint height;
+  guint flags;
+};
+
+/**
+ * GstVaapiSurfaceRecyclerDestroyFunc:
+ * @surface_id: the evicted VA surface
+ * @user_data: the data passed to gst_vaapi_surface_recycler_new()
+ *
+ * Destroys a VA surface evicted from the recycler.
+ */
+typedef void (*GstVaapiSurfaceRecyclerDestroyFunc) (GstVaapiID surface_id,
+    gpointer user_data);
+
+GstVaapiSurfaceRecycler *
+gst_vaapi_surface_recycler_new (gsize max_size, GTimeSpan max_idle_time,
+    GstVaapiSurfaceRecyclerDestroyFunc destroy_func, gpointer user_data);
+
+void
+gst_vaapi_surface_recycler_free (GstVaapiSurfaceRecycler * recycler);
+
+gboolean
+gst_vaapi_surface_recycler_take (GstVaapiSurfaceRecycler * recycler,
+    const GstVaapiSurfaceRecyclerKey * key, GstVaapiID * surface_id_ptr);
+
+gboolean
+gst_vaapi_surface_recycler_put (GstVaapiSurfaceRecycler * recycler,
+    const GstVaapiSurfaceRecyclerKey * key, GstVaapiID surface_id,
+    gsize size);
+
+guint
+gst_vaapi_surface_recycler_evict_idle (GstVaapiSurfaceRecycler * recycler,
+    gint64 now);
+
+void
+gst_vaapi_surface_recycler_get_stats (GstVaapiSurfaceRecycler * recycler,
+    guint64 * hits_ptr, guint64 * misses_ptr, gsize * size_ptr);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_SURFACE_RECYCLER_H */
@@ -33,6 +33,7 @@
 #include "gstvaapitexture_priv.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiutils_glx.h"
 #include "gstvaapidisplay_glx.h"
 #include "gstvaapidisplay_x11_priv.h"
@@ -343,11 +344,13 @@ gst_vaapi_texture_glx_put_surface_unlocked (GstVaapiTexture * base_texture,
     {1.0f, 0.0f},
   };
 
-  status = vaPutSurface (GST_VAAPI_OBJECT_VADISPLAY (texture),
-      GST_VAAPI_OBJECT_ID (surface), texture->pixo->pixmap,
-      crop_rect->x, crop_rect->y, crop_rect->width, crop_rect->height,
-      0, 0, base_texture->width, base_texture->height,
-      NULL, 0, from_GstVaapiSurfaceRenderFlags (flags));
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_OBJECT_VADISPLAY (texture),
+      VA_INVALID_ID, PUT_SURFACE, 0,
+      vaPutSurface (GST_VAAPI_OBJECT_VADISPLAY (texture),
+          GST_VAAPI_OBJECT_ID (surface), texture->pixo->pixmap, crop_rect->x,
+          crop_rect->y, crop_rect->width, crop_rect->height, 0, 0,
+          base_texture->width, base_texture->height, NULL, 0,
+          from_GstVaapiSurfaceRenderFlags (flags)));
   if (!vaapi_check_status (status, "vaPutSurface() [TFP]"))
     return FALSE;
 
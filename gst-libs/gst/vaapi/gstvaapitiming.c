@@ -0,0 +1,162 @@
+/*
+ *  gstvaapitiming.c - Stage timing instrumentation
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapitiming
+ * @short_description: Stage timing instrumentation
+ *
+ * The key stages of decoding and encoding, i.e. parsing, picture
+ * submission, surface synchronization and output, are timed with a
+ * monotonic clock once a #GstVaapiTimingFunc is installed with
+ * gst_vaapi_timing_set_func(). Otherwise, each stage only costs a
+ * test of a global flag, so the instrumentation is always built in.
+ *
+ * The durations are reported to the timing function, and accumulated
+ * into the innermost #GstVaapiTimingScope of the calling thread, so
+ * that they can be attributed to the frame being processed.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapitiming.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+gint _gst_vaapi_timing_enabled = 0;
+
+static GMutex g_timing_lock;
+static GstVaapiTimingFunc g_timing_func;
+static gpointer g_timing_data;
+
+/* The durations of the innermost scope of the current thread */
+static GPrivate g_timing_scope = G_PRIVATE_INIT (NULL);
+
+/**
+ * gst_vaapi_timing_stage_get_name:
+ * @stage: a #GstVaapiTimingStage
+ *
+ * Returns: the name of @stage, or %NULL if it is invalid
+ */
+const gchar *
+gst_vaapi_timing_stage_get_name (GstVaapiTimingStage stage)
+{
+  static const gchar *stage_names[GST_VAAPI_TIMING_STAGE_COUNT] = {
+    "parse", "decode", "sync", "push", "encode", "get-buffer",
+  };
+
+  if ((guint) stage >= GST_VAAPI_TIMING_STAGE_COUNT)
+    return NULL;
+  return stage_names[stage];
+}
+
+/**
+ * gst_vaapi_timing_set_func:
+ * @func: the #GstVaapiTimingFunc to install, or %NULL
+ * @user_data: the data to pass to @func
+ *
+ * Installs @func to receive the duration of every stage, which also
+ * turns the instrumentation on. Passing %NULL turns it off.
+ */
+void
+gst_vaapi_timing_set_func (GstVaapiTimingFunc func, gpointer user_data)
+{
+  g_mutex_lock (&g_timing_lock);
+  g_timing_func = func;
+  g_timing_data = user_data;
+  g_atomic_int_set (&_gst_vaapi_timing_enabled, func != NULL);
+  g_mutex_unlock (&g_timing_lock);
+}
+
+/**
+ * gst_vaapi_timing_record:
+ * @stage: the #GstVaapiTimingStage that completed
+ * @start: the time at which @stage started, from gst_util_get_timestamp()
+ *
+ * Accounts the duration of @stage to the innermost #GstVaapiTimingScope
+ * of the calling thread, if any, and reports it to the timing function.
+ * This is normally called through GST_VAAPI_TIMING_END().
+ */
+void
+gst_vaapi_timing_record (GstVaapiTimingStage stage, GstClockTime start)
+{
+  GstClockTime *durations;
+  GstClockTime now, duration;
+
+  g_return_if_fail ((guint) stage < GST_VAAPI_TIMING_STAGE_COUNT);
+
+  now = gst_util_get_timestamp ();
+  duration = now > start ? now - start : 0;
+
+  durations = g_private_get (&g_timing_scope);
+  if (durations)
+    durations[stage] += duration;
+
+  g_mutex_lock (&g_timing_lock);
+  if (g_timing_func)
+    g_timing_func (stage, duration, g_timing_data);
+  g_mutex_unlock (&g_timing_lock);
+}
+
+/**
+ * gst_vaapi_timing_scope_begin:
+ * @scope: a #GstVaapiTimingScope
+ *
+ * Makes @scope the innermost scope of the calling thread, with all
+ * durations reset to zero. Nothing is done if the instrumentation is
+ * off, and @scope is left inactive.
+ */
+void
+gst_vaapi_timing_scope_begin (GstVaapiTimingScope * scope)
+{
+  g_return_if_fail (scope != NULL);
+
+  scope->active = GST_VAAPI_TIMING_IS_ENABLED ();
+  if (!scope->active)
+    return;
+
+  memset (scope->durations, 0, sizeof (scope->durations));
+  scope->parent_durations = g_private_get (&g_timing_scope);
+  g_private_set (&g_timing_scope, scope->durations);
+}
+
+/**
+ * gst_vaapi_timing_scope_end:
+ * @scope: the innermost #GstVaapiTimingScope of the calling thread
+ *
+ * Restores the scope that was active when @scope began. The durations
+ * accumulated into @scope are also accounted to that parent scope.
+ */
+void
+gst_vaapi_timing_scope_end (GstVaapiTimingScope * scope)
+{
+  guint i;
+
+  g_return_if_fail (scope != NULL);
+
+  if (!scope->active)
+    return;
+
+  g_private_set (&g_timing_scope, scope->parent_durations);
+  if (scope->parent_durations) {
+    for (i = 0; i < GST_VAAPI_TIMING_STAGE_COUNT; i++)
+      scope->parent_durations[i] += scope->durations[i];
+  }
+}
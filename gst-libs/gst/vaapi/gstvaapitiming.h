@@ -0,0 +1,133 @@
+/*
+ *  gstvaapitiming.h - Stage timing instrumentation
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_TIMING_H
+#define GST_VAAPI_TIMING_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstVaapiTimingStage:
+ * @GST_VAAPI_TIMING_STAGE_PARSE: bitstream parsing of a decoder unit
+ * @GST_VAAPI_TIMING_STAGE_DECODE: submission of a picture for decoding
+ * @GST_VAAPI_TIMING_STAGE_SYNC: wait for the completion of a surface
+ * @GST_VAAPI_TIMING_STAGE_PUSH: push of a decoded frame downstream
+ * @GST_VAAPI_TIMING_STAGE_ENCODE: submission of a frame for encoding
+ * @GST_VAAPI_TIMING_STAGE_GET_BUFFER: wait for the next coded buffer,
+ *   including the surface synchronization
+ * @GST_VAAPI_TIMING_STAGE_COUNT: the number of stages
+ *
+ * The instrumented stages of the processing of a frame.
+ */
+typedef enum
+{
+  GST_VAAPI_TIMING_STAGE_PARSE = 0,
+  GST_VAAPI_TIMING_STAGE_DECODE,
+  GST_VAAPI_TIMING_STAGE_SYNC,
+  GST_VAAPI_TIMING_STAGE_PUSH,
+  GST_VAAPI_TIMING_STAGE_ENCODE,
+  GST_VAAPI_TIMING_STAGE_GET_BUFFER,
+
+  GST_VAAPI_TIMING_STAGE_COUNT
+} GstVaapiTimingStage;
+
+typedef struct _GstVaapiTimingScope GstVaapiTimingScope;
+
+/**
+ * GstVaapiTimingScope:
+ *
+ * Accumulates the duration of the stages run by the current thread,
+ * between gst_vaapi_timing_scope_begin() and
+ * gst_vaapi_timing_scope_end(), e.g. while a frame is being processed.
+ */
+struct _GstVaapiTimingScope
+{
+  /*< private >*/
+  GstClockTime durations[GST_VAAPI_TIMING_STAGE_COUNT];
+  GstClockTime *parent_durations;
+  gboolean active;
+};
+
+/**
+ * GstVaapiTimingFunc:
+ * @stage: the stage that completed
+ * @duration: the duration of the stage, in nanoseconds
+ * @user_data: the data supplied to gst_vaapi_timing_set_func()
+ *
+ * Called from the thread that ran the @stage, every time one completes.
+ */
+typedef void (*GstVaapiTimingFunc) (GstVaapiTimingStage stage,
+    GstClockTime duration, gpointer user_data);
+
+/* Non-zero when a timing function is installed (private) */
+extern gint _gst_vaapi_timing_enabled;
+
+/**
+ * GST_VAAPI_TIMING_IS_ENABLED:
+ *
+ * Evaluates to %TRUE if the stages are to be timed. This is the only
+ * cost of the instrumentation when disabled.
+ */
+#define GST_VAAPI_TIMING_IS_ENABLED() \
+  G_UNLIKELY (g_atomic_int_get (&_gst_vaapi_timing_enabled))
+
+/**
+ * GST_VAAPI_TIMING_BEGIN:
+ *
+ * Evaluates to the start time of a stage, or %GST_CLOCK_TIME_NONE if
+ * the stages are not timed.
+ */
+#define GST_VAAPI_TIMING_BEGIN() \
+  (GST_VAAPI_TIMING_IS_ENABLED () ? gst_util_get_timestamp () : \
+   GST_CLOCK_TIME_NONE)
+
+/**
+ * GST_VAAPI_TIMING_END:
+ * @stage: the #GstVaapiTimingStage that completed
+ * @start: the value of GST_VAAPI_TIMING_BEGIN() when the stage started
+ *
+ * Accounts the duration of @stage, if it was timed.
+ */
+#define GST_VAAPI_TIMING_END(stage, start) G_STMT_START {       \
+    if (G_UNLIKELY (GST_CLOCK_TIME_IS_VALID (start)))           \
+      gst_vaapi_timing_record (stage, start);                   \
+  } G_STMT_END
+
+const gchar *
+gst_vaapi_timing_stage_get_name (GstVaapiTimingStage stage);
+
+void
+gst_vaapi_timing_set_func (GstVaapiTimingFunc func, gpointer user_data);
+
+void
+gst_vaapi_timing_record (GstVaapiTimingStage stage, GstClockTime start);
+
+void
+gst_vaapi_timing_scope_begin (GstVaapiTimingScope * scope);
+
+void
+gst_vaapi_timing_scope_end (GstVaapiTimingScope * scope);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_TIMING_H */
@@ -25,6 +25,8 @@
 #include "sysdeps.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
+#include "gstvaapirecorder.h"
 #include "gstvaapisurface.h"
 #include "gstvaapisubpicture.h"
 #include "gstvaapifilter.h"
@@ -61,7 +63,8 @@ gst_vaapi_log (const char *message)
 #endif
 
 gboolean
-vaapi_initialize (VADisplay dpy)
+vaapi_initialize (VADisplay dpy, gint * major_version_ptr,
+    gint * minor_version_ptr)
 {
   gint major_version, minor_version;
   VAStatus status;
@@ -70,11 +73,19 @@ vaapi_initialize (VADisplay dpy)
   vaSetInfoCallback (gst_vaapi_log);
 #endif
 
-  status = vaInitialize (dpy, &major_version, &minor_version);
+  gst_vaapi_profiler_init ();
+  gst_vaapi_recorder_init ();
+
+  GST_VAAPI_PROFILER_CALL (status, dpy, VA_INVALID_ID, INITIALIZE, 0,
+      vaInitialize (dpy, &major_version, &minor_version));
   if (!vaapi_check_status (status, "vaInitialize()"))
     return FALSE;
 
   GST_INFO ("VA-API version %d.%d", major_version, minor_version);
+  if (major_version_ptr)
+    *major_version_ptr = major_version;
+  if (minor_version_ptr)
+    *minor_version_ptr = minor_version;
   return TRUE;
 }
 
@@ -96,7 +107,8 @@ vaapi_map_buffer (VADisplay dpy, VABufferID buf_id)
   VAStatus status;
   gpointer data = NULL;
 
-  status = vaMapBuffer (dpy, buf_id, &data);
+  GST_VAAPI_PROFILER_CALL (status, dpy, VA_INVALID_ID, MAP_BUFFER, 0,
+      vaMapBuffer (dpy, buf_id, &data));
   if (!vaapi_check_status (status, "vaMapBuffer()"))
     return NULL;
   return data;
@@ -111,7 +123,8 @@ vaapi_unmap_buffer (VADisplay dpy, VABufferID buf_id, gpointer * pbuf)
   if (pbuf)
     *pbuf = NULL;
 
-  status = vaUnmapBuffer (dpy, buf_id);
+  GST_VAAPI_PROFILER_CALL (status, dpy, VA_INVALID_ID, UNMAP_BUFFER, 0,
+      vaUnmapBuffer (dpy, buf_id));
   if (!vaapi_check_status (status, "vaUnmapBuffer()"))
     return;
 }
@@ -125,10 +138,14 @@ vaapi_create_buffer (VADisplay dpy, VAContextID ctx, int type, guint size,
   VAStatus status;
   gpointer data = (gpointer) buf;
 
-  status = vaCreateBuffer (dpy, ctx, type, size, 1, data, &buf_id);
+  GST_VAAPI_PROFILER_CALL (status, dpy, ctx, CREATE_BUFFER, size,
+      vaCreateBuffer (dpy, ctx, type, size, 1, data, &buf_id));
   if (!vaapi_check_status (status, "vaCreateBuffer()"))
     return FALSE;
 
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_create_buffer (dpy, ctx, buf_id, type, size, 1);
+
   if (mapped_data) {
     data = vaapi_map_buffer (dpy, buf_id);
     if (!data)
@@ -151,10 +168,17 @@ error:
 void
 vaapi_destroy_buffer (VADisplay dpy, VABufferID * buf_id_ptr)
 {
+  VAStatus status;
+
   if (!buf_id_ptr || *buf_id_ptr == VA_INVALID_ID)
     return;
 
-  vaDestroyBuffer (dpy, *buf_id_ptr);
+  if (GST_VAAPI_RECORDER_IS_ENABLED ())
+    gst_vaapi_recorder_destroy_buffer (dpy, *buf_id_ptr);
+
+  GST_VAAPI_PROFILER_CALL (status, dpy, VA_INVALID_ID, DESTROY_BUFFER, 0,
+      vaDestroyBuffer (dpy, *buf_id_ptr));
+  vaapi_check_status (status, "vaDestroyBuffer()");
   *buf_id_ptr = VA_INVALID_ID;
 }
 
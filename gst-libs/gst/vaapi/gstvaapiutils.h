@@ -33,7 +33,8 @@
 /** calls vaInitialize() redirecting the logging mechanism */
 G_GNUC_INTERNAL
 gboolean
-vaapi_initialize (VADisplay dpy);
+vaapi_initialize (VADisplay dpy, gint * major_version_ptr,
+    gint * minor_version_ptr);
 
 /** Check VA status for success or print out an error */
 G_GNUC_INTERNAL
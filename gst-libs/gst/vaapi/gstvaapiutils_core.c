@@ -26,6 +26,7 @@
 #include "gstvaapicompat.h"
 #include "gstvaapiimage.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiutils_core.h"
 #include "gstvaapidisplay_priv.h"
 
@@ -62,11 +63,11 @@ gst_vaapi_get_config_attribute (GstVaapiDisplay * display, VAProfile profile,
 
   g_return_val_if_fail (display != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
   attrib.type = type;
-  status = vaGetConfigAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      profile, entrypoint, &attrib, 1);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, GET_CONFIG_ATTRIBUTES, 0,
+      vaGetConfigAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display), profile,
+          entrypoint, &attrib, 1));
   if (!vaapi_check_status (status, "vaGetConfigAttributes()"))
     return FALSE;
   if (attrib.value == VA_ATTRIB_NOT_SUPPORTED)
@@ -101,10 +102,10 @@ gst_vaapi_get_surface_formats (GstVaapiDisplay * display, VAConfigID config)
   if (config == VA_INVALID_ID)
     return NULL;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  va_status = vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      config, NULL, &num_surface_attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_PROFILER_CALL (va_status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, QUERY_SURFACE_ATTRIBUTES, 0,
+      vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display), config,
+          NULL, &num_surface_attribs));
   if (!vaapi_check_status (va_status, "vaQuerySurfaceAttributes()"))
     return NULL;
 
@@ -112,10 +113,10 @@ gst_vaapi_get_surface_formats (GstVaapiDisplay * display, VAConfigID config)
   if (!surface_attribs)
     return NULL;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  va_status = vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      config, surface_attribs, &num_surface_attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_PROFILER_CALL (va_status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+      VA_INVALID_ID, QUERY_SURFACE_ATTRIBUTES, 0,
+      vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display), config,
+          surface_attribs, &num_surface_attribs));
   if (!vaapi_check_status (va_status, "vaQuerySurfaceAttributes()"))
     return NULL;
 
@@ -0,0 +1,76 @@
+/*
+ *  gstvaapiutils_h264_enc_priv.h - H.264 bitstream writer utilities
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_UTILS_H264_ENC_PRIV_H
+#define GST_VAAPI_UTILS_H264_ENC_PRIV_H
+
+#include <gst/base/gstbitwriter.h>
+#include <va/va.h>
+#include <va/va_enc_h264.h>
+#include <gst/vaapi/gstvaapiprofile.h>
+#include "gstvaapiutils_h26x.h"
+
+G_BEGIN_DECLS
+
+/* Fixed-length slice header fields recorded in templates, in order */
+enum
+{
+  GST_VAAPI_H264_SLICE_TMPL_FIELD_FRAME_NUM,
+  GST_VAAPI_H264_SLICE_TMPL_FIELD_POC_LSB,
+};
+
+/* Writes the seq_parameter_set_rbsp() of @seq_param */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h264_write_sps (GstBitWriter * bs,
+    const VAEncSequenceParameterBufferH264 * seq_param, GstVaapiProfile profile,
+    const VAEncMiscParameterHRD * hrd_params);
+
+/* Writes the subset_seq_parameter_set_rbsp() of @seq_param, for MVC */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h264_write_subset_sps (GstBitWriter * bs,
+    const VAEncSequenceParameterBufferH264 * seq_param, GstVaapiProfile profile,
+    guint num_views, guint16 * view_ids,
+    const VAEncMiscParameterHRD * hrd_params);
+
+/* Writes the pic_parameter_set_rbsp() of @pic_param */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h264_write_pps (GstBitWriter * bs,
+    const VAEncPictureParameterBufferH264 * pic_param, GstVaapiProfile profile);
+
+/* Writes the slice_header() of @slice_param. The sequence level syntax
+   elements are the ones of the active SPS. If @tmpl is not NULL, the
+   position of the fields that vary from one picture to the next is
+   recorded there */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h264_write_slice_header (GstBitWriter * bs,
+    const VAEncPictureParameterBufferH264 * pic_param,
+    const VAEncSliceParameterBufferH264 * slice_param,
+    guint log2_max_frame_num, guint log2_max_pic_order_cnt_lsb,
+    guint pic_order_cnt_type, gboolean delta_pic_order_always_zero_flag,
+    GstVaapiH26xHeaderTemplate * tmpl);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_UTILS_H264_ENC_PRIV_H */
@@ -0,0 +1,286 @@
+/*
+ *  gstvaapiutils_h265_enc.c - H.265 bitstream writer utilities
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *    Author: Sreerenj Balachandran <sreerenj.balachandran@intel.com>
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <math.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include "gstvaapiutils_h265_enc_priv.h"
+#include "gstvaapiutils_h26x_priv.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Write a PPS NAL unit */
+gboolean
+gst_vaapi_utils_h265_write_pps (GstBitWriter * bs,
+    const VAEncPictureParameterBufferHEVC * pic_param)
+{
+  guint32 pic_parameter_set_id = 0;
+  guint32 seq_parameter_set_id = 0;
+  guint32 output_flag_present_flag = 0;
+  guint32 num_extra_slice_header_bits = 0;
+  guint32 cabac_init_present_flag = 0;
+  guint32 pps_slice_chroma_qp_offsets_present_flag = 0;
+  guint32 deblocking_filter_control_present_flag = 0;
+  guint32 lists_modification_present_flag = 0;
+  guint32 slice_segment_header_extension_present_flag = 0;
+  guint32 pps_extension_flag = 0;
+
+  /* pic_parameter_set_id */
+  WRITE_UE (bs, pic_parameter_set_id);
+  /* seq_parameter_set_id */
+  WRITE_UE (bs, seq_parameter_set_id);
+  /* dependent_slice_segments_enabled_flag */
+  WRITE_UINT32 (bs,
+      pic_param->pic_fields.bits.dependent_slice_segments_enabled_flag, 1);
+  /* output_flag_present_flag */
+  WRITE_UINT32 (bs, output_flag_present_flag, 1);
+  /* num_extra_slice_header_bits */
+  WRITE_UINT32 (bs, num_extra_slice_header_bits, 3);
+  /* sign_data_hiding_enabled_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.sign_data_hiding_enabled_flag,
+      1);
+  /* cabac_init_present_flag */
+  WRITE_UINT32 (bs, cabac_init_present_flag, 1);
+  /* num_ref_idx_l0_default_active_minus1 */
+  WRITE_UE (bs, pic_param->num_ref_idx_l0_default_active_minus1);
+  /* num_ref_idx_l1_default_active_minus1 */
+  WRITE_UE (bs, pic_param->num_ref_idx_l1_default_active_minus1);
+  /* pic_init_qp_minus26 */
+  WRITE_SE (bs, pic_param->pic_init_qp - 26);
+  /* constrained_intra_pred_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.constrained_intra_pred_flag, 1);
+  /* transform_skip_enabled_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.transform_skip_enabled_flag, 1);
+  /* cu_qp_delta_enabled_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.cu_qp_delta_enabled_flag, 1);
+  /* diff_cu_qp_delta_depth */
+  if (pic_param->pic_fields.bits.cu_qp_delta_enabled_flag)
+    WRITE_UE (bs, pic_param->diff_cu_qp_delta_depth);
+
+  /* pps_cb_qp_offset */
+  WRITE_SE (bs, pic_param->pps_cb_qp_offset);
+  /* pps_cr_qp_offset */
+  WRITE_SE (bs, pic_param->pps_cr_qp_offset);
+  /* pps_slice_chroma_qp_offsets_present_flag */
+  WRITE_UINT32 (bs, pps_slice_chroma_qp_offsets_present_flag, 1);
+  /* weighted_pred_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.weighted_pred_flag, 1);
+  /* weighted_bipred_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.weighted_bipred_flag, 1);
+  /* transquant_bypass_enabled_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.transquant_bypass_enabled_flag,
+      1);
+  /* tiles_enabled_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.tiles_enabled_flag, 1);
+  /* entropy_coding_sync_enabled_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.entropy_coding_sync_enabled_flag,
+      1);
+  /* pps_loop_filter_across_slices_enabled_flag */
+  WRITE_UINT32 (bs,
+      pic_param->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag, 1);
+  /* deblocking_filter_control_present_flag */
+  WRITE_UINT32 (bs, deblocking_filter_control_present_flag, 1);
+  /* pps_scaling_list_data_present_flag */
+  WRITE_UINT32 (bs, pic_param->pic_fields.bits.scaling_list_data_present_flag,
+      1);
+  /* lists_modification_present_flag */
+  WRITE_UINT32 (bs, lists_modification_present_flag, 1);
+  /* log2_parallel_merge_level_minus2 */
+  WRITE_UE (bs, pic_param->log2_parallel_merge_level_minus2);
+  /* slice_segment_header_extension_present_flag */
+  WRITE_UINT32 (bs, slice_segment_header_extension_present_flag, 1);
+  /* pps_extension_flag */
+  WRITE_UINT32 (bs, pps_extension_flag, 1);
+
+  /* rbsp_trailing_bits */
+  bs_write_trailing_bits (bs);
+
+  return TRUE;
+
+  /* ERRORS */
+bs_error:
+  {
+    GST_WARNING ("failed to write PPS NAL unit");
+    return FALSE;
+  }
+}
+
+/* Write a Slice NAL unit */
+gboolean
+gst_vaapi_utils_h265_write_slice_header (GstBitWriter * bs,
+    const VAEncPictureParameterBufferHEVC * pic_param,
+    const VAEncSliceParameterBufferHEVC * slice_param,
+    guint log2_max_pic_order_cnt_lsb, guint pic_size_in_ctbs,
+    gboolean sps_temporal_mvp_enabled_flag,
+    gboolean sample_adaptive_offset_enabled_flag,
+    GstVaapiH26xHeaderTemplate * tmpl)
+{
+  const gint32 poc = pic_param->decoded_curr_pic.pic_order_cnt;
+  const guint8 first_slice_segment_in_pic_flag =
+      slice_param->slice_segment_address == 0;
+
+  guint8 no_output_of_prior_pics_flag = 0;
+  guint8 dependent_slice_segment_flag = 0;
+  guint8 short_term_ref_pic_set_sps_flag = 0;
+  guint8 num_ref_idx_active_override_flag = 0;
+  guint8 slice_deblocking_filter_disabled_flag = 0;
+
+  /* first_slice_segment_in_pic_flag */
+  WRITE_UINT32 (bs, first_slice_segment_in_pic_flag, 1);
+
+  /* Fixme: For all IRAP pics */
+  /* no_output_of_prior_pics_flag */
+  if (pic_param->pic_fields.bits.idr_pic_flag)
+    WRITE_UINT32 (bs, no_output_of_prior_pics_flag, 1);
+
+  /* slice_pic_parameter_set_id */
+  WRITE_UE (bs, slice_param->slice_pic_parameter_set_id);
+
+  /* slice_segment_address , bits_size = Ceil(Log2(PicSizeInCtbsY)) */
+  if (!first_slice_segment_in_pic_flag) {
+    guint bits_size = (guint) ceil ((log2 (pic_size_in_ctbs)));
+    WRITE_UINT32 (bs, slice_param->slice_segment_address, bits_size);
+  }
+
+  if (!dependent_slice_segment_flag) {
+    /* slice_type */
+    WRITE_UE (bs, slice_param->slice_type);
+
+    if (!pic_param->pic_fields.bits.idr_pic_flag) {
+      /* slice_pic_order_cnt_lsb */
+      if (tmpl)
+        gst_vaapi_utils_h26x_header_template_add_field (tmpl,
+            GST_BIT_WRITER_BIT_SIZE (bs), log2_max_pic_order_cnt_lsb);
+      WRITE_UINT32 (bs, poc, log2_max_pic_order_cnt_lsb);
+      /* short_term_ref_pic_set_sps_flag */
+      WRITE_UINT32 (bs, short_term_ref_pic_set_sps_flag, 1);
+
+    /*---------- Write short_term_ref_pic_set(0) ----------- */
+      {
+        guint num_positive_pics = 0, num_negative_pics = 0;
+        guint delta_poc_s0_minus1 = 0, delta_poc_s1_minus1 = 0;
+        guint used_by_curr_pic_s0_flag = 0, used_by_curr_pic_s1_flag = 0;
+
+        if (slice_param->slice_type == GST_H265_P_SLICE) {
+          num_negative_pics = 1;
+          num_positive_pics = 0;
+          delta_poc_s0_minus1 =
+              poc - slice_param->ref_pic_list0[0].pic_order_cnt - 1;
+          used_by_curr_pic_s0_flag = 1;
+          delta_poc_s1_minus1 = 0;
+          used_by_curr_pic_s1_flag = 0;
+        }
+        if (slice_param->slice_type == GST_H265_B_SLICE) {
+          num_negative_pics = 1;
+          num_positive_pics = 1;
+          delta_poc_s0_minus1 =
+              poc - slice_param->ref_pic_list0[0].pic_order_cnt - 1;
+          used_by_curr_pic_s0_flag = 1;
+          delta_poc_s1_minus1 =
+              slice_param->ref_pic_list1[0].pic_order_cnt - poc - 1;
+          used_by_curr_pic_s1_flag = 1;
+        }
+
+        /* num_negative_pics */
+        WRITE_UE (bs, num_negative_pics);
+        /* num_positive_pics */
+        WRITE_UE (bs, num_positive_pics);
+        if (num_negative_pics) {
+          /* delta_poc_s0_minus1 */
+          WRITE_UE (bs, delta_poc_s0_minus1);
+          /* used_by_curr_pic_s0_flag */
+          WRITE_UINT32 (bs, used_by_curr_pic_s0_flag, 1);
+        }
+        if (num_positive_pics) {
+          /* delta_poc_s1_minus1 */
+          WRITE_UE (bs, delta_poc_s1_minus1);
+          /* used_by_curr_pic_s1_flag */
+          WRITE_UINT32 (bs, used_by_curr_pic_s1_flag, 1);
+        }
+      }
+
+      /* slice_temporal_mvp_enabled_flag */
+      if (sps_temporal_mvp_enabled_flag)
+        WRITE_UINT32 (bs,
+            slice_param->slice_fields.bits.slice_temporal_mvp_enabled_flag, 1);
+    }
+
+    if (sample_adaptive_offset_enabled_flag) {
+      WRITE_UINT32 (bs, slice_param->slice_fields.bits.slice_sao_luma_flag, 1);
+      WRITE_UINT32 (bs, slice_param->slice_fields.bits.slice_sao_chroma_flag,
+          1);
+    }
+
+    if (slice_param->slice_type == GST_H265_P_SLICE ||
+        slice_param->slice_type == GST_H265_B_SLICE) {
+      /* num_ref_idx_active_override_flag */
+      WRITE_UINT32 (bs, num_ref_idx_active_override_flag, 1);
+      /* mvd_l1_zero_flag */
+      if (slice_param->slice_type == GST_H265_B_SLICE)
+        WRITE_UINT32 (bs, slice_param->slice_fields.bits.mvd_l1_zero_flag, 1);
+
+      /* cabac_init_present_flag == FALSE */
+      /* cabac_init_flag  = FALSE */
+
+      /* collocated_from_l0_flag */
+      if (slice_param->slice_fields.bits.slice_temporal_mvp_enabled_flag) {
+        if (slice_param->slice_type == GST_H265_B_SLICE)
+          WRITE_UINT32 (bs,
+              slice_param->slice_fields.bits.collocated_from_l0_flag, 1);
+      }
+      /* five_minus_max_num_merge_cand */
+      WRITE_UE (bs, 5 - slice_param->max_num_merge_cand);
+    }
+
+    /* slice_qp_delta */
+    WRITE_SE (bs, slice_param->slice_qp_delta);
+    if (pic_param->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag &&
+        (slice_param->slice_fields.bits.slice_sao_luma_flag
+            || slice_param->slice_fields.bits.slice_sao_chroma_flag
+            || !slice_deblocking_filter_disabled_flag))
+      WRITE_UINT32 (bs,
+          slice_param->slice_fields.bits.
+          slice_loop_filter_across_slices_enabled_flag, 1);
+
+  }
+
+  /* byte_alignment() */
+  {
+    /* alignment_bit_equal_to_one */
+    WRITE_UINT32 (bs, 1, 1);
+    while (GST_BIT_WRITER_BIT_SIZE (bs) % 8 != 0) {
+      /* alignment_bit_equal_to_zero */
+      WRITE_UINT32 (bs, 0, 1);
+    }
+  }
+
+  return TRUE;
+
+  /* ERRORS */
+bs_error:
+  {
+    GST_WARNING ("failed to write Slice NAL unit");
+    return FALSE;
+  }
+}
@@ -0,0 +1,60 @@
+/*
+ *  gstvaapiutils_h265_enc_priv.h - H.265 bitstream writer utilities
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_UTILS_H265_ENC_PRIV_H
+#define GST_VAAPI_UTILS_H265_ENC_PRIV_H
+
+#include <gst/base/gstbitwriter.h>
+#include <va/va.h>
+#include <va/va_enc_hevc.h>
+#include "gstvaapiutils_h26x.h"
+
+G_BEGIN_DECLS
+
+/* Fixed-length slice header fields recorded in templates, in order */
+enum
+{
+  GST_VAAPI_H265_SLICE_TMPL_FIELD_POC_LSB,
+};
+
+/* Writes the pic_parameter_set_rbsp() of @pic_param */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h265_write_pps (GstBitWriter * bs,
+    const VAEncPictureParameterBufferHEVC * pic_param);
+
+/* Writes the slice_segment_header() of @slice_param, followed by the
+   byte_alignment() bits. The sequence level syntax elements are the
+   ones of the active SPS. If @tmpl is not NULL, the position of the
+   fields that vary from one picture to the next is recorded there */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_utils_h265_write_slice_header (GstBitWriter * bs,
+    const VAEncPictureParameterBufferHEVC * pic_param,
+    const VAEncSliceParameterBufferHEVC * slice_param,
+    guint log2_max_pic_order_cnt_lsb, guint pic_size_in_ctbs,
+    gboolean sps_temporal_mvp_enabled_flag,
+    gboolean sample_adaptive_offset_enabled_flag,
+    GstVaapiH26xHeaderTemplate * tmpl);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_UTILS_H265_ENC_PRIV_H */
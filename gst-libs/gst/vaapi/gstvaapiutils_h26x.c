@@ -23,6 +23,7 @@
  *  Boston, MA 02110-1301 USA
  */
 
+#include "gstvaapiutils_h26x.h"
 #include "gstvaapiutils_h26x_priv.h"
 
 /* Write an unsigned integer Exp-Golomb-coded syntax element. i.e. ue(v) */
@@ -60,6 +61,16 @@ bs_write_se (GstBitWriter * bs, gint32 value)
   return TRUE;
 }
 
+/* Write the NAL unit trailing bits, i.e. rbsp_trailing_bits() */
+gboolean
+bs_write_trailing_bits (GstBitWriter * bs)
+{
+  if (!gst_bit_writer_put_bits_uint32 (bs, 1, 1))
+    return FALSE;
+  gst_bit_writer_align_bytes_unchecked (bs, 0);
+  return TRUE;
+}
+
 /* Copy from src to dst, applying emulation prevention bytes.
  *
  * This is copied from libavcodec written by Mark Thompson
@@ -145,3 +156,303 @@ bs_error:
     return FALSE;
   }
 }
+
+/* Checks whether the NAL unit starting with @nal_header is a VCL NAL unit */
+static inline gboolean
+nal_unit_is_vcl (guint8 nal_header, gboolean is_hevc)
+{
+  guint nal_unit_type;
+
+  if (is_hevc) {
+    /* VCL NAL unit types are in the range 0..31 */
+    nal_unit_type = (nal_header >> 1) & 0x3f;
+    return nal_unit_type < 32;
+  }
+
+  nal_unit_type = nal_header & 0x1f;
+  switch (nal_unit_type) {
+    case 1:                    /* non-IDR slice */
+    case 2:                    /* slice data partition A */
+    case 3:                    /* slice data partition B */
+    case 4:                    /* slice data partition C */
+    case 5:                    /* IDR slice */
+    case 20:                   /* slice extension (MVC) */
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* Finds the next start code prefix in [@data, @end). The returned
+   offset includes the leading zero_byte of 4-byte start codes */
+static const guint8 *
+find_start_code (const guint8 * data, const guint8 * end, guint * sc_len_ptr)
+{
+  const guint8 *p;
+
+  for (p = data; p + 3 <= end; p++) {
+    if (p[0] != 0 || p[1] != 0 || p[2] != 1)
+      continue;
+
+    if (p > data && p[-1] == 0) {
+      *sc_len_ptr = 4;
+      return p - 1;
+    }
+    *sc_len_ptr = 3;
+    return p;
+  }
+  return NULL;
+}
+
+/**
+ * gst_vaapi_utils_h26x_split_slices:
+ * @data: the coded picture, in byte-stream format
+ * @size: the size of @data, in bytes
+ * @is_hevc: %TRUE if @data is an H.265 bitstream, %FALSE for H.264
+ * @slices: a #GArray of #GstVaapiH26xSliceRange to fill in
+ *
+ * Splits the coded picture in @data into as many ranges as there are
+ * slices. Each range ends with one VCL NAL unit and holds any non-VCL
+ * NAL unit preceding it, e.g. the SPS/PPS and packed slice headers
+ * generated by the encoder. Trailing non-VCL NAL units are appended
+ * to the last range. If no VCL NAL unit is found, then the whole
+ * @data is reported as a single range.
+ *
+ * Returns: the number of ranges stored into @slices
+ **/
+guint
+gst_vaapi_utils_h26x_split_slices (const guint8 * data, guint size,
+    gboolean is_hevc, GArray * slices)
+{
+  const guint8 *const end = data + size;
+  const guint8 *nal, *next_nal;
+  GstVaapiH26xSliceRange range;
+  guint sc_len, next_sc_len, range_start;
+
+  g_return_val_if_fail (slices != NULL, 0);
+  g_return_val_if_fail (g_array_get_element_size (slices) ==
+      sizeof (GstVaapiH26xSliceRange), 0);
+
+  g_array_set_size (slices, 0);
+  if (!data || !size)
+    return 0;
+
+  range_start = 0;
+  nal = find_start_code (data, end, &sc_len);
+  while (nal) {
+    const guint8 *const nal_header = nal + sc_len;
+
+    if (nal_header >= end)
+      break;
+
+    next_nal = find_start_code (nal_header + 1, end, &next_sc_len);
+    if (nal_unit_is_vcl (*nal_header, is_hevc)) {
+      const guint nal_end = (next_nal ? next_nal : end) - data;
+
+      range.offset = range_start;
+      range.size = nal_end - range_start;
+      g_array_append_val (slices, range);
+      range_start = nal_end;
+    }
+    nal = next_nal;
+    sc_len = next_sc_len;
+  }
+
+  if (range_start < size) {
+    if (slices->len > 0) {
+      GstVaapiH26xSliceRange *const last_range =
+          &g_array_index (slices, GstVaapiH26xSliceRange, slices->len - 1);
+      last_range->size = size - last_range->offset;
+    } else {
+      range.offset = range_start;
+      range.size = size - range_start;
+      g_array_append_val (slices, range);
+    }
+  }
+  return slices->len;
+}
+
+/**
+ * gst_vaapi_utils_h26x_header_template_clear:
+ * @tmpl: a #GstVaapiH26xHeaderTemplate
+ *
+ * Releases the resources held by @tmpl. The template is left empty,
+ * and it never matches any key until it is filled again.
+ **/
+void
+gst_vaapi_utils_h26x_header_template_clear (GstVaapiH26xHeaderTemplate * tmpl)
+{
+  g_return_if_fail (tmpl != NULL);
+
+  g_free (tmpl->data);
+  g_free (tmpl->key);
+  memset (tmpl, 0, sizeof (*tmpl));
+}
+
+/**
+ * gst_vaapi_utils_h26x_header_template_match:
+ * @tmpl: a #GstVaapiH26xHeaderTemplate
+ * @key: the syntax elements the header is generated from
+ * @key_size: the size of @key, in bytes
+ *
+ * Determines whether @tmpl was generated from the same @key, i.e.
+ * whether it can be reused by only patching its variable fields.
+ *
+ * Returns: %TRUE if @tmpl holds a header generated from @key
+ **/
+gboolean
+gst_vaapi_utils_h26x_header_template_match (GstVaapiH26xHeaderTemplate * tmpl,
+    gconstpointer key, guint key_size)
+{
+  g_return_val_if_fail (tmpl != NULL, FALSE);
+
+  return tmpl->data && tmpl->key_size == key_size &&
+      memcmp (tmpl->key, key, key_size) == 0;
+}
+
+/**
+ * gst_vaapi_utils_h26x_header_template_reset:
+ * @tmpl: a #GstVaapiH26xHeaderTemplate
+ * @key: the syntax elements the header is generated from
+ * @key_size: the size of @key, in bytes
+ *
+ * Starts generating a new header for @key into @tmpl. Variable fields
+ * shall then be declared with
+ * gst_vaapi_utils_h26x_header_template_add_field() while the header is
+ * being written, and the resulting bytes stored with
+ * gst_vaapi_utils_h26x_header_template_set_data().
+ **/
+void
+gst_vaapi_utils_h26x_header_template_reset (GstVaapiH26xHeaderTemplate * tmpl,
+    gconstpointer key, guint key_size)
+{
+  g_return_if_fail (tmpl != NULL);
+
+  gst_vaapi_utils_h26x_header_template_clear (tmpl);
+  tmpl->key = g_memdup (key, key_size);
+  tmpl->key_size = key_size;
+}
+
+/**
+ * gst_vaapi_utils_h26x_header_template_add_field:
+ * @tmpl: a #GstVaapiH26xHeaderTemplate
+ * @bit_offset: the position of the field in the header, in bits
+ * @num_bits: the size of the field, in bits
+ *
+ * Declares a fixed-length field that varies from one use of @tmpl to
+ * the next.
+ *
+ * Returns: the field index to pass to
+ *   gst_vaapi_utils_h26x_header_template_patch(), or -1 on error
+ **/
+gint
+gst_vaapi_utils_h26x_header_template_add_field (GstVaapiH26xHeaderTemplate *
+    tmpl, guint32 bit_offset, guint num_bits)
+{
+  g_return_val_if_fail (tmpl != NULL, -1);
+  g_return_val_if_fail (num_bits > 0 && num_bits <= 32, -1);
+
+  if (tmpl->num_fields == GST_VAAPI_H26X_HEADER_TEMPLATE_MAX_FIELDS)
+    return -1;
+
+  tmpl->field_offsets[tmpl->num_fields] = bit_offset;
+  tmpl->field_sizes[tmpl->num_fields] = num_bits;
+  return tmpl->num_fields++;
+}
+
+/**
+ * gst_vaapi_utils_h26x_header_template_set_data:
+ * @tmpl: a #GstVaapiH26xHeaderTemplate
+ * @data: the header bytes
+ * @bit_size: the size of the header, in bits
+ *
+ * Stores a copy of the header generated for the current key.
+ **/
+void
+gst_vaapi_utils_h26x_header_template_set_data (GstVaapiH26xHeaderTemplate *
+    tmpl, const guint8 * data, guint32 bit_size)
+{
+  g_return_if_fail (tmpl != NULL);
+  g_return_if_fail (data != NULL);
+
+  g_free (tmpl->data);
+  tmpl->data = g_memdup (data, (bit_size + 7) / 8);
+  tmpl->bit_size = bit_size;
+}
+
+/**
+ * gst_vaapi_utils_h26x_header_template_patch:
+ * @tmpl: a #GstVaapiH26xHeaderTemplate
+ * @field: the field index
+ * @value: the new field value
+ *
+ * Overwrites the @field bits of the header held in @tmpl with the
+ * least significant bits of @value, most significant bit first.
+ **/
+void
+gst_vaapi_utils_h26x_header_template_patch (GstVaapiH26xHeaderTemplate * tmpl,
+    guint field, guint32 value)
+{
+  guint32 pos;
+  guint i, num_bits;
+  guint8 mask;
+
+  g_return_if_fail (tmpl != NULL && tmpl->data != NULL);
+  g_return_if_fail (field < tmpl->num_fields);
+
+  pos = tmpl->field_offsets[field];
+  num_bits = tmpl->field_sizes[field];
+  g_return_if_fail (pos + num_bits <= tmpl->bit_size);
+
+  for (i = 0; i < num_bits; i++, pos++) {
+    mask = 0x80 >> (pos % 8);
+    if ((value >> (num_bits - 1 - i)) & 1)
+      tmpl->data[pos / 8] |= mask;
+    else
+      tmpl->data[pos / 8] &= ~mask;
+  }
+}
+
+/**
+ * gst_vaapi_utils_h26x_align_crop_rect:
+ * @crop_rect: the region of the frame to display
+ * @width: the frame width
+ * @height: the frame height
+ * @crop_unit_y: the vertical crop unit, in luma lines
+ * @out_rect: return location for the aligned region
+ *
+ * Extends @crop_rect to the crop unit of a 4:2:0 H.264 or H.265
+ * stream, i.e. to 2 luma samples horizontally and @crop_unit_y luma
+ * lines vertically. The region is clamped to the frame horizontally,
+ * and vertically to the frame height rounded up to @crop_unit_y, as
+ * the lines below the frame up to the next crop unit are part of the
+ * coded padding.
+ *
+ * Returns: %TRUE if @crop_rect is a non-empty region of the frame,
+ *   %FALSE otherwise, in which case @out_rect is left untouched
+ **/
+gboolean
+gst_vaapi_utils_h26x_align_crop_rect (const GstVaapiRectangle * crop_rect,
+    guint width, guint height, guint crop_unit_y,
+    GstVaapiRectangle * out_rect)
+{
+  guint x2, y2;
+
+  g_return_val_if_fail (crop_rect != NULL, FALSE);
+  g_return_val_if_fail (crop_unit_y > 0, FALSE);
+  g_return_val_if_fail (out_rect != NULL, FALSE);
+
+  if (crop_rect->width == 0 || crop_rect->height == 0 ||
+      crop_rect->x >= width || crop_rect->y >= height ||
+      crop_rect->width > width - crop_rect->x ||
+      crop_rect->height > height - crop_rect->y)
+    return FALSE;
+
+  x2 = MIN (GST_ROUND_UP_2 (crop_rect->x + crop_rect->width), width);
+  y2 = MIN (GST_ROUND_UP_N (crop_rect->y + crop_rect->height, crop_unit_y),
+      GST_ROUND_UP_N (height, crop_unit_y));
+  out_rect->x = GST_ROUND_DOWN_2 (crop_rect->x);
+  out_rect->y = GST_ROUND_DOWN_N (crop_rect->y, crop_unit_y);
+  out_rect->width = x2 - out_rect->x;
+  out_rect->height = y2 - out_rect->y;
+  return TRUE;
+}
@@ -0,0 +1,109 @@
+/*
+ *  gstvaapiutils_h26x.h - H.26x related utilities
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_UTILS_H26X_H
+#define GST_VAAPI_UTILS_H26X_H
+
+#include <glib.h>
+#include <gst/vaapi/gstvaapitypes.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiH26xSliceRange GstVaapiH26xSliceRange;
+typedef struct _GstVaapiH26xHeaderTemplate GstVaapiH26xHeaderTemplate;
+
+/**
+ * GstVaapiH26xSliceRange:
+ * @offset: the offset of the first byte of the range
+ * @size: the size of the range, in bytes
+ *
+ * A range of an H.264/H.265 byte-stream holding one slice NAL unit,
+ * along with any non-VCL NAL unit (parameter sets, SEI, AUD) that
+ * precedes it.
+ */
+struct _GstVaapiH26xSliceRange
+{
+  guint offset;
+  guint size;
+};
+
+/* Splits a coded picture in byte-stream format into slice ranges */
+guint
+gst_vaapi_utils_h26x_split_slices (const guint8 * data, guint size,
+    gboolean is_hevc, GArray * slices);
+
+#define GST_VAAPI_H26X_HEADER_TEMPLATE_MAX_FIELDS 4
+
+/**
+ * GstVaapiH26xHeaderTemplate:
+ * @data: the header bytes, with the latest patched field values
+ * @bit_size: the size of the header, in bits
+ *
+ * A packed header generated once for a given set of syntax elements
+ * (the key), and then reused by only patching the fixed-length fields
+ * that vary from one picture to the next, e.g. frame_num or the POC
+ * LSB in slice headers.
+ */
+struct _GstVaapiH26xHeaderTemplate
+{
+  guint8 *data;
+  guint32 bit_size;
+
+  /*< private >*/
+  gpointer key;
+  guint key_size;
+  guint num_fields;
+  guint32 field_offsets[GST_VAAPI_H26X_HEADER_TEMPLATE_MAX_FIELDS];
+  guint8 field_sizes[GST_VAAPI_H26X_HEADER_TEMPLATE_MAX_FIELDS];
+};
+
+void
+gst_vaapi_utils_h26x_header_template_clear (GstVaapiH26xHeaderTemplate * tmpl);
+
+gboolean
+gst_vaapi_utils_h26x_header_template_match (GstVaapiH26xHeaderTemplate * tmpl,
+    gconstpointer key, guint key_size);
+
+void
+gst_vaapi_utils_h26x_header_template_reset (GstVaapiH26xHeaderTemplate * tmpl,
+    gconstpointer key, guint key_size);
+
+gint
+gst_vaapi_utils_h26x_header_template_add_field (GstVaapiH26xHeaderTemplate *
+    tmpl, guint32 bit_offset, guint num_bits);
+
+void
+gst_vaapi_utils_h26x_header_template_set_data (GstVaapiH26xHeaderTemplate *
+    tmpl, const guint8 * data, guint32 bit_size);
+
+void
+gst_vaapi_utils_h26x_header_template_patch (GstVaapiH26xHeaderTemplate * tmpl,
+    guint field, guint32 value);
+
+/* Aligns a cropping rectangle outwards to the crop unit of the SPS */
+gboolean
+gst_vaapi_utils_h26x_align_crop_rect (const GstVaapiRectangle * crop_rect,
+    guint width, guint height, guint crop_unit_y,
+    GstVaapiRectangle * out_rect);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_UTILS_H26X_H */
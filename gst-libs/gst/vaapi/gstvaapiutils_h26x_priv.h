@@ -79,6 +79,9 @@ bs_write_ue (GstBitWriter * bs, guint32 value);
 gboolean
 bs_write_se (GstBitWriter * bs, gint32 value);
 
+gboolean
+bs_write_trailing_bits (GstBitWriter * bs);
+
 /* Write nal unit, applying emulation prevention bytes */
 gboolean
 gst_vaapi_utils_h26x_write_nal_unit (GstBitWriter * bs, guint8 * nal, guint nal_size);
@@ -404,6 +404,36 @@ gst_vaapi_video_pool_get_capacity (GstVaapiVideoPool * pool)
   return capacity;
 }
 
+/**
+ * gst_vaapi_video_pool_get_num_available:
+ * @pool: a #GstVaapiVideoPool
+ *
+ * Returns the number of objects that can still be obtained from the
+ * @pool through gst_vaapi_video_pool_get_object() without exceeding
+ * its capacity. If the @pool has no capacity limit, then %G_MAXUINT
+ * is returned.
+ *
+ * Return value: the number of objects still available in the pool
+ */
+guint
+gst_vaapi_video_pool_get_num_available (GstVaapiVideoPool * pool)
+{
+  guint num_available;
+
+  g_return_val_if_fail (pool != NULL, 0);
+
+  g_mutex_lock (&pool->mutex);
+  if (!pool->capacity)
+    num_available = G_MAXUINT;
+  else if (pool->used_count < pool->capacity)
+    num_available = pool->capacity - pool->used_count;
+  else
+    num_available = 0;
+  g_mutex_unlock (&pool->mutex);
+
+  return num_available;
+}
+
 /**
  * gst_vaapi_video_pool_set_capacity:
  * @pool: a #GstVaapiVideoPool
@@ -88,6 +88,9 @@ gst_vaapi_video_pool_reserve (GstVaapiVideoPool * pool, guint n);
 guint
 gst_vaapi_video_pool_get_capacity (GstVaapiVideoPool * pool);
 
+guint
+gst_vaapi_video_pool_get_num_available (GstVaapiVideoPool * pool);
+
 void
 gst_vaapi_video_pool_set_capacity (GstVaapiVideoPool * pool, guint capacity);
 
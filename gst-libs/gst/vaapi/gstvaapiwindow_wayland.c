@@ -34,6 +34,7 @@
 #include "gstvaapidisplay_wayland.h"
 #include "gstvaapidisplay_wayland_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapifilter.h"
 #include "gstvaapisurfacepool.h"
 
@@ -491,9 +492,11 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
   if (!need_vpp) {
     GST_VAAPI_OBJECT_LOCK_DISPLAY (window);
     va_flags = from_GstVaapiSurfaceRenderFlags (flags);
-    status = vaGetSurfaceBufferWl (GST_VAAPI_DISPLAY_VADISPLAY (display),
-        GST_VAAPI_OBJECT_ID (surface),
-        va_flags & (VA_TOP_FIELD | VA_BOTTOM_FIELD), &buffer);
+    GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+        VA_INVALID_ID, GET_SURFACE_BUFFER_WL, 0,
+        vaGetSurfaceBufferWl (GST_VAAPI_DISPLAY_VADISPLAY (display),
+            GST_VAAPI_OBJECT_ID (surface),
+            va_flags & (VA_TOP_FIELD | VA_BOTTOM_FIELD), &buffer));
     GST_VAAPI_OBJECT_UNLOCK_DISPLAY (window);
     if (status == VA_STATUS_ERROR_FLAG_NOT_SUPPORTED ||
         status == VA_STATUS_ERROR_UNIMPLEMENTED ||
@@ -518,8 +521,10 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
     }
 
     GST_VAAPI_OBJECT_LOCK_DISPLAY (window);
-    status = vaGetSurfaceBufferWl (GST_VAAPI_DISPLAY_VADISPLAY (display),
-        GST_VAAPI_OBJECT_ID (surface), VA_FRAME_PICTURE, &buffer);
+    GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_DISPLAY_VADISPLAY (display),
+        VA_INVALID_ID, GET_SURFACE_BUFFER_WL, 0,
+        vaGetSurfaceBufferWl (GST_VAAPI_DISPLAY_VADISPLAY (display),
+            GST_VAAPI_OBJECT_ID (surface), VA_FRAME_PICTURE, &buffer));
     GST_VAAPI_OBJECT_UNLOCK_DISPLAY (window);
     if (!vaapi_check_status (status, "vaGetSurfaceBufferWl()"))
       return FALSE;
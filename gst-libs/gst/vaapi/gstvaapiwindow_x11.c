@@ -38,6 +38,7 @@
 #include "gstvaapidisplay_x11.h"
 #include "gstvaapidisplay_x11_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiutils_x11.h"
 
 #define DEBUG 1
@@ -410,18 +411,13 @@ gst_vaapi_window_x11_render (GstVaapiWindow * window,
     return FALSE;
 
   GST_VAAPI_OBJECT_LOCK_DISPLAY (window);
-  status = vaPutSurface (GST_VAAPI_OBJECT_VADISPLAY (window),
-      surface_id,
-      GST_VAAPI_OBJECT_ID (window),
-      src_rect->x,
-      src_rect->y,
-      src_rect->width,
-      src_rect->height,
-      dst_rect->x,
-      dst_rect->y,
-      dst_rect->width,
-      dst_rect->height, NULL, 0, from_GstVaapiSurfaceRenderFlags (flags)
-      );
+  GST_VAAPI_PROFILER_CALL (status, GST_VAAPI_OBJECT_VADISPLAY (window),
+      VA_INVALID_ID, PUT_SURFACE, 0,
+      vaPutSurface (GST_VAAPI_OBJECT_VADISPLAY (window), surface_id,
+          GST_VAAPI_OBJECT_ID (window), src_rect->x, src_rect->y,
+          src_rect->width, src_rect->height, dst_rect->x, dst_rect->y,
+          dst_rect->width, dst_rect->height, NULL, 0,
+          from_GstVaapiSurfaceRenderFlags (flags)));
   GST_VAAPI_OBJECT_UNLOCK_DISPLAY (window);
   if (!vaapi_check_status (status, "vaPutSurface()"))
     return FALSE;
@@ -23,10 +23,13 @@
  */
 
 #include "gstcompat.h"
+#include "gstvaapicompositor.h"
 #include "gstvaapidecode.h"
 #include "gstvaapipostproc.h"
+#include "gstvaapipostprocmulti.h"
 #include "gstvaapisink.h"
 #include "gstvaapidecodebin.h"
+#include "gstvaapitimingtracer.h"
 
 #if USE_ENCODERS
 #include "gstvaapiencode_h264.h"
@@ -198,6 +201,8 @@ plugin_init (GstPlugin * plugin)
 
   plugin_add_dependencies (plugin);
 
+  gst_tracer_register (plugin, "vaapitiming", GST_TYPE_VAAPI_TIMING_TRACER);
+
   display = gst_vaapi_create_test_display ();
   if (!display)
     goto error_no_display;
@@ -210,9 +215,19 @@ plugin_init (GstPlugin * plugin)
     g_array_unref (decoders);
   }
 
+  /* Without video processing pipeline, the filters fall back to
+     software scaling and color conversion */
+#if USE_VA_VPP
+  gst_element_register (plugin, "vaapipostproc",
+      GST_RANK_PRIMARY, GST_TYPE_VAAPIPOSTPROC);
+
+  gst_element_register (plugin, "vaapipostprocmulti",
+      GST_RANK_NONE, GST_TYPE_VAAPIPOSTPROC_MULTI);
+#endif
+
   if (gst_vaapi_display_has_video_processing (display)) {
-    gst_element_register (plugin, "vaapipostproc",
-        GST_RANK_PRIMARY, GST_TYPE_VAAPIPOSTPROC);
+    gst_element_register (plugin, "vaapicompositor",
+        GST_RANK_NONE, GST_TYPE_VAAPI_COMPOSITOR);
 
     gst_element_register (plugin, "vaapidecodebin",
         GST_RANK_PRIMARY + 2, GST_TYPE_VAAPI_DECODE_BIN);
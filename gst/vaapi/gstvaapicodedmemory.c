@@ -0,0 +1,281 @@
+/*
+ *  gstvaapicodedmemory.c - Gstreamer/VA coded buffer memory
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gstcompat.h"
+#include "gstvaapicodedmemory.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapicodedmemory);
+#define GST_CAT_DEFAULT gst_debug_vaapicodedmemory
+
+/* ------------------------------------------------------------------------ */
+/* --- GstVaapiCodedMemory                                              --- */
+/* ------------------------------------------------------------------------ */
+
+static void
+_init_vaapi_coded_memory_debug (void)
+{
+#ifndef GST_DISABLE_GST_DEBUG
+  static volatile gsize _init = 0;
+
+  if (g_once_init_enter (&_init)) {
+    GST_DEBUG_CATEGORY_INIT (gst_debug_vaapicodedmemory, "vaapicodedmemory", 0,
+        "VA-API coded buffer memory allocator");
+    g_once_init_leave (&_init, 1);
+  }
+#endif
+}
+
+static gpointer
+gst_vaapi_coded_memory_map (GstMemory * base_mem, gsize maxsize,
+    GstMapFlags flags)
+{
+  GstVaapiCodedMemory *const mem = GST_VAAPI_CODED_MEMORY_CAST (base_mem);
+
+  /* The VA coded buffer is mapped for the whole lifetime of the memory */
+  return mem->data;
+}
+
+static void
+gst_vaapi_coded_memory_unmap (GstMemory * base_mem)
+{
+}
+
+static GstMemory *
+gst_vaapi_coded_memory_new (GstAllocator * allocator, GstMemoryFlags flags,
+    GstVaapiEncoder * encoder, GstVaapiCodedBufferProxy * proxy,
+    guint8 * data, gsize maxsize, gsize offset, gsize size)
+{
+  GstVaapiCodedMemory *mem;
+
+  mem = g_slice_new (GstVaapiCodedMemory);
+  if (!mem)
+    return NULL;
+
+  gst_memory_init (&mem->parent_instance, flags, gst_object_ref (allocator),
+      NULL, maxsize, 0, offset, size);
+
+  mem->proxy = gst_vaapi_coded_buffer_proxy_ref (proxy);
+  mem->encoder = encoder ? gst_vaapi_encoder_ref (encoder) : NULL;
+  mem->data = data;
+  return GST_MEMORY_CAST (mem);
+}
+
+static GstMemory *
+gst_vaapi_coded_memory_share (GstMemory * base_mem, gssize offset, gssize size)
+{
+  GstVaapiCodedMemory *const mem = GST_VAAPI_CODED_MEMORY_CAST (base_mem);
+  VACodedBufferSegment *segment_list;
+  GstMemory *out_mem;
+
+  if (size == -1)
+    size = base_mem->size - offset;
+
+  /* The shared memory holds its own reference to the VA mapping */
+  if (!gst_vaapi_coded_buffer_proxy_map (mem->proxy, &segment_list))
+    return NULL;
+
+  out_mem = gst_vaapi_coded_memory_new (base_mem->allocator,
+      GST_MEMORY_FLAG_READONLY, mem->encoder, mem->proxy, mem->data,
+      base_mem->maxsize, base_mem->offset + offset, size);
+  if (!out_mem)
+    gst_vaapi_coded_buffer_proxy_unmap (mem->proxy);
+  return out_mem;
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- GstVaapiCodedAllocator                                           --- */
+/* ------------------------------------------------------------------------ */
+
+G_DEFINE_TYPE (GstVaapiCodedAllocator, gst_vaapi_coded_allocator,
+    GST_TYPE_ALLOCATOR);
+
+static void
+gst_vaapi_coded_allocator_free (GstAllocator * allocator, GstMemory * base_mem)
+{
+  GstVaapiCodedMemory *const mem = GST_VAAPI_CODED_MEMORY_CAST (base_mem);
+
+  /* Releasing the proxy pushes the coded buffer back to its pool and
+     wakes up the encoder, so keep the encoder alive until then */
+  gst_vaapi_coded_buffer_proxy_unmap (mem->proxy);
+  gst_vaapi_coded_buffer_proxy_replace (&mem->proxy, NULL);
+  gst_vaapi_encoder_replace (&mem->encoder, NULL);
+  gst_object_unref (GST_MEMORY_CAST (mem)->allocator);
+  g_slice_free (GstVaapiCodedMemory, mem);
+}
+
+static void
+gst_vaapi_coded_allocator_class_init (GstVaapiCodedAllocatorClass * klass)
+{
+  GstAllocatorClass *const allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+  _init_vaapi_coded_memory_debug ();
+
+  allocator_class->free = gst_vaapi_coded_allocator_free;
+}
+
+static void
+gst_vaapi_coded_allocator_init (GstVaapiCodedAllocator * allocator)
+{
+  GstAllocator *const base_allocator = GST_ALLOCATOR_CAST (allocator);
+
+  base_allocator->mem_type = GST_VAAPI_CODED_MEMORY_NAME;
+  base_allocator->mem_map = gst_vaapi_coded_memory_map;
+  base_allocator->mem_unmap = gst_vaapi_coded_memory_unmap;
+  base_allocator->mem_share = gst_vaapi_coded_memory_share;
+
+  GST_OBJECT_FLAG_SET (allocator, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
+/**
+ * gst_vaapi_coded_allocator_new:
+ * @min_headroom: the minimum number of coded buffers that shall
+ *   remain available in the encoder pool for a new buffer to be
+ *   wrapped
+ *
+ * Creates a new allocator of #GstVaapiCodedMemory objects.
+ *
+ * Returns: the newly allocated #GstAllocator
+ */
+GstAllocator *
+gst_vaapi_coded_allocator_new (guint min_headroom)
+{
+  GstVaapiCodedAllocator *allocator;
+
+  allocator = g_object_new (GST_VAAPI_TYPE_CODED_ALLOCATOR, NULL);
+  if (!allocator)
+    return NULL;
+
+  allocator->min_headroom = min_headroom;
+  return GST_ALLOCATOR_CAST (allocator);
+}
+
+/**
+ * gst_vaapi_coded_allocator_can_wrap:
+ * @allocator: a #GstVaapiCodedAllocator
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Determines whether the coded buffer held in @proxy could be handed
+ * over downstream without copy. Each wrapped buffer keeps one slot of
+ * the encoder coded buffer pool busy until downstream releases it, so
+ * this is only allowed while the pool still has enough headroom for
+ * the encoder to make progress.
+ *
+ * Returns: %TRUE if @proxy can be wrapped, %FALSE if the caller shall
+ *   copy the coded data instead
+ */
+gboolean
+gst_vaapi_coded_allocator_can_wrap (GstAllocator * base_allocator,
+    GstVaapiCodedBufferProxy * proxy)
+{
+  GstVaapiCodedAllocator *const allocator =
+      GST_VAAPI_CODED_ALLOCATOR_CAST (base_allocator);
+  GstVaapiVideoPool *pool;
+  guint num_available;
+
+  g_return_val_if_fail (GST_VAAPI_IS_CODED_ALLOCATOR (allocator), FALSE);
+  g_return_val_if_fail (proxy != NULL, FALSE);
+
+  pool = gst_vaapi_coded_buffer_proxy_get_pool (proxy);
+  if (!pool)
+    return FALSE;
+
+  num_available = gst_vaapi_video_pool_get_num_available (pool);
+  if (num_available < allocator->min_headroom) {
+    GST_LOG_OBJECT (allocator, "coded buffer pool nearly exhausted "
+        "(%u available), falling back to copy", num_available);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_coded_allocator_wrap_buffer:
+ * @allocator: a #GstVaapiCodedAllocator
+ * @encoder: the #GstVaapiEncoder that produced @proxy
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Creates a new #GstBuffer holding one #GstVaapiCodedMemory for each
+ * non-empty segment of the VA coded buffer held in @proxy. The coded
+ * buffer stays mapped, and out of its parent pool, until the last
+ * memory is released.
+ *
+ * Returns: the newly allocated #GstBuffer, or %NULL on error
+ */
+GstBuffer *
+gst_vaapi_coded_allocator_wrap_buffer (GstAllocator * allocator,
+    GstVaapiEncoder * encoder, GstVaapiCodedBufferProxy * proxy)
+{
+  VACodedBufferSegment *segment_list, *segment;
+  GstBuffer *buffer;
+  GstMemory *mem;
+
+  g_return_val_if_fail (GST_VAAPI_IS_CODED_ALLOCATOR (allocator), NULL);
+  g_return_val_if_fail (proxy != NULL, NULL);
+
+  buffer = gst_buffer_new ();
+  if (!buffer)
+    return NULL;
+
+  if (!gst_vaapi_coded_buffer_proxy_map (proxy, &segment_list))
+    goto error_map_buffer;
+
+  for (segment = segment_list; segment != NULL; segment = segment->next) {
+    if (!segment->size)
+      continue;
+
+    /* Each memory holds its own reference to the VA mapping */
+    if (!gst_vaapi_coded_buffer_proxy_map (proxy, &segment_list))
+      goto error_wrap_segment;
+    mem = gst_vaapi_coded_memory_new (allocator, 0, encoder, proxy,
+        segment->buf, segment->size, 0, segment->size);
+    if (!mem) {
+      gst_vaapi_coded_buffer_proxy_unmap (proxy);
+      goto error_wrap_segment;
+    }
+    gst_buffer_append_memory (buffer, mem);
+  }
+  gst_vaapi_coded_buffer_proxy_unmap (proxy);
+
+  if (gst_buffer_n_memory (buffer) == 0)
+    goto error_empty_buffer;
+  return buffer;
+
+  /* ERRORS */
+error_map_buffer:
+  {
+    GST_ERROR_OBJECT (allocator, "failed to map VA coded buffer");
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+error_wrap_segment:
+  {
+    GST_ERROR_OBJECT (allocator, "failed to wrap VA coded buffer segment");
+    gst_vaapi_coded_buffer_proxy_unmap (proxy);
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+error_empty_buffer:
+  {
+    GST_ERROR_OBJECT (allocator, "empty VA coded buffer");
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+}
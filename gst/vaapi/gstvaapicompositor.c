@@ -0,0 +1,1319 @@
+/*
+ *  gstvaapicompositor.c - VA-API video compositor
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:element-vaapicompositor
+ * @short_description: A VA-API video compositor
+ *
+ * vaapicompositor composes the videos of all its requested sink pads
+ * into a single output video, e.g. a mosaic of cameras for a video
+ * wall. Each input is a tile, scaled to the size and blended at the
+ * position given by the properties of its pad, in the order the pads
+ * were requested.
+ *
+ * All the tiles of an output frame are rendered within a single video
+ * processing picture, instead of one scaling pass, copy and
+ * synchronization per tile.
+ *
+ * Inputs are expected to be VA surfaces, at the same frame rate. An
+ * input that runs out of frames, e.g. on EOS, keeps showing its last
+ * one. The output size is the one set on the element, or the bounding
+ * box of all the tiles. The output areas not covered by any tile show
+ * the background colour.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 vaapicompositor name=c sink_1::xpos=640 ! vaapisink \
+ *     filesrc location=a.mp4 ! qtdemux ! vaapidecodebin ! c.sink_0 \
+ *     filesrc location=b.mp4 ! qtdemux ! vaapidecodebin ! c.sink_1
+ * ]|
+ * </refsect2>
+ */
+
+#include "gstcompat.h"
+#include <gst/video/video.h>
+
+#include "gstvaapicompositor.h"
+#include "gstvaapipluginutil.h"
+#include "gstvaapivideobufferpool.h"
+#include "gstvaapivideomemory.h"
+#include "gstvaapivideometa.h"
+
+#define GST_PLUGIN_NAME "vaapicompositor"
+#define GST_PLUGIN_DESC "A VA-API video compositor"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapi_compositor);
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT gst_debug_vaapi_compositor
+#else
+#define GST_CAT_DEFAULT NULL
+#endif
+
+#define DEFAULT_FORMAT          GST_VIDEO_FORMAT_NV12
+#define DEFAULT_SCALE_METHOD    GST_VAAPI_SCALE_METHOD_DEFAULT
+#define DEFAULT_PAD_ALPHA       1.0
+#define DEFAULT_BACKGROUND      0xff000000
+
+/* Default templates */
+/* *INDENT-OFF* */
+static const char gst_vaapi_compositor_sink_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ", "
+  GST_CAPS_INTERLACED_FALSE;
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static const char gst_vaapi_compositor_src_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ", "
+  GST_CAPS_INTERLACED_FALSE;
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_compositor_sink_factory =
+  GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (gst_vaapi_compositor_sink_caps_str));
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_compositor_src_factory =
+  GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (gst_vaapi_compositor_src_caps_str));
+/* *INDENT-ON* */
+
+static void gst_vaapi_compositor_child_proxy_init (gpointer iface,
+    gpointer data);
+
+G_DEFINE_TYPE_WITH_CODE (GstVaapiCompositor, gst_vaapi_compositor,
+    GST_TYPE_ELEMENT, GST_VAAPI_PLUGIN_BASE_INIT_INTERFACES
+    G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY,
+        gst_vaapi_compositor_child_proxy_init));
+
+GST_VAAPI_PLUGIN_BASE_DEFINE_SET_CONTEXT (gst_vaapi_compositor_parent_class);
+
+G_DEFINE_TYPE (GstVaapiCompositorPad, gst_vaapi_compositor_pad, GST_TYPE_PAD);
+
+enum
+{
+  PROP_0,
+
+  PROP_WIDTH,
+  PROP_HEIGHT,
+  PROP_FORMAT,
+  PROP_SCALE_METHOD,
+  PROP_BACKGROUND,
+};
+
+enum
+{
+  PROP_PAD_0,
+
+  PROP_PAD_XPOS,
+  PROP_PAD_YPOS,
+  PROP_PAD_WIDTH,
+  PROP_PAD_HEIGHT,
+  PROP_PAD_ALPHA,
+};
+
+/* ------------------------------------------------------------------------ */
+/* --- Sink pads                                                        --- */
+/* ------------------------------------------------------------------------ */
+
+static void
+sinkpad_reset (GstVaapiCompositorPad * sinkpad)
+{
+  gst_buffer_replace (&sinkpad->buffer, NULL);
+}
+
+static void
+gst_vaapi_compositor_pad_finalize (GObject * object)
+{
+  sinkpad_reset (GST_VAAPI_COMPOSITOR_PAD (object));
+
+  G_OBJECT_CLASS (gst_vaapi_compositor_pad_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapi_compositor_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiCompositorPad *const sinkpad = GST_VAAPI_COMPOSITOR_PAD (object);
+
+  GST_OBJECT_LOCK (sinkpad);
+  switch (prop_id) {
+    case PROP_PAD_XPOS:
+      sinkpad->xpos = g_value_get_uint (value);
+      break;
+    case PROP_PAD_YPOS:
+      sinkpad->ypos = g_value_get_uint (value);
+      break;
+    case PROP_PAD_WIDTH:
+      sinkpad->width = g_value_get_uint (value);
+      break;
+    case PROP_PAD_HEIGHT:
+      sinkpad->height = g_value_get_uint (value);
+      break;
+    case PROP_PAD_ALPHA:
+      sinkpad->alpha = g_value_get_double (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (sinkpad);
+}
+
+static void
+gst_vaapi_compositor_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiCompositorPad *const sinkpad = GST_VAAPI_COMPOSITOR_PAD (object);
+
+  GST_OBJECT_LOCK (sinkpad);
+  switch (prop_id) {
+    case PROP_PAD_XPOS:
+      g_value_set_uint (value, sinkpad->xpos);
+      break;
+    case PROP_PAD_YPOS:
+      g_value_set_uint (value, sinkpad->ypos);
+      break;
+    case PROP_PAD_WIDTH:
+      g_value_set_uint (value, sinkpad->width);
+      break;
+    case PROP_PAD_HEIGHT:
+      g_value_set_uint (value, sinkpad->height);
+      break;
+    case PROP_PAD_ALPHA:
+      g_value_set_double (value, sinkpad->alpha);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (sinkpad);
+}
+
+static void
+gst_vaapi_compositor_pad_class_init (GstVaapiCompositorPadClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gst_vaapi_compositor_pad_finalize;
+  object_class->set_property = gst_vaapi_compositor_pad_set_property;
+  object_class->get_property = gst_vaapi_compositor_pad_get_property;
+
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_XPOS,
+      g_param_spec_uint ("xpos",
+          "X Position",
+          "Horizontal position of the tile in the output",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_YPOS,
+      g_param_spec_uint ("ypos",
+          "Y Position",
+          "Vertical position of the tile in the output",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiCompositorPad:width:
+   *
+   * The width of the tile. If zero, it is the width of the input.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_WIDTH,
+      g_param_spec_uint ("width",
+          "Width",
+          "Width of the tile",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiCompositorPad:height:
+   *
+   * The height of the tile. If zero, it is the height of the input.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_HEIGHT,
+      g_param_spec_uint ("height",
+          "Height",
+          "Height of the tile",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_ALPHA,
+      g_param_spec_double ("alpha",
+          "Alpha",
+          "Global alpha value of the tile",
+          0.0, 1.0, DEFAULT_PAD_ALPHA,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_vaapi_compositor_pad_init (GstVaapiCompositorPad * sinkpad)
+{
+  sinkpad->alpha = DEFAULT_PAD_ALPHA;
+  gst_video_info_init (&sinkpad->info);
+}
+
+/* Determines the region of the output covered by the tile */
+static gboolean
+sinkpad_get_target_rect (GstVaapiCompositorPad * sinkpad,
+    GstVaapiRectangle * target_rect)
+{
+  GST_OBJECT_LOCK (sinkpad);
+  target_rect->x = sinkpad->xpos;
+  target_rect->y = sinkpad->ypos;
+  target_rect->width = sinkpad->width ? sinkpad->width :
+      GST_VIDEO_INFO_WIDTH (&sinkpad->info);
+  target_rect->height = sinkpad->height ? sinkpad->height :
+      GST_VIDEO_INFO_HEIGHT (&sinkpad->info);
+  GST_OBJECT_UNLOCK (sinkpad);
+  return target_rect->width > 0 && target_rect->height > 0;
+}
+
+/* Determines the region of the input surface to compose */
+static void
+sinkpad_get_crop_rect (GstVaapiCompositorPad * sinkpad,
+    GstVaapiVideoMeta * meta, GstVaapiRectangle * crop_rect)
+{
+  const GstVideoCropMeta *const crop_meta =
+      gst_buffer_get_video_crop_meta (sinkpad->buffer);
+  const GstVaapiRectangle *const render_rect =
+      gst_vaapi_video_meta_get_render_rect (meta);
+
+  if (crop_meta) {
+    crop_rect->x = crop_meta->x;
+    crop_rect->y = crop_meta->y;
+    crop_rect->width = crop_meta->width;
+    crop_rect->height = crop_meta->height;
+  } else if (render_rect)
+    *crop_rect = *render_rect;
+  else {
+    crop_rect->x = 0;
+    crop_rect->y = 0;
+    crop_rect->width = GST_VIDEO_INFO_WIDTH (&sinkpad->info);
+    crop_rect->height = GST_VIDEO_INFO_HEIGHT (&sinkpad->info);
+  }
+}
+
+/* Clips the tile to the output, cropping the input accordingly */
+static gboolean
+clip_tile (GstVaapiRectangle * crop_rect, GstVaapiRectangle * target_rect,
+    guint width, guint height)
+{
+  guint visible;
+
+  if (target_rect->x >= width || target_rect->y >= height)
+    return FALSE;
+
+  if (target_rect->x + target_rect->width > width) {
+    visible = width - target_rect->x;
+    crop_rect->width = gst_util_uint64_scale_int (crop_rect->width, visible,
+        target_rect->width);
+    target_rect->width = visible;
+  }
+  if (target_rect->y + target_rect->height > height) {
+    visible = height - target_rect->y;
+    crop_rect->height = gst_util_uint64_scale_int (crop_rect->height,
+        visible, target_rect->height);
+    target_rect->height = visible;
+  }
+  return crop_rect->width > 0 && crop_rect->height > 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- Output                                                           --- */
+/* ------------------------------------------------------------------------ */
+
+static gboolean
+gst_vaapi_compositor_ensure_filter (GstVaapiCompositor * compositor)
+{
+  if (compositor->filter)
+    return TRUE;
+
+  if (!gst_vaapi_plugin_base_ensure_display (GST_VAAPI_PLUGIN_BASE
+          (compositor)))
+    return FALSE;
+
+  compositor->filter =
+      gst_vaapi_filter_new (GST_VAAPI_PLUGIN_BASE_DISPLAY (compositor));
+  if (!compositor->filter)
+    return FALSE;
+  return gst_vaapi_filter_set_scaling (compositor->filter,
+      compositor->scale_method);
+}
+
+/* Retrieves the sink pads, each with an extra reference */
+static GList *
+get_sinkpads (GstVaapiCompositor * compositor)
+{
+  GList *sinkpads;
+
+  GST_OBJECT_LOCK (compositor);
+  sinkpads = g_list_copy_deep (GST_ELEMENT (compositor)->sinkpads,
+      (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (compositor);
+  return sinkpads;
+}
+
+/* Determines the output size, or the bounding box of all the tiles,
+   and the output frame rate, from the first negotiated input */
+static gboolean
+get_video_info (GstVaapiCompositor * compositor, GList * sinkpads,
+    GstVideoInfo * vip)
+{
+  GstVaapiRectangle target_rect;
+  GstVideoFormat format;
+  guint width, height, bbox_width = 0, bbox_height = 0;
+  gint fps_n = 0, fps_d = 1;
+  GList *l;
+
+  for (l = sinkpads; l; l = l->next) {
+    GstVaapiCompositorPad *const sinkpad = l->data;
+
+    if (GST_VIDEO_INFO_FORMAT (&sinkpad->info) == GST_VIDEO_FORMAT_UNKNOWN)
+      continue;
+    if (fps_n == 0) {
+      fps_n = GST_VIDEO_INFO_FPS_N (&sinkpad->info);
+      fps_d = GST_VIDEO_INFO_FPS_D (&sinkpad->info);
+    }
+    if (!sinkpad_get_target_rect (sinkpad, &target_rect))
+      continue;
+    bbox_width = MAX (bbox_width, target_rect.x + target_rect.width);
+    bbox_height = MAX (bbox_height, target_rect.y + target_rect.height);
+  }
+
+  GST_OBJECT_LOCK (compositor);
+  width = compositor->width ? compositor->width : bbox_width;
+  height = compositor->height ? compositor->height : bbox_height;
+  format = compositor->format;
+  GST_OBJECT_UNLOCK (compositor);
+  if (!width || !height)
+    return FALSE;
+
+  gst_video_info_set_format (vip, format, width, height);
+  GST_VIDEO_INFO_FPS_N (vip) = fps_n;
+  GST_VIDEO_INFO_FPS_D (vip) = fps_d;
+  return TRUE;
+}
+
+static GstBufferPool *
+create_buffer_pool (GstVaapiCompositor * compositor, GstCaps * caps)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (compositor);
+  GstBufferPool *pool;
+  GstAllocator *allocator;
+  GstStructure *config;
+
+  allocator = gst_vaapi_video_allocator_new (display, &compositor->info, 0,
+      GST_VAAPI_IMAGE_USAGE_FLAG_NATIVE_FORMATS);
+  if (!allocator)
+    return NULL;
+
+  pool = gst_vaapi_video_buffer_pool_new (display);
+  if (!pool)
+    goto cleanup;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps,
+      GST_VIDEO_INFO_SIZE (&compositor->info), 0, 0);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_VAAPI_VIDEO_META);
+  gst_buffer_pool_config_set_allocator (config, allocator, NULL);
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE))
+    gst_object_replace ((GstObject **) & pool, NULL);
+
+cleanup:
+  gst_object_unref (allocator);
+  return pool;
+}
+
+static void
+reset_output (GstVaapiCompositor * compositor)
+{
+  if (compositor->buffer_pool) {
+    gst_buffer_pool_set_active (compositor->buffer_pool, FALSE);
+    gst_object_unref (compositor->buffer_pool);
+    compositor->buffer_pool = NULL;
+  }
+  gst_vaapi_video_pool_replace (&compositor->surface_pool, NULL);
+  gst_vaapi_object_replace (&compositor->background_surface, NULL);
+  gst_video_info_init (&compositor->info);
+}
+
+/* Negotiates the output caps, and sets up the pools the output is
+   allocated from. This is checked on every frame, as the tiles may
+   be moved or resized at any time */
+static gboolean
+ensure_caps (GstVaapiCompositor * compositor, GList * sinkpads)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (compositor);
+  GstPad *const srcpad = GST_VAAPI_PLUGIN_BASE_SRC_PAD (compositor);
+  GstVideoInfo vi;
+  GstCaps *caps;
+
+  if (!get_video_info (compositor, sinkpads, &vi))
+    goto error_invalid_size;
+
+  if (compositor->buffer_pool &&
+      !gst_video_info_changed (&compositor->info, &vi) &&
+      GST_VIDEO_INFO_FPS_N (&compositor->info) == GST_VIDEO_INFO_FPS_N (&vi) &&
+      GST_VIDEO_INFO_FPS_D (&compositor->info) == GST_VIDEO_INFO_FPS_D (&vi))
+    return TRUE;
+
+  reset_output (compositor);
+  compositor->info = vi;
+
+  caps = gst_video_info_to_caps (&vi);
+  if (!caps)
+    goto error_invalid_size;
+  gst_caps_set_features (caps, 0,
+      gst_caps_features_new (GST_CAPS_FEATURE_MEMORY_VAAPI_SURFACE, NULL));
+  GST_INFO_OBJECT (compositor, "new output caps %" GST_PTR_FORMAT, caps);
+
+  compositor->surface_pool = gst_vaapi_surface_pool_new_full (display, &vi,
+      0);
+  if (compositor->surface_pool)
+    compositor->buffer_pool = create_buffer_pool (compositor, caps);
+
+  gst_pad_push_event (srcpad, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  if (!compositor->buffer_pool)
+    goto error_create_pool;
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_size:
+  {
+    GST_ELEMENT_ERROR (compositor, CORE, NEGOTIATION,
+        ("invalid output size"), (NULL));
+    return FALSE;
+  }
+error_create_pool:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to create output pools");
+    reset_output (compositor);
+    return FALSE;
+  }
+}
+
+static void
+ensure_stream_start (GstVaapiCompositor * compositor)
+{
+  GstPad *const srcpad = GST_VAAPI_PLUGIN_BASE_SRC_PAD (compositor);
+  gchar *stream_id;
+
+  if (!compositor->need_stream_start)
+    return;
+  compositor->need_stream_start = FALSE;
+
+  stream_id = gst_pad_create_stream_id (srcpad, GST_ELEMENT (compositor),
+      NULL);
+  gst_pad_push_event (srcpad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+}
+
+/* The output is timestamped in running time, as the inputs may come
+   from different segments */
+static void
+ensure_segment (GstVaapiCompositor * compositor)
+{
+  GstSegment segment;
+
+  if (!compositor->need_segment)
+    return;
+  compositor->need_segment = FALSE;
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (GST_VAAPI_PLUGIN_BASE_SRC_PAD (compositor),
+      gst_event_new_segment (&segment));
+}
+
+/* Fills @image with @color, given as ARGB, through the pack function
+   of the image format */
+static gboolean
+fill_image (GstVaapiImage * image, guint32 color)
+{
+  const GstVideoFormatInfo *const finfo =
+      gst_video_format_get_info (gst_vaapi_image_get_format (image));
+  const guint width = gst_vaapi_image_get_width (image);
+  const guint height = gst_vaapi_image_get_height (image);
+  const gint a = (color >> 24) & 0xff;
+  const gint r = (color >> 16) & 0xff;
+  const gint g = (color >> 8) & 0xff;
+  const gint b = color & 0xff;
+  gpointer planes[GST_VIDEO_MAX_PLANES] = { NULL, };
+  gint strides[GST_VIDEO_MAX_PLANES] = { 0, };
+  guint8 comps[4];
+  gpointer line;
+  guint i, x, y, num_planes;
+  gboolean is_16bit;
+
+  if (!finfo)
+    return FALSE;
+
+  switch (finfo->unpack_format) {
+    case GST_VIDEO_FORMAT_AYUV:
+    case GST_VIDEO_FORMAT_AYUV64:
+      /* BT.601, limited range */
+      comps[0] = a;
+      comps[1] = 16 + ((66 * r + 129 * g + 25 * b + 128) >> 8);
+      comps[2] = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+      comps[3] = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+      break;
+    case GST_VIDEO_FORMAT_ARGB:
+    case GST_VIDEO_FORMAT_ARGB64:
+      comps[0] = a;
+      comps[1] = r;
+      comps[2] = g;
+      comps[3] = b;
+      break;
+    default:
+      return FALSE;
+  }
+  is_16bit = finfo->unpack_format == GST_VIDEO_FORMAT_AYUV64 ||
+      finfo->unpack_format == GST_VIDEO_FORMAT_ARGB64;
+
+  /* One extra pixel, for the formats that pack pixel pairs */
+  line = g_malloc ((width + 1) * (is_16bit ? 8 : 4));
+  for (x = 0; x <= width; x++) {
+    for (i = 0; i < 4; i++) {
+      if (is_16bit)
+        ((guint16 *) line)[x * 4 + i] = (comps[i] << 8) | comps[i];
+      else
+        ((guint8 *) line)[x * 4 + i] = comps[i];
+    }
+  }
+
+  if (!gst_vaapi_image_map (image)) {
+    g_free (line);
+    return FALSE;
+  }
+  num_planes = gst_vaapi_image_get_plane_count (image);
+  for (i = 0; i < num_planes && i < GST_VIDEO_MAX_PLANES; i++) {
+    planes[i] = gst_vaapi_image_get_plane (image, i);
+    strides[i] = gst_vaapi_image_get_pitch (image, i);
+  }
+  for (y = 0; y < height; y++)
+    finfo->pack_func (finfo, GST_VIDEO_PACK_FLAG_NONE, line, 0, planes,
+        strides, GST_VIDEO_CHROMA_SITE_UNKNOWN, y, width);
+  gst_vaapi_image_unmap (image);
+  g_free (line);
+  return TRUE;
+}
+
+/* Makes sure the background surface, a full output frame of the
+   background colour, is up-to-date. It is blitted first on every
+   output frame, as pooled surfaces hold the pixels of a previous
+   frame and drivers do not reliably apply the VPP background colour
+   to the areas outside of the blended tiles */
+static gboolean
+ensure_background (GstVaapiCompositor * compositor)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (compositor);
+  const GstVideoFormat format = GST_VIDEO_INFO_FORMAT (&compositor->info);
+  const guint width = GST_VIDEO_INFO_WIDTH (&compositor->info);
+  const guint height = GST_VIDEO_INFO_HEIGHT (&compositor->info);
+  GstVaapiSurface *surface = NULL;
+  GstVaapiImage *image;
+  guint32 color;
+  gboolean success = FALSE;
+
+  GST_OBJECT_LOCK (compositor);
+  color = compositor->background;
+  GST_OBJECT_UNLOCK (compositor);
+
+  if (compositor->background_surface &&
+      compositor->background_surface_color == color)
+    return TRUE;
+  gst_vaapi_object_replace (&compositor->background_surface, NULL);
+
+  image = gst_vaapi_image_new (display, format, width, height);
+  if (!image)
+    goto error_create_image;
+  if (!fill_image (image, color))
+    goto error_fill_image;
+
+  surface = gst_vaapi_surface_new_with_format (display, format, width,
+      height);
+  if (!surface || !gst_vaapi_surface_put_image (surface, image))
+    goto error_upload_image;
+
+  compositor->background_surface = surface;
+  compositor->background_surface_color = color;
+  surface = NULL;
+  success = TRUE;
+
+cleanup:
+  gst_vaapi_object_replace (&surface, NULL);
+  gst_vaapi_object_replace (&image, NULL);
+  return success;
+
+  /* ERRORS */
+error_create_image:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to create %s background image",
+        gst_video_format_to_string (format));
+    return FALSE;
+  }
+error_fill_image:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to fill %s background image",
+        gst_video_format_to_string (format));
+    goto cleanup;
+  }
+error_upload_image:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to upload background image");
+    goto cleanup;
+  }
+}
+
+/* Fills in the composition entries of the tiles that have a frame.
+   Returns the number of entries */
+static guint
+fill_blend_surfaces (GstVaapiCompositor * compositor, GList * sinkpads,
+    GstVaapiBlendSurface * blend_surfaces, GstVaapiRectangle * crop_rects)
+{
+  const guint width = GST_VIDEO_INFO_WIDTH (&compositor->info);
+  const guint height = GST_VIDEO_INFO_HEIGHT (&compositor->info);
+  GstVaapiVideoMeta *meta;
+  GList *l;
+  guint n = 0;
+
+  for (l = sinkpads; l; l = l->next) {
+    GstVaapiCompositorPad *const sinkpad = l->data;
+    GstVaapiBlendSurface *const blend = &blend_surfaces[n];
+
+    if (!sinkpad->buffer)
+      continue;
+    meta = gst_buffer_get_vaapi_video_meta (sinkpad->buffer);
+    if (!meta)
+      continue;
+
+    sinkpad_get_crop_rect (sinkpad, meta, &crop_rects[n]);
+    if (!sinkpad_get_target_rect (sinkpad, &blend->target) ||
+        !clip_tile (&crop_rects[n], &blend->target, width, height))
+      continue;
+
+    blend->surface = gst_vaapi_video_meta_get_surface (meta);
+    blend->crop = &crop_rects[n];
+    GST_OBJECT_LOCK (sinkpad);
+    blend->alpha = sinkpad->alpha;
+    GST_OBJECT_UNLOCK (sinkpad);
+    n++;
+  }
+  return n;
+}
+
+static GstFlowReturn
+compose (GstVaapiCompositor * compositor, GList * sinkpads,
+    GstClockTime pts, GstClockTime duration)
+{
+  const guint num_sinkpads = g_list_length (sinkpads);
+  GstVaapiBlendSurface *blend_surfaces;
+  GstVaapiRectangle *crop_rects;
+  GstVaapiVideoMeta *outbuf_meta;
+  GstVaapiSurfaceProxy *proxy;
+  GstVaapiFilterStatus status;
+  GstBuffer *outbuf = NULL;
+  guint num_surfaces;
+
+  /* The background comes first, below all the tiles */
+  blend_surfaces = g_newa (GstVaapiBlendSurface, num_sinkpads + 1);
+  crop_rects = g_newa (GstVaapiRectangle, num_sinkpads);
+  num_surfaces = fill_blend_surfaces (compositor, sinkpads,
+      &blend_surfaces[1], crop_rects);
+  if (num_surfaces == 0)
+    return GST_FLOW_OK;
+
+  if (!ensure_background (compositor))
+    return GST_FLOW_ERROR;
+  blend_surfaces[0].surface = compositor->background_surface;
+  blend_surfaces[0].crop = NULL;
+  blend_surfaces[0].target.x = 0;
+  blend_surfaces[0].target.y = 0;
+  blend_surfaces[0].target.width = GST_VIDEO_INFO_WIDTH (&compositor->info);
+  blend_surfaces[0].target.height = GST_VIDEO_INFO_HEIGHT (&compositor->info);
+  blend_surfaces[0].alpha = 1.0;
+  num_surfaces++;
+
+  if (gst_buffer_pool_acquire_buffer (compositor->buffer_pool, &outbuf,
+          NULL) != GST_FLOW_OK)
+    goto error_create_buffer;
+
+  outbuf_meta = gst_buffer_get_vaapi_video_meta (outbuf);
+  if (!outbuf_meta)
+    goto error_create_meta;
+
+  proxy = gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
+      (compositor->surface_pool));
+  if (!proxy)
+    goto error_create_proxy;
+  gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
+  gst_vaapi_surface_proxy_unref (proxy);
+
+  status = gst_vaapi_filter_compose (compositor->filter, blend_surfaces,
+      num_surfaces, gst_vaapi_video_meta_get_surface (outbuf_meta));
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    goto error_process_vpp;
+
+  GST_BUFFER_PTS (outbuf) = pts;
+  GST_BUFFER_DURATION (outbuf) = duration;
+  return gst_pad_push (GST_VAAPI_PLUGIN_BASE_SRC_PAD (compositor), outbuf);
+
+  /* ERRORS */
+error_create_buffer:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to create output buffer");
+    return GST_FLOW_ERROR;
+  }
+error_create_meta:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to create new output buffer meta");
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+error_create_proxy:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to create surface proxy from pool");
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+error_process_vpp:
+  {
+    GST_ERROR_OBJECT (compositor, "failed to compose %u tiles (error %d)",
+        num_surfaces, status);
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* Called by the collect pads once all the inputs that did not reach
+   EOS have a frame */
+static GstFlowReturn
+gst_vaapi_compositor_collected (GstCollectPads * pads, gpointer user_data)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (user_data);
+  GstClockTime pts = GST_CLOCK_TIME_NONE, duration = GST_CLOCK_TIME_NONE;
+  GstClockTime running_time;
+  GstFlowReturn ret;
+  GList *sinkpads, *l;
+  gboolean eos = TRUE;
+
+  sinkpads = get_sinkpads (compositor);
+  for (l = sinkpads; l; l = l->next) {
+    GstVaapiCompositorPad *const sinkpad = l->data;
+    GstBuffer *buf;
+
+    buf = gst_collect_pads_pop (pads, sinkpad->collect);
+    if (!buf)
+      continue;
+    eos = FALSE;
+
+    running_time = gst_segment_to_running_time (&sinkpad->collect->segment,
+        GST_FORMAT_TIME, GST_BUFFER_PTS (buf));
+    if (GST_CLOCK_TIME_IS_VALID (running_time) &&
+        (!GST_CLOCK_TIME_IS_VALID (pts) || running_time < pts))
+      pts = running_time;
+    if (!GST_CLOCK_TIME_IS_VALID (duration))
+      duration = GST_BUFFER_DURATION (buf);
+    gst_buffer_replace (&sinkpad->buffer, buf);
+    gst_buffer_unref (buf);
+  }
+
+  if (eos) {
+    GST_DEBUG_OBJECT (compositor, "all inputs reached EOS");
+    gst_pad_push_event (GST_VAAPI_PLUGIN_BASE_SRC_PAD (compositor),
+        gst_event_new_eos ());
+    ret = GST_FLOW_EOS;
+    goto done;
+  }
+
+  ensure_stream_start (compositor);
+  if (!ensure_caps (compositor, sinkpads)) {
+    ret = GST_FLOW_NOT_NEGOTIATED;
+    goto done;
+  }
+  ensure_segment (compositor);
+
+  if (GST_VIDEO_INFO_FPS_N (&compositor->info) > 0)
+    duration = gst_util_uint64_scale_int (GST_SECOND,
+        GST_VIDEO_INFO_FPS_D (&compositor->info),
+        GST_VIDEO_INFO_FPS_N (&compositor->info));
+
+  ret = compose (compositor, sinkpads, pts, duration);
+
+done:
+  g_list_free_full (sinkpads, gst_object_unref);
+  return ret;
+}
+
+static gboolean
+gst_vaapi_compositor_sink_event (GstCollectPads * pads, GstCollectData * data,
+    GstEvent * event, gpointer user_data)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (user_data);
+  GstVaapiCompositorPad *const sinkpad = GST_VAAPI_COMPOSITOR_PAD (data->pad);
+  GstCaps *caps;
+  GstVideoInfo vi;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+      /* The output caps are negotiated again on the next frame */
+      gst_event_parse_caps (event, &caps);
+      if (!gst_video_info_from_caps (&vi, caps)) {
+        gst_event_unref (event);
+        return FALSE;
+      }
+      sinkpad->info = vi;
+      gst_event_unref (event);
+      return TRUE;
+    case GST_EVENT_FLUSH_STOP:
+      sinkpad_reset (sinkpad);
+      compositor->need_segment = TRUE;
+      break;
+    default:
+      break;
+  }
+  return gst_collect_pads_event_default (pads, data, event, FALSE);
+}
+
+static gboolean
+gst_vaapi_compositor_sink_query (GstCollectPads * pads, GstCollectData * data,
+    GstQuery * query, gpointer user_data)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (user_data);
+  GstCaps *caps, *filter;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CONTEXT:
+      if (gst_vaapi_handle_context_query (GST_ELEMENT (compositor), query))
+        return TRUE;
+      break;
+    case GST_QUERY_CAPS:
+      /* Each tile is scaled, so inputs are only bound to the template */
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (data->pad);
+      if (filter) {
+        GstCaps *const tmp_caps = caps;
+        caps = gst_caps_intersect_full (filter, tmp_caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (tmp_caps);
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    default:
+      break;
+  }
+  return gst_collect_pads_query_default (pads, data, query, FALSE);
+}
+
+static gboolean
+gst_vaapi_compositor_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  if (GST_QUERY_TYPE (query) == GST_QUERY_CONTEXT &&
+      gst_vaapi_handle_context_query (GST_ELEMENT (parent), query))
+    return TRUE;
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+gst_vaapi_compositor_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (parent);
+
+  return gst_collect_pads_src_event_default (compositor->collect, pad, event);
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- Element                                                          --- */
+/* ------------------------------------------------------------------------ */
+
+static GstPad *
+gst_vaapi_compositor_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (element);
+  GstVaapiCompositorPad *sinkpad;
+  gchar *pad_name;
+
+  GST_OBJECT_LOCK (compositor);
+  if (name && sscanf (name, "sink_%u", &compositor->next_pad_id) == 1)
+    pad_name = g_strdup (name);
+  else
+    pad_name = g_strdup_printf ("sink_%u", compositor->next_pad_id);
+  compositor->next_pad_id++;
+  GST_OBJECT_UNLOCK (compositor);
+
+  sinkpad = g_object_new (GST_TYPE_VAAPI_COMPOSITOR_PAD, "name", pad_name,
+      "direction", GST_PAD_SINK, "template", templ, NULL);
+  g_free (pad_name);
+
+  sinkpad->collect = gst_collect_pads_add_pad (compositor->collect,
+      GST_PAD_CAST (sinkpad), sizeof (GstCollectData), NULL, TRUE);
+
+  if (!gst_element_add_pad (element, GST_PAD_CAST (sinkpad))) {
+    gst_collect_pads_remove_pad (compositor->collect, GST_PAD_CAST (sinkpad));
+    gst_object_unref (sinkpad);
+    return NULL;
+  }
+  gst_child_proxy_child_added (GST_CHILD_PROXY (element), G_OBJECT (sinkpad),
+      GST_OBJECT_NAME (sinkpad));
+  return GST_PAD_CAST (sinkpad);
+}
+
+static void
+gst_vaapi_compositor_release_pad (GstElement * element, GstPad * pad)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (element);
+
+  gst_child_proxy_child_removed (GST_CHILD_PROXY (element), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+  gst_collect_pads_remove_pad (compositor->collect, pad);
+  gst_element_remove_pad (element, pad);
+}
+
+static void
+reset_sinkpads (GstVaapiCompositor * compositor)
+{
+  GList *sinkpads;
+
+  sinkpads = get_sinkpads (compositor);
+  g_list_foreach (sinkpads, (GFunc) sinkpad_reset, NULL);
+  g_list_free_full (sinkpads, gst_object_unref);
+}
+
+static void
+gst_vaapi_compositor_destroy (GstVaapiCompositor * compositor)
+{
+  reset_sinkpads (compositor);
+  reset_output (compositor);
+  gst_vaapi_filter_replace (&compositor->filter, NULL);
+  gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (compositor));
+}
+
+static GstStateChangeReturn
+gst_vaapi_compositor_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!gst_vaapi_plugin_base_open (GST_VAAPI_PLUGIN_BASE (compositor)))
+        return GST_STATE_CHANGE_FAILURE;
+      if (!gst_vaapi_compositor_ensure_filter (compositor))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      compositor->need_stream_start = TRUE;
+      compositor->need_segment = TRUE;
+      gst_collect_pads_start (compositor->collect);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* Unblocks the streaming threads waiting for the other inputs */
+      gst_collect_pads_stop (compositor->collect);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_vaapi_compositor_parent_class)->change_state
+      (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      reset_sinkpads (compositor);
+      reset_output (compositor);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      gst_vaapi_compositor_destroy (compositor);
+      break;
+    default:
+      break;
+  }
+  return ret;
+}
+
+static void
+gst_vaapi_compositor_finalize (GObject * object)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (object);
+
+  gst_vaapi_compositor_destroy (compositor);
+  gst_object_unref (compositor->collect);
+  gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (compositor));
+  G_OBJECT_CLASS (gst_vaapi_compositor_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapi_compositor_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (object);
+
+  switch (prop_id) {
+    case PROP_WIDTH:
+      GST_OBJECT_LOCK (compositor);
+      compositor->width = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    case PROP_HEIGHT:
+      GST_OBJECT_LOCK (compositor);
+      compositor->height = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    case PROP_FORMAT:
+      GST_OBJECT_LOCK (compositor);
+      compositor->format = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    case PROP_SCALE_METHOD:
+      compositor->scale_method = g_value_get_enum (value);
+      if (compositor->filter)
+        gst_vaapi_filter_set_scaling (compositor->filter,
+            compositor->scale_method);
+      break;
+    case PROP_BACKGROUND:
+      GST_OBJECT_LOCK (compositor);
+      compositor->background = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_compositor_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiCompositor *const compositor = GST_VAAPI_COMPOSITOR (object);
+
+  switch (prop_id) {
+    case PROP_WIDTH:
+      GST_OBJECT_LOCK (compositor);
+      g_value_set_uint (value, compositor->width);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    case PROP_HEIGHT:
+      GST_OBJECT_LOCK (compositor);
+      g_value_set_uint (value, compositor->height);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    case PROP_FORMAT:
+      GST_OBJECT_LOCK (compositor);
+      g_value_set_enum (value, compositor->format);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    case PROP_SCALE_METHOD:
+      g_value_set_enum (value, compositor->scale_method);
+      break;
+    case PROP_BACKGROUND:
+      GST_OBJECT_LOCK (compositor);
+      g_value_set_uint (value, compositor->background);
+      GST_OBJECT_UNLOCK (compositor);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_compositor_class_init (GstVaapiCompositorClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_vaapi_compositor,
+      GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
+
+  gst_vaapi_plugin_base_class_init (GST_VAAPI_PLUGIN_BASE_CLASS (klass));
+
+  object_class->finalize = gst_vaapi_compositor_finalize;
+  object_class->set_property = gst_vaapi_compositor_set_property;
+  object_class->get_property = gst_vaapi_compositor_get_property;
+
+  element_class->change_state = gst_vaapi_compositor_change_state;
+  element_class->request_new_pad = gst_vaapi_compositor_request_new_pad;
+  element_class->release_pad = gst_vaapi_compositor_release_pad;
+  element_class->set_context = gst_vaapi_base_set_context;
+  gst_element_class_set_static_metadata (element_class,
+      "VA-API video compositor",
+      "Filter/Editor/Video/Compositor",
+      GST_PLUGIN_DESC, "Intel Corporation");
+
+  /* sink pads */
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaapi_compositor_sink_factory);
+
+  /* src pad */
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaapi_compositor_src_factory);
+
+  /**
+   * GstVaapiCompositor:width:
+   *
+   * The width of the output. If zero, it is the width of the bounding
+   * box of all the tiles.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_WIDTH,
+      g_param_spec_uint ("width",
+          "Width",
+          "Output width",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiCompositor:height:
+   *
+   * The height of the output. If zero, it is the height of the
+   * bounding box of all the tiles.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_HEIGHT,
+      g_param_spec_uint ("height",
+          "Height",
+          "Output height",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_FORMAT,
+      g_param_spec_enum ("format",
+          "Format",
+          "Output pixel format",
+          GST_TYPE_VIDEO_FORMAT,
+          DEFAULT_FORMAT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_SCALE_METHOD,
+      g_param_spec_enum ("scale-method",
+          "Scale method",
+          "Scaling method to use",
+          GST_VAAPI_TYPE_SCALE_METHOD,
+          DEFAULT_SCALE_METHOD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiCompositor:background:
+   *
+   * The colour of the output areas not covered by any tile, as ARGB.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_BACKGROUND,
+      g_param_spec_uint ("background",
+          "Background",
+          "Background colour as ARGB",
+          0, G_MAXUINT32, DEFAULT_BACKGROUND,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_vaapi_compositor_init (GstVaapiCompositor * compositor)
+{
+  GstPad *srcpad;
+
+  srcpad = gst_pad_new_from_static_template
+      (&gst_vaapi_compositor_src_factory, "src");
+  gst_pad_set_query_function (srcpad, gst_vaapi_compositor_src_query);
+  gst_pad_set_event_function (srcpad, gst_vaapi_compositor_src_event);
+  gst_pad_use_fixed_caps (srcpad);
+  gst_element_add_pad (GST_ELEMENT (compositor), srcpad);
+
+  gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (compositor),
+      GST_CAT_DEFAULT);
+
+  compositor->collect = gst_collect_pads_new ();
+  gst_collect_pads_set_function (compositor->collect,
+      gst_vaapi_compositor_collected, compositor);
+  gst_collect_pads_set_event_function (compositor->collect,
+      gst_vaapi_compositor_sink_event, compositor);
+  gst_collect_pads_set_query_function (compositor->collect,
+      gst_vaapi_compositor_sink_query, compositor);
+
+  compositor->format = DEFAULT_FORMAT;
+  compositor->scale_method = DEFAULT_SCALE_METHOD;
+  compositor->background = DEFAULT_BACKGROUND;
+  gst_video_info_init (&compositor->info);
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- GstChildProxy interface                                          --- */
+/* ------------------------------------------------------------------------ */
+
+static GObject *
+gst_vaapi_compositor_child_proxy_get_child_by_index (GstChildProxy * proxy,
+    guint index)
+{
+  GObject *child;
+
+  GST_OBJECT_LOCK (proxy);
+  child = g_list_nth_data (GST_ELEMENT_CAST (proxy)->sinkpads, index);
+  if (child)
+    gst_object_ref (child);
+  GST_OBJECT_UNLOCK (proxy);
+  return child;
+}
+
+static guint
+gst_vaapi_compositor_child_proxy_get_children_count (GstChildProxy * proxy)
+{
+  guint count;
+
+  GST_OBJECT_LOCK (proxy);
+  count = GST_ELEMENT_CAST (proxy)->numsinkpads;
+  GST_OBJECT_UNLOCK (proxy);
+  return count;
+}
+
+static void
+gst_vaapi_compositor_child_proxy_init (gpointer iface, gpointer data)
+{
+  GstChildProxyInterface *const proxy_iface = iface;
+
+  proxy_iface->get_child_by_index =
+      gst_vaapi_compositor_child_proxy_get_child_by_index;
+  proxy_iface->get_children_count =
+      gst_vaapi_compositor_child_proxy_get_children_count;
+}
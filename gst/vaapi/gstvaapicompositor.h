@@ -0,0 +1,135 @@
+/*
+ *  gstvaapicompositor.h - VA-API video compositor
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#ifndef GST_VAAPI_COMPOSITOR_H
+#define GST_VAAPI_COMPOSITOR_H
+
+#include "gstvaapipluginbase.h"
+#include <gst/base/gstcollectpads.h>
+#include <gst/vaapi/gstvaapisurfacepool.h>
+#include <gst/vaapi/gstvaapifilter.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAAPI_COMPOSITOR \
+  (gst_vaapi_compositor_get_type ())
+#define GST_VAAPI_COMPOSITOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_COMPOSITOR, \
+       GstVaapiCompositor))
+#define GST_VAAPI_COMPOSITOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_VAAPI_COMPOSITOR, \
+       GstVaapiCompositorClass))
+#define GST_IS_VAAPI_COMPOSITOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPI_COMPOSITOR))
+#define GST_IS_VAAPI_COMPOSITOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_VAAPI_COMPOSITOR))
+#define GST_VAAPI_COMPOSITOR_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_VAAPI_COMPOSITOR, \
+       GstVaapiCompositorClass))
+
+#define GST_TYPE_VAAPI_COMPOSITOR_PAD \
+  (gst_vaapi_compositor_pad_get_type ())
+#define GST_VAAPI_COMPOSITOR_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_COMPOSITOR_PAD, \
+       GstVaapiCompositorPad))
+#define GST_IS_VAAPI_COMPOSITOR_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPI_COMPOSITOR_PAD))
+
+typedef struct _GstVaapiCompositor GstVaapiCompositor;
+typedef struct _GstVaapiCompositorClass GstVaapiCompositorClass;
+typedef struct _GstVaapiCompositorPad GstVaapiCompositorPad;
+typedef struct _GstVaapiCompositorPadClass GstVaapiCompositorPadClass;
+
+/*
+ * GstVaapiCompositorPad:
+ * @xpos: the horizontal position of the tile in the output
+ * @ypos: the vertical position of the tile in the output
+ * @width: the width of the tile, or 0 for the input width
+ * @height: the height of the tile, or 0 for the input height
+ * @alpha: the global alpha value of the tile
+ * @collect: the #GstCollectData of the pad
+ * @info: the negotiated input video info
+ * @buffer: the last input buffer, composed until a new one arrives
+ *
+ * A sink pad of vaapicompositor, carrying one tile of the output
+ * video. The properties are protected by the object lock, the
+ * negotiated state is only used from the streaming thread.
+ */
+struct _GstVaapiCompositorPad
+{
+  /*< private >*/
+  GstPad parent_instance;
+
+  guint xpos;
+  guint ypos;
+  guint width;
+  guint height;
+  gdouble alpha;
+
+  GstCollectData *collect;
+  GstVideoInfo info;
+  GstBuffer *buffer;
+};
+
+struct _GstVaapiCompositorPadClass
+{
+  /*< private >*/
+  GstPadClass parent_class;
+};
+
+struct _GstVaapiCompositor
+{
+  /*< private >*/
+  GstVaapiPluginBase parent_instance;
+
+  GstCollectPads *collect;
+  GstVaapiFilter *filter;
+  GstVaapiScaleMethod scale_method;
+  guint width;
+  guint height;
+  GstVideoFormat format;
+  guint32 background;
+  guint next_pad_id;
+
+  gboolean need_stream_start;
+  gboolean need_segment;
+  GstVideoInfo info;
+  GstVaapiVideoPool *surface_pool;
+  GstBufferPool *buffer_pool;
+  GstVaapiSurface *background_surface;
+  guint32 background_surface_color;
+};
+
+struct _GstVaapiCompositorClass
+{
+  /*< private >*/
+  GstVaapiPluginBaseClass parent_class;
+};
+
+GType
+gst_vaapi_compositor_get_type (void);
+
+GType
+gst_vaapi_compositor_pad_get_type (void);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_COMPOSITOR_H */
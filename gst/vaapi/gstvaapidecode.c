@@ -24,6 +24,7 @@
 
 #include "gstcompat.h"
 #include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapicapscache.h>
 
 #include "gstvaapidecode.h"
 #include "gstvaapipluginutil.h"
@@ -55,6 +56,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapidecode);
 #define GST_CAT_DEFAULT NULL
 #endif
 
+enum
+{
+  PROP_0,
+
+  PROP_SHARED_SCHEDULER,
+};
+
 #define GST_VAAPI_DECODE_PARAMS_QDATA \
   g_quark_from_static_string("vaapidec-params")
 
@@ -148,9 +156,11 @@ gst_vaapi_decoder_state_changed (GstVaapiDecoder * decoder,
 
   g_assert (decode->decoder == decoder);
 
+  /* With the shared scheduler, this runs on a worker thread while the
+     streaming thread pushes the frames decoded so far */
   if (!gst_vaapi_decode_input_state_replace (decode, codec_state))
     return;
-  if (!gst_vaapidecode_update_sink_caps (decode, decode->input_state->caps))
+  if (!gst_vaapidecode_update_sink_caps (decode, codec_state->caps))
     return;
 }
 
@@ -171,56 +181,85 @@ copy_video_codec_state (const GstVideoCodecState * in_state)
   return state;
 }
 
+/* The input state and the sink caps are updated by the decoder, which
+   may run on a scheduler worker, so they are only accessed under
+   input_state_mutex */
 static gboolean
 gst_vaapi_decode_input_state_replace (GstVaapiDecode * decode,
     const GstVideoCodecState * new_state)
 {
-  if (decode->input_state) {
-    if (new_state) {
-      const GstCaps *curcaps = decode->input_state->caps;
-      /* If existing caps are equal of the new state, keep the
-       * existing state without renegotiating. */
-      if (gst_caps_is_strictly_equal (curcaps, new_state->caps)) {
-        GST_DEBUG ("Ignoring new caps %" GST_PTR_FORMAT
-            " since are equal to current ones", new_state->caps);
-        return FALSE;
-      }
+  GstVideoCodecState *old_state;
+
+  g_mutex_lock (&decode->input_state_mutex);
+  old_state = decode->input_state;
+  if (old_state && new_state) {
+    /* If existing caps are equal of the new state, keep the
+     * existing state without renegotiating. */
+    if (gst_caps_is_strictly_equal (old_state->caps, new_state->caps)) {
+      g_mutex_unlock (&decode->input_state_mutex);
+      GST_DEBUG ("Ignoring new caps %" GST_PTR_FORMAT
+          " since are equal to current ones", new_state->caps);
+      return FALSE;
     }
-    gst_video_codec_state_unref (decode->input_state);
   }
 
   if (new_state)
     decode->input_state = copy_video_codec_state (new_state);
   else
     decode->input_state = NULL;
+  g_mutex_unlock (&decode->input_state_mutex);
 
+  if (old_state)
+    gst_video_codec_state_unref (old_state);
   return TRUE;
 }
 
+/* Returns a new reference to the current input state, or NULL */
+static GstVideoCodecState *
+gst_vaapi_decode_get_input_state (GstVaapiDecode * decode)
+{
+  GstVideoCodecState *state = NULL;
+
+  g_mutex_lock (&decode->input_state_mutex);
+  if (decode->input_state)
+    state = gst_video_codec_state_ref (decode->input_state);
+  g_mutex_unlock (&decode->input_state_mutex);
+  return state;
+}
+
 static inline gboolean
 gst_vaapidecode_update_sink_caps (GstVaapiDecode * decode, GstCaps * caps)
 {
   GST_INFO_OBJECT (decode, "new sink caps = %" GST_PTR_FORMAT, caps);
+  g_mutex_lock (&decode->input_state_mutex);
   gst_caps_replace (&decode->sinkpad_caps, caps);
+  g_mutex_unlock (&decode->input_state_mutex);
   return TRUE;
 }
 
-static gboolean
-gst_vaapidecode_ensure_allowed_srcpad_caps (GstVaapiDecode * decode)
+/* Returns a new reference to the current sink caps, or NULL */
+static GstCaps *
+gst_vaapidecode_get_sink_caps (GstVaapiDecode * decode)
 {
-  GstCaps *out_caps, *raw_caps;
+  GstCaps *caps = NULL;
 
-  if (decode->allowed_srcpad_caps)
-    return TRUE;
+  g_mutex_lock (&decode->input_state_mutex);
+  gst_caps_replace (&caps, decode->sinkpad_caps);
+  g_mutex_unlock (&decode->input_state_mutex);
+  return caps;
+}
 
-  if (!GST_VAAPI_PLUGIN_BASE_DISPLAY (decode))
-    return FALSE;
+static GstCaps *
+build_allowed_srcpad_caps (gpointer user_data)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (user_data);
+  GstCaps *out_caps, *raw_caps;
 
   /* Create VA caps */
   out_caps = gst_caps_from_string (GST_VAAPI_MAKE_SURFACE_CAPS);
   if (!out_caps) {
     GST_WARNING_OBJECT (decode, "failed to create VA/GL source caps");
-    return FALSE;
+    return NULL;
   }
 #if (USE_GLX || USE_EGL)
   if (!GST_VAAPI_PLUGIN_BASE_SRC_PAD_CAN_DMABUF (decode) &&
@@ -236,12 +275,33 @@ gst_vaapidecode_ensure_allowed_srcpad_caps (GstVaapiDecode * decode)
   if (!raw_caps) {
     gst_caps_unref (out_caps);
     GST_WARNING_OBJECT (decode, "failed to create raw sink caps");
-    return FALSE;
+    return NULL;
   }
 
   out_caps = gst_caps_make_writable (out_caps);
   gst_caps_append (out_caps, gst_caps_copy (raw_caps));
-  decode->allowed_srcpad_caps = out_caps;
+  return out_caps;
+}
+
+static gboolean
+gst_vaapidecode_ensure_allowed_srcpad_caps (GstVaapiDecode * decode)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (decode);
+
+  if (decode->allowed_srcpad_caps)
+    return TRUE;
+
+  if (!display)
+    return FALSE;
+
+  /* Only the source pad DMABuf capability varies between decoders
+     sharing a display */
+  decode->allowed_srcpad_caps =
+      gst_vaapi_caps_cache_get (gst_vaapi_display_get_caps_cache (display),
+      "vaapidecode-src", GST_VAAPI_PLUGIN_BASE_SRC_PAD_CAN_DMABUF (decode) ?
+      "dmabuf" : NULL, build_allowed_srcpad_caps, decode);
+  if (!decode->allowed_srcpad_caps)
+    return FALSE;
 
   GST_INFO_OBJECT (decode, "allowed srcpad caps: %" GST_PTR_FORMAT,
       decode->allowed_srcpad_caps);
@@ -276,11 +336,6 @@ gst_vaapidecode_update_src_caps (GstVaapiDecode * decode)
   guint width, height;
   const gchar *format_str, *feature_str;
 
-  if (!decode->input_state)
-    return FALSE;
-
-  ref_state = decode->input_state;
-
   format = GST_VIDEO_INFO_FORMAT (&decode->decoded_info);
   allowed = gst_vaapidecode_get_allowed_srcpad_caps (decode);
   feature = gst_vaapi_find_preferred_caps_feature (srcpad, allowed, &format);
@@ -303,6 +358,10 @@ gst_vaapidecode_update_src_caps (GstVaapiDecode * decode)
             (&decode->decoded_info)), gst_video_format_to_string (format));
   }
 
+  ref_state = gst_vaapi_decode_get_input_state (decode);
+  if (!ref_state)
+    return FALSE;
+
   width = decode->display_width;
   height = decode->display_height;
 
@@ -313,6 +372,7 @@ gst_vaapidecode_update_src_caps (GstVaapiDecode * decode)
 
   state = gst_video_decoder_set_output_state (vdec, format, width, height,
       ref_state);
+  gst_video_codec_state_unref (ref_state);
   if (!state)
     return FALSE;
 
@@ -471,11 +531,16 @@ gst_vaapidecode_negotiate (GstVaapiDecode * decode)
 {
   GstVideoDecoder *const vdec = GST_VIDEO_DECODER (decode);
   GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (vdec);
+  GstCaps *sink_caps;
+  gboolean success;
 
   GST_DEBUG_OBJECT (decode, "input codec state changed: renegotiating");
 
   GST_VIDEO_DECODER_STREAM_LOCK (vdec);
-  if (!gst_vaapi_plugin_base_set_caps (plugin, decode->sinkpad_caps, NULL))
+  sink_caps = gst_vaapidecode_get_sink_caps (decode);
+  success = gst_vaapi_plugin_base_set_caps (plugin, sink_caps, NULL);
+  gst_caps_replace (&sink_caps, NULL);
+  if (!success)
     return FALSE;
   if (!gst_vaapidecode_update_src_caps (decode))
     return FALSE;
@@ -513,6 +578,7 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
   GstVaapiVideoBufferPoolAcquireParams vaapi_params = { {0,}, };
   guint flags, out_flags = 0;
   gboolean alloc_renegotiate, caps_renegotiate;
+  GstClockTime start;
 
   if (!GST_VIDEO_CODEC_FRAME_IS_DECODE_ONLY (out_frame)) {
     proxy = gst_video_codec_frame_get_user_data (out_frame);
@@ -585,6 +651,9 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
     if (decode->has_texture_upload_meta)
       gst_buffer_ensure_texture_upload_meta (out_frame->output_buffer);
 #endif
+
+    gst_vaapi_timing_frames_attach (decode->timing_frames,
+        out_frame->system_frame_number, out_frame->output_buffer);
   }
 
   if (decode->in_segment.rate < 0.0
@@ -594,7 +663,9 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
     return GST_FLOW_OK;
   }
 
+  start = GST_VAAPI_TIMING_BEGIN ();
   ret = gst_video_decoder_finish_frame (vdec, out_frame);
+  GST_VAAPI_TIMING_END (GST_VAAPI_TIMING_STAGE_PUSH, start);
   if (ret != GST_FLOW_OK)
     goto error_commit_buffer;
   return GST_FLOW_OK;
@@ -658,6 +729,54 @@ gst_vaapidecode_push_all_decoded_frames (GstVaapiDecode * decode)
   g_assert_not_reached ();
 }
 
+/* Decodes @frame, accounting the stages run by this thread to it */
+static GstVaapiDecoderStatus
+decode_frame_timed (GstVaapiDecode * decode, GstVideoCodecFrame * frame)
+{
+  GstVaapiDecoderStatus status;
+  GstVaapiTimingScope scope;
+
+  gst_vaapi_timing_scope_begin (&scope);
+  status = gst_vaapi_decoder_decode (decode->decoder, frame);
+  gst_vaapi_timing_scope_end (&scope);
+
+  gst_vaapi_timing_frames_add (decode->timing_frames,
+      frame->system_frame_number, &scope);
+  return status;
+}
+
+/* Decodes @frame. With the shared scheduler, the frames decoded so far
+   are pushed downstream while @frame is being decoded. The flow return
+   of that push is stored in @ret_ptr */
+static GstVaapiDecoderStatus
+gst_vaapidecode_decode_frame (GstVaapiDecode * decode,
+    GstVideoCodecFrame * frame, GstFlowReturn * ret_ptr)
+{
+  GstClockTimeDiff max_decode_time;
+  GstVaapiDecoderStatus status;
+  gint64 deadline = GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE;
+
+  *ret_ptr = GST_FLOW_OK;
+  if (!decode->scheduler_stream)
+    return decode_frame_timed (decode, frame);
+
+  /* Late frames get decoded first by the shared scheduler */
+  max_decode_time = gst_video_decoder_get_max_decode_time (GST_VIDEO_DECODER
+      (decode), frame);
+  if (max_decode_time != G_MAXINT64)
+    deadline = g_get_monotonic_time () + max_decode_time / GST_USECOND;
+
+  /* The worker could output the frame, and it could be finished by the
+     push below, before the worker is done with it */
+  gst_video_codec_frame_ref (frame);
+  gst_vaapi_decode_scheduler_submit (decode->scheduler_stream, frame,
+      deadline);
+  *ret_ptr = gst_vaapidecode_push_all_decoded_frames (decode);
+  status = gst_vaapi_decode_scheduler_wait (decode->scheduler_stream, NULL);
+  gst_video_codec_frame_unref (frame);
+  return status;
+}
+
 static GstFlowReturn
 gst_vaapidecode_handle_frame (GstVideoDecoder * vdec,
     GstVideoCodecFrame * frame)
@@ -671,7 +790,13 @@ gst_vaapidecode_handle_frame (GstVideoDecoder * vdec,
 
   /* Decode current frame */
   for (;;) {
-    status = gst_vaapi_decoder_decode (decode->decoder, frame);
+    status = gst_vaapidecode_decode_frame (decode, frame, &ret);
+    if (ret != GST_FLOW_OK) {
+      /* The decoded frame is queued for output, and purged from there */
+      if (status == GST_VAAPI_DECODER_STATUS_SUCCESS)
+        return ret;
+      goto error_push_all_decoded_frames;
+    }
     if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE) {
       /* Make sure that there are no decoded frames waiting in the
          output queue. */
@@ -822,6 +947,12 @@ gst_vaapi_codec_from_caps (GstCaps * caps)
   return gst_vaapi_profile_get_codec (gst_vaapi_profile_from_caps (caps));
 }
 
+static GstVaapiDecoderStatus
+decode_frame_job (gpointer stream_data, gpointer job_data)
+{
+  return decode_frame_timed (stream_data, job_data);
+}
+
 static gboolean
 gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
 {
@@ -912,6 +1043,18 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
   gst_vaapi_decoder_set_codec_state_changed_func (decode->decoder,
       gst_vaapi_decoder_state_changed, decode);
 
+  if (decode->shared_scheduler) {
+    GstVaapiDecodeScheduler *const scheduler =
+        gst_vaapi_display_get_decode_scheduler (dpy);
+
+    if (scheduler)
+      decode->scheduler_stream =
+          gst_vaapi_decode_scheduler_add_stream (scheduler,
+          decode_frame_job, decode);
+    if (!decode->scheduler_stream)
+      GST_WARNING_OBJECT (decode, "failed to use the shared scheduler");
+  }
+
   return TRUE;
 }
 
@@ -940,6 +1083,18 @@ gst_vaapidecode_purge (GstVaapiDecode * decode)
       gst_video_codec_frame_unref (frame);
     }
   } while (status == GST_VAAPI_DECODER_STATUS_SUCCESS);
+
+  gst_vaapi_timing_frames_clear (decode->timing_frames);
+}
+
+static void
+gst_vaapidecode_release_decoder (GstVaapiDecode * decode)
+{
+  if (decode->scheduler_stream) {
+    gst_vaapi_decode_scheduler_remove_stream (decode->scheduler_stream);
+    decode->scheduler_stream = NULL;
+  }
+  gst_vaapi_decoder_replace (&decode->decoder, NULL);
 }
 
 static void
@@ -947,7 +1102,7 @@ gst_vaapidecode_destroy (GstVaapiDecode * decode)
 {
   gst_vaapidecode_purge (decode);
 
-  gst_vaapi_decoder_replace (&decode->decoder, NULL);
+  gst_vaapidecode_release_decoder (decode);
 
   gst_vaapidecode_release (gst_object_ref (decode));
 }
@@ -977,11 +1132,45 @@ gst_vaapidecode_finalize (GObject * object)
 
   g_cond_clear (&decode->surface_ready);
   g_mutex_clear (&decode->surface_ready_mutex);
+  g_mutex_clear (&decode->input_state_mutex);
+  gst_vaapi_timing_frames_free (decode->timing_frames);
 
   gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (object));
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_vaapidecode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case PROP_SHARED_SCHEDULER:
+      decode->shared_scheduler = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapidecode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case PROP_SHARED_SCHEDULER:
+      g_value_set_boolean (value, decode->shared_scheduler);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static gboolean
 gst_vaapidecode_open (GstVideoDecoder * vdec)
 {
@@ -1037,7 +1226,7 @@ gst_vaapidecode_stop (GstVideoDecoder * vdec)
 
   gst_vaapidecode_purge (decode);
   gst_vaapi_decode_input_state_replace (decode, NULL);
-  gst_vaapi_decoder_replace (&decode->decoder, NULL);
+  gst_vaapidecode_release_decoder (decode);
   gst_caps_replace (&decode->sinkpad_caps, NULL);
   gst_caps_replace (&decode->srcpad_caps, NULL);
   return TRUE;
@@ -1089,12 +1278,17 @@ gst_vaapidecode_parse_frame (GstVideoDecoder * vdec,
 {
   GstVaapiDecode *const decode = GST_VAAPIDECODE (vdec);
   GstVaapiDecoderStatus status;
+  GstVaapiTimingScope scope;
   GstFlowReturn ret;
   guint got_unit_size;
   gboolean got_frame;
 
+  gst_vaapi_timing_scope_begin (&scope);
   status = gst_vaapi_decoder_parse (decode->decoder, frame,
       adapter, at_eos, &got_unit_size, &got_frame);
+  gst_vaapi_timing_scope_end (&scope);
+  gst_vaapi_timing_frames_add (decode->timing_frames,
+      frame->system_frame_number, &scope);
 
   switch (status) {
     case GST_VAAPI_DECODER_STATUS_SUCCESS:
@@ -1139,16 +1333,15 @@ gst_vaapidecode_parse (GstVideoDecoder * vdec,
   return ret;
 }
 
-static gboolean
-gst_vaapidecode_ensure_allowed_sinkpad_caps (GstVaapiDecode * decode)
+static GstCaps *
+build_allowed_sinkpad_caps (gpointer user_data)
 {
+  GstVaapiDisplay *const display = GST_VAAPI_DISPLAY (user_data);
   GstCaps *caps, *allowed_sinkpad_caps;
   GArray *profiles;
   guint i;
 
-  profiles =
-      gst_vaapi_display_get_decode_profiles (GST_VAAPI_PLUGIN_BASE_DISPLAY
-      (decode));
+  profiles = gst_vaapi_display_get_decode_profiles (display);
   if (!profiles)
     goto error_no_profiles;
 
@@ -1179,25 +1372,38 @@ gst_vaapidecode_ensure_allowed_sinkpad_caps (GstVaapiDecode * decode)
 
     allowed_sinkpad_caps = gst_caps_merge (allowed_sinkpad_caps, caps);
   }
-  decode->allowed_sinkpad_caps = gst_caps_simplify (allowed_sinkpad_caps);
+  allowed_sinkpad_caps = gst_caps_simplify (allowed_sinkpad_caps);
 
   g_array_unref (profiles);
-  return TRUE;
+  return allowed_sinkpad_caps;
 
   /* ERRORS */
 error_no_profiles:
   {
     GST_ERROR ("failed to retrieve VA decode profiles");
-    return FALSE;
+    return NULL;
   }
 error_no_memory:
   {
     GST_ERROR ("failed to allocate allowed-caps set");
     g_array_unref (profiles);
-    return FALSE;
+    return NULL;
   }
 }
 
+static gboolean
+gst_vaapidecode_ensure_allowed_sinkpad_caps (GstVaapiDecode * decode)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (decode);
+
+  /* The decode profiles, hence the caps, are the same for all the
+     decoders sharing a display */
+  decode->allowed_sinkpad_caps =
+      gst_vaapi_caps_cache_get (gst_vaapi_display_get_caps_cache (display),
+      "vaapidecode-sink", NULL, build_allowed_sinkpad_caps, display);
+  return decode->allowed_sinkpad_caps != NULL;
+}
+
 static GstCaps *
 gst_vaapidecode_sink_getcaps (GstVideoDecoder * vdec, GstCaps * filter)
 {
@@ -1236,6 +1442,11 @@ gst_vaapidecode_sink_query (GstVideoDecoder * vdec, GstQuery * query)
       ret = gst_vaapi_handle_context_query (element, query);
       break;
     }
+    case GST_QUERY_CUSTOM:{
+      ret = gst_vaapi_handle_profiler_query (element, query) ||
+          GST_VIDEO_DECODER_CLASS (parent_class)->sink_query (vdec, query);
+      break;
+    }
     default:{
       ret = GST_VIDEO_DECODER_CLASS (parent_class)->sink_query (vdec, query);
       break;
@@ -1273,6 +1484,11 @@ gst_vaapidecode_src_query (GstVideoDecoder * vdec, GstQuery * query)
       ret = gst_vaapi_handle_context_query (element, query);
       break;
     }
+    case GST_QUERY_CUSTOM:{
+      ret = gst_vaapi_handle_profiler_query (element, query) ||
+          GST_VIDEO_DECODER_CLASS (parent_class)->src_query (vdec, query);
+      break;
+    }
     default:{
       ret = GST_VIDEO_DECODER_CLASS (parent_class)->src_query (vdec, query);
       break;
@@ -1322,6 +1538,8 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   gst_vaapi_plugin_base_class_init (GST_VAAPI_PLUGIN_BASE_CLASS (klass));
 
   object_class->finalize = gst_vaapidecode_finalize;
+  object_class->set_property = gst_vaapidecode_set_property;
+  object_class->get_property = gst_vaapidecode_get_property;
 
   vdec_class->open = GST_DEBUG_FUNCPTR (gst_vaapidecode_open);
   vdec_class->close = GST_DEBUG_FUNCPTR (gst_vaapidecode_close);
@@ -1374,6 +1592,22 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   /* src pad */
   gst_element_class_add_static_pad_template (element_class,
       &gst_vaapidecode_src_factory);
+
+  /**
+   * GstVaapiDecode:shared-scheduler:
+   *
+   * When enabled, frames are decoded by the worker threads shared by
+   * all the decoders using the same VA display, rather than on the
+   * streaming thread. This reduces contention on the VA display when
+   * many streams are decoded concurrently.
+   */
+  g_object_class_install_property (object_class,
+      PROP_SHARED_SCHEDULER,
+      g_param_spec_boolean ("shared-scheduler",
+          "Shared scheduler",
+          "Decode frames on the worker threads shared by all decoders",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
 }
 
 static void
@@ -1385,6 +1619,8 @@ gst_vaapidecode_init (GstVaapiDecode * decode)
 
   g_mutex_init (&decode->surface_ready_mutex);
   g_cond_init (&decode->surface_ready);
+  g_mutex_init (&decode->input_state_mutex);
+  decode->timing_frames = gst_vaapi_timing_frames_new ();
 
   gst_video_decoder_set_packetized (vdec, FALSE);
 }
@@ -26,7 +26,9 @@
 #define GST_VAAPIDECODE_H
 
 #include "gstvaapipluginbase.h"
+#include "gstvaapitimingmeta.h"
 #include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapidecodescheduler.h>
 
 G_BEGIN_DECLS
 
@@ -43,6 +45,8 @@ struct _GstVaapiDecode {
     GstCaps            *srcpad_caps;
     GstVideoInfo        decoded_info;
     GstVaapiDecoder    *decoder;
+    GstVaapiDecodeSchedulerStream *scheduler_stream;
+    gboolean            shared_scheduler;
     GMutex              surface_ready_mutex;
     GCond               surface_ready;
     GstCaps            *allowed_sinkpad_caps;
@@ -53,10 +57,12 @@ struct _GstVaapiDecode {
     guint               display_width;
     guint               display_height;
 
+    GMutex              input_state_mutex;
     GstVideoCodecState *input_state;
     GstSegment          in_segment;
 
     gboolean            do_renego;
+    GstVaapiTimingFrames *timing_frames;
 };
 
 struct _GstVaapiDecodeClass {
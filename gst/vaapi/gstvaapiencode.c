@@ -24,11 +24,14 @@
 #include "gstcompat.h"
 #include <gst/vaapi/gstvaapivalue.h>
 #include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapicapscache.h>
+#include <gst/vaapi/gstvaapiutils_h26x.h>
 #include "gstvaapiencode.h"
 #include "gstvaapipluginutil.h"
 #include "gstvaapivideometa.h"
 #include "gstvaapivideomemory.h"
 #include "gstvaapivideobufferpool.h"
+#include "gstvaapicodedmemory.h"
 
 #define GST_PLUGIN_NAME "vaapiencode"
 #define GST_PLUGIN_DESC "A VA-API based video encoder"
@@ -37,6 +40,10 @@
 #define GST_VAAPI_ENCODE_FLOW_MEM_ERROR         GST_FLOW_CUSTOM_ERROR
 #define GST_VAAPI_ENCODE_FLOW_CONVERT_ERROR     GST_FLOW_CUSTOM_ERROR_1
 
+/* Minimum number of free coded buffers the encoder pool shall keep
+   for an output buffer to be pushed downstream without copy */
+#define GST_VAAPI_ENCODE_CODED_BUFFER_HEADROOM  2
+
 GST_DEBUG_CATEGORY_STATIC (gst_vaapiencode_debug);
 #ifndef GST_DISABLE_GST_DEBUG
 #define GST_CAT_DEFAULT gst_vaapiencode_debug
@@ -73,6 +80,11 @@ gst_vaapiencode_sink_query (GstVideoEncoder * encoder, GstQuery * query)
     case GST_QUERY_CONTEXT:
       ret = gst_vaapi_handle_context_query (element, query);
       break;
+    case GST_QUERY_CUSTOM:
+      ret = gst_vaapi_handle_profiler_query (element, query) ||
+          GST_VIDEO_ENCODER_CLASS (gst_vaapiencode_parent_class)->sink_query
+          (encoder, query);
+      break;
     default:
       ret = GST_VIDEO_ENCODER_CLASS (gst_vaapiencode_parent_class)->sink_query
           (encoder, query);
@@ -92,6 +104,11 @@ gst_vaapiencode_src_query (GstVideoEncoder * encoder, GstQuery * query)
     case GST_QUERY_CONTEXT:
       ret = gst_vaapi_handle_context_query (element, query);
       break;
+    case GST_QUERY_CUSTOM:
+      ret = gst_vaapi_handle_profiler_query (element, query) ||
+          GST_VIDEO_ENCODER_CLASS (gst_vaapiencode_parent_class)->src_query
+          (encoder, query);
+      break;
     default:
       ret = GST_VIDEO_ENCODER_CLASS (gst_vaapiencode_parent_class)->src_query
           (encoder, query);
@@ -185,14 +202,30 @@ gst_vaapiencode_default_set_property (GstVaapiEncode * encode, guint prop_id,
 
 static GstFlowReturn
 gst_vaapiencode_default_alloc_buffer (GstVaapiEncode * encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** outbuf_ptr)
+    GstVaapiCodedBufferProxy * codedbuf_proxy, GstBuffer ** outbuf_ptr)
 {
+  GstVaapiCodedBuffer *coded_buf;
   GstBuffer *buf;
   gint32 buf_size;
 
-  g_return_val_if_fail (coded_buf != NULL, GST_FLOW_ERROR);
+  g_return_val_if_fail (codedbuf_proxy != NULL, GST_FLOW_ERROR);
   g_return_val_if_fail (outbuf_ptr != NULL, GST_FLOW_ERROR);
 
+  /* Hand over the VA coded buffer segments directly, if possible */
+  if (encode->coded_allocator &&
+      gst_vaapi_coded_allocator_can_wrap (encode->coded_allocator,
+          codedbuf_proxy)) {
+    buf = gst_vaapi_coded_allocator_wrap_buffer (encode->coded_allocator,
+        encode->encoder, codedbuf_proxy);
+    if (buf) {
+      *outbuf_ptr = buf;
+      return GST_FLOW_OK;
+    }
+    GST_WARNING_OBJECT (encode, "failed to wrap GstVaapiCodedBuffer, "
+        "falling back to copy");
+  }
+
+  coded_buf = GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy);
   buf_size = gst_vaapi_coded_buffer_get_size (coded_buf);
   if (buf_size <= 0)
     goto error_invalid_buffer;
@@ -233,6 +266,7 @@ ensure_output_state (GstVaapiEncode * encode)
   GstVideoEncoder *const venc = GST_VIDEO_ENCODER_CAST (encode);
   GstVaapiEncodeClass *const klass = GST_VAAPIENCODE_GET_CLASS (encode);
   GstVaapiEncoderStatus status;
+  GstVaapiRectangle crop_rect;
   GstCaps *out_caps;
 
   if (!encode->input_state_changed)
@@ -247,6 +281,12 @@ ensure_output_state (GstVaapiEncode * encode)
   encode->output_state = gst_video_encoder_set_output_state (venc, out_caps,
       encode->input_state);
 
+  /* The output size is the region signalled for display */
+  if (gst_vaapi_encoder_get_crop_rect (encode->encoder, &crop_rect)) {
+    encode->output_state->info.width = crop_rect.width;
+    encode->output_state->info.height = crop_rect.height;
+  }
+
   if (encode->need_codec_data) {
     status = gst_vaapi_encoder_get_codec_data (encode->encoder,
         &encode->output_state->codec_data);
@@ -261,6 +301,93 @@ ensure_output_state (GstVaapiEncode * encode)
   return TRUE;
 }
 
+/* Finishes the coded picture as individual NAL aligned slices. The
+   first slice goes through gst_video_encoder_finish_frame(), so that
+   the pending caps, segment, tags and frame events are pushed ahead of
+   it, and the other slices directly follow on the source pad.
+   VA-API only reports the completion of whole pictures, so the slices
+   are only available once the picture is synced */
+static GstFlowReturn
+gst_vaapiencode_finish_slices (GstVaapiEncode * encode,
+    GstVideoCodecFrame * frame, GstBuffer * buffer)
+{
+  GstVideoEncoder *const venc = GST_VIDEO_ENCODER_CAST (encode);
+  GstPad *const srcpad = GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode);
+  const GstClockTime pts = frame->pts;
+  const GstClockTime dts = frame->dts;
+  const GstClockTime duration = frame->duration;
+  const GstVaapiH26xSliceRange *range;
+  GstBuffer *slice_buffer;
+  GstFlowReturn ret;
+  GstMapInfo info;
+  guint i, num_slices;
+
+  if (!gst_buffer_map (buffer, &info, GST_MAP_READ))
+    goto error_map_buffer;
+  num_slices = gst_vaapi_utils_h26x_split_slices (info.data, info.size,
+      encode->slice_output_codec == GST_VAAPI_CODEC_H265,
+      encode->slice_ranges);
+  gst_buffer_unmap (buffer, &info);
+
+  if (num_slices < 2) {
+    slice_buffer = buffer;
+    buffer = NULL;
+  } else {
+    range = &g_array_index (encode->slice_ranges, GstVaapiH26xSliceRange, 0);
+    slice_buffer = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+        range->offset, range->size);
+    if (!slice_buffer)
+      goto error_map_buffer;
+  }
+  gst_vaapi_timing_frames_attach (encode->timing_frames,
+      frame->system_frame_number, slice_buffer);
+
+  /* The last buffer of the coded picture is flagged as such */
+  if (num_slices < 2)
+    GST_BUFFER_FLAG_SET (slice_buffer, GST_VIDEO_BUFFER_FLAG_MARKER);
+  gst_buffer_replace (&frame->output_buffer, slice_buffer);
+  gst_buffer_unref (slice_buffer);
+
+  /* Keep other events from getting in between the slices */
+  GST_VIDEO_ENCODER_STREAM_LOCK (encode);
+  ret = gst_video_encoder_finish_frame (venc, frame);
+  for (i = 1; ret == GST_FLOW_OK && i < num_slices; i++) {
+    range = &g_array_index (encode->slice_ranges, GstVaapiH26xSliceRange, i);
+    slice_buffer = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+        range->offset, range->size);
+    if (!slice_buffer) {
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+
+    GST_BUFFER_PTS (slice_buffer) = pts;
+    GST_BUFFER_DTS (slice_buffer) = dts;
+    GST_BUFFER_DURATION (slice_buffer) = duration;
+    GST_BUFFER_FLAG_SET (slice_buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    if (i == num_slices - 1)
+      GST_BUFFER_FLAG_SET (slice_buffer, GST_VIDEO_BUFFER_FLAG_MARKER);
+
+    GST_TRACE_OBJECT (encode, "output:%" GST_TIME_FORMAT ", slice %u/%u, "
+        "size:%u", GST_TIME_ARGS (pts), i + 1, num_slices, range->size);
+
+    ret = gst_pad_push (srcpad, slice_buffer);
+  }
+  GST_VIDEO_ENCODER_STREAM_UNLOCK (encode);
+
+  if (buffer)
+    gst_buffer_unref (buffer);
+  return ret;
+
+  /* ERRORS */
+error_map_buffer:
+  {
+    GST_ERROR ("failed to split coded buffer into slices");
+    gst_buffer_unref (buffer);
+    gst_video_encoder_finish_frame (venc, frame);
+    return GST_FLOW_ERROR;
+  }
+}
+
 static GstFlowReturn
 gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
 {
@@ -269,11 +396,14 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
   GstVideoCodecFrame *out_frame;
   GstVaapiCodedBufferProxy *codedbuf_proxy = NULL;
   GstVaapiEncoderStatus status;
+  GstVaapiTimingScope scope;
   GstBuffer *out_buffer;
   GstFlowReturn ret;
 
+  gst_vaapi_timing_scope_begin (&scope);
   status = gst_vaapi_encoder_get_buffer_with_timeout (encode->encoder,
       &codedbuf_proxy, timeout);
+  gst_vaapi_timing_scope_end (&scope);
   if (status == GST_VAAPI_ENCODER_STATUS_NO_BUFFER)
     return GST_VAAPI_ENCODE_FLOW_TIMEOUT;
   if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
@@ -284,6 +414,12 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
     goto error_get_buffer;
   gst_video_codec_frame_ref (out_frame);
   gst_video_codec_frame_set_user_data (out_frame, NULL, NULL);
+  gst_vaapi_timing_frames_add (encode->timing_frames,
+      out_frame->system_frame_number, &scope);
+
+  /* The output buffer may keep the coded buffer proxy alive, so drop
+     the frame reference it holds to avoid a reference cycle */
+  gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy, NULL, NULL);
 
   /* Update output state */
   GST_VIDEO_ENCODER_STREAM_LOCK (encode);
@@ -291,14 +427,19 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
     goto error_output_state;
   GST_VIDEO_ENCODER_STREAM_UNLOCK (encode);
 
-  /* Allocate and copy buffer into system memory */
+  /* Wrap the coded buffer, or copy it into system memory */
   out_buffer = NULL;
-  ret = klass->alloc_buffer (encode,
-      GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy), &out_buffer);
+  ret = klass->alloc_buffer (encode, codedbuf_proxy, &out_buffer);
   gst_vaapi_coded_buffer_proxy_replace (&codedbuf_proxy, NULL);
   if (ret != GST_FLOW_OK)
     goto error_allocate_buffer;
 
+  /* Push the individual slices downstream */
+  if (encode->slice_output_codec)
+    return gst_vaapiencode_finish_slices (encode, out_frame, out_buffer);
+
+  gst_vaapi_timing_frames_attach (encode->timing_frames,
+      out_frame->system_frame_number, out_buffer);
   gst_buffer_replace (&out_frame->output_buffer, out_buffer);
   gst_buffer_unref (out_buffer);
 
@@ -346,58 +487,83 @@ gst_vaapiencode_buffer_loop (GstVaapiEncode * encode)
   gst_pad_pause_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
 }
 
-static gboolean
-ensure_allowed_sinkpad_caps (GstVaapiEncode * encode)
+static GstCaps *
+build_allowed_sinkpad_caps (gpointer user_data)
 {
-  GstCaps *out_caps, *raw_caps = NULL;
-  GArray *formats = NULL;
-  gboolean ret = FALSE;
-
-  if (encode->allowed_sinkpad_caps)
-    return TRUE;
-  if (!encode->encoder)
-    return TRUE;
+  GArray *const formats = user_data;
+  GstCaps *out_caps, *raw_caps;
 
   out_caps = gst_caps_from_string (GST_VAAPI_MAKE_SURFACE_CAPS);
   if (!out_caps)
     goto failed_create_va_caps;
 
-  formats = gst_vaapi_encoder_get_surface_formats (encode->encoder);
-  if (!formats)
-    goto failed_get_formats;
-
   raw_caps = gst_vaapi_video_format_new_template_caps_from_list (formats);
   if (!raw_caps)
     goto failed_create_raw_caps;
 
   out_caps = gst_caps_make_writable (out_caps);
-  gst_caps_append (out_caps, gst_caps_copy (raw_caps));
-  gst_caps_replace (&encode->allowed_sinkpad_caps, out_caps);
-  ret = TRUE;
-
-bail:
-  if (out_caps)
-    gst_caps_unref (out_caps);
-  if (raw_caps)
-    gst_caps_unref (raw_caps);
-  if (formats)
-    g_array_unref (formats);
-  return ret;
+  gst_caps_append (out_caps, raw_caps);
+  return out_caps;
 
 failed_create_va_caps:
   {
-    GST_WARNING_OBJECT (encode, "failed to create VA/GL sink caps");
-    return FALSE;
+    GST_WARNING ("failed to create VA/GL sink caps");
+    return NULL;
   }
-failed_get_formats:
+failed_create_raw_caps:
   {
-    GST_WARNING_OBJECT (encode, "failed to get allowed surface formats");
-    goto bail;
+    GST_WARNING ("failed to create raw sink caps");
+    gst_caps_unref (out_caps);
+    return NULL;
   }
-failed_create_raw_caps:
+}
+
+/* The surface formats depend on the encoder profile and entrypoint,
+   so they are the cache key, as a list of format names */
+static gchar *
+get_formats_key (GArray * formats)
+{
+  GString *key;
+  guint i;
+
+  key = g_string_new (NULL);
+  for (i = 0; i < formats->len; i++) {
+    const GstVideoFormat format = g_array_index (formats, GstVideoFormat, i);
+    if (i > 0)
+      g_string_append_c (key, ',');
+    g_string_append (key, gst_video_format_to_string (format));
+  }
+  return g_string_free (key, FALSE);
+}
+
+static gboolean
+ensure_allowed_sinkpad_caps (GstVaapiEncode * encode)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (encode);
+  GArray *formats;
+  gchar *key;
+
+  if (encode->allowed_sinkpad_caps)
+    return TRUE;
+  if (!encode->encoder)
+    return TRUE;
+
+  formats = gst_vaapi_encoder_get_surface_formats (encode->encoder);
+  if (!formats)
+    goto failed_get_formats;
+
+  key = get_formats_key (formats);
+  encode->allowed_sinkpad_caps =
+      gst_vaapi_caps_cache_get (gst_vaapi_display_get_caps_cache (display),
+      "vaapiencode-sink", key, build_allowed_sinkpad_caps, formats);
+  g_free (key);
+  g_array_unref (formats);
+  return encode->allowed_sinkpad_caps != NULL;
+
+failed_get_formats:
   {
-    GST_WARNING_OBJECT (encode, "failed to create raw sink caps");
-    goto bail;
+    GST_WARNING_OBJECT (encode, "failed to get allowed surface formats");
+    return FALSE;
   }
 }
 
@@ -451,6 +617,8 @@ gst_vaapiencode_purge (GstVaapiEncode * encode)
       gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
     }
   } while (status == GST_VAAPI_ENCODER_STATUS_SUCCESS);
+
+  gst_vaapi_timing_frames_clear (encode->timing_frames);
 }
 
 static gboolean
@@ -537,6 +705,37 @@ set_codec_state (GstVaapiEncode * encode, GstVideoCodecState * state)
   return TRUE;
 }
 
+/* Signals the region of the frames to display in the bitstream, from
+   the GstVideoCropMeta or from the VA surface proxy of the first frame,
+   instead of copying that region to a new surface */
+static void
+ensure_crop_rect (GstVaapiEncode * encode, GstBuffer * buf,
+    GstVaapiSurfaceProxy * proxy)
+{
+  const GstVideoCropMeta *const crop_meta =
+      gst_buffer_get_video_crop_meta (buf);
+  const GstVaapiRectangle *crop_rect;
+  GstVaapiRectangle tmp_rect;
+  GstVaapiEncoderStatus status;
+
+  if (crop_meta) {
+    tmp_rect.x = crop_meta->x;
+    tmp_rect.y = crop_meta->y;
+    tmp_rect.width = crop_meta->width;
+    tmp_rect.height = crop_meta->height;
+    crop_rect = &tmp_rect;
+  } else
+    crop_rect = gst_vaapi_surface_proxy_get_crop_rect (proxy);
+
+  status = gst_vaapi_encoder_set_crop_rect (encode->encoder, crop_rect);
+  if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS) {
+    GST_WARNING_OBJECT (encode, "could not signal cropping rectangle, "
+        "encoding whole frames");
+    return;
+  }
+  encode->input_state_changed = TRUE;
+}
+
 static gboolean
 gst_vaapiencode_set_format (GstVideoEncoder * venc, GstVideoCodecState * state)
 {
@@ -556,6 +755,7 @@ gst_vaapiencode_set_format (GstVideoEncoder * venc, GstVideoCodecState * state)
     gst_video_codec_state_unref (encode->input_state);
   encode->input_state = gst_video_codec_state_ref (state);
   encode->input_state_changed = TRUE;
+  encode->need_crop_rect = TRUE;
 
   ret = gst_pad_start_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode),
       (GstTaskFunction) gst_vaapiencode_buffer_loop, encode, NULL);
@@ -600,6 +800,7 @@ gst_vaapiencode_handle_frame (GstVideoEncoder * venc,
   GstVaapiEncoderStatus status;
   GstVaapiVideoMeta *meta;
   GstVaapiSurfaceProxy *proxy;
+  GstVaapiTimingScope scope;
   GstFlowReturn ret;
   GstBuffer *buf;
 
@@ -624,9 +825,18 @@ gst_vaapiencode_handle_frame (GstVideoEncoder * venc,
       gst_vaapi_surface_proxy_ref (proxy),
       (GDestroyNotify) gst_vaapi_surface_proxy_unref);
 
+  if (encode->need_crop_rect) {
+    ensure_crop_rect (encode, buf, proxy);
+    encode->need_crop_rect = FALSE;
+  }
+
   GST_VIDEO_ENCODER_STREAM_UNLOCK (encode);
+  gst_vaapi_timing_scope_begin (&scope);
   status = gst_vaapi_encoder_put_frame (encode->encoder, frame);
+  gst_vaapi_timing_scope_end (&scope);
   GST_VIDEO_ENCODER_STREAM_LOCK (encode);
+  gst_vaapi_timing_frames_add (encode->timing_frames,
+      frame->system_frame_number, &scope);
   if (status < GST_VAAPI_ENCODER_STATUS_SUCCESS)
     goto error_encode_frame;
 
@@ -710,10 +920,19 @@ gst_vaapiencode_change_state (GstElement * element, GstStateChange transition)
 static gboolean
 gst_vaapiencode_propose_allocation (GstVideoEncoder * venc, GstQuery * query)
 {
+  GstVaapiEncode *const encode = GST_VAAPIENCODE_CAST (venc);
   GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (venc);
+  guint index;
 
   if (!gst_vaapi_plugin_base_propose_allocation (plugin, query))
     return FALSE;
+
+  /* Only the codecs with a cropping syntax honor the crop meta */
+  if ((!encode->encoder ||
+          !gst_vaapi_encoder_has_crop_rect_support (encode->encoder)) &&
+      gst_query_find_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE,
+          &index))
+    gst_query_remove_nth_allocation_meta (query, index);
   return TRUE;
 }
 
@@ -765,6 +984,7 @@ gst_vaapiencode_flush (GstVideoEncoder * venc)
     return FALSE;
   if (!set_codec_state (encode, encode->input_state))
     return FALSE;
+  encode->need_crop_rect = TRUE;
 
   return TRUE;
 }
@@ -781,6 +1001,10 @@ gst_vaapiencode_finalize (GObject * object)
     encode->prop_values = NULL;
   }
 
+  gst_object_replace ((GstObject **) & encode->coded_allocator, NULL);
+  g_array_unref (encode->slice_ranges);
+  gst_vaapi_timing_frames_free (encode->timing_frames);
+
   gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (object));
   G_OBJECT_CLASS (gst_vaapiencode_parent_class)->finalize (object);
 }
@@ -792,6 +1016,12 @@ gst_vaapiencode_init (GstVaapiEncode * encode)
 
   gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (encode), GST_CAT_DEFAULT);
   gst_pad_use_fixed_caps (plugin->srcpad);
+
+  encode->coded_allocator =
+      gst_vaapi_coded_allocator_new (GST_VAAPI_ENCODE_CODED_BUFFER_HEADROOM);
+  encode->slice_ranges =
+      g_array_new (FALSE, FALSE, sizeof (GstVaapiH26xSliceRange));
+  encode->timing_frames = gst_vaapi_timing_frames_new ();
 }
 
 static void
@@ -25,6 +25,7 @@
 #define GST_VAAPIENCODE_H
 
 #include "gstvaapipluginbase.h"
+#include "gstvaapitimingmeta.h"
 #include <gst/vaapi/gstvaapiencoder.h>
 
 G_BEGIN_DECLS
@@ -55,11 +56,18 @@ struct _GstVaapiEncode
   GstVaapiEncoder *encoder;
   GstVideoCodecState *input_state;
   gboolean input_state_changed;
+  /* the cropping rectangle is taken from the next frame */
+  gboolean need_crop_rect;
   /* needs to be set by the subclass implementation */
   gboolean need_codec_data;
   GstVideoCodecState *output_state;
   GPtrArray *prop_values;
   GstCaps *allowed_sinkpad_caps;
+  GstAllocator *coded_allocator;
+  /* set by the subclass to push one buffer per slice (alignment=nal) */
+  GstVaapiCodec slice_output_codec;
+  GArray *slice_ranges;
+  GstVaapiTimingFrames *timing_frames;
 };
 
 struct _GstVaapiEncodeClass
@@ -78,7 +86,7 @@ struct _GstVaapiEncodeClass
   GstVaapiEncoder *   (*alloc_encoder)  (GstVaapiEncode * encode,
                                          GstVaapiDisplay * display);
   GstFlowReturn       (*alloc_buffer)   (GstVaapiEncode * encode,
-                                         GstVaapiCodedBuffer * coded_buf,
+                                         GstVaapiCodedBufferProxy * proxy,
                                          GstBuffer ** outbuf_ptr);
 };
 
@@ -52,7 +52,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_vaapi_h264_encode_debug);
 #define GST_CODEC_CAPS                              \
   "video/x-h264, "                                  \
   "stream-format = (string) { avc, byte-stream }, " \
-  "alignment = (string) au"
+  "alignment = (string) { au, nal }"
 
 /* *INDENT-OFF* */
 static const char gst_vaapiencode_h264_sink_caps_str[] =
@@ -215,6 +215,7 @@ gst_vaapiencode_h264_get_caps (GstVaapiEncode * base_encode)
 {
   GstVaapiEncodeH264 *const encode = GST_VAAPIENCODE_H264_CAST (base_encode);
   GstCaps *caps, *allowed_caps;
+  gboolean is_nal_aligned = FALSE;
 
   caps = gst_caps_from_string (GST_CODEC_CAPS);
 
@@ -222,7 +223,7 @@ gst_vaapiencode_h264_get_caps (GstVaapiEncode * base_encode)
   allowed_caps =
       gst_pad_get_allowed_caps (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
   if (allowed_caps) {
-    const char *stream_format = NULL;
+    const char *stream_format = NULL, *alignment = NULL;
     GstStructure *structure;
     guint i, num_structures;
 
@@ -234,12 +235,27 @@ gst_vaapiencode_h264_get_caps (GstVaapiEncode * base_encode)
         continue;
       stream_format = gst_structure_get_string (structure, "stream-format");
     }
+    for (i = 0; !alignment && i < num_structures; i++) {
+      structure = gst_caps_get_structure (allowed_caps, i);
+      if (!gst_structure_has_field_typed (structure, "alignment",
+              G_TYPE_STRING))
+        continue;
+      alignment = gst_structure_get_string (structure, "alignment");
+    }
     encode->is_avc = stream_format && strcmp (stream_format, "avc") == 0;
+    is_nal_aligned = alignment && strcmp (alignment, "nal") == 0;
     gst_caps_unref (allowed_caps);
   }
   gst_caps_set_simple (caps, "stream-format", G_TYPE_STRING,
       encode->is_avc ? "avc" : "byte-stream", NULL);
 
+  /* Slice output is only supported in byte-stream format */
+  if (encode->is_avc)
+    is_nal_aligned = FALSE;
+  gst_caps_set_simple (caps, "alignment", G_TYPE_STRING,
+      is_nal_aligned ? "nal" : "au", NULL);
+  base_encode->slice_output_codec = is_nal_aligned ? GST_VAAPI_CODEC_H264 : 0;
+
   base_encode->need_codec_data = encode->is_avc;
 
   /* XXX: update profile and level information */
@@ -350,7 +366,7 @@ error:
 
 static GstFlowReturn
 gst_vaapiencode_h264_alloc_buffer (GstVaapiEncode * base_encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** out_buffer_ptr)
+    GstVaapiCodedBufferProxy * codedbuf_proxy, GstBuffer ** out_buffer_ptr)
 {
   GstVaapiEncodeH264 *const encode = GST_VAAPIENCODE_H264_CAST (base_encode);
   GstVaapiEncoderH264 *const encoder =
@@ -361,7 +377,7 @@ gst_vaapiencode_h264_alloc_buffer (GstVaapiEncode * base_encode,
 
   ret =
       GST_VAAPIENCODE_CLASS (gst_vaapiencode_h264_parent_class)->alloc_buffer
-      (base_encode, coded_buf, out_buffer_ptr);
+      (base_encode, codedbuf_proxy, out_buffer_ptr);
   if (ret != GST_FLOW_OK)
     return ret;
 
@@ -51,7 +51,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_vaapi_h265_encode_debug);
 #define GST_CODEC_CAPS                              \
   "video/x-h265, "                                  \
   "stream-format = (string) { hvc1, byte-stream }, " \
-  "alignment = (string) au"
+  "alignment = (string) { au, nal }"
 
 /* *INDENT-OFF* */
 static const char gst_vaapiencode_h265_sink_caps_str[] =
@@ -214,6 +214,7 @@ gst_vaapiencode_h265_get_caps (GstVaapiEncode * base_encode)
 {
   GstVaapiEncodeH265 *const encode = GST_VAAPIENCODE_H265_CAST (base_encode);
   GstCaps *caps, *allowed_caps;
+  gboolean is_nal_aligned = FALSE;
 
   caps = gst_caps_from_string (GST_CODEC_CAPS);
 
@@ -221,7 +222,7 @@ gst_vaapiencode_h265_get_caps (GstVaapiEncode * base_encode)
   allowed_caps =
       gst_pad_get_allowed_caps (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
   if (allowed_caps) {
-    const char *stream_format = NULL;
+    const char *stream_format = NULL, *alignment = NULL;
     GstStructure *structure;
     guint i, num_structures;
 
@@ -233,12 +234,27 @@ gst_vaapiencode_h265_get_caps (GstVaapiEncode * base_encode)
         continue;
       stream_format = gst_structure_get_string (structure, "stream-format");
     }
+    for (i = 0; !alignment && i < num_structures; i++) {
+      structure = gst_caps_get_structure (allowed_caps, i);
+      if (!gst_structure_has_field_typed (structure, "alignment",
+              G_TYPE_STRING))
+        continue;
+      alignment = gst_structure_get_string (structure, "alignment");
+    }
     encode->is_hvc = stream_format && strcmp (stream_format, "hvc1") == 0;
+    is_nal_aligned = alignment && strcmp (alignment, "nal") == 0;
     gst_caps_unref (allowed_caps);
   }
   gst_caps_set_simple (caps, "stream-format", G_TYPE_STRING,
       encode->is_hvc ? "hvc1" : "byte-stream", NULL);
 
+  /* Slice output is only supported in byte-stream format */
+  if (encode->is_hvc)
+    is_nal_aligned = FALSE;
+  gst_caps_set_simple (caps, "alignment", G_TYPE_STRING,
+      is_nal_aligned ? "nal" : "au", NULL);
+  base_encode->slice_output_codec = is_nal_aligned ? GST_VAAPI_CODEC_H265 : 0;
+
   base_encode->need_codec_data = encode->is_hvc;
 
   /* XXX: update profile and level information */
@@ -349,7 +365,7 @@ error:
 
 static GstFlowReturn
 gst_vaapiencode_h265_alloc_buffer (GstVaapiEncode * base_encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** out_buffer_ptr)
+    GstVaapiCodedBufferProxy * codedbuf_proxy, GstBuffer ** out_buffer_ptr)
 {
   GstVaapiEncodeH265 *const encode = GST_VAAPIENCODE_H265_CAST (base_encode);
   GstVaapiEncoderH265 *const encoder =
@@ -360,7 +376,7 @@ gst_vaapiencode_h265_alloc_buffer (GstVaapiEncode * base_encode,
 
   ret =
       GST_VAAPIENCODE_CLASS (gst_vaapiencode_h265_parent_class)->alloc_buffer
-      (base_encode, coded_buf, out_buffer_ptr);
+      (base_encode, codedbuf_proxy, out_buffer_ptr);
   if (ret != GST_FLOW_OK)
     return ret;
 
@@ -24,12 +24,15 @@
 
 #include "gstcompat.h"
 #include <gst/vaapi/gstvaapisurface_drm.h>
+#include <gst/vaapi/gstvaapicapscache.h>
 #include <gst/base/gstpushsrc.h>
 #include "gstvaapipluginbase.h"
 #include "gstvaapipluginutil.h"
 #include "gstvaapivideocontext.h"
 #include "gstvaapivideometa.h"
+#include "gstvaapivideobuffer.h"
 #include "gstvaapivideobufferpool.h"
+#include "gstvaapivideomemory.h"
 #if USE_GST_GL_HELPERS
 # include <gst/gl/gl.h>
 #endif
@@ -39,6 +42,15 @@
 
 #define BUFFER_POOL_SINK_MIN_BUFFERS 2
 
+/* Layout constraints for wrapping system memory into VA surfaces, as
+   commonly expected by VA drivers */
+#define USER_PTR_DATA_ALIGNMENT 4096
+#define USER_PTR_STRIDE_ALIGNMENT 128
+
+/* Maximum number of VA surfaces imported from other VA displays kept
+   around, each of them keeping its source surface alive */
+#define MAX_IMPORTED_SURFACES 64
+
 /* GstVideoContext interface */
 static void
 plugin_set_display (GstVaapiPluginBase * plugin, GstVaapiDisplay * display)
@@ -52,6 +64,9 @@ plugin_set_display (GstVaapiPluginBase * plugin, GstVaapiDisplay * display)
     gst_vaapi_display_replace (&plugin->display, NULL);
   } else {
     GST_INFO_OBJECT (plugin, "set display %" GST_PTR_FORMAT, display);
+    /* Allowed caps are memoized per display */
+    if (plugin->display != display)
+      gst_caps_replace (&plugin->allowed_raw_caps, NULL);
     gst_vaapi_display_replace (&plugin->display, display);
     plugin->display_type = gst_vaapi_display_get_display_type (display);
     gst_vaapi_plugin_base_set_display_name (plugin, display_name);
@@ -117,11 +132,73 @@ _set_cached_surface (GstBuffer * buf, GstVaapiSurface * surface)
       (GDestroyNotify) gst_vaapi_object_unref);
 }
 
+/* A VA surface wrapping system memory, along with the layout of the
+   pixels it was created for */
+typedef struct
+{
+  GstVaapiSurface *surface;
+  GstVideoInfo info;
+} UserPtrSurface;
+
+static void
+user_ptr_surface_free (UserPtrSurface * cached)
+{
+  gst_vaapi_object_unref (cached->surface);
+  g_slice_free (UserPtrSurface, cached);
+}
+
+/* Checks whether the pixels described by @a and @b are laid out the
+   same way in memory */
 static gboolean
-plugin_update_sinkpad_info_from_buffer (GstVaapiPluginBase * plugin,
-    GstBuffer * buf)
+video_info_same_layout (const GstVideoInfo * a, const GstVideoInfo * b)
+{
+  guint i;
+
+  if (gst_video_info_changed (a, b))
+    return FALSE;
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (a); i++) {
+    if (GST_VIDEO_INFO_PLANE_STRIDE (a, i) !=
+        GST_VIDEO_INFO_PLANE_STRIDE (b, i) ||
+        GST_VIDEO_INFO_PLANE_OFFSET (a, i) !=
+        GST_VIDEO_INFO_PLANE_OFFSET (b, i))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Returns the VA surface cached in @mem, if it was created on
+   @display for pixels laid out as described by @vip */
+static GstVaapiSurface *
+_get_cached_user_ptr_surface (GstMemory * mem, GstVaapiDisplay * display,
+    const GstVideoInfo * vip)
+{
+  UserPtrSurface *const cached = gst_mini_object_get_qdata (GST_MINI_OBJECT
+      (mem), g_quark_from_static_string ("GstVaapiUserPtrSurface"));
+
+  if (!cached || GST_VAAPI_OBJECT_DISPLAY (cached->surface) != display ||
+      !video_info_same_layout (&cached->info, vip))
+    return NULL;
+  return cached->surface;
+}
+
+/* Caches @surface in @mem, replacing any previous one. The surface is
+   released along with the memory */
+static void
+_set_cached_user_ptr_surface (GstMemory * mem, GstVaapiSurface * surface,
+    const GstVideoInfo * vip)
+{
+  UserPtrSurface *const cached = g_slice_new (UserPtrSurface);
+
+  cached->surface = surface;
+  cached->info = *vip;
+  gst_mini_object_set_qdata (GST_MINI_OBJECT (mem),
+      g_quark_from_static_string ("GstVaapiUserPtrSurface"), cached,
+      (GDestroyNotify) user_ptr_surface_free);
+}
+
+static gboolean
+video_info_update_from_buffer (GstVideoInfo * vip, GstBuffer * buf)
 {
-  GstVideoInfo *const vip = &plugin->sinkpad_info;
   GstVideoMeta *vmeta;
   guint i;
 
@@ -143,6 +220,13 @@ plugin_update_sinkpad_info_from_buffer (GstVaapiPluginBase * plugin,
   return TRUE;
 }
 
+static gboolean
+plugin_update_sinkpad_info_from_buffer (GstVaapiPluginBase * plugin,
+    GstBuffer * buf)
+{
+  return video_info_update_from_buffer (&plugin->sinkpad_info, buf);
+}
+
 static gboolean
 is_dma_buffer (GstBuffer * buf)
 {
@@ -217,6 +301,264 @@ error_create_proxy:
   }
 }
 
+/* Determines whether the VA surface backed by @meta belongs to a VA
+   display other than the @plugin one, e.g. when elements could not
+   share their display through a GstContext */
+static gboolean
+is_foreign_vaapi_meta (GstVaapiPluginBase * plugin, GstVaapiVideoMeta * meta)
+{
+  GstVaapiDisplay *const display = gst_vaapi_video_meta_get_display (meta);
+
+  if (!display || !plugin->display || display == plugin->display)
+    return FALSE;
+  return GST_VAAPI_DISPLAY_VADISPLAY (display) !=
+      GST_VAAPI_DISPLAY_VADISPLAY (plugin->display);
+}
+
+static GstVaapiSurface *
+plugin_get_imported_surface (GstVaapiPluginBase * plugin,
+    GstVaapiSurface * surface)
+{
+  GstVaapiSurface *imported_surface;
+
+  /* The imported surfaces hold a reference to their source surface,
+     so the latter can safely be used as key. Upstream pools cycle
+     through a fixed set of surfaces, which stays cached, while the
+     surfaces no longer sent are released one at a time */
+  if (!plugin->imported_surfaces) {
+    plugin->imported_surfaces =
+        gst_vaapi_lru_cache_new (MAX_IMPORTED_SURFACES, g_direct_hash,
+        g_direct_equal, NULL, (GDestroyNotify) gst_vaapi_object_unref);
+  }
+
+  imported_surface = gst_vaapi_lru_cache_lookup (plugin->imported_surfaces,
+      surface);
+  if (imported_surface &&
+      GST_VAAPI_OBJECT_DISPLAY (imported_surface) == plugin->display)
+    return imported_surface;
+
+  imported_surface = gst_vaapi_surface_import_dma_buf (plugin->display,
+      surface);
+  if (!imported_surface)
+    return NULL;
+  gst_vaapi_lru_cache_insert (plugin->imported_surfaces, surface,
+      imported_surface);
+
+  GST_DEBUG_OBJECT (plugin, "imported VA surface %" GST_VAAPI_ID_FORMAT
+      " from another display as %" GST_VAAPI_ID_FORMAT,
+      GST_VAAPI_ID_ARGS (GST_VAAPI_OBJECT_ID (surface)),
+      GST_VAAPI_ID_ARGS (GST_VAAPI_OBJECT_ID (imported_surface)));
+  return imported_surface;
+}
+
+/* Wraps the VA surface of @inbuf, which comes from another VA
+   display, into a new buffer with a VA surface of the @plugin display
+   sharing the same dma_buf. No pixels are copied. */
+static gboolean
+plugin_import_vaapi_buffer (GstVaapiPluginBase * plugin, GstBuffer * inbuf,
+    GstBuffer ** outbuf_ptr)
+{
+  GstVaapiVideoMeta *const meta = gst_buffer_get_vaapi_video_meta (inbuf);
+  GstVaapiVideoMeta *out_meta;
+  GstVaapiSurfaceProxy *src_proxy, *proxy;
+  GstVaapiSurface *surface;
+  const GstVaapiRectangle *rect;
+  GstVideoCropMeta *crop_meta;
+  GstBuffer *outbuf;
+
+  src_proxy = gst_vaapi_video_meta_get_surface_proxy (meta);
+  if (!src_proxy)
+    return FALSE;
+
+  surface = plugin_get_imported_surface (plugin,
+      GST_VAAPI_SURFACE_PROXY_SURFACE (src_proxy));
+  if (!surface)
+    return FALSE;
+
+  proxy = gst_vaapi_surface_proxy_new (surface);
+  if (!proxy)
+    return FALSE;
+  rect = gst_vaapi_surface_proxy_get_crop_rect (src_proxy);
+  if (rect)
+    gst_vaapi_surface_proxy_set_crop_rect (proxy, rect);
+  outbuf = gst_vaapi_video_buffer_new_with_surface_proxy (proxy);
+  gst_vaapi_surface_proxy_unref (proxy);
+  if (!outbuf)
+    return FALSE;
+
+  out_meta = gst_buffer_get_vaapi_video_meta (outbuf);
+  gst_vaapi_video_meta_set_render_flags (out_meta,
+      gst_vaapi_video_meta_get_render_flags (meta));
+  rect = gst_vaapi_video_meta_get_render_rect (meta);
+  if (rect)
+    gst_vaapi_video_meta_set_render_rect (out_meta, rect);
+
+  crop_meta = gst_buffer_get_video_crop_meta (inbuf);
+  if (crop_meta) {
+    GstVideoCropMeta *const out_crop_meta =
+        gst_buffer_add_video_crop_meta (outbuf);
+    if (out_crop_meta)
+      *out_crop_meta = *crop_meta;
+  }
+
+  /* Keep the source surface out of its pool while it is in use */
+  gst_buffer_add_parent_buffer_meta (outbuf, inbuf);
+  gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_FLAGS |
+      GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+  *outbuf_ptr = outbuf;
+  return TRUE;
+}
+
+/* Determines whether the system memory @mem, holding the pixels
+   described by @vip, could back a VA surface as is */
+static gboolean
+is_user_ptr_compatible (GstVaapiPluginBase * plugin, GstMemory * mem,
+    const GstVideoInfo * vip)
+{
+  GstVaapiVideoAllocator *allocator;
+  GstMapInfo map_info;
+  gboolean is_aligned;
+  guint i;
+
+  if (!GST_VAAPI_IS_VIDEO_ALLOCATOR (plugin->sinkpad_allocator))
+    return FALSE;
+  allocator = GST_VAAPI_VIDEO_ALLOCATOR_CAST (plugin->sinkpad_allocator);
+
+  /* The surface shall have the format the pool surfaces would have */
+  if (GST_VIDEO_INFO_FORMAT (&allocator->surface_info) !=
+      GST_VIDEO_INFO_FORMAT (vip))
+    return FALSE;
+
+  /* The memory shall stay at the same address while it is alive. This
+     is not the case of fd memory, which is unmapped on the last unmap
+     unless it was allocated with GST_FD_MEMORY_FLAG_KEEP_MAPPED, and
+     that flag cannot be queried */
+  if (!gst_memory_is_type (mem, GST_ALLOCATOR_SYSMEM))
+    return FALSE;
+
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (vip); i++) {
+    if (GST_VIDEO_INFO_PLANE_STRIDE (vip, i) % USER_PTR_STRIDE_ALIGNMENT)
+      return FALSE;
+  }
+
+  if (!gst_memory_map (mem, &map_info, GST_MAP_READ))
+    return FALSE;
+  is_aligned = ((guintptr) map_info.data % USER_PTR_DATA_ALIGNMENT) == 0 &&
+      map_info.size >= GST_VIDEO_INFO_SIZE (vip);
+  gst_memory_unmap (mem, &map_info);
+  return is_aligned;
+}
+
+typedef struct
+{
+  GstMemory *mem;
+  GstMapInfo map_info;
+} UserPtrMapping;
+
+static void
+user_ptr_mapping_free (UserPtrMapping * mapping)
+{
+  gst_memory_unmap (mapping->mem, &mapping->map_info);
+  gst_memory_unref (mapping->mem);
+  g_slice_free (UserPtrMapping, mapping);
+}
+
+/* Wraps the system memory of @inbuf into a VA surface, without copy.
+   The memory stays mapped for reading while the surface proxy is in
+   use, so that upstream cannot map it for writing meanwhile */
+static gboolean
+plugin_bind_user_ptr_to_vaapi_buffer (GstVaapiPluginBase * plugin,
+    GstBuffer * inbuf, GstBuffer * outbuf)
+{
+  GstVideoInfo vi = plugin->sinkpad_info;
+  GstVaapiVideoMeta *meta;
+  GstVaapiSurface *surface;
+  GstVaapiSurfaceProxy *proxy;
+  UserPtrMapping *mapping;
+  GstMemory *mem;
+
+  if (!plugin->sinkpad_can_user_ptr || gst_buffer_n_memory (inbuf) != 1)
+    return FALSE;
+
+  mem = gst_buffer_peek_memory (inbuf, 0);
+  if (!video_info_update_from_buffer (&vi, inbuf) ||
+      !is_user_ptr_compatible (plugin, mem, &vi))
+    return FALSE;
+
+  meta = gst_buffer_get_vaapi_video_meta (outbuf);
+  g_return_val_if_fail (meta != NULL, FALSE);
+
+  /* A read mapping fails if upstream still has the memory mapped for
+     writing, and prevents it from doing so until it is released */
+  mapping = g_slice_new (UserPtrMapping);
+  if (!gst_memory_map (mem, &mapping->map_info, GST_MAP_READ)) {
+    g_slice_free (UserPtrMapping, mapping);
+    return FALSE;
+  }
+  mapping->mem = gst_memory_ref (mem);
+
+  /* Check for a VASurface cached in the memory */
+  surface = _get_cached_user_ptr_surface (mem, plugin->display, &vi);
+  if (!surface) {
+    /* otherwise create one and cache it */
+    surface = gst_vaapi_surface_new_with_user_ptr (plugin->display,
+        mapping->map_info.data, &vi);
+    if (!surface)
+      goto error_create_surface;
+    _set_cached_user_ptr_surface (mem, surface, &vi);
+  }
+
+  proxy = gst_vaapi_surface_proxy_new (surface);
+  if (!proxy) {
+    user_ptr_mapping_free (mapping);
+    return FALSE;
+  }
+  gst_vaapi_surface_proxy_set_destroy_notify (proxy,
+      (GDestroyNotify) user_ptr_mapping_free, mapping);
+  gst_vaapi_video_meta_set_surface_proxy (meta, proxy);
+  gst_vaapi_surface_proxy_unref (proxy);
+  gst_buffer_add_parent_buffer_meta (outbuf, inbuf);
+  return TRUE;
+
+  /* ERRORS */
+error_create_surface:
+  {
+    user_ptr_mapping_free (mapping);
+    GST_INFO_OBJECT (plugin, "failed to create VA surface from system "
+        "memory, disabling zero-copy upload");
+    plugin->sinkpad_can_user_ptr = FALSE;
+    return FALSE;
+  }
+}
+
+/* Returns the number of copies needed to upload a raw frame into the
+   pool buffer @outbuf: one into the derived image, or two through an
+   intermediate VA image */
+static guint
+get_upload_num_copies (GstBuffer * outbuf)
+{
+  GstMemory *const mem = gst_buffer_peek_memory (outbuf, 0);
+
+  if (mem && GST_VAAPI_IS_VIDEO_ALLOCATOR (mem->allocator) &&
+      GST_VAAPI_VIDEO_MEMORY_CAST (mem)->usage_flag ==
+      GST_VAAPI_IMAGE_USAGE_FLAG_NATIVE_FORMATS)
+    return 2;
+  return 1;
+}
+
+static void
+plugin_reset_input_stats (GstVaapiPluginBase * plugin)
+{
+  if (plugin->sinkpad_num_frames > 0) {
+    GST_INFO_OBJECT (plugin, "uploaded %" G_GUINT64_FORMAT " raw frames "
+        "with %" G_GUINT64_FORMAT " copies (%.2f per frame)",
+        plugin->sinkpad_num_frames, plugin->sinkpad_num_copies,
+        (gdouble) plugin->sinkpad_num_copies / plugin->sinkpad_num_frames);
+  }
+  plugin->sinkpad_num_frames = 0;
+  plugin->sinkpad_num_copies = 0;
+}
+
 static void
 plugin_reset_texture_map (GstVaapiPluginBase * plugin)
 {
@@ -293,6 +635,11 @@ gst_vaapi_plugin_base_close (GstVaapiPluginBase * plugin)
   gst_object_replace (&plugin->gl_display, NULL);
   gst_object_replace (&plugin->gl_other_context, NULL);
 
+  plugin_reset_input_stats (plugin);
+  if (plugin->imported_surfaces) {
+    gst_vaapi_lru_cache_free (plugin->imported_surfaces);
+    plugin->imported_surfaces = NULL;
+  }
   gst_caps_replace (&plugin->sinkpad_caps, NULL);
   gst_video_info_init (&plugin->sinkpad_info);
   if (plugin->sinkpad_buffer_pool) {
@@ -385,6 +732,7 @@ gst_vaapi_plugin_base_ensure_display (GstVaapiPluginBase * plugin)
   if (gst_vaapi_plugin_base_has_display_type (plugin, plugin->display_type_req))
     return TRUE;
   gst_vaapi_display_replace (&plugin->display, NULL);
+  gst_caps_replace (&plugin->allowed_raw_caps, NULL);
 
   if (!gst_vaapi_ensure_display (GST_ELEMENT (plugin),
           plugin->display_type_req))
@@ -752,6 +1100,7 @@ ensure_sinkpad_buffer_pool (GstVaapiPluginBase * plugin, GstCaps * caps)
 
   plugin->sinkpad_buffer_pool = pool;
   plugin->sinkpad_buffer_size = size;
+  plugin->sinkpad_can_user_ptr = TRUE;
   return TRUE;
 }
 
@@ -801,7 +1150,11 @@ gst_vaapi_plugin_base_set_caps (GstVaapiPluginBase * plugin, GstCaps * incaps,
  * @plugin: a #GstVaapiPluginBase
  * @query: the allocation query to configure
  *
- * Proposes allocation parameters to the upstream elements.
+ * Proposes allocation parameters to the upstream elements. The
+ * #GstVideoCropMeta is advertised too, so that upstream elements can
+ * crop without copying pixels. Elements that cannot honor it in their
+ * current configuration, e.g. encoders for codecs without a cropping
+ * syntax, remove it from @query afterwards.
  *
  * Returns: %TRUE if successful, %FALSE otherwise.
  */
@@ -826,6 +1179,7 @@ gst_vaapi_plugin_base_propose_allocation (GstVaapiPluginBase * plugin,
 
   gst_query_add_allocation_meta (query, GST_VAAPI_VIDEO_META_API_TYPE, NULL);
   gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+  gst_query_add_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE, NULL);
   return TRUE;
 
   /* ERRORS */
@@ -988,7 +1342,13 @@ error:
  * Acquires the sink pad (input) buffer as a VA surface backed
  * buffer. This is mostly useful for raw YUV buffers, as source
  * buffers that are already backed as a VA surface are passed
- * verbatim.
+ * verbatim. VA surfaces from another VA display are imported into
+ * the @plugin display through dma_buf, without copying pixels.
+ *
+ * Raw buffers are wrapped without copy whenever possible, i.e. for
+ * dma_buf memory, or for suitably aligned system memory. Otherwise,
+ * they are copied into a pool buffer, and the number of copies is
+ * accounted for in the upload statistics logged at close time.
  *
  * Returns: #GST_FLOW_OK if the buffer could be acquired
  */
@@ -1006,6 +1366,12 @@ gst_vaapi_plugin_base_get_input_buffer (GstVaapiPluginBase * plugin,
 
   meta = gst_buffer_get_vaapi_video_meta (inbuf);
   if (meta) {
+    if (is_foreign_vaapi_meta (plugin, meta)) {
+      if (plugin_import_vaapi_buffer (plugin, inbuf, outbuf_ptr))
+        return GST_FLOW_OK;
+      GST_WARNING_OBJECT (plugin, "failed to import VA surface from another "
+          "display through dma_buf");
+    }
     *outbuf_ptr = gst_buffer_ref (inbuf);
     return GST_FLOW_OK;
   }
@@ -1025,12 +1391,17 @@ gst_vaapi_plugin_base_get_input_buffer (GstVaapiPluginBase * plugin,
           &outbuf, NULL) != GST_FLOW_OK)
     goto error_create_buffer;
 
+  plugin->sinkpad_num_frames++;
+
   if (is_dma_buffer (inbuf)) {
     if (!plugin_bind_dma_to_vaapi_buffer (plugin, inbuf, outbuf))
       goto error_bind_dma_buffer;
     goto done;
   }
 
+  if (plugin_bind_user_ptr_to_vaapi_buffer (plugin, inbuf, outbuf))
+    goto done;
+
   if (!gst_video_frame_map (&src_frame, &plugin->sinkpad_info, inbuf,
           GST_MAP_READ))
     goto error_map_src_buffer;
@@ -1045,6 +1416,11 @@ gst_vaapi_plugin_base_get_input_buffer (GstVaapiPluginBase * plugin,
   if (!success)
     goto error_copy_buffer;
 
+  plugin->sinkpad_num_copies += get_upload_num_copies (outbuf);
+  GST_LOG_OBJECT (plugin, "copied raw frame, %" G_GUINT64_FORMAT " copies "
+      "for %" G_GUINT64_FORMAT " frames so far", plugin->sinkpad_num_copies,
+      plugin->sinkpad_num_frames);
+
 done:
   gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_FLAGS |
       GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
@@ -1204,23 +1580,19 @@ gst_vaapi_plugin_base_create_gl_context (GstVaapiPluginBase * plugin)
 #endif
 }
 
-static gboolean
-ensure_allowed_raw_caps (GstVaapiPluginBase * plugin)
+/* Probes the formats that can be uploaded into VA surfaces */
+static GstCaps *
+build_allowed_raw_caps (gpointer user_data)
 {
+  GstVaapiDisplay *const display = GST_VAAPI_DISPLAY (user_data);
   GArray *formats, *out_formats;
   GstVaapiSurface *surface;
-  GstVaapiDisplay *display;
   guint i;
-  GstCaps *out_caps;
-  gboolean ret = FALSE;
-
-  if (plugin->allowed_raw_caps)
-    return TRUE;
+  GstCaps *out_caps = NULL;
 
   out_formats = formats = NULL;
   surface = NULL;
 
-  display = gst_vaapi_display_ref (plugin->display);
   formats = gst_vaapi_display_get_image_formats (display);
   if (!formats)
     goto bail;
@@ -1250,12 +1622,6 @@ ensure_allowed_raw_caps (GstVaapiPluginBase * plugin)
   }
 
   out_caps = gst_vaapi_video_format_new_template_caps_from_list (out_formats);
-  if (!out_caps)
-    goto bail;
-
-  gst_caps_replace (&plugin->allowed_raw_caps, out_caps);
-  gst_caps_unref (out_caps);
-  ret = TRUE;
 
 bail:
   if (formats)
@@ -1264,9 +1630,30 @@ bail:
     g_array_unref (out_formats);
   if (surface)
     gst_vaapi_object_unref (surface);
+
+  return out_caps;
+}
+
+static gboolean
+ensure_allowed_raw_caps (GstVaapiPluginBase * plugin)
+{
+  GstVaapiDisplay *display;
+  GstCaps *out_caps;
+
+  if (plugin->allowed_raw_caps)
+    return TRUE;
+
+  /* The probe is costly, so it is shared by all elements */
+  display = gst_vaapi_display_ref (plugin->display);
+  out_caps = gst_vaapi_caps_cache_get (gst_vaapi_display_get_caps_cache
+      (display), "raw", NULL, build_allowed_raw_caps, display);
   gst_vaapi_display_unref (display);
+  if (!out_caps)
+    return FALSE;
 
-  return ret;
+  gst_caps_replace (&plugin->allowed_raw_caps, out_caps);
+  gst_caps_unref (out_caps);
+  return TRUE;
 }
 
 /**
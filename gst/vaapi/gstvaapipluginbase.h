@@ -30,6 +30,7 @@
 #include <gst/video/gstvideoencoder.h>
 #include <gst/video/gstvideosink.h>
 #include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapilrucache.h>
 
 #if USE_GST_GL_HELPERS
 # include <gst/gl/gstglcontext.h>
@@ -130,6 +131,10 @@ struct _GstVaapiPluginBase
   GstVideoInfo sinkpad_info;
   GstBufferPool *sinkpad_buffer_pool;
   guint sinkpad_buffer_size;
+  gboolean sinkpad_can_user_ptr;
+  guint64 sinkpad_num_frames;
+  guint64 sinkpad_num_copies;
+  GstVaapiLruCache *imported_surfaces;
 
   GstPad *srcpad;
   GstCaps *srcpad_caps;
@@ -39,6 +39,7 @@
 #if USE_WAYLAND
 # include <gst/vaapi/gstvaapidisplay_wayland.h>
 #endif
+#include <gst/vaapi/gstvaapiprofiler.h>
 #include "gstvaapipluginutil.h"
 #include "gstvaapipluginbase.h"
 
@@ -344,6 +345,36 @@ gst_vaapi_handle_context_query (GstElement * element, GstQuery * query)
   return TRUE;
 }
 
+/* Answers a GST_VAAPI_PROFILER_QUERY_NAME custom query, if the VA calls
+   of the display of the element were profiled */
+gboolean
+gst_vaapi_handle_profiler_query (GstElement * element, GstQuery * query)
+{
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (element);
+  const GstStructure *structure;
+  gchar *json;
+
+  g_return_val_if_fail (query != NULL, FALSE);
+
+  structure = gst_query_get_structure (query);
+  if (!structure
+      || !gst_structure_has_name (structure, GST_VAAPI_PROFILER_QUERY_NAME))
+    return FALSE;
+
+  if (!plugin->display)
+    return FALSE;
+
+  json = gst_vaapi_profiler_to_json (GST_VAAPI_DISPLAY_VADISPLAY
+      (plugin->display));
+  if (!json)
+    return FALSE;
+
+  gst_structure_set (gst_query_writable_structure (query), "json",
+      G_TYPE_STRING, json, NULL);
+  g_free (json);
+  return TRUE;
+}
+
 gboolean
 gst_vaapi_append_surface_caps (GstCaps * out_caps, GstCaps * in_caps)
 {
@@ -37,6 +37,14 @@ G_GNUC_INTERNAL
 gboolean
 gst_vaapi_handle_context_query (GstElement * element, GstQuery * query);
 
+/* The name of the structure of the custom query that retrieves the VA
+   call statistics of the display of an element, as a "json" string */
+#define GST_VAAPI_PROFILER_QUERY_NAME "GstVaapiProfilerQuery"
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_handle_profiler_query (GstElement * element, GstQuery * query);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_append_surface_caps (GstCaps * out_caps, GstCaps * in_caps);
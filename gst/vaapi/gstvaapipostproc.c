@@ -37,6 +37,7 @@
 
 #include "gstcompat.h"
 #include <gst/video/video.h>
+#include <gst/vaapi/gstvaapicapscache.h>
 
 #include "gstvaapipostproc.h"
 #include "gstvaapipostprocutil.h"
@@ -151,49 +152,26 @@ gst_vaapi_deinterlace_mode_get_type (void)
 static void
 ds_reset (GstVaapiDeinterlaceState * ds)
 {
-  guint i;
-
-  for (i = 0; i < G_N_ELEMENTS (ds->buffers); i++)
-    gst_buffer_replace (&ds->buffers[i], NULL);
-  ds->buffers_index = 0;
+  gst_vaapi_deinterlace_history_clear (&ds->history);
   ds->num_surfaces = 0;
   ds->deint = FALSE;
-  ds->tff = FALSE;
 }
 
 static void
 ds_add_buffer (GstVaapiDeinterlaceState * ds, GstBuffer * buf)
 {
-  gst_buffer_replace (&ds->buffers[ds->buffers_index], buf);
-  ds->buffers_index = (ds->buffers_index + 1) % G_N_ELEMENTS (ds->buffers);
-}
+  GstVaapiVideoMeta *const meta = gst_buffer_get_vaapi_video_meta (buf);
 
-static inline GstBuffer *
-ds_get_buffer (GstVaapiDeinterlaceState * ds, guint index)
-{
-  /* Note: the index increases towards older buffers.
-     i.e. buffer at index 0 means the immediately preceding buffer
-     in the history, buffer at index 1 means the one preceding the
-     surface at index 0, etc. */
-  const guint n = ds->buffers_index + G_N_ELEMENTS (ds->buffers) - index - 1;
-  return ds->buffers[n % G_N_ELEMENTS (ds->buffers)];
+  if (meta)
+    gst_vaapi_deinterlace_history_push (&ds->history, buf,
+        gst_vaapi_video_meta_get_surface (meta));
 }
 
 static void
 ds_set_surfaces (GstVaapiDeinterlaceState * ds)
 {
-  GstVaapiVideoMeta *meta;
-  guint i;
-
-  ds->num_surfaces = 0;
-  for (i = 0; i < G_N_ELEMENTS (ds->buffers); i++) {
-    GstBuffer *const buf = ds_get_buffer (ds, i);
-    if (!buf)
-      break;
-
-    meta = gst_buffer_get_vaapi_video_meta (buf);
-    ds->surfaces[ds->num_surfaces++] = gst_vaapi_video_meta_get_surface (meta);
-  }
+  ds->num_surfaces =
+      gst_vaapi_deinterlace_history_get_surfaces (&ds->history, ds->surfaces);
 }
 
 static GstVaapiFilterOpInfo *
@@ -319,6 +297,7 @@ gst_vaapipostproc_stop (GstBaseTransform * trans)
   gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (postproc));
 
   postproc->field_duration = GST_CLOCK_TIME_NONE;
+  gst_vaapi_frame_decimator_reset (&postproc->decimator);
   gst_video_info_init (&postproc->sinkpad_info);
   gst_video_info_init (&postproc->srcpad_info);
   gst_video_info_init (&postproc->filter_pool_info);
@@ -355,6 +334,68 @@ should_deinterlace_buffer (GstVaapiPostproc * postproc, GstBuffer * buf)
   return FALSE;
 }
 
+#define OUTPUT_FIRST_FIELD  (1U << 0)
+#define OUTPUT_SECOND_FIELD (1U << 1)
+
+/*
+ * OutputFields:
+ * @mask: the fields to output, as OUTPUT_*_FIELD flags
+ * @timestamp: the timestamps of the first and second output fields
+ * @duration: the durations of the first and second output fields
+ *
+ * The output frames produced from one input buffer. When
+ * deinterlacing, each field yields one output frame, the second one
+ * being returned in the output buffer. Otherwise, the single output
+ * frame is accounted as the second field.
+ */
+typedef struct
+{
+  guint mask;
+  GstClockTime timestamp[2];
+  GstClockTime duration[2];
+} OutputFields;
+
+/* Determines the output frames of @buf, dropping those that are not
+   needed for the output frame rate. Returns the mask of kept fields */
+static guint
+schedule_output_fields (GstVaapiPostproc * postproc, GstBuffer * buf,
+    OutputFields * fields)
+{
+  GstVaapiFrameDecimator *const decimator = &postproc->decimator;
+  const GstClockTime timestamp = GST_BUFFER_TIMESTAMP (buf);
+  guint i;
+
+  if (postproc->flags & GST_VAAPI_POSTPROC_FLAG_DEINTERLACE) {
+    fields->mask = OUTPUT_FIRST_FIELD | OUTPUT_SECOND_FIELD;
+    fields->timestamp[0] = timestamp;
+    fields->duration[0] = postproc->field_duration;
+    fields->timestamp[1] = GST_CLOCK_TIME_IS_VALID (timestamp) ?
+        timestamp + postproc->field_duration : GST_CLOCK_TIME_NONE;
+    fields->duration[1] = postproc->field_duration;
+  } else {
+    fields->mask = OUTPUT_SECOND_FIELD;
+    fields->timestamp[0] = GST_CLOCK_TIME_NONE;
+    fields->duration[0] = GST_CLOCK_TIME_NONE;
+    fields->timestamp[1] = timestamp;
+    fields->duration[1] = GST_BUFFER_DURATION (buf);
+  }
+
+  if (!gst_vaapi_frame_decimator_is_active (decimator))
+    return fields->mask;
+
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT))
+    gst_vaapi_frame_decimator_reset (decimator);
+
+  for (i = 0; i < G_N_ELEMENTS (fields->timestamp); i++) {
+    const guint field = 1U << i;
+    if ((fields->mask & field) && !gst_vaapi_frame_decimator_keep (decimator,
+            fields->timestamp[i], &fields->timestamp[i],
+            &fields->duration[i]))
+      fields->mask &= ~field;
+  }
+  return fields->mask;
+}
+
 static GstBuffer *
 create_output_buffer (GstVaapiPostproc * postproc)
 {
@@ -599,7 +640,7 @@ gst_vaapipostproc_set_passthrough (GstBaseTransform * trans)
 
 static GstFlowReturn
 gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
-    GstBuffer * outbuf)
+    GstBuffer * outbuf, const OutputFields * fields)
 {
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
   GstVaapiDeinterlaceState *const ds = &postproc->deinterlace_state;
@@ -607,9 +648,8 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
   GstVaapiSurface *inbuf_surface, *outbuf_surface;
   GstVaapiSurfaceProxy *proxy;
   GstVaapiFilterStatus status;
-  GstClockTime timestamp;
   GstFlowReturn ret;
-  GstBuffer *fieldbuf;
+  GstBuffer *fieldbuf = NULL;
   GstVaapiDeinterlaceMethod deint_method;
   guint flags, deint_flags;
   gboolean tff, deint, deint_refs, deint_changed;
@@ -634,53 +674,27 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
     crop_rect = (GstVaapiRectangle *)
         gst_vaapi_video_meta_get_render_rect (inbuf_meta);
 
-  timestamp = GST_BUFFER_TIMESTAMP (inbuf);
   tff = GST_BUFFER_FLAG_IS_SET (inbuf, GST_VIDEO_BUFFER_FLAG_TFF);
   deint = should_deinterlace_buffer (postproc, inbuf);
 
-  /* Drop references if deinterlacing conditions changed */
+  /* Drop references only if they no longer precede this frame. The
+     frames processed without deinterlacing were not kept, but a
+     change of field order does not break the continuity */
   deint_changed = deint != ds->deint;
-  if (deint_changed || (ds->num_surfaces > 0 && tff != ds->tff))
-    ds_reset (ds);
+  if (deint_changed)
+    gst_vaapi_deinterlace_history_invalidate (&ds->history);
+  else if (deint)
+    gst_vaapi_deinterlace_history_check (&ds->history, inbuf);
 
   deint_method = postproc->deinterlace_method;
   deint_refs = deint_method_is_advanced (deint_method);
-  if (deint_refs && 0) {
-    GstBuffer *const prev_buf = ds_get_buffer (ds, 0);
-    GstClockTime prev_pts, pts = GST_BUFFER_TIMESTAMP (inbuf);
-    /* Reset deinterlacing state when there is a discontinuity */
-    if (prev_buf && (prev_pts = GST_BUFFER_TIMESTAMP (prev_buf)) != pts) {
-      const GstClockTimeDiff pts_diff = GST_CLOCK_DIFF (prev_pts, pts);
-      if (pts_diff < 0 || (postproc->field_duration > 0 &&
-              pts_diff >= postproc->field_duration * 3 - 1))
-        ds_reset (ds);
-    }
-  }
-
   ds->deint = deint;
-  ds->tff = tff;
 
   flags = gst_vaapi_video_meta_get_render_flags (inbuf_meta) &
       ~GST_VAAPI_PICTURE_STRUCTURE_MASK;
 
   /* First field */
   if (postproc->flags & GST_VAAPI_POSTPROC_FLAG_DEINTERLACE) {
-    fieldbuf = create_output_buffer (postproc);
-    if (!fieldbuf)
-      goto error_create_buffer;
-
-    outbuf_meta = gst_buffer_get_vaapi_video_meta (fieldbuf);
-    if (!outbuf_meta)
-      goto error_create_meta;
-
-    proxy =
-        gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
-        (postproc->filter_pool));
-    if (!proxy)
-      goto error_create_proxy;
-    gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
-    gst_vaapi_surface_proxy_unref (proxy);
-
     if (deint) {
       deint_flags = (tff ? GST_VAAPI_DEINTERLACE_FLAG_TOPFIELD : 0);
       if (tff)
@@ -708,6 +722,28 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
               deint_method, 0))
         goto error_op_deinterlace;
     }
+  }
+
+  if (fields->mask & OUTPUT_FIRST_FIELD) {
+    /* Render into the output buffer if the second field is dropped */
+    if (fields->mask & OUTPUT_SECOND_FIELD)
+      fieldbuf = create_output_buffer (postproc);
+    else
+      fieldbuf = gst_buffer_ref (outbuf);
+    if (!fieldbuf)
+      goto error_create_buffer;
+
+    outbuf_meta = gst_buffer_get_vaapi_video_meta (fieldbuf);
+    if (!outbuf_meta)
+      goto error_create_meta;
+
+    proxy =
+        gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
+        (postproc->filter_pool));
+    if (!proxy)
+      goto error_create_proxy;
+    gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
+    gst_vaapi_surface_proxy_unref (proxy);
 
     outbuf_surface = gst_vaapi_video_meta_get_surface (outbuf_meta);
     gst_vaapi_filter_set_cropping_rectangle (postproc->filter, crop_rect);
@@ -716,8 +752,13 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
     if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
       goto error_process_vpp;
 
-    GST_BUFFER_TIMESTAMP (fieldbuf) = timestamp;
-    GST_BUFFER_DURATION (fieldbuf) = postproc->field_duration;
+    GST_BUFFER_TIMESTAMP (fieldbuf) = fields->timestamp[0];
+    GST_BUFFER_DURATION (fieldbuf) = fields->duration[0];
+    if (!(fields->mask & OUTPUT_SECOND_FIELD)) {
+      gst_buffer_unref (fieldbuf);
+      goto done;
+    }
+
     ret = gst_pad_push (trans->srcpad, fieldbuf);
     if (ret != GST_FLOW_OK)
       goto error_push_buffer;
@@ -765,11 +806,10 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
 
   if (!(postproc->flags & GST_VAAPI_POSTPROC_FLAG_DEINTERLACE))
     gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
-  else {
-    GST_BUFFER_TIMESTAMP (outbuf) = timestamp + postproc->field_duration;
-    GST_BUFFER_DURATION (outbuf) = postproc->field_duration;
-  }
+  GST_BUFFER_TIMESTAMP (outbuf) = fields->timestamp[1];
+  GST_BUFFER_DURATION (outbuf) = fields->duration[1];
 
+done:
   if (deint && deint_refs)
     ds_add_buffer (ds, inbuf);
   postproc->use_vpp = TRUE;
@@ -821,11 +861,10 @@ error_push_buffer:
 
 static GstFlowReturn
 gst_vaapipostproc_process (GstBaseTransform * trans, GstBuffer * inbuf,
-    GstBuffer * outbuf)
+    GstBuffer * outbuf, const OutputFields * fields)
 {
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
   GstVaapiVideoMeta *meta;
-  GstClockTime timestamp;
   GstFlowReturn ret;
   GstBuffer *fieldbuf;
   guint fieldbuf_flags, outbuf_flags, flags;
@@ -835,7 +874,6 @@ gst_vaapipostproc_process (GstBaseTransform * trans, GstBuffer * inbuf,
   if (!meta)
     goto error_invalid_buffer;
 
-  timestamp = GST_BUFFER_TIMESTAMP (inbuf);
   tff = GST_BUFFER_FLAG_IS_SET (inbuf, GST_VIDEO_BUFFER_FLAG_TFF);
   deint = should_deinterlace_buffer (postproc, inbuf);
 
@@ -843,24 +881,33 @@ gst_vaapipostproc_process (GstBaseTransform * trans, GstBuffer * inbuf,
       ~GST_VAAPI_PICTURE_STRUCTURE_MASK;
 
   /* First field */
-  fieldbuf = create_output_buffer (postproc);
-  if (!fieldbuf)
-    goto error_create_buffer;
-  append_output_buffer_metadata (postproc, fieldbuf, inbuf, 0);
+  if (fields->mask & OUTPUT_FIRST_FIELD) {
+    /* Use the output buffer if the second field is dropped */
+    if (fields->mask & OUTPUT_SECOND_FIELD)
+      fieldbuf = create_output_buffer (postproc);
+    else
+      fieldbuf = outbuf;
+    if (!fieldbuf)
+      goto error_create_buffer;
+    append_output_buffer_metadata (postproc, fieldbuf, inbuf, 0);
 
-  meta = gst_buffer_get_vaapi_video_meta (fieldbuf);
-  fieldbuf_flags = flags;
-  fieldbuf_flags |= deint ? (tff ?
-      GST_VAAPI_PICTURE_STRUCTURE_TOP_FIELD :
-      GST_VAAPI_PICTURE_STRUCTURE_BOTTOM_FIELD) :
-      GST_VAAPI_PICTURE_STRUCTURE_FRAME;
-  gst_vaapi_video_meta_set_render_flags (meta, fieldbuf_flags);
+    meta = gst_buffer_get_vaapi_video_meta (fieldbuf);
+    fieldbuf_flags = flags;
+    fieldbuf_flags |= deint ? (tff ?
+        GST_VAAPI_PICTURE_STRUCTURE_TOP_FIELD :
+        GST_VAAPI_PICTURE_STRUCTURE_BOTTOM_FIELD) :
+        GST_VAAPI_PICTURE_STRUCTURE_FRAME;
+    gst_vaapi_video_meta_set_render_flags (meta, fieldbuf_flags);
 
-  GST_BUFFER_TIMESTAMP (fieldbuf) = timestamp;
-  GST_BUFFER_DURATION (fieldbuf) = postproc->field_duration;
-  ret = gst_pad_push (trans->srcpad, fieldbuf);
-  if (ret != GST_FLOW_OK)
-    goto error_push_buffer;
+    GST_BUFFER_TIMESTAMP (fieldbuf) = fields->timestamp[0];
+    GST_BUFFER_DURATION (fieldbuf) = fields->duration[0];
+    if (fieldbuf == outbuf)
+      return GST_FLOW_OK;
+
+    ret = gst_pad_push (trans->srcpad, fieldbuf);
+    if (ret != GST_FLOW_OK)
+      goto error_push_buffer;
+  }
 
   /* Second field */
   append_output_buffer_metadata (postproc, outbuf, inbuf, 0);
@@ -873,8 +920,8 @@ gst_vaapipostproc_process (GstBaseTransform * trans, GstBuffer * inbuf,
       GST_VAAPI_PICTURE_STRUCTURE_FRAME;
   gst_vaapi_video_meta_set_render_flags (meta, outbuf_flags);
 
-  GST_BUFFER_TIMESTAMP (outbuf) = timestamp + postproc->field_duration;
-  GST_BUFFER_DURATION (outbuf) = postproc->field_duration;
+  GST_BUFFER_TIMESTAMP (outbuf) = fields->timestamp[1];
+  GST_BUFFER_DURATION (outbuf) = fields->duration[1];
   return GST_FLOW_OK;
 
   /* ERRORS */
@@ -898,7 +945,7 @@ error_push_buffer:
 
 static GstFlowReturn
 gst_vaapipostproc_passthrough (GstBaseTransform * trans, GstBuffer * inbuf,
-    GstBuffer * outbuf)
+    GstBuffer * outbuf, const OutputFields * fields)
 {
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
   GstVaapiVideoMeta *meta;
@@ -910,6 +957,10 @@ gst_vaapipostproc_passthrough (GstBaseTransform * trans, GstBuffer * inbuf,
 
   append_output_buffer_metadata (postproc, outbuf, inbuf,
       GST_BUFFER_COPY_TIMESTAMPS);
+  if (gst_vaapi_frame_decimator_is_active (&postproc->decimator)) {
+    GST_BUFFER_TIMESTAMP (outbuf) = fields->timestamp[1];
+    GST_BUFFER_DURATION (outbuf) = fields->duration[1];
+  }
   return GST_FLOW_OK;
 
   /* ERRORS */
@@ -965,9 +1016,15 @@ gst_vaapipostproc_update_sink_caps (GstVaapiPostproc * postproc, GstCaps * caps,
   deinterlace = is_deinterlace_enabled (postproc, &vi);
   if (deinterlace)
     postproc->flags |= GST_VAAPI_POSTPROC_FLAG_DEINTERLACE;
+  else
+    postproc->flags &= ~GST_VAAPI_POSTPROC_FLAG_DEINTERLACE;
   postproc->field_duration = GST_VIDEO_INFO_FPS_N (&vi) > 0 ?
       gst_util_uint64_scale (GST_SECOND, GST_VIDEO_INFO_FPS_D (&vi),
       (1 + deinterlace) * GST_VIDEO_INFO_FPS_N (&vi)) : 0;
+  gst_vaapi_deinterlace_history_set_frame_duration
+      (&postproc->deinterlace_state.history, GST_VIDEO_INFO_FPS_N (&vi) > 0 ?
+      gst_util_uint64_scale (GST_SECOND, GST_VIDEO_INFO_FPS_D (&vi),
+          GST_VIDEO_INFO_FPS_N (&vi)) : 0);
 
   postproc->get_va_surfaces = gst_caps_has_vaapi_surface (caps);
   return TRUE;
@@ -977,6 +1034,8 @@ static gboolean
 gst_vaapipostproc_update_src_caps (GstVaapiPostproc * postproc, GstCaps * caps,
     gboolean * caps_changed_ptr)
 {
+  gint fps_n, fps_d;
+
   GST_INFO_OBJECT (postproc, "new src caps = %" GST_PTR_FORMAT, caps);
 
   if (!video_info_update (caps, &postproc->srcpad_info, caps_changed_ptr))
@@ -992,26 +1051,32 @@ gst_vaapipostproc_update_src_caps (GstVaapiPostproc * postproc, GstCaps * caps,
       GST_VIDEO_INFO_HEIGHT (&postproc->sinkpad_info))
     postproc->flags |= GST_VAAPI_POSTPROC_FLAG_SIZE;
 
+  /* Decimate the input frames, or fields if deinterlacing, down to
+     the output frame rate */
+  fps_n = GST_VIDEO_INFO_FPS_N (&postproc->sinkpad_info);
+  fps_d = GST_VIDEO_INFO_FPS_D (&postproc->sinkpad_info);
+  if ((postproc->flags & GST_VAAPI_POSTPROC_FLAG_DEINTERLACE) &&
+      !gst_util_fraction_multiply (fps_n, fps_d, 2, 1, &fps_n, &fps_d))
+    fps_n = 0;
+  gst_vaapi_frame_decimator_init (&postproc->decimator, fps_n, fps_d,
+      GST_VIDEO_INFO_FPS_N (&postproc->srcpad_info),
+      GST_VIDEO_INFO_FPS_D (&postproc->srcpad_info));
+
   return TRUE;
 }
 
-static gboolean
-ensure_allowed_sinkpad_caps (GstVaapiPostproc * postproc)
+static GstCaps *
+build_allowed_sinkpad_caps (gpointer user_data)
 {
+  GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (user_data);
   GstCaps *out_caps, *raw_caps;
 
-  if (postproc->allowed_sinkpad_caps)
-    return TRUE;
-
-  if (!GST_VAAPI_PLUGIN_BASE_DISPLAY (postproc))
-    return FALSE;
-
   /* Create VA caps */
   out_caps = gst_caps_from_string (GST_VAAPI_MAKE_SURFACE_CAPS ", "
       GST_CAPS_INTERLACED_MODES);
   if (!out_caps) {
     GST_WARNING_OBJECT (postproc, "failed to create VA sink caps");
-    return FALSE;
+    return NULL;
   }
 
   raw_caps = gst_vaapi_plugin_base_get_allowed_raw_caps
@@ -1019,15 +1084,31 @@ ensure_allowed_sinkpad_caps (GstVaapiPostproc * postproc)
   if (!raw_caps) {
     gst_caps_unref (out_caps);
     GST_WARNING_OBJECT (postproc, "failed to create YUV sink caps");
-    return FALSE;
+    return NULL;
   }
 
   out_caps = gst_caps_make_writable (out_caps);
   gst_caps_append (out_caps, gst_caps_copy (raw_caps));
-  postproc->allowed_sinkpad_caps = out_caps;
 
   /* XXX: append VA/VPP filters */
-  return TRUE;
+  return out_caps;
+}
+
+static gboolean
+ensure_allowed_sinkpad_caps (GstVaapiPostproc * postproc)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (postproc);
+
+  if (postproc->allowed_sinkpad_caps)
+    return TRUE;
+
+  if (!display)
+    return FALSE;
+
+  postproc->allowed_sinkpad_caps =
+      gst_vaapi_caps_cache_get (gst_vaapi_display_get_caps_cache (display),
+      "vaapipostproc-sink", NULL, build_allowed_sinkpad_caps, postproc);
+  return postproc->allowed_sinkpad_caps != NULL;
 }
 
 /* Fixup output caps so that to reflect the supported set of pixel formats */
@@ -1080,23 +1161,40 @@ cleanup:
   return caps;
 }
 
-static gboolean
-ensure_allowed_srcpad_caps (GstVaapiPostproc * postproc)
+static GstCaps *
+build_allowed_srcpad_caps (gpointer user_data)
 {
+  GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (user_data);
   GstCaps *out_caps;
 
-  if (postproc->allowed_srcpad_caps)
-    return TRUE;
-
   /* Create initial caps from pad template */
   out_caps = gst_caps_from_string (gst_vaapipostproc_src_caps_str);
   if (!out_caps) {
     GST_ERROR_OBJECT (postproc, "failed to create VA src caps");
-    return FALSE;
+    return NULL;
+  }
+  return expand_allowed_srcpad_caps (postproc, out_caps);
+}
+
+static gboolean
+ensure_allowed_srcpad_caps (GstVaapiPostproc * postproc)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (postproc);
+
+  if (postproc->allowed_srcpad_caps)
+    return TRUE;
+
+  /* Caps are only expanded to the VPP formats once there is a filter,
+     and then only depend on the display and the DMABuf capability */
+  if (!display || !postproc->filter) {
+    postproc->allowed_srcpad_caps = build_allowed_srcpad_caps (postproc);
+    return postproc->allowed_srcpad_caps != NULL;
   }
 
   postproc->allowed_srcpad_caps =
-      expand_allowed_srcpad_caps (postproc, out_caps);
+      gst_vaapi_caps_cache_get (gst_vaapi_display_get_caps_cache (display),
+      "vaapipostproc-src", GST_VAAPI_PLUGIN_BASE_SRC_PAD_CAN_DMABUF (postproc)
+      ? "dmabuf" : NULL, build_allowed_srcpad_caps, postproc);
   return postproc->allowed_srcpad_caps != NULL;
 }
 
@@ -1196,22 +1294,43 @@ gst_vaapipostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
     GstBuffer * outbuf)
 {
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
+  OutputFields fields;
+  gboolean keep_reference;
   GstBuffer *buf;
   GstFlowReturn ret;
 
+  /* Drop the frames not needed for the output frame rate before any
+     processing, unless they serve as deinterlacing references */
+  keep_reference = FALSE;
+  if (!schedule_output_fields (postproc, inbuf, &fields)) {
+    keep_reference = postproc->use_vpp && postproc->deinterlace_state.deint &&
+        deint_method_is_advanced (postproc->deinterlace_method) &&
+        should_deinterlace_buffer (postproc, inbuf);
+    if (!keep_reference)
+      return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
+
   ret =
       gst_vaapi_plugin_base_get_input_buffer (GST_VAAPI_PLUGIN_BASE (postproc),
       inbuf, &buf);
   if (ret != GST_FLOW_OK)
     return GST_FLOW_ERROR;
 
+  if (keep_reference) {
+    gst_vaapi_deinterlace_history_check (&postproc->deinterlace_state.history,
+        buf);
+    ds_add_buffer (&postproc->deinterlace_state, buf);
+    ret = GST_BASE_TRANSFORM_FLOW_DROPPED;
+    goto done;
+  }
+
   ret = GST_FLOW_NOT_SUPPORTED;
   if (postproc->flags) {
     /* Use VA/VPP extensions to process this frame */
     if (postproc->has_vpp &&
         (postproc->flags != GST_VAAPI_POSTPROC_FLAG_DEINTERLACE ||
             deint_method_is_advanced (postproc->deinterlace_method))) {
-      ret = gst_vaapipostproc_process_vpp (trans, buf, outbuf);
+      ret = gst_vaapipostproc_process_vpp (trans, buf, outbuf, &fields);
       if (ret != GST_FLOW_NOT_SUPPORTED)
         goto done;
       GST_WARNING_OBJECT (postproc, "unsupported VPP filters. Disabling");
@@ -1219,14 +1338,14 @@ gst_vaapipostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
 
     /* Only append picture structure meta data (top/bottom field) */
     if (postproc->flags & GST_VAAPI_POSTPROC_FLAG_DEINTERLACE) {
-      ret = gst_vaapipostproc_process (trans, buf, outbuf);
+      ret = gst_vaapipostproc_process (trans, buf, outbuf, &fields);
       if (ret != GST_FLOW_NOT_SUPPORTED)
         goto done;
     }
   }
 
   /* Fallback: passthrough to the downstream element as is */
-  ret = gst_vaapipostproc_passthrough (trans, buf, outbuf);
+  ret = gst_vaapipostproc_passthrough (trans, buf, outbuf, &fields);
 
 done:
   gst_buffer_unref (buf);
@@ -1292,10 +1411,11 @@ gst_vaapipostproc_set_caps (GstBaseTransform * trans, GstCaps * caps,
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
   gboolean sink_caps_changed = FALSE;
   gboolean src_caps_changed = FALSE;
-  GstVideoInfo vinfo;
+  GstVideoInfo vinfo, old_sinkpad_info;
   gboolean ret = FALSE;
 
   g_mutex_lock (&postproc->postproc_lock);
+  old_sinkpad_info = postproc->sinkpad_info;
   if (!gst_vaapipostproc_update_sink_caps (postproc, caps, &sink_caps_changed))
     goto done;
   /* HACK: This is a workaround to deal with the va-intel-driver for non-native
@@ -1315,8 +1435,13 @@ gst_vaapipostproc_set_caps (GstBaseTransform * trans, GstCaps * caps,
     goto done;
 
   if (sink_caps_changed || src_caps_changed) {
-    gst_vaapipostproc_destroy (postproc);
-    if (!gst_vaapipostproc_create (postproc))
+    /* Keep the display, the filter and the deinterlacing references
+       across renegotiations. The references can only be used with
+       input frames of the same size and format */
+    if (gst_video_info_changed (&old_sinkpad_info, &postproc->sinkpad_info))
+      gst_vaapi_deinterlace_history_invalidate
+          (&postproc->deinterlace_state.history);
+    if (!postproc->filter && !gst_vaapipostproc_create (postproc))
       goto done;
     if (!gst_vaapi_plugin_base_set_caps (GST_VAAPI_PLUGIN_BASE (trans),
             caps, out_caps))
@@ -1358,6 +1483,9 @@ gst_vaapipostproc_query (GstBaseTransform * trans,
           GST_VAAPI_PLUGIN_BASE_DISPLAY (postproc));
       return TRUE;
     }
+  } else if (GST_QUERY_TYPE (query) == GST_QUERY_CUSTOM) {
+    if (gst_vaapi_handle_profiler_query (element, query))
+      return TRUE;
   }
 
   return
@@ -1822,6 +1950,8 @@ gst_vaapipostproc_init (GstVaapiPostproc * postproc)
   postproc->deinterlace_mode = DEFAULT_DEINTERLACE_MODE;
   postproc->deinterlace_method = DEFAULT_DEINTERLACE_METHOD;
   postproc->field_duration = GST_CLOCK_TIME_NONE;
+  gst_vaapi_frame_decimator_init (&postproc->decimator, 0, 1, 0, 1);
+  gst_vaapi_deinterlace_history_init (&postproc->deinterlace_state.history);
   postproc->keep_aspect = TRUE;
   postproc->get_va_surfaces = TRUE;
 
@@ -27,6 +27,8 @@
 #include <gst/vaapi/gstvaapisurface.h>
 #include <gst/vaapi/gstvaapisurfacepool.h>
 #include <gst/vaapi/gstvaapifilter.h>
+#include <gst/vaapi/gstvaapiframedecimator.h>
+#include <gst/vaapi/gstvaapideinterlacehistory.h>
 
 G_BEGIN_DECLS
 
@@ -62,18 +64,6 @@ typedef enum
   GST_VAAPI_DEINTERLACE_MODE_DISABLED,
 } GstVaapiDeinterlaceMode;
 
-/*
- * GST_VAAPI_DEINTERLACE_MAX_REFERENCES:
- *
- * This represents the maximum number of VA surfaces we could keep as
- * references for advanced deinterlacing.
- *
- * Note: if the upstream element is vaapidecode, then the maximum
- * number of allowed surfaces used as references shall be less than
- * the actual number of scratch surfaces used for decoding (4).
- */
-#define GST_VAAPI_DEINTERLACE_MAX_REFERENCES 2
-
 /**
  * GstVaapiPostprocFlags:
  * @GST_VAAPI_POSTPROC_FLAG_FORMAT: Pixel format conversion.
@@ -110,23 +100,19 @@ typedef enum
 
 /*
  * GstVaapiDeinterlaceState:
- * @buffers: history buffer, maintained as a cyclic array
- * @buffers_index: next free slot in the history buffer
+ * @history: the past buffers, kept across renegotiations
  * @surfaces: array of surfaces used as references
  * @num_surfaces: number of active surfaces in that array
  * @deint: flag: previous buffers were interlaced?
- * @tff: flag: previous buffers were organized as top-field-first?
  *
  * Context used to maintain deinterlacing state.
  */
 struct _GstVaapiDeinterlaceState
 {
-  GstBuffer *buffers[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
-  guint buffers_index;
+  GstVaapiDeinterlaceHistory history;
   GstVaapiSurface *surfaces[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
   guint num_surfaces;
   guint deint:1;
-  guint tff:1;
 };
 
 struct _GstVaapiPostproc
@@ -156,6 +142,9 @@ struct _GstVaapiPostproc
   GstVaapiDeinterlaceState deinterlace_state;
   GstClockTime field_duration;
 
+  /* Frame-rate decimation */
+  GstVaapiFrameDecimator decimator;
+
   /* Basic filter values */
   gfloat denoise_level;
   gfloat sharpen_level;
@@ -0,0 +1,1066 @@
+/*
+ *  gstvaapipostprocmulti.c - VA-API multi-output video postprocessing
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:element-vaapipostprocmulti
+ * @short_description: A VA-API multi-output video postprocessing filter
+ *
+ * vaapipostprocmulti produces several renditions of its input video,
+ * one per requested source pad. Each rendition is scaled, cropped and
+ * converted according to the properties of its pad, e.g. to feed the
+ * encoders of an adaptive bitrate ladder.
+ *
+ * Unlike a tee followed by as many vaapipostproc elements, all the
+ * renditions of a frame are processed back to back on a single video
+ * processing context, out of surface pools sized for each of them,
+ * and they all carry the timestamps of the input frame.
+ *
+ * Source pads only produce VA surfaces. Their properties can be set
+ * through the #GstChildProxy interface, and they should be requested
+ * before the pipeline goes to PAUSED.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 filesrc location=in.mp4 ! qtdemux ! vaapidecodebin ! \
+ *     vaapipostprocmulti name=m src_0::width=1280 src_1::width=854 src_2::width=640 \
+ *     m.src_0 ! vaapih264enc ! fakesink \
+ *     m.src_1 ! vaapih264enc ! fakesink \
+ *     m.src_2 ! vaapih264enc ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#include "gstcompat.h"
+#include <gst/video/video.h>
+
+#include "gstvaapipostprocmulti.h"
+#include "gstvaapipluginutil.h"
+#include "gstvaapivideobufferpool.h"
+#include "gstvaapivideomemory.h"
+#include "gstvaapivideometa.h"
+
+#define GST_PLUGIN_NAME "vaapipostprocmulti"
+#define GST_PLUGIN_DESC "A VA-API multi-output video postprocessing filter"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapipostproc_multi);
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT gst_debug_vaapipostproc_multi
+#else
+#define GST_CAT_DEFAULT NULL
+#endif
+
+#define DEFAULT_FORMAT          GST_VIDEO_FORMAT_NV12
+#define DEFAULT_SCALE_METHOD    GST_VAAPI_SCALE_METHOD_DEFAULT
+
+/* Default templates */
+/* *INDENT-OFF* */
+static const char gst_vaapipostproc_multi_sink_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ", "
+  GST_CAPS_INTERLACED_FALSE "; "
+  GST_VIDEO_CAPS_MAKE (GST_VIDEO_FORMATS_ALL) ", "
+  GST_CAPS_INTERLACED_FALSE;
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static const char gst_vaapipostproc_multi_src_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ", "
+  GST_CAPS_INTERLACED_FALSE;
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapipostproc_multi_sink_factory =
+  GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (gst_vaapipostproc_multi_sink_caps_str));
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapipostproc_multi_src_factory =
+  GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (gst_vaapipostproc_multi_src_caps_str));
+/* *INDENT-ON* */
+
+static void gst_vaapipostproc_multi_child_proxy_init (gpointer iface,
+    gpointer data);
+
+G_DEFINE_TYPE_WITH_CODE (GstVaapiPostprocMulti, gst_vaapipostproc_multi,
+    GST_TYPE_ELEMENT, GST_VAAPI_PLUGIN_BASE_INIT_INTERFACES
+    G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY,
+        gst_vaapipostproc_multi_child_proxy_init));
+
+GST_VAAPI_PLUGIN_BASE_DEFINE_SET_CONTEXT (gst_vaapipostproc_multi_parent_class);
+
+G_DEFINE_TYPE (GstVaapiPostprocMultiPad, gst_vaapipostproc_multi_pad,
+    GST_TYPE_PAD);
+
+enum
+{
+  PROP_0,
+
+  PROP_SCALE_METHOD,
+};
+
+enum
+{
+  PROP_PAD_0,
+
+  PROP_PAD_WIDTH,
+  PROP_PAD_HEIGHT,
+  PROP_PAD_FORMAT,
+  PROP_PAD_CROP_LEFT,
+  PROP_PAD_CROP_RIGHT,
+  PROP_PAD_CROP_TOP,
+  PROP_PAD_CROP_BOTTOM,
+};
+
+/* ------------------------------------------------------------------------ */
+/* --- Source pads                                                      --- */
+/* ------------------------------------------------------------------------ */
+
+static void
+srcpad_reset (GstVaapiPostprocMultiPad * srcpad)
+{
+  gst_buffer_replace (&srcpad->outbuf, NULL);
+  if (srcpad->buffer_pool) {
+    gst_buffer_pool_set_active (srcpad->buffer_pool, FALSE);
+    gst_object_unref (srcpad->buffer_pool);
+    srcpad->buffer_pool = NULL;
+  }
+  gst_vaapi_video_pool_replace (&srcpad->surface_pool, NULL);
+  gst_video_info_init (&srcpad->info);
+
+  GST_OBJECT_LOCK (srcpad);
+  srcpad->need_caps = TRUE;
+  GST_OBJECT_UNLOCK (srcpad);
+}
+
+static void
+gst_vaapipostproc_multi_pad_finalize (GObject * object)
+{
+  srcpad_reset (GST_VAAPIPOSTPROC_MULTI_PAD (object));
+
+  G_OBJECT_CLASS (gst_vaapipostproc_multi_pad_parent_class)->finalize
+      (object);
+}
+
+static void
+gst_vaapipostproc_multi_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiPostprocMultiPad *const srcpad =
+      GST_VAAPIPOSTPROC_MULTI_PAD (object);
+
+  GST_OBJECT_LOCK (srcpad);
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      srcpad->width = g_value_get_uint (value);
+      break;
+    case PROP_PAD_HEIGHT:
+      srcpad->height = g_value_get_uint (value);
+      break;
+    case PROP_PAD_FORMAT:
+      srcpad->format = g_value_get_enum (value);
+      break;
+    case PROP_PAD_CROP_LEFT:
+      srcpad->crop_left = g_value_get_uint (value);
+      break;
+    case PROP_PAD_CROP_RIGHT:
+      srcpad->crop_right = g_value_get_uint (value);
+      break;
+    case PROP_PAD_CROP_TOP:
+      srcpad->crop_top = g_value_get_uint (value);
+      break;
+    case PROP_PAD_CROP_BOTTOM:
+      srcpad->crop_bottom = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  srcpad->need_caps = TRUE;
+  GST_OBJECT_UNLOCK (srcpad);
+}
+
+static void
+gst_vaapipostproc_multi_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiPostprocMultiPad *const srcpad =
+      GST_VAAPIPOSTPROC_MULTI_PAD (object);
+
+  GST_OBJECT_LOCK (srcpad);
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      g_value_set_uint (value, srcpad->width);
+      break;
+    case PROP_PAD_HEIGHT:
+      g_value_set_uint (value, srcpad->height);
+      break;
+    case PROP_PAD_FORMAT:
+      g_value_set_enum (value, srcpad->format);
+      break;
+    case PROP_PAD_CROP_LEFT:
+      g_value_set_uint (value, srcpad->crop_left);
+      break;
+    case PROP_PAD_CROP_RIGHT:
+      g_value_set_uint (value, srcpad->crop_right);
+      break;
+    case PROP_PAD_CROP_TOP:
+      g_value_set_uint (value, srcpad->crop_top);
+      break;
+    case PROP_PAD_CROP_BOTTOM:
+      g_value_set_uint (value, srcpad->crop_bottom);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (srcpad);
+}
+
+static void
+gst_vaapipostproc_multi_pad_class_init (GstVaapiPostprocMultiPadClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gst_vaapipostproc_multi_pad_finalize;
+  object_class->set_property = gst_vaapipostproc_multi_pad_set_property;
+  object_class->get_property = gst_vaapipostproc_multi_pad_get_property;
+
+  /**
+   * GstVaapiPostprocMultiPad:width:
+   *
+   * The width of the rendition. If zero, it is derived from the
+   * height so that the display aspect ratio is preserved, or it is
+   * the width of the cropped input.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_WIDTH,
+      g_param_spec_uint ("width",
+          "Width",
+          "Output width",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiPostprocMultiPad:height:
+   *
+   * The height of the rendition. If zero, it is derived from the
+   * width so that the display aspect ratio is preserved, or it is
+   * the height of the cropped input.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_HEIGHT,
+      g_param_spec_uint ("height",
+          "Height",
+          "Output height",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstVaapiPostprocMultiPad:format:
+   *
+   * The pixel format of the rendition.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_FORMAT,
+      g_param_spec_enum ("format",
+          "Format",
+          "Output pixel format",
+          GST_TYPE_VIDEO_FORMAT,
+          DEFAULT_FORMAT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_CROP_LEFT,
+      g_param_spec_uint ("crop-left",
+          "Crop Left",
+          "Pixels to crop at the left of the input",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_CROP_RIGHT,
+      g_param_spec_uint ("crop-right",
+          "Crop Right",
+          "Pixels to crop at the right of the input",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_CROP_TOP,
+      g_param_spec_uint ("crop-top",
+          "Crop Top",
+          "Pixels to crop at the top of the input",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (object_class,
+      PROP_PAD_CROP_BOTTOM,
+      g_param_spec_uint ("crop-bottom",
+          "Crop Bottom",
+          "Pixels to crop at the bottom of the input",
+          0, G_MAXINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_vaapipostproc_multi_pad_init (GstVaapiPostprocMultiPad * srcpad)
+{
+  srcpad->format = DEFAULT_FORMAT;
+  srcpad->need_caps = TRUE;
+  gst_video_info_init (&srcpad->info);
+}
+
+/* Applies the pad cropping to the input region */
+static gboolean
+srcpad_get_crop_rect (GstVaapiPostprocMultiPad * srcpad,
+    const GstVaapiRectangle * in_rect, GstVaapiRectangle * crop_rect)
+{
+  guint crop_width, crop_height;
+
+  GST_OBJECT_LOCK (srcpad);
+  crop_width = srcpad->crop_left + srcpad->crop_right;
+  crop_height = srcpad->crop_top + srcpad->crop_bottom;
+  if (crop_width >= in_rect->width || crop_height >= in_rect->height) {
+    GST_OBJECT_UNLOCK (srcpad);
+    return FALSE;
+  }
+  crop_rect->x = in_rect->x + srcpad->crop_left;
+  crop_rect->y = in_rect->y + srcpad->crop_top;
+  crop_rect->width = in_rect->width - crop_width;
+  crop_rect->height = in_rect->height - crop_height;
+  GST_OBJECT_UNLOCK (srcpad);
+  return TRUE;
+}
+
+/* Determines the rendition size and pixel aspect ratio, so that the
+   display aspect ratio of the cropped input is preserved */
+static gboolean
+srcpad_get_video_info (GstVaapiPostprocMultiPad * srcpad,
+    const GstVideoInfo * in_vip, GstVideoInfo * vip)
+{
+  GstVaapiRectangle in_rect, crop_rect;
+  GstVideoFormat format;
+  guint width, height;
+  gint dar_n, dar_d;
+
+  in_rect.x = 0;
+  in_rect.y = 0;
+  in_rect.width = GST_VIDEO_INFO_WIDTH (in_vip);
+  in_rect.height = GST_VIDEO_INFO_HEIGHT (in_vip);
+  if (!srcpad_get_crop_rect (srcpad, &in_rect, &crop_rect))
+    return FALSE;
+
+  if (!gst_util_fraction_multiply (crop_rect.width, crop_rect.height,
+          GST_VIDEO_INFO_PAR_N (in_vip), GST_VIDEO_INFO_PAR_D (in_vip),
+          &dar_n, &dar_d))
+    return FALSE;
+
+  GST_OBJECT_LOCK (srcpad);
+  width = srcpad->width;
+  height = srcpad->height;
+  format = srcpad->format;
+  GST_OBJECT_UNLOCK (srcpad);
+
+  if (!width && !height) {
+    width = crop_rect.width;
+    height = crop_rect.height;
+  } else if (!width)
+    width = GST_ROUND_UP_2 (gst_util_uint64_scale_int (height, dar_n, dar_d));
+  else if (!height)
+    height = GST_ROUND_UP_2 (gst_util_uint64_scale_int (width, dar_d, dar_n));
+
+  gst_video_info_set_format (vip, format, width, height);
+  GST_VIDEO_INFO_FPS_N (vip) = GST_VIDEO_INFO_FPS_N (in_vip);
+  GST_VIDEO_INFO_FPS_D (vip) = GST_VIDEO_INFO_FPS_D (in_vip);
+  GST_VIDEO_INFO_CHROMA_SITE (vip) = GST_VIDEO_INFO_CHROMA_SITE (in_vip);
+  return gst_util_fraction_multiply (dar_n, dar_d, height, width,
+      &GST_VIDEO_INFO_PAR_N (vip), &GST_VIDEO_INFO_PAR_D (vip));
+}
+
+static GstBufferPool *
+srcpad_create_buffer_pool (GstVaapiPostprocMultiPad * srcpad,
+    GstVaapiDisplay * display, GstCaps * caps)
+{
+  GstBufferPool *pool;
+  GstAllocator *allocator;
+  GstStructure *config;
+
+  allocator = gst_vaapi_video_allocator_new (display, &srcpad->info, 0,
+      GST_VAAPI_IMAGE_USAGE_FLAG_NATIVE_FORMATS);
+  if (!allocator)
+    return NULL;
+
+  pool = gst_vaapi_video_buffer_pool_new (display);
+  if (!pool)
+    goto cleanup;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps,
+      GST_VIDEO_INFO_SIZE (&srcpad->info), 0, 0);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_VAAPI_VIDEO_META);
+  gst_buffer_pool_config_set_allocator (config, allocator, NULL);
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE))
+    gst_object_replace ((GstObject **) & pool, NULL);
+
+cleanup:
+  gst_object_unref (allocator);
+  return pool;
+}
+
+/* Negotiates the rendition caps, and sets up the pools it is
+   allocated from */
+static gboolean
+srcpad_ensure_caps (GstVaapiPostprocMulti * multi,
+    GstVaapiPostprocMultiPad * srcpad)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_PLUGIN_BASE_DISPLAY (multi);
+  GstVideoInfo vi;
+  GstCaps *caps;
+  gboolean need_caps;
+
+  GST_OBJECT_LOCK (srcpad);
+  need_caps = srcpad->need_caps;
+  srcpad->need_caps = FALSE;
+  GST_OBJECT_UNLOCK (srcpad);
+  if (!need_caps && srcpad->buffer_pool)
+    return TRUE;
+
+  if (!srcpad_get_video_info (srcpad, GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO
+          (multi), &vi))
+    goto error_invalid_size;
+
+  if (srcpad->buffer_pool && !gst_video_info_changed (&srcpad->info, &vi))
+    return TRUE;
+
+  srcpad_reset (srcpad);
+  GST_OBJECT_LOCK (srcpad);
+  srcpad->need_caps = FALSE;
+  GST_OBJECT_UNLOCK (srcpad);
+  srcpad->info = vi;
+
+  caps = gst_video_info_to_caps (&vi);
+  if (!caps)
+    goto error_invalid_size;
+  gst_caps_set_features (caps, 0,
+      gst_caps_features_new (GST_CAPS_FEATURE_MEMORY_VAAPI_SURFACE, NULL));
+  GST_INFO_OBJECT (srcpad, "new rendition caps %" GST_PTR_FORMAT, caps);
+
+  srcpad->surface_pool = gst_vaapi_surface_pool_new_full (display, &vi, 0);
+  if (srcpad->surface_pool)
+    srcpad->buffer_pool = srcpad_create_buffer_pool (srcpad, display, caps);
+
+  /* An unlinked pad still gets renditions, the push just fails */
+  gst_pad_push_event (GST_PAD_CAST (srcpad), gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  if (!srcpad->buffer_pool)
+    goto error_create_pool;
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_size:
+  {
+    GST_ELEMENT_ERROR (multi, CORE, NEGOTIATION,
+        ("invalid rendition size for %s", GST_PAD_NAME (srcpad)), (NULL));
+    return FALSE;
+  }
+error_create_pool:
+  {
+    GST_ERROR_OBJECT (srcpad, "failed to create rendition pools");
+    srcpad_reset (srcpad);
+    return FALSE;
+  }
+}
+
+static gboolean
+srcpad_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  if (GST_QUERY_TYPE (query) == GST_QUERY_CONTEXT &&
+      gst_vaapi_handle_context_query (GST_ELEMENT (parent), query))
+    return TRUE;
+  return gst_pad_query_default (pad, parent, query);
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- Processing                                                       --- */
+/* ------------------------------------------------------------------------ */
+
+static gboolean
+gst_vaapipostproc_multi_ensure_filter (GstVaapiPostprocMulti * multi)
+{
+  if (multi->filter)
+    return TRUE;
+
+  if (!gst_vaapi_plugin_base_ensure_display (GST_VAAPI_PLUGIN_BASE (multi)))
+    return FALSE;
+
+  multi->filter = gst_vaapi_filter_new (GST_VAAPI_PLUGIN_BASE_DISPLAY (multi));
+  if (!multi->filter)
+    return FALSE;
+  return gst_vaapi_filter_set_scaling (multi->filter, multi->scale_method);
+}
+
+/* Retrieves the source pads, each with an extra reference */
+static GList *
+get_srcpads (GstVaapiPostprocMulti * multi)
+{
+  GList *srcpads;
+
+  GST_OBJECT_LOCK (multi);
+  srcpads = g_list_copy_deep (GST_ELEMENT (multi)->srcpads,
+      (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (multi);
+  return srcpads;
+}
+
+static void
+mark_srcpads_need_caps (GstVaapiPostprocMulti * multi)
+{
+  GList *l;
+
+  GST_OBJECT_LOCK (multi);
+  for (l = GST_ELEMENT (multi)->srcpads; l; l = l->next) {
+    GstVaapiPostprocMultiPad *const srcpad = l->data;
+    GST_OBJECT_LOCK (srcpad);
+    srcpad->need_caps = TRUE;
+    GST_OBJECT_UNLOCK (srcpad);
+  }
+  GST_OBJECT_UNLOCK (multi);
+}
+
+/* Processes the rendition of the input surface for @srcpad */
+static GstFlowReturn
+render_rendition (GstVaapiPostprocMulti * multi,
+    GstVaapiPostprocMultiPad * srcpad, GstBuffer * inbuf,
+    GstVaapiSurface * inbuf_surface, const GstVaapiRectangle * in_rect,
+    guint flags)
+{
+  GstVaapiVideoMeta *outbuf_meta;
+  GstVaapiSurfaceProxy *proxy;
+  GstVaapiFilterStatus status;
+  GstVaapiRectangle crop_rect;
+  GstBuffer *outbuf = NULL;
+
+  if (!srcpad_ensure_caps (multi, srcpad))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  if (gst_buffer_pool_acquire_buffer (srcpad->buffer_pool, &outbuf,
+          NULL) != GST_FLOW_OK)
+    goto error_create_buffer;
+
+  outbuf_meta = gst_buffer_get_vaapi_video_meta (outbuf);
+  if (!outbuf_meta)
+    goto error_create_meta;
+
+  proxy = gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
+      (srcpad->surface_pool));
+  if (!proxy)
+    goto error_create_proxy;
+  gst_vaapi_video_meta_set_surface_proxy (outbuf_meta, proxy);
+  gst_vaapi_surface_proxy_unref (proxy);
+
+  if (!srcpad_get_crop_rect (srcpad, in_rect, &crop_rect))
+    goto error_invalid_crop;
+
+  if (!gst_vaapi_filter_set_format (multi->filter,
+          GST_VIDEO_INFO_FORMAT (&srcpad->info)))
+    goto error_invalid_format;
+  gst_vaapi_filter_set_cropping_rectangle (multi->filter, &crop_rect);
+  status = gst_vaapi_filter_process (multi->filter, inbuf_surface,
+      gst_vaapi_video_meta_get_surface (outbuf_meta), flags);
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    goto error_process_vpp;
+
+  gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_FLAGS |
+      GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+  gst_buffer_replace (&srcpad->outbuf, outbuf);
+  gst_buffer_unref (outbuf);
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+error_create_buffer:
+  {
+    GST_ERROR_OBJECT (srcpad, "failed to create output buffer");
+    return GST_FLOW_ERROR;
+  }
+error_create_meta:
+  {
+    GST_ERROR_OBJECT (srcpad, "failed to create new output buffer meta");
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+error_create_proxy:
+  {
+    GST_ERROR_OBJECT (srcpad, "failed to create surface proxy from pool");
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+error_invalid_crop:
+  {
+    GST_ERROR_OBJECT (srcpad, "cropping exceeds the input frame");
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+error_invalid_format:
+  {
+    GST_ERROR_OBJECT (srcpad, "unsupported output format %s",
+        gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&srcpad->info)));
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+error_process_vpp:
+  {
+    GST_ERROR_OBJECT (srcpad, "failed to apply VPP filters (error %d)",
+        status);
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* The frame is dropped by all the renditions only when none of them
+   could push it, e.g. because they are all unlinked */
+static GstFlowReturn
+combine_flow (GstFlowReturn ret, GstFlowReturn pad_ret)
+{
+  if (ret == GST_FLOW_OK || pad_ret == GST_FLOW_OK)
+    return GST_FLOW_OK;
+  if (pad_ret == GST_FLOW_NOT_LINKED)
+    return ret;
+  return pad_ret;
+}
+
+static GstFlowReturn
+gst_vaapipostproc_multi_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (parent);
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (multi);
+  GstVaapiVideoMeta *inbuf_meta;
+  GstVaapiSurface *inbuf_surface;
+  const GstVideoCropMeta *crop_meta;
+  const GstVaapiRectangle *render_rect;
+  GstVaapiRectangle in_rect;
+  GstBuffer *inbuf = NULL;
+  GstFlowReturn ret, pad_ret;
+  GList *srcpads, *l;
+  guint flags;
+
+  ret = gst_vaapi_plugin_base_get_input_buffer (plugin, buf, &inbuf);
+  gst_buffer_unref (buf);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  inbuf_meta = gst_buffer_get_vaapi_video_meta (inbuf);
+  if (!inbuf_meta)
+    goto error_invalid_buffer;
+  inbuf_surface = gst_vaapi_video_meta_get_surface (inbuf_meta);
+  flags = gst_vaapi_video_meta_get_render_flags (inbuf_meta) &
+      ~GST_VAAPI_PICTURE_STRUCTURE_MASK;
+
+  crop_meta = gst_buffer_get_video_crop_meta (inbuf);
+  render_rect = gst_vaapi_video_meta_get_render_rect (inbuf_meta);
+  if (crop_meta) {
+    in_rect.x = crop_meta->x;
+    in_rect.y = crop_meta->y;
+    in_rect.width = crop_meta->width;
+    in_rect.height = crop_meta->height;
+  } else if (render_rect)
+    in_rect = *render_rect;
+  else {
+    in_rect.x = 0;
+    in_rect.y = 0;
+    in_rect.width =
+        GST_VIDEO_INFO_WIDTH (GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (multi));
+    in_rect.height =
+        GST_VIDEO_INFO_HEIGHT (GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (multi));
+  }
+
+  /* Submit all the renditions back to back, before any push could
+     stall the streaming thread */
+  srcpads = get_srcpads (multi);
+  ret = GST_FLOW_OK;
+  for (l = srcpads; l && ret == GST_FLOW_OK; l = l->next)
+    ret = render_rendition (multi, l->data, inbuf, inbuf_surface, &in_rect,
+        flags);
+
+  if (ret == GST_FLOW_OK) {
+    ret = GST_FLOW_NOT_LINKED;
+    for (l = srcpads; l; l = l->next) {
+      GstVaapiPostprocMultiPad *const srcpad = l->data;
+      GstBuffer *const outbuf = srcpad->outbuf;
+
+      srcpad->outbuf = NULL;
+      pad_ret = gst_pad_push (GST_PAD_CAST (srcpad), outbuf);
+      GST_LOG_OBJECT (srcpad, "pushed rendition: %s",
+          gst_flow_get_name (pad_ret));
+      ret = combine_flow (ret, pad_ret);
+    }
+  } else {
+    for (l = srcpads; l; l = l->next)
+      gst_buffer_replace (&GST_VAAPIPOSTPROC_MULTI_PAD (l->data)->outbuf,
+          NULL);
+  }
+  g_list_free_full (srcpads, gst_object_unref);
+  gst_buffer_unref (inbuf);
+  return ret;
+
+  /* ERRORS */
+error_invalid_buffer:
+  {
+    GST_ERROR_OBJECT (multi, "failed to validate source buffer");
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- Sink pad                                                         --- */
+/* ------------------------------------------------------------------------ */
+
+static gboolean
+gst_vaapipostproc_multi_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (parent);
+  GstCaps *caps;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+      /* Each source pad negotiates its own caps on the next frame */
+      gst_event_parse_caps (event, &caps);
+      if (!gst_vaapipostproc_multi_ensure_filter (multi) ||
+          !gst_vaapi_plugin_base_set_caps (GST_VAAPI_PLUGIN_BASE (multi),
+              caps, NULL)) {
+        gst_event_unref (event);
+        return FALSE;
+      }
+      mark_srcpads_need_caps (multi);
+      gst_event_unref (event);
+      return TRUE;
+    default:
+      break;
+  }
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_vaapipostproc_multi_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (parent);
+  GstCaps *caps, *filter;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CONTEXT:
+      if (gst_vaapi_handle_context_query (GST_ELEMENT (multi), query))
+        return TRUE;
+      break;
+    case GST_QUERY_CAPS:
+      /* Renditions are negotiated separately, downstream of each
+         source pad, so the input is only bound to the template */
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *const tmp_caps = caps;
+        caps = gst_caps_intersect_full (filter, tmp_caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (tmp_caps);
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    case GST_QUERY_ALLOCATION:
+      return gst_vaapi_plugin_base_propose_allocation (GST_VAAPI_PLUGIN_BASE
+          (multi), query);
+    default:
+      break;
+  }
+  return gst_pad_query_default (pad, parent, query);
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- Element                                                          --- */
+/* ------------------------------------------------------------------------ */
+
+static gboolean
+copy_sticky_event (GstPad * pad, GstEvent ** event, gpointer user_data)
+{
+  GstPad *const srcpad = GST_PAD_CAST (user_data);
+
+  /* Renditions have caps of their own */
+  if (GST_EVENT_TYPE (*event) != GST_EVENT_CAPS)
+    gst_pad_store_sticky_event (srcpad, *event);
+  return TRUE;
+}
+
+static GstPad *
+gst_vaapipostproc_multi_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (element);
+  GstPad *srcpad;
+  gchar *pad_name;
+
+  GST_OBJECT_LOCK (multi);
+  if (name && sscanf (name, "src_%u", &multi->next_pad_id) == 1)
+    pad_name = g_strdup (name);
+  else
+    pad_name = g_strdup_printf ("src_%u", multi->next_pad_id);
+  multi->next_pad_id++;
+  GST_OBJECT_UNLOCK (multi);
+
+  srcpad = g_object_new (GST_TYPE_VAAPIPOSTPROC_MULTI_PAD, "name", pad_name,
+      "direction", GST_PAD_SRC, "template", templ, NULL);
+  g_free (pad_name);
+
+  gst_pad_set_query_function (srcpad, srcpad_query);
+  gst_pad_use_fixed_caps (srcpad);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_sticky_events_foreach (GST_VAAPI_PLUGIN_BASE_SINK_PAD (multi),
+      copy_sticky_event, srcpad);
+
+  if (!gst_element_add_pad (element, srcpad)) {
+    gst_object_unref (srcpad);
+    return NULL;
+  }
+  gst_child_proxy_child_added (GST_CHILD_PROXY (element), G_OBJECT (srcpad),
+      GST_OBJECT_NAME (srcpad));
+  return srcpad;
+}
+
+static void
+gst_vaapipostproc_multi_release_pad (GstElement * element, GstPad * pad)
+{
+  gst_child_proxy_child_removed (GST_CHILD_PROXY (element), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+}
+
+static void
+reset_srcpads (GstVaapiPostprocMulti * multi)
+{
+  GList *srcpads;
+
+  srcpads = get_srcpads (multi);
+  g_list_foreach (srcpads, (GFunc) srcpad_reset, NULL);
+  g_list_free_full (srcpads, gst_object_unref);
+}
+
+static void
+gst_vaapipostproc_multi_destroy (GstVaapiPostprocMulti * multi)
+{
+  reset_srcpads (multi);
+  gst_vaapi_filter_replace (&multi->filter, NULL);
+  gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (multi));
+}
+
+static GstStateChangeReturn
+gst_vaapipostproc_multi_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!gst_vaapi_plugin_base_open (GST_VAAPI_PLUGIN_BASE (multi)))
+        return GST_STATE_CHANGE_FAILURE;
+      if (!gst_vaapipostproc_multi_ensure_filter (multi))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_vaapipostproc_multi_parent_class)->change_state
+      (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      reset_srcpads (multi);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      gst_vaapipostproc_multi_destroy (multi);
+      break;
+    default:
+      break;
+  }
+  return ret;
+}
+
+static void
+gst_vaapipostproc_multi_finalize (GObject * object)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (object);
+
+  gst_vaapipostproc_multi_destroy (multi);
+  gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (multi));
+  G_OBJECT_CLASS (gst_vaapipostproc_multi_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapipostproc_multi_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (object);
+
+  switch (prop_id) {
+    case PROP_SCALE_METHOD:
+      multi->scale_method = g_value_get_enum (value);
+      if (multi->filter)
+        gst_vaapi_filter_set_scaling (multi->filter, multi->scale_method);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapipostproc_multi_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiPostprocMulti *const multi = GST_VAAPIPOSTPROC_MULTI (object);
+
+  switch (prop_id) {
+    case PROP_SCALE_METHOD:
+      g_value_set_enum (value, multi->scale_method);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapipostproc_multi_class_init (GstVaapiPostprocMultiClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_vaapipostproc_multi,
+      GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
+
+  gst_vaapi_plugin_base_class_init (GST_VAAPI_PLUGIN_BASE_CLASS (klass));
+
+  object_class->finalize = gst_vaapipostproc_multi_finalize;
+  object_class->set_property = gst_vaapipostproc_multi_set_property;
+  object_class->get_property = gst_vaapipostproc_multi_get_property;
+
+  element_class->change_state = gst_vaapipostproc_multi_change_state;
+  element_class->request_new_pad = gst_vaapipostproc_multi_request_new_pad;
+  element_class->release_pad = gst_vaapipostproc_multi_release_pad;
+  element_class->set_context = gst_vaapi_base_set_context;
+  gst_element_class_set_static_metadata (element_class,
+      "VA-API multi-output video postprocessing",
+      "Filter/Converter/Video;Filter/Converter/Video/Scaler",
+      GST_PLUGIN_DESC, "Intel Corporation");
+
+  /* sink pad */
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaapipostproc_multi_sink_factory);
+
+  /* src pads */
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaapipostproc_multi_src_factory);
+
+  /**
+   * GstVaapiPostprocMulti:scale-method:
+   *
+   * The scaling method used for all the renditions. See
+   * #GstVaapiScaleMethod.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_SCALE_METHOD,
+      g_param_spec_enum ("scale-method",
+          "Scale method",
+          "Scaling method to use",
+          GST_VAAPI_TYPE_SCALE_METHOD,
+          DEFAULT_SCALE_METHOD, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_vaapipostproc_multi_init (GstVaapiPostprocMulti * multi)
+{
+  GstPad *sinkpad;
+
+  sinkpad = gst_pad_new_from_static_template
+      (&gst_vaapipostproc_multi_sink_factory, "sink");
+  gst_pad_set_chain_function (sinkpad, gst_vaapipostproc_multi_chain);
+  gst_pad_set_event_function (sinkpad, gst_vaapipostproc_multi_sink_event);
+  gst_pad_set_query_function (sinkpad, gst_vaapipostproc_multi_sink_query);
+  gst_element_add_pad (GST_ELEMENT (multi), sinkpad);
+
+  gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (multi), GST_CAT_DEFAULT);
+
+  multi->scale_method = DEFAULT_SCALE_METHOD;
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- GstChildProxy interface                                          --- */
+/* ------------------------------------------------------------------------ */
+
+static GObject *
+gst_vaapipostproc_multi_child_proxy_get_child_by_index (GstChildProxy * proxy,
+    guint index)
+{
+  GObject *child;
+
+  GST_OBJECT_LOCK (proxy);
+  child = g_list_nth_data (GST_ELEMENT_CAST (proxy)->srcpads, index);
+  if (child)
+    gst_object_ref (child);
+  GST_OBJECT_UNLOCK (proxy);
+  return child;
+}
+
+static guint
+gst_vaapipostproc_multi_child_proxy_get_children_count (GstChildProxy * proxy)
+{
+  guint count;
+
+  GST_OBJECT_LOCK (proxy);
+  count = GST_ELEMENT_CAST (proxy)->numsrcpads;
+  GST_OBJECT_UNLOCK (proxy);
+  return count;
+}
+
+static void
+gst_vaapipostproc_multi_child_proxy_init (gpointer iface, gpointer data)
+{
+  GstChildProxyInterface *const proxy_iface = iface;
+
+  proxy_iface->get_child_by_index =
+      gst_vaapipostproc_multi_child_proxy_get_child_by_index;
+  proxy_iface->get_children_count =
+      gst_vaapipostproc_multi_child_proxy_get_children_count;
+}
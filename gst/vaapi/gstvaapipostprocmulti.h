@@ -0,0 +1,129 @@
+/*
+ *  gstvaapipostprocmulti.h - VA-API multi-output video postprocessing
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#ifndef GST_VAAPIPOSTPROC_MULTI_H
+#define GST_VAAPIPOSTPROC_MULTI_H
+
+#include "gstvaapipluginbase.h"
+#include <gst/vaapi/gstvaapisurfacepool.h>
+#include <gst/vaapi/gstvaapifilter.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAAPIPOSTPROC_MULTI \
+  (gst_vaapipostproc_multi_get_type ())
+#define GST_VAAPIPOSTPROC_MULTI(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPIPOSTPROC_MULTI, \
+       GstVaapiPostprocMulti))
+#define GST_VAAPIPOSTPROC_MULTI_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_VAAPIPOSTPROC_MULTI, \
+       GstVaapiPostprocMultiClass))
+#define GST_IS_VAAPIPOSTPROC_MULTI(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPIPOSTPROC_MULTI))
+#define GST_IS_VAAPIPOSTPROC_MULTI_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_VAAPIPOSTPROC_MULTI))
+#define GST_VAAPIPOSTPROC_MULTI_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_VAAPIPOSTPROC_MULTI, \
+       GstVaapiPostprocMultiClass))
+
+#define GST_TYPE_VAAPIPOSTPROC_MULTI_PAD \
+  (gst_vaapipostproc_multi_pad_get_type ())
+#define GST_VAAPIPOSTPROC_MULTI_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPIPOSTPROC_MULTI_PAD, \
+       GstVaapiPostprocMultiPad))
+#define GST_IS_VAAPIPOSTPROC_MULTI_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_VAAPIPOSTPROC_MULTI_PAD))
+
+typedef struct _GstVaapiPostprocMulti GstVaapiPostprocMulti;
+typedef struct _GstVaapiPostprocMultiClass GstVaapiPostprocMultiClass;
+typedef struct _GstVaapiPostprocMultiPad GstVaapiPostprocMultiPad;
+typedef struct _GstVaapiPostprocMultiPadClass GstVaapiPostprocMultiPadClass;
+
+/*
+ * GstVaapiPostprocMultiPad:
+ * @width: requested output width, or 0 to derive it
+ * @height: requested output height, or 0 to derive it
+ * @format: requested output pixel format
+ * @crop_left: pixels to crop at the left of the input
+ * @crop_right: pixels to crop at the right of the input
+ * @crop_top: pixels to crop at the top of the input
+ * @crop_bottom: pixels to crop at the bottom of the input
+ * @need_caps: flag: the output caps need to be negotiated again
+ * @info: the negotiated output video info
+ * @surface_pool: the pool of output surfaces, sized for @info
+ * @buffer_pool: the pool of output buffers, sized for @info
+ * @outbuf: the rendition of the current input frame, pending push
+ *
+ * A source pad of vaapipostprocmulti, carrying one rendition of the
+ * input video. The properties are protected by the object lock, the
+ * negotiated state is only used from the streaming thread.
+ */
+struct _GstVaapiPostprocMultiPad
+{
+  /*< private >*/
+  GstPad parent_instance;
+
+  guint width;
+  guint height;
+  GstVideoFormat format;
+  guint crop_left;
+  guint crop_right;
+  guint crop_top;
+  guint crop_bottom;
+  gboolean need_caps;
+
+  GstVideoInfo info;
+  GstVaapiVideoPool *surface_pool;
+  GstBufferPool *buffer_pool;
+  GstBuffer *outbuf;
+};
+
+struct _GstVaapiPostprocMultiPadClass
+{
+  /*< private >*/
+  GstPadClass parent_class;
+};
+
+struct _GstVaapiPostprocMulti
+{
+  /*< private >*/
+  GstVaapiPluginBase parent_instance;
+
+  GstVaapiFilter *filter;
+  GstVaapiScaleMethod scale_method;
+  guint next_pad_id;
+};
+
+struct _GstVaapiPostprocMultiClass
+{
+  /*< private >*/
+  GstVaapiPluginBaseClass parent_class;
+};
+
+GType
+gst_vaapipostproc_multi_get_type (void);
+
+GType
+gst_vaapipostproc_multi_pad_get_type (void);
+
+G_END_DECLS
+
+#endif /* GST_VAAPIPOSTPROC_MULTI_H */
@@ -528,7 +528,7 @@ static gboolean
 _fixate_frame_rate (GstVaapiPostproc * postproc, GstVideoInfo * vinfo,
     GstStructure * outs)
 {
-  gint fps_n, fps_d;
+  gint fps_n, fps_d, out_fps_n, out_fps_d;
 
   fps_n = GST_VIDEO_INFO_FPS_N (vinfo);
   fps_d = GST_VIDEO_INFO_FPS_D (vinfo);
@@ -536,6 +536,20 @@ _fixate_frame_rate (GstVaapiPostproc * postproc, GstVideoInfo * vinfo,
     if (!gst_util_fraction_multiply (fps_n, fps_d, 2, 1, &fps_n, &fps_d))
       goto overflow_error;
   }
+
+  /* Frames can be dropped to honour a lower downstream frame rate, but
+   * never duplicated */
+  if (fps_n > 0 && gst_structure_has_field (outs, "framerate")) {
+    gst_structure_fixate_field_nearest_fraction (outs, "framerate", fps_n,
+        fps_d);
+    if (gst_structure_get_fraction (outs, "framerate", &out_fps_n,
+            &out_fps_d) && out_fps_n > 0
+        && gst_util_fraction_compare (out_fps_n, out_fps_d, fps_n,
+            fps_d) < 0) {
+      fps_n = out_fps_n;
+      fps_d = out_fps_d;
+    }
+  }
   gst_structure_set (outs, "framerate", GST_TYPE_FRACTION, fps_n, fps_d, NULL);
   return TRUE;
 
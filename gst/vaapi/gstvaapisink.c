@@ -1515,7 +1515,6 @@ gst_vaapisink_propose_allocation (GstBaseSink * base_sink, GstQuery * query)
   if (!gst_vaapi_plugin_base_propose_allocation (plugin, query))
     return FALSE;
 
-  gst_query_add_allocation_meta (query, GST_VIDEO_CROP_META_API_TYPE, NULL);
   gst_query_add_allocation_meta (query,
       GST_VIDEO_OVERLAY_COMPOSITION_META_API_TYPE, NULL);
   return TRUE;
@@ -1531,6 +1530,11 @@ gst_vaapisink_query (GstBaseSink * base_sink, GstQuery * query)
     case GST_QUERY_CONTEXT:
       ret = gst_vaapi_handle_context_query (element, query);
       break;
+    case GST_QUERY_CUSTOM:
+      ret = gst_vaapi_handle_profiler_query (element, query) ||
+          GST_BASE_SINK_CLASS (gst_vaapisink_parent_class)->query (base_sink,
+          query);
+      break;
     default:
       ret = GST_BASE_SINK_CLASS (gst_vaapisink_parent_class)->query (base_sink,
           query);
@@ -0,0 +1,225 @@
+/*
+ *  gstvaapitimingmeta.c - Per-frame stage timings
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapitimingmeta
+ * @short_description: Per-frame stage timings
+ *
+ * The stages of a frame run at different times, and possibly from
+ * different threads, e.g. a frame is parsed and submitted for decoding
+ * well before it is output in presentation order. A
+ * #GstVaapiTimingFrames table accumulates the timings of each frame,
+ * indexed by its system frame number, until the output buffer is
+ * produced. They are then moved to a #GstVaapiTimingMeta.
+ */
+
+#include "gstcompat.h"
+#include <string.h>
+#include "gstvaapitimingmeta.h"
+
+/* Frames that are still pending after that many newer frames were
+   submitted are assumed to be dropped */
+#define MAX_PENDING_FRAMES 64
+
+struct _GstVaapiTimingFrames
+{
+  GMutex mutex;
+  GHashTable *durations;
+};
+
+static gboolean
+gst_vaapi_timing_meta_init (GstVaapiTimingMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  memset (meta->durations, 0, sizeof (meta->durations));
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_timing_meta_transform (GstBuffer * dst_buffer, GstMeta * meta,
+    GstBuffer * src_buffer, GQuark type, gpointer data)
+{
+  GstVaapiTimingMeta *const src_meta = (GstVaapiTimingMeta *) meta;
+  GstVaapiTimingMeta *dst_meta;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    dst_meta = gst_buffer_add_vaapi_timing_meta (dst_buffer);
+    if (!dst_meta)
+      return FALSE;
+    memcpy (dst_meta->durations, src_meta->durations,
+        sizeof (dst_meta->durations));
+    return TRUE;
+  }
+  return FALSE;
+}
+
+GType
+gst_vaapi_timing_meta_api_get_type (void)
+{
+  static gsize g_type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&g_type)) {
+    GType type = gst_meta_api_type_register ("GstVaapiTimingMetaAPI", tags);
+    g_once_init_leave (&g_type, type);
+  }
+  return g_type;
+}
+
+#define GST_VAAPI_TIMING_META_INFO gst_vaapi_timing_meta_info_get ()
+static const GstMetaInfo *
+gst_vaapi_timing_meta_info_get (void)
+{
+  static gsize g_meta_info;
+
+  if (g_once_init_enter (&g_meta_info)) {
+    gsize meta_info =
+        GPOINTER_TO_SIZE (gst_meta_register (GST_VAAPI_TIMING_META_API_TYPE,
+            "GstVaapiTimingMeta", sizeof (GstVaapiTimingMeta),
+            (GstMetaInitFunction) gst_vaapi_timing_meta_init, NULL,
+            (GstMetaTransformFunction) gst_vaapi_timing_meta_transform));
+    g_once_init_leave (&g_meta_info, meta_info);
+  }
+  return GSIZE_TO_POINTER (g_meta_info);
+}
+
+GstVaapiTimingMeta *
+gst_buffer_add_vaapi_timing_meta (GstBuffer * buffer)
+{
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  return (GstVaapiTimingMeta *) gst_buffer_add_meta (buffer,
+      GST_VAAPI_TIMING_META_INFO, NULL);
+}
+
+GstVaapiTimingFrames *
+gst_vaapi_timing_frames_new (void)
+{
+  GstVaapiTimingFrames *frames;
+
+  frames = g_slice_new (GstVaapiTimingFrames);
+  g_mutex_init (&frames->mutex);
+  frames->durations = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  return frames;
+}
+
+void
+gst_vaapi_timing_frames_free (GstVaapiTimingFrames * frames)
+{
+  if (!frames)
+    return;
+
+  g_hash_table_unref (frames->durations);
+  g_mutex_clear (&frames->mutex);
+  g_slice_free (GstVaapiTimingFrames, frames);
+}
+
+void
+gst_vaapi_timing_frames_clear (GstVaapiTimingFrames * frames)
+{
+  g_return_if_fail (frames != NULL);
+
+  g_mutex_lock (&frames->mutex);
+  g_hash_table_remove_all (frames->durations);
+  g_mutex_unlock (&frames->mutex);
+}
+
+static gboolean
+is_stale_frame (gpointer key, gpointer value, gpointer user_data)
+{
+  const guint frame_number = GPOINTER_TO_UINT (key);
+  const guint last_frame_number = GPOINTER_TO_UINT (user_data);
+
+  return (gint) (last_frame_number - frame_number) > MAX_PENDING_FRAMES;
+}
+
+/**
+ * gst_vaapi_timing_frames_add:
+ * @frames: a #GstVaapiTimingFrames
+ * @frame_number: the system frame number of the frame
+ * @scope: the #GstVaapiTimingScope of the stages run for the frame
+ *
+ * Accumulates the durations of @scope to the frame @frame_number.
+ * Nothing is done if @scope was not active.
+ */
+void
+gst_vaapi_timing_frames_add (GstVaapiTimingFrames * frames,
+    guint frame_number, const GstVaapiTimingScope * scope)
+{
+  GstClockTime *durations;
+  guint i;
+
+  g_return_if_fail (frames != NULL);
+  g_return_if_fail (scope != NULL);
+
+  if (!scope->active)
+    return;
+
+  g_mutex_lock (&frames->mutex);
+  durations = g_hash_table_lookup (frames->durations,
+      GUINT_TO_POINTER (frame_number));
+  if (!durations) {
+    if (g_hash_table_size (frames->durations) >= MAX_PENDING_FRAMES)
+      g_hash_table_foreach_remove (frames->durations, is_stale_frame,
+          GUINT_TO_POINTER (frame_number));
+    durations = g_new0 (GstClockTime, GST_VAAPI_TIMING_STAGE_COUNT);
+    g_hash_table_insert (frames->durations, GUINT_TO_POINTER (frame_number),
+        durations);
+  }
+  for (i = 0; i < GST_VAAPI_TIMING_STAGE_COUNT; i++)
+    durations[i] += scope->durations[i];
+  g_mutex_unlock (&frames->mutex);
+}
+
+/**
+ * gst_vaapi_timing_frames_attach:
+ * @frames: a #GstVaapiTimingFrames
+ * @frame_number: the system frame number of the frame
+ * @buffer: the writable output #GstBuffer of the frame
+ *
+ * Moves the timings accumulated for the frame @frame_number, if any,
+ * to a #GstVaapiTimingMeta attached to @buffer. Nothing is done if
+ * the stages are not timed.
+ */
+void
+gst_vaapi_timing_frames_attach (GstVaapiTimingFrames * frames,
+    guint frame_number, GstBuffer * buffer)
+{
+  GstVaapiTimingMeta *meta;
+  GstClockTime *durations;
+
+  g_return_if_fail (frames != NULL);
+  g_return_if_fail (GST_IS_BUFFER (buffer));
+
+  if (!GST_VAAPI_TIMING_IS_ENABLED ())
+    return;
+
+  g_mutex_lock (&frames->mutex);
+  durations = g_hash_table_lookup (frames->durations,
+      GUINT_TO_POINTER (frame_number));
+  if (durations) {
+    meta = gst_buffer_add_vaapi_timing_meta (buffer);
+    if (meta)
+      memcpy (meta->durations, durations, sizeof (meta->durations));
+    g_hash_table_remove (frames->durations, GUINT_TO_POINTER (frame_number));
+  }
+  g_mutex_unlock (&frames->mutex);
+}
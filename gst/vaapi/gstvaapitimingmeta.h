@@ -0,0 +1,88 @@
+/*
+ *  gstvaapitimingmeta.h - Per-frame stage timings
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_TIMING_META_H
+#define GST_VAAPI_TIMING_META_H
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapitiming.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiTimingMeta GstVaapiTimingMeta;
+typedef struct _GstVaapiTimingFrames GstVaapiTimingFrames;
+
+#define GST_VAAPI_TIMING_META_API_TYPE \
+  gst_vaapi_timing_meta_api_get_type ()
+
+/**
+ * GstVaapiTimingMeta:
+ * @meta: parent #GstMeta
+ * @durations: the time spent in each #GstVaapiTimingStage for the
+ *   frame, in nanoseconds
+ *
+ * Timings attached to the output buffers of vaapidecode and vaapiencode
+ * while the "vaapitiming" tracer is active.
+ */
+struct _GstVaapiTimingMeta
+{
+  GstMeta meta;
+
+  GstClockTime durations[GST_VAAPI_TIMING_STAGE_COUNT];
+};
+
+G_GNUC_INTERNAL
+GType
+gst_vaapi_timing_meta_api_get_type (void);
+
+G_GNUC_INTERNAL
+GstVaapiTimingMeta *
+gst_buffer_add_vaapi_timing_meta (GstBuffer * buffer);
+
+#define gst_buffer_get_vaapi_timing_meta(buffer) \
+  ((GstVaapiTimingMeta *) gst_buffer_get_meta ((buffer), \
+      GST_VAAPI_TIMING_META_API_TYPE))
+
+G_GNUC_INTERNAL
+GstVaapiTimingFrames *
+gst_vaapi_timing_frames_new (void);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_timing_frames_free (GstVaapiTimingFrames * frames);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_timing_frames_clear (GstVaapiTimingFrames * frames);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_timing_frames_add (GstVaapiTimingFrames * frames,
+    guint frame_number, const GstVaapiTimingScope * scope);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_timing_frames_attach (GstVaapiTimingFrames * frames,
+    guint frame_number, GstBuffer * buffer);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_TIMING_META_H */
@@ -0,0 +1,170 @@
+/*
+ *  gstvaapitimingtracer.c - Tracer of the VA-API stage timings
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:element-vaapitiming
+ * @short_description: Tracer of the VA-API stage timings
+ *
+ * The vaapitiming tracer turns on the timing of the parsing, picture
+ * submission, surface synchronization and output stages of the VA-API
+ * elements. Each stage is logged as a "vaapi-stage" record, and the
+ * output buffers of vaapidecode and vaapiencode carry the timings of
+ * their frame in a #GstVaapiTimingMeta. A "vaapi-histogram" record per
+ * stage summarizes the durations, by powers of two of microseconds,
+ * when the tracer is destroyed.
+ *
+ * <refsect2>
+ * <title>Example</title>
+ * |[
+ * GST_TRACERS=vaapitiming GST_DEBUG=GST_TRACER:7 \
+ *   gst-launch-1.0 filesrc location=sample.mp4 ! qtdemux ! h264parse ! \
+ *   vaapih264dec ! vaapisink
+ * ]|
+ * </refsect2>
+ */
+
+#include "gstcompat.h"
+#include "gstvaapitimingtracer.h"
+
+#define GST_CAT_DEFAULT gst_debug_vaapi_timing_tracer
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+G_DEFINE_TYPE (GstVaapiTimingTracer, gst_vaapi_timing_tracer,
+    GST_TYPE_TRACER);
+
+static GstTracerRecord *tr_stage;
+static GstTracerRecord *tr_histogram;
+
+static guint
+get_bin (GstClockTime duration)
+{
+  const guint64 us = duration / GST_USECOND;
+  guint bin;
+
+  /* bin 0 holds durations below 1us, bin N those below 2^N us */
+  bin = us > 0 ? g_bit_storage (us) : 0;
+  return MIN (bin, GST_VAAPI_TIMING_TRACER_NUM_BINS - 1);
+}
+
+static void
+timing_func (GstVaapiTimingStage stage, GstClockTime duration,
+    gpointer user_data)
+{
+  GstVaapiTimingTracer *const tracer = GST_VAAPI_TIMING_TRACER (user_data);
+  GstVaapiTimingHistogram *const histogram = &tracer->histograms[stage];
+
+  g_mutex_lock (&tracer->mutex);
+  histogram->count++;
+  histogram->total += duration;
+  histogram->max = MAX (histogram->max, duration);
+  histogram->bins[get_bin (duration)]++;
+  g_mutex_unlock (&tracer->mutex);
+
+  gst_tracer_record_log (tr_stage, gst_vaapi_timing_stage_get_name (stage),
+      duration);
+}
+
+static void
+log_histogram (GstVaapiTimingTracer * tracer, GstVaapiTimingStage stage)
+{
+  const GstVaapiTimingHistogram *const histogram = &tracer->histograms[stage];
+  GString *bins;
+  guint i;
+
+  if (histogram->count == 0)
+    return;
+
+  bins = g_string_new (NULL);
+  for (i = 0; i < GST_VAAPI_TIMING_TRACER_NUM_BINS; i++) {
+    if (histogram->bins[i] == 0)
+      continue;
+    g_string_append_printf (bins, "%s<%" G_GUINT64_FORMAT "us:%"
+        G_GUINT64_FORMAT, bins->len > 0 ? "," : "", G_GUINT64_CONSTANT (1)
+        << i, histogram->bins[i]);
+  }
+
+  gst_tracer_record_log (tr_histogram, gst_vaapi_timing_stage_get_name (stage),
+      histogram->count, histogram->total / histogram->count, histogram->max,
+      bins->str);
+  g_string_free (bins, TRUE);
+}
+
+static void
+gst_vaapi_timing_tracer_finalize (GObject * object)
+{
+  GstVaapiTimingTracer *const tracer = GST_VAAPI_TIMING_TRACER (object);
+  guint i;
+
+  gst_vaapi_timing_set_func (NULL, NULL);
+
+  for (i = 0; i < GST_VAAPI_TIMING_STAGE_COUNT; i++)
+    log_histogram (tracer, i);
+  g_mutex_clear (&tracer->mutex);
+
+  G_OBJECT_CLASS (gst_vaapi_timing_tracer_parent_class)->finalize (object);
+}
+
+static GstStructure *
+make_field (GType type, const gchar * description)
+{
+  return gst_structure_new ("value",
+      "type", G_TYPE_GTYPE, type,
+      "description", G_TYPE_STRING, description,
+      "related-to", GST_TYPE_TRACER_VALUE_SCOPE, GST_TRACER_VALUE_SCOPE_PROCESS,
+      NULL);
+}
+
+static void
+gst_vaapi_timing_tracer_class_init (GstVaapiTimingTracerClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "vaapitiming", 0,
+      "VA-API stage timings tracer");
+
+  object_class->finalize = gst_vaapi_timing_tracer_finalize;
+
+  tr_stage = gst_tracer_record_new ("vaapi-stage.class",
+      "stage", GST_TYPE_STRUCTURE, make_field (G_TYPE_STRING,
+          "the name of the stage"),
+      "duration", GST_TYPE_STRUCTURE, make_field (G_TYPE_UINT64,
+          "the duration of the stage, in nanoseconds"), NULL);
+
+  tr_histogram = gst_tracer_record_new ("vaapi-histogram.class",
+      "stage", GST_TYPE_STRUCTURE, make_field (G_TYPE_STRING,
+          "the name of the stage"),
+      "count", GST_TYPE_STRUCTURE, make_field (G_TYPE_UINT64,
+          "the number of times the stage ran"),
+      "mean", GST_TYPE_STRUCTURE, make_field (G_TYPE_UINT64,
+          "the mean duration of the stage, in nanoseconds"),
+      "max", GST_TYPE_STRUCTURE, make_field (G_TYPE_UINT64,
+          "the maximal duration of the stage, in nanoseconds"),
+      "bins", GST_TYPE_STRUCTURE, make_field (G_TYPE_STRING,
+          "the number of durations below each power of two of "
+          "microseconds"), NULL);
+}
+
+static void
+gst_vaapi_timing_tracer_init (GstVaapiTimingTracer * tracer)
+{
+  g_mutex_init (&tracer->mutex);
+  gst_vaapi_timing_set_func (timing_func, tracer);
+}
@@ -0,0 +1,74 @@
+/*
+ *  gstvaapitimingtracer.h - Tracer of the VA-API stage timings
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_TIMING_TRACER_H
+#define GST_VAAPI_TIMING_TRACER_H
+
+#include <gst/gst.h>
+#include <gst/gsttracer.h>
+#include <gst/gsttracerrecord.h>
+#include <gst/vaapi/gstvaapitiming.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAAPI_TIMING_TRACER \
+  (gst_vaapi_timing_tracer_get_type ())
+#define GST_VAAPI_TIMING_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_VAAPI_TIMING_TRACER, \
+       GstVaapiTimingTracer))
+
+/* Durations are binned by powers of two of microseconds */
+#define GST_VAAPI_TIMING_TRACER_NUM_BINS 24
+
+typedef struct _GstVaapiTimingTracer GstVaapiTimingTracer;
+typedef struct _GstVaapiTimingTracerClass GstVaapiTimingTracerClass;
+typedef struct _GstVaapiTimingHistogram GstVaapiTimingHistogram;
+
+struct _GstVaapiTimingHistogram
+{
+  guint64 count;
+  GstClockTime total;
+  GstClockTime max;
+  guint64 bins[GST_VAAPI_TIMING_TRACER_NUM_BINS];
+};
+
+struct _GstVaapiTimingTracer
+{
+  /*< private >*/
+  GstTracer parent_instance;
+
+  GMutex mutex;
+  GstVaapiTimingHistogram histograms[GST_VAAPI_TIMING_STAGE_COUNT];
+};
+
+struct _GstVaapiTimingTracerClass
+{
+  /*< private >*/
+  GstTracerClass parent_class;
+};
+
+G_GNUC_INTERNAL
+GType
+gst_vaapi_timing_tracer_get_type (void);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_TIMING_TRACER_H */
@@ -25,6 +25,7 @@
 #include "gstvaapivideobuffer.h"
 #include "gstvaapivideomemory.h"
 #include "gstvaapipluginutil.h"
+#include <gst/vaapi/gstvaapisurfacebindings.h>
 #if (USE_GLX || USE_EGL)
 #include "gstvaapivideometa_texture.h"
 #endif
@@ -48,6 +49,7 @@ struct _GstVaapiVideoBufferPoolPrivate
   GstAllocator *allocator;
   GstVideoInfo alloc_info;
   GstVaapiDisplay *display;
+  GstVaapiSurfaceBindings *dmabuf_bindings;
   guint options;
   guint use_dmabuf_memory:1;
 };
@@ -64,6 +66,7 @@ gst_vaapi_video_buffer_pool_finalize (GObject * object)
 
   gst_vaapi_display_replace (&priv->display, NULL);
   g_clear_object (&priv->allocator);
+  gst_vaapi_surface_bindings_free (priv->dmabuf_bindings);
 
   G_OBJECT_CLASS (gst_vaapi_video_buffer_pool_parent_class)->finalize (object);
 }
@@ -367,61 +370,155 @@ gst_vaapi_video_buffer_pool_acquire_buffer (GstBufferPool * pool,
   GstVaapiVideoMeta *meta;
   GstVaapiSurface *surface;
   GstVaapiBufferProxy *dmabuf_proxy;
+  GstVaapiID surface_id;
+  gboolean is_bound;
 
-  ret =
-      GST_BUFFER_POOL_CLASS
-      (gst_vaapi_video_buffer_pool_parent_class)->acquire_buffer (pool, &buffer,
-      params);
-
-  if (!priv->use_dmabuf_memory || !params || !priv_params->proxy
-      || ret != GST_FLOW_OK) {
-    *out_buffer_ptr = buffer;
-    return ret;
+  if (!priv->use_dmabuf_memory || !params || !priv_params->proxy) {
+    return GST_BUFFER_POOL_CLASS
+        (gst_vaapi_video_buffer_pool_parent_class)->acquire_buffer (pool,
+        out_buffer_ptr, params);
   }
 
-  /* The point of the following dance is to attach the right GstMemory to the
-   * current acquired buffer. Indeed this buffer can contain any of the
-   * GstFdmemory since this buffer have been popped out from the buffer pool's
-   * FIFO. So there is no garantee that this matches the current surface. The
-   * va decoder driver might not even use a FIFO. So there is no way to guess
-   * on the ordering. In short acquire_current_buffer on the va driver and on
-   * the buffer pool return none matching data. So we have to manually attach
-   * the right GstFdMemory to the acquired GstBuffer. The right GstMemory is
-   * the one associated with the current surface. */
-  g_assert (gst_buffer_n_memory (buffer) == 1);
-
-  /* Find the cached memory associated with the given surface. */
+  if (GST_BUFFER_POOL_IS_FLUSHING (pool))
+    return GST_FLOW_FLUSHING;
+
   surface = GST_VAAPI_SURFACE_PROXY_SURFACE (priv_params->proxy);
+  surface_id = GST_VAAPI_SURFACE_PROXY_SURFACE_ID (priv_params->proxy);
   dmabuf_proxy = gst_vaapi_surface_peek_buffer_proxy (surface);
-  if (dmabuf_proxy) {
-    mem = gst_vaapi_buffer_proxy_peek_mem (dmabuf_proxy);
-    if (mem == gst_buffer_peek_memory (buffer, 0))
-      mem = NULL;
-    else
-      mem = gst_memory_ref (mem);
-  } else {
-    /* The given surface has not been exported yet. */
-    meta = gst_buffer_get_vaapi_video_meta (buffer);
-    if (gst_vaapi_video_meta_get_surface_proxy (meta))
-      gst_vaapi_video_meta_set_surface_proxy (meta, priv_params->proxy);
 
-    mem =
-        gst_vaapi_dmabuf_memory_new (priv->allocator,
-        gst_buffer_get_vaapi_video_meta (buffer));
+  /* The va decoder driver does not necessarily hand out surfaces in
+   * FIFO order, so the buffers are indexed by the surface they were
+   * bound to: handing back the very buffer that already wraps the
+   * GstFdMemory of the current surface keeps the memory identity
+   * stable for downstream, which may have imported it already. */
+  buffer = gst_vaapi_surface_bindings_acquire (priv->dmabuf_bindings,
+      surface_id);
+  if (buffer) {
+    /* The surface ID may have been recycled for another surface,
+     * e.g. when the decoder's VA context got re-created. */
+    is_bound = dmabuf_proxy && gst_buffer_peek_memory (buffer, 0) ==
+        gst_vaapi_buffer_proxy_peek_mem (dmabuf_proxy);
+    if (!is_bound)
+      GST_DEBUG_OBJECT (pool, "stale binding of buffer %p to surface %"
+          GST_VAAPI_ID_FORMAT, buffer, GST_VAAPI_ID_ARGS (surface_id));
+  } else {
+    /* Prefer a parked buffer to a new one: parked buffers are not
+     * queued in the parent pool, which could otherwise block waiting
+     * for a free buffer while some are available. */
+    buffer = gst_vaapi_surface_bindings_steal (priv->dmabuf_bindings);
+    if (!buffer) {
+      ret =
+          GST_BUFFER_POOL_CLASS
+          (gst_vaapi_video_buffer_pool_parent_class)->acquire_buffer (pool,
+          &buffer, params);
+      if (ret != GST_FLOW_OK)
+        return ret;
+    }
+    is_bound = FALSE;
   }
 
-  /* Attach the GstFdMemory to the output buffer. */
-  if (mem) {
-    GST_DEBUG_OBJECT (pool, "assigning memory %p to acquired buffer %p", mem,
+  /* Keep the surface out of the decoder's pool while the buffer is in
+   * use, it is handed back when the buffer is released. */
+  meta = gst_buffer_get_vaapi_video_meta (buffer);
+  if (meta)
+    gst_vaapi_video_meta_set_surface_proxy (meta, priv_params->proxy);
+
+  if (!is_bound) {
+    /* Attach the GstMemory associated with the current surface to a
+     * buffer that is not bound to it yet. */
+    g_assert (gst_buffer_n_memory (buffer) == 1);
+
+    /* Find the cached memory associated with the given surface. */
+    if (dmabuf_proxy) {
+      mem = gst_vaapi_buffer_proxy_peek_mem (dmabuf_proxy);
+      if (mem == gst_buffer_peek_memory (buffer, 0))
+        mem = NULL;
+      else
+        mem = gst_memory_ref (mem);
+    } else {
+      /* The given surface has not been exported yet. */
+      mem = gst_vaapi_dmabuf_memory_new (priv->allocator, meta);
+    }
+
+    /* Attach the GstFdMemory to the output buffer. */
+    if (mem) {
+      GST_DEBUG_OBJECT (pool, "assigning memory %p to acquired buffer %p",
+          mem, buffer);
+      gst_buffer_replace_memory (buffer, 0, mem);
+      gst_buffer_unset_flags (buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+    }
+    gst_vaapi_surface_bindings_bind (priv->dmabuf_bindings, surface_id,
         buffer);
-    gst_buffer_replace_memory (buffer, 0, mem);
-    gst_buffer_unset_flags (buffer, GST_BUFFER_FLAG_TAG_MEMORY);
   }
 
   *out_buffer_ptr = buffer;
   return GST_FLOW_OK;
 }
 
+static void
+gst_vaapi_video_buffer_pool_release_buffer (GstBufferPool * pool,
+    GstBuffer * buffer)
+{
+  GstVaapiVideoBufferPoolPrivate *const priv =
+      GST_VAAPI_VIDEO_BUFFER_POOL (pool)->priv;
+  GstVaapiVideoMeta *meta;
+
+  if (gst_vaapi_surface_bindings_get_surface_id (priv->dmabuf_bindings,
+          buffer) == GST_VAAPI_ID_INVALID)
+    goto chain_up;
+
+  /* Park the buffer under its surface, unless its memory was touched */
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_TAG_MEMORY) &&
+      gst_buffer_is_all_memory_writable (buffer)) {
+    meta = gst_buffer_get_vaapi_video_meta (buffer);
+    if (meta)
+      gst_vaapi_video_meta_set_surface_proxy (meta, NULL);
+    if (gst_vaapi_surface_bindings_release (priv->dmabuf_bindings, buffer))
+      return;
+  }
+  gst_vaapi_surface_bindings_unbind (priv->dmabuf_bindings, buffer);
+
+chain_up:
+  GST_BUFFER_POOL_CLASS (gst_vaapi_video_buffer_pool_parent_class)->
+      release_buffer (pool, buffer);
+}
+
+static void
+gst_vaapi_video_buffer_pool_free_buffer (GstBufferPool * pool,
+    GstBuffer * buffer)
+{
+  GstVaapiVideoBufferPoolPrivate *const priv =
+      GST_VAAPI_VIDEO_BUFFER_POOL (pool)->priv;
+
+  gst_vaapi_surface_bindings_unbind (priv->dmabuf_bindings, buffer);
+
+  GST_BUFFER_POOL_CLASS (gst_vaapi_video_buffer_pool_parent_class)->free_buffer
+      (pool, buffer);
+}
+
+static gboolean
+gst_vaapi_video_buffer_pool_stop (GstBufferPool * pool)
+{
+  GstVaapiVideoBufferPoolPrivate *const priv =
+      GST_VAAPI_VIDEO_BUFFER_POOL (pool)->priv;
+  GstBuffer *buffer;
+  guint64 num_hits, num_misses;
+
+  gst_vaapi_surface_bindings_get_stats (priv->dmabuf_bindings, &num_hits,
+      &num_misses);
+  if (num_hits + num_misses > 0)
+    GST_DEBUG_OBJECT (pool, "surface bindings: %" G_GUINT64_FORMAT " hits, %"
+        G_GUINT64_FORMAT " misses", num_hits, num_misses);
+
+  /* Hand the parked buffers back to the parent pool, which frees them */
+  while ((buffer = gst_vaapi_surface_bindings_steal (priv->dmabuf_bindings)))
+    GST_BUFFER_POOL_CLASS (gst_vaapi_video_buffer_pool_parent_class)->
+        release_buffer (pool, buffer);
+
+  return GST_BUFFER_POOL_CLASS (gst_vaapi_video_buffer_pool_parent_class)->stop
+      (pool);
+}
+
 static void
 gst_vaapi_video_buffer_pool_reset_buffer (GstBufferPool * pool,
     GstBuffer * buffer)
@@ -455,6 +552,9 @@ gst_vaapi_video_buffer_pool_class_init (GstVaapiVideoBufferPoolClass * klass)
   pool_class->alloc_buffer = gst_vaapi_video_buffer_pool_alloc_buffer;
   pool_class->acquire_buffer = gst_vaapi_video_buffer_pool_acquire_buffer;
   pool_class->reset_buffer = gst_vaapi_video_buffer_pool_reset_buffer;
+  pool_class->release_buffer = gst_vaapi_video_buffer_pool_release_buffer;
+  pool_class->free_buffer = gst_vaapi_video_buffer_pool_free_buffer;
+  pool_class->stop = gst_vaapi_video_buffer_pool_stop;
 
   /**
    * GstVaapiVideoBufferPool:display:
@@ -479,6 +579,7 @@ gst_vaapi_video_buffer_pool_init (GstVaapiVideoBufferPool * pool)
   pool->priv = priv;
 
   gst_video_info_init (&priv->video_info);
+  priv->dmabuf_bindings = gst_vaapi_surface_bindings_new ();
 }
 
 GstBufferPool *
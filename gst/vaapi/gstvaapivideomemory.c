@@ -32,6 +32,9 @@ GST_DEBUG_CATEGORY_STATIC (CAT_PERFORMANCE);
 GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapivideomemory);
 #define GST_CAT_DEFAULT gst_debug_vaapivideomemory
 
+/* Maximum size of the downloaded images kept for further reads */
+#define IMAGE_CACHE_MAX_SIZE (32 * 1024 * 1024)
+
 #ifndef GST_VIDEO_INFO_FORMAT_STRING
 #define GST_VIDEO_INFO_FORMAT_STRING(vip) \
   gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (vip))
@@ -145,23 +148,103 @@ ensure_image (GstVaapiVideoMemory * mem)
   return TRUE;
 }
 
+/* Reuses the image the current surface contents were downloaded into
+   by another reader, if any */
 static gboolean
-ensure_image_is_current (GstVaapiVideoMemory * mem)
+map_cached_image (GstVaapiVideoMemory * mem)
 {
-  if (!use_native_formats (mem->usage_flag))
-    return TRUE;
+  GstVaapiVideoAllocator *const allocator =
+      GST_VAAPI_VIDEO_ALLOCATOR_CAST (GST_MEMORY_CAST (mem)->allocator);
+  GstVaapiImage *image;
+  guint key;
 
-  if (!GST_VAAPI_VIDEO_MEMORY_FLAG_IS_SET (mem,
-          GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT)) {
-    if (!gst_vaapi_surface_get_image (mem->surface, mem->image))
-      return FALSE;
+  if (!use_native_formats (mem->usage_flag) || !allocator->image_cache)
+    return FALSE;
 
-    GST_VAAPI_VIDEO_MEMORY_FLAG_SET (mem,
-        GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT);
-  }
+  /* Our own image is already up-to-date */
+  if (gst_vaapi_image_sync_get_flags (&mem->sync) &
+      GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT)
+    return FALSE;
+
+  key = gst_vaapi_surface_get_generation (mem->surface);
+  image = gst_vaapi_image_cache_lookup (allocator->image_cache, key);
+  if (!image)
+    return FALSE;
+
+  gst_vaapi_video_memory_reset_image (mem);
+  mem->image = image;
+  mem->cached_image_key = key;
+  gst_vaapi_video_meta_set_image (mem->meta, image);
   return TRUE;
 }
 
+/* Hands the freshly downloaded and mapped image over to the cache */
+static void
+cache_image (GstVaapiVideoMemory * mem)
+{
+  GstVaapiVideoAllocator *const allocator =
+      GST_VAAPI_VIDEO_ALLOCATOR_CAST (GST_MEMORY_CAST (mem)->allocator);
+  const guint sync_flags = GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT |
+      GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT;
+  guint key;
+
+  if (!use_native_formats (mem->usage_flag) || !allocator->image_cache)
+    return;
+  if ((gst_vaapi_image_sync_get_flags (&mem->sync) & sync_flags) != sync_flags)
+    return;
+
+  key = gst_vaapi_surface_get_generation (mem->surface);
+  if (!gst_vaapi_image_cache_insert (allocator->image_cache, key, mem->image,
+          gst_vaapi_image_get_data_size (mem->image)))
+    return;
+  mem->cached_image_key = key;
+}
+
+static void
+unmap_cached_image (GstVaapiVideoMemory * mem)
+{
+  /* The image stays mapped until it is evicted from the cache */
+  gst_vaapi_video_meta_set_image (mem->meta, NULL);
+  gst_vaapi_video_memory_reset_image (mem);
+}
+
+static void
+image_cache_destroy_item (gpointer item, gpointer user_data)
+{
+  GstVaapiImage *const image = item;
+  GstVaapiVideoAllocator *const allocator = user_data;
+
+  gst_vaapi_image_unmap (image);
+  gst_vaapi_video_pool_put_object (allocator->image_pool, image);
+}
+
+static gboolean
+image_sync_get_image (gpointer user_data)
+{
+  GstVaapiVideoMemory *const mem = user_data;
+
+  return gst_vaapi_surface_get_image (mem->surface, mem->image);
+}
+
+static gboolean
+image_sync_put_image (gpointer user_data, guint planes, guint y, guint height)
+{
+  GstVaapiVideoMemory *const mem = user_data;
+  GstVaapiRectangle rect;
+
+  /* vaPutImage() always copies all planes of the selected rows */
+  rect.x = 0;
+  rect.y = y;
+  rect.width = GST_VIDEO_INFO_WIDTH (mem->image_info);
+  rect.height = height;
+  return gst_vaapi_surface_put_image_rect (mem->surface, mem->image, &rect);
+}
+
+static const GstVaapiImageSyncFuncs image_sync_funcs = {
+  image_sync_get_image,
+  image_sync_put_image,
+};
+
 static GstVaapiSurface *
 new_surface (GstVaapiDisplay * display, const GstVideoInfo * vip,
     GstVaapiImageUsageFlags usage_flag)
@@ -221,17 +304,7 @@ ensure_surface_is_current (GstVaapiVideoMemory * mem)
   if (!use_native_formats (mem->usage_flag))
     return TRUE;
 
-  if (!GST_VAAPI_VIDEO_MEMORY_FLAG_IS_SET (mem,
-          GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT)) {
-    if (GST_VAAPI_VIDEO_MEMORY_FLAG_IS_SET (mem,
-            GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT)
-        && !gst_vaapi_surface_put_image (mem->surface, mem->image))
-      return FALSE;
-
-    GST_VAAPI_VIDEO_MEMORY_FLAG_SET (mem,
-        GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT);
-  }
-  return TRUE;
+  return gst_vaapi_image_sync_ensure_surface (&mem->sync);
 }
 
 static inline gboolean
@@ -239,22 +312,25 @@ map_vaapi_memory (GstVaapiVideoMemory * mem, GstMapFlags flags)
 {
   if (!ensure_surface (mem))
     goto error_no_surface;
+
+  /* Share downloads of the same surface contents among readers */
+  if ((flags & GST_MAP_READWRITE) == GST_MAP_READ && map_cached_image (mem))
+    return TRUE;
+
   if (!ensure_image (mem))
     goto error_no_image;
 
-  /* Load VA image from surface only for read flag since it returns
-   * raw pixels */
-  if ((flags & GST_MAP_READ) && !ensure_image_is_current (mem))
+  /* Load VA image from surface only if its previous contents are
+   * needed. Derived images share the surface pixels */
+  if (use_native_formats (mem->usage_flag) &&
+      !gst_vaapi_image_sync_map (&mem->sync, flags))
     goto error_no_current_image;
 
   if (!gst_vaapi_image_map (mem->image))
     goto error_map_image;
 
-  /* Mark surface as dirty and expect updates from image */
-  if (flags & GST_MAP_WRITE)
-    GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET (mem,
-        GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT);
-
+  if ((flags & GST_MAP_READWRITE) == GST_MAP_READ)
+    cache_image (mem);
   return TRUE;
 
 error_no_surface:
@@ -286,17 +362,41 @@ error_map_image:
   }
 }
 
+/* Adds the @flags of another mapping, e.g. of another plane, to the
+   current mapping */
+static gboolean
+remap_vaapi_memory (GstVaapiVideoMemory * mem, GstMapFlags flags)
+{
+  /* The cached image is shared with other readers */
+  if (mem->cached_image_key) {
+    if (!(flags & GST_MAP_WRITE))
+      return TRUE;
+    GST_ERROR ("cannot write to an image shared with other readers");
+    return FALSE;
+  }
+
+  if (use_native_formats (mem->usage_flag) &&
+      !gst_vaapi_image_sync_map (&mem->sync, flags))
+    return FALSE;
+  return TRUE;
+}
+
 static inline void
 unmap_vaapi_memory (GstVaapiVideoMemory * mem, GstMapFlags flags)
 {
-  gst_vaapi_image_unmap (mem->image);
-
-  if (flags & GST_MAP_WRITE) {
-    GST_VAAPI_VIDEO_MEMORY_FLAG_SET (mem,
-        GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT);
+  if (mem->cached_image_key) {
+    unmap_cached_image (mem);
+    return;
   }
 
-  if (!use_native_formats (mem->usage_flag)) {
+  gst_vaapi_image_unmap (mem->image);
+
+  /* Upload the modified rows back to the surface */
+  if (use_native_formats (mem->usage_flag)) {
+    if (!gst_vaapi_image_sync_unmap (&mem->sync))
+      GST_ERROR ("failed to upload image %" GST_VAAPI_ID_FORMAT,
+          GST_VAAPI_ID_ARGS (gst_vaapi_image_get_id (mem->image)));
+  } else {
     gst_vaapi_video_meta_set_image (mem->meta, NULL);
     gst_vaapi_video_memory_reset_image (mem);
   }
@@ -326,12 +426,17 @@ gst_video_meta_map_vaapi_memory (GstVideoMeta * meta, guint plane,
     if (!map_vaapi_memory (mem, flags))
       goto out;
     mem->map_type = GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_PLANAR;
-  }
+  } else if (!remap_vaapi_memory (mem, flags))
+    goto out;
   mem->map_count++;
+  mem->map_flags |= flags & GST_MAP_READWRITE;
 
   *data = gst_vaapi_image_get_plane (mem->image, plane);
   *stride = gst_vaapi_image_get_pitch (mem->image, plane);
   info->flags = flags;
+
+  if ((flags & GST_MAP_WRITE) && use_native_formats (mem->usage_flag))
+    gst_vaapi_image_sync_mark_dirty (&mem->sync, 1U << plane, 0, 0);
   ret = (*data != NULL);
 
 out:
@@ -366,9 +471,11 @@ gst_video_meta_unmap_vaapi_memory (GstVideoMeta * meta, guint plane,
   if (--mem->map_count == 0) {
     mem->map_type = 0;
 
-    /* Unmap VA image used for read/writes */
-    if (info->flags & GST_MAP_READWRITE)
-      unmap_vaapi_memory (mem, info->flags);
+    /* Unmap VA image used for read/writes, with the flags of all the
+       planes that were mapped */
+    if (mem->map_flags & GST_MAP_READWRITE)
+      unmap_vaapi_memory (mem, mem->map_flags);
+    mem->map_flags = 0;
   }
   g_mutex_unlock (&mem->lock);
   return TRUE;
@@ -402,11 +509,12 @@ gst_vaapi_video_memory_new (GstAllocator * base_allocator,
   mem->meta = meta ? gst_vaapi_video_meta_ref (meta) : NULL;
   mem->map_type = 0;
   mem->map_count = 0;
+  mem->map_flags = 0;
   mem->usage_flag = allocator->usage_flag;
+  mem->cached_image_key = 0;
+  gst_vaapi_image_sync_init (&mem->sync, &image_sync_funcs, mem,
+      GST_VIDEO_INFO_HEIGHT (mem->image_info));
   g_mutex_init (&mem->lock);
-
-  GST_VAAPI_VIDEO_MEMORY_FLAG_SET (mem,
-      GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT);
   return GST_MEMORY_CAST (mem);
 }
 
@@ -416,7 +524,13 @@ gst_vaapi_video_memory_reset_image (GstVaapiVideoMemory * mem)
   GstVaapiVideoAllocator *const allocator =
       GST_VAAPI_VIDEO_ALLOCATOR_CAST (GST_MEMORY_CAST (mem)->allocator);
 
-  if (!use_native_formats (mem->usage_flag))
+  if (mem->cached_image_key) {
+    /* The image is owned by the cache */
+    gst_vaapi_image_cache_release (allocator->image_cache,
+        mem->cached_image_key);
+    mem->cached_image_key = 0;
+    mem->image = NULL;
+  } else if (!use_native_formats (mem->usage_flag))
     gst_vaapi_object_replace (&mem->image, NULL);
   else if (mem->image) {
     gst_vaapi_video_pool_put_object (allocator->image_pool, mem->image);
@@ -425,8 +539,7 @@ gst_vaapi_video_memory_reset_image (GstVaapiVideoMemory * mem)
 
   /* Don't synchronize to surface, this shall have happened during
    * unmaps */
-  GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET (mem,
-      GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT);
+  gst_vaapi_image_sync_invalidate_image (&mem->sync);
 }
 
 void
@@ -438,8 +551,8 @@ gst_vaapi_video_memory_reset_surface (GstVaapiVideoMemory * mem)
   if (mem->meta)
     gst_vaapi_video_meta_set_surface_proxy (mem->meta, NULL);
 
-  GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET (mem,
-      GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT);
+  /* The next surface has undefined contents */
+  gst_vaapi_image_sync_reset (&mem->sync);
 }
 
 gboolean
@@ -450,6 +563,31 @@ gst_vaapi_video_memory_sync (GstVaapiVideoMemory * mem)
   return ensure_surface_is_current (mem);
 }
 
+/**
+ * gst_vaapi_video_memory_mark_dirty_rows:
+ * @mem: a #GstVaapiVideoMemory
+ * @y: the first modified row
+ * @height: the number of modified rows
+ *
+ * Records that only the rows [@y, @y + @height) were modified through
+ * the current mapping for writing, so that only those rows are
+ * uploaded to the VA surface on unmap. This is only a hint, which is
+ * ignored for derived images. @mem shall be mapped for writing.
+ */
+void
+gst_vaapi_video_memory_mark_dirty_rows (GstVaapiVideoMemory * mem, guint y,
+    guint height)
+{
+  g_return_if_fail (mem != NULL);
+
+  g_mutex_lock (&mem->lock);
+  if (!(mem->map_flags & GST_MAP_WRITE))
+    GST_ERROR ("memory is not mapped for writing");
+  else if (use_native_formats (mem->usage_flag))
+    gst_vaapi_image_sync_mark_dirty (&mem->sync, 0, y, height);
+  g_mutex_unlock (&mem->lock);
+}
+
 static gpointer
 gst_vaapi_video_memory_map (GstMemory * base_mem, gsize maxsize, guint flags)
 {
@@ -473,9 +611,12 @@ gst_vaapi_video_memory_map (GstMemory * base_mem, gsize maxsize, guint flags)
         mem->map_type = GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_SURFACE;
         break;
       case GST_MAP_READ:
+      case GST_MAP_WRITE:
+      case GST_MAP_READWRITE:
         if (!map_vaapi_memory (mem, flags))
           goto out;
         mem->map_type = GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_LINEAR;
+        mem->map_flags = flags & GST_MAP_READWRITE;
         break;
       default:
         goto error_unsupported_map;
@@ -542,12 +683,13 @@ gst_vaapi_video_memory_unmap_full (GstMemory * base_mem, GstMapInfo * info)
         gst_vaapi_surface_proxy_replace (&mem->proxy, NULL);
         break;
       case GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_LINEAR:
-        unmap_vaapi_memory (mem, info->flags);
+        unmap_vaapi_memory (mem, mem->map_flags);
         break;
       default:
         goto error_incompatible_map;
     }
     mem->map_type = 0;
+    mem->map_flags = 0;
   }
   mem->map_count--;
 
@@ -642,6 +784,17 @@ gst_vaapi_video_allocator_finalize (GObject * object)
   GstVaapiVideoAllocator *const allocator =
       GST_VAAPI_VIDEO_ALLOCATOR_CAST (object);
 
+  if (allocator->image_cache) {
+    guint64 num_hits, num_misses;
+
+    gst_vaapi_image_cache_get_stats (allocator->image_cache, &num_hits,
+        &num_misses, NULL);
+    _init_performance_debug ();
+    GST_CAT_INFO (CAT_PERFORMANCE, "image cache: %" G_GUINT64_FORMAT
+        " hits, %" G_GUINT64_FORMAT " misses", num_hits, num_misses);
+    gst_vaapi_image_cache_free (allocator->image_cache);
+    allocator->image_cache = NULL;
+  }
   gst_vaapi_video_pool_replace (&allocator->surface_pool, NULL);
   gst_vaapi_video_pool_replace (&allocator->image_pool, NULL);
 
@@ -875,6 +1028,9 @@ allocator_params_init (GstVaapiVideoAllocator * allocator,
   if (!allocator->image_pool)
     goto error_create_image_pool;
 
+  allocator->image_cache = gst_vaapi_image_cache_new (IMAGE_CACHE_MAX_SIZE,
+      image_cache_destroy_item, allocator);
+
   gst_allocator_set_vaapi_video_info (GST_ALLOCATOR_CAST (allocator),
       &allocator->image_info, surface_alloc_flags);
 
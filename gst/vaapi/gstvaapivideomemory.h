@@ -27,6 +27,8 @@
 #include <gst/video/video-info.h>
 #include <gst/vaapi/gstvaapidisplay.h>
 #include <gst/vaapi/gstvaapivideopool.h>
+#include <gst/vaapi/gstvaapiimagesync.h>
+#include <gst/vaapi/gstvaapiimagecache.h>
 #include "gstvaapivideometa.h"
 #include <gst/allocators/allocators.h>
 
@@ -52,13 +54,6 @@ typedef struct _GstVaapiDmaBufAllocatorClass GstVaapiDmaBufAllocatorClass;
 
 #define GST_CAPS_FEATURE_MEMORY_VAAPI_SURFACE   "memory:VASurface"
 
-#define GST_VAAPI_VIDEO_MEMORY_FLAG_IS_SET(mem, flag) \
-  GST_MEMORY_FLAG_IS_SET (mem, flag)
-#define GST_VAAPI_VIDEO_MEMORY_FLAG_SET(mem, flag) \
-  GST_MINI_OBJECT_FLAG_SET (mem, flag)
-#define GST_VAAPI_VIDEO_MEMORY_FLAG_UNSET(mem, flag) \
-  GST_MEMORY_FLAG_UNSET (mem, flag)
-
 /**
  * GstVaapiVideoMemoryMapType:
  * @GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_SURFACE: map with gst_buffer_map()
@@ -66,7 +61,8 @@ typedef struct _GstVaapiDmaBufAllocatorClass GstVaapiDmaBufAllocatorClass;
  * @GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_PLANAR: map individual plane with
  *   gst_video_frame_map()
  * @GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_LINEAR: map with gst_buffer_map()
- *   and flags = GST_MAP_READ to return the raw pixels of the whole image
+ *   and flags = GST_MAP_READ, GST_MAP_WRITE or GST_MAP_READWRITE to
+ *   access the raw pixels of the whole image
  *
  * The set of all #GstVaapiVideoMemory map types.
  */
@@ -77,21 +73,6 @@ typedef enum
   GST_VAAPI_VIDEO_MEMORY_MAP_TYPE_LINEAR
 } GstVaapiVideoMemoryMapType;
 
-/**
- * GstVaapiVideoMemoryFlags:
- * @GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT: The embedded
- *   #GstVaapiSurface has the up-to-date video frame contents.
- * @GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT: The embedded
- *   #GstVaapiImage has the up-to-date video frame contents.
- *
- * The set of extended #GstMemory flags.
- */
-typedef enum
-{
-  GST_VAAPI_VIDEO_MEMORY_FLAG_SURFACE_IS_CURRENT = GST_MEMORY_FLAG_LAST << 0,
-  GST_VAAPI_VIDEO_MEMORY_FLAG_IMAGE_IS_CURRENT = GST_MEMORY_FLAG_LAST << 1,
-} GstVaapiVideoMemoryFlags;
-
 /**
  * GstVaapiImageUsageFlags:
  * @GST_VAAPI_IMAGE_USAGE_FLAG_NATIVE_FORMATS: will use vaCreateImage +
@@ -128,7 +109,10 @@ struct _GstVaapiVideoMemory
   GstVaapiVideoMeta *meta;
   guint map_type;
   gint map_count;
+  GstMapFlags map_flags;
   GstVaapiImageUsageFlags usage_flag;
+  GstVaapiImageSync sync;
+  guint cached_image_key;
   GMutex lock;
 };
 
@@ -154,6 +138,11 @@ G_GNUC_INTERNAL
 gboolean
 gst_vaapi_video_memory_sync (GstVaapiVideoMemory * mem);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_video_memory_mark_dirty_rows (GstVaapiVideoMemory * mem, guint y,
+    guint height);
+
 /* ------------------------------------------------------------------------ */
 /* --- GstVaapiVideoAllocator                                           --- */
 /* ------------------------------------------------------------------------ */
@@ -186,6 +175,7 @@ struct _GstVaapiVideoAllocator
   GstVaapiVideoPool *surface_pool;
   GstVideoInfo image_info;
   GstVaapiVideoPool *image_pool;
+  GstVaapiImageCache *image_cache;
   GstVaapiImageUsageFlags usage_flag;
 };
 
@@ -0,0 +1,234 @@
+/*
+ *  test-caps-cache.c - Test memoized caps
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapicapscache.h>
+#include <gst/vaapi/gstvaapiprofile.h>
+
+#define NUM_QUERIES     10000
+#define NUM_THREADS     8
+
+/* The decode profiles of a typical driver */
+static const GstVaapiProfile g_profiles[] = {
+  GST_VAAPI_PROFILE_MPEG2_SIMPLE,
+  GST_VAAPI_PROFILE_MPEG2_MAIN,
+  GST_VAAPI_PROFILE_H264_CONSTRAINED_BASELINE,
+  GST_VAAPI_PROFILE_H264_MAIN,
+  GST_VAAPI_PROFILE_H264_HIGH,
+  GST_VAAPI_PROFILE_VC1_SIMPLE,
+  GST_VAAPI_PROFILE_VC1_MAIN,
+  GST_VAAPI_PROFILE_VC1_ADVANCED,
+  GST_VAAPI_PROFILE_JPEG_BASELINE,
+  GST_VAAPI_PROFILE_VP8,
+  GST_VAAPI_PROFILE_H265_MAIN,
+  GST_VAAPI_PROFILE_H265_MAIN10,
+  GST_VAAPI_PROFILE_VP9_0,
+};
+
+static gint g_num_builds;
+
+/* Mimics the vaapidecode sink pad caps computation */
+static GstCaps *
+build_decode_caps (gpointer user_data)
+{
+  GstCaps *caps, *out_caps;
+  guint i;
+
+  g_atomic_int_inc (&g_num_builds);
+
+  out_caps = gst_caps_new_empty ();
+  for (i = 0; i < G_N_ELEMENTS (g_profiles); i++) {
+    const gchar *const media_type_name =
+        gst_vaapi_profile_get_media_type_name (g_profiles[i]);
+    const gchar *const profile_name =
+        gst_vaapi_profile_get_name (g_profiles[i]);
+
+    if (!media_type_name)
+      continue;
+    caps = gst_caps_from_string (media_type_name);
+    if (profile_name)
+      gst_caps_set_simple (caps, "profile", G_TYPE_STRING, profile_name,
+          NULL);
+    out_caps = gst_caps_merge (out_caps, caps);
+  }
+  return gst_caps_simplify (out_caps);
+}
+
+/* One CAPS query, as answered by an element */
+static void
+answer_caps_query (GstCaps * allowed_caps, GstCaps * filter)
+{
+  GstCaps *result;
+
+  result = gst_caps_intersect_full (filter, allowed_caps,
+      GST_CAPS_INTERSECT_FIRST);
+  g_assert (!gst_caps_is_empty (result));
+  gst_caps_unref (result);
+}
+
+static void
+test_query_storm (void)
+{
+  GstVaapiCapsCache *cache;
+  GstCaps *filter, *caps, *uncached_caps;
+  guint64 num_hits, num_misses;
+  gint64 start_time, uncached_time, cached_time;
+  guint i;
+
+  cache = gst_vaapi_caps_cache_new ();
+  filter = gst_caps_from_string ("video/x-h264; video/x-h265");
+
+  /* Each element instance rebuilds its caps, as on relinking */
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < NUM_QUERIES; i++) {
+    caps = build_decode_caps (NULL);
+    answer_caps_query (caps, filter);
+    gst_caps_unref (caps);
+  }
+  uncached_time = g_get_monotonic_time () - start_time;
+
+  g_num_builds = 0;
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < NUM_QUERIES; i++) {
+    caps = gst_vaapi_caps_cache_get (cache, "vaapidecode-sink", NULL,
+        build_decode_caps, NULL);
+    answer_caps_query (caps, filter);
+    gst_caps_unref (caps);
+  }
+  cached_time = g_get_monotonic_time () - start_time;
+
+  g_print ("%u CAPS queries: %" G_GINT64_FORMAT " us uncached, %"
+      G_GINT64_FORMAT " us cached\n", NUM_QUERIES, uncached_time, cached_time);
+
+  /* The caps were built once, and are the very same */
+  g_assert_cmpint (g_num_builds, ==, 1);
+  gst_vaapi_caps_cache_get_stats (cache, &num_hits, &num_misses);
+  g_assert_cmpuint (num_misses, ==, 1);
+  g_assert_cmpuint (num_hits, ==, NUM_QUERIES - 1);
+  caps = gst_vaapi_caps_cache_get (cache, "vaapidecode-sink", NULL,
+      build_decode_caps, NULL);
+  uncached_caps = build_decode_caps (NULL);
+  g_assert (gst_caps_is_equal (caps, uncached_caps));
+  gst_caps_unref (uncached_caps);
+  gst_caps_unref (caps);
+
+  gst_caps_unref (filter);
+  gst_vaapi_caps_cache_free (cache);
+}
+
+static GstCaps *
+build_failing_caps (gpointer user_data)
+{
+  return NULL;
+}
+
+static void
+test_keys (void)
+{
+  GstVaapiCapsCache *cache;
+  GstCaps *caps, *dmabuf_caps;
+
+  cache = gst_vaapi_caps_cache_new ();
+  g_num_builds = 0;
+
+  /* Features are part of the key */
+  caps = gst_vaapi_caps_cache_get (cache, "vaapidecode-src", NULL,
+      build_decode_caps, NULL);
+  dmabuf_caps = gst_vaapi_caps_cache_get (cache, "vaapidecode-src", "dmabuf",
+      build_decode_caps, NULL);
+  g_assert (caps != dmabuf_caps);
+  g_assert_cmpint (g_num_builds, ==, 2);
+  gst_caps_unref (dmabuf_caps);
+  gst_caps_unref (caps);
+
+  /* Failures are not memoized */
+  g_assert (gst_vaapi_caps_cache_get (cache, "vaapipostproc-src", NULL,
+          build_failing_caps, NULL) == NULL);
+  caps = gst_vaapi_caps_cache_get (cache, "vaapipostproc-src", NULL,
+      build_decode_caps, NULL);
+  g_assert (caps != NULL);
+  gst_caps_unref (caps);
+
+  /* Clearing releases the memoized caps only */
+  caps = gst_vaapi_caps_cache_get (cache, "vaapidecode-src", NULL,
+      build_decode_caps, NULL);
+  gst_vaapi_caps_cache_clear (cache);
+  g_assert_cmpint (GST_MINI_OBJECT_REFCOUNT_VALUE (caps), ==, 1);
+  dmabuf_caps = gst_vaapi_caps_cache_get (cache, "vaapidecode-src", NULL,
+      build_decode_caps, NULL);
+  g_assert (caps != dmabuf_caps);
+  gst_caps_unref (dmabuf_caps);
+  gst_caps_unref (caps);
+
+  gst_vaapi_caps_cache_free (cache);
+}
+
+static gpointer
+query_thread (gpointer data)
+{
+  GstVaapiCapsCache *const cache = data;
+  GstCaps *caps;
+  guint i;
+
+  for (i = 0; i < NUM_QUERIES / NUM_THREADS; i++) {
+    caps = gst_vaapi_caps_cache_get (cache, "vaapidecode-sink", NULL,
+        build_decode_caps, NULL);
+    g_assert (caps != NULL);
+    gst_caps_unref (caps);
+  }
+  return NULL;
+}
+
+static void
+test_threads (void)
+{
+  GstVaapiCapsCache *cache;
+  GThread *threads[NUM_THREADS];
+  guint64 num_hits, num_misses;
+  guint i;
+
+  cache = gst_vaapi_caps_cache_new ();
+  for (i = 0; i < NUM_THREADS; i++)
+    threads[i] = g_thread_new ("query", query_thread, cache);
+  for (i = 0; i < NUM_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  /* Concurrent builds may happen, but only on the first queries */
+  gst_vaapi_caps_cache_get_stats (cache, &num_hits, &num_misses);
+  g_assert_cmpuint (num_hits + num_misses, ==,
+      NUM_THREADS * (NUM_QUERIES / NUM_THREADS));
+  g_assert_cmpuint (num_misses, <=, NUM_THREADS);
+  gst_vaapi_caps_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_query_storm ();
+  test_keys ();
+  test_threads ();
+
+  g_print ("all caps cache tests passed\n");
+  gst_deinit ();
+  return 0;
+}
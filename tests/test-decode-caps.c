@@ -0,0 +1,186 @@
+/*
+ *  test-decode-caps.c - Test input caps changes in vaapidecode
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include "test-h264.h"
+
+#define NUM_CAPS_CHANGES        50
+#define FRAMES_PER_CAPS         4
+
+/* Alternated input frame rates, each change renegotiates the output */
+static const gint g_framerates[][2] = { {30, 1}, {25, 1} };
+
+typedef struct
+{
+  GMutex mutex;
+  guint num_buffers;
+  GstCaps *caps;
+} OutputSink;
+
+static GstFlowReturn
+output_sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  OutputSink *const sink = GST_PAD_ELEMENT_PRIVATE (pad);
+
+  g_mutex_lock (&sink->mutex);
+  sink->num_buffers++;
+  g_mutex_unlock (&sink->mutex);
+  gst_buffer_unref (buffer);
+  return GST_FLOW_OK;
+}
+
+static gboolean
+output_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  OutputSink *const sink = GST_PAD_ELEMENT_PRIVATE (pad);
+  GstCaps *caps;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+    gst_event_parse_caps (event, &caps);
+    g_mutex_lock (&sink->mutex);
+    gst_caps_replace (&sink->caps, caps);
+    g_mutex_unlock (&sink->mutex);
+  }
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static GstCaps *
+make_input_caps (const VideoDecodeInfo * info, guint index)
+{
+  return gst_caps_new_simple ("video/x-h264",
+      "stream-format", G_TYPE_STRING, "byte-stream",
+      "alignment", G_TYPE_STRING, "au",
+      "width", G_TYPE_INT, info->width,
+      "height", G_TYPE_INT, info->height,
+      "framerate", GST_TYPE_FRACTION, g_framerates[index][0],
+      g_framerates[index][1], NULL);
+}
+
+static void
+push_event (GstPad * srcpad, GstEvent * event)
+{
+  if (!gst_pad_push_event (srcpad, event))
+    g_error ("failed to push event");
+}
+
+/* Changes the input caps every few frames, while the shared scheduler
+   decodes on its workers and the streaming thread pushes the output */
+static void
+test_caps_changes (gboolean shared_scheduler)
+{
+  GstElement *decoder;
+  GstPad *srcpad, *sinkpad, *pad;
+  GstSegment segment;
+  GstBuffer *buffer;
+  GstStructure *structure;
+  VideoDecodeInfo info;
+  OutputSink sink;
+  gint fps_n, fps_d;
+  guint i, j, num_frames = 0, index = 0;
+
+  decoder = gst_element_factory_make ("vaapih264dec", NULL);
+  if (!decoder) {
+    g_print ("vaapih264dec is not available, skipping\n");
+    return;
+  }
+  g_object_set (decoder, "shared-scheduler", shared_scheduler, NULL);
+  h264_get_video_info (&info);
+
+  g_mutex_init (&sink.mutex);
+  sink.num_buffers = 0;
+  sink.caps = NULL;
+
+  srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  GST_PAD_ELEMENT_PRIVATE (sinkpad) = &sink;
+  gst_pad_set_chain_function (sinkpad, output_sink_chain);
+  gst_pad_set_event_function (sinkpad, output_sink_event);
+
+  pad = gst_element_get_static_pad (decoder, "sink");
+  g_assert (gst_pad_link (srcpad, pad) == GST_PAD_LINK_OK);
+  gst_object_unref (pad);
+  pad = gst_element_get_static_pad (decoder, "src");
+  g_assert (gst_pad_link (pad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (pad);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+  if (gst_element_set_state (decoder, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE)
+    g_error ("failed to start vaapih264dec");
+
+  push_event (srcpad, gst_event_new_stream_start ("test-decode-caps"));
+  push_event (srcpad, gst_event_new_caps (make_input_caps (&info, 0)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  push_event (srcpad, gst_event_new_segment (&segment));
+
+  for (i = 0; i < NUM_CAPS_CHANGES; i++) {
+    index = i % G_N_ELEMENTS (g_framerates);
+    if (i > 0)
+      push_event (srcpad, gst_event_new_caps (make_input_caps (&info, index)));
+
+    /* The clip holds a single IDR frame, each copy decodes on its own */
+    for (j = 0; j < FRAMES_PER_CAPS; j++) {
+      buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+          (gpointer) info.data, info.data_size, 0, info.data_size, NULL,
+          NULL);
+      GST_BUFFER_PTS (buffer) = gst_util_uint64_scale (num_frames,
+          g_framerates[index][1] * GST_SECOND, g_framerates[index][0]);
+      if (gst_pad_push (srcpad, buffer) != GST_FLOW_OK)
+        g_error ("failed to push frame %u", num_frames);
+      num_frames++;
+    }
+  }
+  push_event (srcpad, gst_event_new_eos ());
+
+  /* Every frame made it out, with the last negotiated frame rate */
+  g_mutex_lock (&sink.mutex);
+  g_assert_cmpuint (sink.num_buffers, ==, num_frames);
+  g_assert (sink.caps != NULL);
+  structure = gst_caps_get_structure (sink.caps, 0);
+  g_assert (gst_structure_get_fraction (structure, "framerate", &fps_n,
+          &fps_d));
+  g_assert_cmpint (fps_n, ==, g_framerates[index][0]);
+  g_assert_cmpint (fps_d, ==, g_framerates[index][1]);
+  g_mutex_unlock (&sink.mutex);
+
+  gst_element_set_state (decoder, GST_STATE_NULL);
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_object_unref (srcpad);
+  gst_object_unref (sinkpad);
+  gst_object_unref (decoder);
+  gst_caps_replace (&sink.caps, NULL);
+  g_mutex_clear (&sink.mutex);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_caps_changes (FALSE);
+  test_caps_changes (TRUE);
+
+  g_print ("all decode caps tests passed\n");
+  gst_deinit ();
+  return 0;
+}
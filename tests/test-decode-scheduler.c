@@ -0,0 +1,377 @@
+/*
+ *  test-decode-scheduler.c - Test decode jobs scheduling
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapidecodescheduler.h>
+
+#define NUM_STREAMS     64
+#define NUM_FRAMES      100
+
+/* Stub display: its lock is what decode jobs contend for */
+typedef struct
+{
+  GMutex mutex;
+  gboolean is_locked;
+  guint num_locks;
+} StubDisplay;
+
+static void
+stub_display_lock (gpointer user_data)
+{
+  StubDisplay *const display = user_data;
+
+  g_mutex_lock (&display->mutex);
+  g_assert (!display->is_locked);
+  display->is_locked = TRUE;
+  display->num_locks++;
+}
+
+static void
+stub_display_unlock (gpointer user_data)
+{
+  StubDisplay *const display = user_data;
+
+  g_assert (display->is_locked);
+  display->is_locked = FALSE;
+  g_mutex_unlock (&display->mutex);
+}
+
+/* Synthetic stream, decoding frames numbered in sequence */
+typedef struct
+{
+  StubDisplay *display;
+  GstVaapiDecodeSchedulerStream *stream;
+  GThread *thread;
+  guint next_frame;
+} SyntheticStream;
+
+static GstVaapiDecoderStatus
+synthetic_stream_decode (gpointer stream_data, gpointer job_data)
+{
+  SyntheticStream *const stream = stream_data;
+
+  g_assert (stream->display->is_locked);
+  g_assert_cmpuint (GPOINTER_TO_UINT (job_data), ==, stream->next_frame);
+  stream->next_frame++;
+  return GST_VAAPI_DECODER_STATUS_SUCCESS;
+}
+
+static gpointer
+synthetic_stream_thread (gpointer data)
+{
+  SyntheticStream *const stream = data;
+  guint i;
+
+  for (i = 0; i < NUM_FRAMES; i++)
+    g_assert_cmpint (gst_vaapi_decode_scheduler_run (stream->stream,
+            GUINT_TO_POINTER (i), GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE),
+        ==, GST_VAAPI_DECODER_STATUS_SUCCESS);
+  return NULL;
+}
+
+static void
+test_many_streams (void)
+{
+  GstVaapiDecodeScheduler *scheduler;
+  GstVaapiDecodeSchedulerStats stats;
+  SyntheticStream streams[NUM_STREAMS];
+  StubDisplay display = { {0,}, };
+  gint64 start_time, elapsed;
+  guint i;
+
+  g_mutex_init (&display.mutex);
+  scheduler = gst_vaapi_decode_scheduler_new (4, 8, stub_display_lock,
+      stub_display_unlock, &display);
+  g_assert (scheduler != NULL);
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < NUM_STREAMS; i++) {
+    streams[i].display = &display;
+    streams[i].next_frame = 0;
+    streams[i].stream = gst_vaapi_decode_scheduler_add_stream (scheduler,
+        synthetic_stream_decode, &streams[i]);
+    g_assert (streams[i].stream != NULL);
+  }
+  for (i = 0; i < NUM_STREAMS; i++)
+    streams[i].thread = g_thread_new ("stream", synthetic_stream_thread,
+        &streams[i]);
+  for (i = 0; i < NUM_STREAMS; i++)
+    g_thread_join (streams[i].thread);
+  elapsed = g_get_monotonic_time () - start_time;
+
+  gst_vaapi_decode_scheduler_get_stats (scheduler, &stats);
+  g_print ("%u streams x %u frames in %" G_GINT64_FORMAT " us, %"
+      G_GUINT64_FORMAT " batches, max queue depth %u\n", NUM_STREAMS,
+      NUM_FRAMES, elapsed, stats.num_batches, stats.max_queue_depth);
+
+  /* Every frame got decoded once, in order, with fewer lock rounds */
+  for (i = 0; i < NUM_STREAMS; i++) {
+    g_assert_cmpuint (streams[i].next_frame, ==, NUM_FRAMES);
+    gst_vaapi_decode_scheduler_remove_stream (streams[i].stream);
+  }
+  g_assert_cmpuint (stats.num_streams, ==, NUM_STREAMS);
+  g_assert_cmpuint (stats.queue_depth, ==, 0);
+  g_assert_cmpuint (stats.max_queue_depth, <=, NUM_STREAMS);
+  g_assert_cmpuint (stats.num_jobs, ==, NUM_STREAMS * NUM_FRAMES);
+  g_assert_cmpuint (stats.num_batches, <=, stats.num_jobs);
+  g_assert_cmpuint (display.num_locks, ==, stats.num_batches);
+  g_assert_cmpuint (stats.num_deadline_misses, ==, 0);
+
+  gst_vaapi_decode_scheduler_free (scheduler);
+  g_mutex_clear (&display.mutex);
+}
+
+/* Streams of the deadline test, whose first jobs block the workers */
+typedef struct
+{
+  GMutex mutex;
+  GCond cond;
+  gboolean is_blocking;
+  guint num_blocking;
+  GArray *decoded;
+} DeadlineTest;
+
+typedef struct
+{
+  DeadlineTest *test;
+  GstVaapiDecodeSchedulerStream *stream;
+  gint64 deadline;
+  guint id;
+} DeadlineStream;
+
+static GstVaapiDecoderStatus
+deadline_stream_decode (gpointer stream_data, gpointer job_data)
+{
+  DeadlineStream *const stream = stream_data;
+  DeadlineTest *const test = stream->test;
+
+  g_mutex_lock (&test->mutex);
+  while (test->is_blocking && stream->id < test->num_blocking)
+    g_cond_wait (&test->cond, &test->mutex);
+  g_array_append_val (test->decoded, stream->id);
+  g_mutex_unlock (&test->mutex);
+  return GST_VAAPI_DECODER_STATUS_SUCCESS;
+}
+
+static gpointer
+deadline_stream_thread (gpointer data)
+{
+  DeadlineStream *const stream = data;
+
+  gst_vaapi_decode_scheduler_run (stream->stream, NULL, stream->deadline);
+  return NULL;
+}
+
+static void
+test_deadlines (void)
+{
+  /* Deadlines in the past, so that the order is easily checked */
+  static const gint64 deadlines[] = { 0, 300, 100, 200, 100 };
+  static const guint expected_order[] = { 0, 2, 4, 3, 1 };
+  GstVaapiDecodeScheduler *scheduler;
+  GstVaapiDecodeSchedulerStats stats;
+  DeadlineStream streams[G_N_ELEMENTS (deadlines)];
+  GThread *threads[G_N_ELEMENTS (deadlines)];
+  DeadlineTest test;
+  guint i;
+
+  g_mutex_init (&test.mutex);
+  g_cond_init (&test.cond);
+  test.is_blocking = TRUE;
+  test.num_blocking = 1;
+  test.decoded = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  scheduler = gst_vaapi_decode_scheduler_new (1, 1, NULL, NULL, NULL);
+  for (i = 0; i < G_N_ELEMENTS (streams); i++) {
+    streams[i].test = &test;
+    streams[i].deadline = deadlines[i];
+    streams[i].id = i;
+    streams[i].stream = gst_vaapi_decode_scheduler_add_stream (scheduler,
+        deadline_stream_decode, &streams[i]);
+  }
+
+  /* Queue all jobs while the single worker is busy with the first one */
+  threads[0] = g_thread_new ("stream", deadline_stream_thread, &streams[0]);
+  do {
+    g_usleep (1000);
+    gst_vaapi_decode_scheduler_get_stats (scheduler, &stats);
+  } while (stats.num_jobs < 1);
+  for (i = 1; i < G_N_ELEMENTS (streams); i++) {
+    threads[i] = g_thread_new ("stream", deadline_stream_thread,
+        &streams[i]);
+    do {
+      g_usleep (1000);
+      gst_vaapi_decode_scheduler_get_stats (scheduler, &stats);
+    } while (stats.queue_depth < i);
+  }
+  g_assert_cmpuint (stats.max_queue_depth, ==, G_N_ELEMENTS (streams) - 1);
+
+  g_mutex_lock (&test.mutex);
+  test.is_blocking = FALSE;
+  g_cond_signal (&test.cond);
+  g_mutex_unlock (&test.mutex);
+  for (i = 0; i < G_N_ELEMENTS (streams); i++)
+    g_thread_join (threads[i]);
+
+  /* Earliest deadline first, then submission order */
+  g_assert_cmpuint (test.decoded->len, ==, G_N_ELEMENTS (expected_order));
+  for (i = 0; i < G_N_ELEMENTS (expected_order); i++)
+    g_assert_cmpuint (g_array_index (test.decoded, guint, i), ==,
+        expected_order[i]);
+
+  gst_vaapi_decode_scheduler_get_stats (scheduler, &stats);
+  g_assert_cmpuint (stats.num_deadline_misses, ==, G_N_ELEMENTS (streams));
+
+  for (i = 0; i < G_N_ELEMENTS (streams); i++)
+    gst_vaapi_decode_scheduler_remove_stream (streams[i].stream);
+  gst_vaapi_decode_scheduler_free (scheduler);
+  g_array_unref (test.decoded);
+  g_cond_clear (&test.cond);
+  g_mutex_clear (&test.mutex);
+}
+
+/* Without a lock, the jobs of distinct streams run concurrently, and
+   are only batched when no worker is left idle */
+static void
+test_lockless_batches (void)
+{
+  GstVaapiDecodeScheduler *scheduler;
+  GstVaapiDecodeSchedulerStats stats;
+  DeadlineStream streams[2 + 8];
+  GThread *threads[G_N_ELEMENTS (streams)];
+  DeadlineTest test;
+  guint i;
+
+  g_mutex_init (&test.mutex);
+  g_cond_init (&test.cond);
+  test.is_blocking = TRUE;
+  test.num_blocking = 2;
+  test.decoded = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  scheduler = gst_vaapi_decode_scheduler_new (2, 8, NULL, NULL, NULL);
+  for (i = 0; i < G_N_ELEMENTS (streams); i++) {
+    streams[i].test = &test;
+    streams[i].deadline = GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE;
+    streams[i].id = i;
+    streams[i].stream = gst_vaapi_decode_scheduler_add_stream (scheduler,
+        deadline_stream_decode, &streams[i]);
+  }
+
+  /* Both workers get busy with a blocking job of their own */
+  for (i = 0; i < 2; i++)
+    threads[i] = g_thread_new ("stream", deadline_stream_thread,
+        &streams[i]);
+  do {
+    g_usleep (1000);
+    gst_vaapi_decode_scheduler_get_stats (scheduler, &stats);
+  } while (stats.num_jobs < 2);
+  g_assert_cmpuint (stats.num_batches, ==, 2);
+
+  for (i = 2; i < G_N_ELEMENTS (streams); i++)
+    threads[i] = g_thread_new ("stream", deadline_stream_thread,
+        &streams[i]);
+  do {
+    g_usleep (1000);
+    gst_vaapi_decode_scheduler_get_stats (scheduler, &stats);
+  } while (stats.queue_depth < G_N_ELEMENTS (streams) - 2);
+
+  g_mutex_lock (&test.mutex);
+  test.is_blocking = FALSE;
+  g_cond_broadcast (&test.cond);
+  g_mutex_unlock (&test.mutex);
+  for (i = 0; i < G_N_ELEMENTS (streams); i++)
+    g_thread_join (threads[i]);
+
+  /* The queued jobs outnumbered the idle workers, so they got batched */
+  gst_vaapi_decode_scheduler_get_stats (scheduler, &stats);
+  g_assert_cmpuint (test.decoded->len, ==, G_N_ELEMENTS (streams));
+  g_assert_cmpuint (stats.num_jobs, ==, G_N_ELEMENTS (streams));
+  g_assert_cmpuint (stats.num_batches, <, stats.num_jobs);
+
+  for (i = 0; i < G_N_ELEMENTS (streams); i++)
+    gst_vaapi_decode_scheduler_remove_stream (streams[i].stream);
+  gst_vaapi_decode_scheduler_free (scheduler);
+  g_array_unref (test.decoded);
+  g_cond_clear (&test.cond);
+  g_mutex_clear (&test.mutex);
+}
+
+static GstVaapiDecoderStatus
+echo_stream_decode (gpointer stream_data, gpointer job_data)
+{
+  guint *const num_decoded = stream_data;
+
+  (*num_decoded)++;
+  return GPOINTER_TO_UINT (job_data) == 0 ?
+      GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE :
+      GST_VAAPI_DECODER_STATUS_SUCCESS;
+}
+
+/* Jobs submitted without waiting are waited for in submission order */
+static void
+test_submit_wait (void)
+{
+  GstVaapiDecodeScheduler *scheduler;
+  GstVaapiDecodeSchedulerStream *stream;
+  guint num_decoded = 0;
+  gpointer job_data;
+  guint i;
+
+  scheduler = gst_vaapi_decode_scheduler_new (2, 1, NULL, NULL, NULL);
+  stream = gst_vaapi_decode_scheduler_add_stream (scheduler,
+      echo_stream_decode, &num_decoded);
+
+  for (i = 0; i < 3; i++)
+    gst_vaapi_decode_scheduler_submit (stream, GUINT_TO_POINTER (i),
+        GST_VAAPI_DECODE_SCHEDULER_NO_DEADLINE);
+
+  g_assert_cmpint (gst_vaapi_decode_scheduler_wait (stream, &job_data), ==,
+      GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE);
+  g_assert_cmpuint (GPOINTER_TO_UINT (job_data), ==, 0);
+  for (i = 1; i < 3; i++) {
+    g_assert_cmpint (gst_vaapi_decode_scheduler_wait (stream, &job_data), ==,
+        GST_VAAPI_DECODER_STATUS_SUCCESS);
+    g_assert_cmpuint (GPOINTER_TO_UINT (job_data), ==, i);
+  }
+  g_assert_cmpuint (num_decoded, ==, 3);
+
+  /* Nothing left to wait for */
+  g_assert_cmpint (gst_vaapi_decode_scheduler_wait (stream, NULL), ==,
+      GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
+
+  gst_vaapi_decode_scheduler_remove_stream (stream);
+  gst_vaapi_decode_scheduler_free (scheduler);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_many_streams ();
+  test_deadlines ();
+  test_lockless_batches ();
+  test_submit_wait ();
+
+  g_print ("all decode scheduler tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ *  test-deinterlace-history.c - Test deinterlacing references
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/vaapi/gstvaapideinterlacehistory.h>
+
+#define FRAME_DURATION  (GST_SECOND / 25)
+#define NUM_FRAMES      100
+
+/* The history never dereferences the surfaces */
+#define FAKE_SURFACE(i) ((GstVaapiSurface *) GSIZE_TO_POINTER ((i) + 1))
+
+static GstBuffer *
+new_frame (guint64 index, gboolean tff)
+{
+  GstBuffer *const buf = gst_buffer_new ();
+
+  GST_BUFFER_PTS (buf) = index * FRAME_DURATION;
+  GST_BUFFER_DURATION (buf) = FRAME_DURATION;
+  if (tff)
+    GST_BUFFER_FLAG_SET (buf, GST_VIDEO_BUFFER_FLAG_TFF);
+  return buf;
+}
+
+/* Checks and pushes a frame, as vaapipostproc does */
+static gboolean
+process_frame (GstVaapiDeinterlaceHistory * history, GstBuffer * buf,
+    guint64 index)
+{
+  gboolean kept;
+
+  kept = gst_vaapi_deinterlace_history_check (history, buf);
+  gst_vaapi_deinterlace_history_push (history, buf, FAKE_SURFACE (index));
+  gst_buffer_unref (buf);
+  return kept;
+}
+
+static void
+test_order (void)
+{
+  GstVaapiDeinterlaceHistory history;
+  GstVaapiSurface *surfaces[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
+  GstBuffer *bufs[GST_VAAPI_DEINTERLACE_MAX_REFERENCES + 1];
+  guint i, num_surfaces;
+
+  gst_vaapi_deinterlace_history_init (&history);
+  g_assert_cmpuint (gst_vaapi_deinterlace_history_get_surfaces (&history,
+          surfaces), ==, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (bufs); i++) {
+    bufs[i] = new_frame (i, TRUE);
+    gst_vaapi_deinterlace_history_push (&history, bufs[i], FAKE_SURFACE (i));
+  }
+
+  /* The newest references come first, the oldest one was released */
+  num_surfaces = gst_vaapi_deinterlace_history_get_surfaces (&history,
+      surfaces);
+  g_assert_cmpuint (num_surfaces, ==, GST_VAAPI_DEINTERLACE_MAX_REFERENCES);
+  for (i = 0; i < num_surfaces; i++)
+    g_assert (surfaces[i] == FAKE_SURFACE (G_N_ELEMENTS (bufs) - 1 - i));
+  g_assert_cmpint (GST_MINI_OBJECT_REFCOUNT_VALUE (bufs[0]), ==, 1);
+  g_assert_cmpint (GST_MINI_OBJECT_REFCOUNT_VALUE (bufs[1]), ==, 2);
+
+  gst_vaapi_deinterlace_history_clear (&history);
+  for (i = 0; i < G_N_ELEMENTS (bufs); i++) {
+    g_assert_cmpint (GST_MINI_OBJECT_REFCOUNT_VALUE (bufs[i]), ==, 1);
+    gst_buffer_unref (bufs[i]);
+  }
+  g_assert_cmpuint (history.num_invalidations, ==, 0);
+}
+
+static void
+test_continuity (void)
+{
+  GstVaapiDeinterlaceHistory history;
+  GstBuffer *buf;
+  guint64 i;
+
+  gst_vaapi_deinterlace_history_init (&history);
+  gst_vaapi_deinterlace_history_set_frame_duration (&history,
+      FRAME_DURATION);
+
+  /* A broadcast feed flipping its field order keeps its references */
+  for (i = 0; i < NUM_FRAMES; i++)
+    g_assert (process_frame (&history, new_frame (i, (i / 10) % 2), i));
+  g_assert_cmpuint (history.num_invalidations, ==, 0);
+
+  /* A single missing frame is tolerated */
+  i = NUM_FRAMES + 1;
+  g_assert (process_frame (&history, new_frame (i, TRUE), i));
+  g_assert_cmpuint (history.num_invalidations, ==, 0);
+
+  /* Two missing frames are not */
+  i += 3;
+  g_assert (!process_frame (&history, new_frame (i, TRUE), i));
+  g_assert_cmpuint (history.num_invalidations, ==, 1);
+  g_assert_cmpuint (history.num_buffers, ==, 1);
+
+  /* Neither are timestamps going backwards */
+  i += 1;
+  g_assert (process_frame (&history, new_frame (i, TRUE), i));
+  i -= 10;
+  g_assert (!process_frame (&history, new_frame (i, TRUE), i));
+  g_assert_cmpuint (history.num_invalidations, ==, 2);
+
+  /* Nor discontinuities */
+  i += 1;
+  g_assert (process_frame (&history, new_frame (i, TRUE), i));
+  i += 1;
+  buf = new_frame (i, TRUE);
+  GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+  g_assert (!process_frame (&history, buf, i));
+  g_assert_cmpuint (history.num_invalidations, ==, 3);
+
+  /* Invalidation keeps the frame duration, clearing does not */
+  gst_vaapi_deinterlace_history_invalidate (&history);
+  g_assert_cmpuint (history.num_buffers, ==, 0);
+  g_assert_cmpuint (history.num_invalidations, ==, 4);
+  g_assert_cmpuint (history.frame_duration, ==, FRAME_DURATION);
+  gst_vaapi_deinterlace_history_clear (&history);
+  g_assert_cmpuint (history.frame_duration, ==, 0);
+  g_assert_cmpuint (history.num_invalidations, ==, 0);
+}
+
+static void
+test_unknown_frame_rate (void)
+{
+  GstVaapiDeinterlaceHistory history;
+  GstBuffer *buf;
+
+  gst_vaapi_deinterlace_history_init (&history);
+
+  /* Gaps can't be detected without a frame duration */
+  g_assert (process_frame (&history, new_frame (0, TRUE), 0));
+  g_assert (process_frame (&history, new_frame (10, TRUE), 1));
+
+  /* Frames without timestamps don't break the continuity */
+  buf = new_frame (11, TRUE);
+  GST_BUFFER_PTS (buf) = GST_CLOCK_TIME_NONE;
+  g_assert (process_frame (&history, buf, 2));
+  g_assert (process_frame (&history, new_frame (11, TRUE), 3));
+  g_assert_cmpuint (history.num_invalidations, ==, 0);
+
+  gst_vaapi_deinterlace_history_clear (&history);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_order ();
+  test_continuity ();
+  test_unknown_frame_rate ();
+
+  g_print ("all deinterlace history tests passed\n");
+  gst_deinit ();
+  return 0;
+}
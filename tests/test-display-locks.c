@@ -0,0 +1,179 @@
+/*
+ *  test-display-locks.c - Check concurrent VA display accesses
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapiimage.h>
+#include "output.h"
+
+#define MAX_THREADS     8
+#define NUM_ITERATIONS  200
+#define IMAGE_WIDTH     320
+#define IMAGE_HEIGHT    240
+
+static GstVaapiDisplay *g_display;
+static gboolean g_has_decoder;
+static gboolean g_has_video_processing;
+static const gchar *g_vendor_string;
+
+/* Fills the luma plane of @image with a pattern unique to @seed */
+static void
+fill_pattern (GstVaapiImage * image, guint seed)
+{
+  guint8 *pixels;
+  guint pitch, x, y;
+
+  if (!gst_vaapi_image_map (image))
+    g_error ("could not map Gst/VA image");
+
+  pixels = gst_vaapi_image_get_plane (image, 0);
+  pitch = gst_vaapi_image_get_pitch (image, 0);
+  for (y = 0; y < IMAGE_HEIGHT; y++) {
+    for (x = 0; x < IMAGE_WIDTH; x++)
+      pixels[y * pitch + x] = (guint8) (seed * 31 + x + y);
+  }
+  gst_vaapi_image_unmap (image);
+}
+
+static void
+check_pattern (GstVaapiImage * image, guint seed)
+{
+  const guint8 *pixels;
+  guint pitch, x, y;
+
+  if (!gst_vaapi_image_map (image))
+    g_error ("could not map Gst/VA image");
+
+  pixels = gst_vaapi_image_get_plane (image, 0);
+  pitch = gst_vaapi_image_get_pitch (image, 0);
+  for (y = 0; y < IMAGE_HEIGHT; y++) {
+    for (x = 0; x < IMAGE_WIDTH; x++) {
+      if (pixels[y * pitch + x] != (guint8) (seed * 31 + x + y))
+        g_error ("corrupted pixel at (%u,%u) for seed %u", x, y, seed);
+    }
+  }
+  gst_vaapi_image_unmap (image);
+}
+
+/* Mixes capability queries with surface uploads, syncs and downloads,
+   as concurrent pipelines sharing a display would do. Each iteration
+   round-trips a pattern unique to the thread and iteration, so that
+   any call interleaving the driver cannot cope with shows up as a
+   corrupted readback */
+static gpointer
+worker_thread (gpointer data)
+{
+  const guint thread_id = GPOINTER_TO_UINT (data);
+  GstVaapiSurface *surface;
+  GstVaapiImage *src_image, *dst_image;
+  GstVaapiSurfaceStatus status;
+  guint i, seed;
+
+  src_image = gst_vaapi_image_new (g_display, GST_VIDEO_FORMAT_NV12,
+      IMAGE_WIDTH, IMAGE_HEIGHT);
+  dst_image = gst_vaapi_image_new (g_display, GST_VIDEO_FORMAT_NV12,
+      IMAGE_WIDTH, IMAGE_HEIGHT);
+  if (!src_image || !dst_image)
+    g_error ("could not create Gst/VA images");
+
+  for (i = 0; i < NUM_ITERATIONS; i++) {
+    g_assert (gst_vaapi_display_has_decoder (g_display,
+            GST_VAAPI_PROFILE_H264_MAIN, GST_VAAPI_ENTRYPOINT_VLD) ==
+        g_has_decoder);
+    g_assert (gst_vaapi_display_has_video_processing (g_display) ==
+        g_has_video_processing);
+    g_assert (g_strcmp0 (gst_vaapi_display_get_vendor_string (g_display),
+            g_vendor_string) == 0);
+
+    surface = gst_vaapi_surface_new (g_display, GST_VAAPI_CHROMA_TYPE_YUV420,
+        IMAGE_WIDTH, IMAGE_HEIGHT);
+    if (!surface)
+      g_error ("could not create Gst/VA surface");
+
+    seed = thread_id * NUM_ITERATIONS + i;
+    fill_pattern (src_image, seed);
+    if (!gst_vaapi_surface_put_image (surface, src_image))
+      g_error ("could not upload image to Gst/VA surface");
+    if (!gst_vaapi_surface_sync (surface))
+      g_error ("could not sync Gst/VA surface");
+    if (!gst_vaapi_surface_query_status (surface, &status))
+      g_error ("could not query Gst/VA surface status");
+    g_assert (!(status & GST_VAAPI_SURFACE_STATUS_RENDERING));
+    if (!gst_vaapi_surface_get_image (surface, dst_image))
+      g_error ("could not download image from Gst/VA surface");
+    check_pattern (dst_image, seed);
+
+    gst_vaapi_object_unref (surface);
+  }
+
+  gst_vaapi_object_unref (src_image);
+  gst_vaapi_object_unref (dst_image);
+  return NULL;
+}
+
+static gint64
+run_threads (guint num_threads)
+{
+  GThread *threads[MAX_THREADS];
+  gint64 start_time;
+  guint i;
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < num_threads; i++)
+    threads[i] = g_thread_new ("worker", worker_thread, GUINT_TO_POINTER (i));
+  for (i = 0; i < num_threads; i++)
+    g_thread_join (threads[i]);
+  return g_get_monotonic_time () - start_time;
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint64 elapsed;
+  guint num_threads;
+
+  if (!video_output_init (&argc, argv, NULL))
+    g_error ("failed to initialize video output subsystem");
+
+  g_display = video_output_create_display (NULL);
+  if (!g_display)
+    g_error ("could not create Gst/VA display");
+
+  /* Reference results, queried before any concurrent access */
+  g_has_decoder = gst_vaapi_display_has_decoder (g_display,
+      GST_VAAPI_PROFILE_H264_MAIN, GST_VAAPI_ENTRYPOINT_VLD);
+  g_has_video_processing = gst_vaapi_display_has_video_processing (g_display);
+  g_vendor_string = gst_vaapi_display_get_vendor_string (g_display);
+
+  /* Warm up the capabilities caches */
+  run_threads (1);
+
+  for (num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+    elapsed = run_threads (num_threads);
+    g_print ("%u threads: %.0f iterations/s\n", num_threads,
+        (gdouble) num_threads * NUM_ITERATIONS * G_USEC_PER_SEC /
+        MAX (elapsed, 1));
+  }
+  g_print ("all display locks tests passed\n");
+
+  gst_vaapi_display_unref (g_display);
+  video_output_exit ();
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ *  test-driver-cache.c - Test the on-disk cache of VA driver capabilities
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <gst/vaapi/gstvaapidrivercache.h>
+
+#define DEVICE          "/dev/dri/renderD128"
+#define OTHER_DEVICE    "/dev/dri/renderD129"
+#define DRIVER          "Stub driver 1.0;libva 0.40"
+#define NEW_DRIVER      "Stub driver 1.1;libva 0.40"
+#define NUM_LOADS       100
+
+static const guint g_decoders[] = { 0x01343632, 1, 0x02343632, 1 };
+
+static void
+assert_values (GstVaapiDriverCache * cache, const gchar * device,
+    const gchar * driver, const gchar * name, const guint * values,
+    guint num_values)
+{
+  GArray *cached_values;
+  guint i;
+
+  g_assert (gst_vaapi_driver_cache_lookup (cache, device, driver, name,
+          &cached_values));
+  g_assert_cmpuint (cached_values->len, ==, num_values);
+  for (i = 0; i < num_values; i++)
+    g_assert_cmpuint (g_array_index (cached_values, guint, i), ==, values[i]);
+  g_array_free (cached_values, TRUE);
+}
+
+static void
+test_round_trip (const gchar * filename)
+{
+  GstVaapiDriverCache *cache;
+  GArray *values;
+  const guint has_vpp = G_MAXUINT;
+
+  /* Nothing is found before the first save */
+  cache = gst_vaapi_driver_cache_new (filename);
+  g_assert (cache != NULL);
+  g_assert (!gst_vaapi_driver_cache_lookup (cache, DEVICE, DRIVER,
+          "decoders", &values));
+  gst_vaapi_driver_cache_store (cache, DEVICE, DRIVER, "decoders",
+      g_decoders, G_N_ELEMENTS (g_decoders));
+  gst_vaapi_driver_cache_store (cache, DEVICE, DRIVER, "encoders", NULL, 0);
+  gst_vaapi_driver_cache_store (cache, DEVICE, DRIVER, "vpp", &has_vpp, 1);
+  g_assert (gst_vaapi_driver_cache_save (cache));
+  gst_vaapi_driver_cache_free (cache);
+
+  cache = gst_vaapi_driver_cache_new (filename);
+  assert_values (cache, DEVICE, DRIVER, "decoders", g_decoders,
+      G_N_ELEMENTS (g_decoders));
+  assert_values (cache, DEVICE, DRIVER, "encoders", NULL, 0);
+  assert_values (cache, DEVICE, DRIVER, "vpp", &has_vpp, 1);
+  g_assert (!gst_vaapi_driver_cache_lookup (cache, DEVICE, DRIVER,
+          "image-formats", &values));
+  g_assert (!gst_vaapi_driver_cache_lookup (cache, OTHER_DEVICE, DRIVER,
+          "decoders", &values));
+  gst_vaapi_driver_cache_free (cache);
+}
+
+static void
+test_invalidation (const gchar * filename)
+{
+  GstVaapiDriverCache *cache;
+  GArray *values;
+
+  /* Capabilities of another driver are not valid for this one */
+  cache = gst_vaapi_driver_cache_new (filename);
+  g_assert (!gst_vaapi_driver_cache_lookup (cache, DEVICE, NEW_DRIVER,
+          "decoders", &values));
+
+  /* Storing capabilities for a new driver discards the old ones */
+  gst_vaapi_driver_cache_store (cache, DEVICE, NEW_DRIVER, "decoders",
+      g_decoders, 2);
+  g_assert (gst_vaapi_driver_cache_save (cache));
+  gst_vaapi_driver_cache_free (cache);
+
+  cache = gst_vaapi_driver_cache_new (filename);
+  g_assert (!gst_vaapi_driver_cache_lookup (cache, DEVICE, DRIVER,
+          "decoders", &values));
+  g_assert (!gst_vaapi_driver_cache_lookup (cache, DEVICE, NEW_DRIVER,
+          "encoders", &values));
+  assert_values (cache, DEVICE, NEW_DRIVER, "decoders", g_decoders, 2);
+  gst_vaapi_driver_cache_free (cache);
+}
+
+static void
+test_concurrent_saves (const gchar * filename)
+{
+  GstVaapiDriverCache *cache1, *cache2;
+
+  /* Devices saved by another process in the meantime are preserved */
+  cache1 = gst_vaapi_driver_cache_new (filename);
+  cache2 = gst_vaapi_driver_cache_new (filename);
+  gst_vaapi_driver_cache_store (cache1, DEVICE, DRIVER, "decoders",
+      g_decoders, G_N_ELEMENTS (g_decoders));
+  gst_vaapi_driver_cache_store (cache2, OTHER_DEVICE, DRIVER, "decoders",
+      g_decoders, 2);
+  g_assert (gst_vaapi_driver_cache_save (cache1));
+  g_assert (gst_vaapi_driver_cache_save (cache2));
+  gst_vaapi_driver_cache_free (cache1);
+  gst_vaapi_driver_cache_free (cache2);
+
+  cache1 = gst_vaapi_driver_cache_new (filename);
+  assert_values (cache1, DEVICE, DRIVER, "decoders", g_decoders,
+      G_N_ELEMENTS (g_decoders));
+  assert_values (cache1, OTHER_DEVICE, DRIVER, "decoders", g_decoders, 2);
+  gst_vaapi_driver_cache_free (cache1);
+}
+
+static void
+test_load_time (const gchar * filename)
+{
+  GstVaapiDriverCache *cache;
+  gint64 start_time, elapsed;
+  guint i;
+
+  /* What a display pays instead of querying the driver */
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < NUM_LOADS; i++) {
+    cache = gst_vaapi_driver_cache_new (filename);
+    assert_values (cache, DEVICE, DRIVER, "decoders", g_decoders,
+        G_N_ELEMENTS (g_decoders));
+    gst_vaapi_driver_cache_free (cache);
+  }
+  elapsed = g_get_monotonic_time () - start_time;
+  g_print ("driver cache load and lookup in %.1f us\n",
+      (gdouble) elapsed / NUM_LOADS);
+}
+
+static void
+test_disabled (void)
+{
+  g_setenv (GST_VAAPI_DRIVER_CACHE_ENV, "", TRUE);
+  g_assert (gst_vaapi_driver_cache_new (NULL) == NULL);
+  g_unsetenv (GST_VAAPI_DRIVER_CACHE_ENV);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar *dirname, *filename;
+
+  gst_init (&argc, &argv);
+
+  dirname = g_dir_make_tmp ("test-driver-cache-XXXXXX", NULL);
+  g_assert (dirname != NULL);
+  filename = g_build_filename (dirname, "cache", "driver-cache.ini", NULL);
+
+  test_round_trip (filename);
+  test_invalidation (filename);
+  test_concurrent_saves (filename);
+  test_load_time (filename);
+  test_disabled ();
+
+  g_unlink (filename);
+  g_free (filename);
+  filename = g_build_filename (dirname, "cache", NULL);
+  g_rmdir (filename);
+  g_free (filename);
+  g_rmdir (dirname);
+  g_free (dirname);
+
+  g_print ("all driver cache tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ *  test-filter-sw.c - Test software scaling and color conversion
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapifilter_sw.h>
+
+/* Extra bytes at the end of each row, so that strides differ from
+   the widths */
+#define ROW_PADDING     24
+
+static const GstVaapiScaleMethod g_scale_methods[] = {
+  GST_VAAPI_SCALE_METHOD_FAST,
+  GST_VAAPI_SCALE_METHOD_DEFAULT,
+  GST_VAAPI_SCALE_METHOD_HQ,
+};
+
+static void
+frame_alloc (GstVaapiFilterSwFrame * frame, GstVideoFormat format,
+    guint width, guint height)
+{
+  const guint chroma_width = (width + 1) / 2;
+  const guint chroma_height = (height + 1) / 2;
+
+  memset (frame, 0, sizeof (*frame));
+  frame->format = format;
+  frame->width = width;
+  frame->height = height;
+
+  switch (format) {
+    case GST_VIDEO_FORMAT_NV12:
+      frame->stride[0] = width + ROW_PADDING;
+      frame->stride[1] = 2 * chroma_width + ROW_PADDING;
+      frame->data[0] = g_malloc (frame->stride[0] * height);
+      frame->data[1] = g_malloc (frame->stride[1] * chroma_height);
+      break;
+    case GST_VIDEO_FORMAT_I420:
+      frame->stride[0] = width + ROW_PADDING;
+      frame->stride[1] = chroma_width + ROW_PADDING;
+      frame->stride[2] = chroma_width + ROW_PADDING;
+      frame->data[0] = g_malloc (frame->stride[0] * height);
+      frame->data[1] = g_malloc (frame->stride[1] * chroma_height);
+      frame->data[2] = g_malloc (frame->stride[2] * chroma_height);
+      break;
+    default:
+      frame->stride[0] = 4 * width + ROW_PADDING;
+      frame->data[0] = g_malloc (frame->stride[0] * height);
+      break;
+  }
+}
+
+static void
+frame_free (GstVaapiFilterSwFrame * frame)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (frame->data); i++)
+    g_free (frame->data[i]);
+}
+
+static guint8 *
+get_sample (const GstVaapiFilterSwFrame * frame, guint plane, guint x,
+    guint y, guint pixel_stride)
+{
+  return frame->data[plane] + y * frame->stride[plane] + x * pixel_stride;
+}
+
+/* Fills a frame with a horizontal ramp of luma, or of red, and with
+   constant chroma */
+static void
+fill_ramp (GstVaapiFilterSwFrame * frame)
+{
+  guint x, y;
+
+  for (y = 0; y < frame->height; y++) {
+    for (x = 0; x < frame->width; x++) {
+      const guint8 value = (x * 255) / (frame->width - 1);
+
+      if (frame->format == GST_VIDEO_FORMAT_RGBA) {
+        guint8 *const p = get_sample (frame, 0, x, y, 4);
+        p[0] = value;
+        p[1] = 64;
+        p[2] = 192;
+        p[3] = 255;
+      } else
+        *get_sample (frame, 0, x, y, 1) = value;
+    }
+  }
+
+  if (frame->format == GST_VIDEO_FORMAT_NV12) {
+    for (y = 0; y < (frame->height + 1) / 2; y++)
+      for (x = 0; x < (frame->width + 1) / 2; x++) {
+        get_sample (frame, 1, x, y, 2)[0] = 90;
+        get_sample (frame, 1, x, y, 2)[1] = 200;
+      }
+  } else if (frame->format == GST_VIDEO_FORMAT_I420) {
+    for (y = 0; y < (frame->height + 1) / 2; y++)
+      for (x = 0; x < (frame->width + 1) / 2; x++) {
+        *get_sample (frame, 1, x, y, 1) = 90;
+        *get_sample (frame, 2, x, y, 1) = 200;
+      }
+  }
+}
+
+/* Same size: NV12 -> I420 -> NV12 is lossless */
+static void
+test_nv12_i420 (void)
+{
+  GstVaapiFilterSwFrame nv12, i420, out;
+  guint x, y;
+
+  frame_alloc (&nv12, GST_VIDEO_FORMAT_NV12, 64, 36);
+  frame_alloc (&i420, GST_VIDEO_FORMAT_I420, 64, 36);
+  frame_alloc (&out, GST_VIDEO_FORMAT_NV12, 64, 36);
+  fill_ramp (&nv12);
+
+  g_assert (gst_vaapi_filter_sw_process (&nv12, NULL, &i420, NULL,
+          GST_VAAPI_SCALE_METHOD_DEFAULT));
+  for (y = 0; y < 18; y++) {
+    for (x = 0; x < 32; x++) {
+      g_assert_cmpuint (*get_sample (&i420, 1, x, y, 1), ==, 90);
+      g_assert_cmpuint (*get_sample (&i420, 2, x, y, 1), ==, 200);
+    }
+  }
+
+  g_assert (gst_vaapi_filter_sw_process (&i420, NULL, &out, NULL,
+          GST_VAAPI_SCALE_METHOD_DEFAULT));
+  for (y = 0; y < 36; y++)
+    g_assert (memcmp (get_sample (&nv12, 0, 0, y, 1),
+            get_sample (&out, 0, 0, y, 1), 64) == 0);
+  for (y = 0; y < 18; y++)
+    g_assert (memcmp (get_sample (&nv12, 1, 0, y, 1),
+            get_sample (&out, 1, 0, y, 1), 64) == 0);
+
+  frame_free (&out);
+  frame_free (&i420);
+  frame_free (&nv12);
+}
+
+/* Scaling a ramp keeps it a ramp, with all the rows identical across
+   the bands processed by different threads */
+static void
+check_scaled_ramp (guint src_width, guint dst_width, guint dst_height,
+    GstVaapiScaleMethod method)
+{
+  GstVaapiFilterSwFrame src, dst;
+  guint x, y;
+
+  frame_alloc (&src, GST_VIDEO_FORMAT_I420, src_width, 240);
+  frame_alloc (&dst, GST_VIDEO_FORMAT_NV12, dst_width, dst_height);
+  fill_ramp (&src);
+
+  g_assert (gst_vaapi_filter_sw_process (&src, NULL, &dst, NULL, method));
+
+  for (x = 0; x < dst_width; x++) {
+    const gdouble center = (x + 0.5) * src_width / dst_width - 0.5;
+    const gint expected = CLAMP (center, 0, src_width - 1) * 255 /
+        (src_width - 1);
+    const gint value = *get_sample (&dst, 0, x, 0, 1);
+
+    /* Lanczos overshoots a little at the edges of the ramp */
+    g_assert_cmpint (ABS (value - expected), <=, 3);
+    if (x > 0)
+      g_assert_cmpint (value, >=, *get_sample (&dst, 0, x - 1, 0, 1));
+  }
+
+  for (y = 1; y < dst_height; y++)
+    g_assert (memcmp (get_sample (&dst, 0, 0, 0, 1),
+            get_sample (&dst, 0, 0, y, 1), dst_width) == 0);
+
+  /* Constant planes stay constant, the weights sum to one */
+  for (y = 0; y < (dst_height + 1) / 2; y++) {
+    for (x = 0; x < (dst_width + 1) / 2; x++) {
+      g_assert_cmpuint (get_sample (&dst, 1, x, y, 2)[0], ==, 90);
+      g_assert_cmpuint (get_sample (&dst, 1, x, y, 2)[1], ==, 200);
+    }
+  }
+
+  frame_free (&dst);
+  frame_free (&src);
+}
+
+static void
+test_scale (void)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (g_scale_methods); i++) {
+    check_scaled_ramp (256, 640, 480, g_scale_methods[i]);
+    check_scaled_ramp (256, 100, 75, g_scale_methods[i]);
+    check_scaled_ramp (1920, 1280, 720, g_scale_methods[i]);
+  }
+}
+
+/* RGBA -> NV12 -> BGRx round trip of the ramp, with BT.601 values */
+static void
+test_rgb_yuv (void)
+{
+  GstVaapiFilterSwFrame rgba, nv12, bgrx;
+  guint x, y;
+
+  frame_alloc (&rgba, GST_VIDEO_FORMAT_RGBA, 128, 64);
+  frame_alloc (&nv12, GST_VIDEO_FORMAT_NV12, 128, 64);
+  frame_alloc (&bgrx, GST_VIDEO_FORMAT_BGRx, 128, 64);
+  fill_ramp (&rgba);
+
+  g_assert (gst_vaapi_filter_sw_process (&rgba, NULL, &nv12, NULL,
+          GST_VAAPI_SCALE_METHOD_DEFAULT));
+
+  /* Luma follows BT.601, with the limited range */
+  for (y = 0; y < 64; y++) {
+    for (x = 0; x < 128; x++) {
+      const guint8 *const p = get_sample (&rgba, 0, x, y, 4);
+      const gint expected =
+          ((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16;
+      g_assert_cmpint (*get_sample (&nv12, 0, x, y, 1), ==, expected);
+    }
+  }
+
+  g_assert (gst_vaapi_filter_sw_process (&nv12, NULL, &bgrx, NULL,
+          GST_VAAPI_SCALE_METHOD_DEFAULT));
+  for (y = 0; y < 64; y++) {
+    for (x = 0; x < 128; x++) {
+      const guint8 *const in = get_sample (&rgba, 0, x, y, 4);
+      const guint8 *const out = get_sample (&bgrx, 0, x, y, 4);
+
+      /* Chroma is shared by pairs of pixels along the ramp */
+      g_assert_cmpint (ABS (out[2] - in[0]), <=, 6);
+      g_assert_cmpint (ABS (out[1] - in[1]), <=, 6);
+      g_assert_cmpint (ABS (out[0] - in[2]), <=, 6);
+      g_assert_cmpuint (out[3], ==, 255);
+    }
+  }
+
+  frame_free (&bgrx);
+  frame_free (&nv12);
+  frame_free (&rgba);
+}
+
+/* Cropping selects the source pixels, the target rectangle the output
+   pixels, and the rest of the output is black */
+static void
+test_crop (void)
+{
+  GstVaapiFilterSwFrame src, dst;
+  const GstVaapiRectangle crop_rect = { 32, 8, 64, 16 };
+  const GstVaapiRectangle target_rect = { 16, 16, 64, 16 };
+  const GstVaapiRectangle invalid_rect = { 100, 8, 64, 16 };
+  guint x, y;
+
+  frame_alloc (&src, GST_VIDEO_FORMAT_I420, 256, 32);
+  frame_alloc (&dst, GST_VIDEO_FORMAT_I420, 128, 64);
+  fill_ramp (&src);
+
+  g_assert (gst_vaapi_filter_sw_process (&src, &crop_rect, &dst,
+          &target_rect, GST_VAAPI_SCALE_METHOD_HQ));
+
+  for (y = 0; y < 64; y++) {
+    for (x = 0; x < 128; x++) {
+      const guint8 value = *get_sample (&dst, 0, x, y, 1);
+
+      if (x >= 16 && x < 80 && y >= 16 && y < 32)
+        g_assert_cmpuint (value, ==, *get_sample (&src, 0, x + 16, 0, 1));
+      else
+        g_assert_cmpuint (value, ==, 16);
+    }
+  }
+  g_assert_cmpuint (*get_sample (&dst, 1, 0, 0, 1), ==, 128);
+  g_assert_cmpuint (*get_sample (&dst, 1, 20, 12, 1), ==, 90);
+
+  /* Rectangles must fit in the frames */
+  g_assert (!gst_vaapi_filter_sw_process (&dst, &invalid_rect, &src, NULL,
+          GST_VAAPI_SCALE_METHOD_DEFAULT));
+
+  frame_free (&dst);
+  frame_free (&src);
+}
+
+static void
+test_formats (void)
+{
+  GArray *formats;
+  guint i;
+
+  formats = gst_vaapi_filter_sw_get_formats ();
+  g_assert_cmpuint (formats->len, >, 0);
+  for (i = 0; i < formats->len; i++)
+    g_assert (gst_vaapi_filter_sw_has_format (g_array_index (formats,
+                GstVideoFormat, i)));
+  g_array_unref (formats);
+
+  g_assert (gst_vaapi_filter_sw_has_format (GST_VIDEO_FORMAT_NV12));
+  g_assert (gst_vaapi_filter_sw_has_format (GST_VIDEO_FORMAT_RGBA));
+  g_assert (!gst_vaapi_filter_sw_has_format (GST_VIDEO_FORMAT_YUY2));
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_formats ();
+  test_nv12_i420 ();
+  test_scale ();
+  test_rgb_yuv ();
+  test_crop ();
+
+  g_print ("all software filter tests passed\n");
+  gst_deinit ();
+  return 0;
+}
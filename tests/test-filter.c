@@ -26,10 +26,13 @@
 #include "gst/vaapi/sysdeps.h"
 #include <errno.h>
 #include <gst/vaapi/gstvaapifilter.h>
+#include <gst/vaapi/gstvaapiprofiler.h>
 #include <gst/vaapi/gstvaapiwindow.h>
 #include "image.h"
 #include "output.h"
 
+#define NUM_FRAMES 100
+
 static gchar *g_src_format_str;
 static gchar *g_crop_rect_str;
 static gchar *g_denoise_str;
@@ -200,6 +203,161 @@ dump_formats (GstVaapiFilter * filter)
   g_array_unref (formats);
 }
 
+/* The VA calls issued by the filter to process frames, as accounted
+   by the profiler */
+static const GstVaapiProfilerEntry g_filter_entries[] = {
+  GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_PIPELINE_CAPS,
+  GST_VAAPI_PROFILER_ENTRY_CREATE_BUFFER,
+  GST_VAAPI_PROFILER_ENTRY_MAP_BUFFER,
+  GST_VAAPI_PROFILER_ENTRY_UNMAP_BUFFER,
+  GST_VAAPI_PROFILER_ENTRY_BEGIN_PICTURE,
+  GST_VAAPI_PROFILER_ENTRY_RENDER_PICTURE,
+  GST_VAAPI_PROFILER_ENTRY_END_PICTURE,
+};
+
+static guint64
+count_va_calls (GstVaapiDisplay * display, guint64 * num_caps_queries_ptr)
+{
+  VADisplay const dpy = GST_VAAPI_DISPLAY_VADISPLAY (display);
+  GstVaapiProfilerStats stats;
+  guint64 num_va_calls = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (g_filter_entries); i++) {
+    gst_vaapi_profiler_get_stats (dpy, VA_INVALID_ID, g_filter_entries[i],
+        &stats);
+    num_va_calls += stats.count;
+  }
+
+  if (num_caps_queries_ptr) {
+    gst_vaapi_profiler_get_stats (dpy, VA_INVALID_ID,
+        GST_VAAPI_PROFILER_ENTRY_QUERY_VIDEO_PROC_PIPELINE_CAPS, &stats);
+    *num_caps_queries_ptr = stats.count;
+  }
+  return num_va_calls;
+}
+
+static void
+process_frames (GstVaapiFilter * filter, GstVaapiSurface * src_surface,
+    GstVaapiSurface * dst_surface, guint flags, guint num_frames)
+{
+  GstVaapiFilterStatus status;
+  guint i;
+
+  for (i = 0; i < num_frames; i++) {
+    status = gst_vaapi_filter_process (filter, src_surface, dst_surface,
+        flags);
+    if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+      g_error ("failed to process video filters");
+  }
+}
+
+/* Steady state processing only maps, fills and submits a recycled
+   pipeline parameter buffer, without querying the pipeline caps */
+static void
+check_process_stats (GstVaapiDisplay * display, GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface,
+    guint flags, GstVaapiDeinterlaceMethod deinterlace_method,
+    guint deinterlace_flags)
+{
+  guint64 num_frames, num_va_calls, num_caps_queries;
+  guint64 base_va_calls, base_caps_queries, filter_caps_queries;
+
+  /* Let the whole set of pipeline parameter buffers be allocated */
+  process_frames (filter, src_surface, dst_surface, flags, NUM_FRAMES);
+  base_va_calls = count_va_calls (display, &base_caps_queries);
+  gst_vaapi_filter_get_stats (filter, NULL, &filter_caps_queries);
+  g_assert_cmpuint (filter_caps_queries, ==, 1);
+
+  process_frames (filter, src_surface, dst_surface, flags, NUM_FRAMES);
+  num_va_calls = count_va_calls (display, &num_caps_queries);
+  gst_vaapi_filter_get_stats (filter, &num_frames, NULL);
+  g_assert_cmpuint (num_frames, ==, 2 * NUM_FRAMES + 1);
+  g_assert_cmpuint (num_caps_queries, ==, base_caps_queries);
+
+  /* vaMapBuffer(), vaUnmapBuffer(), vaBeginPicture(), vaRenderPicture()
+     and vaEndPicture() */
+  g_assert_cmpuint (num_va_calls - base_va_calls, ==, 5 * NUM_FRAMES);
+  printf ("VA calls per frame: %.1f\n",
+      (gdouble) (num_va_calls - base_va_calls) / NUM_FRAMES);
+
+  /* Setting the same deinterlacing method again, as done for every
+     field, only changes the field flags and keeps the pipeline caps */
+  if (deinterlace_method != GST_VAAPI_DEINTERLACE_METHOD_NONE) {
+    base_caps_queries = num_caps_queries;
+    if (!gst_vaapi_filter_set_deinterlacing (filter, deinterlace_method,
+            deinterlace_flags ^ GST_VAAPI_DEINTERLACE_FLAG_TFF))
+      g_error ("failed to set deinterlacing method");
+    process_frames (filter, src_surface, dst_surface, flags, 1);
+    if (!gst_vaapi_filter_set_deinterlacing (filter, deinterlace_method,
+            deinterlace_flags))
+      g_error ("failed to set deinterlacing method");
+    process_frames (filter, src_surface, dst_surface, flags, 1);
+    count_va_calls (display, &num_caps_queries);
+    g_assert_cmpuint (num_caps_queries, ==, base_caps_queries);
+  }
+
+  /* Changing the operations requires new pipeline caps */
+  if (gst_vaapi_filter_has_operation (filter, GST_VAAPI_FILTER_OP_DENOISE)) {
+    base_caps_queries = num_caps_queries;
+    if (!gst_vaapi_filter_set_operation (filter, GST_VAAPI_FILTER_OP_DENOISE,
+            NULL))
+      g_error ("failed to reset denoising level");
+    process_frames (filter, src_surface, dst_surface, flags, 1);
+    count_va_calls (display, &num_caps_queries);
+    g_assert_cmpuint (num_caps_queries, ==, base_caps_queries + 1);
+  }
+}
+
+/* A 2x2 mosaic is composed within a single picture */
+static void
+check_compose_stats (GstVaapiDisplay * display, GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface)
+{
+  GstVaapiBlendSurface tiles[4];
+  GstVaapiFilterStatus status;
+  guint64 num_frames, base_frames, num_va_calls, base_va_calls;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (tiles); i++) {
+    tiles[i].surface = src_surface;
+    tiles[i].crop = NULL;
+    tiles[i].target.width = GST_VAAPI_SURFACE_WIDTH (dst_surface) / 2;
+    tiles[i].target.height = GST_VAAPI_SURFACE_HEIGHT (dst_surface) / 2;
+    tiles[i].target.x = (i % 2) * tiles[i].target.width;
+    tiles[i].target.y = (i / 2) * tiles[i].target.height;
+    tiles[i].alpha = 1.0 - i * 0.25;
+  }
+
+  /* Let the pipeline parameter buffers of all the tiles be allocated */
+  status = gst_vaapi_filter_compose (filter, tiles, G_N_ELEMENTS (tiles),
+      dst_surface);
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    g_error ("failed to compose surfaces");
+  gst_vaapi_filter_get_stats (filter, &base_frames, NULL);
+  base_va_calls = count_va_calls (display, NULL);
+
+  status = gst_vaapi_filter_compose (filter, tiles, G_N_ELEMENTS (tiles),
+      dst_surface);
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    g_error ("failed to compose surfaces");
+  gst_vaapi_filter_get_stats (filter, &num_frames, NULL);
+  num_va_calls = count_va_calls (display, NULL);
+  g_assert_cmpuint (num_frames, ==, base_frames + 1);
+
+  /* vaMapBuffer() and vaUnmapBuffer() per tile, then vaBeginPicture(),
+     vaRenderPicture() and vaEndPicture() once */
+  g_assert_cmpuint (num_va_calls - base_va_calls, ==,
+      2 * G_N_ELEMENTS (tiles) + 3);
+
+  /* Tiles must fit in the destination surface */
+  tiles[3].target.x = GST_VAAPI_SURFACE_WIDTH (dst_surface);
+  status = gst_vaapi_filter_compose (filter, tiles, G_N_ELEMENTS (tiles),
+      dst_surface);
+  g_assert_cmpint (status, ==,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+}
+
 static gboolean
 parse_double (const gchar * str, gdouble * out_value_ptr)
 {
@@ -358,6 +516,9 @@ main (int argc, char *argv[])
   if (!window)
     g_error ("failed to create window");
 
+  /* Let the VA calls of the filter be counted */
+  gst_vaapi_profiler_set_enabled (TRUE);
+
   filter = gst_vaapi_filter_new (display);
   if (!filter)
     g_error ("failed to create video processing pipeline");
@@ -431,6 +592,10 @@ main (int argc, char *argv[])
   if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
     g_error ("failed to process video filters");
 
+  check_process_stats (display, filter, src_surface, dst_surface,
+      filter_flags, deinterlace_method, deinterlace_flags);
+  check_compose_stats (display, filter, src_surface, dst_surface);
+
   gst_vaapi_window_show (window);
 
   if (!gst_vaapi_window_put_surface (window, dst_surface, NULL, NULL,
@@ -0,0 +1,180 @@
+/*
+ *  test-frame-decimator.c - Test frame-rate decimation schedules
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiframedecimator.h>
+
+#define NUM_FRAMES      300
+
+static GstClockTime
+frame_timestamp (guint64 index, gint fps_n, gint fps_d)
+{
+  return gst_util_uint64_scale (index, (guint64) fps_d * GST_SECOND, fps_n);
+}
+
+/* Runs NUM_FRAMES input frames through the decimator, and checks the
+   output frames are evenly spaced at the output frame rate */
+static guint
+run_schedule (gint in_fps_n, gint in_fps_d, gint out_fps_n, gint out_fps_d,
+    guint64 * kept)
+{
+  GstVaapiFrameDecimator decimator;
+  GstClockTime ts, out_ts, out_duration, next_ts;
+  guint i, num_kept = 0;
+
+  gst_vaapi_frame_decimator_init (&decimator, in_fps_n, in_fps_d,
+      out_fps_n, out_fps_d);
+  g_assert (gst_vaapi_frame_decimator_is_active (&decimator));
+
+  next_ts = 0;
+  for (i = 0; i < NUM_FRAMES; i++) {
+    ts = frame_timestamp (i, in_fps_n, in_fps_d);
+    if (!gst_vaapi_frame_decimator_keep (&decimator, ts, &out_ts,
+            &out_duration))
+      continue;
+
+    /* The kept frame is the first one at or after its output slot,
+       up to rounding errors */
+    g_assert_cmpuint (out_ts, ==, frame_timestamp (num_kept, out_fps_n,
+            out_fps_d));
+    g_assert_cmpuint (out_ts, ==, next_ts);
+    g_assert_cmpuint (ts, >=, out_ts);
+    g_assert_cmpuint (ts - out_ts, <=, frame_timestamp (1, in_fps_n,
+            in_fps_d) + 1);
+    next_ts = out_ts + out_duration;
+
+    if (kept)
+      kept[num_kept] = i;
+    num_kept++;
+  }
+  return num_kept;
+}
+
+static void
+test_schedules (void)
+{
+  guint64 kept[NUM_FRAMES];
+  guint i, num_kept;
+
+  /* Halving keeps every other frame */
+  num_kept = run_schedule (30, 1, 15, 1, kept);
+  g_assert_cmpuint (num_kept, ==, NUM_FRAMES / 2);
+  for (i = 0; i < num_kept; i++)
+    g_assert_cmpuint (kept[i], ==, 2 * i);
+
+  /* Deinterlacing 60 fields/s to 30 fps keeps the first fields only */
+  num_kept = run_schedule (60, 1, 30, 1, kept);
+  g_assert_cmpuint (num_kept, ==, NUM_FRAMES / 2);
+  for (i = 0; i < num_kept; i++)
+    g_assert_cmpuint (kept[i] % 2, ==, 0);
+
+  /* NTSC rates: 4 frames out of 5 */
+  num_kept = run_schedule (30000, 1001, 24000, 1001, NULL);
+  g_assert_cmpuint (num_kept, ==, NUM_FRAMES * 4 / 5);
+
+  /* Non integral ratio */
+  num_kept = run_schedule (25, 1, 24, 1, NULL);
+  g_assert_cmpuint (num_kept, ==, NUM_FRAMES * 24 / 25);
+  num_kept = run_schedule (60000, 1001, 25, 1, NULL);
+  g_assert_cmpuint (num_kept, >=, 125);
+  g_assert_cmpuint (num_kept, <=, 126);
+}
+
+static void
+test_inactive (void)
+{
+  GstVaapiFrameDecimator decimator;
+  GstClockTime out_ts, out_duration;
+
+  /* Same, higher, or unknown rates never drop frames */
+  gst_vaapi_frame_decimator_init (&decimator, 30, 1, 30, 1);
+  g_assert (!gst_vaapi_frame_decimator_is_active (&decimator));
+  gst_vaapi_frame_decimator_init (&decimator, 30, 1, 60, 1);
+  g_assert (!gst_vaapi_frame_decimator_is_active (&decimator));
+  gst_vaapi_frame_decimator_init (&decimator, 0, 1, 15, 1);
+  g_assert (!gst_vaapi_frame_decimator_is_active (&decimator));
+  gst_vaapi_frame_decimator_init (&decimator, 30, 1, 0, 1);
+  g_assert (!gst_vaapi_frame_decimator_is_active (&decimator));
+
+  g_assert (gst_vaapi_frame_decimator_keep (&decimator, GST_SECOND,
+          &out_ts, &out_duration));
+  g_assert_cmpuint (out_ts, ==, GST_SECOND);
+  g_assert_cmpuint (out_duration, ==, GST_CLOCK_TIME_NONE);
+}
+
+static void
+test_discontinuities (void)
+{
+  GstVaapiFrameDecimator decimator;
+  GstClockTime out_ts, out_duration;
+  const GstClockTime base_ts = 10 * GST_SECOND;
+
+  gst_vaapi_frame_decimator_init (&decimator, 30, 1, 10, 1);
+
+  /* The first frame is the origin of the output time line */
+  g_assert (gst_vaapi_frame_decimator_keep (&decimator, base_ts, &out_ts,
+          &out_duration));
+  g_assert_cmpuint (out_ts, ==, base_ts);
+  g_assert_cmpuint (out_duration, ==, GST_SECOND / 10);
+  g_assert (!gst_vaapi_frame_decimator_keep (&decimator,
+          base_ts + frame_timestamp (1, 30, 1), NULL, NULL));
+
+  /* Missing input frames do not shift the schedule */
+  g_assert (gst_vaapi_frame_decimator_keep (&decimator,
+          base_ts + frame_timestamp (4, 30, 1), &out_ts, NULL));
+  g_assert_cmpuint (out_ts, ==, base_ts + GST_SECOND / 10);
+  g_assert (gst_vaapi_frame_decimator_keep (&decimator,
+          base_ts + frame_timestamp (12, 30, 1), &out_ts, NULL));
+  g_assert_cmpuint (out_ts, ==, base_ts + 4 * GST_SECOND / 10);
+
+  /* Frames without timestamps are kept as is */
+  g_assert (gst_vaapi_frame_decimator_keep (&decimator, GST_CLOCK_TIME_NONE,
+          &out_ts, &out_duration));
+  g_assert_cmpuint (out_ts, ==, GST_CLOCK_TIME_NONE);
+  g_assert_cmpuint (out_duration, ==, GST_SECOND / 10);
+
+  /* Going backwards, e.g. after a seek, restarts the schedule */
+  g_assert (gst_vaapi_frame_decimator_keep (&decimator, GST_SECOND, &out_ts,
+          NULL));
+  g_assert_cmpuint (out_ts, ==, GST_SECOND);
+  g_assert (!gst_vaapi_frame_decimator_keep (&decimator,
+          GST_SECOND + frame_timestamp (1, 30, 1), NULL, NULL));
+
+  /* So does an explicit reset */
+  gst_vaapi_frame_decimator_reset (&decimator);
+  g_assert (gst_vaapi_frame_decimator_keep (&decimator,
+          GST_SECOND + frame_timestamp (2, 30, 1), &out_ts, NULL));
+  g_assert_cmpuint (out_ts, ==, GST_SECOND + frame_timestamp (2, 30, 1));
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_schedules ();
+  test_inactive ();
+  test_discontinuities ();
+
+  g_print ("all frame decimator tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ *  test-h26x-crop.c - Test H.264/H.265 cropping rectangle alignment
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiutils_h26x.h>
+
+#define WIDTH   1920
+#define HEIGHT  1080
+
+static void
+check_align (guint x, guint y, guint width, guint height, guint crop_unit_y,
+    guint frame_width, guint frame_height, guint expected_x, guint expected_y,
+    guint expected_width, guint expected_height)
+{
+  const GstVaapiRectangle crop_rect = { x, y, width, height };
+  GstVaapiRectangle rect;
+
+  if (!gst_vaapi_utils_h26x_align_crop_rect (&crop_rect, frame_width,
+          frame_height, crop_unit_y, &rect))
+    g_error ("could not align (%u,%u):%ux%u", x, y, width, height);
+
+  g_assert_cmpuint (rect.x, ==, expected_x);
+  g_assert_cmpuint (rect.y, ==, expected_y);
+  g_assert_cmpuint (rect.width, ==, expected_width);
+  g_assert_cmpuint (rect.height, ==, expected_height);
+}
+
+static void
+check_invalid (guint x, guint y, guint width, guint height,
+    guint frame_width, guint frame_height)
+{
+  const GstVaapiRectangle crop_rect = { x, y, width, height };
+  GstVaapiRectangle rect = { 1, 2, 3, 4 };
+
+  if (gst_vaapi_utils_h26x_align_crop_rect (&crop_rect, frame_width,
+          frame_height, 2, &rect))
+    g_error ("aligned invalid (%u,%u):%ux%u", x, y, width, height);
+
+  /* The output is left untouched */
+  g_assert_cmpuint (rect.x, ==, 1);
+  g_assert_cmpuint (rect.y, ==, 2);
+  g_assert_cmpuint (rect.width, ==, 3);
+  g_assert_cmpuint (rect.height, ==, 4);
+}
+
+static void
+test_aligned (void)
+{
+  check_align (0, 0, WIDTH, HEIGHT, 2, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT);
+  check_align (16, 8, 1280, 720, 2, WIDTH, HEIGHT, 16, 8, 1280, 720);
+  check_align (16, 8, 1280, 720, 4, WIDTH, HEIGHT, 16, 8, 1280, 720);
+}
+
+/* Odd edges are extended outwards to the 4:2:0 chroma sample grid */
+static void
+test_chroma_alignment (void)
+{
+  check_align (1, 1, 5, 5, 2, WIDTH, HEIGHT, 0, 0, 6, 6);
+  check_align (3, 5, 100, 100, 2, WIDTH, HEIGHT, 2, 4, 102, 102);
+  check_align (2, 2, 1, 1, 2, WIDTH, HEIGHT, 2, 2, 2, 2);
+}
+
+/* The H.264 crop unit is 4 lines high for field coding */
+static void
+test_field_alignment (void)
+{
+  check_align (0, 3, 10, 6, 4, WIDTH, HEIGHT, 0, 0, 10, 12);
+  check_align (0, 4, 10, 4, 4, WIDTH, HEIGHT, 0, 4, 10, 4);
+  check_align (0, 6, 10, 1, 4, WIDTH, HEIGHT, 0, 4, 10, 4);
+}
+
+static void
+test_clamping (void)
+{
+  /* Never wider than the frame, even for odd frame widths */
+  check_align (1, 0, 1918, HEIGHT, 2, 1919, HEIGHT, 0, 0, 1919, HEIGHT);
+
+  /* The bottom edge may reach the end of the last crop unit, which
+     is part of the coded padding */
+  check_align (0, 1077, 16, 3, 4, WIDTH, HEIGHT, 0, 1076, 16, 4);
+  check_align (0, 1080, 16, 1, 4, WIDTH, 1081, 0, 1080, 16, 4);
+  check_align (0, 1079, 16, 2, 2, WIDTH, 1081, 0, 1078, 16, 4);
+}
+
+static void
+test_invalid (void)
+{
+  check_invalid (0, 0, 0, HEIGHT, WIDTH, HEIGHT);
+  check_invalid (0, 0, WIDTH, 0, WIDTH, HEIGHT);
+  check_invalid (WIDTH, 0, 2, 2, WIDTH, HEIGHT);
+  check_invalid (0, HEIGHT, 2, 2, WIDTH, HEIGHT);
+  check_invalid (2, 0, WIDTH, HEIGHT, WIDTH, HEIGHT);
+  check_invalid (0, 2, WIDTH, HEIGHT, WIDTH, HEIGHT);
+
+  /* No overflow on the right and bottom edges */
+  check_invalid (16, 0, G_MAXUINT32, 2, WIDTH, HEIGHT);
+  check_invalid (0, 16, 2, G_MAXUINT32, WIDTH, HEIGHT);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_aligned ();
+  test_chroma_alignment ();
+  test_field_alignment ();
+  test_clamping ();
+  test_invalid ();
+
+  g_print ("all cropping rectangle tests passed\n");
+  gst_deinit ();
+  return 0;
+}
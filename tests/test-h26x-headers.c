@@ -0,0 +1,547 @@
+/*
+ *  test-h26x-headers.c - Test and benchmark H.264/H.265 header templates
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <gst/base/gstbitwriter.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/vaapi/gstvaapiutils_h26x_priv.h>
+#include <gst/vaapi/gstvaapiutils_h264_enc_priv.h>
+#if USE_H265_ENCODER
+# include <gst/codecparsers/gsth265parser.h>
+# include <gst/vaapi/gstvaapiutils_h265_enc_priv.h>
+#endif
+
+#define LOG2_MAX_FRAME_NUM      8
+#define LOG2_MAX_POC_LSB        10
+#define NUM_FRAMES              1000
+#define NUM_BENCH_FRAMES        200000
+
+/* 1920x1080, in 16x16 macroblocks and in 64x64 coding tree blocks */
+#define WIDTH_IN_MBS            120
+#define HEIGHT_IN_MBS           68
+#define PIC_SIZE_IN_CTBS        (30 * 17)
+
+/* The syntax elements the slice header is generated from */
+typedef struct
+{
+  guint32 first_mb_in_slice;
+  guint32 slice_type;
+  gint32 slice_qp_delta;
+} SliceKey;
+
+static void
+fill_h264_seq_param (VAEncSequenceParameterBufferH264 * seq_param)
+{
+  memset (seq_param, 0, sizeof (*seq_param));
+  seq_param->level_idc = 40;
+  seq_param->max_num_ref_frames = 1;
+  seq_param->picture_width_in_mbs = WIDTH_IN_MBS;
+  seq_param->picture_height_in_mbs = HEIGHT_IN_MBS;
+  seq_param->seq_fields.bits.chroma_format_idc = 1;
+  seq_param->seq_fields.bits.frame_mbs_only_flag = 1;
+  seq_param->seq_fields.bits.log2_max_frame_num_minus4 =
+      LOG2_MAX_FRAME_NUM - 4;
+  seq_param->seq_fields.bits.pic_order_cnt_type = 0;
+  seq_param->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4 =
+      LOG2_MAX_POC_LSB - 4;
+  seq_param->frame_cropping_flag = 1;
+  seq_param->frame_crop_bottom_offset = 4;
+}
+
+static void
+fill_h264_pic_param (VAEncPictureParameterBufferH264 * pic_param,
+    guint32 frame_num)
+{
+  memset (pic_param, 0, sizeof (*pic_param));
+  pic_param->frame_num = frame_num;
+  pic_param->pic_init_qp = 30;
+  pic_param->pic_fields.bits.entropy_coding_mode_flag = 1;
+  pic_param->pic_fields.bits.deblocking_filter_control_present_flag = 1;
+}
+
+/* Writes a P slice NAL unit, without start code, with the H.264
+   encoder bitstream writer, which records the position of frame_num
+   and pic_order_cnt_lsb in @tmpl */
+static void
+write_slice_header (GstBitWriter * bs, const SliceKey * key,
+    guint32 frame_num, guint32 poc_lsb, GstVaapiH26xHeaderTemplate * tmpl)
+{
+  VAEncPictureParameterBufferH264 pic_param;
+  VAEncSliceParameterBufferH264 slice_param;
+
+  fill_h264_pic_param (&pic_param, frame_num);
+
+  memset (&slice_param, 0, sizeof (slice_param));
+  slice_param.macroblock_address = key->first_mb_in_slice;
+  slice_param.slice_type = key->slice_type;
+  slice_param.pic_order_cnt_lsb = poc_lsb;
+  slice_param.slice_qp_delta = key->slice_qp_delta;
+  slice_param.slice_alpha_c0_offset_div2 = 2;
+  slice_param.slice_beta_offset_div2 = 2;
+
+  gst_bit_writer_put_bits_uint32 (bs, 0, 1);    /* forbidden_zero_bit */
+  gst_bit_writer_put_bits_uint32 (bs, 2, 2);    /* nal_ref_idc */
+  gst_bit_writer_put_bits_uint32 (bs, GST_H264_NAL_SLICE, 5);
+  if (!gst_vaapi_utils_h264_write_slice_header (bs, &pic_param,
+          &slice_param, LOG2_MAX_FRAME_NUM, LOG2_MAX_POC_LSB, 0, FALSE,
+          tmpl))
+    g_error ("failed to write slice header");
+}
+
+static void
+fill_template (GstVaapiH26xHeaderTemplate * tmpl, const SliceKey * key)
+{
+  GstBitWriter bs;
+
+  gst_bit_writer_init (&bs, 128 * 8);
+  gst_vaapi_utils_h26x_header_template_reset (tmpl, key, sizeof (*key));
+  write_slice_header (&bs, key, 0, 0, tmpl);
+  gst_vaapi_utils_h26x_header_template_set_data (tmpl,
+      GST_BIT_WRITER_DATA (&bs), GST_BIT_WRITER_BIT_SIZE (&bs));
+  gst_bit_writer_clear (&bs, TRUE);
+}
+
+/* Parses the NAL unit in @data with the codecparsers library, once
+   emulation prevention bytes are inserted */
+static void
+parse_h264_nal (GstH264NalParser * parser, const guint8 * data,
+    guint bit_size, GstH264NalUnit * nalu, GstBitWriter * bs)
+{
+  GstH264ParserResult result;
+
+  gst_bit_writer_init (bs, 128 * 8);
+  if (!gst_vaapi_utils_h26x_write_nal_unit (bs, (guint8 *) data,
+          (bit_size + 7) / 8))
+    g_error ("failed to insert emulation prevention bytes");
+
+  /* the NAL unit is prefixed with its 16-bit size */
+  result = gst_h264_parser_identify_nalu_avc (parser,
+      GST_BIT_WRITER_DATA (bs), 0, GST_BIT_WRITER_BIT_SIZE (bs) / 8, 2, nalu);
+  g_assert_cmpint (result, ==, GST_H264_PARSER_OK);
+}
+
+/* Registers the SPS and PPS the slice headers refer to in @parser,
+   and checks they hold the VA parameters they were written from */
+static void
+parse_h264_parameter_sets (GstH264NalParser * parser)
+{
+  VAEncSequenceParameterBufferH264 seq_param;
+  VAEncPictureParameterBufferH264 pic_param;
+  VAEncMiscParameterHRD hrd_params;
+  GstBitWriter bs, nal_bs;
+  GstH264NalUnit nalu;
+  GstH264SPS sps;
+  GstH264PPS pps;
+  GstH264ParserResult result;
+
+  fill_h264_seq_param (&seq_param);
+  memset (&hrd_params, 0, sizeof (hrd_params));
+
+  gst_bit_writer_init (&bs, 128 * 8);
+  gst_bit_writer_put_bits_uint32 (&bs, 0, 1);
+  gst_bit_writer_put_bits_uint32 (&bs, 3, 2);
+  gst_bit_writer_put_bits_uint32 (&bs, GST_H264_NAL_SPS, 5);
+  if (!gst_vaapi_utils_h264_write_sps (&bs, &seq_param,
+          GST_VAAPI_PROFILE_H264_MAIN, &hrd_params))
+    g_error ("failed to write SPS");
+  g_assert_cmpuint (GST_BIT_WRITER_BIT_SIZE (&bs) % 8, ==, 0);
+
+  parse_h264_nal (parser, GST_BIT_WRITER_DATA (&bs),
+      GST_BIT_WRITER_BIT_SIZE (&bs), &nalu, &nal_bs);
+  result = gst_h264_parser_parse_sps (parser, &nalu, &sps, TRUE);
+  g_assert_cmpint (result, ==, GST_H264_PARSER_OK);
+  g_assert_cmpuint (sps.profile_idc, ==, 77);
+  g_assert_cmpuint (sps.level_idc, ==, 40);
+  g_assert_cmpuint (sps.log2_max_frame_num_minus4, ==, LOG2_MAX_FRAME_NUM - 4);
+  g_assert_cmpuint (sps.log2_max_pic_order_cnt_lsb_minus4, ==,
+      LOG2_MAX_POC_LSB - 4);
+  g_assert_cmpuint (sps.pic_width_in_mbs_minus1, ==, WIDTH_IN_MBS - 1);
+  g_assert_cmpuint (sps.pic_height_in_map_units_minus1, ==,
+      HEIGHT_IN_MBS - 1);
+  g_assert_cmpuint (sps.frame_crop_bottom_offset, ==, 4);
+  gst_h264_sps_clear (&sps);
+  gst_bit_writer_clear (&nal_bs, TRUE);
+  gst_bit_writer_clear (&bs, TRUE);
+
+  fill_h264_pic_param (&pic_param, 0);
+
+  gst_bit_writer_init (&bs, 128 * 8);
+  gst_bit_writer_put_bits_uint32 (&bs, 0, 1);
+  gst_bit_writer_put_bits_uint32 (&bs, 3, 2);
+  gst_bit_writer_put_bits_uint32 (&bs, GST_H264_NAL_PPS, 5);
+  if (!gst_vaapi_utils_h264_write_pps (&bs, &pic_param,
+          GST_VAAPI_PROFILE_H264_MAIN))
+    g_error ("failed to write PPS");
+
+  parse_h264_nal (parser, GST_BIT_WRITER_DATA (&bs),
+      GST_BIT_WRITER_BIT_SIZE (&bs), &nalu, &nal_bs);
+  result = gst_h264_parser_parse_pps (parser, &nalu, &pps);
+  g_assert_cmpint (result, ==, GST_H264_PARSER_OK);
+  g_assert (pps.entropy_coding_mode_flag);
+  g_assert (pps.deblocking_filter_control_present_flag);
+  g_assert_cmpint (pps.pic_init_qp_minus26, ==, 4);
+  gst_h264_pps_clear (&pps);
+  gst_bit_writer_clear (&nal_bs, TRUE);
+  gst_bit_writer_clear (&bs, TRUE);
+}
+
+static void
+check_h264_slice_header (GstH264NalParser * parser, const SliceKey * key,
+    const guint8 * data, guint bit_size, guint32 frame_num, guint32 poc_lsb)
+{
+  GstBitWriter nal_bs;
+  GstH264NalUnit nalu;
+  GstH264SliceHdr slice_hdr;
+  GstH264ParserResult result;
+
+  parse_h264_nal (parser, data, bit_size, &nalu, &nal_bs);
+  result = gst_h264_parser_parse_slice_hdr (parser, &nalu, &slice_hdr, TRUE,
+      TRUE);
+  g_assert_cmpint (result, ==, GST_H264_PARSER_OK);
+  g_assert_cmpuint (slice_hdr.first_mb_in_slice, ==, key->first_mb_in_slice);
+  g_assert_cmpuint (slice_hdr.type, ==, key->slice_type);
+  g_assert_cmpuint (slice_hdr.frame_num, ==, frame_num);
+  g_assert_cmpuint (slice_hdr.pic_order_cnt_lsb, ==, poc_lsb);
+  g_assert_cmpint (slice_hdr.slice_qp_delta, ==, key->slice_qp_delta);
+  gst_bit_writer_clear (&nal_bs, TRUE);
+}
+
+static void
+test_patch (const SliceKey * key)
+{
+  GstVaapiH26xHeaderTemplate tmpl = { NULL, };
+  GstH264NalParser *parser;
+  GstBitWriter bs;
+  guint i, frame_num, poc_lsb;
+
+  parser = gst_h264_nal_parser_new ();
+  parse_h264_parameter_sets (parser);
+
+  fill_template (&tmpl, key);
+  g_assert_cmpuint (tmpl.num_fields, ==, 2);
+
+  /* Patched templates match headers written from scratch, and hold
+     the patched values once parsed */
+  for (i = 0; i < NUM_FRAMES; i++) {
+    frame_num = i % (1 << LOG2_MAX_FRAME_NUM);
+    poc_lsb = (2 * i) % (1 << LOG2_MAX_POC_LSB);
+
+    gst_bit_writer_init (&bs, 128 * 8);
+    write_slice_header (&bs, key, frame_num, poc_lsb, NULL);
+    gst_vaapi_utils_h26x_header_template_patch (&tmpl,
+        GST_VAAPI_H264_SLICE_TMPL_FIELD_FRAME_NUM, frame_num);
+    gst_vaapi_utils_h26x_header_template_patch (&tmpl,
+        GST_VAAPI_H264_SLICE_TMPL_FIELD_POC_LSB, poc_lsb);
+
+    g_assert_cmpuint (tmpl.bit_size, ==, GST_BIT_WRITER_BIT_SIZE (&bs));
+    g_assert (memcmp (tmpl.data, GST_BIT_WRITER_DATA (&bs),
+            (tmpl.bit_size + 7) / 8) == 0);
+    check_h264_slice_header (parser, key, tmpl.data, tmpl.bit_size,
+        frame_num, poc_lsb);
+    gst_bit_writer_clear (&bs, TRUE);
+  }
+  gst_vaapi_utils_h26x_header_template_clear (&tmpl);
+  gst_h264_nal_parser_free (parser);
+}
+
+static void
+test_match (const SliceKey * key)
+{
+  GstVaapiH26xHeaderTemplate tmpl = { NULL, };
+  SliceKey other_key = *key;
+
+  /* Empty templates never match */
+  g_assert (!gst_vaapi_utils_h26x_header_template_match (&tmpl, key,
+          sizeof (*key)));
+
+  fill_template (&tmpl, key);
+  g_assert (gst_vaapi_utils_h26x_header_template_match (&tmpl, key,
+          sizeof (*key)));
+
+  /* Any change to the variable-length fields requires a new header */
+  other_key.slice_qp_delta++;
+  g_assert (!gst_vaapi_utils_h26x_header_template_match (&tmpl, &other_key,
+          sizeof (other_key)));
+
+  gst_vaapi_utils_h26x_header_template_clear (&tmpl);
+  g_assert (!gst_vaapi_utils_h26x_header_template_match (&tmpl, key,
+          sizeof (*key)));
+}
+
+static gboolean
+h264_pps_equal (const VAEncPictureParameterBufferH264 * a,
+    const VAEncPictureParameterBufferH264 * b)
+{
+  GstBitWriter bs_a, bs_b;
+  gboolean equal;
+
+  gst_bit_writer_init (&bs_a, 128 * 8);
+  gst_bit_writer_init (&bs_b, 128 * 8);
+  if (!gst_vaapi_utils_h264_write_pps (&bs_a, a, GST_VAAPI_PROFILE_H264_HIGH)
+      || !gst_vaapi_utils_h264_write_pps (&bs_b, b,
+          GST_VAAPI_PROFILE_H264_HIGH))
+    g_error ("failed to write PPS");
+
+  equal = GST_BIT_WRITER_BIT_SIZE (&bs_a) == GST_BIT_WRITER_BIT_SIZE (&bs_b)
+      && memcmp (GST_BIT_WRITER_DATA (&bs_a), GST_BIT_WRITER_DATA (&bs_b),
+      GST_BIT_WRITER_BIT_SIZE (&bs_a) / 8) == 0;
+  gst_bit_writer_clear (&bs_a, TRUE);
+  gst_bit_writer_clear (&bs_b, TRUE);
+  return equal;
+}
+
+/* The encoder only regenerates the PPS when the syntax elements it is
+   written from change, so it must not depend on per-picture fields */
+static void
+test_h264_pps_reuse (void)
+{
+  VAEncPictureParameterBufferH264 pic_param, other;
+
+  fill_h264_pic_param (&pic_param, 0);
+  pic_param.pic_fields.bits.transform_8x8_mode_flag = 1;
+
+  other = pic_param;
+  other.frame_num = 7;
+  other.CurrPic.picture_id = 3;
+  other.CurrPic.TopFieldOrderCnt = 14;
+  other.ReferenceFrames[0].picture_id = 2;
+  other.coded_buf = 5;
+  other.pic_fields.bits.idr_pic_flag = 1;
+  other.pic_fields.bits.reference_pic_flag = 1;
+  g_assert (h264_pps_equal (&pic_param, &other));
+
+  other = pic_param;
+  other.pic_init_qp++;
+  g_assert (!h264_pps_equal (&pic_param, &other));
+
+  other = pic_param;
+  other.second_chroma_qp_index_offset = -2;
+  g_assert (!h264_pps_equal (&pic_param, &other));
+
+  other = pic_param;
+  other.pic_fields.bits.transform_8x8_mode_flag = 0;
+  g_assert (!h264_pps_equal (&pic_param, &other));
+}
+
+#if USE_H265_ENCODER
+#define H265_LOG2_MAX_POC_LSB   8
+
+static void
+fill_h265_pic_param (VAEncPictureParameterBufferHEVC * pic_param,
+    gint32 poc, gboolean is_idr)
+{
+  memset (pic_param, 0, sizeof (*pic_param));
+  pic_param->decoded_curr_pic.pic_order_cnt = poc;
+  pic_param->pic_init_qp = 30;
+  pic_param->pic_fields.bits.idr_pic_flag = is_idr;
+  pic_param->pic_fields.bits.transform_skip_enabled_flag = 1;
+  pic_param->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag = 1;
+}
+
+/* Writes a P slice NAL unit, without start code, with the H.265
+   encoder bitstream writer, which records the position of
+   slice_pic_order_cnt_lsb in @tmpl. The reference picture is always
+   the previous one, as for the slice header templates in the encoder */
+static void
+write_h265_slice_header (GstBitWriter * bs, guint32 slice_segment_address,
+    gint32 poc, gboolean is_idr, GstVaapiH26xHeaderTemplate * tmpl)
+{
+  VAEncPictureParameterBufferHEVC pic_param;
+  VAEncSliceParameterBufferHEVC slice_param;
+
+  fill_h265_pic_param (&pic_param, poc, is_idr);
+
+  memset (&slice_param, 0, sizeof (slice_param));
+  slice_param.slice_segment_address = slice_segment_address;
+  slice_param.slice_type = is_idr ? GST_H265_I_SLICE : GST_H265_P_SLICE;
+  slice_param.max_num_merge_cand = 5;
+  slice_param.slice_qp_delta = 2;
+  slice_param.ref_pic_list0[0].pic_order_cnt = poc - 1;
+  slice_param.slice_fields.bits.slice_temporal_mvp_enabled_flag = 1;
+  slice_param.slice_fields.bits.slice_loop_filter_across_slices_enabled_flag =
+      1;
+
+  gst_bit_writer_put_bits_uint32 (bs, 0, 1);    /* forbidden_zero_bit */
+  gst_bit_writer_put_bits_uint32 (bs,
+      is_idr ? GST_H265_NAL_SLICE_IDR_W_RADL : GST_H265_NAL_SLICE_TRAIL_R, 6);
+  gst_bit_writer_put_bits_uint32 (bs, 0, 6);    /* nuh_layer_id */
+  gst_bit_writer_put_bits_uint32 (bs, 1, 3);    /* nuh_temporal_id_plus1 */
+  if (!gst_vaapi_utils_h265_write_slice_header (bs, &pic_param,
+          &slice_param, H265_LOG2_MAX_POC_LSB, PIC_SIZE_IN_CTBS, TRUE, FALSE,
+          tmpl))
+    g_error ("failed to write slice header");
+}
+
+static void
+test_h265_patch (guint32 slice_segment_address)
+{
+  GstVaapiH26xHeaderTemplate tmpl = { NULL, };
+  GstBitWriter bs;
+  guint i;
+  gint32 poc;
+
+  gst_bit_writer_init (&bs, 128 * 8);
+  write_h265_slice_header (&bs, slice_segment_address, 1, FALSE, &tmpl);
+  gst_vaapi_utils_h26x_header_template_set_data (&tmpl,
+      GST_BIT_WRITER_DATA (&bs), GST_BIT_WRITER_BIT_SIZE (&bs));
+  gst_bit_writer_clear (&bs, TRUE);
+  g_assert_cmpuint (tmpl.num_fields, ==, 1);
+
+  /* Slice segment headers end with byte_alignment() */
+  g_assert_cmpuint (tmpl.bit_size % 8, ==, 0);
+
+  for (i = 0; i < NUM_FRAMES; i++) {
+    poc = 1 + i % ((1 << H265_LOG2_MAX_POC_LSB) - 1);
+
+    gst_bit_writer_init (&bs, 128 * 8);
+    write_h265_slice_header (&bs, slice_segment_address, poc, FALSE, NULL);
+    gst_vaapi_utils_h26x_header_template_patch (&tmpl,
+        GST_VAAPI_H265_SLICE_TMPL_FIELD_POC_LSB, poc);
+
+    g_assert_cmpuint (tmpl.bit_size, ==, GST_BIT_WRITER_BIT_SIZE (&bs));
+    g_assert (memcmp (tmpl.data, GST_BIT_WRITER_DATA (&bs),
+            tmpl.bit_size / 8) == 0);
+    gst_bit_writer_clear (&bs, TRUE);
+  }
+  gst_vaapi_utils_h26x_header_template_clear (&tmpl);
+
+  /* IDR slices carry no POC LSB, so there is nothing to patch */
+  gst_bit_writer_init (&bs, 128 * 8);
+  write_h265_slice_header (&bs, slice_segment_address, 0, TRUE, &tmpl);
+  g_assert_cmpuint (tmpl.num_fields, ==, 0);
+  gst_bit_writer_clear (&bs, TRUE);
+  gst_vaapi_utils_h26x_header_template_clear (&tmpl);
+}
+
+static gboolean
+h265_pps_equal (const VAEncPictureParameterBufferHEVC * a,
+    const VAEncPictureParameterBufferHEVC * b)
+{
+  GstBitWriter bs_a, bs_b;
+  gboolean equal;
+
+  gst_bit_writer_init (&bs_a, 128 * 8);
+  gst_bit_writer_init (&bs_b, 128 * 8);
+  if (!gst_vaapi_utils_h265_write_pps (&bs_a, a)
+      || !gst_vaapi_utils_h265_write_pps (&bs_b, b))
+    g_error ("failed to write PPS");
+
+  equal = GST_BIT_WRITER_BIT_SIZE (&bs_a) == GST_BIT_WRITER_BIT_SIZE (&bs_b)
+      && memcmp (GST_BIT_WRITER_DATA (&bs_a), GST_BIT_WRITER_DATA (&bs_b),
+      GST_BIT_WRITER_BIT_SIZE (&bs_a) / 8) == 0;
+  gst_bit_writer_clear (&bs_a, TRUE);
+  gst_bit_writer_clear (&bs_b, TRUE);
+  return equal;
+}
+
+/* Same as test_h264_pps_reuse(), for the H.265 PPS */
+static void
+test_h265_pps_reuse (void)
+{
+  VAEncPictureParameterBufferHEVC pic_param, other;
+
+  fill_h265_pic_param (&pic_param, 0, FALSE);
+
+  other = pic_param;
+  other.decoded_curr_pic.pic_order_cnt = 12;
+  other.decoded_curr_pic.picture_id = 3;
+  other.reference_frames[0].picture_id = 2;
+  other.coded_buf = 5;
+  other.nal_unit_type = GST_H265_NAL_SLICE_IDR_W_RADL;
+  other.pic_fields.bits.idr_pic_flag = 1;
+  other.pic_fields.bits.coding_type = 1;
+  other.pic_fields.bits.reference_pic_flag = 1;
+  g_assert (h265_pps_equal (&pic_param, &other));
+
+  other = pic_param;
+  other.pic_init_qp++;
+  g_assert (!h265_pps_equal (&pic_param, &other));
+
+  other = pic_param;
+  other.pic_fields.bits.cu_qp_delta_enabled_flag = 1;
+  other.diff_cu_qp_delta_depth = 1;
+  g_assert (!h265_pps_equal (&pic_param, &other));
+}
+#endif
+
+static void
+benchmark (const SliceKey * key)
+{
+  GstVaapiH26xHeaderTemplate tmpl = { NULL, };
+  GstBitWriter bs;
+  gint64 start_time, write_time, patch_time;
+  guint i;
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < NUM_BENCH_FRAMES; i++) {
+    gst_bit_writer_init (&bs, 128 * 8);
+    write_slice_header (&bs, key, i % (1 << LOG2_MAX_FRAME_NUM),
+        i % (1 << LOG2_MAX_POC_LSB), NULL);
+    gst_bit_writer_clear (&bs, TRUE);
+  }
+  write_time = g_get_monotonic_time () - start_time;
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < NUM_BENCH_FRAMES; i++) {
+    if (!gst_vaapi_utils_h26x_header_template_match (&tmpl, key,
+            sizeof (*key)))
+      fill_template (&tmpl, key);
+    gst_vaapi_utils_h26x_header_template_patch (&tmpl,
+        GST_VAAPI_H264_SLICE_TMPL_FIELD_FRAME_NUM,
+        i % (1 << LOG2_MAX_FRAME_NUM));
+    gst_vaapi_utils_h26x_header_template_patch (&tmpl,
+        GST_VAAPI_H264_SLICE_TMPL_FIELD_POC_LSB, i % (1 << LOG2_MAX_POC_LSB));
+  }
+  patch_time = g_get_monotonic_time () - start_time;
+  gst_vaapi_utils_h26x_header_template_clear (&tmpl);
+
+  g_print ("slice header generation: bit writer %.1f ns/frame, "
+      "template %.1f ns/frame\n",
+      write_time * 1000.0 / NUM_BENCH_FRAMES,
+      patch_time * 1000.0 / NUM_BENCH_FRAMES);
+}
+
+int
+main (int argc, char *argv[])
+{
+  SliceKey key;
+
+  gst_init (&argc, &argv);
+
+  memset (&key, 0, sizeof (key));
+  key.first_mb_in_slice = 120;
+  key.slice_type = 0;
+  key.slice_qp_delta = 4;
+
+  test_patch (&key);
+  test_match (&key);
+  test_h264_pps_reuse ();
+#if USE_H265_ENCODER
+  test_h265_patch (0);
+  test_h265_patch (2 * 30);
+  test_h265_pps_reuse ();
+#endif
+  benchmark (&key);
+
+  g_print ("all header template tests passed\n");
+  gst_deinit ();
+  return 0;
+}
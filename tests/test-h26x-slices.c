@@ -0,0 +1,129 @@
+/*
+ *  test-h26x-slices.c - Test splitting of H.264/H.265 coded pictures
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiutils_h26x.h>
+
+/* AUD, SPS, PPS, IDR slice, IDR slice (H.264) */
+static const guint8 h264_picture[] = {
+  0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,
+  0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x28,
+  0x00, 0x00, 0x00, 0x01, 0x68, 0xee, 0x3c, 0x80,
+  0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x21,
+  0x00, 0x00, 0x01, 0x65, 0x88, 0x82, 0x00,
+};
+
+/* VPS, SPS, PPS, IDR_W_RADL slice, IDR_W_RADL slice, EOS (H.265) */
+static const guint8 h265_picture[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c,
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01,
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc1,
+  0x00, 0x00, 0x01, 0x26, 0x01, 0xaf, 0x1d,
+  0x00, 0x00, 0x01, 0x26, 0x01, 0x50, 0x0f,
+  0x00, 0x00, 0x01, 0x4a, 0x01,
+};
+
+static const GstVaapiH26xSliceRange *
+get_range (GArray * slices, guint i)
+{
+  return &g_array_index (slices, GstVaapiH26xSliceRange, i);
+}
+
+static void
+check_contiguous (GArray * slices, guint size)
+{
+  guint i, offset = 0;
+
+  for (i = 0; i < slices->len; i++) {
+    g_assert_cmpuint (get_range (slices, i)->offset, ==, offset);
+    offset += get_range (slices, i)->size;
+  }
+  g_assert_cmpuint (offset, ==, size);
+}
+
+static void
+test_h264 (GArray * slices)
+{
+  guint n;
+
+  n = gst_vaapi_utils_h26x_split_slices (h264_picture, sizeof (h264_picture),
+      FALSE, slices);
+  g_assert_cmpuint (n, ==, 2);
+  check_contiguous (slices, sizeof (h264_picture));
+
+  /* AUD + SPS + PPS go along with the first slice */
+  g_assert_cmpuint (get_range (slices, 0)->size, ==, 30);
+  g_assert_cmpuint (h264_picture[get_range (slices, 1)->offset + 3], ==, 0x65);
+}
+
+static void
+test_h265 (GArray * slices)
+{
+  guint n;
+
+  n = gst_vaapi_utils_h26x_split_slices (h265_picture, sizeof (h265_picture),
+      TRUE, slices);
+  g_assert_cmpuint (n, ==, 2);
+  check_contiguous (slices, sizeof (h265_picture));
+
+  /* VPS + SPS + PPS go along with the first slice, EOS with the last */
+  g_assert_cmpuint (get_range (slices, 0)->size, ==, 28);
+  g_assert_cmpuint (get_range (slices, 1)->size, ==, 12);
+}
+
+static void
+test_no_slice (GArray * slices)
+{
+  static const guint8 sps_only[] = { 0x00, 0x00, 0x01, 0x67, 0x42, 0x00 };
+  static const guint8 garbage[] = { 0xde, 0xad, 0xbe, 0xef };
+  guint n;
+
+  n = gst_vaapi_utils_h26x_split_slices (sps_only, sizeof (sps_only), FALSE,
+      slices);
+  g_assert_cmpuint (n, ==, 1);
+  check_contiguous (slices, sizeof (sps_only));
+
+  n = gst_vaapi_utils_h26x_split_slices (garbage, sizeof (garbage), FALSE,
+      slices);
+  g_assert_cmpuint (n, ==, 1);
+  check_contiguous (slices, sizeof (garbage));
+
+  n = gst_vaapi_utils_h26x_split_slices (NULL, 0, FALSE, slices);
+  g_assert_cmpuint (n, ==, 0);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GArray *slices;
+
+  gst_init (&argc, &argv);
+
+  slices = g_array_new (FALSE, FALSE, sizeof (GstVaapiH26xSliceRange));
+  test_h264 (slices);
+  test_h265 (slices);
+  test_no_slice (slices);
+  g_array_unref (slices);
+
+  g_print ("all slice splitting tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ *  test-image-cache.c - Test the cache of downloaded surface contents
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiimagecache.h>
+
+#define IMAGE_SIZE      1000
+#define CACHE_SIZE      (3 * IMAGE_SIZE)
+
+/* Fake images: only their identity matters */
+typedef struct
+{
+  guint key;
+} FakeImage;
+
+typedef struct
+{
+  guint num_destroyed;
+  guint last_destroyed;
+} FakePool;
+
+static void
+fake_image_destroy (gpointer item, gpointer user_data)
+{
+  FakeImage *const image = item;
+  FakePool *const pool = user_data;
+
+  pool->num_destroyed++;
+  pool->last_destroyed = image->key;
+  g_slice_free (FakeImage, image);
+}
+
+static FakeImage *
+fake_image_new (guint key)
+{
+  FakeImage *const image = g_slice_new (FakeImage);
+
+  image->key = key;
+  return image;
+}
+
+/* Downloads the image for @key on cache miss, like a reader would */
+static void
+read_image (GstVaapiImageCache * cache, guint key)
+{
+  FakeImage *image;
+
+  image = gst_vaapi_image_cache_lookup (cache, key);
+  if (!image) {
+    image = fake_image_new (key);
+    g_assert (gst_vaapi_image_cache_insert (cache, key, image, IMAGE_SIZE));
+  }
+  g_assert_cmpuint (image->key, ==, key);
+  gst_vaapi_image_cache_release (cache, key);
+}
+
+static void
+test_hits (void)
+{
+  GstVaapiImageCache *cache;
+  FakePool pool = { 0, };
+  guint64 num_hits, num_misses;
+  gsize size;
+  guint i;
+
+  cache = gst_vaapi_image_cache_new (CACHE_SIZE, fake_image_destroy, &pool);
+  g_assert (cache != NULL);
+
+  /* Three readers of the same two pictures download each one once */
+  for (i = 0; i < 3; i++) {
+    read_image (cache, 1);
+    read_image (cache, 2);
+  }
+  gst_vaapi_image_cache_get_stats (cache, &num_hits, &num_misses, &size);
+  g_assert_cmpuint (num_misses, ==, 2);
+  g_assert_cmpuint (num_hits, ==, 4);
+  g_assert_cmpuint (size, ==, 2 * IMAGE_SIZE);
+  g_assert_cmpuint (pool.num_destroyed, ==, 0);
+
+  gst_vaapi_image_cache_free (cache);
+  g_assert_cmpuint (pool.num_destroyed, ==, 2);
+}
+
+static void
+test_eviction (void)
+{
+  GstVaapiImageCache *cache;
+  FakePool pool = { 0, };
+  FakeImage *image;
+  gsize size;
+
+  cache = gst_vaapi_image_cache_new (CACHE_SIZE, fake_image_destroy, &pool);
+
+  read_image (cache, 1);
+  read_image (cache, 2);
+  read_image (cache, 3);
+
+  /* The least recently used image goes first */
+  read_image (cache, 1);
+  read_image (cache, 4);
+  g_assert_cmpuint (pool.num_destroyed, ==, 1);
+  g_assert_cmpuint (pool.last_destroyed, ==, 2);
+  gst_vaapi_image_cache_get_stats (cache, NULL, NULL, &size);
+  g_assert_cmpuint (size, <=, CACHE_SIZE);
+
+  /* Images in use are never evicted */
+  image = gst_vaapi_image_cache_lookup (cache, 3);
+  g_assert (image != NULL);
+  read_image (cache, 1);
+  read_image (cache, 4);
+  read_image (cache, 5);
+  g_assert_cmpuint (pool.last_destroyed, ==, 1);
+  g_assert (gst_vaapi_image_cache_lookup (cache, 3) == image);
+  gst_vaapi_image_cache_release (cache, 3);
+  gst_vaapi_image_cache_release (cache, 3);
+
+  /* Images that don't fit are left to the caller */
+  image = fake_image_new (6);
+  g_assert (!gst_vaapi_image_cache_insert (cache, 6, image, CACHE_SIZE + 1));
+  g_slice_free (FakeImage, image);
+
+  /* One image per key */
+  image = fake_image_new (5);
+  g_assert (!gst_vaapi_image_cache_insert (cache, 5, image, IMAGE_SIZE));
+  g_slice_free (FakeImage, image);
+
+  gst_vaapi_image_cache_free (cache);
+  g_assert_cmpuint (pool.num_destroyed, ==, 5);
+}
+
+static void
+test_pinned_budget (void)
+{
+  GstVaapiImageCache *cache;
+  FakePool pool = { 0, };
+  FakeImage *image;
+  guint i;
+
+  cache = gst_vaapi_image_cache_new (CACHE_SIZE, fake_image_destroy, &pool);
+
+  /* The budget holds even when all images are in use */
+  for (i = 1; i <= 3; i++)
+    g_assert (gst_vaapi_image_cache_insert (cache, i, fake_image_new (i),
+            IMAGE_SIZE));
+  image = fake_image_new (4);
+  g_assert (!gst_vaapi_image_cache_insert (cache, 4, image, IMAGE_SIZE));
+
+  gst_vaapi_image_cache_release (cache, 2);
+  g_assert (gst_vaapi_image_cache_insert (cache, 4, image, IMAGE_SIZE));
+  g_assert_cmpuint (pool.last_destroyed, ==, 2);
+
+  for (i = 1; i <= 4; i++) {
+    if (i != 2)
+      gst_vaapi_image_cache_release (cache, i);
+  }
+  gst_vaapi_image_cache_free (cache);
+  g_assert_cmpuint (pool.num_destroyed, ==, 4);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_hits ();
+  test_eviction ();
+  test_pinned_budget ();
+
+  g_print ("all image cache tests passed\n");
+  gst_deinit ();
+  return 0;
+}
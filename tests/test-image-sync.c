@@ -0,0 +1,259 @@
+/*
+ *  test-image-sync.c - Test synchronization of VA images with surfaces
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiimagesync.h>
+
+#define IMAGE_HEIGHT    64
+
+#define SURFACE_IS_CURRENT GST_VAAPI_IMAGE_SYNC_SURFACE_IS_CURRENT
+#define IMAGE_IS_CURRENT GST_VAAPI_IMAGE_SYNC_IMAGE_IS_CURRENT
+
+/* Fake image backend: records the transfers instead of performing
+   them, and may be told to fail uploads */
+typedef struct
+{
+  guint num_gets;
+  guint num_puts;
+  guint put_planes;
+  guint put_y;
+  guint put_height;
+  gboolean put_fails;
+} FakeBackend;
+
+static gboolean
+fake_get_image (gpointer user_data)
+{
+  FakeBackend *const backend = user_data;
+
+  backend->num_gets++;
+  return TRUE;
+}
+
+static gboolean
+fake_put_image (gpointer user_data, guint planes, guint y, guint height)
+{
+  FakeBackend *const backend = user_data;
+
+  if (backend->put_fails)
+    return FALSE;
+
+  backend->num_puts++;
+  backend->put_planes = planes;
+  backend->put_y = y;
+  backend->put_height = height;
+  return TRUE;
+}
+
+static const GstVaapiImageSyncFuncs fake_funcs = {
+  fake_get_image,
+  fake_put_image,
+};
+
+static void
+test_read (void)
+{
+  FakeBackend backend = { 0, };
+  GstVaapiImageSync sync;
+
+  gst_vaapi_image_sync_init (&sync, &fake_funcs, &backend, IMAGE_HEIGHT);
+  g_assert_cmpuint (gst_vaapi_image_sync_get_flags (&sync), ==,
+      SURFACE_IS_CURRENT);
+
+  /* The first read downloads the surface, the next ones reuse it */
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_READ));
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_READ));
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.num_gets, ==, 1);
+
+  /* Reads never upload anything */
+  g_assert_cmpuint (backend.num_puts, ==, 0);
+  g_assert_cmpuint (gst_vaapi_image_sync_get_flags (&sync), ==,
+      SURFACE_IS_CURRENT | IMAGE_IS_CURRENT);
+  g_assert (gst_vaapi_image_sync_ensure_surface (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 0);
+}
+
+static void
+test_write (void)
+{
+  FakeBackend backend = { 0, };
+  GstVaapiImageSync sync;
+
+  gst_vaapi_image_sync_init (&sync, &fake_funcs, &backend, IMAGE_HEIGHT);
+
+  /* Partial writes need the previous surface contents */
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  g_assert_cmpuint (backend.num_gets, ==, 1);
+
+  /* Without any hint, the whole image is uploaded */
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 1);
+  g_assert_cmpuint (backend.put_planes, ==, GST_VAAPI_IMAGE_SYNC_ALL_PLANES);
+  g_assert_cmpuint (backend.put_y, ==, 0);
+  g_assert_cmpuint (backend.put_height, ==, IMAGE_HEIGHT);
+  g_assert_cmpuint (gst_vaapi_image_sync_get_flags (&sync), ==,
+      SURFACE_IS_CURRENT | IMAGE_IS_CURRENT);
+
+  /* Surface is already up-to-date */
+  g_assert (gst_vaapi_image_sync_ensure_surface (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 1);
+
+  /* Recycled surfaces have undefined contents: write-only maps don't
+     download them, read-write maps still do */
+  gst_vaapi_image_sync_reset (&sync);
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  g_assert_cmpuint (backend.num_gets, ==, 1);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 2);
+
+  gst_vaapi_image_sync_reset (&sync);
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_READWRITE));
+  g_assert_cmpuint (backend.num_gets, ==, 2);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 3);
+
+  /* Released images are downloaded again */
+  gst_vaapi_image_sync_invalidate_image (&sync);
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  g_assert_cmpuint (backend.num_gets, ==, 3);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+}
+
+static void
+test_dirty_rows (void)
+{
+  FakeBackend backend = { 0, };
+  GstVaapiImageSync sync;
+
+  gst_vaapi_image_sync_init (&sync, &fake_funcs, &backend, IMAGE_HEIGHT);
+
+  /* Only the band covering the modified rows is uploaded */
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_READWRITE));
+  gst_vaapi_image_sync_mark_dirty (&sync, 1 << 0, 16, 16);
+  gst_vaapi_image_sync_mark_dirty (&sync, 1 << 1, 40, 8);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 1);
+  g_assert_cmpuint (backend.put_planes, ==, 0x3);
+  g_assert_cmpuint (backend.put_y, ==, 16);
+  g_assert_cmpuint (backend.put_height, ==, 32);
+
+  /* Rows beyond the image are clipped */
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  gst_vaapi_image_sync_mark_dirty (&sync, 1 << 0, IMAGE_HEIGHT - 4, 16);
+  gst_vaapi_image_sync_mark_dirty (&sync, 1 << 0, IMAGE_HEIGHT + 4, 16);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.put_planes, ==, 1 << 0);
+  g_assert_cmpuint (backend.put_y, ==, IMAGE_HEIGHT - 4);
+  g_assert_cmpuint (backend.put_height, ==, 4);
+
+  /* Plane-only hints upload whole planes */
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  gst_vaapi_image_sync_mark_dirty (&sync, 1 << 2, 0, 0);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.put_planes, ==, 1 << 2);
+  g_assert_cmpuint (backend.put_y, ==, 0);
+  g_assert_cmpuint (backend.put_height, ==, IMAGE_HEIGHT);
+
+  /* Dirty areas don't leak into the next mapping */
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.put_planes, ==, GST_VAAPI_IMAGE_SYNC_ALL_PLANES);
+  g_assert_cmpuint (backend.put_height, ==, IMAGE_HEIGHT);
+  g_assert_cmpuint (backend.num_gets, ==, 1);
+}
+
+static void
+test_nested_maps (void)
+{
+  FakeBackend backend = { 0, };
+  GstVaapiImageSync sync;
+
+  gst_vaapi_image_sync_init (&sync, &fake_funcs, &backend, IMAGE_HEIGHT);
+
+  /* A plane mapped for writing after another one mapped for reading
+     gets uploaded */
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_READ));
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  gst_vaapi_image_sync_mark_dirty (&sync, 1 << 1, 0, 0);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.num_gets, ==, 1);
+  g_assert_cmpuint (backend.num_puts, ==, 1);
+  g_assert_cmpuint (backend.put_planes, ==, 1 << 1);
+
+  /* Nested mappings don't download over the pixels written so far */
+  gst_vaapi_image_sync_reset (&sync);
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_READ));
+  g_assert_cmpuint (backend.num_gets, ==, 1);
+  g_assert (gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 2);
+}
+
+static void
+test_upload_failure (void)
+{
+  FakeBackend backend = { 0, };
+  GstVaapiImageSync sync;
+
+  gst_vaapi_image_sync_init (&sync, &fake_funcs, &backend, IMAGE_HEIGHT);
+
+  /* A failed upload leaves the image as the only current copy */
+  backend.put_fails = TRUE;
+  g_assert (gst_vaapi_image_sync_map (&sync, GST_MAP_WRITE));
+  gst_vaapi_image_sync_mark_dirty (&sync, 1 << 0, 8, 8);
+  g_assert (!gst_vaapi_image_sync_unmap (&sync));
+  g_assert_cmpuint (gst_vaapi_image_sync_get_flags (&sync), ==,
+      IMAGE_IS_CURRENT);
+
+  /* The next synchronization uploads the whole image */
+  backend.put_fails = FALSE;
+  g_assert (gst_vaapi_image_sync_ensure_surface (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 1);
+  g_assert_cmpuint (backend.put_y, ==, 0);
+  g_assert_cmpuint (backend.put_height, ==, IMAGE_HEIGHT);
+  g_assert_cmpuint (gst_vaapi_image_sync_get_flags (&sync), ==,
+      SURFACE_IS_CURRENT | IMAGE_IS_CURRENT);
+
+  /* Nothing to upload for undefined contents */
+  gst_vaapi_image_sync_reset (&sync);
+  g_assert (gst_vaapi_image_sync_ensure_surface (&sync));
+  g_assert_cmpuint (backend.num_puts, ==, 1);
+  g_assert_cmpuint (gst_vaapi_image_sync_get_flags (&sync), ==,
+      SURFACE_IS_CURRENT);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_read ();
+  test_write ();
+  test_dirty_rows ();
+  test_nested_maps ();
+  test_upload_failure ();
+
+  g_print ("all image sync tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ *  test-lru-cache.c - Test the bounded LRU cache
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapilrucache.h>
+
+#define CAPACITY        4
+#define POOL_SIZE       CAPACITY
+#define NUM_FRAMES      1000
+
+/* Values are counted references on fake imported surfaces */
+static gint g_refcounts[2 * CAPACITY + 1];
+
+static gpointer
+value_new (guint index)
+{
+  g_refcounts[index]++;
+  return &g_refcounts[index];
+}
+
+static void
+value_free (gpointer value)
+{
+  gint *const refcount = value;
+
+  g_assert_cmpint (*refcount, >, 0);
+  (*refcount)--;
+}
+
+static gboolean
+is_cached (guint index)
+{
+  return g_refcounts[index] > 0;
+}
+
+static void
+test_hits_and_misses (void)
+{
+  GstVaapiLruCache *cache;
+  guint64 num_hits, num_misses, num_evictions;
+  guint i;
+
+  cache = gst_vaapi_lru_cache_new (CAPACITY, g_direct_hash, g_direct_equal,
+      NULL, value_free);
+
+  g_assert (gst_vaapi_lru_cache_lookup (cache, GUINT_TO_POINTER (1)) == NULL);
+  gst_vaapi_lru_cache_insert (cache, GUINT_TO_POINTER (1), value_new (1));
+  g_assert (gst_vaapi_lru_cache_lookup (cache, GUINT_TO_POINTER (1)) ==
+      &g_refcounts[1]);
+  g_assert_cmpuint (gst_vaapi_lru_cache_get_size (cache), ==, 1);
+
+  /* Replacing an entry releases the previous value */
+  gst_vaapi_lru_cache_insert (cache, GUINT_TO_POINTER (1), value_new (2));
+  g_assert (!is_cached (1));
+  g_assert (gst_vaapi_lru_cache_lookup (cache, GUINT_TO_POINTER (1)) ==
+      &g_refcounts[2]);
+  g_assert_cmpuint (gst_vaapi_lru_cache_get_size (cache), ==, 1);
+
+  g_assert (gst_vaapi_lru_cache_remove (cache, GUINT_TO_POINTER (1)));
+  g_assert (!gst_vaapi_lru_cache_remove (cache, GUINT_TO_POINTER (1)));
+  g_assert (!is_cached (2));
+
+  gst_vaapi_lru_cache_get_stats (cache, &num_hits, &num_misses,
+      &num_evictions);
+  g_assert_cmpuint (num_hits, ==, 2);
+  g_assert_cmpuint (num_misses, ==, 1);
+  g_assert_cmpuint (num_evictions, ==, 0);
+
+  for (i = 1; i <= CAPACITY; i++)
+    gst_vaapi_lru_cache_insert (cache, GUINT_TO_POINTER (i), value_new (i));
+  gst_vaapi_lru_cache_free (cache);
+  for (i = 0; i < G_N_ELEMENTS (g_refcounts); i++)
+    g_assert (!is_cached (i));
+}
+
+static void
+test_eviction_order (void)
+{
+  GstVaapiLruCache *cache;
+  guint64 num_evictions;
+  guint i;
+
+  cache = gst_vaapi_lru_cache_new (CAPACITY, g_direct_hash, g_direct_equal,
+      NULL, value_free);
+  for (i = 1; i <= CAPACITY; i++)
+    gst_vaapi_lru_cache_insert (cache, GUINT_TO_POINTER (i), value_new (i));
+
+  /* Entry 1 is used again, so entry 2 is now the least recently used */
+  g_assert (gst_vaapi_lru_cache_lookup (cache, GUINT_TO_POINTER (1)) != NULL);
+  gst_vaapi_lru_cache_insert (cache, GUINT_TO_POINTER (CAPACITY + 1),
+      value_new (CAPACITY + 1));
+  g_assert_cmpuint (gst_vaapi_lru_cache_get_size (cache), ==, CAPACITY);
+  g_assert (!is_cached (2));
+  g_assert (gst_vaapi_lru_cache_lookup (cache, GUINT_TO_POINTER (2)) == NULL);
+  for (i = 1; i <= CAPACITY + 1; i++) {
+    if (i != 2)
+      g_assert (is_cached (i));
+  }
+
+  /* Only one entry is released per insertion */
+  gst_vaapi_lru_cache_insert (cache, GUINT_TO_POINTER (CAPACITY + 2),
+      value_new (CAPACITY + 2));
+  g_assert (!is_cached (3));
+  g_assert (is_cached (1));
+  gst_vaapi_lru_cache_get_stats (cache, NULL, NULL, &num_evictions);
+  g_assert_cmpuint (num_evictions, ==, 2);
+
+  gst_vaapi_lru_cache_clear (cache);
+  g_assert_cmpuint (gst_vaapi_lru_cache_get_size (cache), ==, 0);
+  for (i = 0; i < G_N_ELEMENTS (g_refcounts); i++)
+    g_assert (!is_cached (i));
+  gst_vaapi_lru_cache_free (cache);
+}
+
+/* Mimics the import of the surfaces of an upstream pool, which is
+   renewed mid-stream, e.g. on renegotiation */
+static void
+test_pool_cycle (void)
+{
+  GstVaapiLruCache *cache;
+  guint64 num_hits, num_misses, num_evictions;
+  guint i, index, base = 1;
+
+  cache = gst_vaapi_lru_cache_new (CAPACITY, g_direct_hash, g_direct_equal,
+      NULL, value_free);
+  for (i = 0; i < NUM_FRAMES; i++) {
+    if (i == NUM_FRAMES / 2)
+      base += POOL_SIZE;
+    index = base + i % POOL_SIZE;
+    if (!gst_vaapi_lru_cache_lookup (cache, GUINT_TO_POINTER (index)))
+      gst_vaapi_lru_cache_insert (cache, GUINT_TO_POINTER (index),
+          value_new (index));
+  }
+
+  /* Each surface was imported once, and the old pool was released */
+  gst_vaapi_lru_cache_get_stats (cache, &num_hits, &num_misses,
+      &num_evictions);
+  g_assert_cmpuint (num_misses, ==, 2 * POOL_SIZE);
+  g_assert_cmpuint (num_hits, ==, NUM_FRAMES - 2 * POOL_SIZE);
+  g_assert_cmpuint (num_evictions, ==, POOL_SIZE);
+  for (i = 1; i <= POOL_SIZE; i++) {
+    g_assert (!is_cached (i));
+    g_assert (is_cached (POOL_SIZE + i));
+  }
+  gst_vaapi_lru_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_hits_and_misses ();
+  test_eviction_order ();
+  test_pool_cycle ();
+
+  g_print ("all LRU cache tests passed\n");
+  gst_deinit ();
+  return 0;
+}
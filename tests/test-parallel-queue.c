@@ -0,0 +1,219 @@
+/*
+ *  test-parallel-queue.c - Test dispatching of pictures over parallel lanes
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiparallelqueue.h>
+
+#define NUM_LANES       3
+#define NUM_PICTURES    24
+
+/* Stub backend: each lane processes its pictures serially, with its
+   own latency, and all lanes run concurrently. Time is virtual, so
+   that the outcome does not depend on the load of the machine */
+static const guint lane_latency[NUM_LANES] = { 12, 3, 5 };
+
+typedef struct
+{
+  guint index;
+  guint done_time;
+} StubPicture;
+
+typedef struct
+{
+  guint clock;
+  guint busy_until[NUM_LANES];
+  guint num_freed;
+} StubBackend;
+
+static void
+stub_submit (StubBackend * backend, guint lane, StubPicture * picture)
+{
+  backend->busy_until[lane] = MAX (backend->busy_until[lane],
+      backend->clock) + lane_latency[lane];
+  picture->done_time = backend->busy_until[lane];
+}
+
+static void
+stub_sync (StubBackend * backend, StubPicture * picture)
+{
+  backend->clock = MAX (backend->clock, picture->done_time);
+}
+
+static StubBackend *g_backend;
+
+static void
+stub_picture_free (StubPicture * picture)
+{
+  g_backend->num_freed++;
+  g_slice_free (StubPicture, picture);
+}
+
+static void
+test_reorder (void)
+{
+  GstVaapiParallelQueue *queue;
+  StubBackend backend = { 0, {0,}, 0 };
+  StubPicture *picture;
+  guint i, lane, lane_count[NUM_LANES] = { 0, };
+  gboolean out_of_order = FALSE;
+  guint last_done_time = 0, serial_time = 0;
+
+  g_backend = &backend;
+  queue = gst_vaapi_parallel_queue_new (NUM_LANES,
+      (GDestroyNotify) stub_picture_free);
+  g_assert (queue != NULL);
+
+  for (i = 0; i < NUM_PICTURES; i++) {
+    picture = g_slice_new0 (StubPicture);
+    picture->index = i;
+
+    lane = gst_vaapi_parallel_queue_next_lane (queue);
+    g_assert_cmpuint (lane, <, NUM_LANES);
+    stub_submit (&backend, lane, picture);
+    gst_vaapi_parallel_queue_push (queue, lane, picture);
+    lane_count[lane]++;
+    serial_time += lane_latency[lane];
+
+    /* Lanes complete their pictures in a different order */
+    if (picture->done_time < last_done_time)
+      out_of_order = TRUE;
+    last_done_time = picture->done_time;
+  }
+  g_assert (out_of_order);
+
+  /* Idle lanes get the same share of pictures */
+  for (i = 0; i < NUM_LANES; i++)
+    g_assert_cmpuint (lane_count[i], ==, NUM_PICTURES / NUM_LANES);
+
+  /* Pictures are output in submission order */
+  for (i = 0; i < NUM_PICTURES; i++) {
+    picture = gst_vaapi_parallel_queue_pop (queue, 0, &lane);
+    g_assert (picture != NULL);
+    g_assert_cmpuint (picture->index, ==, i);
+    stub_sync (&backend, picture);
+    stub_picture_free (picture);
+  }
+  g_assert (gst_vaapi_parallel_queue_pop (queue, 0, NULL) == NULL);
+
+  /* Lanes ran concurrently */
+  g_assert_cmpuint (backend.clock, <, serial_time);
+
+  gst_vaapi_parallel_queue_free (queue);
+  g_assert_cmpuint (backend.num_freed, ==, NUM_PICTURES);
+}
+
+/* Submits NUM_PICTURES pictures from another thread */
+static gpointer
+producer_thread (gpointer data)
+{
+  GstVaapiParallelQueue *const queue = data;
+  StubPicture *picture;
+  guint i, lane;
+
+  for (i = 0; i < NUM_PICTURES; i++) {
+    picture = g_slice_new0 (StubPicture);
+    picture->index = i;
+    lane = gst_vaapi_parallel_queue_next_lane (queue);
+    gst_vaapi_parallel_queue_push (queue, lane, picture);
+  }
+  return NULL;
+}
+
+static void
+test_concurrent_pop (void)
+{
+  GstVaapiParallelQueue *queue;
+  StubBackend backend = { 0, {0,}, 0 };
+  StubPicture *picture;
+  GThread *thread;
+  guint i;
+
+  g_backend = &backend;
+  queue = gst_vaapi_parallel_queue_new (NUM_LANES,
+      (GDestroyNotify) stub_picture_free);
+  thread = g_thread_new ("producer", producer_thread, queue);
+
+  /* Blocking pops return every picture, in submission order. The
+     timeout only guards against a hang */
+  for (i = 0; i < NUM_PICTURES; i++) {
+    picture = gst_vaapi_parallel_queue_pop (queue, 10 * G_USEC_PER_SEC,
+        NULL);
+    g_assert (picture != NULL);
+    g_assert_cmpuint (picture->index, ==, i);
+    stub_picture_free (picture);
+  }
+  g_thread_join (thread);
+
+  g_assert (gst_vaapi_parallel_queue_pop (queue, 0, NULL) == NULL);
+  for (i = 0; i < NUM_LANES; i++)
+    g_assert_cmpuint (gst_vaapi_parallel_queue_get_lane_depth (queue, i), ==,
+        0);
+  gst_vaapi_parallel_queue_free (queue);
+  g_assert_cmpuint (backend.num_freed, ==, NUM_PICTURES);
+}
+
+static void
+test_lane_selection (void)
+{
+  GstVaapiParallelQueue *queue;
+  StubBackend backend = { 0, {0,}, 0 };
+  StubPicture *picture;
+  guint lane;
+
+  g_backend = &backend;
+  queue = gst_vaapi_parallel_queue_new (2,
+      (GDestroyNotify) stub_picture_free);
+
+  /* The least busy lane is selected first */
+  gst_vaapi_parallel_queue_push (queue, 0, g_slice_new0 (StubPicture));
+  gst_vaapi_parallel_queue_push (queue, 0, g_slice_new0 (StubPicture));
+  g_assert_cmpuint (gst_vaapi_parallel_queue_get_lane_depth (queue, 0), ==, 2);
+  lane = gst_vaapi_parallel_queue_next_lane (queue);
+  g_assert_cmpuint (lane, ==, 1);
+
+  /* The number of lanes can only change while the queue is empty */
+  g_assert (!gst_vaapi_parallel_queue_set_num_lanes (queue, 3));
+  g_assert (gst_vaapi_parallel_queue_set_num_lanes (queue, 2));
+
+  picture = gst_vaapi_parallel_queue_pop (queue, 0, &lane);
+  g_assert (picture != NULL);
+  g_assert_cmpuint (lane, ==, 0);
+  g_assert_cmpuint (gst_vaapi_parallel_queue_get_lane_depth (queue, 0), ==, 1);
+  stub_picture_free (picture);
+
+  /* Pending items are released along with the queue */
+  gst_vaapi_parallel_queue_free (queue);
+  g_assert_cmpuint (backend.num_freed, ==, 2);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_reorder ();
+  test_concurrent_pop ();
+  test_lane_selection ();
+
+  g_print ("all parallel queue tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *  test-profiler.c - Test the VA call statistics
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiprofiler.h>
+
+/* A stand-in for libva, so that the statistics can be checked without
+   any driver */
+static VAStatus
+stub_va_call (VADisplay dpy, guint delay_us)
+{
+  if (delay_us > 0)
+    g_usleep (delay_us);
+  return dpy ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_DISPLAY;
+}
+
+static void
+test_disabled (void)
+{
+  GstVaapiProfilerStats stats;
+  VADisplay const dpy = GUINT_TO_POINTER (0x100);
+  VAStatus status;
+
+  g_assert (!GST_VAAPI_PROFILER_IS_ENABLED ());
+  GST_VAAPI_PROFILER_CALL (status, dpy, VA_INVALID_ID, SYNC_SURFACE, 0,
+      stub_va_call (dpy, 0));
+  g_assert_cmpint (status, ==, VA_STATUS_SUCCESS);
+
+  g_assert (!gst_vaapi_profiler_get_stats (dpy, VA_INVALID_ID,
+          GST_VAAPI_PROFILER_ENTRY_SYNC_SURFACE, &stats));
+  g_assert_cmpuint (stats.count, ==, 0);
+  g_assert (gst_vaapi_profiler_to_json (dpy) == NULL);
+}
+
+static void
+test_stats (void)
+{
+  GstVaapiProfilerStats stats;
+  VADisplay const dpy = GUINT_TO_POINTER (0x200);
+  VADisplay const other_dpy = GUINT_TO_POINTER (0x300);
+  const VAContextID ctx = 7;
+  VAStatus status;
+  gchar *json;
+
+  gst_vaapi_profiler_set_enabled (TRUE);
+
+  GST_VAAPI_PROFILER_CALL (status, dpy, ctx, CREATE_BUFFER, 100,
+      stub_va_call (dpy, 0));
+  GST_VAAPI_PROFILER_CALL (status, dpy, ctx, CREATE_BUFFER, 50,
+      stub_va_call (dpy, 0));
+  GST_VAAPI_PROFILER_CALL (status, dpy, VA_INVALID_ID, SYNC_SURFACE, 0,
+      stub_va_call (dpy, 2000));
+  GST_VAAPI_PROFILER_CALL (status, other_dpy, VA_INVALID_ID, SYNC_SURFACE,
+      0, stub_va_call (other_dpy, 0));
+  g_assert_cmpint (status, ==, VA_STATUS_SUCCESS);
+
+  /* Calls related to a context are accounted to both */
+  g_assert (gst_vaapi_profiler_get_stats (dpy, VA_INVALID_ID,
+          GST_VAAPI_PROFILER_ENTRY_CREATE_BUFFER, &stats));
+  g_assert_cmpuint (stats.count, ==, 2);
+  g_assert_cmpuint (stats.bytes, ==, 150);
+  g_assert_cmpuint (stats.max, <=, stats.total);
+  g_assert (gst_vaapi_profiler_get_stats (dpy, ctx,
+          GST_VAAPI_PROFILER_ENTRY_CREATE_BUFFER, &stats));
+  g_assert_cmpuint (stats.count, ==, 2);
+  g_assert (!gst_vaapi_profiler_get_stats (dpy, ctx,
+          GST_VAAPI_PROFILER_ENTRY_SYNC_SURFACE, &stats));
+
+  /* Latencies are measured around the call */
+  g_assert (gst_vaapi_profiler_get_stats (dpy, VA_INVALID_ID,
+          GST_VAAPI_PROFILER_ENTRY_SYNC_SURFACE, &stats));
+  g_assert_cmpuint (stats.count, ==, 1);
+  g_assert_cmpuint (stats.max, >=, 2 * GST_MSECOND);
+  g_assert_cmpuint (stats.total, ==, stats.max);
+
+  /* Displays are kept apart */
+  g_assert (gst_vaapi_profiler_get_stats (other_dpy, VA_INVALID_ID,
+          GST_VAAPI_PROFILER_ENTRY_SYNC_SURFACE, &stats));
+  g_assert_cmpuint (stats.count, ==, 1);
+  g_assert (!gst_vaapi_profiler_get_stats (other_dpy, VA_INVALID_ID,
+          GST_VAAPI_PROFILER_ENTRY_CREATE_BUFFER, &stats));
+
+  json = gst_vaapi_profiler_to_json (dpy);
+  g_assert (json != NULL);
+  g_assert (strstr (json, "\"vaCreateBuffer\":{\"count\":2,") != NULL);
+  g_assert (strstr (json, "\"bytes\":150}") != NULL);
+  g_assert (strstr (json, "\"contexts\":{\"7\":{\"vaCreateBuffer\"") != NULL);
+  g_assert (strstr (json, "vaSyncSurface") != NULL);
+  g_free (json);
+
+  /* Closing a display releases its statistics */
+  gst_vaapi_profiler_close_display (dpy);
+  g_assert (gst_vaapi_profiler_to_json (dpy) == NULL);
+  g_assert (gst_vaapi_profiler_get_stats (other_dpy, VA_INVALID_ID,
+          GST_VAAPI_PROFILER_ENTRY_SYNC_SURFACE, &stats));
+  gst_vaapi_profiler_close_display (other_dpy);
+
+  gst_vaapi_profiler_set_enabled (FALSE);
+}
+
+static void
+test_entry_names (void)
+{
+  guint i;
+
+  for (i = 0; i < GST_VAAPI_PROFILER_ENTRY_COUNT; i++)
+    g_assert (g_str_has_prefix (gst_vaapi_profiler_entry_get_name (i), "va"));
+  g_assert_cmpstr (gst_vaapi_profiler_entry_get_name
+      (GST_VAAPI_PROFILER_ENTRY_END_PICTURE), ==, "vaEndPicture");
+  g_assert (gst_vaapi_profiler_entry_get_name
+      (GST_VAAPI_PROFILER_ENTRY_COUNT) == NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_disabled ();
+  test_stats ();
+  test_entry_names ();
+
+  g_print ("all profiler tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ *  test-surface-bindings.c - Test items bound to VA surfaces
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapisurfacebindings.h>
+
+#define MAX_BUFFERS     8
+
+/* Fake buffers: the surface whose export they wrap is all that matters */
+typedef struct
+{
+  GstVaapiID surface_id;
+} FakeBuffer;
+
+/* Fake buffer pool, with an export backend that counts memory swaps */
+typedef struct
+{
+  GstVaapiSurfaceBindings *bindings;
+  FakeBuffer buffers[MAX_BUFFERS];
+  guint num_buffers;
+  guint num_swaps;
+} FakePool;
+
+static void
+fake_pool_init (FakePool * pool)
+{
+  pool->bindings = gst_vaapi_surface_bindings_new ();
+  g_assert (pool->bindings != NULL);
+}
+
+static void
+fake_pool_finalize (FakePool * pool)
+{
+  while (gst_vaapi_surface_bindings_steal (pool->bindings));
+  gst_vaapi_surface_bindings_free (pool->bindings);
+}
+
+/* Mimics the DMABuf path of GstVaapiVideoBufferPool::acquire_buffer() */
+static FakeBuffer *
+fake_pool_acquire (FakePool * pool, GstVaapiID surface_id)
+{
+  FakeBuffer *buffer;
+
+  buffer = gst_vaapi_surface_bindings_acquire (pool->bindings, surface_id);
+  if (buffer) {
+    g_assert_cmpuint (buffer->surface_id, ==, surface_id);
+    return buffer;
+  }
+
+  buffer = gst_vaapi_surface_bindings_steal (pool->bindings);
+  if (!buffer) {
+    g_assert_cmpuint (pool->num_buffers, <, MAX_BUFFERS);
+    buffer = &pool->buffers[pool->num_buffers++];
+  }
+  buffer->surface_id = surface_id;
+  pool->num_swaps++;
+  gst_vaapi_surface_bindings_bind (pool->bindings, surface_id, buffer);
+  return buffer;
+}
+
+static void
+fake_pool_release (FakePool * pool, FakeBuffer * buffer)
+{
+  g_assert (gst_vaapi_surface_bindings_release (pool->bindings, buffer));
+}
+
+static void
+test_driver_order (void)
+{
+  /* Surfaces as handed out by a driver that does not use a FIFO */
+  static const GstVaapiID surfaces[] = {
+    4, 1, 3, 2, 2, 4, 1, 3, 3, 3, 1, 2, 4, 4, 2, 1,
+  };
+  FakeBuffer *bound[5] = { NULL, };
+  FakeBuffer *buffer;
+  FakePool pool = { 0, };
+  guint64 num_hits, num_misses;
+  guint i;
+
+  fake_pool_init (&pool);
+
+  /* The decoder first fills all its surfaces */
+  for (i = 1; i <= 4; i++)
+    bound[i] = fake_pool_acquire (&pool, i);
+  for (i = 1; i <= 4; i++)
+    fake_pool_release (&pool, bound[i]);
+
+  for (i = 0; i < G_N_ELEMENTS (surfaces); i++) {
+    buffer = fake_pool_acquire (&pool, surfaces[i]);
+    g_assert (buffer == bound[surfaces[i]]);
+    fake_pool_release (&pool, buffer);
+  }
+
+  /* Each surface got exported into a buffer once and for all */
+  g_assert_cmpuint (pool.num_swaps, ==, 4);
+  g_assert_cmpuint (pool.num_buffers, ==, 4);
+  gst_vaapi_surface_bindings_get_stats (pool.bindings, &num_hits, &num_misses);
+  g_assert_cmpuint (num_misses, ==, 4);
+  g_assert_cmpuint (num_hits, ==, G_N_ELEMENTS (surfaces) - 4);
+  g_assert_cmpuint (gst_vaapi_surface_bindings_get_num_free (pool.bindings),
+      ==, 4);
+
+  fake_pool_finalize (&pool);
+}
+
+static void
+test_in_flight (void)
+{
+  FakeBuffer *buffers[3];
+  FakePool pool = { 0, };
+  guint i, j;
+
+  fake_pool_init (&pool);
+
+  /* Three pictures in flight at a time, released out of order */
+  for (j = 0; j < 4; j++) {
+    for (i = 0; i < 3; i++)
+      buffers[i] = fake_pool_acquire (&pool, 10 + (i + j) % 3);
+    fake_pool_release (&pool, buffers[1]);
+    fake_pool_release (&pool, buffers[2]);
+    fake_pool_release (&pool, buffers[0]);
+  }
+  g_assert_cmpuint (pool.num_buffers, ==, 3);
+  g_assert_cmpuint (pool.num_swaps, ==, 3);
+  for (i = 0; i < 3; i++)
+    g_assert_cmpuint (gst_vaapi_surface_bindings_get_surface_id
+        (pool.bindings, &pool.buffers[i]), ==, pool.buffers[i].surface_id);
+
+  /* New surfaces take over the least recently released buffers */
+  buffers[0] = fake_pool_acquire (&pool, 20);
+  g_assert_cmpuint (pool.num_buffers, ==, 3);
+  g_assert_cmpuint (pool.num_swaps, ==, 4);
+  g_assert_cmpuint (buffers[0]->surface_id, ==, 20);
+  g_assert_cmpuint (gst_vaapi_surface_bindings_get_num_free (pool.bindings),
+      ==, 2);
+  fake_pool_release (&pool, buffers[0]);
+
+  fake_pool_finalize (&pool);
+}
+
+static void
+test_unbind (void)
+{
+  FakeBuffer *buffer, *other;
+  FakePool pool = { 0, };
+
+  fake_pool_init (&pool);
+
+  /* Unbound buffers stay with the caller */
+  buffer = fake_pool_acquire (&pool, 7);
+  gst_vaapi_surface_bindings_unbind (pool.bindings, buffer);
+  g_assert_cmpuint (gst_vaapi_surface_bindings_get_surface_id (pool.bindings,
+          buffer), ==, GST_VAAPI_ID_INVALID);
+  g_assert (!gst_vaapi_surface_bindings_release (pool.bindings, buffer));
+  g_assert (gst_vaapi_surface_bindings_acquire (pool.bindings, 7) == NULL);
+
+  /* Binding a buffer elsewhere drops its previous binding */
+  gst_vaapi_surface_bindings_bind (pool.bindings, 7, buffer);
+  gst_vaapi_surface_bindings_bind (pool.bindings, 8, buffer);
+  fake_pool_release (&pool, buffer);
+  g_assert (gst_vaapi_surface_bindings_acquire (pool.bindings, 7) == NULL);
+  g_assert (gst_vaapi_surface_bindings_acquire (pool.bindings, 8) == buffer);
+
+  /* Buffers in use are never stolen */
+  g_assert (gst_vaapi_surface_bindings_steal (pool.bindings) == NULL);
+  other = fake_pool_acquire (&pool, 9);
+  g_assert (other != buffer);
+  fake_pool_release (&pool, buffer);
+  fake_pool_release (&pool, other);
+  g_assert (gst_vaapi_surface_bindings_steal (pool.bindings) == buffer);
+  g_assert (gst_vaapi_surface_bindings_steal (pool.bindings) == other);
+  g_assert (gst_vaapi_surface_bindings_steal (pool.bindings) == NULL);
+
+  fake_pool_finalize (&pool);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_driver_order ();
+  test_in_flight ();
+  test_unbind ();
+
+  g_print ("all surface bindings tests passed\n");
+  gst_deinit ();
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ *  test-surface-recycler.c - Test VA surfaces recycling
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapisurfacerecycler.h>
+
+#define SURFACE_SIZE    (1920 * 1088 * 3 / 2)
+#define MAX_IDLE_TIME   (3600 * G_TIME_SPAN_SECOND)
+#define NUM_SURFACES    16
+#define NUM_STREAMS     50
+#define SHORT_IDLE_TIME (100 * G_TIME_SPAN_MILLISECOND)
+
+/* Stub allocator, standing in for vaCreateSurfaces()/vaDestroySurfaces() */
+typedef struct
+{
+  GHashTable *live_surfaces;
+  GstVaapiID next_id;
+  guint num_creates;
+  guint num_destroys;
+} StubAllocator;
+
+static void
+stub_allocator_init (StubAllocator * allocator)
+{
+  allocator->live_surfaces = g_hash_table_new (g_direct_hash, g_direct_equal);
+  allocator->next_id = 0;
+  allocator->num_creates = 0;
+  allocator->num_destroys = 0;
+}
+
+static void
+stub_allocator_finalize (StubAllocator * allocator)
+{
+  g_assert_cmpuint (g_hash_table_size (allocator->live_surfaces), ==, 0);
+  g_hash_table_unref (allocator->live_surfaces);
+}
+
+static GstVaapiID
+stub_allocator_create (StubAllocator * allocator)
+{
+  /* Surface 0 is a valid VA surface */
+  const GstVaapiID surface_id = allocator->next_id++;
+
+  g_hash_table_add (allocator->live_surfaces, GSIZE_TO_POINTER (surface_id));
+  allocator->num_creates++;
+  return surface_id;
+}
+
+static void
+stub_allocator_destroy (GstVaapiID surface_id, gpointer user_data)
+{
+  StubAllocator *const allocator = user_data;
+
+  g_assert (g_hash_table_remove (allocator->live_surfaces,
+          GSIZE_TO_POINTER (surface_id)));
+  allocator->num_destroys++;
+}
+
+/* Mimics gst_vaapi_surface_new_recyclable() */
+static GstVaapiID
+acquire_surface (GstVaapiSurfaceRecycler * recycler,
+    StubAllocator * allocator, const GstVaapiSurfaceRecyclerKey * key)
+{
+  GstVaapiID surface_id;
+
+  if (gst_vaapi_surface_recycler_take (recycler, key, &surface_id)) {
+    g_assert (g_hash_table_contains (allocator->live_surfaces,
+            GSIZE_TO_POINTER (surface_id)));
+    return surface_id;
+  }
+  return stub_allocator_create (allocator);
+}
+
+static void
+init_key (GstVaapiSurfaceRecyclerKey * key, GstVideoFormat format,
+    guint width, guint height)
+{
+  key->chroma_type = GST_VAAPI_CHROMA_TYPE_YUV420;
+  key->format = format;
+  key->width = width;
+  key->height = height;
+  key->flags = 0;
+}
+
+static void
+test_churn (void)
+{
+  GstVaapiSurfaceRecycler *recycler;
+  GstVaapiSurfaceRecyclerKey key;
+  StubAllocator allocator;
+  GstVaapiID surfaces[NUM_SURFACES];
+  guint64 num_hits, num_misses;
+  gint64 start_time, elapsed;
+  guint i, j;
+
+  stub_allocator_init (&allocator);
+  recycler = gst_vaapi_surface_recycler_new (NUM_SURFACES * SURFACE_SIZE,
+      MAX_IDLE_TIME, stub_allocator_destroy, &allocator);
+  g_assert (recycler != NULL);
+  init_key (&key, GST_VIDEO_FORMAT_NV12, 1920, 1088);
+
+  /* Streams are started and stopped one after the other */
+  start_time = g_get_monotonic_time ();
+  for (j = 0; j < NUM_STREAMS; j++) {
+    for (i = 0; i < NUM_SURFACES; i++)
+      surfaces[i] = acquire_surface (recycler, &allocator, &key);
+    for (i = 0; i < NUM_SURFACES; i++)
+      g_assert (gst_vaapi_surface_recycler_put (recycler, &key, surfaces[i],
+              SURFACE_SIZE));
+  }
+  elapsed = g_get_monotonic_time () - start_time;
+  g_print ("%u stream start/stop cycles in %" G_GINT64_FORMAT " us\n",
+      NUM_STREAMS, elapsed);
+
+  /* Only the first stream allocated surfaces */
+  g_assert_cmpuint (allocator.num_creates, ==, NUM_SURFACES);
+  g_assert_cmpuint (allocator.num_destroys, ==, 0);
+  gst_vaapi_surface_recycler_get_stats (recycler, &num_hits, &num_misses,
+      NULL);
+  g_assert_cmpuint (num_misses, ==, NUM_SURFACES);
+  g_assert_cmpuint (num_hits, ==, (NUM_STREAMS - 1) * NUM_SURFACES);
+
+  gst_vaapi_surface_recycler_free (recycler);
+  g_assert_cmpuint (allocator.num_destroys, ==, NUM_SURFACES);
+  stub_allocator_finalize (&allocator);
+}
+
+static void
+test_budget (void)
+{
+  GstVaapiSurfaceRecycler *recycler;
+  GstVaapiSurfaceRecyclerKey key;
+  StubAllocator allocator;
+  GstVaapiID surfaces[4], surface_id;
+  gsize size;
+  guint i;
+
+  stub_allocator_init (&allocator);
+  recycler = gst_vaapi_surface_recycler_new (3 * SURFACE_SIZE,
+      MAX_IDLE_TIME, stub_allocator_destroy, &allocator);
+  init_key (&key, GST_VIDEO_FORMAT_NV12, 1920, 1088);
+
+  /* The least recently recycled surface goes when over budget */
+  for (i = 0; i < 4; i++)
+    surfaces[i] = stub_allocator_create (&allocator);
+  for (i = 0; i < 4; i++)
+    g_assert (gst_vaapi_surface_recycler_put (recycler, &key, surfaces[i],
+            SURFACE_SIZE));
+  g_assert_cmpuint (allocator.num_destroys, ==, 1);
+  g_assert (!g_hash_table_contains (allocator.live_surfaces,
+          GSIZE_TO_POINTER (surfaces[0])));
+  gst_vaapi_surface_recycler_get_stats (recycler, NULL, NULL, &size);
+  g_assert_cmpuint (size, ==, 3 * SURFACE_SIZE);
+
+  /* The most recently recycled surface comes out first */
+  g_assert (gst_vaapi_surface_recycler_take (recycler, &key, &surface_id));
+  g_assert_cmpuint (surface_id, ==, surfaces[3]);
+
+  /* Surfaces larger than the whole budget are left to the caller */
+  g_assert (!gst_vaapi_surface_recycler_put (recycler, &key, surface_id,
+          4 * SURFACE_SIZE));
+  stub_allocator_destroy (surface_id, &allocator);
+
+  gst_vaapi_surface_recycler_free (recycler);
+  stub_allocator_finalize (&allocator);
+}
+
+static void
+test_idle (void)
+{
+  GstVaapiSurfaceRecycler *recycler;
+  GstVaapiSurfaceRecyclerKey key;
+  StubAllocator allocator;
+  gsize size;
+  guint i;
+
+  stub_allocator_init (&allocator);
+  recycler = gst_vaapi_surface_recycler_new (8 * SURFACE_SIZE,
+      MAX_IDLE_TIME, stub_allocator_destroy, &allocator);
+  init_key (&key, GST_VIDEO_FORMAT_NV12, 1920, 1088);
+
+  for (i = 0; i < 4; i++)
+    g_assert (gst_vaapi_surface_recycler_put (recycler, &key,
+            stub_allocator_create (&allocator), SURFACE_SIZE));
+
+  /* Nothing is evicted before the idle time elapsed */
+  g_assert_cmpuint (gst_vaapi_surface_recycler_evict_idle (recycler,
+          g_get_monotonic_time ()), ==, 0);
+  g_assert_cmpuint (allocator.num_destroys, ==, 0);
+
+  g_assert_cmpuint (gst_vaapi_surface_recycler_evict_idle (recycler,
+          g_get_monotonic_time () + 2 * MAX_IDLE_TIME), ==, 4);
+  g_assert_cmpuint (allocator.num_destroys, ==, 4);
+  gst_vaapi_surface_recycler_get_stats (recycler, NULL, NULL, &size);
+  g_assert_cmpuint (size, ==, 0);
+
+  gst_vaapi_surface_recycler_free (recycler);
+  stub_allocator_finalize (&allocator);
+}
+
+/* Counts the surfaces destroyed by the eviction thread */
+typedef struct
+{
+  GMutex mutex;
+  GCond cond;
+  guint num_destroys;
+} DestroyCounter;
+
+static void
+destroy_counter_destroy (GstVaapiID surface_id, gpointer user_data)
+{
+  DestroyCounter *const counter = user_data;
+
+  g_mutex_lock (&counter->mutex);
+  counter->num_destroys++;
+  g_cond_signal (&counter->cond);
+  g_mutex_unlock (&counter->mutex);
+}
+
+static void
+test_idle_timeout (void)
+{
+  GstVaapiSurfaceRecycler *recycler;
+  GstVaapiSurfaceRecyclerKey key;
+  DestroyCounter counter;
+  gint64 start_time, end_time;
+  gsize size;
+  guint i;
+
+  g_mutex_init (&counter.mutex);
+  g_cond_init (&counter.cond);
+  counter.num_destroys = 0;
+  recycler = gst_vaapi_surface_recycler_new (8 * SURFACE_SIZE,
+      SHORT_IDLE_TIME, destroy_counter_destroy, &counter);
+  g_assert (recycler != NULL);
+  init_key (&key, GST_VIDEO_FORMAT_NV12, 1920, 1088);
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < 4; i++)
+    g_assert (gst_vaapi_surface_recycler_put (recycler, &key, i,
+            SURFACE_SIZE));
+
+  /* Idle surfaces go away without any further take or put */
+  end_time = start_time + 50 * SHORT_IDLE_TIME;
+  g_mutex_lock (&counter.mutex);
+  while (counter.num_destroys < 4) {
+    if (!g_cond_wait_until (&counter.cond, &counter.mutex, end_time))
+      break;
+  }
+  g_assert_cmpuint (counter.num_destroys, ==, 4);
+  g_mutex_unlock (&counter.mutex);
+  g_assert_cmpint (g_get_monotonic_time () - start_time, >=, SHORT_IDLE_TIME);
+
+  gst_vaapi_surface_recycler_get_stats (recycler, NULL, NULL, &size);
+  g_assert_cmpuint (size, ==, 0);
+
+  gst_vaapi_surface_recycler_free (recycler);
+  g_assert_cmpuint (counter.num_destroys, ==, 4);
+  g_cond_clear (&counter.cond);
+  g_mutex_clear (&counter.mutex);
+}
+
+static void
+test_keys (void)
+{
+  GstVaapiSurfaceRecycler *recycler;
+  GstVaapiSurfaceRecyclerKey nv12_key, i420_key, chroma_key, small_key;
+  StubAllocator allocator;
+  GstVaapiID surface_id, nv12_surface;
+
+  stub_allocator_init (&allocator);
+  recycler = gst_vaapi_surface_recycler_new (8 * SURFACE_SIZE,
+      MAX_IDLE_TIME, stub_allocator_destroy, &allocator);
+  init_key (&nv12_key, GST_VIDEO_FORMAT_NV12, 1920, 1088);
+  init_key (&i420_key, GST_VIDEO_FORMAT_I420, 1920, 1088);
+  init_key (&chroma_key, GST_VIDEO_FORMAT_UNKNOWN, 1920, 1088);
+  init_key (&small_key, GST_VIDEO_FORMAT_NV12, 1280, 720);
+
+  nv12_surface = stub_allocator_create (&allocator);
+  g_assert (gst_vaapi_surface_recycler_put (recycler, &nv12_key,
+          nv12_surface, SURFACE_SIZE));
+
+  /* Surfaces only match the very same allocation attributes */
+  g_assert (!gst_vaapi_surface_recycler_take (recycler, &i420_key,
+          &surface_id));
+  g_assert (!gst_vaapi_surface_recycler_take (recycler, &chroma_key,
+          &surface_id));
+  g_assert (!gst_vaapi_surface_recycler_take (recycler, &small_key,
+          &surface_id));
+  nv12_key.flags = 1;
+  g_assert (!gst_vaapi_surface_recycler_take (recycler, &nv12_key,
+          &surface_id));
+  nv12_key.flags = 0;
+  g_assert (gst_vaapi_surface_recycler_take (recycler, &nv12_key,
+          &surface_id));
+  g_assert_cmpuint (surface_id, ==, nv12_surface);
+  g_assert (!gst_vaapi_surface_recycler_take (recycler, &nv12_key,
+          &surface_id));
+
+  stub_allocator_destroy (surface_id, &allocator);
+  gst_vaapi_surface_recycler_free (recycler);
+  stub_allocator_finalize (&allocator);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_churn ();
+  test_budget ();
+  test_idle ();
+  test_idle_timeout ();
+  test_keys ();
+
+  g_print ("all surface recycler tests passed\n");
+  gst_deinit ();
+  return 0;
+}
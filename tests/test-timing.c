@@ -0,0 +1,138 @@
+/*
+ *  test-timing.c - Test stage timing scopes
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapitiming.h>
+
+typedef struct
+{
+  guint num_calls[GST_VAAPI_TIMING_STAGE_COUNT];
+} TimingCalls;
+
+static void
+timing_func (GstVaapiTimingStage stage, GstClockTime duration,
+    gpointer user_data)
+{
+  TimingCalls *const calls = user_data;
+
+  g_assert_cmpuint (stage, <, GST_VAAPI_TIMING_STAGE_COUNT);
+  calls->num_calls[stage]++;
+}
+
+/* Runs a stage of at least 1ms */
+static void
+run_stage (GstVaapiTimingStage stage)
+{
+  const GstClockTime start = GST_VAAPI_TIMING_BEGIN ();
+
+  g_usleep (1000);
+  GST_VAAPI_TIMING_END (stage, start);
+}
+
+static void
+test_disabled (void)
+{
+  GstVaapiTimingScope scope;
+
+  g_assert (!GST_VAAPI_TIMING_IS_ENABLED ());
+  g_assert (!GST_CLOCK_TIME_IS_VALID (GST_VAAPI_TIMING_BEGIN ()));
+
+  gst_vaapi_timing_scope_begin (&scope);
+  g_assert (!scope.active);
+  run_stage (GST_VAAPI_TIMING_STAGE_PARSE);
+  gst_vaapi_timing_scope_end (&scope);
+}
+
+static void
+test_scopes (void)
+{
+  GstVaapiTimingScope outer, inner;
+  TimingCalls calls = { {0,} };
+
+  gst_vaapi_timing_set_func (timing_func, &calls);
+  g_assert (GST_VAAPI_TIMING_IS_ENABLED ());
+
+  /* Stages run out of any scope are only reported */
+  run_stage (GST_VAAPI_TIMING_STAGE_PUSH);
+  g_assert_cmpuint (calls.num_calls[GST_VAAPI_TIMING_STAGE_PUSH], ==, 1);
+
+  gst_vaapi_timing_scope_begin (&outer);
+  g_assert (outer.active);
+  run_stage (GST_VAAPI_TIMING_STAGE_PARSE);
+
+  /* The durations of a nested scope are also accounted to its parent */
+  gst_vaapi_timing_scope_begin (&inner);
+  run_stage (GST_VAAPI_TIMING_STAGE_DECODE);
+  run_stage (GST_VAAPI_TIMING_STAGE_SYNC);
+  gst_vaapi_timing_scope_end (&inner);
+
+  g_assert_cmpuint (inner.durations[GST_VAAPI_TIMING_STAGE_PARSE], ==, 0);
+  g_assert_cmpuint (inner.durations[GST_VAAPI_TIMING_STAGE_DECODE], >=,
+      GST_MSECOND);
+  g_assert_cmpuint (inner.durations[GST_VAAPI_TIMING_STAGE_SYNC], >=,
+      GST_MSECOND);
+
+  run_stage (GST_VAAPI_TIMING_STAGE_PARSE);
+  gst_vaapi_timing_scope_end (&outer);
+
+  g_assert_cmpuint (outer.durations[GST_VAAPI_TIMING_STAGE_PARSE], >=,
+      2 * GST_MSECOND);
+  g_assert_cmpuint (outer.durations[GST_VAAPI_TIMING_STAGE_DECODE], ==,
+      inner.durations[GST_VAAPI_TIMING_STAGE_DECODE]);
+  g_assert_cmpuint (outer.durations[GST_VAAPI_TIMING_STAGE_SYNC], ==,
+      inner.durations[GST_VAAPI_TIMING_STAGE_SYNC]);
+  g_assert_cmpuint (outer.durations[GST_VAAPI_TIMING_STAGE_PUSH], ==, 0);
+  g_assert_cmpuint (calls.num_calls[GST_VAAPI_TIMING_STAGE_PARSE], ==, 2);
+
+  /* The scope of the thread is restored */
+  run_stage (GST_VAAPI_TIMING_STAGE_ENCODE);
+  g_assert_cmpuint (outer.durations[GST_VAAPI_TIMING_STAGE_ENCODE], ==, 0);
+
+  gst_vaapi_timing_set_func (NULL, NULL);
+  g_assert (!GST_VAAPI_TIMING_IS_ENABLED ());
+}
+
+static void
+test_stage_names (void)
+{
+  guint i;
+
+  for (i = 0; i < GST_VAAPI_TIMING_STAGE_COUNT; i++)
+    g_assert (gst_vaapi_timing_stage_get_name (i) != NULL);
+  g_assert_cmpstr (gst_vaapi_timing_stage_get_name
+      (GST_VAAPI_TIMING_STAGE_SYNC), ==, "sync");
+  g_assert (gst_vaapi_timing_stage_get_name
+      (GST_VAAPI_TIMING_STAGE_COUNT) == NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gst_init (&argc, &argv);
+
+  test_disabled ();
+  test_scopes ();
+  test_stage_names ();
+
+  g_print ("all timing tests passed\n");
+  gst_deinit ();
+  return 0;
+}
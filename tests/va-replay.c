@@ -0,0 +1,1044 @@
+/*
+ *  va-replay.c - VA command stream replayer
+ *
+ *  Copyright (C) 2017 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This replays a VA command stream recorded with the GST_VAAPI_RECORD
+ * environment variable, against the VA driver of the default display,
+ * or against a null backend that only measures the replay cost.
+ *
+ * The ids of the recording driver are mapped to the ids of the objects
+ * created on replay. The surfaces and coded buffers that parameter
+ * buffers refer to are relocated through the fields known to hold them,
+ * according to the codec and the buffer type. Other parameter buffers
+ * are replayed as is.
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <time.h>
+#include <gst/vaapi/gstvaapicompat.h>
+#include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapiprofile.h>
+#include <gst/vaapi/gstvaapiprofiler.h>
+#include <gst/vaapi/gstvaapirecorder.h>
+#if USE_VP8_DECODER
+# include <va/va_dec_vp8.h>
+#endif
+#if USE_VP9_DECODER
+# include <va/va_dec_vp9.h>
+#endif
+#if USE_ENCODERS
+# include <va/va_enc_h264.h>
+# include <va/va_enc_mpeg2.h>
+#endif
+#if USE_JPEG_ENCODER
+# include <va/va_enc_jpeg.h>
+#endif
+#if USE_VP8_ENCODER
+# include <va/va_enc_vp8.h>
+#endif
+#if USE_H265_ENCODER
+# include <va/va_enc_hevc.h>
+#endif
+#if USE_VP9_ENCODER
+# include <va/va_enc_vp9.h>
+#endif
+#if USE_VA_VPP
+# include <va/va_vpp.h>
+#endif
+#include "output.h"
+
+static gboolean g_null_backend;
+static gboolean g_profile;
+
+static GOptionEntry g_options[] = {
+  {"null", 0,
+        0,
+        G_OPTION_ARG_NONE, &g_null_backend,
+      "replay against a null backend", NULL},
+  {"profile", 0,
+        0,
+        G_OPTION_ARG_NONE, &g_profile,
+      "print the latency of the VA calls", NULL},
+  {NULL,}
+};
+
+typedef struct
+{
+  VAConfigID id;
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+  guint rt_format;
+} Config;
+
+typedef struct
+{
+  VAContextID id;
+  GstVaapiCodec codec;
+  gboolean is_encoder;
+  gboolean is_vpp;
+  guint rt_format;
+  guint width;
+  guint height;
+} Context;
+
+typedef struct
+{
+  const guint32 *words;
+  guint num_words;
+  guint pos;
+  gboolean overflow;
+} Record;
+
+typedef struct
+{
+  GMappedFile *file;
+  const guint8 *data;
+  gsize size;
+  gsize offset;
+  GstVaapiDisplay *display;
+  VADisplay dpy;                /* NULL with the null backend */
+  GHashTable *configs;
+  GHashTable *contexts;
+  GHashTable *surfaces;
+  GHashTable *buffers;
+  guint num_pictures;
+  guint num_buffers;
+  guint64 num_bytes;
+} Replay;
+
+#define CHECK_STATUS(status, func) \
+  check_status ((status), G_STRINGIFY (func) "()")
+
+static gboolean
+check_status (VAStatus status, const gchar * func)
+{
+  if (status != VA_STATUS_SUCCESS) {
+    g_message ("%s: %s", func, vaErrorStr (status));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static guint32
+record_get_word (Record * record)
+{
+  if (record->pos >= record->num_words) {
+    record->overflow = TRUE;
+    return 0;
+  }
+  return record->words[record->pos++];
+}
+
+static const guint8 *
+record_get_data (Record * record, guint64 size)
+{
+  const guint64 num_words = (size + 3) / 4;
+  const guint8 *data;
+
+  if (num_words > record->num_words - record->pos) {
+    record->overflow = TRUE;
+    return NULL;
+  }
+  data = (const guint8 *) (record->words + record->pos);
+  record->pos += num_words;
+  return data;
+}
+
+static gboolean
+lookup_id (GHashTable * ids, guint old_id, guint * new_id_ptr)
+{
+  gpointer value;
+
+  if (!g_hash_table_lookup_extended (ids, GUINT_TO_POINTER (old_id), NULL,
+          &value))
+    return FALSE;
+  *new_id_ptr = GPOINTER_TO_UINT (value);
+  return TRUE;
+}
+
+static void
+destroy_config (Replay * replay, Config * config)
+{
+  VAStatus status;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, VA_INVALID_ID,
+        DESTROY_CONFIG, 0, vaDestroyConfig (replay->dpy, config->id));
+    CHECK_STATUS (status, vaDestroyConfig);
+  }
+  g_free (config);
+}
+
+static void
+destroy_context (Replay * replay, Context * context)
+{
+  VAStatus status;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, context->id,
+        DESTROY_CONTEXT, 0, vaDestroyContext (replay->dpy, context->id));
+    CHECK_STATUS (status, vaDestroyContext);
+  }
+  g_free (context);
+}
+
+static void
+destroy_surface (Replay * replay, VASurfaceID surface)
+{
+  VAStatus status;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, VA_INVALID_ID,
+        DESTROY_SURFACES, 0, vaDestroySurfaces (replay->dpy, &surface, 1));
+    CHECK_STATUS (status, vaDestroySurfaces);
+  }
+}
+
+static void
+destroy_buffer (Replay * replay, VABufferID buffer)
+{
+  VAStatus status;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, VA_INVALID_ID,
+        DESTROY_BUFFER, 0, vaDestroyBuffer (replay->dpy, buffer));
+    CHECK_STATUS (status, vaDestroyBuffer);
+  }
+}
+
+static gboolean
+create_surface (Replay * replay, VASurfaceID old_id, guint rt_format,
+    guint width, guint height, VASurfaceID * new_id_ptr)
+{
+  VASurfaceID surface = old_id;
+  VAStatus status;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, VA_INVALID_ID,
+        CREATE_SURFACES, 0, vaCreateSurfaces (replay->dpy, width, height,
+            rt_format, 1, &surface));
+    if (!CHECK_STATUS (status, vaCreateSurfaces))
+      return FALSE;
+  }
+  g_hash_table_insert (replay->surfaces, GUINT_TO_POINTER (old_id),
+      GUINT_TO_POINTER (surface));
+  *new_id_ptr = surface;
+  return TRUE;
+}
+
+static gboolean
+replay_create_config (Replay * replay, Record * record)
+{
+  const VAConfigID old_id = record_get_word (record);
+  const VAProfile profile = record_get_word (record);
+  const VAEntrypoint entrypoint = record_get_word (record);
+  const guint num_attribs = record_get_word (record);
+  VAConfigAttrib *attribs;
+  Config *config, *old_config;
+  VAStatus status;
+  guint i;
+
+  if (num_attribs > (record->num_words - record->pos) / 2)
+    return FALSE;
+
+  config = g_new (Config, 1);
+  config->id = old_id;
+  config->profile = profile;
+  config->entrypoint = entrypoint;
+  config->rt_format = VA_RT_FORMAT_YUV420;
+
+  attribs = g_new (VAConfigAttrib, num_attribs);
+  for (i = 0; i < num_attribs; i++) {
+    attribs[i].type = record_get_word (record);
+    attribs[i].value = record_get_word (record);
+    if (attribs[i].type == VAConfigAttribRTFormat)
+      config->rt_format = attribs[i].value;
+  }
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, VA_INVALID_ID,
+        CREATE_CONFIG, 0, vaCreateConfig (replay->dpy, profile, entrypoint,
+            attribs, num_attribs, &config->id));
+    if (!CHECK_STATUS (status, vaCreateConfig)) {
+      g_free (attribs);
+      g_free (config);
+      return FALSE;
+    }
+  }
+  g_free (attribs);
+
+  /* The recording driver reused the id of a destroyed config */
+  old_config = g_hash_table_lookup (replay->configs, GUINT_TO_POINTER (old_id));
+  if (old_config)
+    destroy_config (replay, old_config);
+  g_hash_table_insert (replay->configs, GUINT_TO_POINTER (old_id), config);
+  return TRUE;
+}
+
+static gboolean
+replay_create_context (Replay * replay, Record * record)
+{
+  const VAContextID old_id = record_get_word (record);
+  const VAConfigID old_config_id = record_get_word (record);
+  const guint width = record_get_word (record);
+  const guint height = record_get_word (record);
+  const gint flag = record_get_word (record);
+  const guint num_surfaces = record_get_word (record);
+  VASurfaceID *surfaces;
+  Config *config;
+  Context *context;
+  VAStatus status;
+  guint i;
+
+  config = g_hash_table_lookup (replay->configs,
+      GUINT_TO_POINTER (old_config_id));
+  if (!config || num_surfaces > record->num_words - record->pos)
+    return FALSE;
+
+  surfaces = g_new (VASurfaceID, num_surfaces);
+  for (i = 0; i < num_surfaces; i++) {
+    const VASurfaceID surface = record_get_word (record);
+    if (!lookup_id (replay->surfaces, surface, &surfaces[i]) &&
+        !create_surface (replay, surface, config->rt_format, width, height,
+            &surfaces[i]))
+      goto error;
+  }
+
+  context = g_new (Context, 1);
+  context->id = old_id;
+  context->codec = gst_vaapi_profile_get_codec (gst_vaapi_profile
+      (config->profile));
+  switch (gst_vaapi_entrypoint (config->entrypoint)) {
+    case GST_VAAPI_ENTRYPOINT_SLICE_ENCODE:
+    case GST_VAAPI_ENTRYPOINT_PICTURE_ENCODE:
+    case GST_VAAPI_ENTRYPOINT_SLICE_ENCODE_LP:
+      context->is_encoder = TRUE;
+      break;
+    default:
+      context->is_encoder = FALSE;
+      break;
+  }
+#if USE_VA_VPP
+  context->is_vpp = config->entrypoint == VAEntrypointVideoProc;
+#else
+  context->is_vpp = FALSE;
+#endif
+  context->rt_format = config->rt_format;
+  context->width = width;
+  context->height = height;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, VA_INVALID_ID,
+        CREATE_CONTEXT, 0, vaCreateContext (replay->dpy, config->id, width,
+            height, flag, surfaces, num_surfaces, &context->id));
+    if (!CHECK_STATUS (status, vaCreateContext)) {
+      g_free (context);
+      goto error;
+    }
+  }
+  g_free (surfaces);
+
+  g_hash_table_insert (replay->contexts, GUINT_TO_POINTER (old_id), context);
+  return TRUE;
+
+error:
+  g_free (surfaces);
+  return FALSE;
+}
+
+static gboolean
+replay_destroy_context (Replay * replay, Record * record)
+{
+  const VAContextID old_id = record_get_word (record);
+  Context *context;
+
+  context = g_hash_table_lookup (replay->contexts, GUINT_TO_POINTER (old_id));
+  if (!context)
+    return FALSE;
+
+  g_hash_table_steal (replay->contexts, GUINT_TO_POINTER (old_id));
+  destroy_context (replay, context);
+  return TRUE;
+}
+
+static gboolean
+replay_create_buffer (Replay * replay, Record * record)
+{
+  const VAContextID old_context_id = record_get_word (record);
+  const VABufferID old_id = record_get_word (record);
+  const VABufferType type = record_get_word (record);
+  const guint size = record_get_word (record);
+  VABufferID buffer = old_id, old_buffer;
+  Context *context;
+  VAStatus status;
+
+  context = g_hash_table_lookup (replay->contexts,
+      GUINT_TO_POINTER (old_context_id));
+  if (!context)
+    return FALSE;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, context->id, CREATE_BUFFER,
+        size, vaCreateBuffer (replay->dpy, context->id, type, size, 1, NULL,
+            &buffer));
+    if (!CHECK_STATUS (status, vaCreateBuffer))
+      return FALSE;
+  }
+
+  /* The recording driver reused the id of a destroyed coded buffer */
+  if (lookup_id (replay->buffers, old_id, &old_buffer))
+    destroy_buffer (replay, old_buffer);
+  g_hash_table_insert (replay->buffers, GUINT_TO_POINTER (old_id),
+      GUINT_TO_POINTER (buffer));
+  return TRUE;
+}
+
+static gboolean
+replay_begin_picture (Replay * replay, Record * record)
+{
+  const VAContextID old_context_id = record_get_word (record);
+  const VASurfaceID old_surface_id = record_get_word (record);
+  VASurfaceID surface;
+  Context *context;
+  VAStatus status;
+
+  context = g_hash_table_lookup (replay->contexts,
+      GUINT_TO_POINTER (old_context_id));
+  if (!context)
+    return FALSE;
+
+  /* e.g. the source surfaces of an encoder are not bound to the context */
+  if (!lookup_id (replay->surfaces, old_surface_id, &surface) &&
+      !create_surface (replay, old_surface_id, context->rt_format,
+          context->width, context->height, &surface))
+    return FALSE;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, context->id, BEGIN_PICTURE,
+        0, vaBeginPicture (replay->dpy, context->id, surface));
+    if (!CHECK_STATUS (status, vaBeginPicture))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Relocates the recorded surface or coded buffer id at @id_ptr */
+static void
+relocate_id (GHashTable * ids, VAGenericID * id_ptr)
+{
+  guint new_id;
+
+  if (lookup_id (ids, *id_ptr, &new_id))
+    *id_ptr = new_id;
+}
+
+#define relocate_surface(replay, id) \
+  relocate_id ((replay)->surfaces, &(id))
+#define relocate_buffer(replay, id) \
+  relocate_id ((replay)->buffers, &(id))
+
+static void
+relocate_pictures_h264 (Replay * replay, VAPictureH264 * pictures,
+    guint num_pictures)
+{
+  guint i;
+
+  for (i = 0; i < num_pictures; i++)
+    relocate_surface (replay, pictures[i].picture_id);
+}
+
+#if USE_H265_DECODER || USE_H265_ENCODER
+static void
+relocate_pictures_hevc (Replay * replay, VAPictureHEVC * pictures,
+    guint num_pictures)
+{
+  guint i;
+
+  for (i = 0; i < num_pictures; i++)
+    relocate_surface (replay, pictures[i].picture_id);
+}
+#endif
+
+static void
+relocate_surfaces (Replay * replay, VASurfaceID * surfaces,
+    guint num_surfaces)
+{
+  guint i;
+
+  for (i = 0; i < num_surfaces; i++)
+    relocate_surface (replay, surfaces[i]);
+}
+
+/* Relocates the surfaces and coded buffers one element of a decoder
+   parameter buffer refers to */
+static void
+relocate_decode_element (Replay * replay, GstVaapiCodec codec,
+    VABufferType type, gpointer data, guint size)
+{
+  switch (codec) {
+    case GST_VAAPI_CODEC_H264:{
+      if (type == VAPictureParameterBufferType) {
+        VAPictureParameterBufferH264 *const param = data;
+        if (size < sizeof (*param))
+          break;
+        relocate_pictures_h264 (replay, &param->CurrPic, 1);
+        relocate_pictures_h264 (replay, param->ReferenceFrames,
+            G_N_ELEMENTS (param->ReferenceFrames));
+      } else if (type == VASliceParameterBufferType) {
+        VASliceParameterBufferH264 *const param = data;
+        if (size < sizeof (*param))
+          break;
+        relocate_pictures_h264 (replay, param->RefPicList0,
+            G_N_ELEMENTS (param->RefPicList0));
+        relocate_pictures_h264 (replay, param->RefPicList1,
+            G_N_ELEMENTS (param->RefPicList1));
+      }
+      break;
+    }
+    case GST_VAAPI_CODEC_MPEG2:{
+      VAPictureParameterBufferMPEG2 *const param = data;
+      if (type != VAPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->forward_reference_picture);
+      relocate_surface (replay, param->backward_reference_picture);
+      break;
+    }
+    case GST_VAAPI_CODEC_MPEG4:
+    case GST_VAAPI_CODEC_H263:{
+      VAPictureParameterBufferMPEG4 *const param = data;
+      if (type != VAPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->forward_reference_picture);
+      relocate_surface (replay, param->backward_reference_picture);
+      break;
+    }
+    case GST_VAAPI_CODEC_WMV3:
+    case GST_VAAPI_CODEC_VC1:{
+      VAPictureParameterBufferVC1 *const param = data;
+      if (type != VAPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->forward_reference_picture);
+      relocate_surface (replay, param->backward_reference_picture);
+      relocate_surface (replay, param->inloop_decoded_picture);
+      break;
+    }
+#if USE_VP8_DECODER
+    case GST_VAAPI_CODEC_VP8:{
+      VAPictureParameterBufferVP8 *const param = data;
+      if (type != VAPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->last_ref_frame);
+      relocate_surface (replay, param->golden_ref_frame);
+      relocate_surface (replay, param->alt_ref_frame);
+      relocate_surface (replay, param->out_of_loop_frame);
+      break;
+    }
+#endif
+#if USE_H265_DECODER
+    case GST_VAAPI_CODEC_H265:{
+      VAPictureParameterBufferHEVC *const param = data;
+      if (type != VAPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_pictures_hevc (replay, &param->CurrPic, 1);
+      relocate_pictures_hevc (replay, param->ReferenceFrames,
+          G_N_ELEMENTS (param->ReferenceFrames));
+      break;
+    }
+#endif
+#if USE_VP9_DECODER
+    case GST_VAAPI_CODEC_VP9:{
+      VADecPictureParameterBufferVP9 *const param = data;
+      if (type != VAPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surfaces (replay, param->reference_frames,
+          G_N_ELEMENTS (param->reference_frames));
+      break;
+    }
+#endif
+    default:
+      break;
+  }
+}
+
+#if USE_ENCODERS
+/* Relocates the surfaces and coded buffers one element of an encoder
+   parameter buffer refers to */
+static void
+relocate_encode_element (Replay * replay, GstVaapiCodec codec,
+    VABufferType type, gpointer data, guint size)
+{
+  switch (codec) {
+    case GST_VAAPI_CODEC_H264:{
+      if (type == VAEncPictureParameterBufferType) {
+        VAEncPictureParameterBufferH264 *const param = data;
+        if (size < sizeof (*param))
+          break;
+        relocate_pictures_h264 (replay, &param->CurrPic, 1);
+        relocate_pictures_h264 (replay, param->ReferenceFrames,
+            G_N_ELEMENTS (param->ReferenceFrames));
+        relocate_buffer (replay, param->coded_buf);
+      } else if (type == VAEncSliceParameterBufferType) {
+        VAEncSliceParameterBufferH264 *const param = data;
+        if (size < sizeof (*param))
+          break;
+        relocate_pictures_h264 (replay, param->RefPicList0,
+            G_N_ELEMENTS (param->RefPicList0));
+        relocate_pictures_h264 (replay, param->RefPicList1,
+            G_N_ELEMENTS (param->RefPicList1));
+      }
+      break;
+    }
+    case GST_VAAPI_CODEC_MPEG2:{
+      VAEncPictureParameterBufferMPEG2 *const param = data;
+      if (type != VAEncPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->forward_reference_picture);
+      relocate_surface (replay, param->backward_reference_picture);
+      relocate_surface (replay, param->reconstructed_picture);
+      relocate_buffer (replay, param->coded_buf);
+      break;
+    }
+#if USE_JPEG_ENCODER
+    case GST_VAAPI_CODEC_JPEG:{
+      VAEncPictureParameterBufferJPEG *const param = data;
+      if (type != VAEncPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->reconstructed_picture);
+      relocate_buffer (replay, param->coded_buf);
+      break;
+    }
+#endif
+#if USE_VP8_ENCODER
+    case GST_VAAPI_CODEC_VP8:{
+      VAEncPictureParameterBufferVP8 *const param = data;
+      if (type != VAEncPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->reconstructed_frame);
+      relocate_surface (replay, param->ref_last_frame);
+      relocate_surface (replay, param->ref_gf_frame);
+      relocate_surface (replay, param->ref_arf_frame);
+      relocate_buffer (replay, param->coded_buf);
+      break;
+    }
+#endif
+#if USE_H265_ENCODER
+    case GST_VAAPI_CODEC_H265:{
+      if (type == VAEncPictureParameterBufferType) {
+        VAEncPictureParameterBufferHEVC *const param = data;
+        if (size < sizeof (*param))
+          break;
+        relocate_pictures_hevc (replay, &param->decoded_curr_pic, 1);
+        relocate_pictures_hevc (replay, param->reference_frames,
+            G_N_ELEMENTS (param->reference_frames));
+        relocate_buffer (replay, param->coded_buf);
+      } else if (type == VAEncSliceParameterBufferType) {
+        VAEncSliceParameterBufferHEVC *const param = data;
+        if (size < sizeof (*param))
+          break;
+        relocate_pictures_hevc (replay, param->ref_pic_list0,
+            G_N_ELEMENTS (param->ref_pic_list0));
+        relocate_pictures_hevc (replay, param->ref_pic_list1,
+            G_N_ELEMENTS (param->ref_pic_list1));
+      }
+      break;
+    }
+#endif
+#if USE_VP9_ENCODER
+    case GST_VAAPI_CODEC_VP9:{
+      VAEncPictureParameterBufferVP9 *const param = data;
+      if (type != VAEncPictureParameterBufferType || size < sizeof (*param))
+        break;
+      relocate_surface (replay, param->reconstructed_frame);
+      relocate_surfaces (replay, param->reference_frames,
+          G_N_ELEMENTS (param->reference_frames));
+      relocate_buffer (replay, param->coded_buf);
+      break;
+    }
+#endif
+    default:
+      break;
+  }
+}
+#endif
+
+/* Relocates the ids held by the known fields of each element of a
+   parameter buffer. Other words are left alone, since drivers with
+   small integer ids would make any counter or flag look like an id */
+static void
+relocate_ids (Replay * replay, Context * context, VABufferType type,
+    guint8 * data, guint size, guint num_elements)
+{
+  guint i;
+
+  for (i = 0; i < num_elements; i++, data += size) {
+#if USE_VA_VPP
+    if (context->is_vpp) {
+      VAProcPipelineParameterBuffer *const param = (gpointer) data;
+      if (type == VAProcPipelineParameterBufferType &&
+          size >= sizeof (*param))
+        relocate_surface (replay, param->surface);
+      continue;
+    }
+#endif
+#if USE_ENCODERS
+    if (context->is_encoder) {
+      relocate_encode_element (replay, context->codec, type, data, size);
+      continue;
+    }
+#endif
+    relocate_decode_element (replay, context->codec, type, data, size);
+  }
+}
+
+static gboolean
+replay_render_picture (Replay * replay, Record * record)
+{
+  const VAContextID old_context_id = record_get_word (record);
+  const guint num_buffers = record_get_word (record);
+  VABufferID *buffers;
+  Context *context;
+  VAStatus status;
+  gboolean success = FALSE;
+  guint i, n = 0;
+
+  context = g_hash_table_lookup (replay->contexts,
+      GUINT_TO_POINTER (old_context_id));
+  if (!context || num_buffers > record->num_words - record->pos)
+    return FALSE;
+
+  buffers = g_new (VABufferID, num_buffers);
+  for (i = 0; i < num_buffers; i++) {
+    const VABufferID old_id = record_get_word (record);
+    const VABufferType type = record_get_word (record);
+    const guint size = record_get_word (record);
+    const guint num_elements = record_get_word (record);
+    const guint64 data_size = (guint64) size * num_elements;
+    const guint8 *data;
+    guint8 *payload;
+
+    data = record_get_data (record, data_size);
+    if (!data)
+      goto cleanup;
+    if (data_size == 0) {
+      g_message ("skipping empty buffer 0x%08x", old_id);
+      continue;
+    }
+
+    replay->num_buffers++;
+    replay->num_bytes += data_size;
+    if (!replay->dpy)
+      continue;
+
+    payload = g_memdup (data, data_size);
+    relocate_ids (replay, context, type, payload, size,
+        num_elements);
+
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, context->id, CREATE_BUFFER,
+        data_size, vaCreateBuffer (replay->dpy, context->id, type, size,
+            num_elements, payload, &buffers[n]));
+    g_free (payload);
+    if (!CHECK_STATUS (status, vaCreateBuffer))
+      goto cleanup;
+    n++;
+  }
+
+  if (replay->dpy && n > 0) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, context->id,
+        RENDER_PICTURE, 0, vaRenderPicture (replay->dpy, context->id, buffers,
+            n));
+    if (!CHECK_STATUS (status, vaRenderPicture))
+      goto cleanup;
+  }
+  success = TRUE;
+
+cleanup:
+  for (i = 0; i < n; i++)
+    destroy_buffer (replay, buffers[i]);
+  g_free (buffers);
+  return success;
+}
+
+static gboolean
+replay_end_picture (Replay * replay, Record * record)
+{
+  const VAContextID old_context_id = record_get_word (record);
+  Context *context;
+  VAStatus status;
+
+  context = g_hash_table_lookup (replay->contexts,
+      GUINT_TO_POINTER (old_context_id));
+  if (!context)
+    return FALSE;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, context->id, END_PICTURE,
+        0, vaEndPicture (replay->dpy, context->id));
+    if (!CHECK_STATUS (status, vaEndPicture))
+      return FALSE;
+  }
+  replay->num_pictures++;
+  return TRUE;
+}
+
+static gboolean
+replay_sync_surface (Replay * replay, Record * record)
+{
+  const VASurfaceID old_id = record_get_word (record);
+  VASurfaceID surface;
+  VAStatus status;
+
+  /* Surfaces that were never rendered to are not replayed */
+  if (!lookup_id (replay->surfaces, old_id, &surface))
+    return TRUE;
+
+  if (replay->dpy) {
+    GST_VAAPI_PROFILER_CALL (status, replay->dpy, VA_INVALID_ID,
+        SYNC_SURFACE, 0, vaSyncSurface (replay->dpy, surface));
+    if (!CHECK_STATUS (status, vaSyncSurface))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+replay_record (Replay * replay)
+{
+  guint32 header[2];
+  Record record = { NULL, };
+  gboolean success;
+
+  if (replay->size - replay->offset < sizeof (header))
+    goto error_truncated;
+  memcpy (header, replay->data + replay->offset, sizeof (header));
+  replay->offset += sizeof (header);
+
+  if (header[1] % 4 || header[1] > replay->size - replay->offset)
+    goto error_truncated;
+  record.words = (const guint32 *) (replay->data + replay->offset);
+  record.num_words = header[1] / 4;
+  replay->offset += header[1];
+
+  switch (header[0]) {
+    case GST_VAAPI_RECORD_CREATE_CONFIG:
+      success = replay_create_config (replay, &record);
+      break;
+    case GST_VAAPI_RECORD_CREATE_CONTEXT:
+      success = replay_create_context (replay, &record);
+      break;
+    case GST_VAAPI_RECORD_DESTROY_CONTEXT:
+      success = replay_destroy_context (replay, &record);
+      break;
+    case GST_VAAPI_RECORD_CREATE_BUFFER:
+      success = replay_create_buffer (replay, &record);
+      break;
+    case GST_VAAPI_RECORD_BEGIN_PICTURE:
+      success = replay_begin_picture (replay, &record);
+      break;
+    case GST_VAAPI_RECORD_RENDER_PICTURE:
+      success = replay_render_picture (replay, &record);
+      break;
+    case GST_VAAPI_RECORD_END_PICTURE:
+      success = replay_end_picture (replay, &record);
+      break;
+    case GST_VAAPI_RECORD_SYNC_SURFACE:
+      success = replay_sync_surface (replay, &record);
+      break;
+    default:
+      /* Records added by later versions are skipped */
+      success = TRUE;
+      break;
+  }
+  if (!success || record.overflow) {
+    g_message ("failed to replay record %u at offset %" G_GSIZE_FORMAT,
+        header[0], replay->offset - header[1] - sizeof (header));
+    return FALSE;
+  }
+  return TRUE;
+
+  /* ERRORS */
+error_truncated:
+  {
+    g_message ("truncated trace at offset %" G_GSIZE_FORMAT, replay->offset);
+    return FALSE;
+  }
+}
+
+static void
+replay_destroy_objects (Replay * replay)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, replay->contexts);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    destroy_context (replay, value);
+  g_hash_table_remove_all (replay->contexts);
+
+  g_hash_table_iter_init (&iter, replay->buffers);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    destroy_buffer (replay, GPOINTER_TO_UINT (value));
+  g_hash_table_remove_all (replay->buffers);
+
+  g_hash_table_iter_init (&iter, replay->surfaces);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    destroy_surface (replay, GPOINTER_TO_UINT (value));
+  g_hash_table_remove_all (replay->surfaces);
+
+  g_hash_table_iter_init (&iter, replay->configs);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    destroy_config (replay, value);
+  g_hash_table_remove_all (replay->configs);
+}
+
+static Replay *
+replay_new (void)
+{
+  Replay *replay;
+
+  replay = g_slice_new0 (Replay);
+  replay->configs = g_hash_table_new (NULL, NULL);
+  replay->contexts = g_hash_table_new (NULL, NULL);
+  replay->surfaces = g_hash_table_new (NULL, NULL);
+  replay->buffers = g_hash_table_new (NULL, NULL);
+  return replay;
+}
+
+static void
+replay_free (Replay * replay)
+{
+  if (!replay)
+    return;
+
+  replay_destroy_objects (replay);
+  g_hash_table_unref (replay->configs);
+  g_hash_table_unref (replay->contexts);
+  g_hash_table_unref (replay->surfaces);
+  g_hash_table_unref (replay->buffers);
+
+  if (replay->display)
+    gst_vaapi_display_unref (replay->display);
+  if (replay->file)
+    g_mapped_file_unref (replay->file);
+  g_slice_free (Replay, replay);
+}
+
+static gboolean
+replay_open (Replay * replay, const gchar * file_name)
+{
+  GError *error = NULL;
+  guint32 header[2];
+
+  replay->file = g_mapped_file_new (file_name, FALSE, &error);
+  if (!replay->file) {
+    g_message ("failed to open trace '%s': %s", file_name, error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+  replay->data = (const guint8 *) g_mapped_file_get_contents (replay->file);
+  replay->size = g_mapped_file_get_length (replay->file);
+
+  if (replay->size < sizeof (header))
+    goto error_invalid_header;
+  memcpy (header, replay->data, sizeof (header));
+  if (header[0] != GST_VAAPI_RECORDER_MAGIC ||
+      header[1] != GST_VAAPI_RECORDER_VERSION)
+    goto error_invalid_header;
+  replay->offset = sizeof (header);
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_header:
+  {
+    g_message ("'%s' is not a VA trace, or was recorded on another host "
+        "architecture", file_name);
+    return FALSE;
+  }
+}
+
+static gboolean
+replay_run (Replay * replay, int argc, char *argv[])
+{
+  GTimer *timer;
+  clock_t cpu_start;
+  gdouble elapsed, cpu_time;
+  gboolean success = TRUE;
+  gchar *json;
+
+  if (argc < 2) {
+    g_message ("no trace file specified");
+    return FALSE;
+  }
+
+  if (!replay_open (replay, argv[1]))
+    return FALSE;
+
+  if (!g_null_backend) {
+    replay->display = video_output_create_display (NULL);
+    if (!replay->display) {
+      g_message ("failed to create VA display");
+      return FALSE;
+    }
+    replay->dpy = gst_vaapi_display_get_display (replay->display);
+  }
+
+  if (g_profile)
+    gst_vaapi_profiler_set_enabled (TRUE);
+
+  timer = g_timer_new ();
+  cpu_start = clock ();
+  while (success && replay->offset < replay->size)
+    success = replay_record (replay);
+  cpu_time = (gdouble) (clock () - cpu_start) / CLOCKS_PER_SEC;
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  g_print ("Replayed %u pictures (%u buffers, %" G_GUINT64_FORMAT " bytes) "
+      "on the %s backend in %.3f sec, %.3f sec of CPU time\n",
+      replay->num_pictures, replay->num_buffers, replay->num_bytes,
+      replay->dpy ? "VA" : "null", elapsed, cpu_time);
+
+  replay_destroy_objects (replay);
+
+  if (g_profile && replay->dpy) {
+    json = gst_vaapi_profiler_to_json (replay->dpy);
+    if (json)
+      g_print ("%s\n", json);
+    g_free (json);
+  }
+  return success;
+}
+
+int
+main (int argc, char *argv[])
+{
+  Replay *replay;
+  gint ret;
+
+  if (!video_output_init (&argc, argv, g_options))
+    g_error ("failed to initialize video output subsystem");
+
+  replay = replay_new ();
+  ret = !replay_run (replay, argc, argv);
+
+  replay_free (replay);
+  video_output_exit ();
+  return ret;
+}